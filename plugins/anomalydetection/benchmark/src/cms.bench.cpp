@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <benchmark/benchmark.h>
+#include <num/cms.h>
+#include <num/sliding_cms.h>
+#include <num/space_saving.h>
+#include <num/bloom_filter.h>
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using plugin::anomalydetection::num::cms;
+using plugin::anomalydetection::num::cms_digest;
+using plugin::anomalydetection::num::cms_hash_mode;
+using plugin::anomalydetection::num::sliding_cms;
+using plugin::anomalydetection::num::space_saving;
+using plugin::anomalydetection::num::bloom_filter;
+
+namespace
+{
+
+#define BENCH_N_VALUES 4096
+
+// Deterministic set of profile-like strings of length `len`, e.g. concatenated file paths and comm names
+std::vector<std::string> make_values(size_t len)
+{
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int> chars('a', 'z');
+    std::vector<std::string> res(BENCH_N_VALUES);
+    for (auto& v : res)
+    {
+        v.resize(len);
+        for (auto& c : v)
+        {
+            c = (char)chars(rng);
+        }
+    }
+    return res;
+}
+
+// Common args: d, w, value length
+void cms_args(benchmark::internal::Benchmark* b)
+{
+    for (int64_t d : {3, 7})
+    {
+        for (int64_t w : {1024, 27183})
+        {
+            for (int64_t len : {16, 256})
+            {
+                b->Args({d, w, len});
+            }
+        }
+    }
+}
+
+void set_counters(benchmark::State& state, uint64_t size_bytes)
+{
+    state.SetItemsProcessed(state.iterations());
+    state.counters["bytes"] = (double)size_bytes;
+}
+
+template<typename T, cms_hash_mode hash_mode, bool conservative>
+void BM_cms_update(benchmark::State& state)
+{
+    cms<T> sketch((uint64_t)state.range(0), (uint64_t)state.range(1), false, hash_mode, conservative);
+    auto values = make_values(state.range(2));
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        sketch.update(values[i++ % BENCH_N_VALUES], 1);
+    }
+    set_counters(state, sketch.get_size_bytes());
+}
+
+template<typename T, cms_hash_mode hash_mode>
+void BM_cms_estimate(benchmark::State& state)
+{
+    cms<T> sketch((uint64_t)state.range(0), (uint64_t)state.range(1), false, hash_mode);
+    auto values = make_values(state.range(2));
+    for (const auto& v : values)
+    {
+        sketch.update(v, 1);
+    }
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(sketch.estimate(values[i++ % BENCH_N_VALUES]));
+    }
+    set_counters(state, sketch.get_size_bytes());
+}
+
+// What the plugin does per event: hash once, update and estimate with the shared digest.
+// Digests are only available with double hashing.
+template<typename T>
+void BM_cms_digest_update_estimate(benchmark::State& state)
+{
+    cms<T> sketch((uint64_t)state.range(0), (uint64_t)state.range(1), false, cms_hash_mode::DOUBLE_HASHING);
+    auto values = make_values(state.range(2));
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        auto digest = cms<T>::get_digest(values[i++ % BENCH_N_VALUES]);
+        sketch.update(digest, 1);
+        benchmark::DoNotOptimize(sketch.estimate(digest));
+    }
+    set_counters(state, sketch.get_size_bytes());
+}
+
+template<typename T>
+void BM_sliding_cms_update_estimate(benchmark::State& state)
+{
+    const uint64_t n_buckets = 6;
+    const uint64_t window_ns = 60ULL * 1000 * 1000 * 1000;
+    sliding_cms<T> sketch((uint64_t)state.range(0), (uint64_t)state.range(1), n_buckets, window_ns, false, cms_hash_mode::DOUBLE_HASHING);
+    auto values = make_values(state.range(2));
+    size_t i = 0;
+    uint64_t ts = 0;
+    for (auto _ : state)
+    {
+        // 1ms of simulated time per event, so that buckets rotate during the run
+        ts += 1000 * 1000;
+        sketch.advance(ts);
+        auto digest = cms<T>::get_digest(values[i++ % BENCH_N_VALUES]);
+        sketch.update(digest, 1);
+        benchmark::DoNotOptimize(sketch.estimate(digest));
+    }
+    set_counters(state, sketch.get_size_bytes());
+}
+
+// Estimates of `state.range(0)` sketches for the same event, as when a rule reads several
+// `anomaly.count_min_sketch[i]` fields; `prefetch` issues all probes before reading any of them
+template<bool prefetch>
+void BM_cms_multi_sketch_estimate(benchmark::State& state)
+{
+    std::vector<std::unique_ptr<cms<uint64_t>>> sketches;
+    for (int64_t i = 0; i < state.range(0); ++i)
+    {
+        sketches.emplace_back(std::make_unique<cms<uint64_t>>((uint64_t)7, (uint64_t)state.range(1), false, cms_hash_mode::DOUBLE_HASHING));
+    }
+    auto values = make_values(64);
+    std::vector<cms_digest> digests;
+    for (const auto& v : values)
+    {
+        digests.push_back(cms<uint64_t>::get_digest(v));
+    }
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        const auto& digest = digests[i++ % BENCH_N_VALUES];
+        if (prefetch)
+        {
+            for (const auto& s : sketches)
+            {
+                s->prefetch(digest);
+            }
+        }
+        for (const auto& s : sketches)
+        {
+            benchmark::DoNotOptimize(s->estimate(digest));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_space_saving_update(benchmark::State& state)
+{
+    space_saving<uint64_t> top_k((size_t)state.range(0));
+    // Skewed stream: a few heavy hitters and a long tail of unique values
+    auto values = make_values(64);
+    std::mt19937_64 rng(7);
+    std::geometric_distribution<size_t> dist(0.05);
+    std::vector<size_t> stream(BENCH_N_VALUES);
+    for (auto& s : stream)
+    {
+        s = dist(rng) % BENCH_N_VALUES;
+    }
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        const auto& v = values[stream[i++ % BENCH_N_VALUES]];
+        top_k.update(v, cms<uint64_t>::get_digest(v).h1, 1);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// "Seen before" test-and-set of a Bloom filter vs update + estimate of a count min sketch, both pre-hashed
+void BM_bloom_filter_insert(benchmark::State& state)
+{
+    bloom_filter filter((uint64_t)state.range(0), 0.01);
+    auto values = make_values(64);
+    std::vector<cms_digest> digests;
+    for (const auto& v : values)
+    {
+        digests.push_back(cms<uint64_t>::get_digest(v));
+    }
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(filter.insert(digests[i++ % BENCH_N_VALUES]));
+    }
+    set_counters(state, filter.get_size_bytes());
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_cms_update, uint64_t, cms_hash_mode::SEEDED, false)->Apply(cms_args);
+BENCHMARK_TEMPLATE(BM_cms_update, uint64_t, cms_hash_mode::DOUBLE_HASHING, false)->Apply(cms_args);
+BENCHMARK_TEMPLATE(BM_cms_update, uint64_t, cms_hash_mode::DOUBLE_HASHING, true)->Apply(cms_args);
+BENCHMARK_TEMPLATE(BM_cms_update, uint32_t, cms_hash_mode::DOUBLE_HASHING, false)->Apply(cms_args);
+BENCHMARK_TEMPLATE(BM_cms_update, uint16_t, cms_hash_mode::DOUBLE_HASHING, false)->Apply(cms_args);
+
+BENCHMARK_TEMPLATE(BM_cms_estimate, uint64_t, cms_hash_mode::SEEDED)->Apply(cms_args);
+BENCHMARK_TEMPLATE(BM_cms_estimate, uint64_t, cms_hash_mode::DOUBLE_HASHING)->Apply(cms_args);
+BENCHMARK_TEMPLATE(BM_cms_estimate, uint16_t, cms_hash_mode::DOUBLE_HASHING)->Apply(cms_args);
+
+BENCHMARK_TEMPLATE(BM_cms_digest_update_estimate, uint64_t)->Apply(cms_args);
+BENCHMARK_TEMPLATE(BM_cms_digest_update_estimate, uint32_t)->Apply(cms_args);
+
+BENCHMARK_TEMPLATE(BM_sliding_cms_update_estimate, uint64_t)->Apply(cms_args);
+BENCHMARK_TEMPLATE(BM_sliding_cms_update_estimate, uint32_t)->Apply(cms_args);
+
+BENCHMARK_TEMPLATE(BM_cms_multi_sketch_estimate, false)->Args({4, 27183})->Args({8, 271829});
+BENCHMARK_TEMPLATE(BM_cms_multi_sketch_estimate, true)->Args({4, 27183})->Args({8, 271829});
+
+BENCHMARK(BM_space_saving_update)->Arg(10)->Arg(100);
+
+BENCHMARK(BM_bloom_filter_insert)->Arg(100000)->Arg(10000000);
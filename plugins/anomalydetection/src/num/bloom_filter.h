@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "cms.h"
+
+#include <cstdint>
+#include <cmath>
+#include <new>
+#include <string_view>
+#include <algorithm>
+
+namespace plugin::anomalydetection::num
+{
+
+// One block is one cache line of 8 x 64-bit words
+#define BLOOM_FILTER_BLOCK_WORDS 8
+// Bits set per value, one in each word of its block
+#define BLOOM_FILTER_K BLOOM_FILTER_BLOCK_WORDS
+
+/*
+Blocked Bloom filter answering "was this value seen before", for behavior profiles only matched
+against a count of zero / one where a full count min sketch is wasteful. Each value maps to a
+single cache line aligned block (h1 of its `cms_digest`) and sets one bit in each of the block's
+8 words (derived from h2), hence an insert or a query costs exactly one cache miss. Blocking
+slightly raises the false positive probability over a classic Bloom filter of the same size,
+which is accounted for by sizing the filter for `fpp` at `capacity` distinct values. There are
+no false negatives.
+
+Concurrency model: like `cms`, the event parsing thread is the only writer while any thread may
+query or `reset()` concurrently. Words are accessed with relaxed atomic loads / stores. `reset()`
+clears the words in place: an insert racing with it may survive the reset, which at worst makes
+a value look like it was seen before the reset, the usual Bloom filter approximation.
+*/
+class bloom_filter
+{
+private:
+    uint64_t* words_;
+    uint64_t n_blocks_;
+    uint64_t capacity_;
+    double fpp_;
+
+    // Odd multipliers spreading h2 over the 8 words of a block (from the Parquet split block filter)
+    static constexpr uint32_t salts_[BLOOM_FILTER_K] = {
+        0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+        0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+    static inline uint64_t load_word(const uint64_t& w)
+    {
+        return __atomic_load_n(&w, __ATOMIC_RELAXED);
+    }
+
+    static inline void store_word(uint64_t& w, uint64_t v)
+    {
+        __atomic_store_n(&w, v, __ATOMIC_RELAXED);
+    }
+
+    // Map the 64-bit hash to [0, n_blocks_) without a division
+    inline uint64_t* block(const cms_digest& digest) const
+    {
+        uint64_t b = (uint64_t)(((unsigned __int128)digest.h1 * n_blocks_) >> 64);
+        return words_ + b * BLOOM_FILTER_BLOCK_WORDS;
+    }
+
+    // Bit of word `i` the value maps to, the top 6 bits of the salted hash
+    static inline uint64_t mask(const cms_digest& digest, uint32_t i)
+    {
+        return 1ULL << (((uint32_t)digest.h2 * salts_[i]) >> 26);
+    }
+
+public:
+    bloom_filter(uint64_t capacity, double fpp) : capacity_(capacity < 1 ? 1 : capacity), fpp_(fpp)
+    {
+        n_blocks_ = calculate_n_blocks(capacity_, fpp_);
+        size_t bytes = get_size_bytes(n_blocks_);
+        words_ = static_cast<uint64_t*>(::operator new[](bytes, std::align_val_t(CMS_CACHE_LINE_SIZE)));
+        std::fill(words_, words_ + n_blocks_ * BLOOM_FILTER_BLOCK_WORDS, 0ULL);
+    }
+
+    bloom_filter(const bloom_filter&) = delete;
+    bloom_filter& operator=(const bloom_filter&) = delete;
+
+    ~bloom_filter()
+    {
+        ::operator delete[](words_, std::align_val_t(CMS_CACHE_LINE_SIZE));
+    }
+
+    // Number of blocks for a false positive probability `fpp` at `capacity` values: m / n = -k / ln(1 - fpp^(1 / k))
+    // bits per value for a classic filter, plus 10% as blocking concentrates the values of a block
+    static uint64_t calculate_n_blocks(uint64_t capacity, double fpp)
+    {
+        if (!(fpp > 0.0 && fpp < 1.0))
+        {
+            fpp = 0.01;
+        }
+        double bits_per_value = -(double)BLOOM_FILTER_K / std::log(1.0 - std::pow(fpp, 1.0 / BLOOM_FILTER_K)) * 1.1;
+        double bits = std::ceil(bits_per_value * (double)capacity);
+        uint64_t block_bits = BLOOM_FILTER_BLOCK_WORDS * 64;
+        uint64_t n = (uint64_t)std::ceil(bits / (double)block_bits);
+        return n < 1 ? 1 : n;
+    }
+
+    static cms_digest get_digest(std::string_view value)
+    {
+        return cms<uint64_t>::get_digest(value);
+    }
+
+    // Add the value and return true if it was (probably) seen before, false if it is new for sure
+    bool insert(const cms_digest& digest)
+    {
+        uint64_t* b = block(digest);
+        bool seen = true;
+        for (uint32_t i = 0; i < BLOOM_FILTER_K; ++i)
+        {
+            uint64_t m = mask(digest, i);
+            uint64_t w = load_word(b[i]);
+            if ((w & m) == 0)
+            {
+                seen = false;
+                store_word(b[i], w | m);
+            }
+        }
+        return seen;
+    }
+
+    bool insert(std::string_view value)
+    {
+        return insert(get_digest(value));
+    }
+
+    bool contains(const cms_digest& digest) const
+    {
+        const uint64_t* b = block(digest);
+        for (uint32_t i = 0; i < BLOOM_FILTER_K; ++i)
+        {
+            if ((load_word(b[i]) & mask(digest, i)) == 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool contains(std::string_view value) const
+    {
+        return contains(get_digest(value));
+    }
+
+    // Hint the single cache line `digest` maps to, see `cms::prefetch`
+    void prefetch(const cms_digest& digest) const
+    {
+        __builtin_prefetch(block(digest), 0, 1);
+    }
+
+    void reset()
+    {
+        for (uint64_t i = 0; i < n_blocks_ * BLOOM_FILTER_BLOCK_WORDS; ++i)
+        {
+            store_word(words_[i], 0);
+        }
+    }
+
+    // Fraction of set bits, O(size) hence meant for metrics. The false positive probability grows
+    // with it, roughly fill_ratio^k once values spread evenly over the blocks.
+    double get_fill_ratio() const
+    {
+        uint64_t n = 0;
+        for (uint64_t i = 0; i < n_blocks_ * BLOOM_FILTER_BLOCK_WORDS; ++i)
+        {
+            n += __builtin_popcountll(load_word(words_[i]));
+        }
+        return (double)n / (double)(n_blocks_ * BLOOM_FILTER_BLOCK_WORDS * 64);
+    }
+
+    uint64_t get_n_blocks() const
+    {
+        return n_blocks_;
+    }
+
+    uint64_t get_capacity() const
+    {
+        return capacity_;
+    }
+
+    double get_fpp() const
+    {
+        return fpp_;
+    }
+
+    size_t get_size_bytes() const
+    {
+        return get_size_bytes(n_blocks_);
+    }
+
+    static size_t get_size_bytes(uint64_t n_blocks)
+    {
+        return n_blocks * BLOOM_FILTER_BLOCK_WORDS * sizeof(uint64_t);
+    }
+};
+
+} // namespace plugin::anomalydetection::num
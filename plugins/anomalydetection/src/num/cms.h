@@ -25,6 +25,13 @@ limitations under the License.
 #include <vector>
 #include <algorithm>
 #include <memory>
+#include <new>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <limits>
+#include <string_view>
+#include <cassert>
 
 /*
 CountMinSketch Powered Probabilistic Counting and Filtering
@@ -34,15 +41,298 @@ Falco Proposal: https://github.com/falcosecurity/falco/blob/master/proposals/202
 namespace plugin::anomalydetection::num
 {
 
+// Counters are stored in one contiguous block aligned to a cache line
+#define CMS_CACHE_LINE_SIZE 64
+// Conservative updates remember the cells of up to this many rows on the stack
+#define CMS_CONSERVATIVE_INLINE_ROWS 16
+
+enum class cms_hash_mode : uint8_t
+{
+    // One XXH3 64-bit hash per row, seeded with the row number (seed = 0..d-1)
+    SEEDED = 0,
+    // One XXH3 128-bit hash per value, row indices derived via double hashing (Kirsch-Mitzenmacher)
+    DOUBLE_HASHING,
+};
+
+// Precomputed 128-bit digest of a value, from which all row indices are derived in `DOUBLE_HASHING` mode.
+// The digest only depends on the value, hence it can be computed once and shared across sketches.
+struct cms_digest
+{
+    uint64_t h1;
+    uint64_t h2;
+};
+
+/*
+Counters saturate at std::numeric_limits<T>::max() instead of wrapping around, which makes narrow
+unsigned counter types (uint16_t, uint32_t) usable to fit more sketches into the same memory.
+
+With `conservative_update` set, an update only raises the cells that hold the current minimum
+estimate (to min + count), instead of incrementing all d cells. Estimates stay upper bounds of
+the true counts, but overestimation from colliding values is sharply reduced at the same width.
+
+Concurrency model: the event parsing thread is the only writer of the counters, while any
+number of threads may read them or call `reset()` concurrently. Counters are accessed with
+relaxed atomic loads / stores (plain moves on x86 / arm64), hence the hot path never blocks.
+`reset()` does not clear counters in place, it publishes a zeroed generation via an atomic
+pointer swap and retires the previous one once no in-flight operation references it anymore.
+In-flight operations are tracked per epoch parity, so `reset()` only waits for operations that
+started before the swap and is never starved by a busy event stream.
+*/
 template<typename T>
 class cms 
 {
+public:
+    using value_type = T;
+
 private:
-    std::unique_ptr<std::unique_ptr<T[]>[]> sketch;
+    // Current generation: all d x w counters in one row-major block, row i starts at sketch[i * w_]
+    std::atomic<T*> sketch;
+    // Number of in-flight operations per epoch parity, see `reset()`
+    mutable std::atomic<uint64_t> readers_[2];
+    std::atomic<uint64_t> epoch_;
+    // Serializes concurrent `reset()` calls, never taken on the hot path
+    std::mutex reset_mutex_;
     uint64_t d_; // d / Rows / number of hash functions
     uint64_t w_; // w / Cols / number of buckets
+    uint64_t w_mask_; // w - 1, only meaningful if w is a power of two
+    bool w_pow2_; // If true, map hashes to buckets via a bit mask instead of a modulo
+    cms_hash_mode hash_mode_; // How the d row indices are derived from a value
+    bool conservative_ = false; // Conservative update, only raise the minimum cells
     double gamma_; // Error probability (e.g. 0.001)
     double eps_; // Relative error (e.g. 0.0001)
+    // External storage, see `use_storage`: two generations flipped by `reset()`. Unset if heap allocated.
+    T* slots_[2] = {nullptr, nullptr};
+    uint64_t* storage_generation_ = nullptr;
+    uint64_t* storage_reset_generation_ = nullptr;
+    std::shared_ptr<void> storage_;
+
+    static uint64_t round_up_pow2(uint64_t v)
+    {
+        uint64_t p = 1;
+        while (p < v)
+        {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    static T* allocate_sketch(uint64_t d, uint64_t w)
+    {
+        size_t bytes = get_size_bytes(d, w);
+        // Round up to the alignment so that the last cache line is fully owned
+        bytes = ((bytes + CMS_CACHE_LINE_SIZE - 1) / CMS_CACHE_LINE_SIZE) * CMS_CACHE_LINE_SIZE;
+        T* p = static_cast<T*>(::operator new[](bytes, std::align_val_t(CMS_CACHE_LINE_SIZE)));
+        std::fill(p, p + d * w, static_cast<T>(0)); // Init to 0
+        return p;
+    }
+
+    static void free_sketch(T* p)
+    {
+        if (p != nullptr)
+        {
+            ::operator delete[](p, std::align_val_t(CMS_CACHE_LINE_SIZE));
+        }
+    }
+
+    // Pins the current generation for the duration of an operation
+    class generation_guard
+    {
+    public:
+        explicit generation_guard(const cms& c) : c_(c)
+        {
+            // seq_cst: the increment must be visible before the pointer load, see `reset()`
+            for (;;)
+            {
+                parity_ = c_.epoch_.load() & 1;
+                c_.readers_[parity_].fetch_add(1);
+                // A reset flipping the epoch before the increment may already have waited on this parity,
+                // the next one would wait on the other: count in the current parity instead
+                if ((c_.epoch_.load() & 1) == parity_)
+                {
+                    break;
+                }
+                c_.readers_[parity_].fetch_sub(1, std::memory_order_release);
+            }
+            base_ = c_.sketch.load();
+        }
+
+        ~generation_guard()
+        {
+            c_.readers_[parity_].fetch_sub(1, std::memory_order_release);
+        }
+
+        generation_guard(const generation_guard&) = delete;
+        generation_guard& operator=(const generation_guard&) = delete;
+
+        T* get() const
+        {
+            return base_;
+        }
+
+    private:
+        const cms& c_;
+        uint64_t parity_;
+        T* base_;
+    };
+
+    static inline T load_cell(const T& c)
+    {
+        return __atomic_load_n(&c, __ATOMIC_RELAXED);
+    }
+
+    static inline void store_cell(T& c, T v)
+    {
+        __atomic_store_n(&c, v, __ATOMIC_RELAXED);
+    }
+
+    static inline T saturating_add(T v, T count)
+    {
+        return v > std::numeric_limits<T>::max() - count ? std::numeric_limits<T>::max() : v + count;
+    }
+
+    // Single writer increment, no read-modify-write instruction needed
+    static inline T add_cell(T& c, T count)
+    {
+        T v = saturating_add(load_cell(c), count);
+        store_cell(c, v);
+        return v;
+    }
+
+    void init_sketch(bool round_w_pow2)
+    {
+        if (round_w_pow2)
+        {
+            w_ = round_up_pow2(w_);
+        }
+        w_pow2_ = w_ > 0 && (w_ & (w_ - 1)) == 0;
+        w_mask_ = w_pow2_ ? w_ - 1 : 0;
+        readers_[0].store(0);
+        readers_[1].store(0);
+        epoch_.store(0);
+        sketch.store(allocate_sketch(d_, w_));
+    }
+
+    // Wait for the operations started in epoch parity `parity` to complete
+    void wait_for_readers(uint64_t parity) const
+    {
+        while (readers_[parity].load(std::memory_order_acquire) != 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    inline uint64_t bucket(uint64_t hash) const
+    {
+        return w_pow2_ ? (hash & w_mask_) : (hash % w_);
+    }
+
+    inline T& cell(T* base, uint64_t row, uint64_t col) const
+    {
+        return base[row * w_ + col];
+    }
+
+    // Invoke `f` on the counter each row maps `digest` to via double hashing
+    template<typename F>
+    inline void for_each_cell(T* base, const cms_digest& digest, F&& f) const
+    {
+        // g_i(x) = h1(x) + i * h2(x), h2 forced odd so that it never degenerates to a single bucket
+        uint64_t h2 = digest.h2 | 1;
+        for (uint64_t row = 0; row < d_; ++row)
+        {
+            f(cell(base, row, bucket(digest.h1 + row * h2)));
+        }
+    }
+
+    // Invoke `f` on the counter each row maps `value` to, according to the hash mode
+    template<typename F>
+    inline void for_each_cell(T* base, std::string_view value, F&& f) const
+    {
+        if (hash_mode_ == cms_hash_mode::DOUBLE_HASHING)
+        {
+            for_each_cell(base, get_digest(value), std::forward<F>(f));
+            return;
+        }
+        for (uint64_t seed = 0; seed < d_; ++seed)
+        {
+            // Map the hash value to an index of the current sketch Row by taking the modulo of the hash value, where w is the number of buckets.
+            // Simply loop over d, which is the number of hash functions, to obtain a seed in order to use independent hash functions for each Row.
+            f(cell(base, seed, bucket(hash_XXH3_seed(value, seed))));
+        }
+    }
+
+    // Raise all cells of `value` to at least min + count, return the new estimate
+    template<typename V>
+    inline T update_conservative_(const V& value, T count) const
+    {
+        generation_guard g(*this);
+        T* inline_cells[CMS_CONSERVATIVE_INLINE_ROWS];
+        std::vector<T*> heap_cells;
+        T** cells = inline_cells;
+        if (d_ > CMS_CONSERVATIVE_INLINE_ROWS)
+        {
+            heap_cells.resize(d_);
+            cells = heap_cells.data();
+        }
+        // Single hashing pass, the cells are remembered for the second pass
+        uint64_t n = 0;
+        T min_estimate = std::numeric_limits<T>::max();
+        for_each_cell(g.get(), value, [cells, &n, &min_estimate](T& c)
+            {
+                cells[n++] = &c;
+                min_estimate = std::min(min_estimate, load_cell(c));
+            });
+        if (n == 0)
+        {
+            return T();
+        }
+        T target = saturating_add(min_estimate, count);
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            if (load_cell(*cells[i]) < target)
+            {
+                store_cell(*cells[i], target);
+            }
+        }
+        return target;
+    }
+
+    template<typename V>
+    inline void update_(const V& value, T count) const
+    {
+        if (conservative_)
+        {
+            update_conservative_(value, count);
+            return;
+        }
+        generation_guard g(*this);
+        for_each_cell(g.get(), value, [count](T& c) { add_cell(c, count); });
+    }
+
+    template<typename V>
+    inline T update_estimate_(const V& value, T count) const
+    {
+        if (conservative_)
+        {
+            return update_conservative_(value, count);
+        }
+        generation_guard g(*this);
+        // Track the minimum in a register rather than collecting all row estimates
+        T min_estimate = std::numeric_limits<T>::max();
+        for_each_cell(g.get(), value, [count, &min_estimate](T& c)
+            {
+                min_estimate = std::min(min_estimate, add_cell(c, count));
+            });
+        return d_ > 0 ? min_estimate : T();
+    }
+
+    template<typename V>
+    inline T estimate_(const V& value) const
+    {
+        generation_guard g(*this);
+        T min_estimate = std::numeric_limits<T>::max();
+        for_each_cell(g.get(), value, [&min_estimate](const T& c) { min_estimate = std::min(min_estimate, load_cell(c)); });
+        return d_ > 0 ? min_estimate : T();
+    }
 
 public:
     static uint64_t calculate_d_rows_from_gamma(double gamma)
@@ -69,53 +359,113 @@ public:
         return std::exp(1) / w;
     }
 
-    cms(double gamma, double eps) 
+    // If `round_w_pow2` is set, w is rounded up to the next power of two (lowering eps),
+    // which turns the per-row modulo into a bit mask
+    cms(double gamma, double eps, bool round_w_pow2 = false, cms_hash_mode hash_mode = cms_hash_mode::SEEDED, bool conservative_update = false) 
     {
+        hash_mode_ = hash_mode;
+        conservative_ = conservative_update;
         d_ = calculate_d_rows_from_gamma(gamma); // -> determine Rows / number of hash functions
         w_ = calculate_w_cols_buckets_from_eps(eps); // -> determine Cols / number of buckets
+        init_sketch(round_w_pow2);
         gamma_ = gamma;
-        eps_ = eps;
-        sketch = std::make_unique<std::unique_ptr<T[]>[]>(d_);
-        for (uint64_t i = 0; i < d_; ++i) 
-        {
-            sketch[i] = std::make_unique<T[]>(w_);
-            std::fill(sketch[i].get(), sketch[i].get() + w_, static_cast<T>(0)); // Init to 0
-        }
+        eps_ = round_w_pow2 ? calculate_eps_cols_buckets_from_w(w_) : eps;
     }
 
     // Overloaded constructor
-    cms(uint64_t d, uint64_t w)
+    cms(uint64_t d, uint64_t w, bool round_w_pow2 = false, cms_hash_mode hash_mode = cms_hash_mode::SEEDED, bool conservative_update = false)
     {
+        hash_mode_ = hash_mode;
+        conservative_ = conservative_update;
         d_ = d;
         w_ = w;
-        gamma_ = calculate_gamma_rows_from_d(d); // -> reverse calculate error probability from Rows / number of hash functions 
-        eps_ = calculate_eps_cols_buckets_from_w(w); // -> reverse calculate relative error from Cols / number of buckets
-        sketch = std::make_unique<std::unique_ptr<T[]>[]>(d_);
-        for (uint64_t i = 0; i < d_; ++i) 
+        init_sketch(round_w_pow2);
+        gamma_ = calculate_gamma_rows_from_d(d_); // -> reverse calculate error probability from Rows / number of hash functions 
+        eps_ = calculate_eps_cols_buckets_from_w(w_); // -> reverse calculate relative error from Cols / number of buckets
+    }
+
+    void reset()
+    {
+        // Reset data structure by swapping in a zeroed generation, the hot path keeps running meanwhile
+        std::lock_guard<std::mutex> lock(reset_mutex_);
+        if (storage_)
         {
-            sketch[i] = std::make_unique<T[]>(w_);
-            std::fill(sketch[i].get(), sketch[i].get() + w_, static_cast<T>(0)); // Init to 0
+            // The other slot was retired by the previous reset, readers of other processes tell it is being
+            // reused from the generation number, see `use_storage`
+            uint64_t generation = __atomic_load_n(storage_generation_, __ATOMIC_RELAXED) + 1;
+            T* fresh = slots_[generation & 1];
+            __atomic_store_n(storage_reset_generation_, generation, __ATOMIC_RELAXED);
+            std::atomic_thread_fence(std::memory_order_release);
+            std::fill(fresh, fresh + d_ * w_, static_cast<T>(0));
+            sketch.exchange(fresh);
+            __atomic_store_n(storage_generation_, generation, __ATOMIC_RELEASE);
+            wait_for_readers(epoch_.fetch_add(1) & 1);
+            return;
         }
+        T* fresh = allocate_sketch(d_, w_);
+        T* old = sketch.exchange(fresh);
+        // Operations starting from now on are counted in the other parity. An operation that could
+        // have loaded `old` incremented the old parity counter and saw the epoch unchanged before its
+        // pointer load, so waiting for that counter to drain is sufficient before retiring `old`.
+        wait_for_readers(epoch_.fetch_add(1) & 1);
+        free_sketch(old);
     }
 
-    void reset()
+    // Back the sketch with the caller's memory, e.g. a shared memory region other processes read from:
+    // two generations of d x w counters and the generation number, `slots[generation & 1]` being the current one.
+    // The current counters are moved over and `reset()` then alternates between both slots instead of allocating:
+    // it announces g + 1 in `reset_generation`, zeroes the slot of g + 1 (the one of g - 1) and publishes g + 1
+    // in `generation`. Counters read from the slot of generation g are hence consistent if `reset_generation`,
+    // loaded after an acquire fence, is still at most g + 1 afterwards.
+    // `owner` keeps the memory alive. Not thread safe, meant to be called right after construction.
+    void use_storage(std::shared_ptr<void> owner, T* slot0, T* slot1, uint64_t* generation, uint64_t* reset_generation)
     {
-        // Reset data structure
-        for (uint64_t i = 0; i < d_; ++i) 
+        std::lock_guard<std::mutex> lock(reset_mutex_);
+        uint64_t g = __atomic_load_n(generation, __ATOMIC_RELAXED);
+        T* current = g & 1 ? slot1 : slot0;
+        T* other = g & 1 ? slot0 : slot1;
+        copy_counters(current);
+        std::fill(other, other + d_ * w_, static_cast<T>(0));
+        T* old = sketch.exchange(current);
+        if (!storage_)
         {
-            std::fill(sketch[i].get(), sketch[i].get() + w_, static_cast<T>(0));
+            free_sketch(old);
         }
+        slots_[0] = slot0;
+        slots_[1] = slot1;
+        storage_generation_ = generation;
+        storage_reset_generation_ = reset_generation;
+        storage_ = std::move(owner);
     }
 
-    uint64_t hash_XXH3_seed(std::string value, uint64_t seed) const
+    // True if backed by external storage, see `use_storage`
+    bool has_storage() const
+    {
+        return storage_ != nullptr;
+    }
+
+    uint64_t hash_XXH3_seed(std::string_view value, uint64_t seed) const
     {
         // using https://raw.githubusercontent.com/Cyan4973/xxHash/v0.8.2/xxhash.h
         // Requirement: Need fast and reliable independent hash functions.
-        uint64_t hash = XXH3_64bits_withSeed(value.c_str(), value.size(), seed);
+        uint64_t hash = XXH3_64bits_withSeed(value.data(), value.size(), seed);
         return hash;
     }
 
-    void update(std::string value, T count)
+    XXH128_hash_t hash_XXH3_128(std::string_view value) const
+    {
+        // Single 128-bit digest from which all d row indices are derived in `DOUBLE_HASHING` mode
+        return XXH3_128bits(value.data(), value.size());
+    }
+
+    // Compute the digest of a value once, to be passed to the pre-hashed overloads below
+    static cms_digest get_digest(std::string_view value)
+    {
+        XXH128_hash_t hash = XXH3_128bits(value.data(), value.size());
+        return cms_digest{hash.low64, hash.high64};
+    }
+
+    void update(std::string_view value, T count)
     {
         if (value.empty())
         {
@@ -123,62 +473,162 @@ public:
         }
         // Update counts for each hash function.
         // Note: d is typically very small (e.g. < 10)
-        for (uint64_t seed = 0; seed < d_; ++seed)
-        {
-            // Map the hash value to an index of the current sketch Row by taking the modulo of the hash value, where w is the number of buckets.
-            // Simply loop over d, which is the number of hash functions, to obtain a seed in order to use independent hash functions for each Row.
-            sketch[seed][hash_XXH3_seed(value, seed) % w_] += count;
-        }
+        update_(value, count);
     }
 
-    T update_estimate(std::string value, T count) const
+    // Pre-hashed overload, only valid in `DOUBLE_HASHING` mode as the digest cannot
+    // stand in for the d independent hashes of the `SEEDED` mode
+    void update(const cms_digest& digest, T count)
+    {
+        assert(hash_mode_ == cms_hash_mode::DOUBLE_HASHING);
+        update_(digest, count);
+    }
+
+    T update_estimate(std::string_view value, T count) const
     {
         if (value.empty())
         {
             return T();
         }
-        std::vector<T> estimates;
         // Same as the update function, but also returns the minimum count as an estimate.
         // Note: d is typically very small (e.g. < 10)
-        for (uint64_t seed = 0; seed < d_; ++seed)
-        {
-            uint64_t index = hash_XXH3_seed(value, seed) % w_;
-            sketch[seed][index] += count;
-            estimates.push_back(sketch[seed][index]);
-        }
-        auto min_element = std::min_element(estimates.begin(), estimates.end());
-        return min_element != estimates.end() ? *min_element : T();
+        return update_estimate_(value, count);
     }
 
-    T estimate(std::string value) const
+    // Pre-hashed overload, only valid in `DOUBLE_HASHING` mode
+    T update_estimate(const cms_digest& digest, T count) const
+    {
+        assert(hash_mode_ == cms_hash_mode::DOUBLE_HASHING);
+        return update_estimate_(digest, count);
+    }
+
+    T estimate(std::string_view value) const
     {
         if (value.empty())
         {
             return T();
         }
-        std::vector<T> estimates;
         // Return the minimum count across hash functions as an estimate.
         // Note: d is typically very small (e.g. < 10)
-        for (uint64_t seed = 0; seed < d_; ++seed)
+        return estimate_(value);
+    }
+
+    // Pre-hashed overload, only valid in `DOUBLE_HASHING` mode
+    T estimate(const cms_digest& digest) const
+    {
+        assert(hash_mode_ == cms_hash_mode::DOUBLE_HASHING);
+        return estimate_(digest);
+    }
+
+    // Hint the cache lines `digest` maps to. Probing several sketches for the same event after
+    // prefetching all of them overlaps their cache misses instead of paying them one after the other.
+    void prefetch(const cms_digest& digest) const
+    {
+        assert(hash_mode_ == cms_hash_mode::DOUBLE_HASHING);
+        // No generation pin: a prefetch never faults, at worst it warms a generation being retired
+        for_each_cell(sketch.load(std::memory_order_relaxed), digest, [](const T& c) { __builtin_prefetch(&c, 0, 1); });
+    }
+
+    // Offsets (row * w + col) of the d counters `digest` maps to, in row order. Only valid in `DOUBLE_HASHING` mode.
+    void get_cell_offsets(const cms_digest& digest, uint64_t* offsets) const
+    {
+        assert(hash_mode_ == cms_hash_mode::DOUBLE_HASHING);
+        uint64_t h2 = digest.h2 | 1;
+        for (uint64_t row = 0; row < d_; ++row)
         {
-            uint64_t index = hash_XXH3_seed(value, seed) % w_;
-            estimates.push_back(sketch[seed][index]);
+            offsets[row] = row * w_ + bucket(digest.h1 + row * h2);
+        }
+    }
+
+    // Add the n {offset, count} `cells` to the counters, saturating, within a single generation. Applying a batch
+    // of updates sorted by offset walks the counters in memory order. Only the plain updates decompose into
+    // independent cells, not the conservative ones. Subject to the single writer rule like updates.
+    void add_cells(const std::pair<uint64_t, uint64_t>* cells, size_t n)
+    {
+        assert(!conservative_);
+        generation_guard g(*this);
+        T* base = g.get();
+        for (size_t i = 0; i < n; ++i)
+        {
+            add_cell(base[cells[i].first], (T)std::min<uint64_t>(cells[i].second, std::numeric_limits<T>::max()));
         }
-        auto min_element = std::min_element(estimates.begin(), estimates.end());
-        return min_element != estimates.end() ? *min_element : T();
     }
 
     T get_item(uint64_t row, uint64_t col) const
     {
         if (row >= 0 && row < d_ && col >= 0 && col < w_) 
         {
-            return sketch[row][col];
+            generation_guard g(*this);
+            return load_cell(cell(g.get(), row, col));
         } else
         {
             return T();
         }
     }
 
+    // Copy the d x w counters (row-major) of the current generation into `dst`
+    void copy_counters(T* dst) const
+    {
+        generation_guard g(*this);
+        for (uint64_t i = 0; i < d_ * w_; ++i)
+        {
+            dst[i] = load_cell(g.get()[i]);
+        }
+    }
+
+    // Overwrite the counters of the current generation with the d x w counters (row-major) in `src`,
+    // subject to the single writer rule like updates
+    void load_counters(const T* src)
+    {
+        generation_guard g(*this);
+        for (uint64_t i = 0; i < d_ * w_; ++i)
+        {
+            store_cell(g.get()[i], src[i]);
+        }
+    }
+
+    // Add the d x w counters (row-major) in `src` to the counters of the current generation, saturating.
+    // Subject to the single writer rule like updates.
+    void merge_counters(const T* src)
+    {
+        generation_guard g(*this);
+        for (uint64_t i = 0; i < d_ * w_; ++i)
+        {
+            store_cell(g.get()[i], saturating_add(load_cell(g.get()[i]), src[i]));
+        }
+    }
+
+    // Count min sketches are linear: adding the counters of a sketch of identical dimensions and hash
+    // mode yields the sketch of both streams combined, e.g. to build a cluster wide baseline out of
+    // per node sketches. The overestimation guarantee holds for conservative update sketches as well.
+    bool merge(const cms& other)
+    {
+        if (&other == this || other.d_ != d_ || other.w_ != w_ || other.hash_mode_ != hash_mode_)
+        {
+            return false;
+        }
+        generation_guard g(*this);
+        generation_guard o(other);
+        for (uint64_t i = 0; i < d_ * w_; ++i)
+        {
+            store_cell(g.get()[i], saturating_add(load_cell(g.get()[i]), load_cell(o.get()[i])));
+        }
+        return true;
+    }
+
+    // Fraction of non-zero counters, O(d x w) hence meant for metrics, not for the hot path.
+    // Estimates degrade as the ratio approaches 1 and most cells are shared by colliding values.
+    double get_fill_ratio() const
+    {
+        generation_guard g(*this);
+        uint64_t n = 0;
+        for (uint64_t i = 0; i < d_ * w_; ++i)
+        {
+            n += load_cell(g.get()[i]) != T() ? 1 : 0;
+        }
+        return d_ * w_ > 0 ? (double)n / (double)(d_ * w_) : 0.0;
+    }
+
     size_t get_size_bytes() const 
     {
         return d_ * w_ * sizeof(T);
@@ -194,6 +644,12 @@ public:
         return std::make_pair(d_, w_);
     }
 
+    // Number of `reset()` calls so far, e.g. to tell whether counts added earlier are still part of the sketch
+    uint64_t get_n_resets() const
+    {
+        return epoch_.load();
+    }
+
     // Return Rows / number of hash functions 
     uint64_t get_d() const
     {
@@ -218,10 +674,103 @@ public:
         return eps_;
     }
 
-    cms(cms&&) noexcept = default;
-    cms(const cms&) = default;
-    cms& operator=(cms&&) noexcept = default;
-    cms& operator=(const cms&) = default;
+    // Return true if w is a power of two and buckets are selected via a bit mask
+    bool is_w_pow2() const
+    {
+        return w_pow2_;
+    }
+
+    // Return how row indices are derived from a value
+    cms_hash_mode get_hash_mode() const
+    {
+        return hash_mode_;
+    }
+
+    // Return true if updates only raise the minimum cells
+    bool is_conservative_update() const
+    {
+        return conservative_;
+    }
+
+    ~cms()
+    {
+        if (!storage_)
+        {
+            free_sketch(sketch.load());
+        }
+    }
+
+    // Copies take a snapshot of the current generation of `other`
+    cms(const cms& other) :
+        sketch(allocate_sketch(other.d_, other.w_)), readers_{{0}, {0}}, epoch_(0),
+        d_(other.d_), w_(other.w_), w_mask_(other.w_mask_), w_pow2_(other.w_pow2_), hash_mode_(other.hash_mode_),
+        conservative_(other.conservative_), gamma_(other.gamma_), eps_(other.eps_)
+    {
+        generation_guard g(other);
+        T* dst = sketch.load();
+        for (uint64_t i = 0; i < d_ * w_; ++i)
+        {
+            dst[i] = load_cell(g.get()[i]);
+        }
+    }
+
+    // Moves are not thread safe, `other` must not be in use concurrently
+    cms(cms&& other) noexcept :
+        sketch(other.sketch.exchange(nullptr)), readers_{{0}, {0}}, epoch_(0),
+        d_(other.d_), w_(other.w_), w_mask_(other.w_mask_), w_pow2_(other.w_pow2_), hash_mode_(other.hash_mode_),
+        conservative_(other.conservative_), gamma_(other.gamma_), eps_(other.eps_),
+        slots_{other.slots_[0], other.slots_[1]}, storage_generation_(other.storage_generation_),
+        storage_reset_generation_(other.storage_reset_generation_), storage_(std::move(other.storage_))
+    {
+        other.d_ = 0;
+        other.w_ = 0;
+        other.slots_[0] = nullptr;
+        other.slots_[1] = nullptr;
+        other.storage_generation_ = nullptr;
+        other.storage_reset_generation_ = nullptr;
+    }
+
+    cms& operator=(cms&& other) noexcept
+    {
+        if (this != &other)
+        {
+            T* old = sketch.exchange(other.sketch.exchange(nullptr));
+            if (!storage_)
+            {
+                free_sketch(old);
+            }
+            slots_[0] = other.slots_[0];
+            slots_[1] = other.slots_[1];
+            storage_generation_ = other.storage_generation_;
+            storage_reset_generation_ = other.storage_reset_generation_;
+            storage_ = std::move(other.storage_);
+            other.slots_[0] = nullptr;
+            other.slots_[1] = nullptr;
+            other.storage_generation_ = nullptr;
+            other.storage_reset_generation_ = nullptr;
+            d_ = other.d_;
+            w_ = other.w_;
+            w_mask_ = other.w_mask_;
+            w_pow2_ = other.w_pow2_;
+            hash_mode_ = other.hash_mode_;
+            conservative_ = other.conservative_;
+            gamma_ = other.gamma_;
+            eps_ = other.eps_;
+            other.d_ = 0;
+            other.w_ = 0;
+        }
+        return *this;
+    }
+
+    cms& operator=(const cms& other)
+    {
+        if (this != &other)
+        {
+            cms tmp(other);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
     cms() = delete;
 };
 
@@ -0,0 +1,315 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "cms.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace plugin::anomalydetection::num
+{
+
+#define CMS_SHARED_MAGIC "FALCOSHM"
+#define CMS_SHARED_VERSION 1
+
+/*
+Live sketch counters in a memory-mapped file (e.g. under /dev/shm), shared with read-only tooling:
+
+    [cms_shared_header][slot 0: d x w counters][slot 1: d x w counters]
+
+All fields and counters are in native byte order, both slots start at a cache line aligned offset
+and are `slot_bytes` apart. The counters of generation g are in slot g & 1, row-major. A value maps
+to one counter per row according to `hash_mode`:
+
+    0 (seeded):         col(row) = XXH3_64bits_withSeed(value, seed = row) % w
+    1 (double hashing): h = XXH3_128bits(value), col(row) = (h.low64 + row * (h.high64 | 1)) % w
+
+and its estimate is the minimum of these d counters. A sketch reset to generation g + 1 first stores
+g + 1 in `reset_generation`, then zeroes slot (g + 1) & 1 and finally publishes g + 1 in `generation`.
+Readers load `generation` (acquire) as g, read the counters of its slot, issue an acquire fence, load
+`reset_generation` and retry if it is past g + 1. The writer replaces the file (rename) when the plugin
+is (re)initialized, readers reopen it once `writer_pid` is gone or the file changed.
+*/
+struct cms_shared_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t counter_bytes; // 2, 4 or 8, unsigned
+    uint64_t d;
+    uint64_t w;
+    uint64_t definition_hash; // See `cms_snapshot_header`
+    uint64_t generation; // Written by the plugin only, use atomic loads
+    uint64_t reset_generation; // Ditto, generation being zeroed, at most `generation` + 1
+    uint32_t writer_pid;
+    uint8_t hash_mode; // `cms_hash_mode`
+    uint8_t conservative_update;
+    uint8_t reserved[2];
+    uint64_t slot_bytes;
+};
+
+class cms_shared
+{
+private:
+    // Keeps the region mapped for as long as the sketch uses it
+    struct mapping
+    {
+        void* addr;
+        size_t size;
+
+        ~mapping()
+        {
+            ::munmap(addr, size);
+        }
+    };
+
+public:
+    static size_t counters_offset()
+    {
+        return ((sizeof(cms_shared_header) + CMS_CACHE_LINE_SIZE - 1) / CMS_CACHE_LINE_SIZE) * CMS_CACHE_LINE_SIZE;
+    }
+
+    template<typename T>
+    static size_t slot_bytes(uint64_t d, uint64_t w)
+    {
+        return ((cms<T>::get_size_bytes(d, w) + CMS_CACHE_LINE_SIZE - 1) / CMS_CACHE_LINE_SIZE) * CMS_CACHE_LINE_SIZE;
+    }
+
+    // Create the shared region of `sketch` at `path`, replacing any previous one, and move the sketch
+    // counters into it. Updates then go straight to the shared memory, at no extra cost for the hot path.
+    template<typename T>
+    static bool attach(const std::string& path, cms<T>& sketch, uint64_t definition_hash, std::string& err)
+    {
+        size_t slot = slot_bytes<T>(sketch.get_d(), sketch.get_w());
+        size_t total = counters_offset() + 2 * slot;
+        std::string tmp = path + ".tmp";
+        int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            err = "cannot open shared sketch file " + tmp;
+            return false;
+        }
+        if (::ftruncate(fd, total) != 0)
+        {
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            err = "cannot resize shared sketch file " + tmp;
+            return false;
+        }
+        void* p = ::mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            ::unlink(tmp.c_str());
+            err = "cannot mmap shared sketch file " + tmp;
+            return false;
+        }
+        std::shared_ptr<mapping> region(new mapping{p, total});
+        auto* header = static_cast<cms_shared_header*>(p);
+        std::memset(header, 0, sizeof(*header));
+        std::memcpy(header->magic, CMS_SHARED_MAGIC, sizeof(header->magic));
+        header->version = CMS_SHARED_VERSION;
+        header->counter_bytes = sizeof(T);
+        header->d = sketch.get_d();
+        header->w = sketch.get_w();
+        header->definition_hash = definition_hash;
+        header->writer_pid = (uint32_t)::getpid();
+        header->hash_mode = static_cast<uint8_t>(sketch.get_hash_mode());
+        header->conservative_update = sketch.is_conservative_update() ? 1 : 0;
+        header->slot_bytes = slot;
+        auto* base = static_cast<uint8_t*>(p) + counters_offset();
+        sketch.use_storage(region, reinterpret_cast<T*>(base), reinterpret_cast<T*>(base + slot), &header->generation, &header->reset_generation);
+        if (std::rename(tmp.c_str(), path.c_str()) != 0)
+        {
+            // The sketch keeps the region, only other processes cannot find it
+            ::unlink(tmp.c_str());
+            err = "cannot publish shared sketch file " + path;
+            return false;
+        }
+        return true;
+    }
+};
+
+/*
+Read-only view of a shared sketch, see `cms_shared_header`, for tooling running next to the plugin.
+Reading never blocks nor slows down the plugin. T must match `counter_bytes`.
+*/
+template<typename T>
+class cms_shared_reader
+{
+public:
+    cms_shared_reader() = default;
+    cms_shared_reader(const cms_shared_reader&) = delete;
+    cms_shared_reader& operator=(const cms_shared_reader&) = delete;
+
+    ~cms_shared_reader()
+    {
+        close();
+    }
+
+    bool open(const std::string& path, std::string& err)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            err = "no shared sketch file " + path;
+            return false;
+        }
+        struct stat st = {};
+        if (::fstat(fd, &st) != 0 || (size_t)st.st_size < cms_shared::counters_offset())
+        {
+            ::close(fd);
+            err = "invalid shared sketch file " + path;
+            return false;
+        }
+        size_ = st.st_size;
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            err = "cannot mmap shared sketch file " + path;
+            return false;
+        }
+        base_ = static_cast<const uint8_t*>(p);
+        const auto* h = header();
+        if (std::memcmp(h->magic, CMS_SHARED_MAGIC, sizeof(h->magic)) != 0 || h->version != CMS_SHARED_VERSION ||
+            h->counter_bytes != sizeof(T) || h->w == 0 || h->slot_bytes < cms<T>::get_size_bytes(h->d, h->w) ||
+            size_ < cms_shared::counters_offset() + 2 * h->slot_bytes)
+        {
+            close();
+            err = "unknown shared sketch format in " + path;
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (base_ != nullptr)
+        {
+            ::munmap(const_cast<uint8_t*>(base_), size_);
+            base_ = nullptr;
+        }
+    }
+
+    const cms_shared_header* header() const
+    {
+        return reinterpret_cast<const cms_shared_header*>(base_);
+    }
+
+    uint64_t get_generation() const
+    {
+        return __atomic_load_n(&header()->generation, __ATOMIC_ACQUIRE);
+    }
+
+    T estimate(std::string_view value) const
+    {
+        const auto* h = header();
+        if (value.empty() || h->d == 0)
+        {
+            return T();
+        }
+        T min_estimate;
+        read_consistent([&](const T* counters)
+            {
+                min_estimate = std::numeric_limits<T>::max();
+                if (h->hash_mode == static_cast<uint8_t>(cms_hash_mode::DOUBLE_HASHING))
+                {
+                    XXH128_hash_t hash = XXH3_128bits(value.data(), value.size());
+                    uint64_t h2 = hash.high64 | 1;
+                    for (uint64_t row = 0; row < h->d; ++row)
+                    {
+                        min_estimate = std::min(min_estimate, load(counters[row * h->w + (hash.low64 + row * h2) % h->w]));
+                    }
+                    return;
+                }
+                for (uint64_t row = 0; row < h->d; ++row)
+                {
+                    uint64_t hash = XXH3_64bits_withSeed(value.data(), value.size(), row);
+                    min_estimate = std::min(min_estimate, load(counters[row * h->w + hash % h->w]));
+                }
+            });
+        return min_estimate;
+    }
+
+    // Fraction of non-zero counters, see `cms::get_fill_ratio`
+    double get_fill_ratio() const
+    {
+        const auto* h = header();
+        uint64_t n = 0;
+        read_consistent([&](const T* counters)
+            {
+                n = 0;
+                for (uint64_t i = 0; i < h->d * h->w; ++i)
+                {
+                    n += load(counters[i]) != T() ? 1 : 0;
+                }
+            });
+        return h->d * h->w > 0 ? (double)n / (double)(h->d * h->w) : 0.0;
+    }
+
+    // Copy the d x w counters (row-major) of the current generation into `dst`
+    void copy_counters(T* dst) const
+    {
+        const auto* h = header();
+        read_consistent([&](const T* counters)
+            {
+                for (uint64_t i = 0; i < h->d * h->w; ++i)
+                {
+                    dst[i] = load(counters[i]);
+                }
+            });
+    }
+
+private:
+    static inline T load(const T& c)
+    {
+        return __atomic_load_n(&c, __ATOMIC_RELAXED);
+    }
+
+    // Run `f` on the counters of the current generation until they were not zeroed meanwhile
+    template<typename F>
+    void read_consistent(F&& f) const
+    {
+        uint64_t generation;
+        uint64_t reset_generation;
+        do
+        {
+            generation = get_generation();
+            f(reinterpret_cast<const T*>(base_ + cms_shared::counters_offset() + (generation & 1) * header()->slot_bytes));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            reset_generation = __atomic_load_n(&header()->reset_generation, __ATOMIC_RELAXED);
+        } while (reset_generation > generation + 1);
+    }
+
+    const uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+};
+
+} // namespace plugin::anomalydetection::num
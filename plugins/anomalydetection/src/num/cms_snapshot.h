@@ -0,0 +1,466 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "cms.h"
+#include "sliding_cms.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <cstdio>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace plugin::anomalydetection::num
+{
+
+#define CMS_SNAPSHOT_MAGIC "FALCOCMS"
+#define CMS_SNAPSHOT_VERSION 1
+
+/*
+Versioned binary snapshot of one sketch, written to and read from a memory-mapped file:
+
+    [cms_snapshot_header][bucket 0 counters][bucket 1 counters]...
+
+Each bucket holds d x w counters (row-major) in native byte order, starting at a cache line
+aligned offset. Plain `cms` sketches are stored as a single bucket. A snapshot is only loaded
+into a sketch of identical layout (counter width, d, w, hash mode, buckets) and identical
+`definition_hash`, the hash of the behavior profile definition the counts were collected for.
+*/
+struct cms_snapshot_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t counter_bytes;
+    uint64_t definition_hash;
+    uint64_t d;
+    uint64_t w;
+    uint64_t n_buckets;
+    uint64_t head; // sliding_cms ring position
+    uint64_t head_epoch;
+    uint8_t hash_mode;
+    uint8_t started;
+    uint8_t reserved[6];
+};
+
+// Counts imported into a sketch from a merged cluster wide sketch, see `cms_snapshot::import`.
+// Only part of the sketch as long as the bucket they went to has not been reset since.
+struct cms_snapshot_baseline
+{
+    uint64_t bucket = 0; // sliding_cms bucket, 0 for plain sketches
+    uint64_t n_resets = 0; // `cms::get_n_resets` of the bucket at import time
+    std::vector<uint64_t> counters; // d x w imported counters (row-major), empty if nothing was imported
+};
+
+class cms_snapshot
+{
+private:
+    static size_t counters_offset()
+    {
+        return ((sizeof(cms_snapshot_header) + CMS_CACHE_LINE_SIZE - 1) / CMS_CACHE_LINE_SIZE) * CMS_CACHE_LINE_SIZE;
+    }
+
+    template<typename T>
+    static cms_snapshot_header make_header(const cms<T>& bucket, uint64_t n_buckets, uint64_t definition_hash)
+    {
+        cms_snapshot_header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, CMS_SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = CMS_SNAPSHOT_VERSION;
+        header.counter_bytes = sizeof(T);
+        header.definition_hash = definition_hash;
+        header.d = bucket.get_d();
+        header.w = bucket.get_w();
+        header.n_buckets = n_buckets;
+        header.hash_mode = static_cast<uint8_t>(bucket.get_hash_mode());
+        return header;
+    }
+
+    template<typename T>
+    static const cms<T>& get_bucket(const cms<T>& sketch, uint64_t)
+    {
+        return sketch;
+    }
+
+    template<typename T>
+    static const cms<T>& get_bucket(const sliding_cms<T>& sketch, uint64_t i)
+    {
+        return sketch.get_bucket(i);
+    }
+
+    template<typename T>
+    static uint64_t get_n_buckets(const cms<T>&)
+    {
+        return 1;
+    }
+
+    template<typename T>
+    static uint64_t get_n_buckets(const sliding_cms<T>& sketch)
+    {
+        return sketch.get_n_buckets();
+    }
+
+    // Whether the counts of `baseline` are still part of `sketch`
+    template<typename S>
+    static bool is_current(const S& sketch, const cms_snapshot_baseline& baseline)
+    {
+        if (baseline.counters.empty() || baseline.bucket >= get_n_buckets(sketch))
+        {
+            return false;
+        }
+        const auto& bucket = get_bucket(sketch, baseline.bucket);
+        return baseline.counters.size() == bucket.get_d() * bucket.get_w() && bucket.get_n_resets() == baseline.n_resets;
+    }
+
+    // Write the counters of `sketch` to `dst` and take the counts of `baseline` (if any) off, saturating at 0
+    template<typename T>
+    static void copy_delta(const cms<T>& sketch, const cms_snapshot_baseline* baseline, T* dst)
+    {
+        sketch.copy_counters(dst);
+        if (baseline == nullptr)
+        {
+            return;
+        }
+        for (size_t i = 0; i < baseline->counters.size(); ++i)
+        {
+            dst[i] = dst[i] > baseline->counters[i] ? static_cast<T>(dst[i] - baseline->counters[i]) : T();
+        }
+    }
+
+    template<typename T>
+    static bool import_into(const std::string& path, cms<T>& bucket, uint64_t index, uint64_t definition_hash, cms_snapshot_baseline& baseline, std::string& err)
+    {
+        cms<T> imported(bucket.get_d(), bucket.get_w(), false, bucket.get_hash_mode());
+        if (!merge(path, imported, definition_hash, err))
+        {
+            return false;
+        }
+        std::vector<T> counters(bucket.get_d() * bucket.get_w());
+        imported.copy_counters(counters.data());
+        bucket.merge_counters(counters.data());
+        baseline.bucket = index;
+        baseline.n_resets = bucket.get_n_resets();
+        baseline.counters.assign(counters.begin(), counters.end());
+        return true;
+    }
+
+    // Write `header` followed by the counters of all buckets to `path`, `fill(i, counters)` writes the
+    // d x w counters of bucket i. Data is written to a temporary file first and renamed, a crash never
+    // leaves a torn snapshot behind.
+    template<typename T, typename F>
+    static bool write_file(const std::string& path, const cms_snapshot_header& header, F&& fill, std::string& err)
+    {
+        size_t bucket_bytes = cms<T>::get_size_bytes(header.d, header.w);
+        size_t total = counters_offset() + header.n_buckets * bucket_bytes;
+        std::string tmp = path + ".tmp";
+        int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0)
+        {
+            err = "cannot open snapshot file " + tmp;
+            return false;
+        }
+        if (::ftruncate(fd, total) != 0)
+        {
+            ::close(fd);
+            err = "cannot resize snapshot file " + tmp;
+            return false;
+        }
+        void* p = ::mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            ::close(fd);
+            err = "cannot mmap snapshot file " + tmp;
+            return false;
+        }
+        auto* base = static_cast<uint8_t*>(p);
+        std::memcpy(base, &header, sizeof(header));
+        for (uint64_t i = 0; i < header.n_buckets; ++i)
+        {
+            fill(i, reinterpret_cast<T*>(base + counters_offset() + i * bucket_bytes));
+        }
+        bool ok = ::msync(p, total, MS_SYNC) == 0;
+        ::munmap(p, total);
+        ::close(fd);
+        if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0)
+        {
+            ::unlink(tmp.c_str());
+            err = "cannot persist snapshot file " + path;
+            return false;
+        }
+        return true;
+    }
+
+    // Validate the snapshot at `path` against `expected` and pass the counters of each bucket to
+    // `on_bucket(i, counters)`. Any number of buckets is accepted if `expected.n_buckets` is 0.
+    template<typename T, typename F>
+    static bool read_file(const std::string& path, const cms_snapshot_header& expected, cms_snapshot_header& header, F&& on_bucket, std::string& err)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            err = "no snapshot file " + path;
+            return false;
+        }
+        struct stat st = {};
+        if (::fstat(fd, &st) != 0 || (size_t)st.st_size < counters_offset())
+        {
+            ::close(fd);
+            err = "invalid snapshot file " + path;
+            return false;
+        }
+        size_t total = st.st_size;
+        void* p = ::mmap(nullptr, total, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            err = "cannot mmap snapshot file " + path;
+            return false;
+        }
+        const auto* base = static_cast<const uint8_t*>(p);
+        std::memcpy(&header, base, sizeof(header));
+        size_t bucket_bytes = cms<T>::get_size_bytes(expected.d, expected.w);
+        bool ok = true;
+        if (std::memcmp(header.magic, CMS_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != CMS_SNAPSHOT_VERSION)
+        {
+            err = "unknown snapshot format in " + path;
+            ok = false;
+        } else if (header.definition_hash != expected.definition_hash)
+        {
+            err = "snapshot " + path + " was taken for a different behavior profile definition";
+            ok = false;
+        } else if (header.counter_bytes != expected.counter_bytes || header.d != expected.d || header.w != expected.w ||
+            (expected.n_buckets != 0 && header.n_buckets != expected.n_buckets) || header.hash_mode != expected.hash_mode ||
+            total < counters_offset() + header.n_buckets * bucket_bytes)
+        {
+            err = "snapshot " + path + " does not match the sketch layout";
+            ok = false;
+        }
+        if (ok)
+        {
+            for (uint64_t i = 0; i < header.n_buckets; ++i)
+            {
+                on_bucket(i, reinterpret_cast<const T*>(base + counters_offset() + i * bucket_bytes));
+            }
+        }
+        ::munmap(p, total);
+        return ok;
+    }
+
+public:
+    template<typename T>
+    static bool save(const std::string& path, const cms<T>& sketch, uint64_t definition_hash, std::string& err)
+    {
+        auto header = make_header(sketch, 1, definition_hash);
+        return write_file<T>(path, header, [&sketch](uint64_t, T* c) { sketch.copy_counters(c); }, err);
+    }
+
+    template<typename T>
+    static bool save(const std::string& path, const sliding_cms<T>& sketch, uint64_t definition_hash, std::string& err)
+    {
+        auto header = make_header(sketch.get_bucket(0), sketch.get_n_buckets(), definition_hash);
+        header.head = sketch.get_head();
+        header.head_epoch = sketch.get_head_epoch();
+        header.started = sketch.is_started() ? 1 : 0;
+        return write_file<T>(path, header, [&sketch](uint64_t i, T* c) { sketch.get_bucket(i).copy_counters(c); }, err);
+    }
+
+    template<typename T>
+    static bool load(const std::string& path, cms<T>& sketch, uint64_t definition_hash, std::string& err)
+    {
+        cms_snapshot_header header;
+        auto expected = make_header(sketch, 1, definition_hash);
+        return read_file<T>(path, expected, header, [&sketch](uint64_t, const T* c) { sketch.load_counters(c); }, err);
+    }
+
+    template<typename T>
+    static bool load(const std::string& path, sliding_cms<T>& sketch, uint64_t definition_hash, std::string& err)
+    {
+        cms_snapshot_header header;
+        auto expected = make_header(sketch.get_bucket(0), sketch.get_n_buckets(), definition_hash);
+        if (!read_file<T>(path, expected, header, [&sketch](uint64_t i, const T* c) { sketch.get_bucket(i).load_counters(c); }, err))
+        {
+            return false;
+        }
+        sketch.restore_position(header.head, header.head_epoch, header.started != 0);
+        return true;
+    }
+
+    // Add the counts of the snapshot at `path` to `sketch`, all buckets of a sliding window snapshot
+    // are summed up. Used to import a merged cluster wide sketch, see `merge_files`.
+    template<typename T>
+    static bool merge(const std::string& path, cms<T>& sketch, uint64_t definition_hash, std::string& err)
+    {
+        cms_snapshot_header header;
+        auto expected = make_header(sketch, 0, definition_hash);
+        return read_file<T>(path, expected, header, [&sketch](uint64_t, const T* c) { sketch.merge_counters(c); }, err);
+    }
+
+    // Imported counts go to the head bucket, they age out of the window like local ones
+    template<typename T>
+    static bool merge(const std::string& path, sliding_cms<T>& sketch, uint64_t definition_hash, std::string& err)
+    {
+        cms_snapshot_header header;
+        auto expected = make_header(sketch.get_bucket(0), 0, definition_hash);
+        auto& head = sketch.get_bucket(sketch.get_head());
+        return read_file<T>(path, expected, header, [&head](uint64_t, const T* c) { head.merge_counters(c); }, err);
+    }
+
+    // Like `merge`, and record the imported counts in `baseline` so that `save_delta` can take them off again
+    template<typename T>
+    static bool import(const std::string& path, cms<T>& sketch, uint64_t definition_hash, cms_snapshot_baseline& baseline, std::string& err)
+    {
+        return import_into(path, sketch, 0, definition_hash, baseline, err);
+    }
+
+    template<typename T>
+    static bool import(const std::string& path, sliding_cms<T>& sketch, uint64_t definition_hash, cms_snapshot_baseline& baseline, std::string& err)
+    {
+        auto head = sketch.get_head();
+        return import_into(path, sketch.get_bucket(head), head, definition_hash, baseline, err);
+    }
+
+    // Like `save`, without the imported counts of `baseline` as long as they are part of the sketch: the
+    // export of a node only holds the counts it collected itself, see `merge_files`
+    template<typename T>
+    static bool save_delta(const std::string& path, const cms<T>& sketch, const cms_snapshot_baseline& baseline, uint64_t definition_hash, std::string& err)
+    {
+        auto header = make_header(sketch, 1, definition_hash);
+        const cms_snapshot_baseline* subtract = is_current(sketch, baseline) ? &baseline : nullptr;
+        return write_file<T>(path, header, [&sketch, subtract](uint64_t, T* c) { copy_delta(sketch, subtract, c); }, err);
+    }
+
+    template<typename T>
+    static bool save_delta(const std::string& path, const sliding_cms<T>& sketch, const cms_snapshot_baseline& baseline, uint64_t definition_hash, std::string& err)
+    {
+        auto header = make_header(sketch.get_bucket(0), sketch.get_n_buckets(), definition_hash);
+        header.head = sketch.get_head();
+        header.head_epoch = sketch.get_head_epoch();
+        header.started = sketch.is_started() ? 1 : 0;
+        const cms_snapshot_baseline* subtract = is_current(sketch, baseline) ? &baseline : nullptr;
+        return write_file<T>(path, header, [&sketch, subtract](uint64_t i, T* c)
+            {
+                copy_delta(sketch.get_bucket(i), subtract != nullptr && subtract->bucket == i ? subtract : nullptr, c);
+            }, err);
+    }
+
+    // Persist `baseline` next to the snapshot of `sketch` so that the imported counts are still known after a
+    // warm start, the file is removed once they are no longer part of the sketch
+    template<typename S>
+    static bool save_baseline(const std::string& path, const S& sketch, const cms_snapshot_baseline& baseline, uint64_t definition_hash, std::string& err)
+    {
+        using T = typename S::value_type;
+        if (!is_current(sketch, baseline))
+        {
+            ::unlink(path.c_str());
+            return true;
+        }
+        auto header = make_header(get_bucket(sketch, 0), 1, definition_hash);
+        header.head = baseline.bucket;
+        return write_file<T>(path, header, [&baseline](uint64_t, T* c)
+            {
+                for (size_t i = 0; i < baseline.counters.size(); ++i)
+                {
+                    c[i] = static_cast<T>(baseline.counters[i]);
+                }
+            }, err);
+    }
+
+    // Restore the baseline saved by `save_baseline`, right after `load` restored the sketch itself
+    template<typename S>
+    static bool load_baseline(const std::string& path, const S& sketch, uint64_t definition_hash, cms_snapshot_baseline& baseline, std::string& err)
+    {
+        using T = typename S::value_type;
+        cms_snapshot_header header;
+        const auto& first = get_bucket(sketch, 0);
+        auto expected = make_header(first, 1, definition_hash);
+        std::vector<uint64_t> counters;
+        size_t n = first.get_d() * first.get_w();
+        if (!read_file<T>(path, expected, header, [&counters, n](uint64_t, const T* c) { counters.assign(c, c + n); }, err))
+        {
+            return false;
+        }
+        if (header.head >= get_n_buckets(sketch))
+        {
+            err = "snapshot " + path + " does not match the sketch layout";
+            return false;
+        }
+        baseline.bucket = header.head;
+        baseline.n_resets = get_bucket(sketch, header.head).get_n_resets();
+        baseline.counters = std::move(counters);
+        return true;
+    }
+
+    // Read the header of the snapshot at `path`, e.g. to find out the counter width before merging
+    static bool read_header(const std::string& path, cms_snapshot_header& header, std::string& err)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            err = "no snapshot file " + path;
+            return false;
+        }
+        bool ok = ::read(fd, &header, sizeof(header)) == (ssize_t)sizeof(header) &&
+            std::memcmp(header.magic, CMS_SNAPSHOT_MAGIC, sizeof(header.magic)) == 0 && header.version == CMS_SNAPSHOT_VERSION;
+        ::close(fd);
+        if (!ok)
+        {
+            err = "invalid snapshot file " + path;
+        }
+        return ok;
+    }
+
+    // Merge the snapshots `inputs` (e.g. the latest export of each node of a cluster, see `save_delta`) into a
+    // single plain sketch snapshot at `output`. All inputs must share the layout and the definition hash of the
+    // first one. Meant for an aggregator outside of the plugin, the plugin itself never merges exports.
+    template<typename T>
+    static bool merge_files(const std::vector<std::string>& inputs, const std::string& output, std::string& err)
+    {
+        if (inputs.empty())
+        {
+            err = "no snapshot to merge";
+            return false;
+        }
+        cms_snapshot_header header;
+        if (!read_header(inputs[0], header, err))
+        {
+            return false;
+        }
+        if (header.counter_bytes != sizeof(T))
+        {
+            err = "snapshot " + inputs[0] + " counter width does not match";
+            return false;
+        }
+        cms<T> merged(header.d, header.w, false, static_cast<cms_hash_mode>(header.hash_mode));
+        for (const auto& input : inputs)
+        {
+            if (!merge(input, merged, header.definition_hash, err))
+            {
+                return false;
+            }
+        }
+        return save(output, merged, header.definition_hash, err);
+    }
+};
+
+} // namespace plugin::anomalydetection::num
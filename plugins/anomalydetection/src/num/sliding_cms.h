@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "cms.h"
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <string_view>
+#include <limits>
+#include <type_traits>
+#include <atomic>
+
+namespace plugin::anomalydetection::num
+{
+
+/*
+Sliding window CountMinSketch: a ring of `n_buckets` time-bucketed sub-sketches of identical
+dimensions, each covering `window_ns / n_buckets` ns. Updates go to the head bucket, estimates
+are the sum of the per-bucket estimates, and buckets that fall out of the window are cleared
+lazily when time advances. Estimates therefore answer "count in the last window", covering at
+least (n_buckets - 1) and at most n_buckets bucket durations, without wiping the whole history
+at once like a periodic reset does.
+
+Time is driven by the caller via `advance()` (e.g. with event timestamps). The ring position is
+only mutated by `advance()`, which must be called from the single writer thread, see `cms`.
+*/
+template<typename T>
+class sliding_cms
+{
+public:
+    using value_type = T;
+
+private:
+    std::vector<std::unique_ptr<cms<T>>> buckets_;
+    uint64_t bucket_ns_; // Duration covered by one bucket
+    // Ring position, only written by the event thread but may be read concurrently (e.g. snapshots)
+    std::atomic<uint64_t> head_epoch_{0}; // `ts / bucket_ns_` of the head bucket
+    std::atomic<size_t> head_{0}; // Index of the bucket currently receiving updates
+    std::atomic<bool> started_{false};
+
+    // Narrow counter types saturate, so does the window sum
+    static inline T saturating_add(T v, T count)
+    {
+        return v > std::numeric_limits<T>::max() - count ? std::numeric_limits<T>::max() : v + count;
+    }
+
+public:
+    sliding_cms(double gamma, double eps, uint64_t n_buckets, uint64_t window_ns, bool round_w_pow2 = false, cms_hash_mode hash_mode = cms_hash_mode::SEEDED, bool conservative_update = false)
+    {
+        n_buckets = n_buckets < 1 ? 1 : n_buckets;
+        bucket_ns_ = window_ns / n_buckets < 1 ? 1 : window_ns / n_buckets;
+        for (uint64_t i = 0; i < n_buckets; ++i)
+        {
+            buckets_.emplace_back(std::make_unique<cms<T>>(gamma, eps, round_w_pow2, hash_mode, conservative_update));
+        }
+    }
+
+    sliding_cms(uint64_t d, uint64_t w, uint64_t n_buckets, uint64_t window_ns, bool round_w_pow2 = false, cms_hash_mode hash_mode = cms_hash_mode::SEEDED, bool conservative_update = false)
+    {
+        n_buckets = n_buckets < 1 ? 1 : n_buckets;
+        bucket_ns_ = window_ns / n_buckets < 1 ? 1 : window_ns / n_buckets;
+        for (uint64_t i = 0; i < n_buckets; ++i)
+        {
+            buckets_.emplace_back(std::make_unique<cms<T>>(d, w, round_w_pow2, hash_mode, conservative_update));
+        }
+    }
+
+    // Move the head to the bucket covering `ts_ns`, clearing each bucket it rotates over.
+    // Timestamps older than the head (e.g. slightly out of order events) are accounted to the head.
+    void advance(uint64_t ts_ns)
+    {
+        uint64_t epoch = ts_ns / bucket_ns_;
+        uint64_t head_epoch = head_epoch_.load(std::memory_order_relaxed);
+        if (!started_.load(std::memory_order_relaxed))
+        {
+            started_.store(true, std::memory_order_relaxed);
+            head_epoch_.store(epoch, std::memory_order_relaxed);
+            return;
+        }
+        if (epoch <= head_epoch)
+        {
+            return;
+        }
+        uint64_t steps = epoch - head_epoch;
+        if (steps > buckets_.size())
+        {
+            steps = buckets_.size();
+        }
+        size_t head = head_.load(std::memory_order_relaxed);
+        for (uint64_t i = 0; i < steps; ++i)
+        {
+            head = (head + 1) % buckets_.size();
+            buckets_[head]->reset();
+        }
+        head_.store(head, std::memory_order_relaxed);
+        head_epoch_.store(epoch, std::memory_order_relaxed);
+    }
+
+    void update(std::string_view value, T count)
+    {
+        buckets_[head_.load(std::memory_order_relaxed)]->update(value, count);
+    }
+
+    void update(const cms_digest& digest, T count)
+    {
+        buckets_[head_.load(std::memory_order_relaxed)]->update(digest, count);
+    }
+
+    // Estimates probe all buckets, see `cms::prefetch`
+    void prefetch(const cms_digest& digest) const
+    {
+        for (const auto& b : buckets_)
+        {
+            b->prefetch(digest);
+        }
+    }
+
+    // Each bucket estimate overestimates the true bucket count, so does their sum for the window
+    T estimate(std::string_view value) const
+    {
+        T sum = T();
+        for (const auto& b : buckets_)
+        {
+            sum = saturating_add(sum, b->estimate(value));
+        }
+        return sum;
+    }
+
+    T estimate(const cms_digest& digest) const
+    {
+        T sum = T();
+        for (const auto& b : buckets_)
+        {
+            sum = saturating_add(sum, b->estimate(digest));
+        }
+        return sum;
+    }
+
+    // Clear all buckets, the ring position is kept
+    void reset()
+    {
+        for (auto& b : buckets_)
+        {
+            b->reset();
+        }
+    }
+
+    uint64_t get_n_buckets() const
+    {
+        return buckets_.size();
+    }
+
+    uint64_t get_bucket_ns() const
+    {
+        return bucket_ns_;
+    }
+
+    cms_hash_mode get_hash_mode() const
+    {
+        return buckets_[0]->get_hash_mode();
+    }
+
+    // Average fill ratio over the buckets, see `cms::get_fill_ratio`
+    double get_fill_ratio() const
+    {
+        double sum = 0.0;
+        for (const auto& b : buckets_)
+        {
+            sum += b->get_fill_ratio();
+        }
+        return sum / buckets_.size();
+    }
+
+    // Total size of all buckets
+    uint64_t get_size_bytes() const
+    {
+        return buckets_.size() * buckets_[0]->get_size_bytes();
+    }
+
+    // Access to the underlying sub-sketches, bucket 0 is not necessarily the oldest
+    const cms<T>& get_bucket(uint64_t i) const
+    {
+        return *buckets_[i];
+    }
+
+    cms<T>& get_bucket(uint64_t i)
+    {
+        return *buckets_[i];
+    }
+
+    // Ring position, e.g. to persist and restore the sketch along with its buckets
+    size_t get_head() const
+    {
+        return head_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t get_head_epoch() const
+    {
+        return head_epoch_.load(std::memory_order_relaxed);
+    }
+
+    bool is_started() const
+    {
+        return started_.load(std::memory_order_relaxed);
+    }
+
+    void restore_position(size_t head, uint64_t head_epoch, bool started)
+    {
+        head_.store(head % buckets_.size(), std::memory_order_relaxed);
+        head_epoch_.store(head_epoch, std::memory_order_relaxed);
+        started_.store(started, std::memory_order_relaxed);
+    }
+};
+
+template<typename S>
+struct is_sliding_cms : std::false_type {};
+
+template<typename T>
+struct is_sliding_cms<sliding_cms<T>> : std::true_type {};
+
+} // namespace plugin::anomalydetection::num
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+
+namespace plugin::anomalydetection::num
+{
+
+/*
+Space-Saving heavy hitters (Metwally et al.): tracks at most `capacity` values with counts.
+A value not yet tracked evicts the value with the minimum count once full and inherits that
+count (+ `count`), which becomes its maximum overestimation (`error`). Any value whose true
+count exceeds N / capacity (N = total count) is guaranteed to be tracked.
+
+Values are indexed by a caller provided 64-bit hash (e.g. the `cms_digest` already computed for
+the sketch update), so updates of tracked values never allocate. Finding the minimum on
+eviction is a linear scan, which is cheap for the small capacities top-K lists are used with.
+Not thread safe, meant to be owned by the event thread.
+*/
+template<typename T>
+class space_saving
+{
+public:
+    struct entry
+    {
+        std::string value;
+        uint64_t hash;
+        T count;
+        T error;
+    };
+
+private:
+    size_t capacity_;
+    std::vector<entry> entries_;
+    std::unordered_map<uint64_t, size_t> index_; // hash -> position in `entries_`
+
+    size_t min_position() const
+    {
+        size_t pos = 0;
+        for (size_t i = 1; i < entries_.size(); ++i)
+        {
+            if (entries_[i].count < entries_[pos].count)
+            {
+                pos = i;
+            }
+        }
+        return pos;
+    }
+
+    static inline T saturating_add(T v, T count)
+    {
+        return v > std::numeric_limits<T>::max() - count ? std::numeric_limits<T>::max() : v + count;
+    }
+
+public:
+    explicit space_saving(size_t capacity) : capacity_(capacity < 1 ? 1 : capacity)
+    {
+        entries_.reserve(capacity_);
+        index_.reserve(capacity_);
+    }
+
+    void update(std::string_view value, uint64_t hash, T count)
+    {
+        auto it = index_.find(hash);
+        if (it != index_.end())
+        {
+            auto& e = entries_[it->second];
+            e.count = saturating_add(e.count, count);
+            return;
+        }
+        if (entries_.size() < capacity_)
+        {
+            index_.emplace(hash, entries_.size());
+            entries_.push_back(entry{std::string(value), hash, count, T()});
+            return;
+        }
+        // Replace the minimum, the new value inherits its count as error bound
+        size_t pos = min_position();
+        auto& e = entries_[pos];
+        index_.erase(e.hash);
+        index_.emplace(hash, pos);
+        e.value.assign(value.data(), value.size());
+        e.hash = hash;
+        e.error = e.count;
+        e.count = saturating_add(e.count, count);
+    }
+
+    // Tracked values sorted by descending count, at most `k` (all if 0)
+    std::vector<entry> top(size_t k = 0) const
+    {
+        std::vector<entry> res(entries_);
+        std::sort(res.begin(), res.end(), [](const entry& a, const entry& b) { return a.count > b.count; });
+        if (k > 0 && res.size() > k)
+        {
+            res.resize(k);
+        }
+        return res;
+    }
+
+    // Count of the weakest tracked value, 0 while not full
+    T min_count() const
+    {
+        return entries_.size() < capacity_ || entries_.empty() ? T() : entries_[min_position()].count;
+    }
+
+    void reset()
+    {
+        entries_.clear();
+        index_.clear();
+    }
+
+    size_t size() const
+    {
+        return entries_.size();
+    }
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+};
+
+} // namespace plugin::anomalydetection::num
@@ -18,8 +18,12 @@ limitations under the License.
 #include "plugin.h"
 
 #include <optional>
-#include <filesystem>
+#include <charconv>
+#include <limits>
+#include <cstring>
+#include <stdexcept>
 #include <sys/stat.h>
+#include <unistd.h>
 
 void anomalydetection::log_error(std::string err_mess)
 {
@@ -104,6 +108,185 @@ falcosecurity::init_schema anomalydetection::get_init_schema()
               "reset_timer_ms": {
                 "type": "number",
                 "description": "The anomaly detection behavior profile timer, in milliseconds (ms), is used to reset the sketch counts."
+              },
+              "window_ms": {
+                "type": "number",
+                "description": "Turns the sketch into a sliding window sketch, in milliseconds (ms): counts only cover the last `window_ms` instead of being periodically reset. Supersedes `reset_timer_ms`."
+              },
+              "window_buckets": {
+                "type": "number",
+                "description": "Number of time buckets (sub-sketches) the sliding window is split into, expired buckets are dropped one at a time. Memory grows linearly with it. Defaults to 6."
+              },
+              "conservative_update": {
+                "type": "boolean",
+                "description": "Only raise the sketch counters holding the current minimum estimate on updates, which sharply reduces overestimation at the same width. Defaults to false."
+              },
+              "counter_type": {
+                "type": "string",
+                "enum": [
+                  "uint16",
+                  "uint32",
+                  "uint64"
+                ],
+                "description": "Width of the sketch counters, counters saturate at the maximum of the type instead of wrapping around. Narrower counters divide the sketch memory accordingly. Defaults to 'uint64'."
+              },
+              "top_k": {
+                "type": "number",
+                "description": "Track the (approximately) `top_k` most frequent behavior profiles of this sketch with the Space-Saving algorithm, exposed via the `anomaly.count_min_sketch.top_k` field. Disabled if not set or 0."
+              },
+              "pow2_cols": {
+                "type": "boolean",
+                "description": "Round the number of sketch cols/buckets up to the next power of two, trading some extra memory for cheaper bucket selection (lowers the relative error eps accordingly). Defaults to false."
+              },
+              "hash_mode": {
+                "type": "string",
+                "enum": [
+                  "seeded",
+                  "double_hashing"
+                ],
+                "description": "How the sketch row indices are derived from the behavior profile string. 'seeded' computes one seeded XXH3 64-bit hash per row, 'double_hashing' computes a single XXH3 128-bit hash and derives all row indices from it. Defaults to 'seeded'."
+              },
+              "per_container": {
+                "type": "boolean",
+                "description": "Count the behavior profiles of each container in a sketch of its own, allocated on the first update of the container, so that a noisy container cannot raise the estimates of the others. Host processes count in the node wide sketch. Sketches of containers gone from the container plugin's table are released. Defaults to false."
+              },
+              "per_container_rows_cols": {
+                "type": "array",
+                "items": {
+                  "type": "number"
+                },
+                "minItems": 2,
+                "maxItems": 2,
+                "description": "Dimensions [rows, cols] of the sketch of each container, usually much smaller than the node wide sketch. Defaults to the dimensions of the node wide sketch."
+              },
+              "per_container_max_bytes": {
+                "type": "number",
+                "description": "Memory budget of the sketches of all containers, the least recently updated containers are evicted past it. Defaults to 16777216 (16 MiB)."
+              },
+              "sample_rate": {
+                "type": "integer",
+                "minimum": 1,
+                "description": "Only update the sketch for 1 out of `sample_rate` events, each sampled event adding `sample_rate` to the counts so that estimates still approximate the count of all events. Sampled out events skip the profile extraction altogether. Defaults to 1 (no sampling)."
+              },
+              "sample_mode": {
+                "type": "string",
+                "enum": [
+                  "fixed",
+                  "random"
+                ],
+                "description": "How the sampled events are selected: 'fixed' takes every `sample_rate`-th event, 'random' takes each event with probability 1 / `sample_rate`, which does not alias with periodic workloads. Defaults to 'fixed'."
+              }
+            },
+            "required": [
+              "fields",
+              "event_codes"
+            ]
+          },
+          "minItems": 1
+        },
+        "snapshot_dir": {
+          "type": "string",
+          "description": "Directory in which the sketches are persisted as memory-mapped snapshot files. Snapshots are reloaded on startup and config reloads if the behavior profile definition is unchanged. Disabled if not set."
+        },
+        "snapshot_interval_ms": {
+          "type": "number",
+          "description": "Interval, in milliseconds (ms), at which the sketches are snapshotted to `snapshot_dir`. Sketches are always snapshotted on shutdown and config reloads. Defaults to 300000 (5 minutes)."
+        },
+        "export_dir": {
+          "type": "string",
+          "description": "Directory to which the sketches are periodically exported as `cms_<index>.<export_node_id>.snap` snapshot files, e.g. a shared volume from which the exports of all nodes are merged into a cluster wide baseline. Disabled if not set."
+        },
+        "export_interval_ms": {
+          "type": "number",
+          "description": "Interval, in milliseconds (ms), at which the sketches are exported to `export_dir`. Defaults to 60000 (1 minute)."
+        },
+        "export_node_id": {
+          "type": "string",
+          "description": "Node identifier used in the export file names. Defaults to the hostname."
+        },
+        "import_dir": {
+          "type": "string",
+          "description": "Directory holding merged `cms_<index>.snap` sketches (e.g. cluster wide baselines). On startup, a sketch that was not warm started from its own snapshot adds the imported counts, if the behavior profile definition matches. Disabled if not set."
+        },
+        "shared_dir": {
+          "type": "string",
+          "description": "Directory (e.g. under /dev/shm) in which the counters of the sketches live as `cms_<index>.shm` memory-mapped files, for read-only tooling to query estimates and fill ratios without going through rules. Sliding window sketches and the container sketches are not shared. Disabled if not set."
+        },
+        "async_updates": {
+          "type": "object",
+          "properties": {
+            "ring_size": {
+              "type": "integer",
+              "minimum": 1,
+              "description": "Capacity of the staging ring, rounded up to the next power of two. Once full, the event thread drains it itself. Defaults to 65536."
+            },
+            "drain_interval_ms": {
+              "type": "integer",
+              "minimum": 1,
+              "description": "Interval, in milliseconds (ms), at which the staged updates are applied. Defaults to 1."
+            },
+            "include_pending": {
+              "type": "boolean",
+              "description": "Add the staged, not yet applied, increments of a behavior profile to its `anomaly.count_min_sketch` estimate, e.g. to count the current event. Defaults to true."
+            }
+          },
+          "description": "Only stage the sketch updates on the event thread, a background worker applies them in batches, in counter order. Only applies to the node wide sketches in 'double_hashing' mode without sliding window and `per_container`, others are updated synchronously. Disabled if not set."
+        },
+        "adaptive_sampling": {
+          "type": "object",
+          "properties": {
+            "budget_ns": {
+              "type": "integer",
+              "minimum": 1,
+              "description": "Budget of plugin time per parsed event, in nanoseconds (ns). While the measured time exceeds it, the sampling rates of all behavior profiles are doubled, and halved back once it falls under half of the budget."
+            },
+            "max_rate": {
+              "type": "integer",
+              "minimum": 1,
+              "description": "Maximum factor applied to the `sample_rate` of the behavior profiles. Defaults to 64."
+            }
+          },
+          "required": [
+            "budget_ns"
+          ],
+          "description": "Adaptive load shedding: trade sketch precision for plugin time under load instead of having the kernel drop events. Disabled if not set."
+        }
+      }
+    },
+    "bloom_filter": {
+      "type": "object",
+      "properties": {
+        "enabled": {
+          "type": "boolean"
+        },
+        "behavior_profiles": {
+          "type": "array",
+          "items": {
+            "type": "object",
+            "properties": {
+              "fields": {
+                "type": "string",
+                "description": "The anomalydetection behavior profile string including the fields."
+              },
+              "event_codes": {
+                "type": "array",
+                "description": "The list of PPME event codes to which the behavior profile updates should be applied.",
+                "items": {
+                  "type": "number",
+                  "description": "PPME event codes supported by Falco."
+                }
+              },
+              "capacity": {
+                "type": "number",
+                "description": "Expected number of distinct behavior profiles, the filter is sized to meet `fpp` at this number. Defaults to 100000."
+              },
+              "fpp": {
+                "type": "number",
+                "description": "False positive probability at `capacity` distinct behavior profiles, i.e. the probability of reporting a new profile as seen before. Defaults to 0.01."
+              },
+              "reset_timer_ms": {
+                "type": "number",
+                "description": "The timer, in milliseconds (ms), used to forget all seen behavior profiles."
               }
             },
             "required": [
@@ -120,14 +303,110 @@ falcosecurity::init_schema anomalydetection::get_init_schema()
     return init_schema;
 }
 
+void anomalydetection::parse_behavior_profile(const nlohmann::json& profile, int n, std::vector<plugin_sinsp_filterchecks_field>& fields, std::unordered_set<ppm_event_code>& codes)
+{
+    static const std::vector<ppm_event_code> supported_codes_fd_profile = {
+        PPME_SYSCALL_OPEN_X,
+        PPME_SOCKET_ACCEPT_5_X,
+        PPME_SOCKET_ACCEPT4_6_X,
+        PPME_SYSCALL_CREAT_X,
+        PPME_SOCKET_CONNECT_X,
+        PPME_SYSCALL_OPENAT_2_X,
+        PPME_SYSCALL_OPENAT2_X,
+        PPME_SYSCALL_OPEN_BY_HANDLE_AT_X
+    };
+    static const std::vector<ppm_event_code> supported_codes_any_profile = {
+        PPME_SYSCALL_EXECVEAT_X,
+        PPME_SYSCALL_EXECVE_19_X,
+        PPME_SYSCALL_CLONE_20_X,
+        PPME_SYSCALL_CLONE3_X,
+        PPME_SYSCALL_OPEN_X,
+        PPME_SOCKET_ACCEPT_5_X,
+        PPME_SOCKET_ACCEPT4_6_X,
+        PPME_SYSCALL_CREAT_X,
+        PPME_SOCKET_CONNECT_X,
+        PPME_SYSCALL_OPENAT_2_X,
+        PPME_SYSCALL_OPENAT2_X,
+        PPME_SYSCALL_OPEN_BY_HANDLE_AT_X
+    };
+
+    if (!profile.contains("fields") || !profile.contains("event_codes"))
+    {
+        return;
+    }
+    fields = plugin_anomalydetection::utils::get_profile_fields(profile["fields"].get<std::string>());
+    std::ostringstream oss;
+    bool first_event_code = true;
+    for (const auto& code : profile["event_codes"])
+    {
+        codes.insert((ppm_event_code)code.get<uint64_t>());
+        if (!first_event_code)
+        {
+            oss << ",";
+        }
+        oss << code;
+        first_event_code = false;
+    }
+    std::string event_codes_string = oss.str();
+    log_error("Behavior profile number (" + std::to_string(n) + ") loaded and applied to event_codes (" + event_codes_string + ") with behavior profile fields (" + profile["fields"].get<std::string>() + ")");
+
+    /* Some rudimentary initial checks to ensure profiles with %fd fields are applied on fd related events only */
+    if (profile["fields"].get<std::string>().find("%fd") != std::string::npos)
+    {
+        for (const auto& code : codes)
+        {
+            if (std::find(supported_codes_fd_profile.begin(), supported_codes_fd_profile.end(), code) == supported_codes_fd_profile.end())
+            {
+                throw std::invalid_argument("Behavior profile number (" + std::to_string(n) + ") contains '%fd' related fields but includes non fd related event codes such as code (" + std::to_string(code) + "), which is not allowed. Please refer to the docs for assistance.");
+            }
+        }
+    }
+    /* Some rudimentary checks to generally limit the event codes to a subset of supported event codes. */
+    for (const auto& code : codes)
+    {
+        if (std::find(supported_codes_any_profile.begin(), supported_codes_any_profile.end(), code) == supported_codes_any_profile.end())
+        {
+            throw std::invalid_argument("Behavior profile number (" + std::to_string(n) + ") contains event codes such as code (" + std::to_string(code) + ") that are currently not at all allowed for behavior profiles. Please refer to the docs for assistance.");
+        }
+    }
+}
+
 void anomalydetection::parse_init_config(nlohmann::json& config_json)
 {
     // Clear in case of config hot reloads
     m_gamma_eps.clear();
     m_rows_cols.clear();
     m_reset_timers.clear();
+    m_windows.clear();
+    m_pow2_cols.clear();
+    m_conservative_updates.clear();
+    m_counter_bits.clear();
+    m_top_k_sizes.clear();
+    m_hash_modes.clear();
+    m_per_container.clear();
+    m_per_container_rows_cols.clear();
+    m_per_container_max_bytes.clear();
+    m_sample_rates.clear();
+    m_sample_modes.clear();
+    m_adaptive_sampling_budget_ns = 0;
+    m_adaptive_sampling_max_rate = ADAPTIVE_SAMPLING_DEFAULT_MAX_RATE;
     m_behavior_profiles_fields.clear();
     m_behavior_profiles_event_codes.clear();
+    m_behavior_profiles_definitions.clear();
+    m_snapshot_dir.clear();
+    m_export_dir.clear();
+    m_export_node_id.clear();
+    m_import_dir.clear();
+    m_shared_dir.clear();
+    m_async_updates = false;
+    m_async_ring_size = ASYNC_UPDATES_DEFAULT_RING_SIZE;
+    m_async_drain_interval_ms = ASYNC_UPDATES_DEFAULT_DRAIN_INTERVAL_MS;
+    m_async_include_pending = true;
+    m_bloom_profiles_fields.clear();
+    m_bloom_profiles_event_codes.clear();
+    m_bloom_capacities.clear();
+    m_bloom_fpps.clear();
+    m_bloom_reset_timers.clear();
     if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch")))
     {
         if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch/enabled")))
@@ -146,6 +425,88 @@ void anomalydetection::parse_init_config(nlohmann::json& config_json)
                         .get_to(m_n_sketches);
             }
 
+            if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch/snapshot_dir")))
+            {
+                config_json.at(nlohmann::json::json_pointer("/count_min_sketch/snapshot_dir"))
+                        .get_to(m_snapshot_dir);
+                m_snapshot_interval_ms = 300000;
+                if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch/snapshot_interval_ms")))
+                {
+                    config_json.at(nlohmann::json::json_pointer("/count_min_sketch/snapshot_interval_ms"))
+                            .get_to(m_snapshot_interval_ms);
+                }
+                log_error("Count min sketches are snapshotted to (" + m_snapshot_dir + ") every (" + std::to_string(m_snapshot_interval_ms) + ") ms");
+            }
+
+            if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch/export_dir")))
+            {
+                config_json.at(nlohmann::json::json_pointer("/count_min_sketch/export_dir"))
+                        .get_to(m_export_dir);
+                m_export_interval_ms = 60000;
+                if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch/export_interval_ms")))
+                {
+                    config_json.at(nlohmann::json::json_pointer("/count_min_sketch/export_interval_ms"))
+                            .get_to(m_export_interval_ms);
+                }
+                if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch/export_node_id")))
+                {
+                    config_json.at(nlohmann::json::json_pointer("/count_min_sketch/export_node_id"))
+                            .get_to(m_export_node_id);
+                }
+                if (m_export_node_id.empty())
+                {
+                    char hostname[256] = {0};
+                    m_export_node_id = gethostname(hostname, sizeof(hostname) - 1) == 0 ? hostname : "unknown";
+                }
+                log_error("Count min sketches are exported to (" + m_export_dir + ") as node (" + m_export_node_id + ") every (" + std::to_string(m_export_interval_ms) + ") ms");
+            }
+
+            if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch/import_dir")))
+            {
+                config_json.at(nlohmann::json::json_pointer("/count_min_sketch/import_dir"))
+                        .get_to(m_import_dir);
+            }
+
+            if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch/shared_dir")))
+            {
+                config_json.at(nlohmann::json::json_pointer("/count_min_sketch/shared_dir"))
+                        .get_to(m_shared_dir);
+                log_error("Count min sketches are shared in (" + m_shared_dir + ")");
+            }
+
+            if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch/async_updates")))
+            {
+                m_async_updates = true;
+                if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch/async_updates/ring_size")))
+                {
+                    config_json.at(nlohmann::json::json_pointer("/count_min_sketch/async_updates/ring_size"))
+                            .get_to(m_async_ring_size);
+                }
+                if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch/async_updates/drain_interval_ms")))
+                {
+                    config_json.at(nlohmann::json::json_pointer("/count_min_sketch/async_updates/drain_interval_ms"))
+                            .get_to(m_async_drain_interval_ms);
+                }
+                if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch/async_updates/include_pending")))
+                {
+                    config_json.at(nlohmann::json::json_pointer("/count_min_sketch/async_updates/include_pending"))
+                            .get_to(m_async_include_pending);
+                }
+                log_error("Count min sketch updates are staged in a ring of (" + std::to_string(m_async_ring_size) + ") updates drained every (" + std::to_string(m_async_drain_interval_ms) + ") ms");
+            }
+
+            if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch/adaptive_sampling/budget_ns")))
+            {
+                config_json.at(nlohmann::json::json_pointer("/count_min_sketch/adaptive_sampling/budget_ns"))
+                        .get_to(m_adaptive_sampling_budget_ns);
+                if(config_json.contains(nlohmann::json::json_pointer("/count_min_sketch/adaptive_sampling/max_rate")))
+                {
+                    config_json.at(nlohmann::json::json_pointer("/count_min_sketch/adaptive_sampling/max_rate"))
+                            .get_to(m_adaptive_sampling_max_rate);
+                }
+                log_error("Count min sketch sampling rates adapt to a budget of (" + std::to_string(m_adaptive_sampling_budget_ns) + ") ns per event, up to (" + std::to_string(m_adaptive_sampling_max_rate) + ") times");
+            }
+
             // If used, config JSON schema enforces a minimum of 1 items and 2-d sub-arrays
             auto gamma_eps_pointer = nlohmann::json::json_pointer("/count_min_sketch/gamma_eps");
             if (config_json.contains(gamma_eps_pointer) && config_json[gamma_eps_pointer].is_array())
@@ -207,73 +568,12 @@ void anomalydetection::parse_init_config(nlohmann::json& config_json)
             if (config_json.contains(behavior_profiles_pointer) && config_json[behavior_profiles_pointer].is_array())
             {
                 const auto& behavior_profiles = config_json[behavior_profiles_pointer];
-                const std::vector<ppm_event_code> supported_codes_fd_profile = {
-                    PPME_SYSCALL_OPEN_X,
-                    PPME_SOCKET_ACCEPT_5_X,
-                    PPME_SOCKET_ACCEPT4_6_X,
-                    PPME_SYSCALL_CREAT_X,
-                    PPME_SOCKET_CONNECT_X,
-                    PPME_SYSCALL_OPENAT_2_X,
-                    PPME_SYSCALL_OPENAT2_X,
-                    PPME_SYSCALL_OPEN_BY_HANDLE_AT_X
-                };
-                std::vector<ppm_event_code> supported_codes_any_profile = {
-                    PPME_SYSCALL_EXECVEAT_X,
-                    PPME_SYSCALL_EXECVE_19_X,
-                    PPME_SYSCALL_CLONE_20_X,
-                    PPME_SYSCALL_CLONE3_X
-                };
-                supported_codes_any_profile.insert(
-                    supported_codes_any_profile.end(),
-                    supported_codes_fd_profile.begin(),
-                    supported_codes_fd_profile.end()
-                );
-
                 int n = 1;
                 for (const auto& profile : behavior_profiles)
                 {
                     std::vector<plugin_sinsp_filterchecks_field> filter_check_fields;
                     std::unordered_set<ppm_event_code> codes;
-                    if (profile.contains("fields") && profile.contains("event_codes"))
-                    {
-                        filter_check_fields = plugin_anomalydetection::utils::get_profile_fields(profile["fields"].get<std::string>());
-                        std::ostringstream oss;
-                        bool first_event_code = true;
-                        for (const auto& code : profile["event_codes"])
-                        {
-                            codes.insert((ppm_event_code)code.get<uint64_t>());
-                            if (!first_event_code)
-                            {
-                                oss << ",";
-                            }
-                            oss << code;
-                            first_event_code = false;
-                        }
-                        std::string event_codes_string = oss.str();
-                        log_error("Behavior profile number (" + std::to_string(n) + ") loaded and applied to event_codes (" + event_codes_string + ") with behavior profile fields (" + profile["fields"].get<std::string>() + ")");
-
-                        /* Some rudimentary initial checks to ensure profiles with %fd fields are applied on fd related events only */
-                        if (profile["fields"].get<std::string>().find("%fd") != std::string::npos)
-                        {
-                            for (const auto& code : codes)
-                            {
-                                if (std::find(supported_codes_fd_profile.begin(), supported_codes_fd_profile.end(), code) == supported_codes_fd_profile.end())
-                                {
-                                    log_error("The above behavior profile contains '%fd' related fields but includes non fd related event codes such as code (" + std::to_string(code) + "), which is not allowed. Please refer to the docs for assistance, exiting...");
-                                    exit(1);
-                                }
-                            }
-                        }
-                        /* Some rudimentary checks to generally limit the event codes to a subset of supported event codes. */
-                        for (const auto& code : codes)
-                        {
-                            if (std::find(supported_codes_any_profile.begin(), supported_codes_any_profile.end(), code) == supported_codes_any_profile.end())
-                            {
-                                log_error("The above behavior profile contains event codes such as code (" + std::to_string(code) + ") that are currently not at all allowed for behavior profiles. Please refer to the docs for assistance, exiting...");
-                                exit(1);
-                            }
-                        }
-                    }
+                    parse_behavior_profile(profile, n, filter_check_fields, codes);
                     if (profile.contains("reset_timer_ms"))
                     {
                         uint64_t interval = profile["reset_timer_ms"].get<uint64_t>();
@@ -289,8 +589,133 @@ void anomalydetection::parse_init_config(nlohmann::json& config_json)
                     {
                         m_reset_timers.emplace_back(uint64_t(0));
                     }
+                    uint64_t window_ms = 0;
+                    uint64_t window_buckets = 6;
+                    if (profile.contains("window_ms"))
+                    {
+                        window_ms = profile["window_ms"].get<uint64_t>();
+                    }
+                    if (profile.contains("window_buckets"))
+                    {
+                        window_buckets = profile["window_buckets"].get<uint64_t>();
+                    }
+                    if (window_ms > 0)
+                    {
+                        if (window_buckets < 1)
+                        {
+                            window_buckets = 1;
+                        }
+                        log_error("Behavior profile number (" + std::to_string(n) + ") counts over a sliding window of (" + std::to_string(window_ms) + ") ms split into (" + std::to_string(window_buckets) + ") buckets");
+                        if (m_reset_timers.back() > 0)
+                        {
+                            log_error("Behavior profile number (" + std::to_string(n) + ") has both `window_ms` and `reset_timer_ms` set, `reset_timer_ms` is ignored");
+                            m_reset_timers.back() = 0;
+                        }
+                    }
+                    m_windows.push_back({window_ms, window_buckets});
+                    bool pow2_cols = false;
+                    if (profile.contains("pow2_cols"))
+                    {
+                        pow2_cols = profile["pow2_cols"].get<bool>();
+                        if (pow2_cols)
+                        {
+                            log_error("Behavior profile number (" + std::to_string(n) + ") rounds the sketch cols/buckets up to the next power of two");
+                        }
+                    }
+                    m_pow2_cols.emplace_back(pow2_cols);
+                    auto hash_mode = plugin::anomalydetection::num::cms_hash_mode::SEEDED;
+                    if (profile.contains("hash_mode") && profile["hash_mode"].get<std::string>() == "double_hashing")
+                    {
+                        hash_mode = plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING;
+                        log_error("Behavior profile number (" + std::to_string(n) + ") derives all sketch row indices from a single 128-bit hash (double_hashing)");
+                    }
+                    m_hash_modes.emplace_back(hash_mode);
+                    bool conservative_update = false;
+                    if (profile.contains("conservative_update"))
+                    {
+                        conservative_update = profile["conservative_update"].get<bool>();
+                        if (conservative_update)
+                        {
+                            log_error("Behavior profile number (" + std::to_string(n) + ") uses conservative updates");
+                        }
+                    }
+                    m_conservative_updates.emplace_back(conservative_update);
+                    uint32_t counter_bits = 64;
+                    if (profile.contains("counter_type"))
+                    {
+                        auto counter_type = profile["counter_type"].get<std::string>();
+                        if (counter_type == "uint16")
+                        {
+                            counter_bits = 16;
+                        } else if (counter_type == "uint32")
+                        {
+                            counter_bits = 32;
+                        }
+                        if (counter_bits != 64)
+                        {
+                            log_error("Behavior profile number (" + std::to_string(n) + ") uses saturating " + counter_type + " counters");
+                        }
+                    }
+                    m_counter_bits.emplace_back(counter_bits);
+                    uint64_t top_k = 0;
+                    if (profile.contains("top_k"))
+                    {
+                        top_k = profile["top_k"].get<uint64_t>();
+                        if (top_k > 0)
+                        {
+                            log_error("Behavior profile number (" + std::to_string(n) + ") tracks its top (" + std::to_string(top_k) + ") heavy hitters");
+                        }
+                    }
+                    m_top_k_sizes.emplace_back(top_k);
+                    bool per_container = false;
+                    std::vector<uint64_t> per_container_rows_cols;
+                    uint64_t per_container_max_bytes = CONTAINER_SKETCHES_DEFAULT_MAX_BYTES;
+                    if (profile.contains("per_container"))
+                    {
+                        per_container = profile["per_container"].get<bool>();
+                    }
+                    if (per_container)
+                    {
+                        if (profile.contains("per_container_rows_cols"))
+                        {
+                            per_container_rows_cols = profile["per_container_rows_cols"].get<std::vector<uint64_t>>();
+                        }
+                        if (profile.contains("per_container_max_bytes"))
+                        {
+                            per_container_max_bytes = profile["per_container_max_bytes"].get<uint64_t>();
+                        }
+                        log_error("Behavior profile number (" + std::to_string(n) + ") counts each container in a sketch of its own"
+                        + (per_container_rows_cols.size() == 2 ? " of dimensions (" + std::to_string(per_container_rows_cols[0]) + "," + std::to_string(per_container_rows_cols[1]) + ")" : std::string())
+                        + ", up to (" + std::to_string(per_container_max_bytes) + ") bytes");
+                    }
+                    m_per_container.emplace_back(per_container);
+                    m_per_container_rows_cols.emplace_back(std::move(per_container_rows_cols));
+                    m_per_container_max_bytes.emplace_back(per_container_max_bytes);
+                    uint64_t sample_rate = 1;
+                    auto sample_mode = profile_sampler::FIXED;
+                    if (profile.contains("sample_rate"))
+                    {
+                        sample_rate = profile["sample_rate"].get<uint64_t>();
+                    }
+                    if (profile.contains("sample_mode") && profile["sample_mode"].get<std::string>() == "random")
+                    {
+                        sample_mode = profile_sampler::RANDOM;
+                    }
+                    if (sample_rate > 1)
+                    {
+                        log_error("Behavior profile number (" + std::to_string(n) + ") only updates its sketch for 1 out of (" + std::to_string(sample_rate) + ") events"
+                        + (sample_mode == profile_sampler::RANDOM ? " at random" : ""));
+                    }
+                    m_sample_rates.emplace_back(sample_rate);
+                    m_sample_modes.emplace_back(sample_mode);
                     m_behavior_profiles_fields.emplace_back(filter_check_fields);
                     m_behavior_profiles_event_codes.emplace_back(std::move(codes));
+                    // Snapshots are only reloaded for the same profile definition (fields, codes and sketch options).
+                    // Sampled counts approximate the same totals, the sampling options are left out.
+                    auto definition = profile;
+                    definition.erase("sample_rate");
+                    definition.erase("sample_mode");
+                    m_behavior_profiles_definitions.emplace_back(definition.dump());
                     n++;
                 }
             }
@@ -318,6 +743,101 @@ void anomalydetection::parse_init_config(nlohmann::json& config_json)
             }
         }
     }
+
+    if(config_json.contains(nlohmann::json::json_pointer("/bloom_filter")))
+    {
+        if(config_json.contains(nlohmann::json::json_pointer("/bloom_filter/enabled")))
+        {
+            config_json.at(nlohmann::json::json_pointer("/bloom_filter/enabled"))
+                    .get_to(m_bloom_filter_enabled);
+        }
+
+        // Config JSON schema enforces a minimum of 1 item
+        auto behavior_profiles_pointer = nlohmann::json::json_pointer("/bloom_filter/behavior_profiles");
+        if (m_bloom_filter_enabled && config_json.contains(behavior_profiles_pointer) && config_json[behavior_profiles_pointer].is_array())
+        {
+            int n = 1;
+            for (const auto& profile : config_json[behavior_profiles_pointer])
+            {
+                std::vector<plugin_sinsp_filterchecks_field> filter_check_fields;
+                std::unordered_set<ppm_event_code> codes;
+                parse_behavior_profile(profile, n, filter_check_fields, codes);
+                uint64_t capacity = 100000;
+                double fpp = 0.01;
+                if (profile.contains("capacity"))
+                {
+                    capacity = profile["capacity"].get<uint64_t>();
+                }
+                if (profile.contains("fpp"))
+                {
+                    fpp = profile["fpp"].get<double>();
+                }
+                uint64_t reset_timer = 0;
+                if (profile.contains("reset_timer_ms"))
+                {
+                    reset_timer = profile["reset_timer_ms"].get<uint64_t>();
+                    reset_timer = reset_timer > 100 ? reset_timer : 0;
+                }
+                log_error("Bloom filter number (" + std::to_string(n) + ") loaded with capacity and fpp values ("
+                + std::to_string(capacity) + ","
+                + std::to_string(fpp)
+                + ") -> adding ("
+                + std::to_string(plugin::anomalydetection::num::bloom_filter::get_size_bytes(plugin::anomalydetection::num::bloom_filter::calculate_n_blocks(capacity, fpp)))
+                + ") bytes of constant memory allocation on the heap");
+                m_bloom_profiles_fields.emplace_back(std::move(filter_check_fields));
+                m_bloom_profiles_event_codes.emplace_back(std::move(codes));
+                m_bloom_capacities.emplace_back(capacity);
+                m_bloom_fpps.emplace_back(fpp);
+                m_bloom_reset_timers.emplace_back(reset_timer);
+                n++;
+            }
+        }
+    }
+}
+
+template<typename T>
+count_min_sketch_ptr anomalydetection::make_count_min_sketch(uint32_t i, bool per_container)
+{
+    // Explicit dimensions if any, else the sketch is sized from `gamma_eps`
+    static const std::vector<uint64_t> no_dims;
+    const auto* rows_cols_ptr = &no_dims;
+    if (per_container && m_per_container_rows_cols[i].size() == 2)
+    {
+        rows_cols_ptr = &m_per_container_rows_cols[i];
+    }
+    else if (m_rows_cols.size() == m_n_sketches)
+    {
+        rows_cols_ptr = &m_rows_cols[i];
+    }
+    const auto& rows_cols = *rows_cols_ptr;
+    bool dims = !rows_cols.empty();
+    if (m_windows[i][0] > 0)
+    {
+        uint64_t window_ns = m_windows[i][0] * MILLISECOND_TO_NS;
+        if (dims)
+        {
+            return std::make_shared<plugin::anomalydetection::num::sliding_cms<T>>(rows_cols[0], rows_cols[1], m_windows[i][1], window_ns, m_pow2_cols[i], m_hash_modes[i], m_conservative_updates[i]);
+        }
+        return std::make_shared<plugin::anomalydetection::num::sliding_cms<T>>(m_gamma_eps[i][0], m_gamma_eps[i][1], m_windows[i][1], window_ns, m_pow2_cols[i], m_hash_modes[i], m_conservative_updates[i]);
+    }
+    if (dims)
+    {
+        return std::make_shared<plugin::anomalydetection::num::cms<T>>(rows_cols[0], rows_cols[1], m_pow2_cols[i], m_hash_modes[i], m_conservative_updates[i]);
+    }
+    return std::make_shared<plugin::anomalydetection::num::cms<T>>(m_gamma_eps[i][0], m_gamma_eps[i][1], m_pow2_cols[i], m_hash_modes[i], m_conservative_updates[i]);
+}
+
+count_min_sketch_ptr anomalydetection::make_count_min_sketch_of_type(uint32_t i, bool per_container)
+{
+    switch (m_counter_bits[i])
+    {
+    case 16:
+        return make_count_min_sketch<uint16_t>(i, per_container);
+    case 32:
+        return make_count_min_sketch<uint32_t>(i, per_container);
+    default:
+        return make_count_min_sketch<uint64_t>(i, per_container);
+    }
 }
 
 bool anomalydetection::init(falcosecurity::init_input& in)
@@ -331,8 +851,23 @@ bool anomalydetection::init(falcosecurity::init_input& in)
         return false;
     }
 
-    auto cfg = nlohmann::json::parse(in.get_config());
-    parse_init_config(cfg);
+    // Persist the counts collected so far before a config reload rebuilds the sketches; the periodic
+    // workers are stopped first as they read the settings `parse_init_config` rewrites
+    m_thread_manager.stop_threads(); // Important for reloading configs conditions
+    drain_staged_updates(SIZE_MAX);
+    save_count_min_sketch_snapshots();
+
+    try
+    {
+        auto cfg = nlohmann::json::parse(in.get_config());
+        parse_init_config(cfg);
+    }
+    catch(const std::exception& e)
+    {
+        // E.g. an invalid behavior profile, see `parse_behavior_profile`
+        m_lasterr = "invalid init config: " + std::string(e.what());
+        return false;
+    }
 
     //////////////////////////
     // Init fields
@@ -417,42 +952,500 @@ bool anomalydetection::init(falcosecurity::init_input& in)
     }
 
     // Init the plugin managed state table holding the count min sketch estimates for each behavior profile
-    m_thread_manager.stop_threads(); // Important for reloading configs conditions
-    m_count_min_sketches.lock()->clear();
-
-    if (m_count_min_sketch_enabled)
+    m_count_min_sketches.clear();
+    m_sketch_definition_hashes.clear();
+    m_sketch_baselines.clear();
+    m_top_k.clear();
+    m_behavior_profiles_cache.clear();
+    m_event_code_sketches.clear();
+    m_bloom_filters.clear();
+    m_bloom_profiles_cache.clear();
+    m_event_code_bloom_filters.clear();
+    m_lineage_cache.clear();
+    m_lineage_cache_enabled = false;
+    m_container_sketches.clear();
+    m_has_per_container = false;
+    m_async_sketches.clear();
+    m_staging_ring.reset();
+    m_has_containers_table = false;
+    // Lineage fields of any profile, sketch or Bloom filter
+    auto enable_lineage_cache = [this](const std::vector<std::vector<plugin_sinsp_filterchecks_field>>& profiles_fields)
     {
-        if (m_rows_cols.size() == m_n_sketches)
-        {
-            for (uint32_t i = 0; i < m_n_sketches; ++i)
-            {
-                uint64_t rows = m_rows_cols[i][0];
-                uint64_t cols = m_rows_cols[i][1];
-                m_count_min_sketches.lock()->push_back(std::make_shared<plugin::anomalydetection::num::cms<uint64_t>>(rows, cols));
-            }
-        } else if (m_gamma_eps.size() == m_n_sketches && m_rows_cols.empty())
+        for (const auto& fields : profiles_fields)
         {
-            for (uint32_t i = 0; i < m_n_sketches; ++i)
+            for (const auto& field : fields)
             {
-                double gamma = m_gamma_eps[i][0];
-                double eps = m_gamma_eps[i][1];
-                m_count_min_sketches.lock()->push_back(std::make_shared<plugin::anomalydetection::num::cms<uint64_t>>(gamma, eps));
+                switch (field.id)
+                {
+                case plugin_sinsp_filterchecks::TYPE_ANAME:
+                case plugin_sinsp_filterchecks::TYPE_ACMDLINE:
+                case plugin_sinsp_filterchecks::TYPE_AEXE:
+                case plugin_sinsp_filterchecks::TYPE_AEXEPATH:
+                case plugin_sinsp_filterchecks::TYPE_APID:
+                case plugin_sinsp_filterchecks::TYPE_CUSTOM_ANAME_LINEAGE_CONCAT:
+                case plugin_sinsp_filterchecks::TYPE_CUSTOM_AEXE_LINEAGE_CONCAT:
+                case plugin_sinsp_filterchecks::TYPE_CUSTOM_AEXEPATH_LINEAGE_CONCAT:
+                    m_lineage_cache_enabled |= field.argid >= 1;
+                    break;
+                default:
+                    break;
+                }
             }
-        } else
+        }
+    };
+
+    if (m_count_min_sketch_enabled)
+    {
+        if (m_rows_cols.size() != m_n_sketches && (m_gamma_eps.size() != m_n_sketches || !m_rows_cols.empty()))
         {
             return false;
         }
+        for (uint32_t i = 0; i < m_n_sketches; ++i)
+        {
+            m_count_min_sketches.push_back(make_count_min_sketch_of_type(i));
+            m_top_k.push_back(m_top_k_sizes[i] > 0 ? std::make_unique<plugin::anomalydetection::num::space_saving<uint64_t>>(m_top_k_sizes[i]) : nullptr);
+            const auto& definition = m_behavior_profiles_definitions[i];
+            m_sketch_definition_hashes.push_back(XXH3_64bits(definition.data(), definition.size()));
+        }
+        load_count_min_sketch_snapshots();
+        share_count_min_sketches();
 
-        // Launch threads to periodically reset the data structures (if applicable)
-        m_thread_manager.m_stop_requested = false;
+        m_samplers.clear();
         for (uint32_t i = 0; i < m_n_sketches; ++i)
         {
-            m_thread_manager.start_periodic_count_min_sketch_reset_worker<uint64_t>(i, (uint64_t)m_reset_timers[i], m_count_min_sketches);
+            m_samplers.emplace_back(m_sample_rates[i], m_sample_modes[i], i);
         }
-    }
+        m_adaptive_sampling = adaptive_sampling_controller(m_adaptive_sampling_budget_ns, m_adaptive_sampling_max_rate);
 
-    return true;
-}
+        // Async updates: single writer sketches whose updates fit in a digest
+        bool has_async_sketches = false;
+        for (uint32_t i = 0; i < m_n_sketches; ++i)
+        {
+            bool async = m_async_updates && !m_per_container[i] && m_windows[i][0] == 0 &&
+                m_hash_modes[i] == plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING;
+            if (m_async_updates && !async)
+            {
+                log_error("Count min sketch number (" + std::to_string(i + 1) + ") is updated synchronously, async updates require the 'double_hashing' hash mode without sliding window nor per container sketches");
+            }
+            m_async_sketches.push_back(async);
+            has_async_sketches |= async;
+        }
+        if (has_async_sketches)
+        {
+            m_staging_ring = std::make_unique<staging_ring>(m_async_ring_size);
+        }
+
+        // Container scoped profiles: the node wide sketch above only counts the host processes
+        std::vector<size_t> container_budgets;
+        for (uint32_t i = 0; i < m_n_sketches; ++i)
+        {
+            m_has_per_container |= m_per_container[i];
+            container_budgets.push_back(m_per_container[i] ? m_per_container_max_bytes[i] : 0);
+        }
+        m_container_sketches = container_scoped<count_min_sketch_slot>(container_budgets);
+        m_last_container_sweep_ts = 0;
+        if (m_has_per_container)
+        {
+            try
+            {
+                m_containers_table = t.get_table(CONTAINER_TABLE_NAME, st::SS_PLUGIN_ST_STRING);
+                m_has_containers_table = true;
+            }
+            catch(const std::exception& e)
+            {
+                log_error("The container plugin's table is not available, container sketches are only evicted past their memory budget: " + std::string(e.what()));
+            }
+        }
+
+        m_behavior_profiles_cache.resize(m_n_sketches);
+        enable_lineage_cache(m_behavior_profiles_fields);
+        m_event_code_sketches.resize(PPM_EVENT_MAX);
+        for (uint32_t i = 0; i < m_n_sketches; ++i)
+        {
+            for (const auto& code : m_behavior_profiles_event_codes[i])
+            {
+                if (code < PPM_EVENT_MAX)
+                {
+                    m_event_code_sketches[code].push_back(i);
+                }
+            }
+        }
+
+        // Launch threads to periodically reset the data structures (if applicable)
+        for (uint32_t i = 0; i < m_n_sketches; ++i)
+        {
+            std::visit([this, i](const auto& sketch)
+                {
+                    using S = typename std::decay_t<decltype(sketch)>::element_type;
+                    // Sliding window sketches expire counts on their own
+                    if constexpr (!plugin::anomalydetection::num::is_sliding_cms<S>::value)
+                    {
+                        m_thread_manager.start_periodic_count_min_sketch_reset_worker<typename S::value_type>((uint64_t)m_reset_timers[i], sketch);
+                    }
+                }, m_count_min_sketches[i]);
+        }
+        if (!m_snapshot_dir.empty() && m_snapshot_interval_ms > 0)
+        {
+            m_thread_manager.start_periodic_worker(m_snapshot_interval_ms, [this]() { save_count_min_sketch_snapshots(); });
+        }
+        if (!m_export_dir.empty() && m_export_interval_ms > 0)
+        {
+            m_thread_manager.start_periodic_worker(m_export_interval_ms, [this]() { export_count_min_sketches(); });
+        }
+        if (m_staging_ring)
+        {
+            m_thread_manager.start_periodic_worker(m_async_drain_interval_ms, [this]() { drain_staged_updates(SIZE_MAX); });
+        }
+    }
+
+    if (m_bloom_filter_enabled)
+    {
+        m_event_code_bloom_filters.resize(PPM_EVENT_MAX);
+        for (uint32_t i = 0; i < m_bloom_profiles_fields.size(); ++i)
+        {
+            auto filter = std::make_shared<plugin::anomalydetection::num::bloom_filter>(m_bloom_capacities[i], m_bloom_fpps[i]);
+            m_bloom_filters.push_back(filter);
+            for (const auto& code : m_bloom_profiles_event_codes[i])
+            {
+                if (code < PPM_EVENT_MAX)
+                {
+                    m_event_code_bloom_filters[code].push_back(i);
+                }
+            }
+            if (m_bloom_reset_timers[i] > 0)
+            {
+                m_thread_manager.start_periodic_worker(m_bloom_reset_timers[i], [filter]() { filter->reset(); });
+            }
+        }
+        m_bloom_profiles_cache.resize(m_bloom_filters.size());
+        enable_lineage_cache(m_bloom_profiles_fields);
+    }
+
+    init_metrics();
+    return true;
+}
+
+anomalydetection::~anomalydetection()
+{
+    m_thread_manager.stop_threads();
+    drain_staged_updates(SIZE_MAX);
+    save_count_min_sketch_snapshots();
+    export_count_min_sketches();
+}
+
+//////////////////////////
+// Metrics
+//////////////////////////
+
+static void push_latency_histogram_metrics(std::vector<falcosecurity::metric>& metrics, const std::string& name)
+{
+    for (const auto bound : latency_histogram::bounds)
+    {
+        metrics.emplace_back(name + "_le_" + std::to_string(bound), falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    }
+    metrics.emplace_back(name + "_le_inf", falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    metrics.emplace_back(name + "_sum", falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    metrics.emplace_back(name + "_count", falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+}
+
+static size_t set_latency_histogram_metrics(std::vector<falcosecurity::metric>& metrics, size_t pos, const latency_histogram& h)
+{
+    for (size_t i = 0; i < METRICS_LATENCY_N_BUCKETS; ++i)
+    {
+        metrics[pos++].set_value(h.cumulative_count(i));
+    }
+    metrics[pos++].set_value(h.sum_ns());
+    metrics[pos++].set_value(h.count());
+    return pos;
+}
+
+void anomalydetection::init_metrics()
+{
+    // Names are built once here, `get_metrics` only refreshes the values
+    m_metrics.clear();
+    m_metrics.emplace_back(METRIC_N_EVENTS_PARSED, falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_THREAD_LOOKUP_MISSES, falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_FD_LOOKUP_MISSES, falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_PROFILE_ERRORS, falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    push_latency_histogram_metrics(m_metrics, METRIC_PROFILE_EXTRACTION_LATENCY);
+    push_latency_histogram_metrics(m_metrics, METRIC_SKETCH_UPDATE_LATENCY);
+    if (m_adaptive_sampling_budget_ns > 0)
+    {
+        m_metrics.emplace_back(METRIC_ADAPTIVE_SAMPLING_MULTIPLIER, falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_NON_MONOTONIC);
+    }
+    if (m_staging_ring)
+    {
+        m_metrics.emplace_back(METRIC_N_STAGING_RING_FULL, falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    }
+    for (uint32_t i = 0; i < m_count_min_sketches.size(); ++i)
+    {
+        std::string prefix = METRIC_SKETCH_PREFIX + std::to_string(i) + "_";
+        m_metrics.emplace_back(prefix + METRIC_SKETCH_N_UPDATES, falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+        m_metrics.emplace_back(prefix + METRIC_SKETCH_FILL_RATIO, falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_NON_MONOTONIC);
+        if (m_sample_rates[i] > 1 || m_adaptive_sampling_budget_ns > 0)
+        {
+            m_metrics.emplace_back(prefix + METRIC_SKETCH_N_SAMPLED_OUT, falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+        }
+        if (m_per_container[i])
+        {
+            m_metrics.emplace_back(prefix + METRIC_SKETCH_N_CONTAINERS, falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_NON_MONOTONIC);
+            m_metrics.emplace_back(prefix + METRIC_SKETCH_CONTAINERS_MEMORY, falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_NON_MONOTONIC);
+            m_metrics.emplace_back(prefix + METRIC_SKETCH_N_CONTAINER_EVICTIONS, falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+        }
+    }
+    for (uint32_t i = 0; i < m_bloom_filters.size(); ++i)
+    {
+        std::string prefix = METRIC_BLOOM_FILTER_PREFIX + std::to_string(i) + "_";
+        m_metrics.emplace_back(prefix + METRIC_SKETCH_FILL_RATIO, falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_NON_MONOTONIC);
+    }
+
+    m_n_events_parsed.store(0, std::memory_order_relaxed);
+    m_n_thread_lookup_misses.store(0, std::memory_order_relaxed);
+    m_n_fd_lookup_misses.store(0, std::memory_order_relaxed);
+    m_n_profile_errors.store(0, std::memory_order_relaxed);
+    m_profile_extraction_latency.reset();
+    m_sketch_update_latency.reset();
+    m_sketch_n_updates = std::vector<std::atomic<uint64_t>>(m_count_min_sketches.size());
+    m_sketch_n_sampled_out = std::vector<std::atomic<uint64_t>>(m_count_min_sketches.size());
+    m_adaptive_sampling_multiplier.store(1, std::memory_order_relaxed);
+    m_n_staging_ring_full.store(0, std::memory_order_relaxed);
+    m_sketch_n_containers = std::vector<std::atomic<uint64_t>>(m_count_min_sketches.size());
+    m_sketch_containers_memory = std::vector<std::atomic<uint64_t>>(m_count_min_sketches.size());
+    m_sketch_n_container_evictions = std::vector<std::atomic<uint64_t>>(m_count_min_sketches.size());
+    get_metrics();
+}
+
+const std::vector<falcosecurity::metric>& anomalydetection::get_metrics()
+{
+    size_t pos = 0;
+    m_metrics[pos++].set_value(m_n_events_parsed.load(std::memory_order_relaxed));
+    m_metrics[pos++].set_value(m_n_thread_lookup_misses.load(std::memory_order_relaxed));
+    m_metrics[pos++].set_value(m_n_fd_lookup_misses.load(std::memory_order_relaxed));
+    m_metrics[pos++].set_value(m_n_profile_errors.load(std::memory_order_relaxed));
+    pos = set_latency_histogram_metrics(m_metrics, pos, m_profile_extraction_latency);
+    pos = set_latency_histogram_metrics(m_metrics, pos, m_sketch_update_latency);
+    if (m_adaptive_sampling_budget_ns > 0)
+    {
+        m_metrics[pos++].set_value(m_adaptive_sampling_multiplier.load(std::memory_order_relaxed));
+    }
+    if (m_staging_ring)
+    {
+        m_metrics[pos++].set_value(m_n_staging_ring_full.load(std::memory_order_relaxed));
+    }
+    for (uint32_t i = 0; i < m_count_min_sketches.size(); ++i)
+    {
+        m_metrics[pos++].set_value(m_sketch_n_updates[i].load(std::memory_order_relaxed));
+        // Scans all counters, cheap enough at the metrics collection interval
+        double fill_ratio = std::visit([](const auto& sketch) { return sketch->get_fill_ratio(); }, m_count_min_sketches[i]);
+        m_metrics[pos++].set_value(fill_ratio);
+        if (m_sample_rates[i] > 1 || m_adaptive_sampling_budget_ns > 0)
+        {
+            m_metrics[pos++].set_value(m_sketch_n_sampled_out[i].load(std::memory_order_relaxed));
+        }
+        if (m_per_container[i])
+        {
+            m_metrics[pos++].set_value(m_sketch_n_containers[i].load(std::memory_order_relaxed));
+            m_metrics[pos++].set_value(m_sketch_containers_memory[i].load(std::memory_order_relaxed));
+            m_metrics[pos++].set_value(m_sketch_n_container_evictions[i].load(std::memory_order_relaxed));
+        }
+    }
+    for (const auto& filter : m_bloom_filters)
+    {
+        m_metrics[pos++].set_value(filter->get_fill_ratio());
+    }
+    return m_metrics;
+}
+
+std::string anomalydetection::get_snapshot_path(uint32_t index) const
+{
+    return m_snapshot_dir + "/cms_" + std::to_string(index) + ".snap";
+}
+
+std::string anomalydetection::get_baseline_path(uint32_t index) const
+{
+    return m_snapshot_dir + "/cms_" + std::to_string(index) + ".baseline.snap";
+}
+
+void anomalydetection::save_count_min_sketch_snapshots()
+{
+    if (m_snapshot_dir.empty())
+    {
+        return;
+    }
+    // Serializes the periodic worker against shutdown / config reloads
+    std::lock_guard<std::mutex> lock(m_snapshot_mutex);
+    for (uint32_t i = 0; i < m_count_min_sketches.size() && i < m_sketch_definition_hashes.size(); ++i)
+    {
+        std::string err;
+        auto path = get_snapshot_path(i);
+        bool ok = std::visit([&](const auto& sketch)
+            {
+                return plugin::anomalydetection::num::cms_snapshot::save(path, *sketch, m_sketch_definition_hashes[i], err) &&
+                    (i >= m_sketch_baselines.size() ||
+                        plugin::anomalydetection::num::cms_snapshot::save_baseline(get_baseline_path(i), *sketch, m_sketch_baselines[i], m_sketch_definition_hashes[i], err));
+            }, m_count_min_sketches[i]);
+        if (!ok)
+        {
+            log_error("Count min sketch number (" + std::to_string(i + 1) + ") snapshot failed: " + err);
+        }
+    }
+}
+
+void anomalydetection::load_count_min_sketch_snapshots()
+{
+    std::lock_guard<std::mutex> lock(m_snapshot_mutex);
+    m_sketch_baselines.assign(m_count_min_sketches.size(), plugin::anomalydetection::num::cms_snapshot_baseline());
+    if (m_snapshot_dir.empty() && m_import_dir.empty())
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < m_count_min_sketches.size(); ++i)
+    {
+        std::string err;
+        bool ok = false;
+        if (!m_snapshot_dir.empty())
+        {
+            auto path = get_snapshot_path(i);
+            ok = std::visit([&](const auto& sketch)
+                {
+                    return plugin::anomalydetection::num::cms_snapshot::load(path, *sketch, m_sketch_definition_hashes[i], err);
+                }, m_count_min_sketches[i]);
+            if (ok)
+            {
+                log_error("Count min sketch number (" + std::to_string(i + 1) + ") warm started from snapshot (" + path + ")");
+                // The own snapshot already holds the counts imported earlier (if any), importing again would count
+                // them twice; their baseline keeps them out of the exports
+                std::visit([&](const auto& sketch)
+                    {
+                        plugin::anomalydetection::num::cms_snapshot::load_baseline(get_baseline_path(i), *sketch, m_sketch_definition_hashes[i], m_sketch_baselines[i], err);
+                    }, m_count_min_sketches[i]);
+                continue;
+            }
+        }
+        if (!m_import_dir.empty())
+        {
+            auto path = m_import_dir + "/cms_" + std::to_string(i) + ".snap";
+            ok = std::visit([&](const auto& sketch)
+                {
+                    return plugin::anomalydetection::num::cms_snapshot::import(path, *sketch, m_sketch_definition_hashes[i], m_sketch_baselines[i], err);
+                }, m_count_min_sketches[i]);
+            if (ok)
+            {
+                log_error("Count min sketch number (" + std::to_string(i + 1) + ") warm started from imported sketch (" + path + ")");
+                continue;
+            }
+        }
+        log_error("Count min sketch number (" + std::to_string(i + 1) + ") starts empty: " + err);
+    }
+}
+
+void anomalydetection::export_count_min_sketches()
+{
+    if (m_export_dir.empty())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_snapshot_mutex);
+    for (uint32_t i = 0; i < m_count_min_sketches.size() && i < m_sketch_definition_hashes.size() && i < m_sketch_baselines.size(); ++i)
+    {
+        std::string err;
+        auto path = m_export_dir + "/cms_" + std::to_string(i) + "." + m_export_node_id + ".snap";
+        // Node local counts only, the imported cluster wide counts would otherwise be merged again and again
+        bool ok = std::visit([&](const auto& sketch)
+            {
+                return plugin::anomalydetection::num::cms_snapshot::save_delta(path, *sketch, m_sketch_baselines[i], m_sketch_definition_hashes[i], err);
+            }, m_count_min_sketches[i]);
+        if (!ok)
+        {
+            log_error("Count min sketch number (" + std::to_string(i + 1) + ") export failed: " + err);
+        }
+    }
+}
+
+void anomalydetection::share_count_min_sketches()
+{
+    if (m_shared_dir.empty())
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < m_count_min_sketches.size(); ++i)
+    {
+        std::string err;
+        auto path = m_shared_dir + "/cms_" + std::to_string(i) + ".shm";
+        bool ok = std::visit([&](const auto& sketch)
+            {
+                using S = typename std::decay_t<decltype(sketch)>::element_type;
+                if constexpr (plugin::anomalydetection::num::is_sliding_cms<S>::value)
+                {
+                    err = "sliding window sketches are not shared";
+                    return false;
+                }
+                else
+                {
+                    return plugin::anomalydetection::num::cms_shared::attach(path, *sketch, m_sketch_definition_hashes[i], err);
+                }
+            }, m_count_min_sketches[i]);
+        if (!ok)
+        {
+            log_error("Count min sketch number (" + std::to_string(i + 1) + ") is not shared: " + err);
+        }
+    }
+}
+size_t anomalydetection::drain_staged_updates(size_t max)
+{
+    std::lock_guard<std::mutex> lock(m_drain_mutex);
+    if (!m_staging_ring)
+    {
+        return 0;
+    }
+    m_drain_batch.clear();
+    size_t n = m_staging_ring->pop(m_drain_batch, max);
+    // Grouped by sketch, then each group is applied in counter order rather than in arrival order
+    std::stable_sort(m_drain_batch.begin(), m_drain_batch.end(), [](const staged_update& a, const staged_update& b) { return a.sketch < b.sketch; });
+    for (size_t begin = 0; begin < n;)
+    {
+        uint32_t index = m_drain_batch[begin].sketch;
+        size_t end = begin;
+        while (end < n && m_drain_batch[end].sketch == index)
+        {
+            ++end;
+        }
+        std::visit([this, begin, end](const auto& sketch)
+            {
+                using S = typename std::decay_t<decltype(sketch)>::element_type;
+                using T = typename S::value_type;
+                if constexpr (!plugin::anomalydetection::num::is_sliding_cms<S>::value)
+                {
+                    if (sketch->is_conservative_update())
+                    {
+                        // The cells of a conservative update depend on each other
+                        for (size_t k = begin; k < end; ++k)
+                        {
+                            const auto& u = m_drain_batch[k];
+                            sketch->update(u.digest, (T)std::min<uint64_t>(u.count, std::numeric_limits<T>::max()));
+                        }
+                        return;
+                    }
+                    m_drain_cells.clear();
+                    m_drain_offsets.resize(sketch->get_d());
+                    for (size_t k = begin; k < end; ++k)
+                    {
+                        const auto& u = m_drain_batch[k];
+                        sketch->get_cell_offsets(u.digest, m_drain_offsets.data());
+                        for (auto offset : m_drain_offsets)
+                        {
+                            m_drain_cells.emplace_back(offset, u.count);
+                        }
+                    }
+                    std::sort(m_drain_cells.begin(), m_drain_cells.end());
+                    sketch->add_cells(m_drain_cells.data(), m_drain_cells.size());
+                }
+            }, m_count_min_sketches[index]);
+        begin = end;
+    }
+    m_staging_ring->applied(m_drain_batch.data(), n);
+    return n;
+}
 
 //////////////////////////
 // Extract capability
@@ -486,12 +1479,40 @@ std::vector<falcosecurity::field_info> anomalydetection::get_fields()
                 false,  // index
                 false,
              }},
+            {ft::FTYPE_STRING, "anomaly.count_min_sketch.top_k",
+             "Behavior Profile Heavy Hitters",
+             "List of the most frequent behavior profiles of a sketch as 'count:profile' strings, sorted by descending count. Requires the `top_k` option of the behavior profile. Access different behavior profiles using indices. For instance, anomaly.count_min_sketch.top_k[0] retrieves the heavy hitters of the first behavior profile defined in the plugins' `init_config`.",
+             { // field arg
+                false, // key
+                true,  // index
+                false,
+             },
+             true}, // list
+            {ft::FTYPE_BOOL, "anomaly.bloom_filter.seen",
+             "Behavior Profile Seen Before",
+             "'true' if the behavior profile was (probably) seen before the current event according to the Bloom filter, 'false' for a first occurrence. False positives are bounded by the `fpp` option, there are no false negatives. Access different behavior profiles using indices. For instance, anomaly.bloom_filter.seen[0] retrieves the first behavior profile defined in the `bloom_filter` section of the plugins' `init_config`.",
+             { // field arg
+                false, // key
+                true,  // index
+                false,
+             }},
     };
     const int fields_size = sizeof(fields) / sizeof(fields[0]);
     static_assert(fields_size == ANOMALYDETECTION_FIELD_MAX, "Wrong number of anomaly fields.");
     return std::vector<falcosecurity::field_info>(fields, fields + fields_size);
 }
 
+// 128-bit digest of the profile, computed at most once per event and shared by sketches, heavy hitters and Bloom filters
+static inline const plugin::anomalydetection::num::cms_digest& ensure_digest(behavior_profile_cache_entry& entry)
+{
+    if (!entry.has_digest)
+    {
+        entry.digest = plugin::anomalydetection::num::cms<uint64_t>::get_digest(entry.profile);
+        entry.has_digest = true;
+    }
+    return entry.digest;
+}
+
 bool anomalydetection::extract(const falcosecurity::extract_fields_input& in)
 {
     auto& req = in.get_extract_request();
@@ -503,7 +1524,6 @@ bool anomalydetection::extract(const falcosecurity::extract_fields_input& in)
         {
             int64_t thread_id = evt.get_tid();
             uint64_t count_min_sketch_estimate = 0;
-            std::string behavior_profile_concat_str;
             auto index = req.get_arg_index();
             if(!m_count_min_sketch_enabled)
             {
@@ -515,9 +1535,22 @@ bool anomalydetection::extract(const falcosecurity::extract_fields_input& in)
                 m_lasterr = "sketch index out of bounds";
                 return false;
             }
-            if(extract_filterchecks_concat_profile(evt, tr, m_behavior_profiles_fields[index], behavior_profile_concat_str))
+            profile_extraction_ctx ctx(evt, tr);
+            auto& entry = get_behavior_profile(ctx, index);
+            if(entry.extracted)
             {
-                count_min_sketch_estimate = m_count_min_sketches.lock()->at(index).get()->estimate(behavior_profile_concat_str);
+                if (!entry.has_estimate)
+                {
+                    // First count of the event, also answers the following `anomaly.count_min_sketch[i]` fields
+                    estimate_behavior_profiles_batch(ctx);
+                }
+                if (!entry.has_estimate)
+                {
+                    resolve_sketch(ctx, entry, index, false);
+                    entry.estimate = estimate_behavior_profile(entry, index, evt.get_ts());
+                    entry.has_estimate = true;
+                }
+                count_min_sketch_estimate = entry.estimate;
                 req.set_value(count_min_sketch_estimate, true);
             }
             return true;
@@ -526,7 +1559,6 @@ bool anomalydetection::extract(const falcosecurity::extract_fields_input& in)
         {
             int64_t thread_id = evt.get_tid();
             uint64_t count_min_sketch_estimate = 0;
-            std::string behavior_profile_concat_str;
             auto index = req.get_arg_index();
             if(!m_count_min_sketch_enabled)
             {
@@ -538,12 +1570,41 @@ bool anomalydetection::extract(const falcosecurity::extract_fields_input& in)
                 m_lasterr = "sketch index out of bounds";
                 return false;
             }
-            if(extract_filterchecks_concat_profile(evt, tr, m_behavior_profiles_fields[index], behavior_profile_concat_str))
+            profile_extraction_ctx ctx(evt, tr);
+            auto& entry = get_behavior_profile(ctx, index);
+            if(entry.extracted)
             {
-                req.set_value(behavior_profile_concat_str, true);
+                req.set_value(entry.profile, true);
             }
             return true;
         }  
+    case ANOMALYDETECTION_BLOOM_FILTER_SEEN:
+        {
+            auto index = req.get_arg_index();
+            if(!m_bloom_filter_enabled)
+            {
+                m_lasterr = "bloom_filter disabled, but `anomaly.bloom_filter.seen` field referenced";
+                return false;
+            }
+            if(index >= m_bloom_filters.size())
+            {
+                m_lasterr = "bloom filter index out of bounds";
+                return false;
+            }
+            profile_extraction_ctx ctx(evt, tr);
+            auto& entry = get_bloom_profile(ctx, index);
+            if(entry.extracted)
+            {
+                if (!entry.has_estimate)
+                {
+                    // Not inserted by `parse_event` for this event, e.g. the event code is not subscribed
+                    entry.estimate = !entry.profile.empty() && m_bloom_filters[index]->contains(ensure_digest(entry)) ? 1 : 0;
+                    entry.has_estimate = true;
+                }
+                req.set_value(entry.estimate != 0, true);
+            }
+            return true;
+        }
     case ANOMALYDETECTION_FALCO_DURATION_NS:
         {
             auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
@@ -551,6 +1612,34 @@ bool anomalydetection::extract(const falcosecurity::extract_fields_input& in)
             req.set_value((uint64_t)(now - m_falco_start_ts_epoch_ns), true);
         }
         return true;
+    case ANOMALYDETECTION_COUNT_MIN_SKETCH_TOP_K:
+        {
+            auto index = req.get_arg_index();
+            if(!m_count_min_sketch_enabled)
+            {
+                m_lasterr = "count_min_sketch disabled, but `anomaly.count_min_sketch.top_k` field referenced";
+                return false;
+            }
+            if(index >= m_n_sketches)
+            {
+                m_lasterr = "sketch index out of bounds";
+                return false;
+            }
+            if(!m_top_k[index])
+            {
+                return true;
+            }
+            std::vector<std::string> heavy_hitters;
+            for(const auto& e : m_top_k[index]->top())
+            {
+                heavy_hitters.emplace_back(std::to_string(e.count) + ":" + e.value);
+            }
+            if(!heavy_hitters.empty())
+            {
+                req.set_value(heavy_hitters.begin(), heavy_hitters.end(), true);
+            }
+            return true;
+        }
     default:
         m_lasterr = "unknown extraction request";
         return false;
@@ -563,36 +1652,15 @@ bool anomalydetection::extract(const falcosecurity::extract_fields_input& in)
 // Parse capability
 //////////////////////////
 
-// Adopted from the k8smeta plugin, obtain a param from a sinsp event
-static inline sinsp_param get_syscall_evt_param(void* evt, uint32_t num_param)
+template<typename T>
+std::string_view anomalydetection::format_fallback_num(T num)
 {
-    uint32_t dataoffset = 0;
-    // pointer to the lengths array inside the event.
-    auto len = (uint16_t*)((uint8_t*)evt +
-                           sizeof(falcosecurity::_internal::ss_plugin_event));
-    for(uint32_t j = 0; j < num_param; j++)
-    {
-        // sum lengths of the previous params.
-        dataoffset += len[j];
-    }
-    return {.param_len = len[num_param],
-            .param_pointer =
-                    ((uint8_t*)&len
-                             [((falcosecurity::_internal::ss_plugin_event*)evt)
-                                      ->nparams]) +
-                    dataoffset};
+    auto res = std::to_chars(m_fallback_buf.data(), m_fallback_buf.data() + m_fallback_buf.size(), num);
+    return std::string_view(m_fallback_buf.data(), res.ptr - m_fallback_buf.data());
 }
 
-std::string anomalydetection::extract_filterchecks_evt_params_fallbacks(const falcosecurity::event_reader &evt, const plugin_sinsp_filterchecks_field& field, const std::string& cwd)
+std::string_view anomalydetection::extract_filterchecks_evt_params_fallbacks(profile_extraction_ctx& ctx, const plugin_sinsp_filterchecks_field& field, std::string_view cwd)
 {
-    using st = falcosecurity::state_value_type;
-
-    std::string tstr;
-    uint64_t tuint64 = UINT64_MAX;
-    uint32_t tuint32 = UINT32_MAX;
-    int64_t tint64 = -1;
-    bool tbool;
-    int64_t ptid = -1;
     switch(field.id)
     {
 
@@ -602,7 +1670,7 @@ std::string anomalydetection::extract_filterchecks_evt_params_fallbacks(const fa
 
     case plugin_sinsp_filterchecks::TYPE_FDNUM:
     {
-        switch(evt.get_type())
+        switch(ctx.evt.get_type())
         {
         case PPME_SYSCALL_OPEN_X:
         case PPME_SYSCALL_CREAT_X:
@@ -612,27 +1680,21 @@ std::string anomalydetection::extract_filterchecks_evt_params_fallbacks(const fa
         case PPME_SOCKET_ACCEPT_5_X:
         case PPME_SOCKET_ACCEPT4_6_X:
         {
-            auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                0);
+            auto res_param = resolve_params(ctx).get(0);
             if (res_param.param_pointer == nullptr)
             {
-                return tstr;
+                return {};
             }
-            int64_t fd = *(int64_t*)(res_param.param_pointer);
-            tstr = std::to_string(fd);
-            break;
+            return format_fallback_num(*(int64_t*)(res_param.param_pointer));
         }
         case PPME_SOCKET_CONNECT_X:
         {
-            auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                2);
+            auto res_param = resolve_params(ctx).get(2);
             if (res_param.param_pointer == nullptr)
             {
-                return tstr;
+                return {};
             }
-            int64_t fd = *(int64_t*)(res_param.param_pointer);
-            tstr = std::to_string(fd);
-            break;
+            return format_fallback_num(*(int64_t*)(res_param.param_pointer));
         }
         default:
             break;
@@ -643,54 +1705,39 @@ std::string anomalydetection::extract_filterchecks_evt_params_fallbacks(const fa
     case plugin_sinsp_filterchecks::TYPE_DIRECTORY:
     case plugin_sinsp_filterchecks::TYPE_FILENAME:
     {
-        switch(evt.get_type())
+        switch(ctx.evt.get_type())
         {
         case PPME_SYSCALL_OPEN_X:
         case PPME_SYSCALL_CREAT_X:
             {
-                auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                1);
+                auto res_param = resolve_params(ctx).get(1);
                 if (res_param.param_pointer == nullptr)
                 {
-                    return tstr;
-                }
-                tstr = (char*)(res_param.param_pointer);
-                if(!std::filesystem::path(tstr).is_absolute())
-                {
-                    tstr = plugin_anomalydetection::utils::concatenate_paths(cwd, tstr);
-                } else
-                {
-                    // concatenate_paths takes care of resolving the path
-                    tstr = plugin_anomalydetection::utils::concatenate_paths("", tstr);
+                    return {};
                 }
+                // concatenate_paths ignores cwd for absolute paths and takes care of resolving the path
+                return plugin_anomalydetection::utils::concatenate_paths(cwd, param_as_string_view(res_param), m_fallback_buf.data(), m_fallback_buf.size());
             }
-            break;
         case PPME_SYSCALL_OPENAT_2_X:
         case PPME_SYSCALL_OPENAT2_X:
             {
-                auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                2);
+                auto res_param = resolve_params(ctx).get(2);
                 if (res_param.param_pointer == nullptr)
                 {
-                    return tstr;
+                    return {};
                 }
-                tstr = (char*)(res_param.param_pointer);
                 // cwd passed to the function here is the name extracted from the dirfd
-                tstr = plugin_anomalydetection::utils::concatenate_paths(cwd, tstr);
+                return plugin_anomalydetection::utils::concatenate_paths(cwd, param_as_string_view(res_param), m_fallback_buf.data(), m_fallback_buf.size());
             }
-            break;
         case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
             {
-                auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                3);
+                auto res_param = resolve_params(ctx).get(3);
                 if (res_param.param_pointer == nullptr)
                 {
-                    return tstr;
+                    return {};
                 }
-                tstr = (char*)(res_param.param_pointer);
-                tstr = plugin_anomalydetection::utils::concatenate_paths("", tstr);
+                return plugin_anomalydetection::utils::concatenate_paths("", param_as_string_view(res_param), m_fallback_buf.data(), m_fallback_buf.size());
             }
-            break;
         case PPME_SOCKET_ACCEPT_5_X:
         case PPME_SOCKET_ACCEPT4_6_X:
         case PPME_SOCKET_CONNECT_X:
@@ -700,7 +1747,7 @@ std::string anomalydetection::extract_filterchecks_evt_params_fallbacks(const fa
             //                                     1);
             // if (res_param.param_pointer == nullptr)
             // {
-            //     return tstr;
+            //     return {};
             // }
             break;
         }
@@ -711,167 +1758,569 @@ std::string anomalydetection::extract_filterchecks_evt_params_fallbacks(const fa
     }
     case plugin_sinsp_filterchecks::TYPE_INO:
     {
-        switch(evt.get_type())
+        uint32_t num_param = 0;
+        switch(ctx.evt.get_type())
         {
         case PPME_SYSCALL_OPEN_X:
         case PPME_SYSCALL_CREAT_X:
-            {
-                auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                5);
-                if (res_param.param_pointer == nullptr)
-                {
-                    return tstr;
-                }
-                uint64_t ino = *(uint64_t*)(res_param.param_pointer);
-                tstr = std::to_string(ino);
-            }
+        case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
+            num_param = 5;
             break;
         case PPME_SYSCALL_OPENAT_2_X:
         case PPME_SYSCALL_OPENAT2_X:
-            {
-                auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                7);
-                if (res_param.param_pointer == nullptr)
-                {
-                    return tstr;
-                }
-                uint64_t ino = *(uint64_t*)(res_param.param_pointer);
-                tstr = std::to_string(ino);
-            }
-            break;
-        case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
-            {
-                auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                5);
-                if (res_param.param_pointer == nullptr)
-                {
-                    return tstr;
-                }
-                uint64_t ino = *(uint64_t*)(res_param.param_pointer);
-                tstr = std::to_string(ino);
-            }
+            num_param = 7;
             break;
         default:
-            break;
+            return {};
         }
-        break;
+        auto res_param = resolve_params(ctx).get(num_param);
+        if (res_param.param_pointer == nullptr)
+        {
+            return {};
+        }
+        return format_fallback_num(*(uint64_t*)(res_param.param_pointer));
     }
     case plugin_sinsp_filterchecks::TYPE_DEV:
     {
-        switch(evt.get_type())
+        uint32_t num_param = 0;
+        switch(ctx.evt.get_type())
         {
         case PPME_SYSCALL_OPEN_X:
         case PPME_SYSCALL_CREAT_X:
-            {
-                auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                4);
-                if (res_param.param_pointer == nullptr)
-                {
-                    return tstr;
-                }
-                uint32_t dev = *(uint32_t*)(res_param.param_pointer);
-                tstr = std::to_string(dev);
-            }
+        case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
+            num_param = 4;
             break;
         case PPME_SYSCALL_OPENAT_2_X:
         case PPME_SYSCALL_OPENAT2_X:
-            {
-                auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                6);
-                if (res_param.param_pointer == nullptr)
-                {
-                    return tstr;
-                }
-                uint32_t dev = *(uint32_t*)(res_param.param_pointer);
-                tstr = std::to_string(dev);
-            }
-            break;
-        case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
-            {
-                auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                4);
-                if (res_param.param_pointer == nullptr)
-                {
-                    return tstr;
-                }
-                uint32_t dev = *(uint32_t*)(res_param.param_pointer);
-                tstr = std::to_string(dev);
-            }
+            num_param = 6;
             break;
         default:
-            break;
+            return {};
         }
-        break;
+        auto res_param = resolve_params(ctx).get(num_param);
+        if (res_param.param_pointer == nullptr)
+        {
+            return {};
+        }
+        return format_fallback_num(*(uint32_t*)(res_param.param_pointer));
     }
     case plugin_sinsp_filterchecks::TYPE_FDNAMERAW:
     {
-        switch(evt.get_type())
+        // No transformation needed, view straight into the event buffer
+        switch(ctx.evt.get_type())
         {
         case PPME_SYSCALL_OPEN_X:
         case PPME_SYSCALL_CREAT_X:
-            {
-                auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                1);
-                if (res_param.param_pointer == nullptr)
-                {
-                    return tstr;
-                }
-                tstr = (char*)(res_param.param_pointer);
-            }
-            break;
+            return param_as_string_view(resolve_params(ctx).get(1));
         case PPME_SYSCALL_OPENAT_2_X:
         case PPME_SYSCALL_OPENAT2_X:
+            return param_as_string_view(resolve_params(ctx).get(2));
+        case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
+            return param_as_string_view(resolve_params(ctx).get(3));
+        default:
+            break;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return {};
+}
+
+// Read all args of a thread entry, null args are kept as empty strings
+void anomalydetection::read_args(const falcosecurity::table_reader &tr, falcosecurity::table_entry& entry, std::vector<std::string>& args)
+{
+    using st = falcosecurity::state_value_type;
+
+    const char* arg = nullptr;
+    auto args_table = m_thread_table.get_subtable(tr, m_args, entry, st::SS_PLUGIN_ST_INT64);
+    args_table.iterate_entries(tr, [this, &tr, &arg, &args](const falcosecurity::table_entry& e)
+        {
+            arg = nullptr;
+            m_args_value.read_value(tr, e, arg);
+            args.emplace_back(arg ? arg : "");
+            return true;
+        });
+}
+
+// Space-join args onto `tstr`, a separator is only added if `tstr` is not empty at that point
+static inline void append_args(std::string& tstr, const std::vector<std::string>& args)
+{
+    for (const auto& arg : args)
+    {
+        if (!tstr.empty())
+        {
+            tstr += " ";
+        }
+        tstr += arg;
+    }
+}
+
+const event_params<>& anomalydetection::resolve_params(profile_extraction_ctx& ctx)
+{
+    if (!ctx.params.has_value())
+    {
+        ctx.params.emplace(ctx.evt.get_buf());
+    }
+    return *ctx.params;
+}
+
+bool anomalydetection::resolve_thread_entry(profile_extraction_ctx& ctx)
+{
+    if (!ctx.thread_entry_resolved)
+    {
+        ctx.thread_entry_resolved = true;
+        try
+        {
+            ctx.thread_entry = m_thread_table.get_entry(ctx.tr, ctx.evt.get_tid());
+        } catch (const std::exception& e)
+        {
+            ctx.thread_entry.reset();
+            metric_inc(m_n_thread_lookup_misses);
+        }
+    }
+    return ctx.thread_entry.has_value();
+}
+
+falcosecurity::table_entry& anomalydetection::resolve_parent_entry(profile_extraction_ctx& ctx)
+{
+    if (!ctx.parent_entry.has_value())
+    {
+        // Not memoizing failures on purpose, a missing parent throws for every field as before
+        int64_t ptid = -1;
+        m_ptid.read_value(ctx.tr, ctx.thread_entry.value(), ptid);
+        ctx.parent_entry = m_thread_table.get_entry(ctx.tr, ptid);
+    }
+    return ctx.parent_entry.value();
+}
+
+const std::vector<std::string>& anomalydetection::resolve_args(profile_extraction_ctx& ctx)
+{
+    if (!ctx.args_resolved)
+    {
+        ctx.args_resolved = true;
+        read_args(ctx.tr, ctx.thread_entry.value(), ctx.args);
+    }
+    return ctx.args;
+}
+
+const std::vector<std::string>& anomalydetection::resolve_parent_args(profile_extraction_ctx& ctx)
+{
+    if (!ctx.parent_args_resolved)
+    {
+        auto& parent_entry = resolve_parent_entry(ctx);
+        ctx.parent_args_resolved = true;
+        read_args(ctx.tr, parent_entry, ctx.parent_args);
+    }
+    return ctx.parent_args;
+}
+
+falcosecurity::table_entry* anomalydetection::resolve_fd_entry(profile_extraction_ctx& ctx)
+{
+    using st = falcosecurity::state_value_type;
+
+    if (!ctx.fd_entry_resolved)
+    {
+        ctx.fd_entry_resolved = true;
+        try
+        {
+            int64_t fd = -1;
+            auto fd_table = m_thread_table.get_subtable(
+            ctx.tr, m_fds, ctx.thread_entry.value(),
+            st::SS_PLUGIN_ST_INT64);
+            if (ctx.lastevent_fd.has_value())
             {
-                auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                2);
-                if (res_param.param_pointer == nullptr)
-                {
-                    return tstr;
-                }
-                tstr = (char*)(res_param.param_pointer);
+                fd = ctx.lastevent_fd.value();
+            } else
+            {
+                m_lastevent_fd_field.read_value(ctx.tr, ctx.thread_entry.value(), fd);
             }
+            ctx.fd_entry = fd_table.get_entry(ctx.tr, fd);
+        }
+        catch(const std::exception& e)
+        {
+            ctx.fd_entry.reset();
+            metric_inc(m_n_fd_lookup_misses);
+        }
+    }
+    return ctx.fd_entry.has_value() ? &ctx.fd_entry.value() : nullptr;
+}
+
+lineage_ancestor* anomalydetection::resolve_ancestor(profile_extraction_ctx& ctx, uint32_t level)
+{
+    int64_t tid = ctx.evt.get_tid();
+    auto* lineage = m_lineage_cache.get(tid);
+    if (lineage == nullptr)
+    {
+        int64_t ptid = -1;
+        m_ptid.read_value(ctx.tr, ctx.thread_entry.value(), ptid);
+        lineage = &m_lineage_cache.insert(tid, ptid);
+    }
+    while (lineage->ancestors.size() < level && !lineage->complete)
+    {
+        try
+        {
+            auto entry = m_thread_table.get_entry(ctx.tr, lineage->next_ptid);
+            lineage_ancestor ancestor;
+            ancestor.tid = lineage->next_ptid;
+            m_comm.read_value(ctx.tr, entry, ancestor.comm);
+            m_exe.read_value(ctx.tr, entry, ancestor.exe);
+            m_exepath.read_value(ctx.tr, entry, ancestor.exepath);
+            m_pid.read_value(ctx.tr, entry, ancestor.pid);
+            m_ptid.read_value(ctx.tr, entry, lineage->next_ptid);
+            m_lineage_cache.add_dependency(tid, ancestor.tid);
+            // The walk stops at init, like libs' own lineage traversal
+            lineage->complete = ancestor.tid == 1;
+            lineage->ancestors.push_back(std::move(ancestor));
+        }
+        catch(const std::exception& e)
+        {
+            // Missing ancestor, not memoized as it may show up in the thread table later
             break;
-        case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
-            {
-                auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                3);
-                if (res_param.param_pointer == nullptr)
+        }
+    }
+    return level >= 1 && level <= lineage->ancestors.size() ? &lineage->ancestors[level - 1] : nullptr;
+}
+
+const std::string& anomalydetection::resolve_ancestor_cmdline(profile_extraction_ctx& ctx, lineage_ancestor& ancestor)
+{
+    using st = falcosecurity::state_value_type;
+
+    // Ancestors are owned by the cache entry, only the lazily built cmdline is filled in here
+    if (!ancestor.cmdline_resolved)
+    {
+        ancestor.cmdline = ancestor.comm;
+        try
+        {
+            auto entry = m_thread_table.get_entry(ctx.tr, ancestor.tid);
+            const char* arg = nullptr;
+            auto args_table = m_thread_table.get_subtable(ctx.tr, m_args, entry, st::SS_PLUGIN_ST_INT64);
+            args_table.iterate_entries(ctx.tr, [this, &ctx, &arg, &ancestor](const falcosecurity::table_entry& e)
                 {
-                    return tstr;
-                }
-                tstr = (char*)(res_param.param_pointer);
+                    arg = nullptr;
+                    m_args_value.read_value(ctx.tr, e, arg);
+                    if (!ancestor.cmdline.empty())
+                    {
+                        ancestor.cmdline += " ";
+                    }
+                    if (arg)
+                    {
+                        ancestor.cmdline += arg;
+                    }
+                    return true;
+                });
+        }
+        catch(const std::exception& e)
+        {
+        }
+        ancestor.cmdline_resolved = true;
+    }
+    return ancestor.cmdline;
+}
+
+bool anomalydetection::is_lineage_invalidation_event(size_t evt_type)
+{
+    switch(evt_type)
+    {
+    case PPME_SYSCALL_CLONE_20_X:
+    case PPME_SYSCALL_FORK_20_X:
+    case PPME_SYSCALL_VFORK_20_X:
+    case PPME_SYSCALL_CLONE3_X:
+    case PPME_SYSCALL_EXECVE_19_X:
+    case PPME_SYSCALL_EXECVEAT_X:
+    case PPME_PROCEXIT_1_E:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void anomalydetection::invalidate_lineage(const falcosecurity::event_reader& evt)
+{
+    m_lineage_cache.invalidate(evt.get_tid());
+    switch(evt.get_type())
+    {
+    case PPME_SYSCALL_CLONE_20_X:
+    case PPME_SYSCALL_FORK_20_X:
+    case PPME_SYSCALL_VFORK_20_X:
+    case PPME_SYSCALL_CLONE3_X:
+    {
+        // Parent side return value, the child tid may be a reused one
+        auto res_param = get_syscall_evt_param(evt.get_buf(), 0);
+        if (res_param.param_pointer != nullptr)
+        {
+            int64_t child_tid = *(int64_t*)(res_param.param_pointer);
+            if (child_tid > 0)
+            {
+                m_lineage_cache.invalidate(child_tid);
             }
-            break;
-        default:
-            break;
         }
         break;
     }
     default:
         break;
     }
-    return tstr;
 }
 
-bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::event_reader &evt, const falcosecurity::table_reader &tr, const std::vector<plugin_sinsp_filterchecks_field>& fields, std::string& behavior_profile_concat_str)
+behavior_profile_cache_entry& anomalydetection::get_cached_profile(profile_extraction_ctx& ctx, behavior_profile_cache_entry& entry, const std::vector<plugin_sinsp_filterchecks_field>& fields)
+{
+    uint64_t evtnum = ctx.evt.get_num();
+    if (entry.evtnum != evtnum)
+    {
+        // Invalidate first, the extraction below may throw and must not leave a stale profile behind
+        entry.evtnum = UINT64_MAX;
+        entry.has_digest = false;
+        entry.has_estimate = false;
+        entry.sketch_resolved = false;
+        entry.sketch = nullptr;
+        entry.profile.clear();
+        entry.extracted = extract_filterchecks_concat_profile(ctx, fields, entry.profile);
+        entry.evtnum = evtnum;
+    }
+    return entry;
+}
+
+behavior_profile_cache_entry& anomalydetection::get_behavior_profile(profile_extraction_ctx& ctx, uint32_t index)
+{
+    return get_cached_profile(ctx, m_behavior_profiles_cache[index], m_behavior_profiles_fields[index]);
+}
+
+behavior_profile_cache_entry& anomalydetection::get_bloom_profile(profile_extraction_ctx& ctx, uint32_t index)
+{
+    return get_cached_profile(ctx, m_bloom_profiles_cache[index], m_bloom_profiles_fields[index]);
+}
+
+const std::string& anomalydetection::resolve_container_id(profile_extraction_ctx& ctx)
+{
+    if (!ctx.container_resolved)
+    {
+        ctx.container_resolved = true;
+        if (resolve_thread_entry(ctx))
+        {
+            m_container_id.read_value(ctx.tr, ctx.thread_entry.value(), ctx.container_id);
+            ctx.container_index = m_container_sketches.find(ctx.container_id);
+        }
+    }
+    return ctx.container_id;
+}
+
+const count_min_sketch_ptr* anomalydetection::resolve_sketch(profile_extraction_ctx& ctx, behavior_profile_cache_entry& entry, uint32_t index, bool create)
+{
+    if (!m_per_container[index])
+    {
+        return &m_count_min_sketches[index];
+    }
+    if (entry.sketch_resolved && (entry.sketch != nullptr || !create))
+    {
+        return entry.sketch;
+    }
+    entry.sketch_resolved = true;
+    entry.sketch = nullptr;
+
+    // The container id stays empty until the container plugin matched the cgroups of the thread
+    const auto& container_id = resolve_container_id(ctx);
+    if (container_id.empty() || container_id == "host")
+    {
+        entry.sketch = &m_count_min_sketches[index];
+        return entry.sketch;
+    }
+    uint64_t ts = ctx.evt.get_ts();
+    auto* slot = m_container_sketches.get(index, ctx.container_index);
+    if (slot == nullptr)
+    {
+        if (!create)
+        {
+            return nullptr;
+        }
+        auto sketch = make_count_min_sketch_of_type(index, true);
+        size_t bytes = std::visit([](const auto& s) { return (size_t)s->get_size_bytes(); }, sketch);
+        slot = &m_container_sketches.insert(index, container_id, count_min_sketch_slot{std::move(sketch), ts}, bytes);
+        ctx.container_index = m_container_sketches.find(container_id);
+        publish_container_sketch_metrics(index);
+    }
+    else if (m_reset_timers[index] > 0 && ts > slot->reset_ts && ts - slot->reset_ts >= m_reset_timers[index] * MILLISECOND_TO_NS)
+    {
+        // Sliding window sketches have no reset timer, see `parse_init_config`
+        std::visit([](const auto& s) { s->reset(); }, slot->sketch);
+        slot->reset_ts = ts;
+    }
+    entry.sketch = &slot->sketch;
+    return entry.sketch;
+}
+
+void anomalydetection::sweep_container_sketches(const falcosecurity::table_reader& tr, uint64_t ts)
+{
+    if (ts - m_last_container_sweep_ts < CONTAINER_SKETCHES_SWEEP_INTERVAL_NS)
+    {
+        return;
+    }
+    m_last_container_sweep_ts = ts;
+    std::vector<std::string> removed;
+    m_container_sketches.for_each_container([&](const std::string& container_id)
+        {
+            try
+            {
+                m_containers_table.get_entry(tr, container_id);
+            }
+            catch(const std::exception& e)
+            {
+                removed.push_back(container_id);
+            }
+        });
+    if (removed.empty())
+    {
+        return;
+    }
+    for (const auto& container_id : removed)
+    {
+        m_container_sketches.erase(container_id);
+    }
+    for (uint32_t i = 0; i < m_n_sketches; ++i)
+    {
+        if (m_per_container[i])
+        {
+            publish_container_sketch_metrics(i);
+        }
+    }
+}
+
+void anomalydetection::publish_container_sketch_metrics(uint32_t index)
+{
+    m_sketch_n_containers[index].store(m_container_sketches.size(index), std::memory_order_relaxed);
+    m_sketch_containers_memory[index].store(m_container_sketches.memory_bytes(index), std::memory_order_relaxed);
+    m_sketch_n_container_evictions[index].store(m_container_sketches.n_evictions(index), std::memory_order_relaxed);
+}
+
+// Only `DOUBLE_HASHING` sketches can be fed with the digest, computed once per event and profile
+static inline bool prepare_digest(behavior_profile_cache_entry& entry, plugin::anomalydetection::num::cms_hash_mode hash_mode)
+{
+    if (hash_mode != plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING)
+    {
+        return false;
+    }
+    ensure_digest(entry);
+    return true;
+}
+
+void anomalydetection::update_behavior_profile(behavior_profile_cache_entry& entry, uint32_t index, uint64_t ts, uint64_t count)
+{
+    if (auto& top_k = m_top_k[index])
+    {
+        // Heavy hitters are indexed by the digest, whatever the hash mode of the sketch
+        top_k->update(entry.profile, ensure_digest(entry).h1, count);
+    }
+    bool use_digest = prepare_digest(entry, m_hash_modes[index]);
+    if (m_async_sketches[index])
+    {
+        staged_update u{entry.digest, index, (uint32_t)std::min<uint64_t>(count, UINT32_MAX)};
+        if (!m_staging_ring->push(u))
+        {
+            // The drain worker lags behind, e.g. while a snapshot job runs on the scheduler thread
+            metric_inc(m_n_staging_ring_full);
+            drain_staged_updates(SIZE_MAX);
+            m_staging_ring->push(u);
+        }
+        return;
+    }
+    const auto* sketch_ptr = entry.sketch_resolved ? entry.sketch : &m_count_min_sketches[index];
+    if (sketch_ptr == nullptr)
+    {
+        return;
+    }
+    std::visit([&entry, use_digest, ts, count](const auto& sketch)
+        {
+            using S = typename std::decay_t<decltype(sketch)>::element_type;
+            using T = typename S::value_type;
+            if constexpr (plugin::anomalydetection::num::is_sliding_cms<S>::value)
+            {
+                sketch->advance(ts);
+            }
+            // Scaled increments of sampled profiles saturate like the counters
+            T n = (T)std::min<uint64_t>(count, std::numeric_limits<T>::max());
+            use_digest ? sketch->update(entry.digest, n) : sketch->update(std::string_view(entry.profile), n);
+        }, *sketch_ptr);
+}
+
+uint64_t anomalydetection::estimate_behavior_profile(behavior_profile_cache_entry& entry, uint32_t index, uint64_t ts)
+{
+    const auto* sketch_ptr = entry.sketch_resolved ? entry.sketch : &m_count_min_sketches[index];
+    if (entry.profile.empty() || sketch_ptr == nullptr)
+    {
+        return 0;
+    }
+    bool use_digest = prepare_digest(entry, m_hash_modes[index]);
+    // Staged increments are read first: one applied meanwhile counts twice rather than not at all
+    uint64_t pending = m_async_sketches[index] && m_async_include_pending ? m_staging_ring->pending(index, entry.digest) : 0;
+    return pending + std::visit([&entry, use_digest, ts](const auto& sketch) -> uint64_t
+        {
+            using S = typename std::decay_t<decltype(sketch)>::element_type;
+            if constexpr (plugin::anomalydetection::num::is_sliding_cms<S>::value)
+            {
+                // Drops expired buckets even if this profile did not subscribe to the current event
+                sketch->advance(ts);
+            }
+            return use_digest ? sketch->estimate(entry.digest) : sketch->estimate(std::string_view(entry.profile));
+        }, *sketch_ptr);
+}
+
+void anomalydetection::estimate_behavior_profiles_batch(profile_extraction_ctx& ctx)
+{
+    auto evt_type = ctx.evt.get_type();
+    if (evt_type >= m_event_code_sketches.size())
+    {
+        return;
+    }
+    uint64_t evtnum = ctx.evt.get_num();
+    uint64_t ts = ctx.evt.get_ts();
+    const auto& indices = m_event_code_sketches[evt_type];
+
+    // Only profiles `parse_event` already built for this event, nothing is extracted on behalf of fields
+    // that may never be read. First pass: hash once and hint all cache lines the estimates will touch.
+    for (const auto i : indices)
+    {
+        auto& entry = m_behavior_profiles_cache[i];
+        if (entry.evtnum != evtnum || !entry.extracted || entry.has_estimate || entry.profile.empty() ||
+            !prepare_digest(entry, m_hash_modes[i]))
+        {
+            continue;
+        }
+        const auto* sketch = resolve_sketch(ctx, entry, i, false);
+        if (sketch != nullptr)
+        {
+            std::visit([&entry](const auto& s) { s->prefetch(entry.digest); }, *sketch);
+        }
+    }
+    // Second pass: the probes now mostly hit the cache or overlap their misses
+    for (const auto i : indices)
+    {
+        auto& entry = m_behavior_profiles_cache[i];
+        if (entry.evtnum != evtnum || !entry.extracted || entry.has_estimate)
+        {
+            continue;
+        }
+        resolve_sketch(ctx, entry, i, false);
+        entry.estimate = estimate_behavior_profile(entry, i, ts);
+        entry.has_estimate = true;
+    }
+}
+
+bool anomalydetection::extract_filterchecks_concat_profile(profile_extraction_ctx& ctx, const std::vector<plugin_sinsp_filterchecks_field>& fields, std::string& behavior_profile_concat_str)
 {
     using st = falcosecurity::state_value_type;
 
-    int64_t thread_id = evt.get_tid();
+    auto& evt = ctx.evt;
+    auto& tr = ctx.tr;
     std::string tstr;
-    std::optional<falcosecurity::table_entry> thread_entry_opt;
-    try
-    {
-        thread_entry_opt = m_thread_table.get_entry(tr, thread_id);
-    } catch (const std::exception& e)
+    if (!resolve_thread_entry(ctx))
     {
         for (const auto& field : fields)
         {
-            behavior_profile_concat_str += extract_filterchecks_evt_params_fallbacks(evt, field);
+            behavior_profile_concat_str += extract_filterchecks_evt_params_fallbacks(ctx, field);
         }
         return true;
     }
-    auto& thread_entry = thread_entry_opt.value();
+    auto& thread_entry = ctx.thread_entry.value();
 
     // Create a concatenated string formed out of each field per behavior profile
     // No concept of null fields (instead its always an empty string) compared to libsinsp
@@ -893,132 +2342,55 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
             break;
         case plugin_sinsp_filterchecks::TYPE_PNAME:
         {
-            m_ptid.read_value(tr, thread_entry, ptid);
-            auto lineage = m_thread_table.get_entry(tr, ptid);
+            auto& lineage = resolve_parent_entry(ctx);
             m_comm.read_value(tr, lineage, tstr);
             break;
         }
-        case plugin_sinsp_filterchecks::TYPE_ANAME:
-        {
-            // todo: check implications of main thread as it's part of the libs implementation
-            if(field.argid < 1)
-            {
-                m_comm.read_value(tr, thread_entry, tstr);
-                break;
-            }
-            m_ptid.read_value(tr, thread_entry, ptid);
-            for(uint32_t j = 0; j < field.argid; j++)
-            {
-                try
-                {
-                    auto lineage = m_thread_table.get_entry(tr, ptid);
-                    if(j == (field.argid - 1))
-                    {
-                        m_comm.read_value(tr, lineage, tstr);
-                        break;
-                    }
-                    if(ptid == 1)
-                    {
-                        break;
-                    }
-                    m_ptid.read_value(tr, lineage, ptid);
-                }
-                catch(const std::exception& e)
-                {
-                }
+        case plugin_sinsp_filterchecks::TYPE_ANAME:
+        {
+            // todo: check implications of main thread as it's part of the libs implementation
+            if(field.argid < 1)
+            {
+                m_comm.read_value(tr, thread_entry, tstr);
+                break;
+            }
+            if (const auto* ancestor = resolve_ancestor(ctx, field.argid))
+            {
+                tstr = ancestor->comm;
             }
             break;
         }
         case plugin_sinsp_filterchecks::TYPE_ARGS:
         {
-            const char* arg = nullptr;
-            auto args_table = m_thread_table.get_subtable(tr, m_args, thread_entry, st::SS_PLUGIN_ST_INT64);
-            args_table.iterate_entries(tr, [this, &tr, &arg, &tstr](const falcosecurity::table_entry& e)
-                {
-                    arg = nullptr;
-                    m_args_value.read_value(tr, e, arg);
-                    if (!tstr.empty())
-                    {
-                        tstr += " ";
-                    }
-                    if (arg)
-                    {
-                        tstr += arg;
-                    }
-                    return true;
-                });
+            append_args(tstr, resolve_args(ctx));
             break;
         }
         case plugin_sinsp_filterchecks::TYPE_CMDNARGS:
         {
-            const char* arg = nullptr;
-            size_t c = 0;
-            auto args_table = m_thread_table.get_subtable(tr, m_args, thread_entry, st::SS_PLUGIN_ST_INT64);
-            args_table.iterate_entries(tr, [this, &c](const falcosecurity::table_entry& e)
-                {
-                    c++;
-                    return true;
-                });
-            tstr = std::to_string(c);
+            tstr = std::to_string(resolve_args(ctx).size());
             break;
         }
         case plugin_sinsp_filterchecks::TYPE_CMDLENARGS:
         {
-            const char* arg = nullptr;
             size_t c = 0;
-            auto args_table = m_thread_table.get_subtable(tr, m_args, thread_entry, st::SS_PLUGIN_ST_INT64);
-            args_table.iterate_entries(tr, [this, &tr, &arg, &c](const falcosecurity::table_entry& e)
-                {
-                    arg = nullptr;
-                    m_args_value.read_value(tr, e, arg);
-                    c+=std::strlen(arg);
-                    return true;
-                });
+            for (const auto& arg : resolve_args(ctx))
+            {
+                c += arg.size();
+            }
             tstr = std::to_string(c);
             break;
         }
         case plugin_sinsp_filterchecks::TYPE_CMDLINE:
         {
             m_comm.read_value(tr, thread_entry, tstr);
-            const char* arg = nullptr;
-            auto args_table = m_thread_table.get_subtable(tr, m_args, thread_entry, st::SS_PLUGIN_ST_INT64);
-            args_table.iterate_entries(tr, [this, &tr, &arg, &tstr](const falcosecurity::table_entry& e)
-                {
-                    arg = nullptr;
-                    m_args_value.read_value(tr, e, arg);
-                    if (!tstr.empty())
-                    {
-                        tstr += " ";
-                    }
-                    if (arg)
-                    {
-                        tstr += arg;
-                    }
-                    return true;
-                });
+            append_args(tstr, resolve_args(ctx));
             break;
         }
         case plugin_sinsp_filterchecks::TYPE_PCMDLINE:
         {
-            m_ptid.read_value(tr, thread_entry, ptid);
-            auto lineage = m_thread_table.get_entry(tr, ptid);
+            auto& lineage = resolve_parent_entry(ctx);
             m_comm.read_value(tr, lineage, tstr);
-            const char* arg = nullptr;
-            auto args_table = m_thread_table.get_subtable(tr, m_args, lineage, st::SS_PLUGIN_ST_INT64);
-            args_table.iterate_entries(tr, [this, &tr, &arg, &tstr](const falcosecurity::table_entry& e)
-                {
-                    arg = nullptr;
-                    m_args_value.read_value(tr, e, arg);
-                    if (!tstr.empty())
-                    {
-                        tstr += " ";
-                    }
-                    if (arg)
-                    {
-                        tstr += arg;
-                    }
-                    return true;
-                });
+            append_args(tstr, resolve_parent_args(ctx));
             break;
         }
         case plugin_sinsp_filterchecks::TYPE_ACMDLINE:
@@ -1026,82 +2398,19 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
             if(field.argid < 1)
             {
                 m_comm.read_value(tr, thread_entry, tstr);
-                const char* arg = nullptr;
-                auto args_table = m_thread_table.get_subtable(tr, m_args, thread_entry, st::SS_PLUGIN_ST_INT64);
-                args_table.iterate_entries(tr, [this, &tr, &arg, &tstr](const falcosecurity::table_entry& e)
-                    {
-                        arg = nullptr;
-                        m_args_value.read_value(tr, e, arg);
-                        if (!tstr.empty())
-                        {
-                            tstr += " ";
-                        }
-                        if (arg)
-                        {
-                            tstr += arg;
-                        }
-                        return true;
-                    });
+                append_args(tstr, resolve_args(ctx));
                 break;
             }
-            m_ptid.read_value(tr, thread_entry, ptid);
-            for(uint32_t j = 0; j < field.argid; j++)
+            if (auto* ancestor = resolve_ancestor(ctx, field.argid))
             {
-                try
-                {
-                    auto lineage = m_thread_table.get_entry(tr, ptid);
-                    if(j == (field.argid - 1))
-                    {
-                        m_comm.read_value(tr, lineage, tstr);
-                        const char* arg = nullptr;
-                        auto args_table = m_thread_table.get_subtable(tr, m_args, lineage, st::SS_PLUGIN_ST_INT64);
-                        args_table.iterate_entries(tr, [this, &tr, &arg, &tstr](const falcosecurity::table_entry& e)
-                            {
-                                arg = nullptr;
-                                m_args_value.read_value(tr, e, arg);
-                                if (!tstr.empty())
-                                {
-                                    tstr += " ";
-                                }
-                                if (arg)
-                                {
-                                    tstr += arg;
-                                }
-                                return true;
-                            });
-                        break;
-                    }
-                    if(ptid == 1)
-                    {
-                        break;
-                    }
-                    m_ptid.read_value(tr, lineage, ptid);
-                }
-                catch(const std::exception& e)
-                {
-                }
+                tstr = resolve_ancestor_cmdline(ctx, *ancestor);
             }
             break;
         }
         case plugin_sinsp_filterchecks::TYPE_EXELINE:
         {
             m_exe.read_value(tr, thread_entry, tstr);
-            const char* arg = nullptr;
-            auto args_table = m_thread_table.get_subtable(tr, m_args, thread_entry, st::SS_PLUGIN_ST_INT64);
-            args_table.iterate_entries(tr, [this, &tr, &arg, &tstr](const falcosecurity::table_entry& e)
-                {
-                    arg = nullptr;
-                    m_args_value.read_value(tr, e, arg);
-                    if (!tstr.empty())
-                    {
-                        tstr += " ";
-                    }
-                    if (arg)
-                    {
-                        tstr += arg;
-                    }
-                    return true;
-                });
+            append_args(tstr, resolve_args(ctx));
             break;
         }
         case plugin_sinsp_filterchecks::TYPE_EXE:
@@ -1109,8 +2418,7 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
             break;
         case plugin_sinsp_filterchecks::TYPE_PEXE:
         {
-            m_ptid.read_value(tr, thread_entry, ptid);
-            auto lineage = m_thread_table.get_entry(tr, ptid);
+            auto& lineage = resolve_parent_entry(ctx);
             m_exe.read_value(tr, lineage, tstr);
             break;
         }
@@ -1121,26 +2429,9 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
                 m_exe.read_value(tr, thread_entry, tstr);
                 break;
             }
-            m_ptid.read_value(tr, thread_entry, ptid);
-            for(uint32_t j = 0; j < field.argid; j++)
+            if (const auto* ancestor = resolve_ancestor(ctx, field.argid))
             {
-                try
-                {
-                    auto lineage = m_thread_table.get_entry(tr, ptid);
-                    if(j == (field.argid - 1))
-                    {
-                        m_exe.read_value(tr, lineage, tstr);
-                        break;
-                    }
-                    if(ptid == 1)
-                    {
-                        break;
-                    }
-                    m_ptid.read_value(tr, lineage, ptid);
-                }
-                catch(const std::exception& e)
-                {
-                }
+                tstr = ancestor->exe;
             }
             break;
         }
@@ -1149,8 +2440,7 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
             break;
         case plugin_sinsp_filterchecks::TYPE_PEXEPATH:
         {
-            m_ptid.read_value(tr, thread_entry, ptid);
-            auto lineage = m_thread_table.get_entry(tr, ptid);
+            auto& lineage = resolve_parent_entry(ctx);
             m_exepath.read_value(tr, lineage, tstr);
             break;
         }
@@ -1161,26 +2451,9 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
                 m_exepath.read_value(tr, thread_entry, tstr);
                 break;
             }
-            m_ptid.read_value(tr, thread_entry, ptid);
-            for(uint32_t j = 0; j < field.argid; j++)
+            if (const auto* ancestor = resolve_ancestor(ctx, field.argid))
             {
-                try
-                {
-                    auto lineage = m_thread_table.get_entry(tr, ptid);
-                    if(j == (field.argid - 1))
-                    {
-                        m_exepath.read_value(tr, lineage, tstr);
-                        break;
-                    }
-                    if(ptid == 1)
-                    {
-                        break;
-                    }
-                    m_ptid.read_value(tr, lineage, ptid);
-                }
-                catch(const std::exception& e)
-                {
-                }
+                tstr = ancestor->exepath;
             }
             break;
         }
@@ -1197,8 +2470,7 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
             break;
         case plugin_sinsp_filterchecks::TYPE_PPID:
             {
-                m_ptid.read_value(tr, thread_entry, ptid);
-                auto lineage = m_thread_table.get_entry(tr, ptid);
+                auto& lineage = resolve_parent_entry(ctx);
                 m_pid.read_value(tr, lineage, tint64);
                 tstr = std::to_string(tint64);
                 break;
@@ -1211,27 +2483,9 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
                 tstr = std::to_string(tint64);
                 break;
             }
-            m_ptid.read_value(tr, thread_entry, ptid);
-            for(uint32_t j = 0; j < field.argid; j++)
+            if (const auto* ancestor = resolve_ancestor(ctx, field.argid))
             {
-                try
-                {
-                    auto lineage = m_thread_table.get_entry(tr, ptid);
-                    if(j == (field.argid - 1))
-                    {
-                        m_pid.read_value(tr, lineage, tint64);
-                        tstr = std::to_string(tint64);
-                        break;
-                    }
-                    if(ptid == 1)
-                    {
-                        break;
-                    }
-                    m_ptid.read_value(tr, lineage, ptid);
-                }
-                catch(const std::exception& e)
-                {
-                }
+                tstr = std::to_string(ancestor->pid);
             }
             break;
         }
@@ -1241,8 +2495,7 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
             break;
         case plugin_sinsp_filterchecks::TYPE_PVPID:
             {
-                m_ptid.read_value(tr, thread_entry, ptid);
-                auto lineage = m_thread_table.get_entry(tr, ptid);
+                auto& lineage = resolve_parent_entry(ctx);
                 m_vpid.read_value(tr, lineage, tint64);
                 tstr = std::to_string(tint64);
                 break;
@@ -1545,7 +2798,7 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
                 tstr = std::to_string(tint64);
                 if (tstr.empty())
                 {
-                    tstr = extract_filterchecks_evt_params_fallbacks(evt, field);
+                    tstr = extract_filterchecks_evt_params_fallbacks(ctx, field);
                 }
                 break;
             }
@@ -1564,67 +2817,44 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
             case PPME_SOCKET_CONNECT_X:
             case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
             {
-                try
-                {
-                    auto fd_table = m_thread_table.get_subtable(
-                    tr, m_fds, thread_entry,
-                    st::SS_PLUGIN_ST_INT64);
-                    m_lastevent_fd_field.read_value(tr, thread_entry, tint64);
-                    auto fd_entry = fd_table.get_entry(tr, tint64);
-                    m_fd_name_value.read_value(tr, fd_entry, tstr);
-                }
-                catch(const std::exception& e)
+                if (auto* fd_entry = resolve_fd_entry(ctx))
                 {
+                    m_fd_name_value.read_value(tr, *fd_entry, tstr);
                 }
                 if (tstr.empty())
                 {
-                    tstr = extract_filterchecks_evt_params_fallbacks(evt, field);
+                    tstr = extract_filterchecks_evt_params_fallbacks(ctx, field);
                 }
                 break;
             }
             case PPME_SYSCALL_OPEN_X:
             case PPME_SYSCALL_CREAT_X:
             {
-                try
-                {
-                    auto fd_table = m_thread_table.get_subtable(
-                    tr, m_fds, thread_entry,
-                    st::SS_PLUGIN_ST_INT64);
-                    m_lastevent_fd_field.read_value(tr, thread_entry, tint64);
-                    auto fd_entry = fd_table.get_entry(tr, tint64);
-                    m_fd_name_value.read_value(tr, fd_entry, tstr);
-                }
-                catch(const std::exception& e)
+                if (auto* fd_entry = resolve_fd_entry(ctx))
                 {
+                    m_fd_name_value.read_value(tr, *fd_entry, tstr);
                 }
                 if (tstr.empty())
                 {
-                    std::string cwd;
+                    auto& cwd = m_fallback_dir;
+                    cwd.clear();
                     m_cwd.read_value(tr, thread_entry, cwd);
-                    tstr = extract_filterchecks_evt_params_fallbacks(evt, field, cwd);
+                    tstr = extract_filterchecks_evt_params_fallbacks(ctx, field, cwd);
                 }
                 break;
             }
             case PPME_SYSCALL_OPENAT_2_X:
             case PPME_SYSCALL_OPENAT2_X:
             {
-                try
-                {
-                    auto fd_table = m_thread_table.get_subtable(
-                    tr, m_fds, thread_entry,
-                    st::SS_PLUGIN_ST_INT64);
-                    m_lastevent_fd_field.read_value(tr, thread_entry, tint64);
-                    auto fd_entry = fd_table.get_entry(tr, tint64);
-                    m_fd_name_value.read_value(tr, fd_entry, tstr);
-                }
-                catch(const std::exception& e)
+                if (auto* fd_entry = resolve_fd_entry(ctx))
                 {
+                    m_fd_name_value.read_value(tr, *fd_entry, tstr);
                 }
                 if (tstr.empty())
                 {
-                    auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                1);
-                    std::string cwd;
+                    auto res_param = resolve_params(ctx).get(1);
+                    auto& cwd = m_fallback_dir;
+                    cwd.clear();
                     if (res_param.param_pointer != nullptr)
                     {
                         int64_t dirfd = *(uint64_t*)(res_param.param_pointer);
@@ -1647,7 +2877,7 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
                         {
                         }
                     }
-                    tstr = extract_filterchecks_evt_params_fallbacks(evt, field, cwd);
+                    tstr = extract_filterchecks_evt_params_fallbacks(ctx, field, cwd);
                 }
                 break;
             }
@@ -1666,66 +2896,49 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
             case PPME_SYSCALL_OPEN_X:
             case PPME_SYSCALL_CREAT_X:
             {
-                try
-                {
-                    auto fd_table = m_thread_table.get_subtable(
-                    tr, m_fds, thread_entry,
-                    st::SS_PLUGIN_ST_INT64);
-                    m_lastevent_fd_field.read_value(tr, thread_entry, tint64);
-                    auto fd_entry = fd_table.get_entry(tr, tint64);
-                    m_fd_name_value.read_value(tr, fd_entry, tstr);
-                }
-                catch(const std::exception& e)
+                if (auto* fd_entry = resolve_fd_entry(ctx))
                 {
+                    m_fd_name_value.read_value(tr, *fd_entry, tstr);
                 }
                 if (tstr.empty())
                 {
-                    std::string cwd;
+                    auto& cwd = m_fallback_dir;
+                    cwd.clear();
                     m_cwd.read_value(tr, thread_entry, cwd);
-                    tstr = extract_filterchecks_evt_params_fallbacks(evt, field, cwd);
+                    tstr = extract_filterchecks_evt_params_fallbacks(ctx, field, cwd);
                 }
                 size_t pos = tstr.find_last_of('/');
                 if (pos != std::string::npos)
                 {
                     if (field.id == plugin_sinsp_filterchecks::TYPE_DIRECTORY)
                     {
-                        tstr = tstr.substr(0, pos);
+                        tstr.resize(pos);
                     } else
                     {
-
-                        tstr = tstr.substr(pos + 1);
+                        tstr.erase(0, pos + 1);
                     }
                 }
                 break;
             }
             case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
             {
-                try
-                {
-                    auto fd_table = m_thread_table.get_subtable(
-                    tr, m_fds, thread_entry,
-                    st::SS_PLUGIN_ST_INT64);
-                    m_lastevent_fd_field.read_value(tr, thread_entry, tint64);
-                    auto fd_entry = fd_table.get_entry(tr, tint64);
-                    m_fd_name_value.read_value(tr, fd_entry, tstr);
-                }
-                catch(const std::exception& e)
+                if (auto* fd_entry = resolve_fd_entry(ctx))
                 {
+                    m_fd_name_value.read_value(tr, *fd_entry, tstr);
                 }
                 if (tstr.empty())
                 {
-                    tstr = extract_filterchecks_evt_params_fallbacks(evt, field);
+                    tstr = extract_filterchecks_evt_params_fallbacks(ctx, field);
                 }
                 size_t pos = tstr.find_last_of('/');
                 if (pos != std::string::npos)
                 {
                     if (field.id == plugin_sinsp_filterchecks::TYPE_DIRECTORY)
                     {
-                        tstr = tstr.substr(0, pos);
+                        tstr.resize(pos);
                     } else
                     {
-
-                        tstr = tstr.substr(pos + 1);
+                        tstr.erase(0, pos + 1);
                     }
                 }
                 break;
@@ -1733,23 +2946,15 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
             case PPME_SYSCALL_OPENAT_2_X:
             case PPME_SYSCALL_OPENAT2_X:
             {
-                try
-                {
-                    auto fd_table = m_thread_table.get_subtable(
-                    tr, m_fds, thread_entry,
-                    st::SS_PLUGIN_ST_INT64);
-                    m_lastevent_fd_field.read_value(tr, thread_entry, tint64);
-                    auto fd_entry = fd_table.get_entry(tr, tint64);
-                    m_fd_name_value.read_value(tr, fd_entry, tstr);
-                }
-                catch(const std::exception& e)
+                if (auto* fd_entry = resolve_fd_entry(ctx))
                 {
+                    m_fd_name_value.read_value(tr, *fd_entry, tstr);
                 }
                 if (tstr.empty())
                 {
-                    auto res_param = get_syscall_evt_param(evt.get_buf(),
-                                                1);
-                    std::string cwd;
+                    auto res_param = resolve_params(ctx).get(1);
+                    auto& cwd = m_fallback_dir;
+                    cwd.clear();
                     if (res_param.param_pointer != nullptr)
                     {
                         int64_t dirfd = *(uint64_t*)(res_param.param_pointer);
@@ -1772,18 +2977,17 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
                         {
                         }
                     }
-                    tstr = extract_filterchecks_evt_params_fallbacks(evt, field, cwd);
+                    tstr = extract_filterchecks_evt_params_fallbacks(ctx, field, cwd);
                 }
                 size_t pos = tstr.find_last_of('/');
                 if (pos != std::string::npos)
                 {
                     if (field.id == plugin_sinsp_filterchecks::TYPE_DIRECTORY)
                     {
-                        tstr = tstr.substr(0, pos);
+                        tstr.resize(pos);
                     } else
                     {
-
-                        tstr = tstr.substr(pos + 1);
+                        tstr.erase(0, pos + 1);
                     }
                 }
                 break;
@@ -1811,22 +3015,14 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
             case PPME_SYSCALL_OPENAT2_X:
             case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
             {
-                try
+                if (auto* fd_entry = resolve_fd_entry(ctx))
                 {
-                    auto fd_table = m_thread_table.get_subtable(
-                    tr, m_fds, thread_entry,
-                    st::SS_PLUGIN_ST_INT64);
-                    m_lastevent_fd_field.read_value(tr, thread_entry, tint64);
-                    auto fd_entry = fd_table.get_entry(tr, tint64);
-                    m_fd_ino_value.read_value(tr, fd_entry, tint64);
+                    m_fd_ino_value.read_value(tr, *fd_entry, tint64);
                     tstr = std::to_string(tint64);
                 }
-                catch(const std::exception& e)
-                {
-                }
                 if (tstr.empty())
                 {
-                    tstr = extract_filterchecks_evt_params_fallbacks(evt, field);
+                    tstr = extract_filterchecks_evt_params_fallbacks(ctx, field);
                 }
                 break;
             }
@@ -1853,22 +3049,14 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
             case PPME_SYSCALL_OPENAT2_X:
             case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
             {
-                try
+                if (auto* fd_entry = resolve_fd_entry(ctx))
                 {
-                    auto fd_table = m_thread_table.get_subtable(
-                    tr, m_fds, thread_entry,
-                    st::SS_PLUGIN_ST_INT64);
-                    m_lastevent_fd_field.read_value(tr, thread_entry, tint64);
-                    auto fd_entry = fd_table.get_entry(tr, tint64);
-                    m_fd_dev_value.read_value(tr, fd_entry, tuint32);
+                    m_fd_dev_value.read_value(tr, *fd_entry, tuint32);
                     tstr = std::to_string(tuint32);
                 }
-                catch(const std::exception& e)
-                {
-                }
                 if (tstr.empty())
                 {
-                    tstr = extract_filterchecks_evt_params_fallbacks(evt, field);
+                    tstr = extract_filterchecks_evt_params_fallbacks(ctx, field);
                 }
                 break;
             }
@@ -1895,21 +3083,13 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
             case PPME_SYSCALL_OPENAT2_X:
             case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
             {
-                try
-                {
-                    auto fd_table = m_thread_table.get_subtable(
-                    tr, m_fds, thread_entry,
-                    st::SS_PLUGIN_ST_INT64);
-                    m_lastevent_fd_field.read_value(tr, thread_entry, tint64);
-                    auto fd_entry = fd_table.get_entry(tr, tint64);
-                    m_fd_nameraw_value.read_value(tr, fd_entry, tstr);
-                }
-                catch(const std::exception& e)
+                if (auto* fd_entry = resolve_fd_entry(ctx))
                 {
+                    m_fd_nameraw_value.read_value(tr, *fd_entry, tstr);
                 }
                 if (tstr.empty())
                 {
-                    tstr = extract_filterchecks_evt_params_fallbacks(evt, field);
+                    tstr = extract_filterchecks_evt_params_fallbacks(ctx, field);
                 }
                 break;
             }
@@ -1938,29 +3118,14 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
                 break;
             }
             m_comm.read_value(tr, thread_entry, tstr);
-            m_ptid.read_value(tr, thread_entry, ptid);
-            std::string tstr2;
-            for(uint32_t j = 0; j < field.argid; j++)
+            for(uint32_t j = 1; j <= field.argid; j++)
             {
-                try
-                {
-                    auto lineage = m_thread_table.get_entry(tr, ptid);
-                    m_comm.read_value(tr, lineage, tstr2);
-                    tstr += tstr2;
-                    tstr2.clear();
-                    if(j == (field.argid - 1))
-                    {
-                        break;
-                    }
-                    if(ptid == 1)
-                    {
-                        break;
-                    }
-                    m_ptid.read_value(tr, lineage, ptid);
-                }
-                catch(const std::exception& e)
+                const auto* ancestor = resolve_ancestor(ctx, j);
+                if (ancestor == nullptr)
                 {
+                    break;
                 }
+                tstr += ancestor->comm;
             }
             break;
         }
@@ -1971,29 +3136,14 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
                 break;
             }
             m_exe.read_value(tr, thread_entry, tstr);
-            m_ptid.read_value(tr, thread_entry, ptid);
-            std::string tstr2;
-            for(uint32_t j = 0; j < field.argid; j++)
+            for(uint32_t j = 1; j <= field.argid; j++)
             {
-                try
-                {
-                    auto lineage = m_thread_table.get_entry(tr, ptid);
-                    m_exe.read_value(tr, lineage, tstr2);
-                    tstr += tstr2;
-                    tstr2.clear();
-                    if(j == (field.argid - 1))
-                    {
-                        break;
-                    }
-                    if(ptid == 1)
-                    {
-                        break;
-                    }
-                    m_ptid.read_value(tr, lineage, ptid);
-                }
-                catch(const std::exception& e)
+                const auto* ancestor = resolve_ancestor(ctx, j);
+                if (ancestor == nullptr)
                 {
+                    break;
                 }
+                tstr += ancestor->exe;
             }
             break;
         }
@@ -2004,29 +3154,14 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
                 break;
             }
             m_exepath.read_value(tr, thread_entry, tstr);
-            m_ptid.read_value(tr, thread_entry, ptid);
-            std::string tstr2;
-            for(uint32_t j = 0; j < field.argid; j++)
+            for(uint32_t j = 1; j <= field.argid; j++)
             {
-                try
-                {
-                    auto lineage = m_thread_table.get_entry(tr, ptid);
-                    m_exepath.read_value(tr, lineage, tstr2);
-                    tstr += tstr2;
-                    tstr2.clear();
-                    if(j == (field.argid - 1))
-                    {
-                        break;
-                    }
-                    if(ptid == 1)
-                    {
-                        break;
-                    }
-                    m_ptid.read_value(tr, lineage, ptid);
-                }
-                catch(const std::exception& e)
+                const auto* ancestor = resolve_ancestor(ctx, j);
+                if (ancestor == nullptr)
                 {
+                    break;
                 }
+                tstr += ancestor->exepath;
             }
             break;
         }
@@ -2047,21 +3182,13 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
             case PPME_SOCKET_ACCEPT4_6_X:
             case PPME_SOCKET_CONNECT_X:
             {
-                try
-                {
-                    auto fd_table = m_thread_table.get_subtable(
-                    tr, m_fds, thread_entry,
-                    st::SS_PLUGIN_ST_INT64);
-                    m_lastevent_fd_field.read_value(tr, thread_entry, tint64);
-                    auto fd_entry = fd_table.get_entry(tr, tint64);
-                    m_fd_name_value.read_value(tr, fd_entry, tstr);
-                }
-                catch(const std::exception& e)
+                if (auto* fd_entry = resolve_fd_entry(ctx))
                 {
+                    m_fd_name_value.read_value(tr, *fd_entry, tstr);
                 }
                 if (tstr.empty())
                 {
-                    tstr = extract_filterchecks_evt_params_fallbacks(evt, field);
+                    tstr = extract_filterchecks_evt_params_fallbacks(ctx, field);
                 }
                 std::string delimiter = "->";
                 size_t pos = tstr.find(delimiter);
@@ -2100,10 +3227,10 @@ bool anomalydetection::extract_filterchecks_concat_profile(const falcosecurity::
 bool anomalydetection::parse_event(const falcosecurity::parse_event_input& in)
 {
     /* Note: While we have set the stage for supporting multiple algorithms in this plugin, 
-       the approach is currently designed specific to the count_min_sketch use case only. 
+       the approach is currently designed specific to the count_min_sketch and bloom_filter use cases only. 
        This will be refactored and refined in the future.
     */
-    if (!m_count_min_sketch_enabled)
+    if (!m_count_min_sketch_enabled && !m_bloom_filter_enabled)
     {
         return true;
     }
@@ -2113,6 +3240,27 @@ bool anomalydetection::parse_event(const falcosecurity::parse_event_input& in)
     auto& tw = in.get_table_writer();
     int64_t thread_id = evt.get_tid();
 
+    // Nothing to do for events no behavior profile subscribed to, including the fd bookkeeping below
+    // which only serves the profiles of the same event
+    auto evt_type = evt.get_type();
+    if (m_lineage_cache_enabled && is_lineage_invalidation_event(evt_type))
+    {
+        invalidate_lineage(evt);
+    }
+    bool has_sketches = evt_type < m_event_code_sketches.size() && !m_event_code_sketches[evt_type].empty();
+    bool has_bloom_filters = evt_type < m_event_code_bloom_filters.size() && !m_event_code_bloom_filters[evt_type].empty();
+    if (!has_sketches && !has_bloom_filters)
+    {
+        return true;
+    }
+
+    metric_inc(m_n_events_parsed);
+    profile_extraction_ctx ctx(evt, tr);
+    if (m_has_containers_table)
+    {
+        sweep_container_sketches(tr, evt.get_ts());
+    }
+
     // Note: Plugin event parsing guaranteed to happen after libs' `sinsp_parser::process_event` has finished.
     // Needs to stay in sync w/ falcosecurity/libs updates.
 
@@ -2128,60 +3276,104 @@ bool anomalydetection::parse_event(const falcosecurity::parse_event_input& in)
     case PPME_SYSCALL_OPENAT2_X:
     case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
     {
-        auto res_param = get_syscall_evt_param(in.get_event_reader().get_buf(),
-                                           0);
+        auto res_param = resolve_params(ctx).get(0);
         if (res_param.param_pointer == nullptr)
         {
             return false;
         }
 
         int64_t fd = *(int64_t*)(res_param.param_pointer);
-        auto thread_entry = m_thread_table.get_entry(tr, thread_id);
-        m_lastevent_fd_field.write_value(tw, thread_entry, fd);
+        // The thread entry is shared with the profile extraction below
+        if (!resolve_thread_entry(ctx))
+        {
+            return false;
+        }
+        m_lastevent_fd_field.write_value(tw, ctx.thread_entry.value(), fd);
+        ctx.lastevent_fd = fd;
         break;
     }
     case PPME_SOCKET_CONNECT_X: // fd param 2
     {
-        auto res_param = get_syscall_evt_param(in.get_event_reader().get_buf(),
-                                           2);
+        auto res_param = resolve_params(ctx).get(2);
         if (res_param.param_pointer == nullptr)
         {
             return false;
         }
         int64_t fd = *(int64_t*)(res_param.param_pointer);
-        auto thread_entry = m_thread_table.get_entry(tr, thread_id);
-        m_lastevent_fd_field.write_value(tw, thread_entry, fd);
+        // The thread entry is shared with the profile extraction below
+        if (!resolve_thread_entry(ctx))
+        {
+            return false;
+        }
+        m_lastevent_fd_field.write_value(tw, ctx.thread_entry.value(), fd);
+        ctx.lastevent_fd = fd;
         break;
     }
     default:
         break;
     }
 
-    // Loop over behavior profiles, extract profile fields and update the count_min_sketch counts.
-    int i = 0;
-    std::string behavior_profile_concat_str;
-    for(const auto& set : m_behavior_profiles_event_codes)
+    // Loop over the behavior profiles subscribed to this event, extract profile fields and update the count_min_sketch counts.
+    if(thread_id <= 0)
+    {
+        return false;
+    }
+    latency_sampler sampler(evt.get_num() % METRICS_LATENCY_SAMPLING_RATE == 0);
+    // Adaptive sampling is fed the time of the same events as the latency metrics
+    bool timed = m_adaptive_sampling.enabled() && evt.get_num() % METRICS_LATENCY_SAMPLING_RATE == 0;
+    auto start = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    uint64_t sampling_multiplier = m_adaptive_sampling.get_multiplier();
+    static const std::vector<uint32_t> no_indices;
+    for(const auto i : has_sketches ? m_event_code_sketches[evt_type] : no_indices)
     {
-        if(set.find((ppm_event_code)evt.get_type()) != set.end())
+        try
         {
-            if(thread_id <= 0)
+            // Sampled out events neither extract the profile nor update the sketch
+            uint64_t count = m_samplers[i].next(sampling_multiplier);
+            if (count == 0)
             {
-                return false;
+                metric_inc(m_sketch_n_sampled_out[i]);
+                continue;
             }
-            try
+            sampler.restart();
+            auto& entry = get_behavior_profile(ctx, i);
+            sampler.lap(m_profile_extraction_latency);
+            if (entry.extracted && !entry.profile.empty())
             {
-                behavior_profile_concat_str.clear();
-                if (i < m_n_sketches && extract_filterchecks_concat_profile(evt, tr, m_behavior_profiles_fields[i], behavior_profile_concat_str) && !behavior_profile_concat_str.empty())
-                {
-                    m_count_min_sketches.lock()->at(i).get()->update(behavior_profile_concat_str, (uint64_t)1);
-                }
+                resolve_sketch(ctx, entry, i, true);
+                update_behavior_profile(entry, i, evt.get_ts(), count);
+                sampler.lap(m_sketch_update_latency);
+                metric_inc(m_sketch_n_updates[i]);
             }
-            catch(falcosecurity::plugin_exception e)
+        }
+        catch(falcosecurity::plugin_exception e)
+        {
+            metric_inc(m_n_profile_errors);
+            return false;
+        }
+    }
+    if (timed)
+    {
+        m_adaptive_sampling.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        m_adaptive_sampling_multiplier.store(m_adaptive_sampling.get_multiplier(), std::memory_order_relaxed);
+    }
+    // Test-and-set: the answer of `anomaly.bloom_filter.seen` is whether the profile was present before this event
+    for(const auto i : has_bloom_filters ? m_event_code_bloom_filters[evt_type] : no_indices)
+    {
+        try
+        {
+            auto& entry = get_bloom_profile(ctx, i);
+            if (entry.extracted && !entry.profile.empty())
             {
-                return false;
+                entry.estimate = m_bloom_filters[i]->insert(ensure_digest(entry)) ? 1 : 0;
+                entry.has_estimate = true;
             }
         }
-        i++;
+        catch(falcosecurity::plugin_exception e)
+        {
+            metric_inc(m_n_profile_errors);
+            return false;
+        }
     }
     return true;
 }
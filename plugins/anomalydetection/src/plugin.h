@@ -18,16 +18,30 @@ limitations under the License.
 #pragma once
 
 #include "num/cms.h"
+#include "num/sliding_cms.h"
+#include "num/cms_snapshot.h"
+#include "num/cms_shared.h"
+#include "num/space_saving.h"
+#include "num/bloom_filter.h"
 #include "plugin_consts.h"
 #include "plugin_utils.h"
 #include "plugin_mutex.h"
 #include "plugin_thread_manager.h"
+#include "plugin_metrics.h"
+#include "plugin_lineage_cache.h"
+#include "plugin_container_scoped.h"
+#include "plugin_sampling.h"
+#include "plugin_staging_ring.h"
 #include "plugin_sinsp_filterchecks.h"
 
 #include <falcosecurity/sdk.h>
+#include <plugin_toolkit/event_params.h>
 #include <driver/ppm_events_public.h> // Temporary workaround to avoid redefining syscalls PPME events and risking being out of sync
 
 #include <thread>
+#include <array>
+#include <variant>
+#include <optional>
 #include <atomic>
 #include <chrono>
 #include <unordered_map>
@@ -37,11 +51,70 @@ limitations under the License.
 #define UINT32_MAX (4294967295U)
 #define PPM_AT_FDCWD -100
 #define SECOND_TO_NS 1000000000ULL
+#define MILLISECOND_TO_NS 1000000ULL
 
-struct sinsp_param
+// Per-event state shared by all behavior profiles evaluated for the same event.
+// Costly table lookups (thread, parent, fd entry, args) are resolved at most once on first use,
+// instead of once per field and per sketch.
+struct profile_extraction_ctx
 {
-    uint16_t param_len;
-    uint8_t* param_pointer;
+    profile_extraction_ctx(const falcosecurity::event_reader& e, const falcosecurity::table_reader& r): evt(e), tr(r) {}
+
+    const falcosecurity::event_reader& evt;
+    const falcosecurity::table_reader& tr;
+
+    // Params of the event, their offsets are computed once on first use
+    std::optional<event_params<>> params;
+    bool thread_entry_resolved = false;
+    std::optional<falcosecurity::table_entry> thread_entry;
+    std::optional<falcosecurity::table_entry> parent_entry;
+    bool fd_entry_resolved = false;
+    std::optional<falcosecurity::table_entry> fd_entry;
+    // `lastevent_fd` as written by `parse_event` for this event, saves reading it back from the thread table
+    std::optional<int64_t> lastevent_fd;
+    bool args_resolved = false;
+    std::vector<std::string> args;
+    bool parent_args_resolved = false;
+    std::vector<std::string> parent_args;
+    // Container of the event thread and its index in `m_container_sketches`, for the container scoped profiles
+    bool container_resolved = false;
+    std::string container_id;
+    uint32_t container_index = UINT32_MAX;
+};
+
+// One behavior profile sketch, the counter type and the sliding window mode are selected per profile
+using count_min_sketch_ptr = std::variant<
+    std::shared_ptr<plugin::anomalydetection::num::cms<uint64_t>>,
+    std::shared_ptr<plugin::anomalydetection::num::cms<uint32_t>>,
+    std::shared_ptr<plugin::anomalydetection::num::cms<uint16_t>>,
+    std::shared_ptr<plugin::anomalydetection::num::sliding_cms<uint64_t>>,
+    std::shared_ptr<plugin::anomalydetection::num::sliding_cms<uint32_t>>,
+    std::shared_ptr<plugin::anomalydetection::num::sliding_cms<uint16_t>>>;
+
+// Sketch of a container scoped profile for one container, reset by the event thread once `reset_timer_ms` elapsed
+struct count_min_sketch_slot
+{
+    count_min_sketch_ptr sketch;
+    uint64_t reset_ts = 0;
+};
+
+// Concatenated behavior profile of one sketch for the event `evtnum`, built in `parse_event` and
+// reused by `extract` so that every field referencing the same sketch costs one extraction per event
+struct behavior_profile_cache_entry
+{
+    uint64_t evtnum = UINT64_MAX;
+    bool extracted = false;
+    std::string profile;
+    bool has_digest = false;
+    plugin::anomalydetection::num::cms_digest digest;
+    // Estimate for `evtnum`, rules usually read it several times per event.
+    // For Bloom filters 1 if the profile was seen before `evtnum`, 0 otherwise.
+    bool has_estimate = false;
+    uint64_t estimate = 0;
+    // Sketch the profile is counted in for `evtnum`, see `resolve_sketch`; nullptr if the container of a container
+    // scoped profile has no sketch yet, its estimate is then 0
+    bool sketch_resolved = false;
+    const count_min_sketch_ptr* sketch = nullptr;
 };
 
 class anomalydetection
@@ -55,6 +128,8 @@ class anomalydetection
         ANOMALYDETECTION_COUNT_MIN_SKETCH_COUNT = 0,
         ANOMALYDETECTION_COUNT_MIN_SKETCH_BEHAVIOR_PROFILE_CONCAT_STR,
         ANOMALYDETECTION_FALCO_DURATION_NS,
+        ANOMALYDETECTION_COUNT_MIN_SKETCH_TOP_K,
+        ANOMALYDETECTION_BLOOM_FILTER_SEEN,
         ANOMALYDETECTION_FIELD_MAX
     };
 
@@ -62,7 +137,8 @@ class anomalydetection
     // General plugin API
     //////////////////////////
 
-    virtual ~anomalydetection() = default;
+    // Snapshots the sketches one last time if persistence is enabled
+    virtual ~anomalydetection();
 
     std::string get_name() { return PLUGIN_NAME; }
 
@@ -90,6 +166,9 @@ class anomalydetection
 
     static void log_error(std::string err_mess);
 
+    // Hot path counters, latencies and per sketch stats; sketch fill ratios are computed on each call
+    const std::vector<falcosecurity::metric>& get_metrics();
+
     //////////////////////////
     // Extract capability
     //////////////////////////
@@ -119,11 +198,16 @@ class anomalydetection
     // required; standard plugin API
     std::vector<falcosecurity::event_type> get_parse_event_types()
     {
+        // Only subscribe to the union of the event codes of all behavior profiles
         std::vector<falcosecurity::event_type> event_types;
-        // Temporary workaround
-        for (int i = PPME_GENERIC_E; i <= PPM_EVENT_MAX; ++i) 
+        for (size_t i = 0; i < PPM_EVENT_MAX; ++i)
         {
-            event_types.push_back(static_cast<falcosecurity::event_type>(i));
+            if ((i < m_event_code_sketches.size() && !m_event_code_sketches[i].empty()) ||
+                (i < m_event_code_bloom_filters.size() && !m_event_code_bloom_filters[i].empty()) ||
+                (m_lineage_cache_enabled && is_lineage_invalidation_event(i)))
+            {
+                event_types.push_back(static_cast<falcosecurity::event_type>(i));
+            }
         }
         return event_types;
     }
@@ -132,11 +216,71 @@ class anomalydetection
     bool parse_event(const falcosecurity::parse_event_input& in);
 
     // Custom helper functions within event parsing
-    bool extract_filterchecks_concat_profile(const falcosecurity::event_reader &evt, const falcosecurity::table_reader &tr, const std::vector<plugin_sinsp_filterchecks_field>& fields, std::string& behavior_profile_concat_str);
-    std::string extract_filterchecks_evt_params_fallbacks(const falcosecurity::event_reader &evt, const plugin_sinsp_filterchecks_field& field, const std::string& cwd = "");
+    bool extract_filterchecks_concat_profile(profile_extraction_ctx& ctx, const std::vector<plugin_sinsp_filterchecks_field>& fields, std::string& behavior_profile_concat_str);
+    // Returned views point into the event buffer or into `m_fallback_buf`, valid until the next call
+    std::string_view extract_filterchecks_evt_params_fallbacks(profile_extraction_ctx& ctx, const plugin_sinsp_filterchecks_field& field, std::string_view cwd = "");
     
     private:
 
+    template<typename T>
+    std::string_view format_fallback_num(T num);
+
+    // Lazily resolved lookups backing `profile_extraction_ctx`
+    const event_params<>& resolve_params(profile_extraction_ctx& ctx);
+    bool resolve_thread_entry(profile_extraction_ctx& ctx);
+    falcosecurity::table_entry& resolve_parent_entry(profile_extraction_ctx& ctx);
+    falcosecurity::table_entry* resolve_fd_entry(profile_extraction_ctx& ctx);
+    const std::vector<std::string>& resolve_args(profile_extraction_ctx& ctx);
+    const std::vector<std::string>& resolve_parent_args(profile_extraction_ctx& ctx);
+    void read_args(const falcosecurity::table_reader &tr, falcosecurity::table_entry& entry, std::vector<std::string>& args);
+    // Ancestor `level` (1 is the parent) of the event thread from `m_lineage_cache`, nullptr if the chain is shorter
+    lineage_ancestor* resolve_ancestor(profile_extraction_ctx& ctx, uint32_t level);
+    const std::string& resolve_ancestor_cmdline(profile_extraction_ctx& ctx, lineage_ancestor& ancestor);
+    static bool is_lineage_invalidation_event(size_t evt_type);
+    void invalidate_lineage(const falcosecurity::event_reader& evt);
+
+    // Per-event cached profile of sketch `index` and sketch access feeding off of it
+    behavior_profile_cache_entry& get_cached_profile(profile_extraction_ctx& ctx, behavior_profile_cache_entry& entry, const std::vector<plugin_sinsp_filterchecks_field>& fields);
+    behavior_profile_cache_entry& get_behavior_profile(profile_extraction_ctx& ctx, uint32_t index);
+    // Profile of the Bloom filter `index` for the current event, see `get_behavior_profile`
+    behavior_profile_cache_entry& get_bloom_profile(profile_extraction_ctx& ctx, uint32_t index);
+    void update_behavior_profile(behavior_profile_cache_entry& entry, uint32_t index, uint64_t ts, uint64_t count = 1);
+    uint64_t estimate_behavior_profile(behavior_profile_cache_entry& entry, uint32_t index, uint64_t ts);
+    // Estimate all sketches whose profile is already extracted for the event in one pass, see `cms::prefetch`
+    void estimate_behavior_profiles_batch(profile_extraction_ctx& ctx);
+    // Validated fields and event codes of a behavior profile of the `count_min_sketch` or `bloom_filter` config,
+    // throws std::invalid_argument on invalid profiles, reported by `init` as an invalid init config
+    void parse_behavior_profile(const nlohmann::json& profile, int n, std::vector<plugin_sinsp_filterchecks_field>& fields, std::unordered_set<ppm_event_code>& codes);
+    // `per_container` sizes the sketch with `per_container_rows_cols`, if set
+    template<typename T>
+    count_min_sketch_ptr make_count_min_sketch(uint32_t index, bool per_container = false);
+    count_min_sketch_ptr make_count_min_sketch_of_type(uint32_t index, bool per_container = false);
+    // Sketch the profile of sketch `index` is counted in for the current event: the node wide one, or the one
+    // of the event container for container scoped profiles, created on first update if `create`
+    const count_min_sketch_ptr* resolve_sketch(profile_extraction_ctx& ctx, behavior_profile_cache_entry& entry, uint32_t index, bool create);
+    const std::string& resolve_container_id(profile_extraction_ctx& ctx);
+    // Release the sketches of the containers no longer in the container plugin's table, at most every
+    // `CONTAINER_SKETCHES_SWEEP_INTERVAL_NS` of event time
+    void sweep_container_sketches(const falcosecurity::table_reader& tr, uint64_t ts);
+    void publish_container_sketch_metrics(uint32_t index);
+
+    // (Re)build `m_metrics` and reset the counters backing it for the current sketches
+    void init_metrics();
+
+    // Sketch persistence, no-ops unless `snapshot_dir` is configured
+    std::string get_snapshot_path(uint32_t index) const;
+    // Counts imported from `import_dir`, persisted next to the snapshot, see `cms_snapshot::save_baseline`
+    std::string get_baseline_path(uint32_t index) const;
+    void save_count_min_sketch_snapshots();
+    // Warm start from the own snapshot, else from the sketch in `import_dir` (if any)
+    void load_count_min_sketch_snapshots();
+    // Periodic export of the node local counts to `export_dir` for cluster wide merging, see `cms_snapshot::save_delta`
+    void export_count_min_sketches();
+    // Move the counters of the plain node wide sketches to `shared_dir`, see `cms_shared`
+    void share_count_min_sketches();
+    // Apply up to `max` staged updates of the async sketches, from any thread
+    size_t drain_staged_updates(size_t max);
+
     // Manages plugin side threads, such as resetting the count min sketch data structures
     ThreadManager m_thread_manager;
 
@@ -153,10 +297,109 @@ class anomalydetection
     std::vector<std::vector<uint64_t>> m_rows_cols; // If set supersedes m_gamma_eps
     std::vector<std::vector<plugin_sinsp_filterchecks_field>> m_behavior_profiles_fields;
     std::vector<std::unordered_set<ppm_event_code>> m_behavior_profiles_event_codes;
+    std::vector<std::string> m_behavior_profiles_definitions; // Raw JSON of each profile
+    std::string m_snapshot_dir;
+    uint64_t m_snapshot_interval_ms = 0;
+    std::string m_export_dir;
+    uint64_t m_export_interval_ms = 0;
+    std::string m_export_node_id;
+    std::string m_import_dir;
+    std::string m_shared_dir;
+    // Dense dispatch table built in `init`: event code -> indices of the sketches interested in it
+    std::vector<std::vector<uint32_t>> m_event_code_sketches;
     std::vector<uint64_t> m_reset_timers;
+    std::vector<std::array<uint64_t, 2>> m_windows; // {window_ms, window_buckets}, window_ms 0 if disabled
+    std::vector<bool> m_pow2_cols;
+    std::vector<bool> m_conservative_updates;
+    std::vector<uint32_t> m_counter_bits; // Counter width, one of 16, 32, 64
+    std::vector<uint64_t> m_top_k_sizes; // 0 if heavy hitters are not tracked
+    std::vector<plugin::anomalydetection::num::cms_hash_mode> m_hash_modes;
+    // Container scoped profiles: one sketch per container, bounded per profile by `per_container_max_bytes`
+    std::vector<bool> m_per_container;
+    std::vector<std::vector<uint64_t>> m_per_container_rows_cols; // Empty if the sketch dimensions are used
+    std::vector<uint64_t> m_per_container_max_bytes;
+    // Sampled profiles, see `sample_rate`, 1 if every event updates the sketch
+    std::vector<uint64_t> m_sample_rates;
+    std::vector<profile_sampler::mode> m_sample_modes;
+    uint64_t m_adaptive_sampling_budget_ns = 0; // 0 if disabled
+    uint64_t m_adaptive_sampling_max_rate = ADAPTIVE_SAMPLING_DEFAULT_MAX_RATE;
+    // Async updates, see `async_updates`
+    bool m_async_updates = false;
+    uint64_t m_async_ring_size = ASYNC_UPDATES_DEFAULT_RING_SIZE;
+    uint64_t m_async_drain_interval_ms = ASYNC_UPDATES_DEFAULT_DRAIN_INTERVAL_MS;
+    bool m_async_include_pending = true;
+
+    // Bloom filter "seen before" profiles, an alternative to a count min sketch for first occurrence rules
+    bool m_bloom_filter_enabled = false;
+    std::vector<std::vector<plugin_sinsp_filterchecks_field>> m_bloom_profiles_fields;
+    std::vector<std::unordered_set<ppm_event_code>> m_bloom_profiles_event_codes;
+    std::vector<uint64_t> m_bloom_capacities; // Expected number of distinct profiles
+    std::vector<double> m_bloom_fpps; // False positive probability at capacity
+    std::vector<uint64_t> m_bloom_reset_timers;
+    // Dense dispatch table built in `init`: event code -> indices of the Bloom filters interested in it
+    std::vector<std::vector<uint32_t>> m_event_code_bloom_filters;
+    // Only (re)built in `init` while no worker thread runs, read-only afterwards
+    std::vector<std::shared_ptr<plugin::anomalydetection::num::bloom_filter>> m_bloom_filters;
+    // One slot per Bloom filter, see `m_behavior_profiles_cache`
+    std::vector<behavior_profile_cache_entry> m_bloom_profiles_cache;
 
     // Plugin managed state table specific to the count_min_sketch use case
-    plugin_anomalydetection::Mutex<std::vector<std::shared_ptr<plugin::anomalydetection::num::cms<uint64_t>>>> m_count_min_sketches;
+    // Only (re)built in `init` while no worker thread runs, read-only afterwards. The sketches themselves
+    // support lock-free concurrent updates / estimates and resets, hence no lock is taken on the hot path.
+    std::vector<count_min_sketch_ptr> m_count_min_sketches;
+    // Per sketch, hash of the profile definition it was built from, see `m_behavior_profiles_definitions`
+    std::vector<uint64_t> m_sketch_definition_hashes;
+    // Per sketch, counts imported from `import_dir`, kept out of the exports; guarded by `m_snapshot_mutex`
+    std::vector<plugin::anomalydetection::num::cms_snapshot_baseline> m_sketch_baselines;
+    std::mutex m_snapshot_mutex;
+    // Per sketch heavy hitters, nullptr if disabled; only accessed from the event thread
+    std::vector<std::unique_ptr<plugin::anomalydetection::num::space_saving<uint64_t>>> m_top_k;
+    // One slot per sketch, parse and extract run on the same thread hence no locking
+    std::vector<behavior_profile_cache_entry> m_behavior_profiles_cache;
+    // Sketches only updated by the consumer of `m_staging_ring`: the plain node wide ones in `DOUBLE_HASHING`
+    // mode, when `async_updates` is set. Only (re)built in `init` while no worker thread runs.
+    std::vector<bool> m_async_sketches;
+    std::unique_ptr<staging_ring> m_staging_ring;
+    // Serializes the consumers of `m_staging_ring`, i.e. the drain worker and a full ring on the event thread
+    std::mutex m_drain_mutex;
+    std::vector<staged_update> m_drain_batch;
+    std::vector<std::pair<uint64_t, uint64_t>> m_drain_cells; // {counter offset, count}
+    std::vector<uint64_t> m_drain_offsets;
+    // One sampler per sketch, scaled by the adaptive sampling multiplier; only accessed from the event thread
+    std::vector<profile_sampler> m_samplers;
+    adaptive_sampling_controller m_adaptive_sampling;
+    // One scope per sketch, only used by the container scoped ones; only accessed from the event thread.
+    // Host processes, or threads without a container id yet, count in the node wide sketch.
+    bool m_has_per_container = false;
+    container_scoped<count_min_sketch_slot> m_container_sketches;
+    uint64_t m_last_container_sweep_ts = 0;
+    // The container plugin's `containers` table, tells which containers are gone
+    bool m_has_containers_table = false;
+    falcosecurity::table m_containers_table;
+    // Ancestor chains for the `proc.a*` lineage fields, only maintained if a profile uses one of them
+    bool m_lineage_cache_enabled = false;
+    lineage_cache m_lineage_cache;
+    // Scratch space of the fd related event param fallbacks, only accessed from the event thread. Reused across
+    // events so that resolving a relative path does not allocate once the buffers have grown.
+    std::array<char, SCAP_MAX_PATH_SIZE> m_fallback_buf;
+    std::string m_fallback_dir; // Thread cwd or dirfd path the relative paths are resolved against
+
+    // Metrics, counters are only written by the event thread, see `metric_inc`
+    std::vector<falcosecurity::metric> m_metrics;
+    std::atomic<uint64_t> m_n_events_parsed{0};
+    std::atomic<uint64_t> m_n_thread_lookup_misses{0};
+    std::atomic<uint64_t> m_n_fd_lookup_misses{0};
+    std::atomic<uint64_t> m_n_profile_errors{0};
+    latency_histogram m_profile_extraction_latency;
+    latency_histogram m_sketch_update_latency;
+    std::vector<std::atomic<uint64_t>> m_sketch_n_updates;
+    std::vector<std::atomic<uint64_t>> m_sketch_n_sampled_out;
+    std::atomic<uint64_t> m_adaptive_sampling_multiplier{1};
+    std::atomic<uint64_t> m_n_staging_ring_full{0};
+    // Per container scoped sketch, published by the event thread
+    std::vector<std::atomic<uint64_t>> m_sketch_n_containers;
+    std::vector<std::atomic<uint64_t>> m_sketch_containers_memory;
+    std::vector<std::atomic<uint64_t>> m_sketch_n_container_evictions;
 
     // required; standard plugin API
     std::string m_lasterr;
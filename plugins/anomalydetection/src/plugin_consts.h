@@ -33,3 +33,55 @@ limitations under the License.
 ///////////////////////////
 
 #define THREAD_TABLE_NAME "threads"
+
+///////////////////////////////////
+// Container Table (container plugin)
+///////////////////////////////////
+
+#define CONTAINER_TABLE_NAME "containers"
+// The sketches of the containers gone from the table are released at most this often, in event time
+#define CONTAINER_SKETCHES_SWEEP_INTERVAL_NS 30000000000ULL
+// Default memory budget of the per container sketches of a behavior profile, see `per_container_max_bytes`
+#define CONTAINER_SKETCHES_DEFAULT_MAX_BYTES 16777216ULL
+
+///////////////////////////////////
+// Sampling
+///////////////////////////////////
+
+// Default maximum factor applied to the sampling rates by the adaptive sampling, see `adaptive_sampling`
+#define ADAPTIVE_SAMPLING_DEFAULT_MAX_RATE 64
+
+///////////////////////////////////
+// Async updates
+///////////////////////////////////
+
+// Defaults of `async_updates`
+#define ASYNC_UPDATES_DEFAULT_RING_SIZE 65536
+#define ASYNC_UPDATES_DEFAULT_DRAIN_INTERVAL_MS 1
+
+/////////////////////////
+// Metrics
+/////////////////////////
+
+#define METRIC_N_EVENTS_PARSED "n_events_parsed"
+#define METRIC_N_THREAD_LOOKUP_MISSES "n_thread_lookup_misses"
+#define METRIC_N_FD_LOOKUP_MISSES "n_fd_lookup_misses"
+#define METRIC_N_PROFILE_ERRORS "n_profile_extraction_errors"
+#define METRIC_PROFILE_EXTRACTION_LATENCY "profile_extraction_latency_ns"
+#define METRIC_SKETCH_UPDATE_LATENCY "sketch_update_latency_ns"
+// Async updates only, updates applied on the event thread because the staging ring was full
+#define METRIC_N_STAGING_RING_FULL "n_staging_ring_full"
+// Per sketch metrics are prefixed with `sketch_<index>_`
+#define METRIC_SKETCH_PREFIX "sketch_"
+#define METRIC_SKETCH_N_UPDATES "n_updates"
+#define METRIC_SKETCH_FILL_RATIO "fill_ratio"
+// Container scoped sketches only
+#define METRIC_SKETCH_N_CONTAINERS "n_containers"
+#define METRIC_SKETCH_CONTAINERS_MEMORY "containers_memory_bytes"
+#define METRIC_SKETCH_N_CONTAINER_EVICTIONS "n_container_evictions"
+// Sampled sketches only
+#define METRIC_SKETCH_N_SAMPLED_OUT "n_sampled_out"
+// Adaptive sampling only, factor currently applied to the sampling rates
+#define METRIC_ADAPTIVE_SAMPLING_MULTIPLIER "adaptive_sampling_multiplier"
+// Per Bloom filter metrics are prefixed with `bloom_filter_<index>_`
+#define METRIC_BLOOM_FILTER_PREFIX "bloom_filter_"
@@ -0,0 +1,270 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+Values scoped to the container of the event thread, e.g. one small sketch per container and behavior profile
+instead of a single node wide one, so that a noisy container cannot saturate the counters the others read.
+
+Container ids are mapped to a compact index shared by all the scopes (profiles): each scope stores its values in
+a dense vector indexed by it, hence only the first sight of a container hashes its id. Each scope holds at most
+`max_bytes` worth of values, but always at least one, and evicts its least recently used containers first. An
+index is recycled once no scope holds a value for it anymore.
+Not thread safe, owned by the event thread.
+*/
+template<typename V>
+class container_scoped
+{
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    // One scope per budget of `max_bytes`
+    explicit container_scoped(const std::vector<size_t>& max_bytes = {})
+    {
+        m_scopes.resize(max_bytes.size());
+        for (size_t i = 0; i < max_bytes.size(); ++i)
+        {
+            m_scopes[i].max_bytes = max_bytes[i];
+        }
+    }
+
+    // Compact index of `container_id`, `npos` if no scope holds a value for it
+    uint32_t find(const std::string& container_id) const
+    {
+        auto it = m_indices.find(container_id);
+        return it != m_indices.end() ? it->second : npos;
+    }
+
+    // Value of the container `index` in `scope`, nullptr if none; it becomes the most recently used one
+    V* get(uint32_t scope, uint32_t index)
+    {
+        auto& s = m_scopes[scope];
+        if (index >= s.nodes.size() || !s.nodes[index].value.has_value())
+        {
+            return nullptr;
+        }
+        move_to_front(s, index);
+        return &s.nodes[index].value.value();
+    }
+
+    // Store the `value` of `container_id` in `scope`, accounted as `bytes`, evicting the least recently used
+    // values of the scope past its budget. Pointers to the values of the scope are valid until the next insertion.
+    V& insert(uint32_t scope, const std::string& container_id, V value, size_t bytes)
+    {
+        auto index = assign(container_id);
+        auto& s = m_scopes[scope];
+        if (index >= s.nodes.size())
+        {
+            s.nodes.resize(index + 1);
+        }
+        auto& node = s.nodes[index];
+        if (node.value.has_value())
+        {
+            s.memory -= node.bytes;
+            move_to_front(s, index);
+        }
+        else
+        {
+            link_front(s, index);
+            ++s.size;
+            ++m_refs[index];
+        }
+        node.value = std::move(value);
+        node.bytes = bytes;
+        s.memory += bytes;
+        while (s.memory > s.max_bytes && s.size > 1)
+        {
+            ++s.n_evictions;
+            remove(s, s.tail);
+        }
+        return node.value.value();
+    }
+
+    // Drop the values of `container_id` in all scopes, e.g. once the container is gone
+    bool erase(const std::string& container_id)
+    {
+        auto it = m_indices.find(container_id);
+        if (it == m_indices.end())
+        {
+            return false;
+        }
+        auto index = it->second;
+        for (auto& s : m_scopes)
+        {
+            if (index < s.nodes.size() && s.nodes[index].value.has_value())
+            {
+                // Releases the index along the last value
+                remove(s, index);
+            }
+        }
+        return true;
+    }
+
+    void clear()
+    {
+        for (auto& s : m_scopes)
+        {
+            auto max_bytes = s.max_bytes;
+            s = scope_state();
+            s.max_bytes = max_bytes;
+        }
+        m_indices.clear();
+        m_ids.clear();
+        m_refs.clear();
+        m_free.clear();
+    }
+
+    // Ids of the containers holding at least one value
+    template<typename F>
+    void for_each_container(F&& f) const
+    {
+        for (const auto& it : m_indices)
+        {
+            f(it.first);
+        }
+    }
+
+    size_t n_containers() const
+    {
+        return m_indices.size();
+    }
+
+    size_t size(uint32_t scope) const
+    {
+        return m_scopes[scope].size;
+    }
+
+    size_t memory_bytes(uint32_t scope) const
+    {
+        return m_scopes[scope].memory;
+    }
+
+    uint64_t n_evictions(uint32_t scope) const
+    {
+        return m_scopes[scope].n_evictions;
+    }
+
+private:
+    struct node_state
+    {
+        std::optional<V> value;
+        size_t bytes = 0;
+        uint32_t prev = npos;
+        uint32_t next = npos;
+    };
+
+    // Doubly linked LRU list threaded through `nodes`, `head` is the most recently used
+    struct scope_state
+    {
+        std::vector<node_state> nodes;
+        uint32_t head = npos;
+        uint32_t tail = npos;
+        size_t size = 0;
+        size_t memory = 0;
+        size_t max_bytes = 0;
+        uint64_t n_evictions = 0;
+    };
+
+    uint32_t assign(const std::string& container_id)
+    {
+        auto it = m_indices.find(container_id);
+        if (it != m_indices.end())
+        {
+            return it->second;
+        }
+        uint32_t index;
+        if (!m_free.empty())
+        {
+            index = m_free.back();
+            m_free.pop_back();
+            m_ids[index] = container_id;
+        }
+        else
+        {
+            index = (uint32_t)m_ids.size();
+            m_ids.push_back(container_id);
+            m_refs.push_back(0);
+        }
+        m_indices.emplace(container_id, index);
+        return index;
+    }
+
+    void unlink(scope_state& s, uint32_t index)
+    {
+        auto& node = s.nodes[index];
+        (node.prev != npos ? s.nodes[node.prev].next : s.head) = node.next;
+        (node.next != npos ? s.nodes[node.next].prev : s.tail) = node.prev;
+        node.prev = npos;
+        node.next = npos;
+    }
+
+    void link_front(scope_state& s, uint32_t index)
+    {
+        auto& node = s.nodes[index];
+        node.prev = npos;
+        node.next = s.head;
+        if (s.head != npos)
+        {
+            s.nodes[s.head].prev = index;
+        }
+        s.head = index;
+        if (s.tail == npos)
+        {
+            s.tail = index;
+        }
+    }
+
+    void move_to_front(scope_state& s, uint32_t index)
+    {
+        if (s.head != index)
+        {
+            unlink(s, index);
+            link_front(s, index);
+        }
+    }
+
+    void remove(scope_state& s, uint32_t index)
+    {
+        unlink(s, index);
+        auto& node = s.nodes[index];
+        node.value.reset();
+        s.memory -= node.bytes;
+        node.bytes = 0;
+        --s.size;
+        if (--m_refs[index] == 0)
+        {
+            m_indices.erase(m_ids[index]);
+            m_ids[index].clear();
+            m_free.push_back(index);
+        }
+    }
+
+    std::vector<scope_state> m_scopes;
+    std::unordered_map<std::string, uint32_t> m_indices;
+    std::vector<std::string> m_ids; // index -> container id
+    std::vector<uint32_t> m_refs; // index -> number of scopes holding a value for it
+    std::vector<uint32_t> m_free;
+};
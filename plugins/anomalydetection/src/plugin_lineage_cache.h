@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Snapshot of one ancestor of a thread, as read from the thread table
+struct lineage_ancestor
+{
+    int64_t tid = -1;
+    int64_t pid = -1;
+    std::string comm;
+    std::string exe;
+    std::string exepath;
+    // Ancestor comm followed by its args, only read for `proc.acmdline` style fields
+    bool cmdline_resolved = false;
+    std::string cmdline;
+};
+
+// Ancestors of a thread walked so far via their `ptid` links, index 0 is the parent.
+// The walk is extended lazily, `complete` once it reached init (tid 1).
+struct lineage_entry
+{
+    std::vector<lineage_ancestor> ancestors;
+    int64_t next_ptid = -1; // ptid of the last walked ancestor (or of the thread itself)
+    bool complete = false;
+};
+
+/*
+Per-thread cache of the ancestor chain used by the `proc.a*` profile fields, so that deep lineage
+fields do not cost one thread table lookup per level, per event and per sketch.
+
+An ancestor's data only changes when the ancestor execs, and a chain only changes when one of
+its threads exits (children are reparented) or a tid is reused after a clone. `invalidate` is
+therefore called on clone, execve and procexit: it drops the entry of the thread itself and the
+entries of every thread that has it as an ancestor, via a reverse index. The reverse index is
+append only between invalidations; both maps are cleared at once if they grow past their bound.
+Not thread safe, owned by the event thread.
+*/
+class lineage_cache
+{
+public:
+    explicit lineage_cache(size_t max_entries = 16384) : m_max_entries(max_entries) {}
+
+    lineage_entry* get(int64_t tid)
+    {
+        auto it = m_entries.find(tid);
+        return it != m_entries.end() ? &it->second : nullptr;
+    }
+
+    // Start a new chain for `tid`, whose parent is `ptid`
+    lineage_entry& insert(int64_t tid, int64_t ptid)
+    {
+        if (m_entries.size() >= m_max_entries || m_n_dependencies >= 8 * m_max_entries)
+        {
+            clear();
+        }
+        auto& entry = m_entries[tid];
+        entry = lineage_entry();
+        entry.next_ptid = ptid;
+        return entry;
+    }
+
+    // Record that the chain of `tid` contains `ancestor_tid`
+    void add_dependency(int64_t tid, int64_t ancestor_tid)
+    {
+        m_dependents[ancestor_tid].push_back(tid);
+        ++m_n_dependencies;
+    }
+
+    void invalidate(int64_t tid)
+    {
+        m_entries.erase(tid);
+        auto it = m_dependents.find(tid);
+        if (it == m_dependents.end())
+        {
+            return;
+        }
+        for (const auto dependent : it->second)
+        {
+            m_entries.erase(dependent);
+        }
+        m_n_dependencies -= it->second.size();
+        m_dependents.erase(it);
+    }
+
+    void clear()
+    {
+        m_entries.clear();
+        m_dependents.clear();
+        m_n_dependencies = 0;
+    }
+
+    size_t size() const
+    {
+        return m_entries.size();
+    }
+
+private:
+    size_t m_max_entries;
+    std::unordered_map<int64_t, lineage_entry> m_entries;
+    std::unordered_map<int64_t, std::vector<int64_t>> m_dependents; // ancestor tid -> cached descendants
+    size_t m_n_dependencies = 0;
+};
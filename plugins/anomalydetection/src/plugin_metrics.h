@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Plugin internal counters are only written by the event thread (parse / extract) while `get_metrics`
+// may read them from another one, a relaxed load + store is enough and avoids a locked RMW per event
+static inline void metric_inc(std::atomic<uint64_t>& c, uint64_t n = 1)
+{
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+#define METRICS_LATENCY_N_BUCKETS 9
+// Only 1 out of N events is timed, reading the clock costs about as much as a sketch update
+#define METRICS_LATENCY_SAMPLING_RATE 16
+
+// Fixed buckets latency histogram in ns, exported as cumulative `le` buckets along the sum and count
+class latency_histogram
+{
+public:
+    static constexpr std::array<uint64_t, METRICS_LATENCY_N_BUCKETS - 1> bounds = {100, 250, 500, 1000, 2500, 5000, 10000, 25000};
+
+    void record(uint64_t ns)
+    {
+        size_t i = 0;
+        while (i < bounds.size() && ns > bounds[i])
+        {
+            ++i;
+        }
+        metric_inc(m_buckets[i]);
+        metric_inc(m_sum_ns, ns);
+        metric_inc(m_count);
+    }
+
+    // Number of samples <= bounds[i], the last bucket counts all samples
+    uint64_t cumulative_count(size_t i) const
+    {
+        uint64_t n = 0;
+        for (size_t j = 0; j <= i && j < m_buckets.size(); ++j)
+        {
+            n += m_buckets[j].load(std::memory_order_relaxed);
+        }
+        return n;
+    }
+
+    uint64_t sum_ns() const { return m_sum_ns.load(std::memory_order_relaxed); }
+
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+
+    void reset()
+    {
+        for (auto& b : m_buckets)
+        {
+            b.store(0, std::memory_order_relaxed);
+        }
+        m_sum_ns.store(0, std::memory_order_relaxed);
+        m_count.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, METRICS_LATENCY_N_BUCKETS> m_buckets = {};
+    std::atomic<uint64_t> m_sum_ns{0};
+    std::atomic<uint64_t> m_count{0};
+};
+
+// Times consecutive steps into histograms, does not read the clock at all when not sampled
+class latency_sampler
+{
+public:
+    explicit latency_sampler(bool sampled) : m_sampled(sampled)
+    {
+        if (m_sampled)
+        {
+            m_last = std::chrono::steady_clock::now();
+        }
+    }
+
+    // Record the time elapsed since construction or the previous `lap` into `h`
+    void lap(latency_histogram& h)
+    {
+        if (!m_sampled)
+        {
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        h.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_last).count());
+        m_last = now;
+    }
+
+    // Restart the measurement without recording, e.g. after a step that is not accounted
+    void restart()
+    {
+        if (m_sampled)
+        {
+            m_last = std::chrono::steady_clock::now();
+        }
+    }
+
+private:
+    bool m_sampled;
+    std::chrono::steady_clock::time_point m_last;
+};
@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+
+// Timed events per decision of the `adaptive_sampling_controller`
+#define ADAPTIVE_SAMPLING_WINDOW 256
+
+/*
+Selects the events of a behavior profile that update its sketch: 1 out of `rate` events, either every `rate`-th
+one (`FIXED`) or each one with probability 1 / `rate` (`RANDOM`, which does not alias with periodic workloads).
+Selected events add `rate` to the counters instead of 1, so that estimates stay unbiased counts of all events.
+Events that are not selected skip both the profile extraction and the update. Not thread safe, owned by the
+event thread.
+*/
+class profile_sampler
+{
+public:
+    enum mode
+    {
+        FIXED = 0,
+        RANDOM
+    };
+
+    explicit profile_sampler(uint64_t rate = 1, mode m = FIXED, uint64_t seed = 0) :
+        m_rate(rate > 0 ? rate : 1), m_mode(m), m_rng(seed * 0x9E3779B97F4A7C15ULL + 1)
+    {
+    }
+
+    // Increment of the sketch for the current event, 0 if it is sampled out. `multiplier` scales the rate, see
+    // `adaptive_sampling_controller`.
+    uint64_t next(uint64_t multiplier = 1)
+    {
+        uint64_t rate = m_rate * multiplier;
+        if (rate <= 1)
+        {
+            return 1;
+        }
+        if (m_mode == RANDOM)
+        {
+            return next_random() % rate == 0 ? rate : 0;
+        }
+        if (++m_n >= rate)
+        {
+            m_n = 0;
+            return rate;
+        }
+        return 0;
+    }
+
+    uint64_t get_rate() const
+    {
+        return m_rate;
+    }
+
+private:
+    // xorshift64*, seeded per profile
+    uint64_t next_random()
+    {
+        m_rng ^= m_rng >> 12;
+        m_rng ^= m_rng << 25;
+        m_rng ^= m_rng >> 27;
+        return m_rng * 0x2545F4914F6CDD1DULL;
+    }
+
+    uint64_t m_rate;
+    mode m_mode;
+    uint64_t m_rng;
+    uint64_t m_n = 0;
+};
+
+/*
+Adaptive load shedding: raises the sampling rates of all behavior profiles, by powers of two up to `max_multiplier`,
+while the plugin time per parsed event stays over `budget_ns`, and lowers them again once it falls under half of
+the budget. Losing some precision beats having the kernel drop events. Fed by the event thread with a sample of
+the parsed events. Not thread safe, owned by the event thread: other threads, e.g. the metrics, read a copy of the
+multiplier published by the plugin.
+*/
+class adaptive_sampling_controller
+{
+public:
+    adaptive_sampling_controller(uint64_t budget_ns = 0, uint64_t max_multiplier = 1) :
+        m_budget_ns(budget_ns), m_max_multiplier(max_multiplier > 0 ? max_multiplier : 1)
+    {
+    }
+
+    bool enabled() const
+    {
+        return m_budget_ns > 0;
+    }
+
+    // Plugin time spent parsing one event
+    void record(uint64_t ns)
+    {
+        m_sum_ns += ns;
+        if (++m_n < ADAPTIVE_SAMPLING_WINDOW)
+        {
+            return;
+        }
+        uint64_t avg_ns = m_sum_ns / m_n;
+        m_sum_ns = 0;
+        m_n = 0;
+        if (avg_ns > m_budget_ns && m_multiplier * 2 <= m_max_multiplier)
+        {
+            m_multiplier *= 2;
+        }
+        else if (avg_ns < m_budget_ns / 2 && m_multiplier > 1)
+        {
+            m_multiplier /= 2;
+        }
+    }
+
+    uint64_t get_multiplier() const
+    {
+        return m_multiplier;
+    }
+
+private:
+    uint64_t m_budget_ns;
+    uint64_t m_max_multiplier;
+    uint64_t m_multiplier = 1;
+    uint64_t m_sum_ns = 0;
+    uint64_t m_n = 0;
+};
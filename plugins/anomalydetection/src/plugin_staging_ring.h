@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include "num/cms.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sketch increment deferred to the drain of the `staging_ring`
+struct staged_update
+{
+    plugin::anomalydetection::num::cms_digest digest;
+    uint32_t sketch; // Index of the sketch
+    uint32_t count;
+};
+
+/*
+Bounded lock-free single producer / single consumer ring of sketch increments: the event thread only appends
+the digest of each update, the consumer applies them in batches off the event thread. The consumer may change
+threads over time (e.g. the drain worker, or the event thread when the ring is full) as long as the handover
+is serialized, e.g. by a mutex.
+
+The increments staged but not yet applied are also summed per (sketch, digest) in a table of counters as large
+as the ring, so that `pending` does not scan the ring. Keys sharing a counter are summed together, `pending`
+is hence an upper bound, like the sketch estimates.
+*/
+class staging_ring
+{
+public:
+    // Capacity rounded up to the next power of two
+    explicit staging_ring(size_t capacity = 0)
+    {
+        size_t n = 1;
+        while (n < capacity)
+        {
+            n <<= 1;
+        }
+        m_slots.resize(n);
+        m_mask = n - 1;
+        m_pending = std::vector<std::atomic<uint64_t>>(n);
+    }
+
+    staging_ring(const staging_ring&) = delete;
+    staging_ring& operator=(const staging_ring&) = delete;
+
+    // Producer only, false if the ring is full
+    bool push(const staged_update& u)
+    {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) >= m_slots.size())
+        {
+            return false;
+        }
+        m_slots[head & m_mask] = u;
+        m_pending[pending_index(u.sketch, u.digest)].fetch_add(u.count, std::memory_order_relaxed);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only, move up to `max` updates to `out`, oldest first. They remain pending until `applied()`
+    size_t pop(std::vector<staged_update>& out, size_t max)
+    {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        size_t n = (size_t)std::min<uint64_t>(head - tail, max);
+        for (size_t i = 0; i < n; ++i)
+        {
+            out.push_back(m_slots[(tail + i) & m_mask]);
+        }
+        m_tail.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    // Consumer only, the `n` updates popped at `u` are now visible in their sketch
+    void applied(const staged_update* u, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            m_pending[pending_index(u[i].sketch, u[i].digest)].fetch_sub(u[i].count, std::memory_order_release);
+        }
+    }
+
+    // Sum of the counts still staged for `digest` in `sketch`, at least. An update applied meanwhile may be
+    // counted here as well as in the sketch, never in neither if the sketch is read afterwards.
+    uint64_t pending(uint32_t sketch, const plugin::anomalydetection::num::cms_digest& digest) const
+    {
+        return m_pending[pending_index(sketch, digest)].load(std::memory_order_acquire);
+    }
+
+    size_t size() const
+    {
+        return (size_t)(m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire));
+    }
+
+    size_t capacity() const
+    {
+        return m_slots.size();
+    }
+
+private:
+    size_t pending_index(uint32_t sketch, const plugin::anomalydetection::num::cms_digest& digest) const
+    {
+        return (size_t)((digest.h1 ^ (digest.h2 * (sketch + 1))) & m_mask);
+    }
+
+    std::vector<staged_update> m_slots;
+    std::vector<std::atomic<uint64_t>> m_pending;
+    uint64_t m_mask = 0;
+    // Written by the producer, respectively by the consumer, on distinct cache lines
+    alignas(CMS_CACHE_LINE_SIZE) std::atomic<uint64_t> m_head{0};
+    alignas(CMS_CACHE_LINE_SIZE) std::atomic<uint64_t> m_tail{0};
+};
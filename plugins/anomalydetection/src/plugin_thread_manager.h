@@ -27,91 +27,139 @@ limitations under the License.
 #include <atomic>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
 
+/*
+Runs the plugin side periodic jobs (sketch resets, snapshots) on a single scheduler thread.
+Jobs are kept in a min-heap ordered by their next deadline, the scheduler sleeps on a condition
+variable until the earliest deadline, a new earlier job or a stop request, so `stop_threads`
+and config reloads return as soon as the job currently running (if any) completes.
+Jobs run one at a time and are rescheduled `interval_ms` after they complete. Scheduling a job
+after `stop_threads` starts the scheduler again, as done on config reloads.
+*/
 class ThreadManager {
 public:
-    ThreadManager() : m_stop_requested(false) {}
+    ThreadManager() = default;
 
     ~ThreadManager()
     {
         stop_threads();
     }
 
+    // Stop the scheduler and drop all jobs
     void stop_threads()
     {
         {
             std::lock_guard<std::mutex> lock(m_thread_mutex);
             m_stop_requested = true;
         }
+        m_cv.notify_all();
 
+        // Join outside of the lock, the scheduler takes it between jobs
+        if (m_scheduler.joinable())
         {
-            std::lock_guard<std::mutex> lock(m_thread_mutex);
-            for (auto& t : m_threads)
-            {
-                if (t.joinable())
-                {
-                    t.join();
-                }
-            }
-            m_threads.clear();
+            m_scheduler.join();
         }
+        std::lock_guard<std::mutex> lock(m_thread_mutex);
+        m_jobs.clear();
     }
 
     template<typename T>
-    void start_periodic_count_min_sketch_reset_worker(int id, uint64_t interval_ms, plugin_anomalydetection::Mutex<std::vector<std::shared_ptr<plugin::anomalydetection::num::cms<T>>>>& count_min_sketches)
+    void start_periodic_count_min_sketch_reset_worker(uint64_t interval_ms, std::shared_ptr<plugin::anomalydetection::num::cms<T>> count_min_sketch)
     {
-        if (interval_ms > 100)
+        if (interval_ms > 100 && count_min_sketch)
         {
-            auto worker = [id, interval_ms, &count_min_sketches, this]() {
-                periodic_count_min_sketch_reset_worker<T>(id, interval_ms, count_min_sketches);
-            };
+            // Swaps in a zeroed generation, concurrent event parsing is never blocked
+            schedule(interval_ms, [count_min_sketch]() { count_min_sketch->reset(); });
+        }
+    }
 
-            std::thread worker_thread(worker);
-            {
-                std::lock_guard<std::mutex> lock(m_thread_mutex);
-                m_threads.push_back(std::move(worker_thread));
-            }
+    // Run `task` every `interval_ms` until `stop_threads` is called
+    void start_periodic_worker(uint64_t interval_ms, std::function<void()> task)
+    {
+        if (interval_ms > 0 && task)
+        {
+            schedule(interval_ms, std::move(task));
         }
     }
-    std::atomic<bool> m_stop_requested;
+
+    size_t get_n_jobs()
+    {
+        std::lock_guard<std::mutex> lock(m_thread_mutex);
+        return m_jobs.size();
+    }
 
 private:
-    std::vector<std::thread> m_threads;
+    struct job
+    {
+        std::chrono::steady_clock::time_point next;
+        std::chrono::milliseconds interval;
+        std::function<void()> task;
+    };
+
+    // Heap comparator, earliest deadline on top
+    static bool later(const job& a, const job& b)
+    {
+        return a.next > b.next;
+    }
+
+    std::vector<job> m_jobs;
+    std::thread m_scheduler;
     std::mutex m_thread_mutex;
+    std::condition_variable m_cv;
+    bool m_stop_requested = false; // Guarded by `m_thread_mutex`
 
-    template<typename T>
-    void reset_sketches_worker(int id, plugin_anomalydetection::Mutex<std::vector<std::shared_ptr<plugin::anomalydetection::num::cms<T>>>>& count_min_sketches)
+    void schedule(uint64_t interval_ms, std::function<void()> task)
     {
-        auto sketches = count_min_sketches.lock();
-        if (id >= 0 && id < sketches->size())
         {
-            auto& sketch_ptr = sketches->at(id);
-            if (sketch_ptr)
+            std::lock_guard<std::mutex> lock(m_thread_mutex);
+            std::chrono::milliseconds interval(interval_ms);
+            m_jobs.push_back(job{std::chrono::steady_clock::now() + interval, interval, std::move(task)});
+            std::push_heap(m_jobs.begin(), m_jobs.end(), later);
+            if (!m_scheduler.joinable())
             {
-                sketch_ptr->reset();
+                m_stop_requested = false;
+                m_scheduler = std::thread([this]() { run(); });
             }
         }
+        m_cv.notify_one();
     }
 
-    template<typename T>
-    void periodic_count_min_sketch_reset_worker(int id, uint64_t interval_ms, plugin_anomalydetection::Mutex<std::vector<std::shared_ptr<plugin::anomalydetection::num::cms<T>>>>& count_min_sketches)
+    void run()
     {
-        std::chrono::milliseconds interval(interval_ms);
-        while (true)
+        std::unique_lock<std::mutex> lock(m_thread_mutex);
+        while (!m_stop_requested)
         {
-            std::this_thread::sleep_for(interval);
+            if (m_jobs.empty())
             {
-                std::lock_guard<std::mutex> lock(m_thread_mutex);
-                if (m_stop_requested)
-                    break;
+                m_cv.wait(lock, [this]() { return m_stop_requested || !m_jobs.empty(); });
+                continue;
             }
+            auto next = m_jobs.front().next;
+            // Woken up early by a stop request or by a job due before `next`
+            if (m_cv.wait_until(lock, next, [this, next]() { return m_stop_requested || m_jobs.front().next < next; }))
+            {
+                continue;
+            }
+            std::pop_heap(m_jobs.begin(), m_jobs.end(), later);
+            job j = std::move(m_jobs.back());
+            m_jobs.pop_back();
 
+            lock.unlock();
             try
             {
-                reset_sketches_worker<T>(id, count_min_sketches);
+                j.task();
             } catch (const std::exception& e)
             {
             }
+            lock.lock();
+
+            j.next = std::chrono::steady_clock::now() + j.interval;
+            m_jobs.push_back(std::move(j));
+            std::push_heap(m_jobs.begin(), m_jobs.end(), later);
         }
     }
 };
@@ -17,10 +17,12 @@ limitations under the License.
 
 #include "plugin_utils.h"
 
-#define SCAP_MAX_PATH_SIZE 1024
+#include <algorithm>
+#include <array>
+#include <stdexcept>
 
 // Copied from falcosecurity/libs and adjusted w/ EPF_ANOMALY_PLUGIN flag and extended via adding custom fields
-static const filtercheck_field_info sinsp_filter_check_fields[] =
+static constexpr filtercheck_field_info sinsp_filter_check_fields[] =
 {
 	{PT_CHARBUF, EPF_ANOMALY_PLUGIN | EPF_NONE, PF_NA, "proc.exe", "First Argument", "The first command-line argument (i.e., argv[0]), typically the executable name or a custom string as specified by the user. It is primarily obtained from syscall arguments, truncated after 4096 bytes, or, as a fallback, by reading /proc/PID/cmdline, in which case it may be truncated after 1024 bytes. This field may differ from the last component of proc.exepath, reflecting how command invocation and execution paths can vary."},
 	{PT_CHARBUF, EPF_ANOMALY_PLUGIN | EPF_NONE, PF_NA, "proc.pexe", "Parent First Argument", "The proc.exe (first command line argument argv[0]) of the parent process."},
@@ -379,96 +381,180 @@ static inline bool concatenate_paths_(char* target, uint32_t targetlen, const ch
 }
 
 // Adopted from falcosecurity/libs, custom hand-rolled for performance reasons
+std::string_view concatenate_paths(std::string_view path1, std::string_view path2, char* target, uint32_t targetlen)
+{
+	if(path2.data() == nullptr)
+	{
+		path2 = "";
+	}
+	concatenate_paths_(target, targetlen, path1.data(), (uint32_t)path1.length(), path2.data(),
+				  path2.size());
+	return std::string_view(target);
+}
+
 std::string concatenate_paths(std::string_view path1, std::string_view path2)
 {
 	char fullpath[SCAP_MAX_PATH_SIZE];
-	concatenate_paths_(fullpath, SCAP_MAX_PATH_SIZE, path1.data(), (uint32_t)path1.length(), path2.data(),
-				  path2.size());
-	return std::string(fullpath);
+	return std::string(concatenate_paths(path1, path2, fullpath, SCAP_MAX_PATH_SIZE));
+}
+
+// Compile-time name -> check_type index over `sinsp_filter_check_fields`, open addressing with linear probing
+// in a table at least twice as large as the catalog, so that a lookup is one hash and a probe or two.
+static constexpr size_t n_filter_check_fields = sizeof(sinsp_filter_check_fields) / sizeof(sinsp_filter_check_fields[0]);
+static constexpr size_t field_index_size = 512;
+static_assert(n_filter_check_fields == plugin_sinsp_filterchecks::TYPE_CUSTOM_FDNAME_PART2 + 1, "field catalog out of sync with check_type");
+static_assert(2 * n_filter_check_fields <= field_index_size, "field index too small");
+
+static constexpr uint64_t field_name_hash(const char* name, size_t len)
+{
+	// FNV-1a
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < len; ++i)
+	{
+		h = (h ^ (uint8_t)name[i]) * 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static constexpr size_t field_name_length(const char* name)
+{
+	size_t len = 0;
+	while (name[len] != '\0')
+	{
+		++len;
+	}
+	return len;
+}
+
+static constexpr std::array<int16_t, field_index_size> build_field_index()
+{
+	std::array<int16_t, field_index_size> index = {};
+	for (size_t slot = 0; slot < field_index_size; ++slot)
+	{
+		index[slot] = -1;
+	}
+	for (size_t i = 0; i < n_filter_check_fields; ++i)
+	{
+		const char* name = sinsp_filter_check_fields[i].m_name;
+		size_t slot = field_name_hash(name, field_name_length(name)) & (field_index_size - 1);
+		while (index[slot] != -1)
+		{
+			slot = (slot + 1) & (field_index_size - 1);
+		}
+		index[slot] = (int16_t)i;
+	}
+	return index;
+}
+
+static constexpr std::array<int16_t, field_index_size> field_index = build_field_index();
+
+// Index of `name` in `sinsp_filter_check_fields`, -1 if unknown
+static int find_field(std::string_view name)
+{
+	size_t slot = field_name_hash(name.data(), name.size()) & (field_index_size - 1);
+	while (field_index[slot] != -1)
+	{
+		if (std::string_view(sinsp_filter_check_fields[field_index[slot]].m_name) == name)
+		{
+			return field_index[slot];
+		}
+		slot = (slot + 1) & (field_index_size - 1);
+	}
+	return -1;
+}
+
+static inline bool is_lineage_field(plugin_sinsp_filterchecks::check_type id)
+{
+	return id == plugin_sinsp_filterchecks::TYPE_CUSTOM_ANAME_LINEAGE_CONCAT ||
+		id == plugin_sinsp_filterchecks::TYPE_CUSTOM_AEXE_LINEAGE_CONCAT ||
+		id == plugin_sinsp_filterchecks::TYPE_CUSTOM_AEXEPATH_LINEAGE_CONCAT;
+}
+
+static inline bool is_arg_field(plugin_sinsp_filterchecks::check_type id)
+{
+	return id == plugin_sinsp_filterchecks::TYPE_ENV ||
+		id == plugin_sinsp_filterchecks::TYPE_APID ||
+		id == plugin_sinsp_filterchecks::TYPE_ANAME ||
+		id == plugin_sinsp_filterchecks::TYPE_AEXE ||
+		id == plugin_sinsp_filterchecks::TYPE_AEXEPATH ||
+		id == plugin_sinsp_filterchecks::TYPE_ACMDLINE ||
+		is_lineage_field(id);
+}
+
+static inline bool is_profile_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
 }
 
 const std::vector<plugin_sinsp_filterchecks_field> get_profile_fields(const std::string& behavior_profile)
 {
 	std::vector<plugin_sinsp_filterchecks_field> fields;
-	std::regex pattern(R"(%(\S+))");
-	std::sregex_iterator iter(behavior_profile.begin(), behavior_profile.end(), pattern);
-	std::sregex_iterator end;
+	std::string_view profile(behavior_profile);
+	size_t pos = 0;
+	while ((pos = profile.find('%', pos)) != std::string_view::npos)
+	{
+		// A field spans from '%' to the next whitespace, e.g. `%proc.name` or `%proc.aname[2]`
+		size_t end = pos + 1;
+		while (end < profile.size() && !is_profile_space(profile[end]))
+		{
+			++end;
+		}
+		std::string_view rawfield = profile.substr(pos + 1, end - pos - 1);
+		pos = end;
+		if (rawfield.empty())
+		{
+			continue;
+		}
 
-	plugin_sinsp_filterchecks::check_type id;
-	std::string fieldname;
-	std::int32_t argid = 0;
-	std::string argname = "";
+		std::string_view fieldname = rawfield;
+		std::string_view arg;
+		bool has_arg = false;
+		size_t start_pos = rawfield.find('[');
+		if (start_pos != std::string_view::npos && rawfield.back() == ']')
+		{
+			fieldname = rawfield.substr(0, start_pos);
+			arg = rawfield.substr(start_pos + 1, rawfield.size() - start_pos - 2);
+			has_arg = true;
+		}
 
-	while (iter != end)
-	{
-		// todo revisit this helper
-		auto rawfield = iter->str().substr(1);
-		std::string fieldname = rawfield;
-		bool found_match = false;
-		for (size_t i = 0; i < sizeof(sinsp_filter_check_fields) / sizeof(sinsp_filter_check_fields[0]); ++i)
+		int i = find_field(fieldname);
+		auto id = static_cast<plugin_sinsp_filterchecks::check_type>(i);
+		if (i < 0 || (has_arg && !is_arg_field(id)) || arg.find_first_of("[]") != std::string_view::npos)
+		{
+			throw std::invalid_argument("Remove the following invalid or mistyped behavior profile field: '" + std::string(rawfield) + "'");
+		}
+		if (!(sinsp_filter_check_fields[i].m_flags & EPF_ANOMALY_PLUGIN))
+		{
+			throw std::invalid_argument("Remove the following unsupported behavior profile field: '" + std::string(fieldname) + "'");
+		}
+
+		std::int32_t argid = 0;
+		std::string argname;
+		if (!arg.empty())
 		{
-			id = static_cast<plugin_sinsp_filterchecks::check_type>(i);
-			if(id == plugin_sinsp_filterchecks::TYPE_ENV ||
-				id == plugin_sinsp_filterchecks::TYPE_APID ||
-				id == plugin_sinsp_filterchecks::TYPE_ANAME ||
-				id == plugin_sinsp_filterchecks::TYPE_AEXE ||
-				id == plugin_sinsp_filterchecks::TYPE_AEXEPATH ||
-				id == plugin_sinsp_filterchecks::TYPE_ACMDLINE ||
-				id == plugin_sinsp_filterchecks::TYPE_CUSTOM_ANAME_LINEAGE_CONCAT||
-				id == plugin_sinsp_filterchecks::TYPE_CUSTOM_AEXE_LINEAGE_CONCAT ||
-				id == plugin_sinsp_filterchecks::TYPE_CUSTOM_AEXEPATH_LINEAGE_CONCAT
-				)
+			bool numeric = arg.size() <= 9 && std::all_of(arg.begin(), arg.end(), ::isdigit);
+			if (numeric)
 			{
-				size_t start_pos = rawfield.find('[');
-				size_t end_pos = rawfield.find(']');
-				if (start_pos != std::string::npos && end_pos != std::string::npos)
-				{
-					fieldname = rawfield.substr(0, start_pos);
-					std::string arg_str = rawfield.substr(start_pos + 1, end_pos - start_pos - 1);
-					if (!arg_str.empty())
-					{
-						argname = rawfield.substr(start_pos + 1, end_pos - start_pos - 1);
-						if (std::all_of(argname.begin(), argname.end(), ::isdigit))
-						{
-							argid = std::stoi(rawfield.substr(start_pos + 1, end_pos - start_pos - 1));
-							argname.clear();
-						}
-					}
-				}
+				argid = (std::int32_t)std::stoi(std::string(arg));
 			}
-			if (std::string(sinsp_filter_check_fields[i].m_name) == fieldname)
+			else
 			{
-				found_match = true;
-				if ((sinsp_filter_check_fields[i].m_flags & EPF_ANOMALY_PLUGIN))
-				{
-					if ((id == plugin_sinsp_filterchecks::TYPE_CUSTOM_ANAME_LINEAGE_CONCAT||
-						id == plugin_sinsp_filterchecks::TYPE_CUSTOM_AEXE_LINEAGE_CONCAT ||
-						id == plugin_sinsp_filterchecks::TYPE_CUSTOM_AEXEPATH_LINEAGE_CONCAT) 
-						&& argid == 0)
-					{
-						plugin_anomalydetection::utils::log_error("Usage of behavior profile field: '" + fieldname + "' requires an argument greater than 0 indicating the level of parent lineage traversal, e.g. '%custom.proc.aname.lineage.join[7]' or '%custom.proc.aexe.lineage.join[7]' or '%custom.proc.aexepath.lineage.join[7]' exiting...");
-                        exit(1);
-					}
-					fields.emplace_back(plugin_sinsp_filterchecks_field{
-						id,
-						argid,
-						argname
-					});
-				} else
-				{
-					plugin_anomalydetection::utils::log_error("Remove the following unsupported behavior profile field: '" + fieldname + "' exiting...");
-					exit(1);
-				}
+				argname = std::string(arg);
 			}
-			argid = 0;
-			argname.clear();
 		}
-		if (!found_match)
+		if (is_lineage_field(id) && argid == 0)
 		{
-			plugin_anomalydetection::utils::log_error("Remove the following invalid or mistyped behavior profile field: '" + fieldname + "' exiting...");
-			exit(1);
+			throw std::invalid_argument("Usage of behavior profile field: '" + std::string(fieldname) + "' requires an argument greater than 0 indicating the level of parent lineage traversal, e.g. '%custom.proc.aname.lineage.join[7]' or '%custom.proc.aexe.lineage.join[7]' or '%custom.proc.aexepath.lineage.join[7]'");
 		}
-		++iter;
+		fields.emplace_back(plugin_sinsp_filterchecks_field{
+			id,
+			argid,
+			argname
+		});
+	}
+	if (fields.empty())
+	{
+		throw std::invalid_argument("The behavior profile '" + behavior_profile + "' has no field, e.g. '%proc.name'");
 	}
 	return fields;
 }
@@ -22,9 +22,12 @@ limitations under the License.
 
 #include <falcosecurity/sdk.h>
 
-#include <regex>
+#include <stdexcept>
+#include <string_view>
 #include <unordered_set>
 
+#define SCAP_MAX_PATH_SIZE 1024
+
 typedef struct plugin_sinsp_filterchecks_field
 {
     plugin_sinsp_filterchecks::check_type id;
@@ -37,10 +40,16 @@ namespace plugin_anomalydetection::utils
     // Adopted from falcosecurity/libs, custom hand-rolled for performance reasons
     std::string concatenate_paths(std::string_view path1, std::string_view path2);
 
+    // Allocation free variant writing the resolved path to `target`, the returned view points into `target`.
+    // `path2` must be NUL terminated, e.g. a string param of the raw event buffer.
+    std::string_view concatenate_paths(std::string_view path1, std::string_view path2, char* target, uint32_t targetlen);
+
     // Temporary workaround; not as robust as libsinsp/eventformatter; 
     // ideally the plugin API exposes more libsinsp functionality in the near-term
     //
-    // No need for performance optimization atm as the typical use case is to have less than 3-8 sketches
+    // Resolves the `%field[arg]` tokens of the profile against a compile-time field index, no regex involved.
+    // Throws std::invalid_argument on the first unknown, mistyped or unsupported field, or without any field, so
+    // that a bad profile cannot load.
     const std::vector<plugin_sinsp_filterchecks_field> get_profile_fields(const std::string& behavior_profile);
 
     inline void log_error(std::string err_mess)
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <sinsp_with_test_input.h>
+#include <helpers/threads_helpers.h>
+#include <plugin_test_var.h>
+#include <test_helpers.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+/*
+Replay driver for the plugin parse / extract hot path. Events are injected through the inspector
+with the default mocked thread table, so each event pays the libsinsp parsing and the plugin
+`parse_event` (profile extraction, hashing and sketch updates of all interested sketches).
+Disabled by default, run with the `run-replay-benchmarks` target, `ANOMALYDETECTION_BENCH_EVENTS`
+overrides the number of replayed events.
+*/
+
+#define BENCH_DEFAULT_N_EVENTS 200000
+
+static uint64_t bench_n_events()
+{
+    const char* n = std::getenv("ANOMALYDETECTION_BENCH_EVENTS");
+    return n != nullptr ? std::stoull(n) : BENCH_DEFAULT_N_EVENTS;
+}
+
+static void bench_report(const char* name, uint64_t n_events, std::chrono::steady_clock::duration elapsed)
+{
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    printf("[bench] %s: %lu events, %.1f ns/event, %.0f events/s\n", name, n_events, ns / n_events, n_events / (ns / 1e9));
+}
+
+TEST_F(sinsp_with_test_input, DISABLED_plugin_anomalydetection_bench_parse_replay_open)
+{
+    std::shared_ptr<sinsp_plugin> plugin_owner;
+    filter_check_list pl_flist;
+    ASSERT_PLUGIN_INITIALIZATION(plugin_owner, pl_flist)
+    DEFAULT_TREE
+
+    uint64_t n_events = bench_n_events();
+    uint64_t ino = 777;
+    int64_t tids[] = {p2_t1_tid, p3_t1_tid, p4_t1_tid, p4_t2_tid, p5_t1_tid, p6_t1_tid};
+    std::string paths[] = {"/etc/passwd", "/etc/shadow", "/tmp/subdir1/subdir2/the_file", "/usr/lib/x86_64-linux-gnu/libc.so.6"};
+    sinsp_evt* evt = nullptr;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < n_events / 2; ++i)
+    {
+        int64_t tid = tids[i % (sizeof(tids) / sizeof(tids[0]))];
+        const auto& path = paths[i % (sizeof(paths) / sizeof(paths[0]))];
+        add_event(increasing_ts(), tid, PPME_SYSCALL_OPEN_E, 3, path.c_str(), 0, 0);
+        evt = add_event_advance_ts(increasing_ts(), tid, PPME_SYSCALL_OPEN_X, 6, (int64_t)(3 + i % 64), path.c_str(), 0, 0, 0, ino);
+    }
+    bench_report("parse_replay_open", n_events, std::chrono::steady_clock::now() - start);
+
+    ASSERT_TRUE(evt != nullptr);
+    ASSERT_NE(get_field_as_string(evt, "anomaly.count_min_sketch[1]", pl_flist), "0");
+
+    // Extraction of the count and profile fields on the last event
+    start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < n_events / 100; ++i)
+    {
+        get_field_as_string(evt, "anomaly.count_min_sketch[1]", pl_flist);
+        get_field_as_string(evt, "anomaly.count_min_sketch.profile[1]", pl_flist);
+    }
+    bench_report("extract_count_profile", 2 * (n_events / 100), std::chrono::steady_clock::now() - start);
+}
+
+TEST_F(sinsp_with_test_input, DISABLED_plugin_anomalydetection_bench_parse_replay_execve)
+{
+    std::shared_ptr<sinsp_plugin> plugin_owner;
+    filter_check_list pl_flist;
+    ASSERT_PLUGIN_INITIALIZATION(plugin_owner, pl_flist)
+    DEFAULT_TREE
+
+    // Exec heavy replay, two sketches with long lineage based profiles are interested in execve
+    uint64_t n_events = bench_n_events() / 10;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < n_events / 2; ++i)
+    {
+        generate_execve_enter_and_exit_event(0, p6_t1_tid, p6_t1_tid, p6_t1_pid, p6_t1_ptid, "/p6_t1_exepath", "p6_t1_comm", "/usr/bin/p6_t1_exepath");
+    }
+    bench_report("parse_replay_execve", n_events, std::chrono::steady_clock::now() - start);
+}
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <sinsp_with_test_input.h>
+#include <helpers/threads_helpers.h>
+#include <num/cms.h>
+#include <num/bloom_filter.h>
+#include <plugin_test_var.h>
+#include <test_helpers.h>
+
+#include <string>
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_bloom_filter_insert_contains)
+{
+    plugin::anomalydetection::num::bloom_filter filter(10000, 0.01);
+    EXPECT_FALSE(filter.contains("falco"));
+    EXPECT_FALSE(filter.insert("falco"));
+    EXPECT_TRUE(filter.insert("falco"));
+    EXPECT_TRUE(filter.contains("falco"));
+
+    // No false negatives
+    for (int i = 0; i < 10000; ++i)
+    {
+        filter.insert("value" + std::to_string(i));
+    }
+    for (int i = 0; i < 10000; ++i)
+    {
+        ASSERT_TRUE(filter.contains("value" + std::to_string(i)));
+    }
+
+    // False positives stay within the configured probability at capacity
+    int n_false_positives = 0;
+    for (int i = 0; i < 100000; ++i)
+    {
+        n_false_positives += filter.contains("other" + std::to_string(i)) ? 1 : 0;
+    }
+    EXPECT_LT(n_false_positives, 100000 * 0.01);
+    EXPECT_GT(filter.get_fill_ratio(), 0.0);
+
+    filter.reset();
+    EXPECT_FALSE(filter.contains("falco"));
+    EXPECT_EQ(filter.get_fill_ratio(), 0.0);
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_bloom_filter_size)
+{
+    plugin::anomalydetection::num::bloom_filter filter(100000, 0.01);
+    // One cache line per block
+    EXPECT_EQ(filter.get_size_bytes() % CMS_CACHE_LINE_SIZE, 0);
+    EXPECT_EQ(filter.get_size_bytes(), filter.get_n_blocks() * CMS_CACHE_LINE_SIZE);
+    // An order of magnitude below the default count min sketch
+    auto d = plugin::anomalydetection::num::cms<uint64_t>::calculate_d_rows_from_gamma(0.001);
+    auto w = plugin::anomalydetection::num::cms<uint64_t>::calculate_w_cols_buckets_from_eps(0.0001);
+    EXPECT_LT(filter.get_size_bytes() * 10, plugin::anomalydetection::num::cms<uint64_t>::get_size_bytes(d, w));
+
+    // The digest shared with the sketches yields the same answers
+    auto digest = plugin::anomalydetection::num::cms<uint64_t>::get_digest("falco");
+    EXPECT_FALSE(filter.insert(digest));
+    EXPECT_TRUE(filter.contains("falco"));
+}
+
+#undef INIT_CONFIG
+#define INIT_CONFIG "{\"bloom_filter\":{\"enabled\":true,\"behavior_profiles\":[\
+{\"fields\":\"%proc.name %fd.name\",\"event_codes\":[3],\"capacity\":1000,\"fpp\":0.001}]}}"
+
+TEST_F(sinsp_with_test_input, plugin_anomalydetection_bloom_filter_seen)
+{
+    std::shared_ptr<sinsp_plugin> plugin_owner;
+    filter_check_list pl_flist;
+    ASSERT_PLUGIN_INITIALIZATION(plugin_owner, pl_flist)
+    DEFAULT_TREE
+
+    auto open_on = [this](int64_t tid, int64_t fd, const char* name)
+    {
+        add_event(increasing_ts(), tid, PPME_SYSCALL_OPEN_E, 3, name, 0, 0);
+        return add_event_advance_ts(increasing_ts(), tid, PPME_SYSCALL_OPEN_X, 6, fd, name, 0, 0, 0, (uint64_t)777);
+    };
+
+    auto evt = open_on(p6_t1_tid, 4, "/tmp/the_file");
+    ASSERT_TRUE(field_exists(evt, "anomaly.bloom_filter.seen[0]", pl_flist));
+    ASSERT_EQ(get_field_as_string(evt, "anomaly.bloom_filter.seen[0]", pl_flist), "false");
+    // Repeated reads of the same event keep the answer of the first insert
+    ASSERT_EQ(get_field_as_string(evt, "anomaly.bloom_filter.seen[0]", pl_flist), "false");
+
+    evt = open_on(p6_t1_tid, 5, "/tmp/the_file");
+    ASSERT_EQ(get_field_as_string(evt, "anomaly.bloom_filter.seen[0]", pl_flist), "true");
+
+    evt = open_on(p6_t1_tid, 6, "/tmp/another_file");
+    ASSERT_EQ(get_field_as_string(evt, "anomaly.bloom_filter.seen[0]", pl_flist), "false");
+}
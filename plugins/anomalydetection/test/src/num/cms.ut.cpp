@@ -22,6 +22,10 @@ limitations under the License.
 #include <plugin_test_var.h>
 #include <test_helpers.h>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 TEST(plugin_anomalydetection, plugin_anomalydetection_cms_dim)
 {
     double gamma = 0.001;
@@ -63,6 +67,176 @@ TEST(plugin_anomalydetection, plugin_anomalydetection_cms_update_estimate)
     EXPECT_EQ(cms.estimate(test_str2), 0);
 }
 
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_pow2_cols)
+{
+    uint64_t d = 7;
+    uint64_t w = 27183;
+
+    plugin::anomalydetection::num::cms<uint64_t> cms_default(d, w);
+    EXPECT_EQ(cms_default.get_w(), w);
+    EXPECT_FALSE(cms_default.is_w_pow2());
+
+    plugin::anomalydetection::num::cms<uint64_t> cms_pow2(d, w, true);
+    EXPECT_EQ(cms_pow2.get_d(), d);
+    EXPECT_EQ(cms_pow2.get_w(), 32768);
+    EXPECT_TRUE(cms_pow2.is_w_pow2());
+    EXPECT_EQ(cms_pow2.get_size_bytes(), d * 32768 * sizeof(uint64_t));
+
+    plugin::anomalydetection::num::cms<uint64_t> cms_proba_pow2(0.001, 0.0001, true);
+    EXPECT_EQ(cms_proba_pow2.get_w(), 32768);
+    EXPECT_LT(cms_proba_pow2.get_eps(), 0.0001);
+
+    std::string test_str = "falco";
+    cms_pow2.update(test_str, 1);
+    cms_pow2.update(test_str, 1);
+    EXPECT_EQ(cms_pow2.estimate(test_str), 2);
+    EXPECT_EQ(cms_pow2.estimate("falco1"), 0);
+
+    // All counters live in one contiguous block, exactly one cell per row is set
+    uint64_t total = 0;
+    for (uint64_t row = 0; row < d; ++row)
+    {
+        for (uint64_t col = 0; col < cms_pow2.get_w(); ++col)
+        {
+            total += cms_pow2.get_item(row, col);
+        }
+    }
+    EXPECT_EQ(total, 2 * d);
+    EXPECT_EQ(cms_pow2.get_item(d, 0), 0);
+
+    // Copies are deep
+    auto cms_copy = cms_pow2;
+    cms_pow2.reset();
+    EXPECT_EQ(cms_pow2.estimate(test_str), 0);
+    EXPECT_EQ(cms_copy.estimate(test_str), 2);
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_double_hashing)
+{
+    uint64_t d = 7;
+    uint64_t w = 27183;
+
+    plugin::anomalydetection::num::cms<uint64_t> cms(d, w, false, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+    EXPECT_EQ(cms.get_hash_mode(), plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+
+    std::string test_str = "falco";
+    cms.update(test_str, 1);
+    cms.update(test_str, 1);
+    EXPECT_EQ(cms.update_estimate(test_str, 1), 3);
+    EXPECT_EQ(cms.estimate(test_str), 3);
+    EXPECT_EQ(cms.estimate("falco1"), 0);
+
+    // Each row is still updated exactly once
+    uint64_t total = 0;
+    for (uint64_t row = 0; row < d; ++row)
+    {
+        uint64_t row_total = 0;
+        for (uint64_t col = 0; col < w; ++col)
+        {
+            row_total += cms.get_item(row, col);
+        }
+        EXPECT_EQ(row_total, 3);
+        total += row_total;
+    }
+    EXPECT_EQ(total, 3 * d);
+
+    // Works together with power of two cols
+    plugin::anomalydetection::num::cms<uint64_t> cms_pow2(d, w, true, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+    cms_pow2.update(test_str, 5);
+    EXPECT_EQ(cms_pow2.estimate(test_str), 5);
+    EXPECT_EQ(cms_pow2.estimate("falco1"), 0);
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_string_view_digest)
+{
+    uint64_t d = 7;
+    uint64_t w = 27183;
+
+    plugin::anomalydetection::num::cms<uint64_t> cms(d, w, false, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+
+    std::string profile = "falco-profile";
+    std::string_view profile_view(profile.data(), 5); // "falco"
+    cms.update(profile_view, 1);
+    EXPECT_EQ(cms.estimate("falco"), 1);
+    EXPECT_EQ(cms.estimate(std::string("falco")), 1);
+
+    // Pre-hashed digests address the same counters as the string overloads
+    auto digest = plugin::anomalydetection::num::cms<uint64_t>::get_digest("falco");
+    cms.update(digest, 2);
+    EXPECT_EQ(cms.estimate(digest), 3);
+    EXPECT_EQ(cms.estimate(profile_view), 3);
+    EXPECT_EQ(cms.update_estimate(digest, 1), 4);
+
+    // Empty values are never counted
+    cms.update(std::string_view(), 1);
+    EXPECT_EQ(cms.estimate(std::string_view()), 0);
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_concurrent_reset)
+{
+    uint64_t d = 5;
+    uint64_t w = 1000;
+
+    auto cms = std::make_shared<plugin::anomalydetection::num::cms<uint64_t>>(d, w);
+    std::atomic<bool> stop(false);
+    std::thread resetter([&]()
+        {
+            while (!stop)
+            {
+                cms->reset();
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        });
+
+    // The writer is never blocked by the concurrent generation swaps
+    for (int i = 0; i < 100000; i++)
+    {
+        cms->update("falco", 1);
+        EXPECT_LE(cms->estimate("falco"), (uint64_t)(i + 1));
+    }
+    stop = true;
+    resetter.join();
+
+    cms->reset();
+    EXPECT_EQ(cms->estimate("falco"), 0);
+    cms->update("falco", 2);
+    EXPECT_EQ(cms->estimate("falco"), 2);
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_back_to_back_resets)
+{
+    uint64_t d = 3;
+    uint64_t w = 64;
+
+    // Resets in a row flip the epoch parity back while readers are still pinning a generation, the retired
+    // sketches must outlive them (run under ASan to catch a use after free)
+    auto cms = std::make_shared<plugin::anomalydetection::num::cms<uint64_t>>(d, w);
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; r++)
+    {
+        readers.emplace_back([&]()
+            {
+                while (!stop)
+                {
+                    EXPECT_EQ(cms->estimate("falco"), 0);
+                }
+            });
+    }
+
+    for (int i = 0; i < 20000; i++)
+    {
+        cms->reset();
+        cms->reset();
+    }
+    stop = true;
+    for (auto& t : readers)
+    {
+        t.join();
+    }
+    EXPECT_EQ(cms->estimate("falco"), 0);
+}
+
 TEST_F(sinsp_with_test_input, plugin_anomalydetection_filterchecks_fields)
 {
     std::shared_ptr<sinsp_plugin> plugin_owner;
@@ -326,3 +500,107 @@ TEST_F(sinsp_with_test_input, plugin_anomalydetection_filterchecks_fields_fd_net
     // no fallbacks atm
     ASSERT_EQ(get_field_as_string(evt, "anomaly.count_min_sketch.profile[1]", pl_flist), "16");
 }
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_conservative_update)
+{
+    uint64_t d = 4;
+    uint64_t w = 64;
+
+    plugin::anomalydetection::num::cms<uint64_t> cms_standard(d, w);
+    plugin::anomalydetection::num::cms<uint64_t> cms_conservative(d, w, false, plugin::anomalydetection::num::cms_hash_mode::SEEDED, true);
+    EXPECT_TRUE(cms_conservative.is_conservative_update());
+
+    // Exact counts for a single value
+    std::string test_str = "falco";
+    for (int i = 0; i < 5; ++i)
+    {
+        cms_conservative.update(test_str, 1);
+    }
+    EXPECT_EQ(cms_conservative.estimate(test_str), 5);
+    EXPECT_EQ(cms_conservative.update_estimate(test_str, 2), 7);
+
+    // Many colliding values, conservative estimates are upper bounds and never worse than standard ones
+    for (int i = 0; i < 1000; ++i)
+    {
+        std::string s = "value" + std::to_string(i);
+        cms_standard.update(s, (uint64_t)(i % 3 + 1));
+        cms_conservative.update(s, (uint64_t)(i % 3 + 1));
+    }
+    uint64_t standard_total = 0;
+    uint64_t conservative_total = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        std::string s = "value" + std::to_string(i);
+        auto c = cms_conservative.estimate(s);
+        EXPECT_GE(c, (uint64_t)(i % 3 + 1));
+        standard_total += cms_standard.estimate(s);
+        conservative_total += c;
+    }
+    EXPECT_LT(conservative_total, standard_total);
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_saturating_counters)
+{
+    plugin::anomalydetection::num::cms<uint16_t> cms16((uint64_t)3, (uint64_t)128);
+    EXPECT_EQ(cms16.get_size_bytes(), 3 * 128 * sizeof(uint16_t));
+
+    std::string test_str = "falco";
+    cms16.update(test_str, (uint16_t)65000);
+    cms16.update(test_str, (uint16_t)1000);
+    EXPECT_EQ(cms16.estimate(test_str), std::numeric_limits<uint16_t>::max());
+
+    plugin::anomalydetection::num::cms<uint32_t> cms32((uint64_t)3, (uint64_t)128, false, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING, true);
+    cms32.update(test_str, std::numeric_limits<uint32_t>::max() - 1);
+    EXPECT_EQ(cms32.update_estimate(test_str, (uint32_t)5), std::numeric_limits<uint32_t>::max());
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_fill_ratio)
+{
+    plugin::anomalydetection::num::cms<uint32_t> cms((uint64_t)2, (uint64_t)10);
+    EXPECT_DOUBLE_EQ(cms.get_fill_ratio(), 0.0);
+    cms.update("falco", 1);
+    // One cell per row
+    EXPECT_DOUBLE_EQ(cms.get_fill_ratio(), 0.1);
+    cms.update("falco", 5);
+    EXPECT_DOUBLE_EQ(cms.get_fill_ratio(), 0.1);
+    cms.reset();
+    EXPECT_DOUBLE_EQ(cms.get_fill_ratio(), 0.0);
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_prefetch)
+{
+    plugin::anomalydetection::num::cms<uint64_t> cms((uint64_t)5, (uint64_t)1000, false, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+    auto digest = plugin::anomalydetection::num::cms<uint64_t>::get_digest("falco");
+    cms.update(digest, 3);
+    // Only a cache hint, estimates are unaffected, also right after a reset retired the generation
+    cms.prefetch(digest);
+    EXPECT_EQ(cms.estimate(digest), 3);
+    cms.reset();
+    cms.prefetch(digest);
+    EXPECT_EQ(cms.estimate(digest), 0);
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_merge)
+{
+    plugin::anomalydetection::num::cms<uint16_t> a((uint64_t)4, (uint64_t)256);
+    plugin::anomalydetection::num::cms<uint16_t> b((uint64_t)4, (uint64_t)256);
+    a.update("falco", 3);
+    b.update("falco", 4);
+    b.update("sysdig", 1);
+    ASSERT_TRUE(a.merge(b));
+    EXPECT_EQ(a.estimate("falco"), 7);
+    EXPECT_EQ(a.estimate("sysdig"), 1);
+    EXPECT_EQ(b.estimate("falco"), 4);
+
+    // Merged counts saturate like updates
+    b.update("falco", UINT16_MAX);
+    ASSERT_TRUE(a.merge(b));
+    EXPECT_EQ(a.estimate("falco"), UINT16_MAX);
+
+    // Incompatible layouts are rejected
+    plugin::anomalydetection::num::cms<uint16_t> other_dims((uint64_t)4, (uint64_t)128);
+    EXPECT_FALSE(a.merge(other_dims));
+    plugin::anomalydetection::num::cms<uint16_t> other_hash((uint64_t)4, (uint64_t)256, false, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+    EXPECT_FALSE(a.merge(other_hash));
+    EXPECT_FALSE(a.merge(a));
+}
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <num/cms_shared.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+static std::string shared_test_path(const std::string& name)
+{
+    return "/tmp/anomalydetection_" + name + "_" + std::to_string(getpid()) + ".shm";
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_shared_reader)
+{
+    std::string err;
+    for (auto mode : {plugin::anomalydetection::num::cms_hash_mode::SEEDED, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING})
+    {
+        auto path = shared_test_path("cms");
+        plugin::anomalydetection::num::cms<uint16_t> cms((uint64_t)4, (uint64_t)100, false, mode);
+        // Counts collected before attaching are kept
+        cms.update("falco", (uint16_t)3);
+        ASSERT_TRUE(plugin::anomalydetection::num::cms_shared::attach(path, cms, 42, err)) << err;
+        EXPECT_TRUE(cms.has_storage());
+        cms.update("falco", (uint16_t)4);
+        cms.update("sysdig", (uint16_t)1);
+
+        plugin::anomalydetection::num::cms_shared_reader<uint16_t> reader;
+        ASSERT_TRUE(reader.open(path, err)) << err;
+        EXPECT_EQ(reader.header()->d, 4);
+        EXPECT_EQ(reader.header()->w, 100);
+        EXPECT_EQ(reader.header()->definition_hash, 42);
+        EXPECT_EQ(reader.header()->hash_mode, static_cast<uint8_t>(mode));
+        EXPECT_EQ(reader.get_generation(), 0);
+        EXPECT_EQ(reader.estimate("falco"), cms.estimate("falco"));
+        EXPECT_EQ(reader.estimate("sysdig"), cms.estimate("sysdig"));
+        EXPECT_EQ(reader.estimate("unknown"), cms.estimate("unknown"));
+        EXPECT_DOUBLE_EQ(reader.get_fill_ratio(), cms.get_fill_ratio());
+
+        // Updates count in the other slot after a reset, twice to reuse the first one
+        for (uint64_t generation = 1; generation <= 2; ++generation)
+        {
+            cms.reset();
+            EXPECT_EQ(reader.get_generation(), generation);
+            EXPECT_EQ(reader.estimate("falco"), 0);
+            cms.update("falco", (uint16_t)2);
+            EXPECT_EQ(reader.estimate("falco"), 2);
+            EXPECT_EQ(cms.estimate("falco"), 2);
+        }
+        std::vector<uint16_t> counters(4 * 100);
+        reader.copy_counters(counters.data());
+        std::vector<uint16_t> expected(4 * 100);
+        cms.copy_counters(expected.data());
+        EXPECT_EQ(counters, expected);
+        std::remove(path.c_str());
+    }
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_shared_invalid)
+{
+    std::string err;
+    auto path = shared_test_path("cms_invalid");
+    plugin::anomalydetection::num::cms_shared_reader<uint32_t> reader;
+    EXPECT_FALSE(reader.open(path, err));
+
+    // Counter width mismatch
+    plugin::anomalydetection::num::cms<uint64_t> cms((uint64_t)2, (uint64_t)16);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_shared::attach(path, cms, 1, err)) << err;
+    EXPECT_FALSE(reader.open(path, err));
+
+    // The sketch outlives the file
+    std::remove(path.c_str());
+    cms.update("falco", (uint64_t)1);
+    EXPECT_EQ(cms.estimate("falco"), 1);
+    auto moved = std::move(cms);
+    EXPECT_TRUE(moved.has_storage());
+    EXPECT_EQ(moved.estimate("falco"), 1);
+}
@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <num/cms_snapshot.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+static std::string snapshot_test_path(const std::string& name)
+{
+    return "/tmp/anomalydetection_" + name + "_" + std::to_string(getpid()) + ".snap";
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_snapshot_roundtrip)
+{
+    std::string err;
+    auto path = snapshot_test_path("cms");
+    uint64_t definition_hash = 42;
+
+    plugin::anomalydetection::num::cms<uint32_t> cms((uint64_t)4, (uint64_t)100, true, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+    cms.update("falco", (uint32_t)7);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::save(path, cms, definition_hash, err));
+
+    // Different profile definition or layout, the snapshot is rejected and nothing is loaded
+    plugin::anomalydetection::num::cms<uint32_t> cms_other_definition((uint64_t)4, (uint64_t)100, true, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+    EXPECT_FALSE(plugin::anomalydetection::num::cms_snapshot::load(path, cms_other_definition, definition_hash + 1, err));
+    EXPECT_EQ(cms_other_definition.estimate("falco"), 0);
+    plugin::anomalydetection::num::cms<uint64_t> cms_other_counters((uint64_t)4, (uint64_t)100, true, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+    EXPECT_FALSE(plugin::anomalydetection::num::cms_snapshot::load(path, cms_other_counters, definition_hash, err));
+    plugin::anomalydetection::num::cms<uint32_t> cms_other_dims((uint64_t)4, (uint64_t)101, false, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+    EXPECT_FALSE(plugin::anomalydetection::num::cms_snapshot::load(path, cms_other_dims, definition_hash, err));
+
+    plugin::anomalydetection::num::cms<uint32_t> cms_restored((uint64_t)4, (uint64_t)100, true, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::load(path, cms_restored, definition_hash, err));
+    EXPECT_EQ(cms_restored.estimate("falco"), 7);
+    EXPECT_EQ(cms_restored.estimate("falco1"), 0);
+
+    std::remove(path.c_str());
+    EXPECT_FALSE(plugin::anomalydetection::num::cms_snapshot::load(path, cms_restored, definition_hash, err));
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_sliding_cms_snapshot_roundtrip)
+{
+    std::string err;
+    auto path = snapshot_test_path("sliding_cms");
+
+    plugin::anomalydetection::num::sliding_cms<uint16_t> sketch((uint64_t)3, (uint64_t)64, (uint64_t)3, (uint64_t)300);
+    sketch.advance(1000);
+    sketch.update("falco", (uint16_t)1);
+    sketch.advance(1100);
+    sketch.update("falco", (uint16_t)2);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::save(path, sketch, 1, err));
+
+    plugin::anomalydetection::num::sliding_cms<uint16_t> restored((uint64_t)3, (uint64_t)64, (uint64_t)3, (uint64_t)300);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::load(path, restored, 1, err));
+    EXPECT_EQ(restored.estimate("falco"), 3);
+    EXPECT_EQ(restored.get_head(), sketch.get_head());
+
+    // The ring position is restored as well, buckets keep expiring in order
+    restored.advance(1200);
+    EXPECT_EQ(restored.estimate("falco"), 3);
+    restored.advance(1300);
+    EXPECT_EQ(restored.estimate("falco"), 2);
+
+    std::remove(path.c_str());
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_snapshot_merge_files)
+{
+    std::string err;
+    auto node_a = snapshot_test_path("node_a");
+    auto node_b = snapshot_test_path("node_b");
+    auto merged = snapshot_test_path("merged");
+    uint64_t definition_hash = 7;
+
+    // Per node sketches, a sliding window one is summed over its buckets
+    plugin::anomalydetection::num::cms<uint32_t> a((uint64_t)3, (uint64_t)128, false, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+    a.update("falco", (uint32_t)2);
+    a.update("node_a_only", (uint32_t)1);
+    plugin::anomalydetection::num::sliding_cms<uint32_t> b((uint64_t)3, (uint64_t)128, (uint64_t)2, (uint64_t)200, false, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+    b.advance(1000);
+    b.update("falco", (uint32_t)3);
+    b.advance(1100);
+    b.update("falco", (uint32_t)4);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::save(node_a, a, definition_hash, err));
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::save(node_b, b, definition_hash, err));
+
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::merge_files<uint32_t>({node_a, node_b}, merged, err)) << err;
+    EXPECT_FALSE(plugin::anomalydetection::num::cms_snapshot::merge_files<uint64_t>({node_a, node_b}, merged + ".64", err));
+
+    // A new node imports the cluster baseline on top of its own (empty) counts
+    plugin::anomalydetection::num::cms<uint32_t> fresh((uint64_t)3, (uint64_t)128, false, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+    EXPECT_FALSE(plugin::anomalydetection::num::cms_snapshot::merge(merged, fresh, definition_hash + 1, err));
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::merge(merged, fresh, definition_hash, err));
+    EXPECT_EQ(fresh.estimate("falco"), 9);
+    EXPECT_EQ(fresh.estimate("node_a_only"), 1);
+
+    plugin::anomalydetection::num::sliding_cms<uint32_t> fresh_sliding((uint64_t)3, (uint64_t)128, (uint64_t)4, (uint64_t)400, false, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::merge(merged, fresh_sliding, definition_hash, err));
+    EXPECT_EQ(fresh_sliding.estimate("falco"), 9);
+
+    std::remove(node_a.c_str());
+    std::remove(node_b.c_str());
+    std::remove(merged.c_str());
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_snapshot_delta_export)
+{
+    std::string err;
+    auto cluster = snapshot_test_path("cluster");
+    auto exported = snapshot_test_path("exported");
+    auto baseline_path = snapshot_test_path("baseline");
+    uint64_t definition_hash = 11;
+
+    plugin::anomalydetection::num::cms<uint32_t> seed((uint64_t)3, (uint64_t)128);
+    seed.update("falco", (uint32_t)5);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::save(cluster, seed, definition_hash, err));
+
+    // The imported counts count for the estimates of the node, not for its exports
+    plugin::anomalydetection::num::cms_snapshot_baseline baseline;
+    plugin::anomalydetection::num::cms<uint32_t> node((uint64_t)3, (uint64_t)128);
+    EXPECT_FALSE(plugin::anomalydetection::num::cms_snapshot::import(cluster, node, definition_hash + 1, baseline, err));
+    EXPECT_TRUE(baseline.counters.empty());
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::import(cluster, node, definition_hash, baseline, err)) << err;
+    node.update("falco", (uint32_t)2);
+    EXPECT_EQ(node.estimate("falco"), 7);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::save_delta(exported, node, baseline, definition_hash, err));
+    plugin::anomalydetection::num::cms<uint32_t> delta((uint64_t)3, (uint64_t)128);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::load(exported, delta, definition_hash, err));
+    EXPECT_EQ(delta.estimate("falco"), 2);
+
+    // The baseline survives a warm start from the own snapshot
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::save_baseline(baseline_path, node, baseline, definition_hash, err));
+    plugin::anomalydetection::num::cms<uint32_t> restarted(node);
+    plugin::anomalydetection::num::cms_snapshot_baseline restored;
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::load_baseline(baseline_path, restarted, definition_hash, restored, err)) << err;
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::save_delta(exported, restarted, restored, definition_hash, err));
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::load(exported, delta, definition_hash, err));
+    EXPECT_EQ(delta.estimate("falco"), 2);
+
+    // Once reset, the imported counts are gone and the sketch is exported as is
+    node.reset();
+    node.update("falco", (uint32_t)1);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::save_delta(exported, node, baseline, definition_hash, err));
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::load(exported, delta, definition_hash, err));
+    EXPECT_EQ(delta.estimate("falco"), 1);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::save_baseline(baseline_path, node, baseline, definition_hash, err));
+    EXPECT_FALSE(plugin::anomalydetection::num::cms_snapshot::load_baseline(baseline_path, node, definition_hash, restored, err));
+
+    // Sliding window sketches import into the head bucket, which expires like any other
+    plugin::anomalydetection::num::cms_snapshot_baseline sliding_baseline;
+    plugin::anomalydetection::num::sliding_cms<uint32_t> sliding((uint64_t)3, (uint64_t)128, (uint64_t)2, (uint64_t)200);
+    sliding.advance(1000);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::import(cluster, sliding, definition_hash, sliding_baseline, err));
+    sliding.update("falco", (uint32_t)1);
+    sliding.advance(1100);
+    sliding.update("falco", (uint32_t)1);
+    EXPECT_EQ(sliding.estimate("falco"), 7);
+    plugin::anomalydetection::num::sliding_cms<uint32_t> sliding_delta((uint64_t)3, (uint64_t)128, (uint64_t)2, (uint64_t)200);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::save_delta(exported, sliding, sliding_baseline, definition_hash, err));
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::load(exported, sliding_delta, definition_hash, err));
+    EXPECT_EQ(sliding_delta.estimate("falco"), 2);
+    sliding.advance(1200);
+    sliding.update("falco", (uint32_t)1);
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::save_delta(exported, sliding, sliding_baseline, definition_hash, err));
+    ASSERT_TRUE(plugin::anomalydetection::num::cms_snapshot::load(exported, sliding_delta, definition_hash, err));
+    EXPECT_EQ(sliding_delta.estimate("falco"), 2);
+
+    std::remove(cluster.c_str());
+    std::remove(exported.c_str());
+    std::remove(baseline_path.c_str());
+}
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <num/sliding_cms.h>
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_sliding_cms_window)
+{
+    uint64_t d = 7;
+    uint64_t w = 1024;
+    uint64_t n_buckets = 4;
+    uint64_t window_ns = 4000;
+
+    plugin::anomalydetection::num::sliding_cms<uint64_t> sketch(d, w, n_buckets, window_ns);
+    EXPECT_EQ(sketch.get_n_buckets(), n_buckets);
+    EXPECT_EQ(sketch.get_bucket_ns(), 1000);
+
+    std::string test_str = "falco";
+    uint64_t ts = 10000;
+    for (uint64_t i = 0; i < n_buckets; ++i)
+    {
+        sketch.advance(ts + i * 1000);
+        sketch.update(test_str, 1);
+    }
+    // All updates still within the window
+    EXPECT_EQ(sketch.estimate(test_str), n_buckets);
+
+    // Each bucket step expires the oldest bucket only
+    sketch.advance(ts + n_buckets * 1000);
+    EXPECT_EQ(sketch.estimate(test_str), n_buckets - 1);
+    sketch.advance(ts + (n_buckets + 1) * 1000);
+    EXPECT_EQ(sketch.estimate(test_str), n_buckets - 2);
+
+    // Out of order timestamps are accounted to the head bucket
+    sketch.advance(ts);
+    sketch.update(test_str, 1);
+    EXPECT_EQ(sketch.estimate(test_str), n_buckets - 1);
+
+    // Large gaps clear the whole window
+    sketch.advance(ts + 100 * 1000);
+    EXPECT_EQ(sketch.estimate(test_str), 0);
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_sliding_cms_digest_reset)
+{
+    plugin::anomalydetection::num::sliding_cms<uint64_t> sketch((uint64_t)5, (uint64_t)1024, (uint64_t)3, (uint64_t)3000, true, plugin::anomalydetection::num::cms_hash_mode::DOUBLE_HASHING);
+
+    std::string test_str = "falco";
+    auto digest = plugin::anomalydetection::num::cms<uint64_t>::get_digest(test_str);
+    sketch.advance(0);
+    sketch.update(digest, 2);
+    sketch.advance(1000);
+    sketch.update(test_str, 3);
+    EXPECT_EQ(sketch.estimate(digest), 5);
+    EXPECT_EQ(sketch.estimate(test_str), 5);
+
+    sketch.reset();
+    EXPECT_EQ(sketch.estimate(test_str), 0);
+}
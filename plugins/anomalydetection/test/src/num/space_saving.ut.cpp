@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <num/cms.h>
+#include <num/space_saving.h>
+
+#include <string>
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_space_saving_top_k)
+{
+    plugin::anomalydetection::num::space_saving<uint64_t> top_k(3);
+    EXPECT_EQ(top_k.capacity(), 3);
+
+    auto update = [&top_k](const std::string& value, uint64_t count)
+    {
+        top_k.update(value, plugin::anomalydetection::num::cms<uint64_t>::get_digest(value).h1, count);
+    };
+
+    // Heavy hitters interleaved with a long tail of rare values
+    for (int i = 0; i < 300; ++i)
+    {
+        update("heavy1", 3);
+        update("heavy2", 2);
+        update("rare" + std::to_string(i), 1);
+    }
+    EXPECT_EQ(top_k.size(), 3);
+
+    auto res = top_k.top(2);
+    ASSERT_EQ(res.size(), 2);
+    EXPECT_EQ(res[0].value, "heavy1");
+    EXPECT_EQ(res[0].count, 900);
+    EXPECT_EQ(res[0].error, 0);
+    EXPECT_EQ(res[1].value, "heavy2");
+    EXPECT_EQ(res[1].count, 600);
+
+    // The third slot keeps being recycled by rare values, inheriting the minimum as error bound
+    auto all = top_k.top();
+    ASSERT_EQ(all.size(), 3);
+    EXPECT_EQ(all[2].count - all[2].error, 1);
+    EXPECT_EQ(top_k.min_count(), all[2].count);
+
+    top_k.reset();
+    EXPECT_EQ(top_k.size(), 0);
+    EXPECT_EQ(top_k.min_count(), 0);
+}
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <sinsp_with_test_input.h>
+#include <helpers/threads_helpers.h>
+#include <plugin_test_var.h>
+#include <test_helpers.h>
+
+#include <string>
+
+static std::string profile_config(const std::string& fields, const std::string& event_codes = "[3]")
+{
+    return "{\"count_min_sketch\":{\"enabled\":true,\"n_sketches\":1,\"rows_cols\":[[5,1024]],\"behavior_profiles\":[{\"fields\":\"" +
+           fields + "\",\"event_codes\":" + event_codes + "}]}}";
+}
+
+// Whether the plugin refuses to load `config`, with the reason in `err`
+static bool init_fails(sinsp& inspector, const std::string& config, std::string& err)
+{
+    auto plugin_owner = inspector.register_plugin(PLUGIN_PATH);
+    try
+    {
+        return !plugin_owner->init(config, err);
+    }
+    catch(const sinsp_exception& e)
+    {
+        err = e.what();
+        return true;
+    }
+}
+
+TEST_F(sinsp_with_test_input, plugin_anomalydetection_behavior_profile_valid)
+{
+    std::string err;
+    EXPECT_FALSE(init_fails(m_inspector, profile_config("%proc.name %fd.name"), err)) << err;
+    EXPECT_FALSE(init_fails(m_inspector, profile_config("%proc.aname[2] %custom.proc.aname.lineage.join[3]"), err)) << err;
+}
+
+TEST_F(sinsp_with_test_input, plugin_anomalydetection_behavior_profile_malformed)
+{
+    const std::string malformed[] = {
+        "",
+        "% ",
+        "%proc.nam",
+        "%not.a.field",
+        "%proc.aname[2",
+        "%proc.name]",
+        "%proc.aname[[2]]",
+        "%proc.name[1]",
+        "%proc.aenv[2]",
+        "%custom.proc.aname.lineage.join",
+    };
+    for (const auto& fields : malformed)
+    {
+        std::string err;
+        EXPECT_TRUE(init_fails(m_inspector, profile_config(fields), err)) << "'" << fields << "'";
+    }
+
+    // The fields must match the event codes
+    std::string err;
+    EXPECT_TRUE(init_fails(m_inspector, profile_config("%fd.name", "[293]"), err));
+    EXPECT_NE(err.find("'%fd' related fields"), std::string::npos) << err;
+    EXPECT_TRUE(init_fails(m_inspector, profile_config("%proc.aname[2"), err));
+    EXPECT_NE(err.find("proc.aname[2"), std::string::npos) << err;
+}
@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <sinsp_with_test_input.h>
+#include <helpers/threads_helpers.h>
+#include <plugin_test_var.h>
+#include <test_helpers.h>
+#include <plugin_container_scoped.h>
+
+#include <algorithm>
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_container_scoped_lru)
+{
+    // Two scopes of 3 and 1 values of 10 bytes
+    container_scoped<int> scoped({30, 10});
+    EXPECT_EQ(scoped.find("c1"), container_scoped<int>::npos);
+    scoped.insert(0, "c1", 1, 10);
+    scoped.insert(0, "c2", 2, 10);
+    scoped.insert(0, "c3", 3, 10);
+    EXPECT_EQ(scoped.size(0), 3);
+    EXPECT_EQ(scoped.memory_bytes(0), 30);
+    EXPECT_EQ(scoped.n_containers(), 3);
+
+    // Indices are shared by the scopes
+    auto c1 = scoped.find("c1");
+    ASSERT_NE(c1, container_scoped<int>::npos);
+    scoped.insert(1, "c1", 10, 10);
+    EXPECT_EQ(scoped.find("c1"), c1);
+    EXPECT_EQ(*scoped.get(1, c1), 10);
+    EXPECT_EQ(scoped.get(1, scoped.find("c2")), nullptr);
+
+    // c1 is used, c2 becomes the least recently used one and gets evicted
+    EXPECT_EQ(*scoped.get(0, c1), 1);
+    scoped.insert(0, "c4", 4, 10);
+    EXPECT_EQ(scoped.size(0), 3);
+    EXPECT_EQ(scoped.n_evictions(0), 1);
+    EXPECT_EQ(scoped.find("c2"), container_scoped<int>::npos);
+    EXPECT_EQ(*scoped.get(0, scoped.find("c3")), 3);
+
+    // A value larger than the budget is still kept, alone
+    scoped.insert(1, "c5", 5, 100);
+    EXPECT_EQ(scoped.size(1), 1);
+    EXPECT_EQ(*scoped.get(1, scoped.find("c5")), 5);
+    // c1 is still held by scope 0
+    EXPECT_EQ(scoped.find("c1"), c1);
+    EXPECT_EQ(scoped.get(1, c1), nullptr);
+
+    // Replacing a value updates its accounted size
+    scoped.insert(0, "c4", 40, 5);
+    EXPECT_EQ(scoped.memory_bytes(0), 25);
+    EXPECT_EQ(*scoped.get(0, scoped.find("c4")), 40);
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_container_scoped_erase)
+{
+    container_scoped<int> scoped({100, 100});
+    scoped.insert(0, "c1", 1, 10);
+    auto c1 = scoped.find("c1");
+    scoped.insert(1, "c1", 2, 10);
+    scoped.insert(0, "c2", 3, 10);
+    auto c2 = scoped.find("c2");
+
+    EXPECT_FALSE(scoped.erase("unknown"));
+    EXPECT_TRUE(scoped.erase("c1"));
+    EXPECT_EQ(scoped.find("c1"), container_scoped<int>::npos);
+    EXPECT_EQ(scoped.size(0), 1);
+    EXPECT_EQ(scoped.size(1), 0);
+    EXPECT_EQ(scoped.memory_bytes(1), 0);
+    EXPECT_EQ(*scoped.get(0, c2), 3);
+
+    // The released index is recycled
+    scoped.insert(1, "c3", 4, 10);
+    EXPECT_EQ(scoped.find("c3"), c1);
+    EXPECT_EQ(scoped.n_containers(), 2);
+    std::vector<std::string> ids;
+    scoped.for_each_container([&](const std::string& id) { ids.push_back(id); });
+    std::sort(ids.begin(), ids.end());
+    EXPECT_EQ(ids, (std::vector<std::string>{"c2", "c3"}));
+
+    scoped.clear();
+    EXPECT_EQ(scoped.n_containers(), 0);
+    EXPECT_EQ(scoped.size(0), 0);
+    EXPECT_EQ(scoped.find("c2"), container_scoped<int>::npos);
+}
+
+#undef INIT_CONFIG
+#define INIT_CONFIG "{\"count_min_sketch\":{\"enabled\":true,\"n_sketches\":1,\"rows_cols\":[[5,1024]],\"behavior_profiles\":[\
+{\"fields\":\"%proc.name %fd.name\",\
+\"event_codes\":[3],\"per_container\":true,\"per_container_rows_cols\":[3,64],\"per_container_max_bytes\":65536}]}}"
+
+TEST_F(sinsp_with_test_input, plugin_anomalydetection_container_scoped_host_fallback)
+{
+    std::shared_ptr<sinsp_plugin> plugin_owner;
+    filter_check_list pl_flist;
+    ASSERT_PLUGIN_INITIALIZATION(plugin_owner, pl_flist)
+    DEFAULT_TREE
+
+    // Threads without a container id count in the node wide sketch
+    sinsp_evt* evt = nullptr;
+    for (int64_t fd = 4; fd < 7; ++fd)
+    {
+        add_event(increasing_ts(), p6_t1_tid, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", 0, 0);
+        evt = add_event_advance_ts(increasing_ts(), p6_t1_tid, PPME_SYSCALL_OPEN_X, 6, fd, "/tmp/the_file", 0, 0, 0, (uint64_t)777);
+    }
+    ASSERT_EQ(get_field_as_string(evt, "anomaly.count_min_sketch[0]", pl_flist), "3");
+}
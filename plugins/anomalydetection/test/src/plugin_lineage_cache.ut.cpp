@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <sinsp_with_test_input.h>
+#include <helpers/threads_helpers.h>
+#include <plugin_test_var.h>
+#include <test_helpers.h>
+#include <plugin_lineage_cache.h>
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_lineage_cache_invalidate)
+{
+    lineage_cache cache;
+    auto& e = cache.insert(10, 5);
+    EXPECT_EQ(e.next_ptid, 5);
+    e.ancestors.push_back(lineage_ancestor{5});
+    e.ancestors.push_back(lineage_ancestor{1});
+    cache.add_dependency(10, 5);
+    cache.add_dependency(10, 1);
+    cache.insert(11, 5);
+    cache.add_dependency(11, 5);
+    EXPECT_EQ(cache.size(), 2);
+    ASSERT_TRUE(cache.get(10) != nullptr);
+    EXPECT_EQ(cache.get(10)->ancestors.size(), 2);
+
+    // Unrelated thread
+    cache.invalidate(42);
+    EXPECT_EQ(cache.size(), 2);
+
+    // Ancestor execs, both descendants are dropped
+    cache.invalidate(5);
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_TRUE(cache.get(10) == nullptr);
+
+    // Thread itself exits
+    cache.insert(12, 1);
+    cache.invalidate(12);
+    EXPECT_TRUE(cache.get(12) == nullptr);
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_lineage_cache_bounded)
+{
+    lineage_cache cache(4);
+    for (int64_t tid = 10; tid < 20; ++tid)
+    {
+        cache.insert(tid, 1);
+        cache.add_dependency(tid, 1);
+    }
+    EXPECT_LE(cache.size(), 4);
+}
+
+#undef INIT_CONFIG
+#define INIT_CONFIG "{\"count_min_sketch\":{\"enabled\":true,\"n_sketches\":1,\"gamma_eps\":[[0.001,0.0001]],\"behavior_profiles\":[\
+{\"fields\":\"%proc.aname[1] %proc.aname[2] %custom.proc.aname.lineage.join[3]\",\
+\"event_codes\":[3]}]}}"
+
+TEST_F(sinsp_with_test_input, plugin_anomalydetection_lineage_cache_execve_invalidation)
+{
+    std::shared_ptr<sinsp_plugin> plugin_owner;
+    filter_check_list pl_flist;
+    ASSERT_PLUGIN_INITIALIZATION(plugin_owner, pl_flist)
+    DEFAULT_TREE
+
+    auto open_on = [this](int64_t tid, int64_t fd)
+    {
+        add_event(increasing_ts(), tid, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", 0, 0);
+        return add_event_advance_ts(increasing_ts(), tid, PPME_SYSCALL_OPEN_X, 6, fd, "/tmp/the_file", 0, 0, 0, (uint64_t)777);
+    };
+    auto expected_profile = [this](sinsp_evt* evt)
+    {
+        return get_field_as_string(evt, "proc.aname[1]") + get_field_as_string(evt, "proc.aname[2]") +
+            get_field_as_string(evt, "proc.name") + get_field_as_string(evt, "proc.aname[1]") +
+            get_field_as_string(evt, "proc.aname[2]") + get_field_as_string(evt, "proc.aname[3]");
+    };
+
+    auto evt = open_on(p6_t1_tid, 4);
+    ASSERT_EQ(get_field_as_string(evt, "anomaly.count_min_sketch.profile[0]", pl_flist), expected_profile(evt));
+
+    // Served from the cache
+    evt = open_on(p6_t1_tid, 5);
+    ASSERT_EQ(get_field_as_string(evt, "anomaly.count_min_sketch.profile[0]", pl_flist), expected_profile(evt));
+
+    // The parent execs, the cached lineage of its child must not be served anymore
+    generate_execve_enter_and_exit_event(0, p5_t1_tid, p5_t1_tid, p5_t1_pid, p5_t1_ptid, "/p5_new_exepath", "p5_new_comm", "/usr/bin/p5_new_exepath");
+    evt = open_on(p6_t1_tid, 6);
+    ASSERT_EQ(get_field_as_string(evt, "proc.aname[1]"), "p5_new_comm");
+    ASSERT_EQ(get_field_as_string(evt, "anomaly.count_min_sketch.profile[0]", pl_flist), expected_profile(evt));
+}
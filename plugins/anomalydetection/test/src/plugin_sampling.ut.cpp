@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <sinsp_with_test_input.h>
+#include <helpers/threads_helpers.h>
+#include <plugin_test_var.h>
+#include <test_helpers.h>
+#include <plugin_sampling.h>
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_profile_sampler)
+{
+    profile_sampler every;
+    EXPECT_EQ(every.next(), 1);
+    EXPECT_EQ(every.next(), 1);
+
+    // Every 4th event counts as 4
+    profile_sampler fixed(4);
+    uint64_t total = 0;
+    for (int i = 0; i < 12; ++i)
+    {
+        auto count = fixed.next();
+        EXPECT_EQ(count, i % 4 == 3 ? 4 : 0);
+        total += count;
+    }
+    EXPECT_EQ(total, 12);
+    // The multiplier scales the rate
+    for (int i = 0; i < 7; ++i)
+    {
+        EXPECT_EQ(fixed.next(2), 0);
+    }
+    EXPECT_EQ(fixed.next(2), 8);
+
+    // Random sampling is unbiased on average
+    profile_sampler random(8, profile_sampler::RANDOM, 1);
+    total = 0;
+    const uint64_t n = 1 << 16;
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        auto count = random.next();
+        EXPECT_TRUE(count == 0 || count == 8);
+        total += count;
+    }
+    EXPECT_NEAR((double)total / n, 1.0, 0.05);
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_adaptive_sampling_controller)
+{
+    adaptive_sampling_controller disabled;
+    EXPECT_FALSE(disabled.enabled());
+
+    adaptive_sampling_controller controller(1000, 4);
+    EXPECT_TRUE(controller.enabled());
+    auto window = [&controller](uint64_t ns)
+    {
+        for (int i = 0; i < ADAPTIVE_SAMPLING_WINDOW; ++i)
+        {
+            controller.record(ns);
+        }
+    };
+    // Over budget: doubles up to the maximum
+    window(5000);
+    EXPECT_EQ(controller.get_multiplier(), 2);
+    window(5000);
+    EXPECT_EQ(controller.get_multiplier(), 4);
+    window(5000);
+    EXPECT_EQ(controller.get_multiplier(), 4);
+    // Between half the budget and the budget: unchanged
+    window(800);
+    EXPECT_EQ(controller.get_multiplier(), 4);
+    // Under half the budget: halves back down to 1
+    window(100);
+    EXPECT_EQ(controller.get_multiplier(), 2);
+    window(100);
+    window(100);
+    EXPECT_EQ(controller.get_multiplier(), 1);
+}
+
+#undef INIT_CONFIG
+#define INIT_CONFIG "{\"count_min_sketch\":{\"enabled\":true,\"n_sketches\":1,\"rows_cols\":[[5,1024]],\"behavior_profiles\":[\
+{\"fields\":\"%proc.name %fd.name\",\
+\"event_codes\":[3],\"sample_rate\":2}]}}"
+
+TEST_F(sinsp_with_test_input, plugin_anomalydetection_sampled_profile)
+{
+    std::shared_ptr<sinsp_plugin> plugin_owner;
+    filter_check_list pl_flist;
+    ASSERT_PLUGIN_INITIALIZATION(plugin_owner, pl_flist)
+    DEFAULT_TREE
+
+    // Every 2nd event adds 2, sampled out events are still estimated
+    const char* expected[] = {"0", "2", "2", "4"};
+    for (int64_t fd = 4; fd < 8; ++fd)
+    {
+        add_event(increasing_ts(), p6_t1_tid, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", 0, 0);
+        auto evt = add_event_advance_ts(increasing_ts(), p6_t1_tid, PPME_SYSCALL_OPEN_X, 6, fd, "/tmp/the_file", 0, 0, 0, (uint64_t)777);
+        ASSERT_EQ(get_field_as_string(evt, "anomaly.count_min_sketch[0]", pl_flist), expected[fd - 4]);
+    }
+}
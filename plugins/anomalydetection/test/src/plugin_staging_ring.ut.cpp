@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <sinsp_with_test_input.h>
+#include <helpers/threads_helpers.h>
+#include <plugin_test_var.h>
+#include <test_helpers.h>
+#include <plugin_staging_ring.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+using plugin::anomalydetection::num::cms;
+using plugin::anomalydetection::num::cms_hash_mode;
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_staging_ring)
+{
+    staging_ring ring(3);
+    EXPECT_EQ(ring.capacity(), 4);
+    auto falco = cms<uint64_t>::get_digest("falco");
+    auto sysdig = cms<uint64_t>::get_digest("sysdig");
+    EXPECT_TRUE(ring.push({falco, 0, 1}));
+    EXPECT_TRUE(ring.push({falco, 1, 2}));
+    EXPECT_TRUE(ring.push({falco, 0, 4}));
+    EXPECT_TRUE(ring.push({sysdig, 0, 8}));
+    EXPECT_FALSE(ring.push({sysdig, 0, 16}));
+    EXPECT_EQ(ring.size(), 4);
+    EXPECT_EQ(ring.pending(0, falco), 5);
+    EXPECT_EQ(ring.pending(1, falco), 2);
+    EXPECT_EQ(ring.pending(0, sysdig), 8);
+
+    std::vector<staged_update> out;
+    EXPECT_EQ(ring.pop(out, 2), 2);
+    EXPECT_EQ(out[0].count, 1);
+    EXPECT_EQ(out[1].count, 2);
+    // Pending until applied
+    EXPECT_EQ(ring.pending(0, falco), 5);
+    ring.applied(out.data(), out.size());
+    EXPECT_EQ(ring.pending(0, falco), 4);
+    EXPECT_EQ(ring.pending(1, falco), 0);
+    // Wraps around
+    EXPECT_TRUE(ring.push({sysdig, 0, 16}));
+    EXPECT_EQ(ring.pop(out, 10), 3);
+    EXPECT_EQ(out.back().count, 16);
+    ring.applied(out.data() + 2, 3);
+    EXPECT_EQ(ring.size(), 0);
+    EXPECT_EQ(ring.pending(0, sysdig), 0);
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_staging_ring_threads)
+{
+    // The consumer applies all increments exactly once
+    staging_ring ring(64);
+    const uint32_t n = 100000;
+    auto digest = cms<uint64_t>::get_digest("falco");
+    uint64_t consumed = 0;
+    std::thread consumer([&]()
+        {
+            std::vector<staged_update> out;
+            while (consumed < n)
+            {
+                out.clear();
+                ring.pop(out, 16);
+                for (const auto& u : out)
+                {
+                    consumed += u.count;
+                }
+            }
+        });
+    for (uint32_t i = 0; i < n;)
+    {
+        i += ring.push({digest, 0, 1}) ? 1 : 0;
+    }
+    consumer.join();
+    EXPECT_EQ(consumed, n);
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_cms_add_cells)
+{
+    // Sorted cell increments are equivalent to the updates
+    cms<uint16_t> expected((uint64_t)4, (uint64_t)64, true, cms_hash_mode::DOUBLE_HASHING);
+    cms<uint16_t> batched((uint64_t)4, (uint64_t)64, true, cms_hash_mode::DOUBLE_HASHING);
+    std::vector<std::pair<uint64_t, uint64_t>> cells;
+    std::vector<uint64_t> offsets(batched.get_d());
+    for (int i = 0; i < 200; ++i)
+    {
+        auto digest = cms<uint16_t>::get_digest("profile" + std::to_string(i % 50));
+        uint64_t count = i % 3 == 0 ? 70000 : 2;
+        expected.update(digest, (uint16_t)std::min<uint64_t>(count, UINT16_MAX));
+        batched.get_cell_offsets(digest, offsets.data());
+        for (auto offset : offsets)
+        {
+            cells.emplace_back(offset, count);
+        }
+    }
+    std::sort(cells.begin(), cells.end());
+    batched.add_cells(cells.data(), cells.size());
+    std::vector<uint16_t> a(4 * 64), b(4 * 64);
+    expected.copy_counters(a.data());
+    batched.copy_counters(b.data());
+    EXPECT_EQ(a, b);
+}
+
+#undef INIT_CONFIG
+#define INIT_CONFIG "{\"count_min_sketch\":{\"enabled\":true,\"n_sketches\":1,\"rows_cols\":[[5,1024]],\
+\"async_updates\":{\"drain_interval_ms\":3600000},\"behavior_profiles\":[\
+{\"fields\":\"%proc.name %fd.name\",\
+\"event_codes\":[3],\"hash_mode\":\"double_hashing\"}]}}"
+
+TEST_F(sinsp_with_test_input, plugin_anomalydetection_async_updates_pending)
+{
+    std::shared_ptr<sinsp_plugin> plugin_owner;
+    filter_check_list pl_flist;
+    ASSERT_PLUGIN_INITIALIZATION(plugin_owner, pl_flist)
+    DEFAULT_TREE
+
+    // Nothing is drained yet, the estimates count the staged increments, including the one of the current event
+    for (int64_t fd = 4; fd < 7; ++fd)
+    {
+        add_event(increasing_ts(), p6_t1_tid, PPME_SYSCALL_OPEN_E, 3, "/tmp/the_file", 0, 0);
+        auto evt = add_event_advance_ts(increasing_ts(), p6_t1_tid, PPME_SYSCALL_OPEN_X, 6, fd, "/tmp/the_file", 0, 0, 0, (uint64_t)777);
+        ASSERT_EQ(get_field_as_string(evt, "anomaly.count_min_sketch[0]", pl_flist), std::to_string(fd - 3));
+    }
+}
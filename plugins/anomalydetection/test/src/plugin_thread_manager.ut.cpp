@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <plugin_thread_manager.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_thread_manager_jobs)
+{
+    ThreadManager manager;
+    std::atomic<int> fast{0};
+    std::atomic<int> slow{0};
+    manager.start_periodic_worker(10, [&fast]() { fast++; });
+    manager.start_periodic_worker(60000, [&slow]() { slow++; });
+    EXPECT_EQ(manager.get_n_jobs(), 2);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (fast < 5 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_GE(fast, 5);
+    EXPECT_EQ(slow, 0);
+
+    // Stopping does not wait for the next deadline of the long interval job
+    auto start = std::chrono::steady_clock::now();
+    manager.stop_threads();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    EXPECT_EQ(manager.get_n_jobs(), 0);
+
+    // Restart after a stop, as done on config reloads
+    int n = fast;
+    manager.start_periodic_worker(10, [&fast]() { fast++; });
+    deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (fast < n + 2 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_GE(fast, n + 2);
+    manager.stop_threads();
+}
+
+TEST(plugin_anomalydetection, plugin_anomalydetection_thread_manager_reset_worker)
+{
+    ThreadManager manager;
+    auto sketch = std::make_shared<plugin::anomalydetection::num::cms<uint64_t>>((uint64_t)3, (uint64_t)100);
+    sketch->update("falco", 10);
+    manager.start_periodic_count_min_sketch_reset_worker<uint64_t>(150, sketch);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (sketch->estimate("falco") != 0 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(sketch->estimate("falco"), 0);
+    manager.stop_threads();
+}
@@ -0,0 +1,167 @@
+#include "corpus.h"
+
+#include <benchmark/benchmark.h>
+#include <container_info.h>
+#include <container_info_binary.h>
+#include <container_info_json.h>
+#include <mount_pattern.h>
+
+#include <string>
+
+// Number of env entries, labels, mounts and port mappings of the container
+static void container_size_args(benchmark::internal::Benchmark* b)
+{
+    for(int64_t n : {0, 8, 64, 512})
+    {
+        b->Arg(n);
+    }
+}
+
+static std::shared_ptr<const container_info> bench_container(int64_t n)
+{
+    std::mt19937_64 rng(CORPUS_SEED);
+    return make_container(rng, (size_t)n);
+}
+
+// The JSON sent along PPME_CONTAINER_JSON_2_E events
+static std::string to_json_string(
+        const std::shared_ptr<const container_info>& info)
+{
+    nlohmann::json j;
+    j["container"] = info;
+    return j.dump();
+}
+
+static void BM_container_info_to_json(benchmark::State& state)
+{
+    auto info = bench_container(state.range(0));
+    size_t bytes = 0;
+    for(auto _ : state)
+    {
+        auto s = to_json_string(info);
+        bytes += s.size();
+        benchmark::DoNotOptimize(s);
+    }
+    state.SetBytesProcessed((int64_t)bytes);
+}
+BENCHMARK(BM_container_info_to_json)->Apply(container_size_args);
+
+static void BM_container_info_from_json(benchmark::State& state)
+{
+    auto s = to_json_string(bench_container(state.range(0)));
+    for(auto _ : state)
+    {
+        auto info = nlohmann::json::parse(s).get<container_info::ptr_t>();
+        benchmark::DoNotOptimize(info);
+    }
+    state.SetBytesProcessed((int64_t)(s.size() * state.iterations()));
+}
+BENCHMARK(BM_container_info_from_json)->Apply(container_size_args);
+
+static void BM_container_info_to_binary(benchmark::State& state)
+{
+    auto info = bench_container(state.range(0));
+    std::string payload;
+    for(auto _ : state)
+    {
+        payload.clear();
+        container_info_to_binary(*info, payload);
+        benchmark::DoNotOptimize(payload);
+    }
+    state.SetBytesProcessed((int64_t)(payload.size() * state.iterations()));
+}
+BENCHMARK(BM_container_info_to_binary)->Apply(container_size_args);
+
+static void BM_container_info_from_binary(benchmark::State& state)
+{
+    std::string payload;
+    container_info_to_binary(*bench_container(state.range(0)), payload);
+    for(auto _ : state)
+    {
+        container_info_view view(payload.data(), payload.size());
+        auto info = view.to_container_info();
+        benchmark::DoNotOptimize(info);
+    }
+    state.SetBytesProcessed((int64_t)(payload.size() * state.iterations()));
+}
+BENCHMARK(BM_container_info_from_binary)->Apply(container_size_args);
+
+/*
+ * Per field extraction. `extract` only reads the container info of the
+ * event thread: these measure the lookups behind each kind of field, once
+ * the composite values are built, as they are after the first event.
+ */
+
+static void BM_extract_container_labels(benchmark::State& state)
+{
+    auto info = bench_container(state.range(0));
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(info->get_labels_string());
+    }
+}
+BENCHMARK(BM_extract_container_labels)->Apply(container_size_args);
+
+static void BM_extract_container_mounts(benchmark::State& state)
+{
+    auto info = bench_container(state.range(0));
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(info->get_mounts_string());
+    }
+}
+BENCHMARK(BM_extract_container_mounts)->Apply(container_size_args);
+
+// container.label[io.kubernetes.pod.namespace]
+static void BM_extract_container_label(benchmark::State& state)
+{
+    auto info = bench_container(state.range(0));
+    for(auto _ : state)
+    {
+        auto it = info->m_labels.find("io.kubernetes.pod.namespace");
+        benchmark::DoNotOptimize(it);
+    }
+}
+BENCHMARK(BM_extract_container_label)->Apply(container_size_args);
+
+// container.mount.dest[<pattern>] with each kind of mount_pattern
+static void BM_extract_container_mount(benchmark::State& state)
+{
+    static const char* const patterns[] = {
+            "^/var/run/docker.sock$", // MP_EQUAL
+            "^/var/run",              // MP_PREFIX
+            "docker.sock",            // MP_SUBSTRING
+            "docker\\.sock$",         // MP_REGEX
+    };
+    auto info = bench_container(state.range(0));
+    mount_pattern pattern(patterns[state.range(1)]);
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(info->mount_by_source(pattern));
+    }
+    state.SetLabel(patterns[state.range(1)]);
+}
+BENCHMARK(BM_extract_container_mount)
+        ->Args({8, 0})
+        ->Args({8, 1})
+        ->Args({8, 2})
+        ->Args({8, 3})
+        ->Args({512, 0})
+        ->Args({512, 1})
+        ->Args({512, 2})
+        ->Args({512, 3});
+
+// proc.is_container_liveness_probe of a process that is not a probe, as
+// almost all of them are
+static void BM_extract_health_probe(benchmark::State& state)
+{
+    auto info = bench_container(0);
+    health_probe_hasher h("/usr/bin/python3");
+    h.add_arg("-m");
+    h.add_arg("http.server");
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(info->may_match_health_probe(h.value()));
+    }
+}
+BENCHMARK(BM_extract_health_probe);
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <container_info.h>
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Deterministic inputs of the benchmarks: every generator is seeded with a
+ * fixed value, so that two runs, or two releases, measure the same corpus.
+ */
+
+#define CORPUS_SEED 42
+
+// Kinds of cgroup paths, as found on real hosts
+enum cgroup_kind
+{
+    CG_DOCKER_CGROUPFS = 0,
+    CG_DOCKER_SYSTEMD,
+    CG_PODMAN_ROOT,
+    CG_PODMAN_ROOTLESS,
+    CG_CRIO_CGROUPFS,
+    CG_CRIO_SYSTEMD,
+    CG_CONTAINERD_CGROUPFS,
+    CG_CONTAINERD_SYSTEMD,
+    CG_LXC,
+    CG_LIBVIRT_LXC,
+    CG_BPM,
+    CG_HOST,
+    // All of the above, in equal shares
+    CG_MIXED,
+    CG_MAX
+};
+
+inline const char* cgroup_kind_name(int kind)
+{
+    static const char* const names[CG_MAX] = {"docker_cgroupfs",
+                                              "docker_systemd",
+                                              "podman_root",
+                                              "podman_rootless",
+                                              "crio_cgroupfs",
+                                              "crio_systemd",
+                                              "containerd_cgroupfs",
+                                              "containerd_systemd",
+                                              "lxc",
+                                              "libvirt_lxc",
+                                              "bpm",
+                                              "host",
+                                              "mixed"};
+    return kind >= 0 && kind < CG_MAX ? names[kind] : "unknown";
+}
+
+inline std::string random_hex(std::mt19937_64& rng, size_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string s(len, '0');
+    for(auto& c : s)
+    {
+        c = digits[rng() & 0xf];
+    }
+    return s;
+}
+
+// A pod uid, eg: 63b3ebfc-2890-11e9-8154-16bf8ef8d9dc, with `sep` separators
+inline std::string random_pod_uid(std::mt19937_64& rng, char sep)
+{
+    return random_hex(rng, 8) + sep + random_hex(rng, 4) + sep +
+           random_hex(rng, 4) + sep + random_hex(rng, 4) + sep +
+           random_hex(rng, 12);
+}
+
+// Cgroup path of the `kind` container, or host process, numbered `n`
+inline std::string make_cgroup(std::mt19937_64& rng, int kind, size_t n)
+{
+    static const char* const qos[] = {"besteffort", "burstable"};
+    static const char* const host[] = {
+            "/",
+            "/init.scope",
+            "/system.slice/sshd.service",
+            "/system.slice/systemd-journald.service",
+            "/user.slice/user-1000.slice/session-3.scope",
+            "/user.slice/user-1000.slice/user@1000.service/init.scope",
+            "/user.slice/user-1000.slice/user@1000.service/app.slice/"
+            "app-gnome-firefox-4242.scope"};
+
+    if(kind == CG_MIXED)
+    {
+        kind = (int)(n % CG_MIXED);
+    }
+    auto id = random_hex(rng, 64);
+    std::string q = qos[n % 2];
+    switch(kind)
+    {
+    case CG_DOCKER_CGROUPFS:
+        return "/docker/" + id;
+    case CG_DOCKER_SYSTEMD:
+        return "/system.slice/docker-" + id + ".scope";
+    case CG_PODMAN_ROOT:
+        return "/machine.slice/libpod-" + id + ".scope/container";
+    case CG_PODMAN_ROOTLESS:
+        return "/user.slice/user-1000.slice/user@1000.service/user.slice/"
+               "libpod-" +
+               id + ".scope/container";
+    case CG_CRIO_CGROUPFS:
+        return "/kubepods/" + q + "/pod" + random_pod_uid(rng, '-') +
+               "/crio-" + id;
+    case CG_CRIO_SYSTEMD:
+        return "/kubepods.slice/kubepods-" + q + ".slice/kubepods-" + q +
+               "-pod" + random_pod_uid(rng, '_') + ".slice/crio-" + id +
+               ".scope";
+    case CG_CONTAINERD_CGROUPFS:
+        return "/kubepods/" + q + "/pod" + random_pod_uid(rng, '-') + "/" + id;
+    case CG_CONTAINERD_SYSTEMD:
+        return "/kubepods.slice/kubepods-" + q + ".slice/kubepods-" + q +
+               "-pod" + random_pod_uid(rng, '_') + ".slice/cri-containerd-" +
+               id + ".scope";
+    case CG_LXC:
+        return (n % 2 ? "/lxc.payload." : "/lxc/") + std::string("ct-") +
+               std::to_string(n);
+    case CG_LIBVIRT_LXC:
+        return "/machine.slice/machine-lxc\\x2d" + std::to_string(1000 + n) +
+               "\\x2dvm" + std::to_string(n) + ".scope";
+    case CG_BPM:
+        return "/system.slice/bpm-job" + std::to_string(n) + ".scope";
+    default:
+        return host[n % (sizeof(host) / sizeof(host[0]))];
+    }
+}
+
+inline std::vector<std::string> make_cgroups(int kind, size_t n)
+{
+    std::mt19937_64 rng(CORPUS_SEED);
+    std::vector<std::string> res;
+    res.reserve(n);
+    for(size_t i = 0; i < n; i++)
+    {
+        res.push_back(make_cgroup(rng, kind, i));
+    }
+    return res;
+}
+
+// A kubernetes like container with `n` env entries, labels and mounts
+inline container_info::ptr_t make_container(std::mt19937_64& rng, size_t n)
+{
+    auto info = std::make_shared<container_info>();
+    info->m_full_id = random_hex(rng, 64);
+    info->m_id = info->m_full_id.substr(0, 12);
+    info->m_type = CT_CONTAINERD;
+    info->m_name = "app-" + info->m_id;
+    info->m_image = "registry.example.com/team/app:1.2.3";
+    info->m_imageid = random_hex(rng, 64);
+    info->m_imagerepo = "registry.example.com/team/app";
+    info->m_imagetag = "1.2.3";
+    info->m_imagedigest = "sha256:" + random_hex(rng, 64);
+    info->m_container_ip = "10.0.0." + std::to_string(rng() % 255);
+    info->m_container_user = "1000";
+    info->m_pod_sandbox_id = random_hex(rng, 12);
+    info->m_created_time = 1749101763;
+    info->m_memory_limit = 2147483648;
+    info->m_cpu_quota = 100000;
+    for(size_t i = 0; i < n; i++)
+    {
+        auto s = std::to_string(i);
+        info->m_env.emplace_back("ENV_" + s + "=" + random_hex(rng, 16));
+        info->m_labels.emplace("app.kubernetes.io/label-" + s,
+                               "value-" + random_hex(rng, 8));
+        info->m_mounts.emplace_back("/var/lib/kubelet/pods/" +
+                                            random_pod_uid(rng, '-') +
+                                            "/volumes/vol-" + s,
+                                    "/mnt/vol-" + s, "", i % 2 == 0, "rprivate");
+        container_port_mapping port;
+        port.m_host_port = (uint16_t)(30000 + i);
+        port.m_container_port = (uint16_t)(8000 + i);
+        info->m_port_mappings.push_back(port);
+    }
+    info->m_labels.emplace("io.kubernetes.pod.namespace", "default");
+    info->m_mounts.emplace_back("/var/run/docker.sock", "/var/run/docker.sock",
+                                "", true, "rprivate");
+    info->m_health_probes.emplace_back(
+            container_health_probe::PT_LIVENESS_PROBE, "/bin/sh",
+            std::vector<std::string>{"-c", "curl -f http://localhost/health"});
+    return info;
+}
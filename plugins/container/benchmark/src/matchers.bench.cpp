@@ -0,0 +1,74 @@
+#include "corpus.h"
+
+#include <benchmark/benchmark.h>
+#include <matcher.h>
+
+#include <algorithm>
+
+#define BENCH_N_CGROUPS 4096
+
+// Args: cgroup kind, cgroup cache size (0 disables the cache)
+static void match_cgroup_args(benchmark::internal::Benchmark* b)
+{
+    for(int64_t kind = 0; kind < CG_MAX; kind++)
+    {
+        for(int64_t cache_size : {0, 1024})
+        {
+            b->Args({kind, cache_size});
+        }
+    }
+}
+
+// One cgroup of the corpus matched per iteration, the corpus holds more
+// cgroups than the cache, as a busy host does
+static void BM_match_cgroup(benchmark::State& state)
+{
+    auto kind = (int)state.range(0);
+    auto cgroups = make_cgroups(kind, BENCH_N_CGROUPS);
+    matcher_manager mgr(Engines{}, (size_t)state.range(1));
+
+    size_t i = 0;
+    uint64_t matched = 0;
+    std::string container_id;
+    container_info::ptr_t info;
+    for(auto _ : state)
+    {
+        container_id.clear();
+        matched += mgr.match_cgroup(cgroups[i], container_id, info);
+        benchmark::DoNotOptimize(container_id);
+        i = (i + 1) % cgroups.size();
+    }
+    state.SetLabel(cgroup_kind_name(kind));
+    state.SetItemsProcessed(state.iterations());
+    state.counters["matched"] =
+            (double)matched / (double)std::max<int64_t>(state.iterations(), 1);
+    state.counters["cache_hits"] = (double)mgr.get_cache_hits();
+}
+BENCHMARK(BM_match_cgroup)->Apply(match_cgroup_args);
+
+// Processes of a same container share their cgroups: a short working set
+// that always hits the cache
+static void BM_match_cgroup_hot(benchmark::State& state)
+{
+    auto kind = (int)state.range(0);
+    auto cgroups = make_cgroups(kind, 64);
+    matcher_manager mgr(Engines{}, 1024);
+
+    size_t i = 0;
+    std::string container_id;
+    container_info::ptr_t info;
+    for(auto _ : state)
+    {
+        container_id.clear();
+        mgr.match_cgroup(cgroups[i], container_id, info);
+        benchmark::DoNotOptimize(container_id);
+        i = (i + 1) % cgroups.size();
+    }
+    state.SetLabel(cgroup_kind_name(kind));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_match_cgroup_hot)
+        ->Arg(CG_DOCKER_SYSTEMD)
+        ->Arg(CG_CRIO_SYSTEMD)
+        ->Arg(CG_HOST)
+        ->Arg(CG_MIXED);
@@ -0,0 +1,201 @@
+#include "corpus.h"
+
+#include <benchmark/benchmark.h>
+#include <container_info_binary.h>
+#include <container_requests.h>
+#include <container_table.h>
+#include <matcher.h>
+
+#include <deque>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/*
+ * Synthetic fork/exec storm: the per process work of `parse_event`, driven
+ * against a mock thread table. Each iteration is one clone, execve or exit
+ * event; new processes get their container id from their cgroups, the
+ * containers table is looked up and the health probes are checked, unknown
+ * containers are asked to a fake go-worker answering a few events later with
+ * binary payloads.
+ */
+
+#define STORM_MAX_THREADS 4096
+// Events between a container request and its answer
+#define STORM_WORKER_LATENCY 64
+#define STORM_EVENT_NS 1000
+
+// Cgroup v1 controllers, each one listed in the thread cgroups table
+static const char* const s_controllers[] = {
+        "cpuset", "cpu", "cpuacct", "blkio",      "memory",  "devices",
+        "freezer", "net_cls", "perf_event", "net_prio", "hugetlb", "pids"};
+
+struct mock_thread
+{
+    // Shared by the processes of a same cgroup
+    const std::vector<std::string>* cgroups;
+    std::string container_id;
+};
+
+class storm
+{
+    public:
+    storm(int cgroup_version, size_t n_containers, size_t cache_size):
+            m_rng(CORPUS_SEED), m_mgr(Engines{}, cache_size)
+    {
+        // A tenth of the processes run on the host
+        auto paths = make_cgroups(CG_MIXED, n_containers);
+        auto host = make_cgroups(CG_HOST, n_containers / 10 + 1);
+        paths.insert(paths.end(), host.begin(), host.end());
+        for(const auto& path : paths)
+        {
+            std::vector<std::string> cgroups;
+            if(cgroup_version == 1)
+            {
+                cgroups.assign(std::size(s_controllers), path);
+                // Not all controllers are delegated to containers
+                cgroups[0] = "/";
+            }
+            else
+            {
+                cgroups.push_back(path);
+            }
+            m_cgroups.push_back(std::move(cgroups));
+        }
+        m_containers.set("", container_info::host_container_info());
+        for(const auto& cgroups : m_cgroups)
+        {
+            m_threads.push_back({&cgroups, ""});
+            on_new_process(m_threads.back());
+        }
+    }
+
+    void next_event()
+    {
+        m_now += STORM_EVENT_NS;
+        answer_requests();
+
+        auto idx = m_rng() % m_threads.size();
+        auto op = m_rng() % 10;
+        if(op < 2 && m_threads.size() > m_cgroups.size())
+        {
+            // exit
+            if(idx != m_threads.size() - 1)
+            {
+                m_threads[idx] = std::move(m_threads.back());
+            }
+            m_threads.pop_back();
+        }
+        else if(op < 6 && m_threads.size() < STORM_MAX_THREADS)
+        {
+            // clone, the child inherits the cgroups of its parent
+            m_threads.push_back({m_threads[idx].cgroups, ""});
+            on_new_process(m_threads.back());
+        }
+        else
+        {
+            // execve
+            on_new_process(m_threads[idx]);
+        }
+    }
+
+    uint64_t get_found() const { return m_found; }
+    uint64_t get_asked() const { return m_asked; }
+
+    private:
+    // See my_plugin::on_new_process
+    void on_new_process(mock_thread& t)
+    {
+        container_info::ptr_t info;
+        t.container_id.clear();
+        for(const auto& cgroup : *t.cgroups)
+        {
+            if(!cgroup.empty())
+            {
+                m_mgr.match_cgroup(cgroup, t.container_id, info);
+                if(!t.container_id.empty())
+                {
+                    break;
+                }
+            }
+        }
+        if(t.container_id.empty())
+        {
+            return;
+        }
+
+        auto found = m_containers.find(t.container_id);
+        if(found != nullptr)
+        {
+            m_found++;
+            m_containers.touch(t.container_id);
+            benchmark::DoNotOptimize((*found)->may_match_health_probe(
+                    health_probe_hasher("/bin/sh").value()));
+        }
+        else if(m_requests.should_ask(t.container_id, m_now))
+        {
+            m_asked++;
+            m_requests.on_asked(t.container_id, m_now);
+            m_worker_queue.emplace_back(m_now + STORM_WORKER_LATENCY *
+                                                         STORM_EVENT_NS,
+                                        t.container_id);
+        }
+    }
+
+    // See my_plugin::parse_async_event
+    void answer_requests()
+    {
+        while(!m_worker_queue.empty() && m_worker_queue.front().first <= m_now)
+        {
+            auto info = make_container(m_rng, 8);
+            info->m_id = m_worker_queue.front().second;
+            m_worker_queue.pop_front();
+
+            m_payload.clear();
+            container_info_to_binary(*info, m_payload);
+            container_info_view view(m_payload.data(), m_payload.size());
+            auto decoded = view.to_container_info();
+            m_requests.on_resolved(decoded->m_id, m_now);
+            auto id = decoded->m_id;
+            m_containers.set(id, std::move(decoded));
+        }
+    }
+
+    std::mt19937_64 m_rng;
+    matcher_manager m_mgr;
+    container_table m_containers;
+    container_requests m_requests;
+    std::vector<std::vector<std::string>> m_cgroups;
+    std::vector<mock_thread> m_threads;
+    std::deque<std::pair<uint64_t, std::string>> m_worker_queue;
+    std::string m_payload;
+    uint64_t m_now = 0;
+    uint64_t m_found = 0;
+    uint64_t m_asked = 0;
+};
+
+// Args: cgroup version, number of containers, cgroup cache size
+static void BM_fork_exec_storm(benchmark::State& state)
+{
+    storm s((int)state.range(0), (size_t)state.range(1),
+            (size_t)state.range(2));
+    for(auto _ : state)
+    {
+        s.next_event();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["found"] = (double)s.get_found();
+    state.counters["asked"] = (double)s.get_asked();
+}
+// The containers table and the requests evolve along the events, a fixed
+// number of them keeps the runs comparable
+BENCHMARK(BM_fork_exec_storm)
+        ->Iterations(1 << 18)
+        ->Args({1, 16, 0})
+        ->Args({1, 16, 1024})
+        ->Args({1, 512, 0})
+        ->Args({1, 512, 1024})
+        ->Args({2, 16, 0})
+        ->Args({2, 16, 1024})
+        ->Args({2, 512, 0})
+        ->Args({2, 512, 1024});
@@ -0,0 +1,6 @@
+# Header-only primitives shared by the C++ plugins of this repository: event
+# params decoding, caches, string interning and metrics helpers
+get_filename_component(PLUGIN_TOOLKIT_INCLUDE
+                       "${CMAKE_CURRENT_LIST_DIR}/../../../../shared/cpp/include"
+                       ABSOLUTE)
+message(STATUS "Using plugin toolkit include at '${PLUGIN_TOOLKIT_INCLUDE}'")
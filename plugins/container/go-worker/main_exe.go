@@ -5,11 +5,28 @@ package main
 /*
 #include <stdio.h>
 #include <stdbool.h>
-void echo_cb(const char *json, bool added, bool initial_state) {
-	if (initial_state) {
-		printf("[Pre-existing] Json: %s\n", json);
-	} else {
-		printf("[%s] Json: %s\n", added ? "Added" : "Removed", json);
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+// Print the container id of the binary payload, see event.Info.Binary()
+static void echo(const char *prefix, const char *data, uint32_t len) {
+	uint32_t id_off, id_len;
+	memcpy(&id_off, data + 80, sizeof(id_off));
+	memcpy(&id_len, data + 84, sizeof(id_len));
+	printf("[%s] Id: %.*s (%u bytes)\n", prefix, id_len, data + id_off, len);
+}
+
+void echo_cb(const char *data, uint32_t len, bool added) {
+	echo(added ? "Added" : "Removed", data, len);
+}
+
+// Print the containers of the initial state, payloads start with their size
+void echo_initial_state(const char *data, uint32_t len) {
+	uint32_t off = 0, size;
+	while (off < len) {
+		memcpy(&size, data + off + 8, sizeof(size));
+		echo("Pre-existing", data + off, size);
+		off += size;
 	}
 }
 */
@@ -20,6 +37,7 @@ import (
 	"os"
 	"os/signal"
 	"syscall"
+	"unsafe"
 )
 
 func main() {
@@ -62,11 +80,17 @@ func main() {
 	fmt.Println("Starting worker")
 	cstr := C.CString(initCfg)
 	enabledSocks := C.CString("")
-	ptr := StartWorker((*[0]byte)(C.echo_cb), cstr, &enabledSocks)
+	var initialState *C.char
+	var initialStateLen C.uint32_t
+	ptr := StartWorker((*[0]byte)(C.echo_cb), cstr, &enabledSocks, &initialState, &initialStateLen)
 	if ptr == nil {
 		fmt.Println("Failed to start worker; nothing configured?")
 		os.Exit(1)
 	}
+	if initialState != nil {
+		C.echo_initial_state(initialState, initialStateLen)
+		C.free(unsafe.Pointer(initialState))
+	}
 	socks := C.GoString(enabledSocks)
 	fmt.Println("Started worker with attached socks:", socks)
 
@@ -21,6 +21,10 @@ type EngineCfg struct {
 	WithSize       bool                     `json:"with_size"`
 	HostRoot       string                   `json:"host_root"`
 	Hooks          byte                     `json:"hooks"`
+	// Max concurrent container info requests to a single engine, 0 for the default
+	FetchMaxConcurrent int `json:"fetch_max_concurrent"`
+	// Container info sections not sent to the C++ side, see event.Section*
+	PrunedSections uint32 `json:"pruned_sections"`
 }
 
 var c EngineCfg
@@ -56,6 +60,14 @@ func GetHostRoot() string {
 	return c.HostRoot
 }
 
+func GetFetchMaxConcurrent() int {
+	return c.FetchMaxConcurrent
+}
+
+func GetPrunedSections() uint32 {
+	return c.PrunedSections
+}
+
 func IsHookEnabled(hook byte) bool {
 	return c.Hooks&hook != 0
 }
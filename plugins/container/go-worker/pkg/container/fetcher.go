@@ -4,37 +4,133 @@ import (
 	"context"
 	"github.com/falcosecurity/plugins/plugins/container/go-worker/pkg/event"
 	"sync"
+	"sync/atomic"
 	"time"
 )
 
 /*
-Fetcher is a fake engine that listens on a channel for published containerIDs.
-Everytime a containerID is published on the channel, the fetcher engine loops
-over all enabled engines and tries to get info about the container,
-until it succeeds and publish an event to the output channel.
-FetcherChan requests are published through a CGO exposed API: AskForContainerInfo(), in worker_api.
+Fetcher is a fake engine that listens on a FetchQueue for requested containerIDs.
+Everytime a containerID is requested, the fetcher engine asks all enabled engines
+in parallel for info about the container, until one succeeds or the request
+deadline expires, and publishes an event to the output channel.
+Requests are published through a CGO exposed API: AskForContainerInfo(), in worker_api.
 */
 
+const (
+	// DefaultFetchTimeout bounds the requests without a deadline
+	DefaultFetchTimeout = time.Second
+	// DefaultFetchMaxConcurrent is the default number of concurrent requests to a single engine
+	DefaultFetchMaxConcurrent = 4
+)
+
+// FetchRequest asks for the info of a single container.
+type FetchRequest struct {
+	ContainerID string
+	// Past the deadline, the request is dropped if not fulfilled
+	Deadline time.Time
+	// Priority requests are fetched before the pending regular ones
+	Priority bool
+}
+
+// FetchStats counts the outcome of the requests, read by the C++ side
+// through GetFetchStats(), in worker_api.
+type FetchStats struct {
+	Requests         atomic.Uint64
+	PriorityRequests atomic.Uint64
+	// Requests answered with the container info
+	Completed atomic.Uint64
+	// Requests whose deadline expired
+	Timeouts atomic.Uint64
+	// Engine calls cut by the request deadline, eg: on an unresponsive socket
+	EngineTimeouts atomic.Uint64
+	InFlight       atomic.Int64
+}
+
+// FetchQueue holds the requests not yet picked by the fetcher, the priority
+// ones apart so that they skip the queue.
+type FetchQueue struct {
+	regular  chan FetchRequest
+	priority chan FetchRequest
+	Stats    FetchStats
+}
+
+// NewFetchQueue returns a queue holding up to size requests of each priority.
+func NewFetchQueue(size int) *FetchQueue {
+	return &FetchQueue{
+		regular:  make(chan FetchRequest, size),
+		priority: make(chan FetchRequest, size),
+	}
+}
+
+// Push queues req without blocking, returns false if the queue is full.
+func (q *FetchQueue) Push(req FetchRequest) bool {
+	ch := q.regular
+	if req.Priority {
+		ch = q.priority
+	}
+	select {
+	case ch <- req:
+		q.Stats.Requests.Add(1)
+		if req.Priority {
+			q.Stats.PriorityRequests.Add(1)
+		}
+		return true
+	default:
+		return false
+	}
+}
+
+// pop returns the next request, priority ones first, or false once ctx is
+// done or the queue is closed.
+func (q *FetchQueue) pop(ctx context.Context) (FetchRequest, bool) {
+	select {
+	case req, ok := <-q.priority:
+		return req, ok
+	default:
+	}
+	select {
+	case <-ctx.Done():
+		return FetchRequest{}, false
+	case req, ok := <-q.priority:
+		return req, ok
+	case req, ok := <-q.regular:
+		return req, ok
+	}
+}
+
+// Close releases the queue, no request can be pushed anymore.
+func (q *FetchQueue) Close() {
+	close(q.regular)
+	close(q.priority)
+}
+
 type fetcher struct {
-	getters     []getter
-	ctx         context.Context
-	fetcherChan chan string
+	getters []getter
+	// One semaphore per getter, bounding its concurrent requests
+	slots []chan struct{}
+	ctx   context.Context
+	queue *FetchQueue
 }
 
 // NewFetcherEngine returns a fetcher engine.
 // The fetcher engine is responsible to allow us to get() single container
-// trying all container engines enabled.
-func NewFetcherEngine(_ context.Context, fetcherChan chan string, containerEngines []Engine) Engine {
+// trying all container engines enabled, each with at most maxConcurrent
+// requests at once so that a slow engine does not hold the others back.
+func NewFetcherEngine(_ context.Context, queue *FetchQueue, containerEngines []Engine, maxConcurrent int) Engine {
+	if maxConcurrent <= 0 {
+		maxConcurrent = DefaultFetchMaxConcurrent
+	}
 	f := fetcher{
-		getters: make([]getter, len(containerEngines)),
+		getters: make([]getter, 0, len(containerEngines)),
+		slots:   make([]chan struct{}, 0, len(containerEngines)),
 		// Since podman relies upon context to store
 		// connection-related info,
 		// we need a unique context for fetcher
 		// to avoid tampering with real podman engine context.
-		ctx:         context.Background(),
-		fetcherChan: fetcherChan,
+		ctx:   context.Background(),
+		queue: queue,
 	}
-	for i, engine := range containerEngines {
+	for _, engine := range containerEngines {
 		copyEngine, ok := engine.(copier)
 		if !ok {
 			// We need all engines to implement the copier interface to be copied by fetcher.
@@ -43,12 +139,20 @@ func NewFetcherEngine(_ context.Context, fetcherChan chan string, containerEngin
 		e, _ := copyEngine.copy(f.ctx)
 		if e != nil {
 			// No type check since Engine interface extends getter.
-			f.getters[i] = e.(getter)
+			f.getters = append(f.getters, e.(getter))
+			f.slots = append(f.slots, make(chan struct{}, maxConcurrent))
 		}
 	}
 	return &f
 }
 
+// IsFetcher returns whether the engine is the fetcher engine, whose events
+// answer explicit requests of the C++ side.
+func IsFetcher(engine Engine) bool {
+	_, ok := engine.(*fetcher)
+	return ok
+}
+
 func (f *fetcher) Name() string {
 	return ""
 }
@@ -61,54 +165,100 @@ func (f *fetcher) List(_ context.Context) ([]event.Event, error) {
 	panic("do not call")
 }
 
-// Everytime a containerID is published on the fetcher channel, the fetcher engine loops
-// over all enabled engines and tries to get info about the container.
+// Everytime a containerID is requested, the fetcher engine fetches it on its own goroutine.
 // In case the container info is missing, due to a timing issue of the underlying engines
-// a retry is set up every containerFetchRetryInterval until containerFetchRetryTimeout is reached.
+// a retry is set up, backing off from containerFetchRetryInterval, until the request deadline.
 // On success, publish event on output channel.
 func (f *fetcher) Listen(ctx context.Context, wg *sync.WaitGroup) (<-chan event.Event, error) {
-	const containerFetchRetryInterval = 30 * time.Millisecond
-	const containerFetchRetryTimeout = 150 * time.Millisecond
 	outCh := make(chan event.Event)
 	wg.Add(1)
 	go func() {
+		// Fetches still running must be done before closing outCh
+		var fetches sync.WaitGroup
 		defer func() {
+			fetches.Wait()
 			close(outCh)
 			wg.Done()
 		}()
-		containerFirstSeen := make(map[string]time.Time)
 		for {
-			select {
-			case <-ctx.Done():
+			req, ok := f.queue.pop(ctx)
+			if !ok {
 				return
-			case containerId := <-f.fetcherChan:
-				found := false
-				now := time.Now()
-				if containerRequestTime, exists := containerFirstSeen[containerId]; exists {
-					if now.Sub(containerRequestTime) > containerFetchRetryTimeout {
-						delete(containerFirstSeen, containerId)
-						break
-					}
-				} else {
-					containerFirstSeen[containerId] = now
-				}
-				for _, e := range f.getters {
-					evt, _ := e.get(f.ctx, containerId)
-					if evt != nil {
-						outCh <- *evt
-						found = true
-						delete(containerFirstSeen, containerId)
-						break
-					}
-				}
-				if !found {
-					go func() {
-						time.Sleep(containerFetchRetryInterval)
-						f.fetcherChan <- containerId
-					}()
-				}
 			}
+			if req.Deadline.IsZero() {
+				req.Deadline = time.Now().Add(DefaultFetchTimeout)
+			}
+			f.queue.Stats.InFlight.Add(1)
+			fetches.Add(1)
+			go func() {
+				defer func() {
+					f.queue.Stats.InFlight.Add(-1)
+					fetches.Done()
+				}()
+				f.fetch(ctx, req, outCh)
+			}()
 		}
 	}()
 	return outCh, nil
 }
+
+func (f *fetcher) fetch(ctx context.Context, req FetchRequest, outCh chan<- event.Event) {
+	const containerFetchRetryInterval = 30 * time.Millisecond
+	reqCtx, cancel := context.WithDeadline(f.ctx, req.Deadline)
+	defer cancel()
+	retry := containerFetchRetryInterval
+	for {
+		if evt := f.getAny(reqCtx, req.ContainerID); evt != nil {
+			select {
+			case outCh <- *evt:
+				f.queue.Stats.Completed.Add(1)
+			case <-ctx.Done():
+			}
+			return
+		}
+		timer := time.NewTimer(retry)
+		select {
+		case <-timer.C:
+			retry *= 2
+		case <-reqCtx.Done():
+			timer.Stop()
+			f.queue.Stats.Timeouts.Add(1)
+			return
+		case <-ctx.Done():
+			timer.Stop()
+			return
+		}
+	}
+}
+
+// getAny asks all the getters for the container at once and returns the
+// first info found, or nil once they all failed.
+func (f *fetcher) getAny(ctx context.Context, containerId string) *event.Event {
+	ctx, cancel := context.WithCancel(ctx)
+	defer cancel()
+	// Buffered, the getters still running when returning do not block
+	results := make(chan *event.Event, len(f.getters))
+	for i := range f.getters {
+		go func(i int) {
+			select {
+			case f.slots[i] <- struct{}{}:
+			case <-ctx.Done():
+				// The engine stayed busy with other requests
+				results <- nil
+				return
+			}
+			evt, err := f.getters[i].get(ctx, containerId)
+			<-f.slots[i]
+			if err != nil && ctx.Err() == context.DeadlineExceeded {
+				f.queue.Stats.EngineTimeouts.Add(1)
+			}
+			results <- evt
+		}(i)
+	}
+	for range f.getters {
+		if evt := <-results; evt != nil {
+			return evt
+		}
+	}
+	return nil
+}
@@ -5,6 +5,7 @@ import (
 	"github.com/falcosecurity/plugins/plugins/container/go-worker/pkg/event"
 	"github.com/stretchr/testify/assert"
 	"sync"
+	"sync/atomic"
 	"testing"
 	"time"
 )
@@ -32,13 +33,13 @@ func TestCRIFetcher(t *testing.T) {
 func testFetcher(t *testing.T, containerEngine Engine, containerId string, expectedEvent event.Event) {
 	// Create the fetcher engine with the docker engine as the only container engine
 	containerEngines := []Engine{containerEngine}
-	fetchCh := make(chan string)
-	assert.NotNil(t, fetchCh)
+	fetchQ := NewFetchQueue(1)
+	assert.NotNil(t, fetchQ)
 	t.Cleanup(func() {
-		close(fetchCh)
+		fetchQ.Close()
 	})
 
-	f := NewFetcherEngine(context.Background(), fetchCh, containerEngines)
+	f := NewFetcherEngine(context.Background(), fetchQ, containerEngines, 0)
 	assert.NotNil(t, f)
 
 	// Check that fetcher is able to fetch the container
@@ -55,7 +56,7 @@ func testFetcher(t *testing.T, containerEngine Engine, containerId string, expec
 	// Send the container ID to the fetcher channel to request its info to be loaded
 	go func() {
 		time.Sleep(1 * time.Second)
-		fetchCh <- containerId
+		fetchQ.Push(FetchRequest{ContainerID: containerId, Deadline: time.Now().Add(5 * time.Second)})
 	}()
 
 	evt := waitOnChannelOrTimeout(t, listCh)
@@ -68,3 +69,108 @@ func testFetcher(t *testing.T, containerEngine Engine, containerId string, expec
 	expectedEvent.Env = evt.Env
 	assert.Equal(t, expectedEvent, evt)
 }
+
+// slowGetter answers after delay, or fails once ctx is done
+type slowGetter struct {
+	delay time.Duration
+	evt   *event.Event
+	calls atomic.Int32
+}
+
+func (g *slowGetter) get(ctx context.Context, containerId string) (*event.Event, error) {
+	g.calls.Add(1)
+	select {
+	case <-time.After(g.delay):
+		if g.evt == nil || g.evt.ID != containerId {
+			return nil, nil
+		}
+		return g.evt, nil
+	case <-ctx.Done():
+		return nil, ctx.Err()
+	}
+}
+
+func newTestFetcher(queue *FetchQueue, maxConcurrent int, getters ...getter) *fetcher {
+	f := &fetcher{ctx: context.Background(), queue: queue}
+	for _, g := range getters {
+		f.getters = append(f.getters, g)
+		f.slots = append(f.slots, make(chan struct{}, maxConcurrent))
+	}
+	return f
+}
+
+func TestFetcherSlowEngine(t *testing.T) {
+	fetchQ := NewFetchQueue(10)
+	// An unresponsive engine does not delay the answer of the other one
+	hung := &slowGetter{delay: time.Hour}
+	fast := &slowGetter{evt: &event.Event{Info: event.Info{Container: event.Container{ID: "fast"}}}}
+	f := newTestFetcher(fetchQ, 1, hung, fast)
+
+	wg := sync.WaitGroup{}
+	ctx, cancel := context.WithCancel(context.Background())
+	listCh, err := f.Listen(ctx, &wg)
+	assert.NoError(t, err)
+
+	start := time.Now()
+	assert.True(t, fetchQ.Push(FetchRequest{ContainerID: "fast", Deadline: time.Now().Add(200 * time.Millisecond)}))
+	evt := waitOnChannelOrTimeout(t, listCh)
+	assert.Equal(t, "fast", evt.ID)
+	assert.Less(t, time.Since(start), 100*time.Millisecond)
+
+	// Cancelled once the fast engine answered
+	assert.Eventually(t, func() bool { return fetchQ.Stats.InFlight.Load() == 0 }, time.Second, 10*time.Millisecond)
+	assert.Equal(t, uint64(1), fetchQ.Stats.Completed.Load())
+	assert.Equal(t, uint64(0), fetchQ.Stats.EngineTimeouts.Load())
+
+	// Unknown to the fast engine, the hung one is cut by the deadline
+	assert.True(t, fetchQ.Push(FetchRequest{ContainerID: "gone", Deadline: time.Now().Add(100 * time.Millisecond)}))
+	assert.Eventually(t, func() bool { return fetchQ.Stats.Timeouts.Load() == 1 }, time.Second, 10*time.Millisecond)
+	assert.Equal(t, uint64(1), fetchQ.Stats.EngineTimeouts.Load())
+	assert.Equal(t, uint64(1), fetchQ.Stats.Completed.Load())
+
+	cancel()
+	wg.Wait()
+	fetchQ.Close()
+}
+
+func TestFetcherDeadline(t *testing.T) {
+	fetchQ := NewFetchQueue(10)
+	missing := &slowGetter{}
+	f := newTestFetcher(fetchQ, 1, missing)
+
+	wg := sync.WaitGroup{}
+	ctx, cancel := context.WithCancel(context.Background())
+	_, err := f.Listen(ctx, &wg)
+	assert.NoError(t, err)
+
+	// Retried with backoff, given up past the deadline
+	assert.True(t, fetchQ.Push(FetchRequest{ContainerID: "missing", Deadline: time.Now().Add(100 * time.Millisecond)}))
+	assert.Eventually(t, func() bool { return fetchQ.Stats.Timeouts.Load() == 1 }, time.Second, 10*time.Millisecond)
+	assert.Greater(t, missing.calls.Load(), int32(1))
+	assert.Less(t, missing.calls.Load(), int32(5))
+	assert.Equal(t, int64(0), fetchQ.Stats.InFlight.Load())
+
+	cancel()
+	wg.Wait()
+	fetchQ.Close()
+}
+
+func TestFetchQueuePriority(t *testing.T) {
+	fetchQ := NewFetchQueue(1)
+	assert.True(t, fetchQ.Push(FetchRequest{ContainerID: "regular"}))
+	assert.False(t, fetchQ.Push(FetchRequest{ContainerID: "full"}))
+	assert.True(t, fetchQ.Push(FetchRequest{ContainerID: "priority", Priority: true}))
+	assert.Equal(t, uint64(2), fetchQ.Stats.Requests.Load())
+	assert.Equal(t, uint64(1), fetchQ.Stats.PriorityRequests.Load())
+
+	req, ok := fetchQ.pop(context.Background())
+	assert.True(t, ok)
+	assert.Equal(t, "priority", req.ContainerID)
+	req, ok = fetchQ.pop(context.Background())
+	assert.True(t, ok)
+	assert.Equal(t, "regular", req.ContainerID)
+
+	fetchQ.Close()
+	_, ok = fetchQ.pop(context.Background())
+	assert.False(t, ok)
+}
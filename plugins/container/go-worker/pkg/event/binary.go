@@ -0,0 +1,277 @@
+package event
+
+import (
+	"encoding/binary"
+	"maps"
+	"slices"
+	"sort"
+)
+
+// Binary encoding of an Info, the layout is documented in
+// src/container_info_binary.h; the two must be kept in sync.
+const (
+	binaryMagic   = 0x31544346 // "FCT1"
+	binaryVersion = 1
+
+	// BinaryFlagInitialState marks containers listed at startup,
+	// already cached by the C++ side when their async event gets parsed.
+	BinaryFlagInitialState = 1 << 0
+	// BinaryFlagDelta marks updates of containers already sent,
+	// only carrying their changed fields, see Info.DeltaBinary().
+	BinaryFlagDelta = 1 << 1
+
+	// Offset of the references of unchanged fields in delta payloads
+	binaryUnchanged = 0xffffffff
+
+	binaryScalarsOffset = 16
+	binaryStringsOffset = binaryScalarsOffset + 8*8
+	binaryListsOffset   = binaryStringsOffset + 12*8
+	binaryFixedSize     = binaryListsOffset + 6*8
+
+	binaryEnvEntrySize         = 8
+	binaryLabelEntrySize       = 16
+	binaryMountEntrySize       = 40
+	binaryPortMappingEntrySize = 8
+	binaryProbeEntrySize       = 24
+)
+
+// Sections of a container that no extracted field may need, see
+// Container.Prune; keep in sync with CONTAINER_INFO_SECTION_* in
+// src/container_info_binary.h.
+const (
+	SectionEnv = 1 << iota
+	SectionMounts
+	SectionPortMappings
+	SectionHealthProbes
+	SectionCNIResult
+)
+
+// Probe types, see container_health_probe::probe_type
+const (
+	probeHealthcheck = 1
+	probeLiveness    = 2
+	probeReadiness   = 3
+)
+
+var le = binary.LittleEndian
+
+type binaryWriter struct {
+	buf []byte
+}
+
+// reserve appends n zeroed bytes and returns their offset.
+func (w *binaryWriter) reserve(n int) int {
+	off := len(w.buf)
+	w.buf = append(w.buf, make([]byte, n)...)
+	return off
+}
+
+// putString appends s and writes its reference at ref.
+func (w *binaryWriter) putString(ref int, s string) {
+	le.PutUint32(w.buf[ref:], uint32(len(w.buf)))
+	le.PutUint32(w.buf[ref+4:], uint32(len(s)))
+	w.buf = append(w.buf, s...)
+}
+
+// putUnchanged marks the string or list reference at ref as unchanged.
+func (w *binaryWriter) putUnchanged(ref int) {
+	le.PutUint32(w.buf[ref:], binaryUnchanged)
+}
+
+// putList reserves count entries and writes their list reference at ref.
+func (w *binaryWriter) putList(ref, count, entrySize int) int {
+	off := w.reserve(count * entrySize)
+	le.PutUint32(w.buf[ref:], uint32(off))
+	le.PutUint32(w.buf[ref+4:], uint32(count))
+	return off
+}
+
+func (w *binaryWriter) putLabels(ref int, labels map[string]string) {
+	// Sorted, as the C++ side stores them, for reproducible payloads
+	keys := make([]string, 0, len(labels))
+	for k := range labels {
+		keys = append(keys, k)
+	}
+	sort.Strings(keys)
+	off := w.putList(ref, len(keys), binaryLabelEntrySize)
+	for _, k := range keys {
+		w.putString(off, k)
+		w.putString(off+8, labels[k])
+		off += binaryLabelEntrySize
+	}
+}
+
+func (w *binaryWriter) putProbes(ref int, c *Container) {
+	type typedProbe struct {
+		probeType uint32
+		probe     *Probe
+	}
+	probes := make([]typedProbe, 0, 3)
+	for _, p := range []typedProbe{{probeHealthcheck, c.HealthcheckProbe},
+		{probeLiveness, c.LivenessProbe}, {probeReadiness, c.ReadinessProbe}} {
+		if p.probe != nil {
+			probes = append(probes, p)
+		}
+	}
+	off := w.putList(ref, len(probes), binaryProbeEntrySize)
+	for _, p := range probes {
+		le.PutUint32(w.buf[off:], p.probeType)
+		w.putString(off+8, p.probe.Exe)
+		args := w.putList(off+16, len(p.probe.Args), binaryEnvEntrySize)
+		for _, arg := range p.probe.Args {
+			w.putString(args, arg)
+			args += binaryEnvEntrySize
+		}
+		off += binaryProbeEntrySize
+	}
+}
+
+func boolBit(b bool, bit uint) byte {
+	if b {
+		return 1 << bit
+	}
+	return 0
+}
+
+func probeEqual(a, b *Probe) bool {
+	if a == nil || b == nil {
+		return a == b
+	}
+	return a.Exe == b.Exe && slices.Equal(a.Args, b.Args)
+}
+
+// Prune empties the given sections of the container, so that they are neither
+// encoded nor taken into account by the deltas.
+func (c *Container) Prune(sections uint32) {
+	if sections&SectionEnv != 0 {
+		c.Env = nil
+	}
+	if sections&SectionMounts != 0 {
+		c.Mounts = nil
+	}
+	if sections&SectionPortMappings != 0 {
+		c.PortMappings = nil
+	}
+	if sections&SectionHealthProbes != 0 {
+		c.HealthcheckProbe = nil
+		c.LivenessProbe = nil
+		c.ReadinessProbe = nil
+	}
+	if sections&SectionCNIResult != 0 {
+		c.CniJson = ""
+	}
+}
+
+// Binary returns the binary encoding of the container info.
+func (i *Info) Binary(flags uint16) []byte {
+	return i.encode(flags, nil)
+}
+
+// DeltaBinary returns the binary encoding of the update of the container
+// from prev, which was already sent: only the strings and lists that changed
+// are carried, along with the id, the scalars and the bools.
+func (i *Info) DeltaBinary(prev *Info) []byte {
+	return i.encode(BinaryFlagDelta, &prev.Container)
+}
+
+func (i *Info) encode(flags uint16, prev *Container) []byte {
+	c := &i.Container
+	// Whether the field is unchanged since prev
+	same := func(equal func(p *Container) bool) bool {
+		return prev != nil && equal(prev)
+	}
+
+	w := binaryWriter{buf: make([]byte, 0, 1024)}
+	w.reserve(binaryFixedSize)
+	le.PutUint32(w.buf[0:], binaryMagic)
+	le.PutUint16(w.buf[4:], binaryVersion)
+	le.PutUint16(w.buf[6:], flags)
+	le.PutUint16(w.buf[12:], uint16(c.Type))
+	w.buf[14] = boolBit(c.Privileged, 0) | boolBit(c.HostPID, 1) |
+		boolBit(c.HostNetwork, 2) | boolBit(c.HostIPC, 3) | boolBit(c.IsPodSandbox, 4)
+
+	scalars := [...]int64{c.MemoryLimit, c.SwapLimit, c.CPUShares, c.CPUQuota,
+		c.CPUPeriod, c.CPUSetCPUCount, c.CreatedTime, c.Size}
+	for idx, v := range scalars {
+		le.PutUint64(w.buf[binaryScalarsOffset+idx*8:], uint64(v))
+	}
+
+	strs := [...]string{c.ID, c.FullID, c.Name, c.Image, c.ImageID, c.ImageRepo,
+		c.ImageTag, c.ImageDigest, c.Ip, c.PodSandboxID, c.CniJson, c.User}
+	var prevStrs [len(strs)]string
+	if prev != nil {
+		prevStrs = [...]string{prev.ID, prev.FullID, prev.Name, prev.Image,
+			prev.ImageID, prev.ImageRepo, prev.ImageTag, prev.ImageDigest,
+			prev.Ip, prev.PodSandboxID, prev.CniJson, prev.User}
+	}
+	for idx, s := range strs {
+		// The id is always set
+		if idx > 0 && prev != nil && s == prevStrs[idx] {
+			w.putUnchanged(binaryStringsOffset + idx*8)
+			continue
+		}
+		w.putString(binaryStringsOffset+idx*8, s)
+	}
+
+	if same(func(p *Container) bool { return slices.Equal(p.Env, c.Env) }) {
+		w.putUnchanged(binaryListsOffset)
+	} else {
+		off := w.putList(binaryListsOffset, len(c.Env), binaryEnvEntrySize)
+		for _, env := range c.Env {
+			w.putString(off, env)
+			off += binaryEnvEntrySize
+		}
+	}
+
+	if same(func(p *Container) bool { return maps.Equal(p.Labels, c.Labels) }) {
+		w.putUnchanged(binaryListsOffset + 8)
+	} else {
+		w.putLabels(binaryListsOffset+8, c.Labels)
+	}
+	if same(func(p *Container) bool { return maps.Equal(p.PodSandboxLabels, c.PodSandboxLabels) }) {
+		w.putUnchanged(binaryListsOffset + 16)
+	} else {
+		w.putLabels(binaryListsOffset+16, c.PodSandboxLabels)
+	}
+
+	if same(func(p *Container) bool { return slices.Equal(p.Mounts, c.Mounts) }) {
+		w.putUnchanged(binaryListsOffset + 24)
+	} else {
+		off := w.putList(binaryListsOffset+24, len(c.Mounts), binaryMountEntrySize)
+		for _, m := range c.Mounts {
+			w.putString(off, m.Source)
+			w.putString(off+8, m.Destination)
+			w.putString(off+16, m.Mode)
+			w.putString(off+24, m.Propagation)
+			if m.RW {
+				le.PutUint32(w.buf[off+32:], 1)
+			}
+			off += binaryMountEntrySize
+		}
+	}
+
+	if same(func(p *Container) bool { return slices.Equal(p.PortMappings, c.PortMappings) }) {
+		w.putUnchanged(binaryListsOffset + 32)
+	} else {
+		off := w.putList(binaryListsOffset+32, len(c.PortMappings), binaryPortMappingEntrySize)
+		for _, p := range c.PortMappings {
+			le.PutUint32(w.buf[off:], p.HostIP)
+			le.PutUint16(w.buf[off+4:], p.HostPort)
+			le.PutUint16(w.buf[off+6:], uint16(p.ContainerPort))
+			off += binaryPortMappingEntrySize
+		}
+	}
+
+	if same(func(p *Container) bool {
+		return probeEqual(p.HealthcheckProbe, c.HealthcheckProbe) &&
+			probeEqual(p.LivenessProbe, c.LivenessProbe) &&
+			probeEqual(p.ReadinessProbe, c.ReadinessProbe)
+	}) {
+		w.putUnchanged(binaryListsOffset + 40)
+	} else {
+		w.putProbes(binaryListsOffset+40, c)
+	}
+
+	le.PutUint32(w.buf[8:], uint32(len(w.buf)))
+	return w.buf
+}
@@ -0,0 +1,119 @@
+package event
+
+import (
+	"github.com/stretchr/testify/assert"
+	"testing"
+)
+
+func readString(buf []byte, ref int) string {
+	off := le.Uint32(buf[ref:])
+	l := le.Uint32(buf[ref+4:])
+	return string(buf[off : off+l])
+}
+
+func TestBinary(t *testing.T) {
+	info := Info{Container{
+		Type:         7,
+		ID:           "fee3a77211e1",
+		Image:        "nginx:1.27",
+		IsPodSandbox: true,
+		MemoryLimit:  2147483648,
+		Size:         -1,
+		Env:          []string{"TZ=Asia/Shanghai"},
+		Labels:       map[string]string{"tier": "web", "app": "nginx"},
+		Mounts:       []Mount{{Source: "/data", Destination: "/mnt", RW: true}},
+		PortMappings: []PortMapping{{HostIP: 1, HostPort: 8080, ContainerPort: 80}},
+		ReadinessProbe: &Probe{
+			Exe:  "/ready",
+			Args: []string{"-v"},
+		},
+	}}
+	buf := info.Binary(BinaryFlagInitialState)
+
+	assert.Equal(t, uint32(binaryMagic), le.Uint32(buf[0:]))
+	assert.Equal(t, uint16(binaryVersion), le.Uint16(buf[4:]))
+	assert.Equal(t, uint16(BinaryFlagInitialState), le.Uint16(buf[6:]))
+	assert.Equal(t, uint32(len(buf)), le.Uint32(buf[8:]))
+	assert.Equal(t, uint16(7), le.Uint16(buf[12:]))
+	assert.Equal(t, byte(1<<4), buf[14])
+	assert.Equal(t, uint64(2147483648), le.Uint64(buf[binaryScalarsOffset:]))
+	assert.Equal(t, int64(-1), int64(le.Uint64(buf[binaryScalarsOffset+7*8:])))
+	assert.Equal(t, "fee3a77211e1", readString(buf, binaryStringsOffset))
+	assert.Equal(t, "nginx:1.27", readString(buf, binaryStringsOffset+3*8))
+
+	env := int(le.Uint32(buf[binaryListsOffset:]))
+	assert.Equal(t, uint32(1), le.Uint32(buf[binaryListsOffset+4:]))
+	assert.Equal(t, "TZ=Asia/Shanghai", readString(buf, env))
+
+	// Labels are sorted by key
+	labels := int(le.Uint32(buf[binaryListsOffset+8:]))
+	assert.Equal(t, uint32(2), le.Uint32(buf[binaryListsOffset+12:]))
+	assert.Equal(t, "app", readString(buf, labels))
+	assert.Equal(t, "nginx", readString(buf, labels+8))
+	assert.Equal(t, "tier", readString(buf, labels+binaryLabelEntrySize))
+
+	mounts := int(le.Uint32(buf[binaryListsOffset+24:]))
+	assert.Equal(t, "/mnt", readString(buf, mounts+8))
+	assert.Equal(t, uint32(1), le.Uint32(buf[mounts+32:]))
+
+	ports := int(le.Uint32(buf[binaryListsOffset+32:]))
+	assert.Equal(t, uint16(8080), le.Uint16(buf[ports+4:]))
+	assert.Equal(t, uint16(80), le.Uint16(buf[ports+6:]))
+
+	probes := int(le.Uint32(buf[binaryListsOffset+40:]))
+	assert.Equal(t, uint32(1), le.Uint32(buf[binaryListsOffset+44:]))
+	assert.Equal(t, uint32(probeReadiness), le.Uint32(buf[probes:]))
+	assert.Equal(t, "/ready", readString(buf, probes+8))
+	args := int(le.Uint32(buf[probes+16:]))
+	assert.Equal(t, "-v", readString(buf, args))
+}
+
+func TestDeltaBinary(t *testing.T) {
+	prev := Info{Container{
+		ID:     "fee3a77211e1",
+		Image:  "nginx:1.27",
+		Labels: map[string]string{"app": "nginx"},
+		Mounts: []Mount{{Source: "/data", Destination: "/mnt"}},
+	}}
+	info := prev
+	info.Ip = "10.0.0.12"
+	info.Labels = map[string]string{"app": "nginx", "tier": "web"}
+	buf := info.DeltaBinary(&prev)
+
+	assert.Equal(t, uint16(BinaryFlagDelta), le.Uint16(buf[6:]))
+	assert.Equal(t, uint32(len(buf)), le.Uint32(buf[8:]))
+	// The id is always set
+	assert.Equal(t, "fee3a77211e1", readString(buf, binaryStringsOffset))
+	// Unchanged fields carry no data
+	assert.Equal(t, uint32(binaryUnchanged), le.Uint32(buf[binaryStringsOffset+3*8:]))
+	assert.Equal(t, uint32(binaryUnchanged), le.Uint32(buf[binaryListsOffset:]))
+	assert.Equal(t, uint32(binaryUnchanged), le.Uint32(buf[binaryListsOffset+24:]))
+	assert.Equal(t, uint32(binaryUnchanged), le.Uint32(buf[binaryListsOffset+40:]))
+	// Changed ones are set
+	assert.Equal(t, "10.0.0.12", readString(buf, binaryStringsOffset+8*8))
+	assert.Equal(t, uint32(2), le.Uint32(buf[binaryListsOffset+12:]))
+
+	assert.Less(t, len(buf), len(info.Binary(0)))
+}
+
+func TestPrune(t *testing.T) {
+	info := Info{Container{
+		ID:               "fee3a77211e1",
+		CniJson:          `{"eth0":"10.0.0.12"}`,
+		Env:              []string{"TZ=UTC"},
+		Labels:           map[string]string{"app": "nginx"},
+		Mounts:           []Mount{{Source: "/data", Destination: "/mnt"}},
+		PortMappings:     []PortMapping{{HostPort: 8080, ContainerPort: 80}},
+		HealthcheckProbe: &Probe{Exe: "/bin/true"},
+	}}
+	info.Prune(SectionEnv | SectionPortMappings | SectionHealthProbes | SectionCNIResult)
+	buf := info.Binary(0)
+
+	assert.Equal(t, "", readString(buf, binaryStringsOffset+10*8))
+	assert.Equal(t, uint32(0), le.Uint32(buf[binaryListsOffset+4:]))
+	assert.Equal(t, uint32(0), le.Uint32(buf[binaryListsOffset+32+4:]))
+	assert.Equal(t, uint32(0), le.Uint32(buf[binaryListsOffset+40+4:]))
+	// Other sections are kept
+	assert.Equal(t, uint32(1), le.Uint32(buf[binaryListsOffset+8+4:]))
+	assert.Equal(t, uint32(1), le.Uint32(buf[binaryListsOffset+24+4:]))
+}
@@ -2,27 +2,170 @@ package main
 
 /*
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
-typedef void (*async_cb)(const char *json, bool added, bool initial_state);
-extern void makeCallback(const char *json, bool added, bool initial_state, async_cb cb) {
-	cb(json, added, initial_state);
+typedef void (*async_cb)(const char *data, uint32_t len, bool added);
+extern void makeCallback(const char *data, uint32_t len, bool added, async_cb cb) {
+	cb(data, len, added);
 }
 */
 import "C"
 
 import (
 	"context"
+	"github.com/falcosecurity/plugins/plugins/container/go-worker/pkg/config"
 	"github.com/falcosecurity/plugins/plugins/container/go-worker/pkg/container"
 	"github.com/falcosecurity/plugins/plugins/container/go-worker/pkg/event"
 	"reflect"
 	"sync"
+	"time"
 )
 
-const ctxDoneIdx = 0
+const (
+	ctxDoneIdx    = 0
+	reconcileIdx  = 1
+	reconciledIdx = 2
+)
+
+const (
+	// Period at which the sent containers are checked against the engines
+	// listings, not to leak the ones whose removal was missed.
+	reconcileInterval = 5 * time.Minute
+	reconcileTimeout  = 30 * time.Second
+)
+
+type asyncCb func([]byte, bool)
+
+// sentContainers holds the last info sent for each container, so that
+// updates of containers already sent only carry their changed fields.
+type sentContainers map[string]*event.Info
+
+// payload returns the binary payload to send for evt. Full payloads are
+// sent for new containers, or when forced, eg: for containers explicitly
+// asked by the C++ side, which does not hold them. The sections needed by
+// no extracted field are pruned beforehand.
+func (s sentContainers) payload(evt *event.Event, full bool) []byte {
+	if !evt.IsCreate {
+		delete(s, evt.ID)
+		return evt.Binary(0)
+	}
+	evt.Prune(config.GetPrunedSections())
+	prev, ok := s[evt.ID]
+	info := evt.Info
+	s[evt.ID] = &info
+	if ok && !full {
+		return info.DeltaBinary(prev)
+	}
+	return info.Binary(0)
+}
+
+// initialSnapshot lists the pre-existing containers of all engines in
+// parallel and returns their binary encodings, flagged as initial state,
+// concatenated in engines order; they are also recorded into `sent`.
+// Each payload starts with its own size, see event.Info.Binary().
+func initialSnapshot(ctx context.Context, containerEngines []container.Engine, sent sentContainers) []byte {
+	lists := make([][]event.Event, len(containerEngines))
+	payloads := make([][][]byte, len(containerEngines))
+	var wg sync.WaitGroup
+	for i, engine := range containerEngines {
+		wg.Add(1)
+		go func(i int, engine container.Engine) {
+			defer wg.Done()
+			containers, err := engine.List(ctx)
+			if err != nil {
+				return
+			}
+			lists[i] = containers
+			payloads[i] = make([][]byte, 0, len(containers))
+			for idx := range containers {
+				containers[idx].Prune(config.GetPrunedSections())
+				payloads[i] = append(payloads[i], containers[idx].Binary(event.BinaryFlagInitialState))
+			}
+		}(i, engine)
+	}
+	wg.Wait()
+
+	for _, containers := range lists {
+		for idx := range containers {
+			info := containers[idx].Info
+			sent[info.ID] = &info
+		}
+	}
+
+	size := 0
+	for _, p := range payloads {
+		for _, payload := range p {
+			size += len(payload)
+		}
+	}
+	snapshot := make([]byte, 0, size)
+	for _, p := range payloads {
+		for _, payload := range p {
+			snapshot = append(snapshot, payload...)
+		}
+	}
+	return snapshot
+}
+
+// reconcileResult holds the outcome of a background listing of the engines.
+type reconcileResult struct {
+	// The containers sent before the listing started
+	candidates []string
+	// The containers listed, nil if any listing failed
+	listed map[string]struct{}
+}
+
+// startReconcile lists all engines off the worker loop, not to hold back
+// the container events while an engine is slow to answer. The ids already in
+// sent are the only removal candidates: the containers sent meanwhile may be
+// missing from the listings.
+func startReconcile(ctx context.Context, containerEngines []container.Engine, sent sentContainers, results chan<- reconcileResult) {
+	res := reconcileResult{candidates: make([]string, 0, len(sent))}
+	for id := range sent {
+		res.candidates = append(res.candidates, id)
+	}
+	go func() {
+		ctx, cancel := context.WithTimeout(ctx, reconcileTimeout)
+		defer cancel()
+		listed := make(map[string]struct{})
+		for _, engine := range containerEngines {
+			if container.IsFetcher(engine) {
+				continue
+			}
+			containers, err := engine.List(ctx)
+			if err != nil {
+				listed = nil
+				break
+			}
+			for _, ctr := range containers {
+				listed[ctr.ID] = struct{}{}
+			}
+		}
+		res.listed = listed
+		// Buffered, never blocks if the worker loop is gone
+		results <- res
+	}()
+}
 
-type asyncCb func(string, bool, bool)
+// reconcile reports as removed the candidates still sent but missing from
+// all the listings. Nothing is removed if any listing failed.
+func reconcile(cb asyncCb, sent sentContainers, res reconcileResult) {
+	if res.listed == nil {
+		return
+	}
+	for _, id := range res.candidates {
+		info, ok := sent[id]
+		if !ok {
+			continue
+		}
+		if _, ok := res.listed[id]; !ok {
+			delete(sent, id)
+			cb(info.Binary(0), false)
+		}
+	}
+}
 
-func workerLoop(ctx context.Context, cb asyncCb, containerEngines []container.Engine, wg *sync.WaitGroup) {
+func workerLoop(ctx context.Context, cb asyncCb, containerEngines []container.Engine, sent sentContainers, wg *sync.WaitGroup) {
 	var evt event.Event
 
 	// We need to use a reflect.SelectCase here since
@@ -34,6 +177,21 @@ func workerLoop(ctx context.Context, cb asyncCb, containerEngines []container.En
 		Dir:  reflect.SelectRecv,
 		Chan: reflect.ValueOf(ctx.Done()),
 	})
+	ticker := time.NewTicker(reconcileInterval)
+	defer ticker.Stop()
+	cases = append(cases, reflect.SelectCase{
+		Dir:  reflect.SelectRecv,
+		Chan: reflect.ValueOf(ticker.C),
+	})
+	// At most one reconcile at once
+	reconciled := make(chan reconcileResult, 1)
+	reconciling := false
+	cases = append(cases, reflect.SelectCase{
+		Dir:  reflect.SelectRecv,
+		Chan: reflect.ValueOf(reconciled),
+	})
+	// Whether the events of each case need full payloads
+	full := []bool{false, false, false}
 
 	// Emplace back cases for each container engine listener
 	for _, engine := range containerEngines {
@@ -45,6 +203,7 @@ func workerLoop(ctx context.Context, cb asyncCb, containerEngines []container.En
 			Dir:  reflect.SelectRecv,
 			Chan: reflect.ValueOf(ch),
 		})
+		full = append(full, container.IsFetcher(engine))
 	}
 
 	for {
@@ -53,12 +212,25 @@ func workerLoop(ctx context.Context, cb asyncCb, containerEngines []container.En
 			// ctx.Done!
 			return
 		}
+		if chosen == reconcileIdx {
+			if !reconciling {
+				reconciling = true
+				startReconcile(ctx, containerEngines, sent, reconciled)
+			}
+			continue
+		}
+		if chosen == reconciledIdx {
+			reconciling = false
+			reconcile(cb, sent, val.Interface().(reconcileResult))
+			continue
+		}
 		if recvOk {
 			evt, _ = val.Interface().(event.Event)
-			cb(evt.String(), evt.IsCreate, false)
+			cb(sent.payload(&evt, full[chosen]), evt.IsCreate)
 		} else {
 			// Remove the stopped goroutine
 			cases = append(cases[:chosen], cases[chosen+1:]...)
+			full = append(full[:chosen], full[chosen+1:]...)
 		}
 	}
 }
@@ -2,9 +2,20 @@ package main
 
 /*
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
 typedef const char cchar_t;
-typedef void (*async_cb)(const char *json, bool added, bool initial_state);
-void makeCallback(const char *json, bool added, bool initial_state, async_cb cb);
+typedef void (*async_cb)(const char *data, uint32_t len, bool added);
+void makeCallback(const char *data, uint32_t len, bool added, async_cb cb);
+// Outcome of the AskForContainerInfo requests, see GetFetchStats
+typedef struct {
+	uint64_t requests;
+	uint64_t priority_requests;
+	uint64_t completed;
+	uint64_t timeouts;
+	uint64_t engine_timeouts;
+	uint64_t in_flight;
+} fetch_stats;
 */
 import "C"
 
@@ -17,38 +28,47 @@ import (
 	"runtime"
 	"runtime/cgo"
 	"sync"
+	"time"
 	"unsafe"
 )
 
 type PluginCtx struct {
-	wg           sync.WaitGroup
-	ctxCancel    context.CancelFunc
-	stringBuffer ptr.StringBuffer
-	pinner       runtime.Pinner
-	fetchCh      chan string
+	wg        sync.WaitGroup
+	ctxCancel context.CancelFunc
+	pinner    runtime.Pinner
+	fetchQ    *container.FetchQueue
 }
 
+// StartWorker starts listening for container events, reported through `cb`.
+// `initialState` is set to a malloc'ed buffer, to be freed by the caller,
+// holding the binary encodings of all pre-existing containers (see initialSnapshot),
+// or to NULL if there are none.
+//
 //export StartWorker
-func StartWorker(cb C.async_cb, initCfg *C.cchar_t, enabledSocks **C.cchar_t) unsafe.Pointer {
+func StartWorker(cb C.async_cb, initCfg *C.cchar_t, enabledSocks **C.cchar_t,
+	initialState **C.char, initialStateLen *C.uint32_t) unsafe.Pointer {
 	var (
 		pluginCtx PluginCtx
 		ctx       context.Context
 	)
-	const fetchChSize = 100
+	const fetchQueueSize = 100
 	ctx, pluginCtx.ctxCancel = context.WithCancel(context.Background())
 
 	// See https://github.com/enobufs/go-calls-c-pointer/blob/master/counter_api.go
-	goCb := func(containerJson string, added bool, initialState bool) {
-		if containerJson == "" {
+	// `payload` is the binary encoding of the container, see event.Info.Binary()
+	goCb := func(payload []byte, added bool) {
+		if len(payload) == 0 {
 			return
 		}
 		// Go cannot call C-function pointers. Instead, use
 		// a C-function to have it call the function pointer.
-		pluginCtx.stringBuffer.Write(containerJson)
+		// The payload holds no Go pointers and is only read during the call,
+		// where it gets copied once into the async event: hand it over as is
+		// rather than copying it to C memory first.
+		clen := C.uint32_t(len(payload))
 		cadded := C.bool(added)
-		cinitialState := C.bool(initialState)
-		cStr := (*C.char)(pluginCtx.stringBuffer.CharPtr())
-		C.makeCallback(cStr, cadded, cinitialState, cb)
+		cStr := (*C.char)(unsafe.Pointer(&payload[0]))
+		C.makeCallback(cStr, clen, cadded, cb)
 	}
 
 	err := config.Load(ptr.GoString(unsafe.Pointer(initCfg)))
@@ -73,20 +93,23 @@ func StartWorker(cb C.async_cb, initCfg *C.cchar_t, enabledSocks **C.cchar_t) un
 			enabledEngines[engine.Name()] = make([]string, 0)
 		}
 		enabledEngines[engine.Name()] = append(enabledEngines[engine.Name()], engine.Sock())
-		// List all pre-existing containers and run `goCb` on all of them
-		containers, err := engine.List(ctx)
-		if err == nil {
-			for _, ctr := range containers {
-				goCb(ctr.String(), true, true)
-			}
-		}
 	}
 
-	pluginCtx.fetchCh = make(chan string, fetchChSize)
+	// List all pre-existing containers at once
+	*initialState = nil
+	*initialStateLen = 0
+	sent := make(sentContainers)
+	if snapshot := initialSnapshot(ctx, containerEngines, sent); len(snapshot) > 0 {
+		*initialState = (*C.char)(C.CBytes(snapshot))
+		*initialStateLen = C.uint32_t(len(snapshot))
+	}
+
+	pluginCtx.fetchQ = container.NewFetchQueue(fetchQueueSize)
 
 	// Always append the dummy engine that is required to
 	// be able to fetch container infos on the fly given other enabled engines.
-	containerEngines = append(containerEngines, container.NewFetcherEngine(ctx, pluginCtx.fetchCh, containerEngines))
+	containerEngines = append(containerEngines, container.NewFetcherEngine(ctx, pluginCtx.fetchQ, containerEngines,
+		config.GetFetchMaxConcurrent()))
 
 	// Store json of attached sockets in `enabledSocks`
 	bytes, _ := json.Marshal(enabledEngines)
@@ -96,7 +119,7 @@ func StartWorker(cb C.async_cb, initCfg *C.cchar_t, enabledSocks **C.cchar_t) un
 	pluginCtx.wg.Add(1)
 	go func() {
 		defer pluginCtx.wg.Done()
-		workerLoop(ctx, goCb, containerEngines, &pluginCtx.wg)
+		workerLoop(ctx, goCb, containerEngines, sent, &pluginCtx.wg)
 	}()
 	h := cgo.NewHandle(&pluginCtx)
 	pluginCtx.pinner.Pin(&h)
@@ -110,29 +133,55 @@ func StopWorker(pCtx unsafe.Pointer) {
 
 	pluginCtx.ctxCancel()
 	pluginCtx.wg.Wait()
-	pluginCtx.stringBuffer.Free()
-	close(pluginCtx.fetchCh)
-	pluginCtx.fetchCh = nil
+	pluginCtx.fetchQ.Close()
+	pluginCtx.fetchQ = nil
 
 	pluginCtx.pinner.Unpin()
 	h.Delete()
 }
 
+// AskForContainerInfo queues a request for the info of a container, dropped
+// if not fulfilled within `timeoutMs` (0 for the default timeout). Priority
+// requests skip the queue, eg: for containers whose events are being
+// evaluated right now. Returns false if the queue is full.
+//
 //export AskForContainerInfo
-func AskForContainerInfo(pCtx unsafe.Pointer, containerId *C.cchar_t) bool {
+func AskForContainerInfo(pCtx unsafe.Pointer, containerId *C.cchar_t, timeoutMs C.uint32_t, priority C.bool) bool {
 	h := (*cgo.Handle)(pCtx)
 	pluginCtx := h.Value().(*PluginCtx)
 
-	containerID := C.GoString(containerId)
-	if pluginCtx.fetchCh != nil {
-		select {
-		case pluginCtx.fetchCh <- containerID:
-			return true
-		default:
-			return false
-		}
+	req := container.FetchRequest{
+		ContainerID: C.GoString(containerId),
+		Priority:    bool(priority),
+	}
+	if timeoutMs > 0 {
+		req.Deadline = time.Now().Add(time.Duration(timeoutMs) * time.Millisecond)
+	}
+	if pluginCtx.fetchQ != nil {
+		return pluginCtx.fetchQ.Push(req)
 	}
-	// In case the fetch channel is nil a retry from falco
+	// In case the fetch queue is nil a retry from falco
 	// does not make sense, report the containerId as handled
 	return true
 }
+
+// GetFetchStats fills `stats` with the outcome of the AskForContainerInfo
+// requests so far.
+//
+//export GetFetchStats
+func GetFetchStats(pCtx unsafe.Pointer, stats *C.fetch_stats) {
+	h := (*cgo.Handle)(pCtx)
+	pluginCtx := h.Value().(*PluginCtx)
+
+	*stats = C.fetch_stats{}
+	if pluginCtx.fetchQ == nil {
+		return
+	}
+	s := &pluginCtx.fetchQ.Stats
+	stats.requests = C.uint64_t(s.Requests.Load())
+	stats.priority_requests = C.uint64_t(s.PriorityRequests.Load())
+	stats.completed = C.uint64_t(s.Completed.Load())
+	stats.timeouts = C.uint64_t(s.Timeouts.Load())
+	stats.engine_timeouts = C.uint64_t(s.EngineTimeouts.Load())
+	stats.in_flight = C.uint64_t(s.InFlight.Load())
+}
@@ -2,6 +2,8 @@ package main
 
 import (
 	"context"
+	"encoding/binary"
+	"errors"
 	"github.com/falcosecurity/plugins/plugins/container/go-worker/pkg/container"
 	"github.com/falcosecurity/plugins/plugins/container/go-worker/pkg/event"
 	"github.com/stretchr/testify/assert"
@@ -67,9 +69,9 @@ func TestWorkerLoop(t *testing.T) {
 	wg.Add(1)
 	go func() {
 		defer wg.Done()
-		workerLoop(ctx, func(jsonEvt string, isCreate bool, _ bool) {
+		workerLoop(ctx, func(payload []byte, isCreate bool) {
 			numEvents++
-		}, containerEngines, &wg)
+		}, containerEngines, make(sentContainers), &wg)
 	}()
 
 	// Give some time to gouroutines to generate events
@@ -104,9 +106,9 @@ func TestWorkerLoopExitBeforeCtxCancel(t *testing.T) {
 	wg.Add(1)
 	go func() {
 		defer wg.Done()
-		workerLoop(ctx, func(jsonEvt string, isCreate bool, _ bool) {
+		workerLoop(ctx, func(payload []byte, isCreate bool) {
 			numEvents++
-		}, containerEngines, &wg)
+		}, containerEngines, make(sentContainers), &wg)
 	}()
 
 	// Wait for goroutines to be spawned
@@ -130,3 +132,108 @@ func TestWorkerLoopExitBeforeCtxCancel(t *testing.T) {
 	// No event sent
 	assert.Equal(t, 0, numEvents)
 }
+
+type listEngine struct {
+	noopEngine
+	ids []string
+	err error
+}
+
+func (l *listEngine) List(_ context.Context) ([]event.Event, error) {
+	if l.err != nil {
+		return nil, l.err
+	}
+	evts := make([]event.Event, 0, len(l.ids))
+	for _, id := range l.ids {
+		evts = append(evts, event.Event{Info: event.Info{Container: event.Container{ID: id}}})
+	}
+	return evts, nil
+}
+
+func TestInitialSnapshot(t *testing.T) {
+	containerEngines := []container.Engine{
+		&listEngine{ids: []string{"aaaaaaaaaaaa", "bbbbbbbbbbbb"}},
+		&listEngine{},
+		&listEngine{ids: []string{"cccccccccccc"}},
+	}
+	sent := make(sentContainers)
+	snapshot := initialSnapshot(context.Background(), containerEngines, sent)
+
+	// Concatenated payloads, in engines order, each starting with its size
+	ids := make([]string, 0)
+	for off := 0; off < len(snapshot); {
+		payload := snapshot[off:]
+		size := int(binary.LittleEndian.Uint32(payload[8:]))
+		assert.Equal(t, uint16(event.BinaryFlagInitialState), binary.LittleEndian.Uint16(payload[6:]))
+		idOff := binary.LittleEndian.Uint32(payload[80:])
+		idLen := binary.LittleEndian.Uint32(payload[84:])
+		ids = append(ids, string(payload[idOff:idOff+idLen]))
+		off += size
+	}
+	assert.Equal(t, []string{"aaaaaaaaaaaa", "bbbbbbbbbbbb", "cccccccccccc"}, ids)
+
+	assert.Equal(t, 3, len(sent))
+
+	assert.Empty(t, initialSnapshot(context.Background(), []container.Engine{&listEngine{}}, make(sentContainers)))
+}
+
+func TestSentContainers(t *testing.T) {
+	sent := make(sentContainers)
+	evt := event.Event{Info: event.Info{Container: event.Container{ID: "aaaaaaaaaaaa", Ip: "10.0.0.1"}}, IsCreate: true}
+
+	flags := func(payload []byte) uint16 {
+		return binary.LittleEndian.Uint16(payload[6:])
+	}
+	// New containers are sent in full, then as deltas
+	assert.Equal(t, uint16(0), flags(sent.payload(&evt, false)))
+	assert.Equal(t, uint16(event.BinaryFlagDelta), flags(sent.payload(&evt, false)))
+	// unless explicitly asked
+	assert.Equal(t, uint16(0), flags(sent.payload(&evt, true)))
+
+	evt.IsCreate = false
+	sent.payload(&evt, false)
+	assert.Empty(t, sent)
+	evt.IsCreate = true
+	assert.Equal(t, uint16(0), flags(sent.payload(&evt, false)))
+}
+
+func TestReconcile(t *testing.T) {
+	sent := make(sentContainers)
+	for _, id := range []string{"aaaaaaaaaaaa", "bbbbbbbbbbbb", "cccccccccccc"} {
+		sent[id] = &event.Info{Container: event.Container{ID: id}}
+	}
+	removed := make([]string, 0)
+	cb := func(payload []byte, isCreate bool) {
+		assert.Equal(t, false, isCreate)
+		idOff := binary.LittleEndian.Uint32(payload[80:])
+		idLen := binary.LittleEndian.Uint32(payload[84:])
+		removed = append(removed, string(payload[idOff:idOff+idLen]))
+	}
+
+	run := func(engines ...container.Engine) {
+		results := make(chan reconcileResult, 1)
+		startReconcile(context.Background(), engines, sent, results)
+		reconcile(cb, sent, <-results)
+	}
+
+	// Nothing is removed when an engine cannot be listed
+	failing := &listEngine{err: errors.New("unreachable")}
+	run(&listEngine{ids: []string{"aaaaaaaaaaaa"}}, failing)
+	assert.Empty(t, removed)
+	assert.Equal(t, 3, len(sent))
+
+	run(&listEngine{ids: []string{"aaaaaaaaaaaa"}},
+		&listEngine{ids: []string{"cccccccccccc"}})
+	assert.Equal(t, []string{"bbbbbbbbbbbb"}, removed)
+	assert.Equal(t, 2, len(sent))
+
+	// Containers sent during the listing are kept
+	results := make(chan reconcileResult, 1)
+	startReconcile(context.Background(), []container.Engine{&listEngine{}}, sent, results)
+	res := <-results
+	sent["dddddddddddd"] = &event.Info{Container: event.Container{ID: "dddddddddddd"}}
+	reconcile(cb, sent, res)
+	assert.ElementsMatch(t, []string{"bbbbbbbbbbbb", "aaaaaaaaaaaa", "cccccccccccc"}, removed)
+	assert.Equal(t, 1, len(sent))
+	assert.Contains(t, sent, "dddddddddddd")
+}
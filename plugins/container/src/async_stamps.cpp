@@ -0,0 +1,49 @@
+#include "async_stamps.h"
+
+async_stamps::async_stamps(size_t max_size, uint64_t max_age_ns):
+        m_max_size(max_size), m_max_age_ns(max_age_ns)
+{
+}
+
+void async_stamps::stamp(const std::string& id, uint64_t now)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_stamps.size() >= m_max_size)
+    {
+        for(auto it = m_stamps.begin(); it != m_stamps.end();)
+        {
+            if(now >= it->second + m_max_age_ns)
+            {
+                it = m_stamps.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        if(m_stamps.size() >= m_max_size)
+        {
+            return;
+        }
+    }
+    m_stamps.try_emplace(id, now);
+}
+
+uint64_t async_stamps::take(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_stamps.find(id);
+    if(it == m_stamps.end())
+    {
+        return 0;
+    }
+    auto ts = it->second;
+    m_stamps.erase(it);
+    return ts;
+}
+
+size_t async_stamps::size()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stamps.size();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#define ASYNC_STAMPS_DEFAULT_MAX_SIZE 1024
+#define ASYNC_STAMPS_MAX_AGE_NS 60000000000ULL // 1min
+
+/*
+ * Time at which the go-worker handed the async event of each container over
+ * to the framework, taken back once the event gets parsed to measure how long
+ * it stayed queued. Events are stamped on the go-worker threads and parsed on
+ * the event thread, hence the lock; only container events go through, which
+ * are rare compared to syscalls.
+ *
+ * The number of stamps is bounded: once full, the stamps older than the max
+ * age, e.g. of events dropped by the framework, are expired to make room,
+ * otherwise new events are not stamped.
+ */
+class async_stamps
+{
+    public:
+    async_stamps(size_t max_size = ASYNC_STAMPS_DEFAULT_MAX_SIZE,
+                 uint64_t max_age_ns = ASYNC_STAMPS_MAX_AGE_NS);
+
+    // Stamp the event of `id` queued at `now`, the earliest stamp is kept if
+    // several events of `id` are queued
+    void stamp(const std::string& id, uint64_t now);
+    // Returns and forgets the stamp of `id`, 0 if none
+    uint64_t take(const std::string& id);
+
+    size_t size();
+
+    private:
+    std::mutex m_mutex;
+    std::unordered_map<std::string, uint64_t> m_stamps;
+    size_t m_max_size;
+    uint64_t m_max_age_ns;
+};
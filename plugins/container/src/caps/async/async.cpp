@@ -1,12 +1,15 @@
 #include <plugin.h>
 #include "async.tpp"
 
+#include <thread>
+
 //////////////////////////
 // Async capability
 //////////////////////////
 
 std::unique_ptr<falcosecurity::async_event_handler>
         s_async_handler[ASYNC_HANDLER_MAX];
+async_stamps s_async_stamps;
 
 std::vector<std::string> my_plugin::get_async_events()
 {
@@ -44,23 +47,65 @@ bool my_plugin::start_async_events(
                  falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
     nlohmann::json j(m_cfg);
     const char *enabled_engines = nullptr;
+    char *initial_state = nullptr;
+    uint32_t initial_state_len = 0;
     m_async_ctx = StartWorker(generate_async_event<ASYNC_HANDLER_GO_WORKER>,
-                              j.dump().c_str(), &enabled_engines);
+                              j.dump().c_str(), &enabled_engines,
+                              &initial_state, &initial_state_len);
     m_logger.log(fmt::format("attached engine sockets: {}", enabled_engines),
                  falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
     free((void *)enabled_engines);
 
-    // Merge back pre-existing containers to our cache
-    for(const auto &c : s_preexisting_containers)
+    if(initial_state != nullptr)
     {
-        m_containers.insert(c);
-        m_logger.log(fmt::format("Added pre-existing container: {}", c.first),
-                     falcosecurity::_internal::SS_PLUGIN_LOG_SEV_TRACE);
+        load_initial_state(initial_state, initial_state_len);
+        free(initial_state);
     }
 
     return m_async_ctx != nullptr;
 }
 
+// Cache all pre-existing containers listed by the go-worker at once, before
+// our listening CAP gets triggered, then forward them as async events so that
+// they also end up in captures.
+void my_plugin::load_initial_state(const char *data, uint32_t len)
+{
+    std::vector<std::string_view> payloads;
+    try
+    {
+        payloads = container_info_view::split(data, len);
+    }
+    catch(const std::exception &e)
+    {
+        m_logger.log(fmt::format("invalid initial state: {}", e.what()),
+                     falcosecurity::_internal::SS_PLUGIN_LOG_SEV_ERROR);
+        return;
+    }
+
+    auto n_threads = std::max(1u, std::thread::hardware_concurrency());
+    auto infos =
+            decode_container_infos(payloads, n_threads, m_cfg.pruned_sections);
+    for(size_t i = 0; i < payloads.size(); i++)
+    {
+        if(infos[i] == nullptr)
+        {
+            m_logger.log("skipping invalid pre-existing container",
+                         falcosecurity::_internal::SS_PLUGIN_LOG_SEV_WARNING);
+            continue;
+        }
+        m_containers.set(infos[i]->m_id, infos[i]);
+        m_logger.log(fmt::format("Added pre-existing container: {}",
+                                 infos[i]->m_id),
+                     falcosecurity::_internal::SS_PLUGIN_LOG_SEV_TRACE);
+        generate_async_event<ASYNC_HANDLER_GO_WORKER>(
+                payloads[i].data(), payloads[i].size(), true);
+    }
+    m_logger.log(fmt::format("loaded {} pre-existing containers",
+                             payloads.size()),
+                 falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
+    reconcile_warm_cache(infos);
+}
+
 // We need this API to stop the async thread when the
 // `set_async_event_handler` plugin API will be called.
 bool my_plugin::stop_async_events() noexcept
@@ -87,14 +132,14 @@ void my_plugin::dump(
     m_logger.log(fmt::format("dumping plugin internal state: {} containers",
                              m_containers.size()),
                  falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
+    std::string msg;
     for(const auto &container : m_containers)
     {
         falcosecurity::events::asyncevent_e_encoder enc;
         enc.set_tid(1);
-        nlohmann::json j(container.second);
-        std::string msg = j.dump();
+        container_info_to_binary(*container.second, msg);
         enc.set_name(ASYNC_EVENT_NAME_ADDED);
-        enc.set_data((void *)msg.c_str(), msg.size() + 1);
+        enc.set_data((void *)msg.data(), msg.size());
 
         enc.encode(async_handler->writer());
         async_handler->push();
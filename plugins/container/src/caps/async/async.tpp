@@ -1,6 +1,7 @@
 #pragma once
 
-#include "container_info_json.h"
+#include "async_stamps.h"
+#include "container_info_binary.h"
 
 #include <libworker.h>
 #include <chrono>
@@ -14,9 +15,9 @@ enum async_handler_id {
 
 extern std::unique_ptr<falcosecurity::async_event_handler>
         s_async_handler[ASYNC_HANDLER_MAX];
-
-static std::unordered_map<std::string, std::shared_ptr<const container_info>>
-            s_preexisting_containers;
+// When the go-worker queued the events of the containers, read back by
+// `parse_async_event`
+extern async_stamps s_async_stamps;
 
 static inline uint64_t get_current_time_ns(int sec_shift)
 {
@@ -25,25 +26,38 @@ static inline uint64_t get_current_time_ns(int sec_shift)
     return ns.count();
 }
 
+// Stamp the event of a container queued by the go-worker, the pre-existing
+// containers are already cached
+static inline void stamp_async_event(const char *data, uint32_t len)
+{
+    try
+    {
+        container_info_view view(data, len);
+        if(!(view.get_flags() & CONTAINER_INFO_BINARY_FLAG_INITIAL_STATE))
+        {
+            s_async_stamps.stamp(std::string(view.get_id()), monotonic_ns());
+        }
+    }
+    catch(const std::exception &)
+    {
+        // Reported when the event gets parsed
+    }
+}
+
 template<async_handler_id id>
-void generate_async_event(const char *json, bool added, bool initial_state)
+void generate_async_event(const char *data, uint32_t len, bool added)
 {
     falcosecurity::events::asyncevent_e_encoder enc;
     enc.set_tid(0); // not-existent tid
-    std::string msg = json;
     if(added)
     {
         // leave ts=-1 (default value) to ensure that the event is grabbed asap
-        enc.set_name(ASYNC_EVENT_NAME_ADDED);
-        // We are being called during initial `start_async_events`.
-        // Update our internal cache immediately since:
-        //     * we are called sinchronously
-        //     * when our listening CAP will be triggered,
-        //       we need pre-existing containers to be already cached.
-        if (initial_state) {
-            auto json_event = nlohmann::json::parse(json);
-            auto cinfo = json_event.get<container_info::ptr_t>();
-            s_preexisting_containers[cinfo->m_id] = cinfo;
+        enc.set_name(container_info_view::is_delta(data, len)
+                             ? ASYNC_EVENT_NAME_UPDATED
+                             : ASYNC_EVENT_NAME_ADDED);
+        if constexpr(id == ASYNC_HANDLER_GO_WORKER)
+        {
+            stamp_async_event(data, len);
         }
     }
     else
@@ -53,7 +67,8 @@ void generate_async_event(const char *json, bool added, bool initial_state)
         enc.set_ts(get_current_time_ns(1));
         enc.set_name(ASYNC_EVENT_NAME_REMOVED);
     }
-    enc.set_data((void *)msg.c_str(), msg.size() + 1);
+    // The payload is copied by the encoder, no need to own it
+    enc.set_data((void *)data, len);
 
     enc.encode(s_async_handler[id]->writer());
     s_async_handler[id]->push();
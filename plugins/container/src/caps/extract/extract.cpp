@@ -1,4 +1,7 @@
 #include <plugin.h>
+#include "container_info_binary.h"
+
+#include <algorithm>
 
 //////////////////////////
 // Extract capability
@@ -29,6 +32,7 @@ enum ContainerFields
     TYPE_CONTAINER_READINESS_PROBE,
     TYPE_CONTAINER_START_TS,
     TYPE_CONTAINER_DURATION,
+    TYPE_CONTAINER_ENRICHMENT_DELAY,
     TYPE_CONTAINER_IP_ADDR,
     TYPE_CONTAINER_CNIRESULT,
     TYPE_CONTAINER_HOST_PID,
@@ -274,6 +278,12 @@ std::vector<falcosecurity::field_info> my_plugin::get_fields()
              "socket / container engine."},
             {ft::FTYPE_RELTIME, "container.duration", "Container Duration",
              "Number of nanoseconds since container.start_ts."},
+            {ft::FTYPE_RELTIME, "container.enrichment_delay",
+             "Container Enrichment Delay",
+             "Number of nanoseconds between the plugin asking the container "
+             "engines for the container, on its first process, and receiving "
+             "its metadata. 0 if the metadata was received before the first "
+             "process, e.g. from the container engine events."},
             {ft::FTYPE_STRING, "container.ip", "Container ip address",
              "The container's / pod's primary ip address as retrieved from the "
              "container engine. Only "
@@ -497,28 +507,72 @@ std::vector<falcosecurity::field_info> my_plugin::get_fields()
     return std::vector<falcosecurity::field_info>(fields, fields + fields_size);
 }
 
-static inline void
-concatenate_container_labels(const std::map<std::string, std::string> &labels,
-                             std::string *s)
+// Sections of the container_info read by the field, see
+// CONTAINER_INFO_SECTION_*
+static uint32_t get_field_sections(int field_id)
 {
-    for(auto const &label_pair : labels)
+    switch(field_id)
     {
-        // exclude annotations and internal labels
-        if(label_pair.first.find("annotation.") == 0 ||
-           label_pair.first.find("io.kubernetes.") == 0)
-        {
-            continue;
-        }
-        if(!s->empty())
-        {
-            s->append(", ");
-        }
-        s->append(label_pair.first);
-        if(!label_pair.second.empty())
+    case TYPE_CONTAINER_MOUNTS:
+    case TYPE_CONTAINER_MOUNT:
+    case TYPE_CONTAINER_MOUNT_SOURCE:
+    case TYPE_CONTAINER_MOUNT_DEST:
+    case TYPE_CONTAINER_MOUNT_MODE:
+    case TYPE_CONTAINER_MOUNT_RDWR:
+    case TYPE_CONTAINER_MOUNT_PROPAGATION:
+        return CONTAINER_INFO_SECTION_MOUNTS;
+    case TYPE_CONTAINER_HEALTHCHECK:
+    case TYPE_CONTAINER_LIVENESS_PROBE:
+    case TYPE_CONTAINER_READINESS_PROBE:
+    case TYPE_IS_CONTAINER_HEALTHCHECK:
+    case TYPE_IS_CONTAINER_LIVENESS_PROBE:
+    case TYPE_IS_CONTAINER_READINESS_PROBE:
+        return CONTAINER_INFO_SECTION_HEALTH_PROBES;
+    case TYPE_CONTAINER_CNIRESULT:
+    case TYPE_K8S_POD_CNIRESULT:
+    // The CNI result tells whether the pod sandbox fields are held by the
+    // container itself or by its pod sandbox container
+    case TYPE_K8S_POD_LABEL:
+    case TYPE_K8S_POD_LABELS:
+    case TYPE_K8S_POD_IP:
+        return CONTAINER_INFO_SECTION_CNI_RESULT;
+    default:
+        // The env and port mappings are only dumped, never extracted
+        return 0;
+    }
+}
+
+uint32_t my_plugin::get_pruned_sections(
+        const std::vector<std::string> &required_fields)
+{
+    if(required_fields.empty())
+    {
+        return 0;
+    }
+    auto fields = get_fields();
+    uint32_t required = 0;
+    for(const auto &name : required_fields)
+    {
+        // Fields can be listed with their argument, e.g. container.label[app]
+        auto base = std::string_view(name).substr(0, name.find('['));
+        auto it = std::find_if(fields.begin(), fields.end(),
+                               [base](const falcosecurity::field_info &f)
+                               { return f.name == base; });
+        if(it == fields.end())
         {
-            s->append(":" + label_pair.second);
+            throw std::runtime_error("unknown required field '" + name + "'");
         }
+        required |= get_field_sections(it - fields.begin());
     }
+    return CONTAINER_INFO_SECTIONS_ALL & ~required;
+}
+
+// Returns the value of the label, nullptr if missing
+static inline const std::string *get_container_label(
+        const container_labels &labels, std::string_view key)
+{
+    auto label = labels.find(key);
+    return label != labels.end() ? &label->second.str() : nullptr;
 }
 
 bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
@@ -529,15 +583,53 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
     const auto field_id = req.get_field_id();
     auto tr = in.get_table_reader();
     bool is_container_async_event = false;
+    if(field_id < m_stats.extract_calls.size())
+    {
+        m_stats.extract_calls[field_id]++;
+    }
 
     std::shared_ptr<const container_info> cinfo;
     // NOTE: empty in case we are extracting from an event generated by us.
     // Not a big deal since cinfo will always be != null in that case.
-    std::string container_id;
+    static const std::string no_container_id;
+    const std::string *container_id = &no_container_id;
     // NOTE: empty in case we are extracting from an event generated by us.
     // This means that any request to extract from it (eg:
     // TYPE_CONTAINER_DURATION) will throw an exception and MUST be managed.
     falcosecurity::table_entry thread_entry;
+    bool has_thread_entry = false;
+    bool is_generated_event = false;
+    // Only fetched again on memo hits by the fields that need it
+    auto get_thread_entry = [&]() -> falcosecurity::table_entry &
+    {
+        if(!has_thread_entry && !is_generated_event)
+        {
+            thread_entry = m_threads_table.get_entry(tr, thread_id);
+            has_thread_entry = true;
+        }
+        return thread_entry;
+    };
+
+    // Since we do write thread category only if not NONE for containerized
+    // processes
+    auto get_category = [&]() -> uint16_t
+    {
+        try
+        {
+            if(m_cfg.lazy_category)
+            {
+                return get_lazy_category(get_thread_entry(), thread_id, tr);
+            }
+            uint16_t category;
+            m_threads_field_category.read_value(tr, get_thread_entry(),
+                                                category);
+            return category;
+        }
+        catch(...)
+        {
+            return CAT_NONE;
+        }
+    };
 
     // If it is an async event, try to understand whether it is a `container`
     // async event
@@ -545,7 +637,8 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
     {
         falcosecurity::events::asyncevent_e_decoder ad(evt_reader);
         is_container_async_event =
-                std::strcmp(ad.get_name(), ASYNC_EVENT_NAME_ADDED) == 0;
+                std::strcmp(ad.get_name(), ASYNC_EVENT_NAME_ADDED) == 0 ||
+                std::strcmp(ad.get_name(), ASYNC_EVENT_NAME_UPDATED) == 0;
     }
     // For events generated by us, use the last container added to fetch info.
     if(evt_reader.get_type() == PPME_CONTAINER_E ||
@@ -557,54 +650,83 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
         // We just generated a container and we are asked to parse from it; use
         // it.
         cinfo = m_last_container;
+        is_generated_event = true;
     }
     else
     {
-        try
+        auto &memo = m_extract_memo;
+        const auto evtnum = evt_reader.get_num();
+        if(memo.evtnum != evtnum || memo.tid != thread_id)
         {
-            // retrieve the thread entry associated with this thread id
-            thread_entry = m_threads_table.get_entry(tr, thread_id);
-            // retrieve container_id from the entry
-            m_container_id_field.read_value(tr, thread_entry, container_id);
-        }
-        catch(const std::exception &e)
-        {
-            // Debug here since many events do not have thread id info (eg:
-            // schedswitch)
-            m_logger.log(
-                    fmt::format(
-                            "cannot extract the container_id for the thread id "
-                            "'{}': {}",
-                            thread_id, e.what()),
-                    falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
-            return false;
-        }
+            memo.evtnum = evtnum;
+            memo.tid = thread_id;
+            memo.resolved = false;
+            memo.container_id.clear();
+            memo.cinfo.reset();
+            try
+            {
+                // retrieve the thread entry associated with this thread id
+                get_thread_entry();
+                // retrieve container_id from the entry
+                m_container_id_field.read_value(tr, thread_entry,
+                                                memo.container_id);
+                memo.resolved = true;
+            }
+            catch(const std::exception &e)
+            {
+                // Debug here since many events do not have thread id info (eg:
+                // schedswitch)
+                m_logger.log(
+                        fmt::format("cannot extract the container_id for the "
+                                    "thread id '{}': {}",
+                                    thread_id, e.what()),
+                        falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
+            }
 
-        // Try to find the entry associated with the container_id
-        auto it = m_containers.find(container_id);
-        if(it == m_containers.end())
-        {
-            m_logger.log(
-                    fmt::format(
-                            "the plugin has no info for the container id '{}'",
-                            container_id),
-                    falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
-            if(field_id != TYPE_CONTAINER_ID &&
-               field_id != TYPE_CONTAINER_START_TS &&
-               field_id != TYPE_CONTAINER_DURATION &&
-               field_id != TYPE_IS_CONTAINER_HEALTHCHECK &&
-               field_id != TYPE_IS_CONTAINER_LIVENESS_PROBE &&
-               field_id != TYPE_IS_CONTAINER_READINESS_PROBE)
+            // Try to find the entry associated with the container_id
+            if(memo.resolved)
             {
-                // Can't return anything but those fields without containers
-                // metadata.
-                return true; // go on to extract other fields if needed, perhaps
-                             // they'll be one of the above
+                auto found = m_containers.find(memo.container_id);
+                if(found == nullptr)
+                {
+                    m_stats.container_lookup_misses++;
+                    m_logger.log(fmt::format("the plugin has no info for the "
+                                             "container id '{}'",
+                                             memo.container_id),
+                                 falcosecurity::_internal::
+                                         SS_PLUGIN_LOG_SEV_DEBUG);
+#ifdef _HAS_ASYNC
+                    // A rule is evaluating the events of the container
+                    if(!memo.container_id.empty())
+                    {
+                        ask_container_info(memo.container_id, true);
+                    }
+#endif
+                }
+                else
+                {
+                    memo.cinfo = *found;
+                }
             }
         }
-        else
+
+        if(!memo.resolved)
+        {
+            return false;
+        }
+        container_id = &memo.container_id;
+        cinfo = memo.cinfo;
+        if(cinfo == nullptr && field_id != TYPE_CONTAINER_ID &&
+           field_id != TYPE_CONTAINER_START_TS &&
+           field_id != TYPE_CONTAINER_DURATION &&
+           field_id != TYPE_IS_CONTAINER_HEALTHCHECK &&
+           field_id != TYPE_IS_CONTAINER_LIVENESS_PROBE &&
+           field_id != TYPE_IS_CONTAINER_READINESS_PROBE)
         {
-            cinfo = it->second;
+            // Can't return anything but those fields without containers
+            // metadata.
+            return true; // go on to extract other fields if needed, perhaps
+                         // they'll be one of the above
         }
     }
 
@@ -618,7 +740,7 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
         else
         {
             // We don't have container metadatas but we are in a container.
-            req.set_value(container_id);
+            req.set_value(*container_id);
         }
         break;
     case TYPE_CONTAINER_FULL_CONTAINER_ID:
@@ -628,10 +750,10 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
         req.set_value(cinfo->m_name);
         break;
     case TYPE_CONTAINER_IMAGE:
-        req.set_value(cinfo->m_image);
+        req.set_value(cinfo->m_image.str());
         break;
     case TYPE_CONTAINER_IMAGE_ID:
-        req.set_value(cinfo->m_imageid);
+        req.set_value(cinfo->m_imageid.str());
         break;
     case TYPE_CONTAINER_TYPE:
         req.set_value(to_string(cinfo->m_type));
@@ -640,24 +762,8 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
         req.set_value(cinfo->m_privileged);
         break;
     case TYPE_CONTAINER_MOUNTS:
-    {
-        std::string tstr;
-        bool first = true;
-        for(auto &mntinfo : cinfo->m_mounts)
-        {
-            if(first)
-            {
-                first = false;
-            }
-            else
-            {
-                tstr += ",";
-            }
-            tstr += mntinfo.to_string();
-        }
-        req.set_value(tstr);
+        req.set_value(cinfo->get_mounts_string());
         break;
-    }
     case TYPE_CONTAINER_MOUNT:
     case TYPE_CONTAINER_MOUNT_SOURCE:
     case TYPE_CONTAINER_MOUNT_DEST:
@@ -673,16 +779,22 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
         }
         else
         {
-            auto arg_key = req.get_arg_key();
+            // The argument is fixed for a given field of a rule, compile it
+            // once
+            auto &pattern = m_mount_patterns[req.get_arg_key()];
+            if(!pattern)
+            {
+                pattern = std::make_unique<mount_pattern>(req.get_arg_key());
+            }
             // See
             // https://github.com/falcosecurity/libs/blob/d87c96b50545bb192fa2a517afce76383877cab5/userspace/libsinsp/sinsp_filtercheck_container.cpp#L617
             if(field_id == TYPE_CONTAINER_MOUNT_SOURCE)
             {
-                mntinfo = cinfo->mount_by_dest(arg_key);
+                mntinfo = cinfo->mount_by_dest(*pattern);
             }
             else
             {
-                mntinfo = cinfo->mount_by_source(arg_key);
+                mntinfo = cinfo->mount_by_source(*pattern);
             }
         }
         if(mntinfo)
@@ -714,13 +826,13 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
         break;
     }
     case TYPE_CONTAINER_IMAGE_REPOSITORY:
-        req.set_value(cinfo->m_imagerepo);
+        req.set_value(cinfo->m_imagerepo.str());
         break;
     case TYPE_CONTAINER_IMAGE_TAG:
-        req.set_value(cinfo->m_imagetag);
+        req.set_value(cinfo->m_imagetag.str());
         break;
     case TYPE_CONTAINER_IMAGE_DIGEST:
-        req.set_value(cinfo->m_imagedigest);
+        req.set_value(cinfo->m_imagedigest.str());
         break;
     case TYPE_CONTAINER_HEALTHCHECK:
     case TYPE_CONTAINER_LIVENESS_PROBE:
@@ -761,8 +873,8 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
         uint64_t pidns_init_start_ts;
         try
         {
-            m_threads_field_pidns_init_start_ts.read_value(tr, thread_entry,
-                                                           pidns_init_start_ts);
+            m_threads_field_pidns_init_start_ts.read_value(
+                    tr, get_thread_entry(), pidns_init_start_ts);
         }
         catch(...)
         {
@@ -781,6 +893,9 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
         }
         break;
     }
+    case TYPE_CONTAINER_ENRICHMENT_DELAY:
+        req.set_value(cinfo->m_enrichment_delay_ns);
+        break;
     case TYPE_CONTAINER_IP_ADDR:
         req.set_value(cinfo->m_container_ip);
         break;
@@ -798,39 +913,47 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
         break;
     case TYPE_CONTAINER_LABEL:
     {
-        auto arg_key = req.get_arg_key();
-        if(cinfo->m_labels.count(arg_key) > 0)
+        auto label = get_container_label(cinfo->m_labels, req.get_arg_key());
+        if(label)
         {
-            req.set_value(cinfo->m_labels.at(arg_key));
+            req.set_value(*label);
         }
         break;
     }
     case TYPE_CONTAINER_LABELS:
-    {
-        std::string labels;
-        concatenate_container_labels(cinfo->m_labels, &labels);
-        req.set_value(labels);
+        req.set_value(cinfo->get_labels_string());
         break;
-    }
     case TYPE_K8S_POD_NAME:
-        if(cinfo->m_labels.count("io.kubernetes.pod.name") > 0)
+    {
+        auto label =
+                get_container_label(cinfo->m_labels, "io.kubernetes.pod.name");
+        if(label)
         {
-            req.set_value(cinfo->m_labels.at("io.kubernetes.pod.name"));
+            req.set_value(*label);
         }
         break;
+    }
     case TYPE_K8S_NS_NAME:
-        if(cinfo->m_labels.count("io.kubernetes.pod.namespace") > 0)
+    {
+        auto label =
+                get_container_label(cinfo->m_labels, "io.kubernetes.pod.namespace");
+        if(label)
         {
-            req.set_value(cinfo->m_labels.at("io.kubernetes.pod.namespace"));
+            req.set_value(*label);
         }
         break;
+    }
     case TYPE_K8S_POD_ID:
     case TYPE_K8S_POD_UID:
-        if(cinfo->m_labels.count("io.kubernetes.pod.uid") > 0)
+    {
+        auto label =
+                get_container_label(cinfo->m_labels, "io.kubernetes.pod.uid");
+        if(label)
         {
-            req.set_value(cinfo->m_labels.at("io.kubernetes.pod.uid"));
+            req.set_value(*label);
         }
         break;
+    }
     case TYPE_K8S_POD_SANDBOX_ID:
     case TYPE_K8S_POD_FULL_SANDBOX_ID:
     {
@@ -853,50 +976,47 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
         {
             // Fallback: Retrieve PodSandboxStatusResponse fields stored in
             // explicit pod sandbox container
-            auto sandbox_id = cinfo->m_pod_sandbox_id.substr(0, SHORT_ID_LEN);
-            if(m_containers.count(sandbox_id) > 0)
-            {
-                sandbox_container_info = m_containers[sandbox_id];
-            }
+            sandbox_container_info = cinfo->m_pod_sandbox.lock();
         }
         if(field_id == TYPE_K8S_POD_LABEL)
         {
             auto arg_key = req.get_arg_key();
-            if(sandbox_container_info &&
-               sandbox_container_info->m_pod_sandbox_labels.count(arg_key) > 0)
+            const std::string *label = nullptr;
+            if(sandbox_container_info)
+            {
+                label = get_container_label(
+                        sandbox_container_info->m_pod_sandbox_labels, arg_key);
+            }
+            if(!label)
             {
-                req.set_value(sandbox_container_info->m_pod_sandbox_labels.at(
-                        arg_key));
+                label = get_container_label(cinfo->m_pod_sandbox_labels,
+                                            arg_key);
             }
-            else if(cinfo->m_pod_sandbox_labels.count(arg_key) > 0)
+            if(label)
             {
-                req.set_value(cinfo->m_pod_sandbox_labels.at(arg_key));
+                req.set_value(*label);
             }
         }
         else
         {
-            std::string labels;
             if(sandbox_container_info)
             {
-                concatenate_container_labels(
-                        sandbox_container_info->m_pod_sandbox_labels, &labels);
+                req.set_value(
+                        sandbox_container_info->get_pod_sandbox_labels_string());
             }
             else
             {
-                concatenate_container_labels(cinfo->m_pod_sandbox_labels,
-                                             &labels);
+                req.set_value(cinfo->get_pod_sandbox_labels_string());
             }
-            req.set_value(labels);
         }
         break;
     }
     case TYPE_K8S_POD_IP:
         if(cinfo->m_pod_sandbox_cniresult.empty())
         {
-            auto sandbox_id = cinfo->m_pod_sandbox_id.substr(0, SHORT_ID_LEN);
-            if(m_containers.count(sandbox_id) > 0)
+            auto sandbox_container_info = cinfo->m_pod_sandbox.lock();
+            if(sandbox_container_info)
             {
-                auto &sandbox_container_info = m_containers[sandbox_id];
                 req.set_value(sandbox_container_info->m_container_ip);
             }
         }
@@ -908,10 +1028,9 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
     case TYPE_K8S_POD_CNIRESULT:
         if(cinfo->m_pod_sandbox_cniresult.empty())
         {
-            auto sandbox_id = cinfo->m_pod_sandbox_id.substr(0, SHORT_ID_LEN);
-            if(m_containers.count(sandbox_id) > 0)
+            auto sandbox_container_info = cinfo->m_pod_sandbox.lock();
+            if(sandbox_container_info)
             {
-                auto &sandbox_container_info = m_containers[sandbox_id];
                 req.set_value(sandbox_container_info->m_pod_sandbox_cniresult);
             }
         }
@@ -921,53 +1040,14 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
         }
         break;
     case TYPE_IS_CONTAINER_HEALTHCHECK:
-    {
-        int16_t category;
-        // Since we do write thread category only if not NONE for containerized
-        // processes
-        try
-        {
-            m_threads_field_category.read_value(tr, thread_entry, category);
-        }
-        catch(...)
-        {
-            category = CAT_NONE;
-        }
-        req.set_value(category == CAT_HEALTHCHECK);
+        req.set_value(get_category() == CAT_HEALTHCHECK);
         break;
-    }
     case TYPE_IS_CONTAINER_LIVENESS_PROBE:
-    {
-        int16_t category;
-        // Since we do write thread category only if not NONE for containerized
-        // processes
-        try
-        {
-            m_threads_field_category.read_value(tr, thread_entry, category);
-        }
-        catch(...)
-        {
-            category = CAT_NONE;
-        }
-        req.set_value(category == CAT_LIVENESS_PROBE);
+        req.set_value(get_category() == CAT_LIVENESS_PROBE);
         break;
-    }
     case TYPE_IS_CONTAINER_READINESS_PROBE:
-    {
-        int16_t category;
-        // Since we do write thread category only if not NONE for containerized
-        // processes
-        try
-        {
-            m_threads_field_category.read_value(tr, thread_entry, category);
-        }
-        catch(...)
-        {
-            category = CAT_NONE;
-        }
-        req.set_value(category == CAT_READINESS_PROBE);
+        req.set_value(get_category() == CAT_READINESS_PROBE);
         break;
-    }
     case TYPE_K8S_RC_NAME:
     case TYPE_K8S_RC_ID:
     case TYPE_K8S_RC_LABEL:
@@ -992,7 +1072,7 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input &in)
     default:
         m_logger.log(fmt::format("unknown extraction request on field '{}' for "
                                  "container_id '{}'",
-                                 req.get_field_id(), container_id),
+                                 req.get_field_id(), *container_id),
                      falcosecurity::_internal::SS_PLUGIN_LOG_SEV_ERROR);
         return false;
     }
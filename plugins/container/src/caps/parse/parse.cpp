@@ -1,38 +1,17 @@
 #include "plugin.h"
 #include "container_info_json.h"
+#include "container_info_binary.h"
+
+#include <plugin_toolkit/event_params.h>
+
+#ifdef _HAS_ASYNC
+#include "caps/async/async.tpp"
+#endif
 
 //////////////////////////
 // Parse capability
 //////////////////////////
 
-struct sinsp_param
-{
-    uint32_t param_len;
-    uint8_t* param_pointer;
-};
-
-// Obtain a param from a sinsp event
-template<const bool LargePayload = false,
-         typename T = std::conditional_t<LargePayload, uint32_t*, uint16_t*>>
-static inline sinsp_param get_syscall_evt_param(void* evt, uint32_t num_param)
-{
-    uint32_t dataoffset = 0;
-    // pointer to the lengths array inside the event.
-    auto len = (T)((uint8_t*)evt +
-                   sizeof(falcosecurity::_internal::ss_plugin_event));
-    for(uint32_t j = 0; j < num_param; j++)
-    {
-        // sum lengths of the previous params.
-        dataoffset += len[j];
-    }
-    return {.param_len = len[num_param],
-            .param_pointer =
-                    ((uint8_t*)&len
-                             [((falcosecurity::_internal::ss_plugin_event*)evt)
-                                      ->nparams]) +
-                    dataoffset};
-}
-
 // We need to parse only the async events produced by this plugin. The async
 // events produced by this plugin are injected in the syscall event source,
 // so here we need to parse events coming from the "syscall" source.
@@ -54,7 +33,8 @@ bool my_plugin::parse_async_event(const falcosecurity::parse_event_input& in)
     falcosecurity::events::asyncevent_e_decoder ad(evt);
     bool added = std::strcmp(ad.get_name(), ASYNC_EVENT_NAME_ADDED) == 0;
     bool removed = std::strcmp(ad.get_name(), ASYNC_EVENT_NAME_REMOVED) == 0;
-    if(!added && !removed)
+    bool updated = std::strcmp(ad.get_name(), ASYNC_EVENT_NAME_UPDATED) == 0;
+    if(!added && !removed && !updated)
     {
         // We are not interested in parsing async events that are not
         // generated by our plugin.
@@ -63,30 +43,122 @@ bool my_plugin::parse_async_event(const falcosecurity::parse_event_input& in)
         return true;
     }
 
-    uint32_t json_charbuf_len = 0;
-    char* json_charbuf_pointer = (char*)ad.get_data(json_charbuf_len);
-    if(json_charbuf_pointer == nullptr)
+    latency_timer timer(m_stats.parse_async_event);
+    uint32_t payload_len = 0;
+    char* payload = (char*)ad.get_data(payload_len);
+    if(payload == nullptr)
     {
         m_lasterr = "there is no payload in the async event";
         m_logger.log(m_lasterr,
                      falcosecurity::_internal::SS_PLUGIN_LOG_SEV_ERROR);
         return false;
     }
-    auto json_event = nlohmann::json::parse(json_charbuf_pointer);
-    auto cinfo = json_event.get<container_info::ptr_t>();
-    if(added)
+    m_stats.async_payload_bytes += payload_len;
+
+    container_info::ptr_t cinfo;
+    // Whether `cinfo` was decoded from the payload rather than cached
+    bool decoded = true;
+    // When the go-worker queued the event, 0 if unknown
+    uint64_t queued_ts = 0;
+    try
     {
-        m_logger.log(fmt::format("Adding container: {}", cinfo->m_id),
+        if(container_info_view::is_binary(payload, payload_len))
+        {
+            container_info_view view(payload, payload_len);
+#ifdef _HAS_ASYNC
+            if(!removed)
+            {
+                queued_ts = s_async_stamps.take(std::string(view.get_id()));
+            }
+#endif
+            // Removed containers and pre-existing ones, already merged back
+            // to our cache by `start_async_events`, need no decoding.
+            auto found = m_containers.find(view.get_id());
+            if(view.is_delta())
+            {
+                // Updates are applied copy-on-write, cached container_info
+                // instances are immutable
+                if(found == nullptr)
+                {
+                    // The go-worker only sends deltas of the containers it
+                    // sent already, eg: we evicted it meanwhile. The fetcher
+                    // answers with a full payload.
+                    m_logger.log(
+                            fmt::format("Skipping update of unknown "
+                                        "container: {}, asking for it",
+                                        view.get_id()),
+                            falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
+#ifdef _HAS_ASYNC
+                    ask_container_info(std::string(view.get_id()), true);
+#endif
+                    return true;
+                }
+                cinfo = view.apply_to(**found, m_cfg.pruned_sections);
+            }
+            else if(found != nullptr &&
+               (removed ||
+                view.get_flags() & CONTAINER_INFO_BINARY_FLAG_INITIAL_STATE))
+            {
+                cinfo = *found;
+                decoded = false;
+            }
+            else
+            {
+                cinfo = view.to_container_info(m_cfg.pruned_sections);
+            }
+        }
+        else
+        {
+            // Captures taken by older plugin versions carry JSON payloads
+            auto json_event = nlohmann::json::parse(payload);
+            cinfo = json_event.get<container_info::ptr_t>();
+            prune_container_info(*cinfo, m_cfg.pruned_sections);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        m_lasterr = fmt::format("cannot decode the async event payload: {}",
+                                e.what());
+        m_logger.log(m_lasterr,
+                     falcosecurity::_internal::SS_PLUGIN_LOG_SEV_ERROR);
+        return false;
+    }
+    if(added || updated)
+    {
+        m_logger.log(fmt::format("{} container: {}",
+                                 added ? "Adding" : "Updating", cinfo->m_id),
                      falcosecurity::_internal::SS_PLUGIN_LOG_SEV_TRACE);
-        m_containers[cinfo->m_id] = cinfo;
+        auto now = monotonic_ns();
+        auto queued = queued_ts != 0 && queued_ts <= now ? now - queued_ts : 0;
+        if(queued_ts != 0)
+        {
+            m_stats.async_event_queue.record(queued);
+        }
+        auto elapsed = m_container_requests.on_resolved(cinfo->m_id, now);
+        if(elapsed != 0)
+        {
+            m_stats.container_request.record(elapsed);
+            if(queued_ts != 0 && queued <= elapsed)
+            {
+                m_stats.container_fetch.record(elapsed - queued);
+            }
+            // Before the container is cached, cached ones are immutable
+            if(decoded)
+            {
+                cinfo->m_enrichment_delay_ns = elapsed;
+            }
+        }
+        m_containers.set(cinfo->m_id, cinfo);
+        link_pod_sandbox(cinfo);
         m_last_container = cinfo;
-        m_asked_containers.erase(cinfo->m_id);
+        evict_containers(in.get_table_reader());
     }
     else
     {
         m_logger.log(fmt::format("Removing container: {}", cinfo->m_id),
                      falcosecurity::_internal::SS_PLUGIN_LOG_SEV_TRACE);
         m_containers.erase(cinfo->m_id);
+        m_mgr->forget_container(cinfo->m_id);
     }
 
     // Update n_containers metric
@@ -101,14 +173,52 @@ bool my_plugin::parse_async_event(const falcosecurity::parse_event_input& in)
     return true;
 }
 
+// Pod containers refer to their sandbox by its full id, while the containers
+// table is indexed by short ids. Sandboxes are usually added before the
+// containers of their pod, but not necessarily, so link both ways.
+void my_plugin::link_pod_sandbox(
+        const std::shared_ptr<const container_info>& cinfo)
+{
+    if(cinfo->m_is_pod_sandbox)
+    {
+        for(const auto& c : m_containers)
+        {
+            if(c.second != cinfo && !c.second->m_pod_sandbox_id.empty() &&
+               std::string_view(c.second->m_pod_sandbox_id)
+                               .substr(0, SHORT_ID_LEN) == cinfo->m_id)
+            {
+                c.second->m_pod_sandbox = cinfo;
+            }
+        }
+    }
+    else if(!cinfo->m_pod_sandbox_id.empty())
+    {
+        auto sandbox_id = std::string_view(cinfo->m_pod_sandbox_id)
+                                  .substr(0, SHORT_ID_LEN);
+        auto found = m_containers.find(sandbox_id);
+        if(found != nullptr)
+        {
+            cinfo->m_pod_sandbox = *found;
+        }
+    }
+}
+
 bool my_plugin::parse_container_event(
         const falcosecurity::parse_event_input& in)
 {
     auto& evt = in.get_event_reader();
-    auto id_param = get_syscall_evt_param(evt.get_buf(), 0);
-    auto type_param = get_syscall_evt_param(evt.get_buf(), 1);
-    auto name_param = get_syscall_evt_param(evt.get_buf(), 2);
-    auto image_param = get_syscall_evt_param(evt.get_buf(), 3);
+    event_params<> params(evt.get_buf());
+    auto id_param = params.get(0);
+    auto type_param = params.get(1);
+    auto name_param = params.get(2);
+    auto image_param = params.get(3);
+    if(id_param.param_pointer == nullptr ||
+       type_param.param_pointer == nullptr ||
+       name_param.param_pointer == nullptr ||
+       image_param.param_pointer == nullptr)
+    {
+        return false;
+    }
 
     std::string id = (char*)id_param.param_pointer;
     container_type tp = *((container_type*)type_param.param_pointer);
@@ -123,7 +233,7 @@ bool my_plugin::parse_container_event(
     m_logger.log(fmt::format("Adding container from old container event: {}",
                              cinfo->m_id),
                  falcosecurity::_internal::SS_PLUGIN_LOG_SEV_TRACE);
-    m_containers[id] = cinfo;
+    m_containers.set(id, cinfo);
     m_last_container = cinfo;
     return true;
 }
@@ -133,6 +243,10 @@ bool my_plugin::parse_container_json_event(
 {
     auto& evt = in.get_event_reader();
     auto json_param = get_syscall_evt_param(evt.get_buf(), 0);
+    if(json_param.param_pointer == nullptr)
+    {
+        return false;
+    }
 
     std::string json_str = (char*)json_param.param_pointer;
     auto json_event = nlohmann::json::parse(json_str);
@@ -142,7 +256,8 @@ bool my_plugin::parse_container_json_event(
             fmt::format("Adding container from old container_json event: {}",
                         cinfo->m_id),
             falcosecurity::_internal::SS_PLUGIN_LOG_SEV_TRACE);
-    m_containers[cinfo->m_id] = cinfo;
+    m_containers.set(cinfo->m_id, cinfo);
+    link_pod_sandbox(cinfo);
     m_last_container = cinfo;
     return true;
 }
@@ -152,6 +267,10 @@ bool my_plugin::parse_container_json_2_event(
 {
     auto& evt = in.get_event_reader();
     auto json_param = get_syscall_evt_param<true>(evt.get_buf(), 0);
+    if(json_param.param_pointer == nullptr)
+    {
+        return false;
+    }
 
     std::string json_str = (char*)json_param.param_pointer;
     auto json_event = nlohmann::json::parse(json_str);
@@ -161,7 +280,8 @@ bool my_plugin::parse_container_json_2_event(
             fmt::format("Adding container from old container_json_2 event: {}",
                         cinfo->m_id),
             falcosecurity::_internal::SS_PLUGIN_LOG_SEV_TRACE);
-    m_containers[cinfo->m_id] = cinfo;
+    m_containers.set(cinfo->m_id, cinfo);
+    link_pod_sandbox(cinfo);
     m_last_container = cinfo;
     return true;
 }
@@ -172,6 +292,7 @@ bool my_plugin::parse_exit_process_event(
     // get tid
     auto thread_id = in.get_event_reader().get_tid();
     auto& tr = in.get_table_reader();
+    m_lazy_categories.erase(thread_id);
 
     // retrieve the thread entry associated with this thread id,
     // check if vpid is 1, so if this is an init process,
@@ -193,6 +314,7 @@ bool my_plugin::parse_exit_process_event(
                                          container_id),
                              falcosecurity::_internal::SS_PLUGIN_LOG_SEV_TRACE);
                 m_containers.erase(container_id);
+                m_mgr->forget_container(container_id);
             }
         }
         return true;
@@ -222,18 +344,43 @@ bool my_plugin::parse_new_process_event(
     // - For clone/fork/vfork/clone3 we exclude failed syscall events (ret<0)
     // res is first param
     auto res_param = get_syscall_evt_param(in.get_event_reader().get_buf(), 0);
+    if(res_param.param_pointer == nullptr ||
+       res_param.param_len < sizeof(int64_t))
+    {
+        return false;
+    }
     int64_t ret = 0;
     memcpy(&ret, res_param.param_pointer, sizeof(ret));
     if(ret < 0)
     {
         return false;
     }
+    // The category is recomputed on the next extraction, as it would be
+    // written now otherwise
+    m_lazy_categories.erase(thread_id);
 
     // retrieve the thread entry associated with this thread id
     try
     {
         auto thread_entry = m_threads_table.get_entry(tr, thread_id);
-        on_new_process(thread_entry, tr, tw);
+        // The child of a clone is usually in the container of its parent,
+        // the full matching only runs if it is not.
+        bool is_clone_child = ret == 0;
+        switch(in.get_event_reader().get_type())
+        {
+        case PPME_SYSCALL_CLONE_20_X:
+        case PPME_SYSCALL_FORK_20_X:
+        case PPME_SYSCALL_VFORK_20_X:
+        case PPME_SYSCALL_CLONE3_X:
+            break;
+        default:
+            is_clone_child = false;
+            break;
+        }
+        if(!is_clone_child || !inherit_parent_container(thread_entry, tr, tw))
+        {
+            on_new_process(thread_entry, tr, tw);
+        }
         return true;
     }
     catch(const std::exception& e)
@@ -252,6 +399,17 @@ bool my_plugin::parse_event(const falcosecurity::parse_event_input& in)
     // NOTE: today in the libs framework, parsing errors are not logged
     auto& evt = in.get_event_reader();
 
+    if(m_warm_cache != nullptr && m_cfg.warm_cache.interval_s > 0)
+    {
+        auto now = monotonic_ns();
+        if(now >= m_warm_cache_next_ns)
+        {
+            m_warm_cache_next_ns =
+                    now + m_cfg.warm_cache.interval_s * 1000000000ULL;
+            snapshot_warm_cache();
+        }
+    }
+
     switch(evt.get_type())
     {
     case PPME_ASYNCEVENT_E:
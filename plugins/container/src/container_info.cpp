@@ -18,8 +18,8 @@ limitations under the License.
 
 #include <utility>
 #include <algorithm>
-#include <reflex/matcher.h>
 #include "container_info.h"
+#include "mount_pattern.h"
 
 std::vector<std::string> container_health_probe::probe_type_names = {
         "None", "Healthcheck", "LivenessProbe", "ReadinessProbe"};
@@ -46,32 +46,71 @@ const container_mount_info *container_info::mount_by_idx(uint32_t idx) const
 }
 
 const container_mount_info *
-container_info::mount_by_source(const std::string &source) const
+container_info::find_mount(const mount_pattern &pattern, bool by_source) const
 {
-    // note: linear search
-    // enable multiline matching to match "^..."
-    reflex::Pattern pattern(source, "(?m)");
-    for(auto &mntinfo : m_mounts)
+    auto path = [by_source](const container_mount_info &m)
+            -> const std::string &
+    { return by_source ? m.m_source : m.m_dest; };
+
+    auto kind = pattern.get_kind();
+    if((kind == mount_pattern::MP_PREFIX || kind == mount_pattern::MP_EQUAL) &&
+       !pattern.has_wildcards())
     {
-        reflex::Matcher matcher(pattern, mntinfo.m_source.c_str());
-        if(matcher.find())
+        auto &lazy_index = by_source ? m_mounts_by_source : m_mounts_by_dest;
+        const auto &index = lazy_index.get(
+                [&]()
+                {
+                    std::vector<uint32_t> idx;
+                    for(uint32_t i = 0; i < m_mounts.size(); i++)
+                    {
+                        // Anchors also match around new lines, no index
+                        if(path(m_mounts[i]).find('\n') != std::string::npos)
+                        {
+                            return std::vector<uint32_t>();
+                        }
+                        idx.push_back(i);
+                    }
+                    std::stable_sort(idx.begin(), idx.end(),
+                                     [&](uint32_t a, uint32_t b)
+                                     {
+                                         return path(m_mounts[a]) <
+                                                path(m_mounts[b]);
+                                     });
+                    return idx;
+                });
+
+        if(index.size() == m_mounts.size())
         {
-            return &mntinfo;
+            // Paths starting with the literal follow the first one not less
+            // than it, the first mount among them wins as with a linear
+            // search
+            const auto &literal = pattern.get_literal();
+            auto it = std::lower_bound(index.begin(), index.end(), literal,
+                                       [&](uint32_t i, const std::string &l)
+                                       { return path(m_mounts[i]) < l; });
+            const container_mount_info *found = nullptr;
+            for(; it != index.end(); ++it)
+            {
+                const auto &p = path(m_mounts[*it]);
+                if(p.compare(0, literal.size(), literal) != 0 ||
+                   (kind == mount_pattern::MP_EQUAL &&
+                    p.size() != literal.size()))
+                {
+                    break;
+                }
+                if(found == nullptr || &m_mounts[*it] < found)
+                {
+                    found = &m_mounts[*it];
+                }
+            }
+            return found;
         }
     }
-    return NULL;
-}
 
-const container_mount_info *
-container_info::mount_by_dest(const std::string &dest) const
-{
     // note: linear search
-    // enable multiline matching to match "^..."
-    reflex::Pattern pattern(dest, "(?m)");
     for(auto &mntinfo : m_mounts)
     {
-        reflex::Matcher matcher(pattern, mntinfo.m_dest.c_str());
-        if(matcher.find())
+        if(pattern.match(path(mntinfo)))
         {
             return &mntinfo;
         }
@@ -79,6 +118,30 @@ container_info::mount_by_dest(const std::string &dest) const
     return NULL;
 }
 
+const container_mount_info *
+container_info::mount_by_source(const mount_pattern &source) const
+{
+    return find_mount(source, true);
+}
+
+const container_mount_info *
+container_info::mount_by_dest(const mount_pattern &dest) const
+{
+    return find_mount(dest, false);
+}
+
+const container_mount_info *
+container_info::mount_by_source(const std::string &source) const
+{
+    return find_mount(mount_pattern(source), true);
+}
+
+const container_mount_info *
+container_info::mount_by_dest(const std::string &dest) const
+{
+    return find_mount(mount_pattern(dest), false);
+}
+
 container_health_probe::probe_type
 container_info::match_health_probe(const std::string &exe,
                                    const std::vector<std::string> &args) const
@@ -96,4 +159,123 @@ container_info::match_health_probe(const std::string &exe,
     }
 
     return match->m_type;
-}
\ No newline at end of file
+}
+
+const std::string &container_info::get_mounts_string() const
+{
+    return m_mounts_string.get(
+            [this]()
+            {
+                std::string tstr;
+                for(auto &mntinfo : m_mounts)
+                {
+                    if(!tstr.empty())
+                    {
+                        tstr += ",";
+                    }
+                    tstr += mntinfo.to_string();
+                }
+                return tstr;
+            });
+}
+
+static std::string concatenate_container_labels(const container_labels &labels)
+{
+    std::string s;
+    for(auto const &label_pair : labels)
+    {
+        const std::string &key = label_pair.first;
+        const std::string &value = label_pair.second;
+        // exclude annotations and internal labels
+        if(key.find("annotation.") == 0 || key.find("io.kubernetes.") == 0)
+        {
+            continue;
+        }
+        if(!s.empty())
+        {
+            s.append(", ");
+        }
+        s.append(key);
+        if(!value.empty())
+        {
+            s.push_back(':');
+            s.append(value);
+        }
+    }
+    return s;
+}
+
+const std::string &container_info::get_labels_string() const
+{
+    return m_labels_string.get(
+            [this]() { return concatenate_container_labels(m_labels); });
+}
+
+const std::string &container_info::get_pod_sandbox_labels_string() const
+{
+    return m_pod_sandbox_labels_string.get(
+            [this]()
+            { return concatenate_container_labels(m_pod_sandbox_labels); });
+}
+
+bool container_info::may_match_health_probe(uint64_t hash) const
+{
+    const auto &hashes = m_health_probe_hashes.get(
+            [this]()
+            {
+                std::vector<uint64_t> h;
+                for(const auto &probe : m_health_probes)
+                {
+                    health_probe_hasher hasher(probe.m_exe);
+                    for(const auto &arg : probe.m_args)
+                    {
+                        hasher.add_arg(arg);
+                    }
+                    h.push_back(hasher.value());
+                }
+                return h;
+            });
+    return std::find(hashes.begin(), hashes.end(), hash) != hashes.end();
+}
+
+// Heap bytes of a string, none when held by the small string buffer
+static size_t string_memory(const std::string &s)
+{
+    auto begin = (const char *)&s;
+    if(s.data() >= begin && s.data() < begin + sizeof(s))
+    {
+        return 0;
+    }
+    return s.capacity() + 1;
+}
+
+size_t container_info::memory_usage() const
+{
+    size_t n = sizeof(*this);
+    for(const auto *s : {&m_id, &m_full_id, &m_name, &m_container_ip,
+                         &m_pod_sandbox_id, &m_pod_sandbox_cniresult})
+    {
+        n += string_memory(*s);
+    }
+    n += m_mounts.capacity() * sizeof(container_mount_info);
+    for(const auto &mount : m_mounts)
+    {
+        n += string_memory(mount.m_source) + string_memory(mount.m_dest) +
+             string_memory(mount.m_mode) + string_memory(mount.m_propagation);
+    }
+    n += m_port_mappings.capacity() * sizeof(container_port_mapping);
+    n += (m_labels.size() + m_pod_sandbox_labels.size()) *
+         sizeof(container_labels::value_type);
+    n += m_env.capacity() * sizeof(interned_string);
+    for(const auto &probe : m_health_probes)
+    {
+        // List node pointers
+        n += sizeof(probe) + 2 * sizeof(void *) + string_memory(probe.m_exe) +
+             probe.m_args.capacity() * sizeof(std::string);
+        for(const auto &arg : probe.m_args)
+        {
+            n += string_memory(arg);
+        }
+    }
+    return n;
+}
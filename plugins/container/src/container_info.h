@@ -1,16 +1,24 @@
 #pragma once
 
 #include "container_type.h"
+#include <plugin_toolkit/string_pool.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
-#include <map>
+#include <initializer_list>
 #include <memory>
 #include <list>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #define HOST_CONTAINER_ID "host"
 
+class mount_pattern;
+
 class container_port_mapping
 {
     public:
@@ -52,6 +60,138 @@ class container_mount_info
     std::string m_propagation;
 };
 
+// Container labels, as a flat vector of interned pairs sorted by key: label
+// sets are small and only ever looked up, a binary search on contiguous
+// memory beats walking a std::map.
+class container_labels
+{
+    public:
+    using value_type = std::pair<interned_string, interned_string>;
+    using const_iterator = std::vector<value_type>::const_iterator;
+
+    container_labels() = default;
+    container_labels(
+            std::initializer_list<std::pair<std::string_view, std::string_view>>
+                    labels)
+    {
+        m_labels.reserve(labels.size());
+        for(const auto& label : labels)
+        {
+            emplace(label.first, label.second);
+        }
+    }
+
+    const_iterator begin() const { return m_labels.begin(); }
+    const_iterator end() const { return m_labels.end(); }
+    size_t size() const { return m_labels.size(); }
+    bool empty() const { return m_labels.empty(); }
+    void reserve(size_t n) { m_labels.reserve(n); }
+
+    const_iterator find(std::string_view key) const
+    {
+        auto it = lower_bound(key);
+        if(it != m_labels.end() && it->first == key)
+        {
+            return it;
+        }
+        return m_labels.end();
+    }
+
+    size_t count(std::string_view key) const
+    {
+        return find(key) != m_labels.end() ? 1 : 0;
+    }
+
+    // Throws std::out_of_range if the label is missing, as std::map does
+    const std::string& at(std::string_view key) const
+    {
+        auto it = find(key);
+        if(it == m_labels.end())
+        {
+            throw std::out_of_range("container label not found");
+        }
+        return it->second.str();
+    }
+
+    // Like std::map::emplace, an existing label is not overwritten.
+    // Appending keys in sorted order, as deserializers do, is O(1).
+    bool emplace(std::string_view key, std::string_view value)
+    {
+        if(m_labels.empty() || m_labels.back().first.str() < key)
+        {
+            m_labels.emplace_back(key, value);
+            return true;
+        }
+        auto it = lower_bound(key);
+        if(it != m_labels.end() && it->first == key)
+        {
+            return false;
+        }
+        m_labels.emplace(it, key, value);
+        return true;
+    }
+
+    bool operator==(const container_labels& o) const
+    {
+        return m_labels == o.m_labels;
+    }
+
+    private:
+    std::vector<value_type>::const_iterator
+    lower_bound(std::string_view key) const
+    {
+        return std::lower_bound(m_labels.begin(), m_labels.end(), key,
+                                [](const value_type& label, std::string_view k)
+                                { return label.first.str() < k; });
+    }
+
+    std::vector<value_type> m_labels;
+};
+
+// Value derived from other fields, computed on first use and then kept.
+// Safe to read concurrently; a copy starts empty as its source may change.
+template<typename T>
+class lazy_value
+{
+    public:
+    lazy_value() = default;
+    lazy_value(const lazy_value&) {}
+    lazy_value& operator=(const lazy_value&)
+    {
+        reset();
+        return *this;
+    }
+    ~lazy_value() { reset(); }
+
+    template<typename F>
+    const T& get(F compute) const
+    {
+        auto v = m_value.load(std::memory_order_acquire);
+        if(v == nullptr)
+        {
+            auto computed = new T(compute());
+            if(m_value.compare_exchange_strong(v, computed,
+                                               std::memory_order_acq_rel))
+            {
+                v = computed;
+            }
+            else
+            {
+                // Lost the race, `v` now holds the winner
+                delete computed;
+            }
+        }
+        return *v;
+    }
+
+    private:
+    void reset() { delete m_value.exchange(nullptr); }
+
+    mutable std::atomic<T*> m_value{nullptr};
+};
+
+using lazy_string = lazy_value<std::string>;
+
 class container_health_probe
 {
     public:
@@ -83,6 +223,38 @@ class container_health_probe
     std::vector<std::string> m_args;
 };
 
+// Streaming FNV-1a hash of a command line, the exe then each of its args, so
+// that the command line of a thread is hashed without collecting its args.
+class health_probe_hasher
+{
+    public:
+    explicit health_probe_hasher(std::string_view exe) { add(exe); }
+    void add_arg(std::string_view arg) { add(arg); }
+    uint64_t value() const { return m_hash; }
+
+    private:
+    void add(std::string_view s)
+    {
+        // Length first, so that {"ab", "c"} and {"a", "bc"} differ
+        auto len = (uint64_t)s.size();
+        for(int i = 0; i < 8; i++)
+        {
+            mix((uint8_t)(len >> (i * 8)));
+        }
+        for(auto c : s)
+        {
+            mix((uint8_t)c);
+        }
+    }
+    void mix(uint8_t b)
+    {
+        m_hash ^= b;
+        m_hash *= 1099511628211ULL;
+    }
+
+    uint64_t m_hash = 14695981039346656037ULL;
+};
+
 class container_info
 {
     public:
@@ -97,14 +269,24 @@ class container_info
     {
     }
 
-    const std::vector<std::string>& get_env() const { return m_env; }
+    const std::vector<interned_string>& get_env() const { return m_env; }
 
     const container_mount_info* mount_by_idx(uint32_t idx) const;
     const container_mount_info* mount_by_source(const std::string&) const;
     const container_mount_info* mount_by_dest(const std::string&) const;
+    // Same as above, with a pattern compiled once by the caller
+    const container_mount_info* mount_by_source(const mount_pattern&) const;
+    const container_mount_info* mount_by_dest(const mount_pattern&) const;
 
     bool is_pod_sandbox() const { return m_is_pod_sandbox; }
 
+    // Values of the composite fields (container.mounts, container.labels and
+    // k8s.pod.labels), built once: container_info instances are never
+    // modified after being added to the containers table.
+    const std::string& get_mounts_string() const;
+    const std::string& get_labels_string() const;
+    const std::string& get_pod_sandbox_labels_string() const;
+
     // static utilities to build a container_info
     static container_info::ptr_t host_container_info()
     {
@@ -120,16 +302,26 @@ class container_info
     container_health_probe::probe_type
     match_health_probe(const std::string& exe,
                        const std::vector<std::string>& args) const;
+    // Whether a process whose command line hashes to `hash`, see
+    // `health_probe_hasher`, may match one of the health probes. Only then
+    // is the full comparison of `match_health_probe` needed.
+    bool may_match_health_probe(uint64_t hash) const;
+
+    // Approximate number of heap and inline bytes held by the instance.
+    // Interned strings are shared with other containers, only their handles
+    // are accounted; lazily built caches are not.
+    size_t memory_usage() const;
 
     std::string m_id;
     std::string m_full_id;
     container_type m_type;
     std::string m_name;
-    std::string m_image;
-    std::string m_imageid;
-    std::string m_imagerepo;
-    std::string m_imagetag;
-    std::string m_imagedigest;
+    // Fields commonly shared by containers of the same deployment are interned
+    interned_string m_image;
+    interned_string m_imageid;
+    interned_string m_imagerepo;
+    interned_string m_imagetag;
+    interned_string m_imagedigest;
     std::string m_container_ip;
     bool m_privileged;
     bool m_host_pid;
@@ -137,8 +329,8 @@ class container_info
     bool m_host_ipc;
     std::vector<container_mount_info> m_mounts;
     std::vector<container_port_mapping> m_port_mappings;
-    std::map<std::string, std::string> m_labels;
-    std::vector<std::string> m_env;
+    container_labels m_labels;
+    std::vector<interned_string> m_env;
     int64_t m_memory_limit;
     int64_t m_swap_limit;
     int64_t m_cpu_shares;
@@ -147,10 +339,10 @@ class container_info
     int64_t m_cpuset_cpu_count;
     std::list<container_health_probe> m_health_probes;
     std::string m_pod_sandbox_id;
-    std::map<std::string, std::string> m_pod_sandbox_labels;
+    container_labels m_pod_sandbox_labels;
     std::string m_pod_sandbox_cniresult;
     bool m_is_pod_sandbox;
-    std::string m_container_user;
+    interned_string m_container_user;
 
     /**
      * The time at which the container was created (IN SECONDS), cast from a
@@ -160,4 +352,28 @@ class container_info
      */
     int64_t m_created_time;
     int64_t m_size_rw_bytes; // TODO: to be exposed by state API
+
+    // Time between the first request of the container to the go-worker and
+    // its info being parsed, 0 if it was cached before any request. Measured
+    // by the plugin, neither encoded nor dumped.
+    uint64_t m_enrichment_delay_ns = 0;
+
+    // Pod sandbox container of a pod container, resolved when either of them
+    // is added to the containers table. Being a link rather than data, it is
+    // the only field updated once in the table, by the parsing thread.
+    mutable std::weak_ptr<const container_info> m_pod_sandbox;
+
+    private:
+    const container_mount_info* find_mount(const mount_pattern& pattern,
+                                           bool by_source) const;
+
+    lazy_string m_mounts_string;
+    lazy_string m_labels_string;
+    lazy_string m_pod_sandbox_labels_string;
+    // Indexes of m_mounts sorted by source and by dest, to look up prefix
+    // and exact patterns with a binary search
+    lazy_value<std::vector<uint32_t>> m_mounts_by_source;
+    lazy_value<std::vector<uint32_t>> m_mounts_by_dest;
+    // Command line hashes of m_health_probes
+    lazy_value<std::vector<uint64_t>> m_health_probe_hashes;
 };
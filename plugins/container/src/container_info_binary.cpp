@@ -0,0 +1,574 @@
+#include "container_info_binary.h"
+
+#include <algorithm>
+#include <cstring>
+#include <endian.h>
+#include <stdexcept>
+#include <thread>
+
+//////////////////////////
+// Decoding
+//////////////////////////
+
+bool container_info_view::is_binary(const void* data, size_t len)
+{
+    uint32_t magic;
+    if(data == nullptr || len < sizeof(magic))
+    {
+        return false;
+    }
+    std::memcpy(&magic, data, sizeof(magic));
+    return le32toh(magic) == CONTAINER_INFO_BINARY_MAGIC;
+}
+
+bool container_info_view::is_delta(const void* data, size_t len)
+{
+    uint16_t flags;
+    if(!is_binary(data, len) || len < header_size)
+    {
+        return false;
+    }
+    std::memcpy(&flags, (const uint8_t*)data + 6, sizeof(flags));
+    return le16toh(flags) & CONTAINER_INFO_BINARY_FLAG_DELTA;
+}
+
+container_info_view::container_info_view(const void* data, size_t len):
+        m_data((const uint8_t*)data), m_len(len)
+{
+    if(!is_binary(data, len) || len < fixed_size)
+    {
+        throw std::runtime_error("invalid container info payload");
+    }
+    if(get_version() > CONTAINER_INFO_BINARY_VERSION)
+    {
+        throw std::runtime_error(
+                "unsupported container info payload version " +
+                std::to_string(get_version()));
+    }
+    // Trailing bytes (e.g. a NUL terminator) are allowed, only the declared
+    // payload size is read.
+    uint32_t size = read_u32(8);
+    if(size < fixed_size || size > len)
+    {
+        throw std::runtime_error("truncated container info payload");
+    }
+    m_len = size;
+}
+
+std::vector<std::string_view> container_info_view::split(const void* data,
+                                                        size_t len)
+{
+    std::vector<std::string_view> payloads;
+    auto p = (const char*)data;
+    size_t off = 0;
+    while(off < len)
+    {
+        // Validates the header and bounds the payload within the buffer
+        container_info_view v(p + off, len - off);
+        payloads.emplace_back(p + off, v.m_len);
+        off += v.m_len;
+    }
+    return payloads;
+}
+
+uint16_t container_info_view::read_u16(size_t off) const
+{
+    uint16_t v;
+    std::memcpy(&v, m_data + off, sizeof(v));
+    return le16toh(v);
+}
+
+uint32_t container_info_view::read_u32(size_t off) const
+{
+    uint32_t v;
+    std::memcpy(&v, m_data + off, sizeof(v));
+    return le32toh(v);
+}
+
+uint64_t container_info_view::read_u64(size_t off) const
+{
+    uint64_t v;
+    std::memcpy(&v, m_data + off, sizeof(v));
+    return le64toh(v);
+}
+
+std::string_view container_info_view::read_string_ref(size_t off) const
+{
+    if(off + 8 > m_len)
+    {
+        throw std::runtime_error("container info payload reference overflow");
+    }
+    uint64_t str_off = read_u32(off);
+    uint64_t str_len = read_u32(off + 4);
+    if(str_off + str_len > m_len)
+    {
+        throw std::runtime_error("container info payload string overflow");
+    }
+    return std::string_view((const char*)m_data + str_off, str_len);
+}
+
+size_t container_info_view::read_list_ref(size_t off, size_t entry_size,
+                                          uint32_t& count) const
+{
+    if(off + 8 > m_len)
+    {
+        throw std::runtime_error("container info payload reference overflow");
+    }
+    uint64_t list_off = read_u32(off);
+    count = read_u32(off + 4);
+    if(list_off + (uint64_t)count * entry_size > m_len)
+    {
+        throw std::runtime_error("container info payload list overflow");
+    }
+    return list_off;
+}
+
+uint16_t container_info_view::get_version() const { return read_u16(4); }
+
+uint16_t container_info_view::get_flags() const { return read_u16(6); }
+
+container_type container_info_view::get_type() const
+{
+    return container_type(read_u16(12));
+}
+
+bool container_info_view::get_bool(bool_field f) const
+{
+    return (m_data[14] >> f) & 1;
+}
+
+int64_t container_info_view::get_scalar(scalar_field f) const
+{
+    return (int64_t)read_u64(scalars_offset + f * 8);
+}
+
+std::string_view container_info_view::get_string(string_field f) const
+{
+    return read_string_ref(strings_offset + f * 8);
+}
+
+container_info::ptr_t
+container_info_view::to_container_info(uint32_t pruned) const
+{
+    if(is_delta())
+    {
+        throw std::runtime_error("container info delta without a base");
+    }
+    auto info = std::make_shared<container_info>();
+    decode(*info, pruned);
+    return info;
+}
+
+container_info::ptr_t container_info_view::apply_to(const container_info& base,
+                                                    uint32_t pruned) const
+{
+    if(!is_delta())
+    {
+        return to_container_info(pruned);
+    }
+    if(get_id() != base.m_id)
+    {
+        throw std::runtime_error("container info delta of another container");
+    }
+    // Copies start with empty caches, see lazy_value
+    auto info = std::make_shared<container_info>(base);
+    decode(*info, pruned);
+    return info;
+}
+
+bool container_info_view::is_unchanged(size_t off) const
+{
+    return is_delta() && read_u32(off) == CONTAINER_INFO_BINARY_UNCHANGED;
+}
+
+void container_info_view::decode(container_info& info, uint32_t pruned) const
+{
+    info.m_type = get_type();
+    info.m_privileged = get_bool(BF_PRIVILEGED);
+    info.m_host_pid = get_bool(BF_HOST_PID);
+    info.m_host_network = get_bool(BF_HOST_NETWORK);
+    info.m_host_ipc = get_bool(BF_HOST_IPC);
+    info.m_is_pod_sandbox = get_bool(BF_IS_POD_SANDBOX);
+
+    info.m_memory_limit = get_scalar(IF_MEMORY_LIMIT);
+    info.m_swap_limit = get_scalar(IF_SWAP_LIMIT);
+    info.m_cpu_shares = get_scalar(IF_CPU_SHARES);
+    info.m_cpu_quota = get_scalar(IF_CPU_QUOTA);
+    info.m_cpu_period = get_scalar(IF_CPU_PERIOD);
+    info.m_cpuset_cpu_count = get_scalar(IF_CPUSET_CPU_COUNT);
+    info.m_created_time = get_scalar(IF_CREATED_TIME);
+    info.m_size_rw_bytes = get_scalar(IF_SIZE_RW_BYTES);
+
+    // Pruned sections keep the value of `info`, empty for full payloads
+    auto skip = [this, pruned](uint32_t section, size_t off)
+    {
+        return (pruned & section) || is_unchanged(off);
+    };
+
+    auto read_string = [this](string_field f, auto& value)
+    {
+        if(!is_unchanged(strings_offset + f * 8))
+        {
+            value = get_string(f);
+        }
+    };
+    read_string(SF_ID, info.m_id);
+    read_string(SF_FULL_ID, info.m_full_id);
+    read_string(SF_NAME, info.m_name);
+    read_string(SF_IMAGE, info.m_image);
+    read_string(SF_IMAGEID, info.m_imageid);
+    read_string(SF_IMAGEREPO, info.m_imagerepo);
+    read_string(SF_IMAGETAG, info.m_imagetag);
+    read_string(SF_IMAGEDIGEST, info.m_imagedigest);
+    read_string(SF_CONTAINER_IP, info.m_container_ip);
+    read_string(SF_POD_SANDBOX_ID, info.m_pod_sandbox_id);
+    if(!skip(CONTAINER_INFO_SECTION_CNI_RESULT,
+            strings_offset + SF_POD_SANDBOX_CNIRESULT * 8))
+    {
+        info.m_pod_sandbox_cniresult = get_string(SF_POD_SANDBOX_CNIRESULT);
+    }
+    read_string(SF_CONTAINER_USER, info.m_container_user);
+
+    auto read_labels = [this](list_field f, container_labels& labels)
+    {
+        if(is_unchanged(lists_offset + f * 8))
+        {
+            return;
+        }
+        uint32_t count;
+        size_t off = read_list_ref(lists_offset + f * 8, label_entry_size, count);
+        labels = container_labels();
+        labels.reserve(count);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            auto entry = off + i * label_entry_size;
+            labels.emplace(read_string_ref(entry), read_string_ref(entry + 8));
+        }
+    };
+
+    uint32_t count;
+    size_t off;
+    if(!skip(CONTAINER_INFO_SECTION_ENV, lists_offset + LF_ENV * 8))
+    {
+        off = read_list_ref(lists_offset + LF_ENV * 8, env_entry_size, count);
+        info.m_env.clear();
+        info.m_env.reserve(count);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            info.m_env.emplace_back(read_string_ref(off + i * env_entry_size));
+        }
+    }
+
+    read_labels(LF_LABELS, info.m_labels);
+    read_labels(LF_POD_SANDBOX_LABELS, info.m_pod_sandbox_labels);
+
+    if(!skip(CONTAINER_INFO_SECTION_MOUNTS, lists_offset + LF_MOUNTS * 8))
+    {
+        off = read_list_ref(lists_offset + LF_MOUNTS * 8, mount_entry_size,
+                            count);
+        info.m_mounts.clear();
+        info.m_mounts.resize(count);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            auto entry = off + i * mount_entry_size;
+            auto& mount = info.m_mounts[i];
+            mount.m_source = read_string_ref(entry);
+            mount.m_dest = read_string_ref(entry + 8);
+            mount.m_mode = read_string_ref(entry + 16);
+            mount.m_propagation = read_string_ref(entry + 24);
+            mount.m_rdwr = read_u32(entry + 32) != 0;
+        }
+    }
+
+    if(!skip(CONTAINER_INFO_SECTION_PORT_MAPPINGS,
+            lists_offset + LF_PORT_MAPPINGS * 8))
+    {
+        off = read_list_ref(lists_offset + LF_PORT_MAPPINGS * 8,
+                            port_mapping_entry_size, count);
+        info.m_port_mappings.clear();
+        info.m_port_mappings.resize(count);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            auto entry = off + i * port_mapping_entry_size;
+            auto& port = info.m_port_mappings[i];
+            port.m_host_ip = read_u32(entry);
+            port.m_host_port = read_u16(entry + 4);
+            port.m_container_port = read_u16(entry + 6);
+        }
+    }
+
+    if(skip(CONTAINER_INFO_SECTION_HEALTH_PROBES,
+            lists_offset + LF_HEALTH_PROBES * 8))
+    {
+        return;
+    }
+    off = read_list_ref(lists_offset + LF_HEALTH_PROBES * 8,
+                        health_probe_entry_size, count);
+    info.m_health_probes.clear();
+    for(uint32_t i = 0; i < count; i++)
+    {
+        auto entry = off + i * health_probe_entry_size;
+        auto type = read_u32(entry);
+        if(type <= container_health_probe::PT_NONE ||
+           type > container_health_probe::PT_READINESS_PROBE)
+        {
+            continue;
+        }
+        auto& probe = info.m_health_probes.emplace_back();
+        probe.m_type = container_health_probe::probe_type(type);
+        probe.m_exe = read_string_ref(entry + 8);
+        uint32_t n_args;
+        size_t args = read_list_ref(entry + 16, env_entry_size, n_args);
+        probe.m_args.reserve(n_args);
+        for(uint32_t j = 0; j < n_args; j++)
+        {
+            probe.m_args.emplace_back(read_string_ref(args + j * env_entry_size));
+        }
+    }
+}
+
+void prune_container_info(container_info& info, uint32_t sections)
+{
+    if(sections & CONTAINER_INFO_SECTION_ENV)
+    {
+        info.m_env.clear();
+        info.m_env.shrink_to_fit();
+    }
+    if(sections & CONTAINER_INFO_SECTION_MOUNTS)
+    {
+        info.m_mounts.clear();
+        info.m_mounts.shrink_to_fit();
+    }
+    if(sections & CONTAINER_INFO_SECTION_PORT_MAPPINGS)
+    {
+        info.m_port_mappings.clear();
+        info.m_port_mappings.shrink_to_fit();
+    }
+    if(sections & CONTAINER_INFO_SECTION_HEALTH_PROBES)
+    {
+        info.m_health_probes.clear();
+    }
+    if(sections & CONTAINER_INFO_SECTION_CNI_RESULT)
+    {
+        info.m_pod_sandbox_cniresult.clear();
+        info.m_pod_sandbox_cniresult.shrink_to_fit();
+    }
+}
+
+// Below this number of payloads per thread, spawning threads costs more than
+// the decoding itself
+#define MIN_PAYLOADS_PER_THREAD 64
+
+std::vector<container_info::ptr_t>
+decode_container_infos(const std::vector<std::string_view>& payloads,
+                       unsigned max_threads, uint32_t pruned)
+{
+    std::vector<container_info::ptr_t> infos(payloads.size());
+    auto decode = [&](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            try
+            {
+                infos[i] = container_info_view(payloads[i].data(),
+                                               payloads[i].size())
+                                   .to_container_info(pruned);
+            }
+            catch(const std::exception&)
+            {
+                // Leave it null
+            }
+        }
+    };
+
+    size_t n_threads = payloads.size() / MIN_PAYLOADS_PER_THREAD;
+    if(n_threads > max_threads)
+    {
+        n_threads = max_threads;
+    }
+    if(n_threads <= 1)
+    {
+        decode(0, payloads.size());
+        return infos;
+    }
+
+    // Each thread decodes a contiguous chunk, the calling one included
+    std::vector<std::thread> threads;
+    size_t chunk = (payloads.size() + n_threads - 1) / n_threads;
+    for(size_t t = 1; t < n_threads; t++)
+    {
+        size_t begin = std::min(t * chunk, payloads.size());
+        size_t end = std::min(begin + chunk, payloads.size());
+        threads.emplace_back(decode, begin, end);
+    }
+    decode(0, std::min(chunk, payloads.size()));
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+    return infos;
+}
+
+//////////////////////////
+// Encoding
+//////////////////////////
+
+namespace
+{
+class binary_writer
+{
+    public:
+    explicit binary_writer(std::string& out): m_out(out) {}
+
+    // Append `n` zeroed bytes and return their offset
+    size_t reserve(size_t n)
+    {
+        size_t off = m_out.size();
+        m_out.append(n, '\0');
+        return off;
+    }
+
+    void put_u16(size_t off, uint16_t v)
+    {
+        v = htole16(v);
+        std::memcpy(&m_out[off], &v, sizeof(v));
+    }
+
+    void put_u32(size_t off, uint32_t v)
+    {
+        v = htole32(v);
+        std::memcpy(&m_out[off], &v, sizeof(v));
+    }
+
+    void put_u64(size_t off, uint64_t v)
+    {
+        v = htole64(v);
+        std::memcpy(&m_out[off], &v, sizeof(v));
+    }
+
+    // Append `s` and write its reference at `ref`
+    void put_string(size_t ref, const std::string& s)
+    {
+        put_u32(ref, m_out.size());
+        put_u32(ref + 4, s.size());
+        m_out.append(s);
+    }
+
+    // Reserve `count` entries and write their list reference at `ref`
+    size_t put_list(size_t ref, size_t count, size_t entry_size)
+    {
+        auto off = reserve(count * entry_size);
+        put_u32(ref, off);
+        put_u32(ref + 4, count);
+        return off;
+    }
+
+    private:
+    std::string& m_out;
+};
+} // namespace
+
+static inline void put_labels(binary_writer& w, size_t ref,
+                              const container_labels& labels)
+{
+    auto off = w.put_list(ref, labels.size(),
+                          container_info_view::label_entry_size);
+    for(const auto& label : labels)
+    {
+        w.put_string(off, label.first);
+        w.put_string(off + 8, label.second);
+        off += container_info_view::label_entry_size;
+    }
+}
+
+void container_info_to_binary(const container_info& info, std::string& out,
+                              uint16_t flags)
+{
+    using v = container_info_view;
+
+    out.clear();
+    binary_writer w(out);
+    w.reserve(v::fixed_size);
+    w.put_u32(0, CONTAINER_INFO_BINARY_MAGIC);
+    w.put_u16(4, CONTAINER_INFO_BINARY_VERSION);
+    w.put_u16(6, flags);
+    w.put_u16(12, info.m_type);
+    out[14] = (char)((info.m_privileged << v::BF_PRIVILEGED) |
+                     (info.m_host_pid << v::BF_HOST_PID) |
+                     (info.m_host_network << v::BF_HOST_NETWORK) |
+                     (info.m_host_ipc << v::BF_HOST_IPC) |
+                     (info.m_is_pod_sandbox << v::BF_IS_POD_SANDBOX));
+
+    const int64_t scalars[v::IF_MAX] = {
+            info.m_memory_limit, info.m_swap_limit,       info.m_cpu_shares,
+            info.m_cpu_quota,    info.m_cpu_period,       info.m_cpuset_cpu_count,
+            info.m_created_time, info.m_size_rw_bytes};
+    for(int i = 0; i < v::IF_MAX; i++)
+    {
+        w.put_u64(v::scalars_offset + i * 8, scalars[i]);
+    }
+
+    const std::string* strings[v::SF_MAX] = {
+            &info.m_id,           &info.m_full_id,
+            &info.m_name,               &info.m_image.str(),
+            &info.m_imageid.str(),      &info.m_imagerepo.str(),
+            &info.m_imagetag.str(),     &info.m_imagedigest.str(),
+            &info.m_container_ip,       &info.m_pod_sandbox_id,
+            &info.m_pod_sandbox_cniresult, &info.m_container_user.str()};
+    for(int i = 0; i < v::SF_MAX; i++)
+    {
+        w.put_string(v::strings_offset + i * 8, *strings[i]);
+    }
+
+    auto off = w.put_list(v::lists_offset + v::LF_ENV * 8, info.m_env.size(),
+                          v::env_entry_size);
+    for(const auto& env : info.m_env)
+    {
+        w.put_string(off, env);
+        off += v::env_entry_size;
+    }
+
+    put_labels(w, v::lists_offset + v::LF_LABELS * 8, info.m_labels);
+    put_labels(w, v::lists_offset + v::LF_POD_SANDBOX_LABELS * 8,
+               info.m_pod_sandbox_labels);
+
+    off = w.put_list(v::lists_offset + v::LF_MOUNTS * 8, info.m_mounts.size(),
+                     v::mount_entry_size);
+    for(const auto& mount : info.m_mounts)
+    {
+        w.put_string(off, mount.m_source);
+        w.put_string(off + 8, mount.m_dest);
+        w.put_string(off + 16, mount.m_mode);
+        w.put_string(off + 24, mount.m_propagation);
+        w.put_u32(off + 32, mount.m_rdwr);
+        off += v::mount_entry_size;
+    }
+
+    off = w.put_list(v::lists_offset + v::LF_PORT_MAPPINGS * 8,
+                     info.m_port_mappings.size(), v::port_mapping_entry_size);
+    for(const auto& port : info.m_port_mappings)
+    {
+        w.put_u32(off, port.m_host_ip);
+        w.put_u16(off + 4, port.m_host_port);
+        w.put_u16(off + 6, port.m_container_port);
+        off += v::port_mapping_entry_size;
+    }
+
+    off = w.put_list(v::lists_offset + v::LF_HEALTH_PROBES * 8,
+                     info.m_health_probes.size(), v::health_probe_entry_size);
+    for(const auto& probe : info.m_health_probes)
+    {
+        w.put_u32(off, probe.m_type);
+        w.put_string(off + 8, probe.m_exe);
+        auto args = w.put_list(off + 16, probe.m_args.size(),
+                               v::env_entry_size);
+        for(const auto& arg : probe.m_args)
+        {
+            w.put_string(args, arg);
+            args += v::env_entry_size;
+        }
+        off += v::health_probe_entry_size;
+    }
+
+    w.put_u32(8, out.size());
+}
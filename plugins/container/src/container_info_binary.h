@@ -0,0 +1,213 @@
+#pragma once
+
+#include "container_info.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Binary encoding of a container_info, used as async event payload between
+ * the go-worker and the C++ side (see go-worker/pkg/event/binary.go, the two
+ * must be kept in sync) and to dump the plugin state.
+ *
+ * All integers are little endian. The payload starts with a fixed size section
+ * holding the header, the scalars and one (offset, length) reference for each
+ * string and list field, followed by a data section. Strings are not NUL
+ * terminated; lists are arrays of fixed size entries whose strings are
+ * references again. Any field can thus be read in place without decoding the
+ * whole payload, see `container_info_view`.
+ *
+ *     0   u32 magic, u16 version, u16 flags, u32 size, u16 type, u8 bools, u8 0
+ *     16  i64 memory_limit, swap_limit, cpu_shares, cpu_quota, cpu_period,
+ *             cpuset_cpu_count, created_time, size_rw_bytes
+ *     80  string refs (u32 offset, u32 length), see `string_field`
+ *     176 list refs (u32 offset, u32 count), see `list_field`
+ *     224 data section
+ *
+ * List entries:
+ *     env                  string ref
+ *     labels               key string ref, value string ref
+ *     mounts               source, dest, mode, propagation string refs,
+ *                          u32 rw, u32 0
+ *     port_mappings        u32 host_ip, u16 host_port, u16 container_port
+ *     health_probes        u32 type, u32 0, exe string ref, args list ref of
+ *                          string refs
+ *
+ * Delta payloads, flagged with CONTAINER_INFO_BINARY_FLAG_DELTA, carry the
+ * update of a container already sent in full: the header, scalars and bools
+ * are always set, while the string and list references of unchanged fields
+ * hold the CONTAINER_INFO_BINARY_UNCHANGED offset and no data. The id is
+ * always set.
+ *
+ * Readers reject payloads with an unknown magic or a newer version, any layout
+ * change requires bumping CONTAINER_INFO_BINARY_VERSION.
+ */
+
+#define CONTAINER_INFO_BINARY_MAGIC 0x31544346 // "FCT1"
+#define CONTAINER_INFO_BINARY_VERSION 1
+
+// The container was listed by the go-worker at startup, as part of the initial
+// state snapshot: a buffer of concatenated payloads handed over at once by
+// StartWorker (see `container_info_view::split`). It is already cached by the
+// time its async event gets parsed.
+#define CONTAINER_INFO_BINARY_FLAG_INITIAL_STATE (1 << 0)
+
+// The payload only holds the fields that changed since the container was
+// last sent; it travels in ASYNC_EVENT_NAME_UPDATED async events.
+#define CONTAINER_INFO_BINARY_FLAG_DELTA (1 << 1)
+
+// Offset of the unchanged string and list references of delta payloads
+#define CONTAINER_INFO_BINARY_UNCHANGED 0xffffffff
+
+// Sections of a container_info that no extracted field may need, pruned from
+// the payloads by the go-worker (see event.Container.Prune) and skipped when
+// decoding, see PluginConfig::required_fields. Pruned sections are empty.
+#define CONTAINER_INFO_SECTION_ENV (1 << 0)
+#define CONTAINER_INFO_SECTION_MOUNTS (1 << 1)
+#define CONTAINER_INFO_SECTION_PORT_MAPPINGS (1 << 2)
+#define CONTAINER_INFO_SECTION_HEALTH_PROBES (1 << 3)
+#define CONTAINER_INFO_SECTION_CNI_RESULT (1 << 4)
+#define CONTAINER_INFO_SECTIONS_ALL ((1 << 5) - 1)
+
+class container_info_view
+{
+    public:
+    enum string_field
+    {
+        SF_ID = 0,
+        SF_FULL_ID,
+        SF_NAME,
+        SF_IMAGE,
+        SF_IMAGEID,
+        SF_IMAGEREPO,
+        SF_IMAGETAG,
+        SF_IMAGEDIGEST,
+        SF_CONTAINER_IP,
+        SF_POD_SANDBOX_ID,
+        SF_POD_SANDBOX_CNIRESULT,
+        SF_CONTAINER_USER,
+        SF_MAX
+    };
+
+    enum list_field
+    {
+        LF_ENV = 0,
+        LF_LABELS,
+        LF_POD_SANDBOX_LABELS,
+        LF_MOUNTS,
+        LF_PORT_MAPPINGS,
+        LF_HEALTH_PROBES,
+        LF_MAX
+    };
+
+    enum scalar_field
+    {
+        IF_MEMORY_LIMIT = 0,
+        IF_SWAP_LIMIT,
+        IF_CPU_SHARES,
+        IF_CPU_QUOTA,
+        IF_CPU_PERIOD,
+        IF_CPUSET_CPU_COUNT,
+        IF_CREATED_TIME,
+        IF_SIZE_RW_BYTES,
+        IF_MAX
+    };
+
+    enum bool_field
+    {
+        BF_PRIVILEGED = 0,
+        BF_HOST_PID,
+        BF_HOST_NETWORK,
+        BF_HOST_IPC,
+        BF_IS_POD_SANDBOX
+    };
+
+    static constexpr size_t header_size = 16;
+    static constexpr size_t scalars_offset = header_size;
+    static constexpr size_t strings_offset = scalars_offset + IF_MAX * 8;
+    static constexpr size_t lists_offset = strings_offset + SF_MAX * 8;
+    static constexpr size_t fixed_size = lists_offset + LF_MAX * 8;
+
+    // Entry sizes of the lists
+    static constexpr size_t env_entry_size = 8;
+    static constexpr size_t label_entry_size = 16;
+    static constexpr size_t mount_entry_size = 40;
+    static constexpr size_t port_mapping_entry_size = 8;
+    static constexpr size_t health_probe_entry_size = 24;
+
+    // Whether the buffer holds a binary payload rather than a JSON one.
+    // JSON payloads are still found in captures taken by older versions.
+    static bool is_binary(const void* data, size_t len);
+    // Whether the buffer holds a binary delta payload, without validating it
+    static bool is_delta(const void* data, size_t len);
+
+    // Split a buffer of concatenated payloads, such as the go-worker initial
+    // state snapshot, relying on the size of each header. Throws
+    // std::runtime_error if a payload is truncated or invalid.
+    static std::vector<std::string_view> split(const void* data, size_t len);
+
+    // Throws std::runtime_error if the payload is truncated, has an unknown
+    // magic or a newer version. The buffer must outlive the view.
+    container_info_view(const void* data, size_t len);
+
+    uint16_t get_version() const;
+    uint16_t get_flags() const;
+    container_type get_type() const;
+    bool get_bool(bool_field f) const;
+    int64_t get_scalar(scalar_field f) const;
+    // Throws std::runtime_error if the reference exceeds the payload, as
+    // unchanged fields of delta payloads do
+    std::string_view get_string(string_field f) const;
+
+    std::string_view get_id() const { return get_string(SF_ID); }
+    std::string_view get_image() const { return get_string(SF_IMAGE); }
+    bool is_pod_sandbox() const { return get_bool(BF_IS_POD_SANDBOX); }
+
+    bool is_delta() const
+    {
+        return get_flags() & CONTAINER_INFO_BINARY_FLAG_DELTA;
+    }
+
+    // Decode the whole payload but the `pruned` sections, throws
+    // std::runtime_error on delta payloads
+    container_info::ptr_t to_container_info(uint32_t pruned = 0) const;
+    // Decode a delta payload on top of a copy of `base`, which must be the
+    // same container; full payloads are decoded as is.
+    container_info::ptr_t apply_to(const container_info& base,
+                                   uint32_t pruned = 0) const;
+
+    private:
+    // Decode all the fields into `info`, skipping the unchanged ones and the
+    // `pruned` sections
+    void decode(container_info& info, uint32_t pruned) const;
+    // Whether the string or list reference at `off` is unchanged
+    bool is_unchanged(size_t off) const;
+    uint16_t read_u16(size_t off) const;
+    uint32_t read_u32(size_t off) const;
+    uint64_t read_u64(size_t off) const;
+    std::string_view read_string_ref(size_t off) const;
+    // Returns the offset of the first entry of the list referenced at `off`
+    // and sets its number of entries, after checking the list bounds.
+    size_t read_list_ref(size_t off, size_t entry_size, uint32_t& count) const;
+
+    const uint8_t* m_data;
+    size_t m_len;
+};
+
+// Decode `payloads` but their `pruned` sections using up to `max_threads`
+// threads, keeping their order. Payloads failing to decode yield null entries.
+std::vector<container_info::ptr_t>
+decode_container_infos(const std::vector<std::string_view>& payloads,
+                       unsigned max_threads, uint32_t pruned = 0);
+
+// Empty the `sections` of `info`, e.g. for JSON payloads which the go-worker
+// did not prune
+void prune_container_info(container_info& info, uint32_t sections);
+
+// Encode `info` into `out`, replacing its content. `out` is a std::string
+// as the payload is handed to the async event encoder as a byte buffer.
+void container_info_to_binary(const container_info& info, std::string& out,
+                              uint16_t flags = 0);
@@ -65,6 +65,22 @@ static inline void object_from_json(const nlohmann::json& j, const char* key,
     }
 }
 
+void from_json(const nlohmann::json& j, interned_string& s)
+{
+    s = j.get_ref<const std::string&>();
+}
+
+void from_json(const nlohmann::json& j, container_labels& labels)
+{
+    labels = container_labels();
+    labels.reserve(j.size());
+    // Objects are sorted by key, labels get appended
+    for(auto it = j.begin(); it != j.end(); ++it)
+    {
+        labels.emplace(it.key(), it.value().get_ref<const std::string&>());
+    }
+}
+
 void from_json(const nlohmann::json& j, container_health_probe& probe)
 {
     object_from_json(j, "args", probe.m_args);
@@ -141,6 +157,17 @@ void from_json(const nlohmann::json& j, container_info::ptr_t& cinfo)
     cinfo = info;
 }
 
+void to_json(nlohmann::json& j, const interned_string& s) { j = s.str(); }
+
+void to_json(nlohmann::json& j, const container_labels& labels)
+{
+    j = nlohmann::json::object();
+    for(const auto& label : labels)
+    {
+        j[label.first.str()] = label.second.str();
+    }
+}
+
 void to_json(nlohmann::json& j, const container_health_probe& probe)
 {
     j["args"] = probe.m_args;
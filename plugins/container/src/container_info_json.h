@@ -4,11 +4,15 @@
 
 #include <nlohmann/json.hpp>
 
+void from_json(const nlohmann::json& j, interned_string& s);
+void from_json(const nlohmann::json& j, container_labels& labels);
 void from_json(const nlohmann::json& j, container_health_probe& probe);
 void from_json(const nlohmann::json& j, container_mount_info& mount);
 void from_json(const nlohmann::json& j, container_port_mapping& port);
 void from_json(const nlohmann::json& j, container_info::ptr_t& cinfo);
 
+void to_json(nlohmann::json& j, const interned_string& s);
+void to_json(nlohmann::json& j, const container_labels& labels);
 void to_json(nlohmann::json& j, const container_health_probe& probe);
 void to_json(nlohmann::json& j, const container_mount_info& mount);
 void to_json(nlohmann::json& j, const container_port_mapping& port);
@@ -0,0 +1,88 @@
+#include "container_requests.h"
+
+#include <algorithm>
+
+container_requests::container_requests(size_t max_pending,
+                                       uint64_t min_backoff_ns,
+                                       uint64_t max_backoff_ns):
+        m_max_pending(max_pending), m_min_backoff_ns(min_backoff_ns),
+        m_max_backoff_ns(std::max(min_backoff_ns, max_backoff_ns))
+{
+}
+
+bool container_requests::should_ask(const std::string& id, uint64_t now,
+                                    bool priority)
+{
+    auto it = m_pending.find(id);
+    if(it != m_pending.end())
+    {
+        if(now < it->second.m_retry_ts &&
+           !(priority && !it->second.m_priority))
+        {
+            m_hits++;
+            return false;
+        }
+        return true;
+    }
+
+    if(m_pending.size() >= m_max_pending)
+    {
+        expire(now);
+        if(m_pending.size() >= m_max_pending)
+        {
+            m_hits++;
+            return false;
+        }
+    }
+    return true;
+}
+
+void container_requests::on_asked(const std::string& id, uint64_t now,
+                                  bool priority)
+{
+    m_misses++;
+    auto res = m_pending.try_emplace(id,
+                                     request{0, m_min_backoff_ns, now, false});
+    auto& req = res.first->second;
+    if(!res.second)
+    {
+        if(priority && now < req.m_retry_ts)
+        {
+            // Upgrade of a pending request, keeping its backoff
+            req.m_priority = true;
+            return;
+        }
+        // A retry
+        req.m_backoff_ns = std::min(req.m_backoff_ns * 2, m_max_backoff_ns);
+    }
+    req.m_priority = priority;
+    req.m_retry_ts = now + req.m_backoff_ns;
+}
+
+uint64_t container_requests::on_resolved(const std::string& id, uint64_t now)
+{
+    auto it = m_pending.find(id);
+    if(it == m_pending.end())
+    {
+        return 0;
+    }
+    auto elapsed = now > it->second.m_asked_ts ? now - it->second.m_asked_ts
+                                               : 0;
+    m_pending.erase(it);
+    return elapsed;
+}
+
+void container_requests::expire(uint64_t now)
+{
+    for(auto it = m_pending.begin(); it != m_pending.end();)
+    {
+        if(now >= it->second.m_retry_ts)
+        {
+            it = m_pending.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#define CONTAINER_REQUESTS_DEFAULT_MAX_PENDING 1024
+#define CONTAINER_REQUESTS_MIN_BACKOFF_NS 1000000000ULL     // 1s
+#define CONTAINER_REQUESTS_MAX_BACKOFF_NS 300000000000ULL   // 5min
+
+/*
+ * Tracks the containers whose metadata was asked to the go-worker through
+ * AskForContainerInfo() and not received yet.
+ *
+ * The go-worker gives up on a container after a few retries, thus a pending
+ * request also acts as a negative cache entry: the same container is not asked
+ * again until its backoff expires, doubling at each retry up to the max
+ * backoff. The number of pending requests is bounded, once full new
+ * containers are only asked after older requests expire or get resolved.
+ *
+ * A priority request, for a container whose events are being evaluated, is
+ * let through once even if a regular request for the same container is still
+ * backing off, so that it skips the go-worker queue.
+ */
+class container_requests
+{
+    public:
+    container_requests(
+            size_t max_pending = CONTAINER_REQUESTS_DEFAULT_MAX_PENDING,
+            uint64_t min_backoff_ns = CONTAINER_REQUESTS_MIN_BACKOFF_NS,
+            uint64_t max_backoff_ns = CONTAINER_REQUESTS_MAX_BACKOFF_NS);
+
+    // Whether the go-worker should be asked for `id` now, ie: it is not
+    // pending or its backoff expired, or a regular request is pending and
+    // `priority` is set. Counts a hit otherwise.
+    bool should_ask(const std::string& id, uint64_t now, bool priority = false);
+    // The go-worker accepted the request for `id`
+    void on_asked(const std::string& id, uint64_t now, bool priority = false);
+    // The metadata of `id` was received at `now`. Returns the time elapsed
+    // since it was first asked, or 0 if it was not pending.
+    uint64_t on_resolved(const std::string& id, uint64_t now);
+
+    // Requests avoided because already pending or backing off
+    uint64_t get_hits() const { return m_hits; }
+    // Requests sent to the go-worker
+    uint64_t get_misses() const { return m_misses; }
+    size_t get_pending() const { return m_pending.size(); }
+
+    private:
+    struct request
+    {
+        // Earliest time at which the container can be asked again
+        uint64_t m_retry_ts;
+        uint64_t m_backoff_ns;
+        uint64_t m_asked_ts;
+        // Asked as priority since the last retry
+        bool m_priority;
+    };
+
+    // Drop the requests whose backoff expired at `now`
+    void expire(uint64_t now);
+
+    std::unordered_map<std::string, request> m_pending;
+    size_t m_max_pending;
+    uint64_t m_min_backoff_ns;
+    uint64_t m_max_backoff_ns;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+};
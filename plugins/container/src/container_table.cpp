@@ -0,0 +1,200 @@
+#include "container_table.h"
+
+#include <algorithm>
+
+static size_t round_capacity(size_t capacity)
+{
+    size_t c = 16;
+    while(c < capacity)
+    {
+        c <<= 1;
+    }
+    return c;
+}
+
+container_table::container_table(size_t capacity):
+        m_hashes(round_capacity(capacity), 0),
+        m_entries(round_capacity(capacity)),
+        m_slots(round_capacity(capacity))
+{
+}
+
+size_t container_table::probe(std::string_view id, uint64_t h) const
+{
+    size_t idx = h & mask();
+    while(m_hashes[idx] != 0)
+    {
+        if(m_hashes[idx] == h && m_entries[idx].first == id)
+        {
+            break;
+        }
+        idx = (idx + 1) & mask();
+    }
+    return idx;
+}
+
+size_t container_table::next_used(size_t idx) const
+{
+    while(idx < m_hashes.size() && m_hashes[idx] == 0)
+    {
+        idx++;
+    }
+    return idx;
+}
+
+const container_table::value_type*
+container_table::find(std::string_view id) const
+{
+    auto idx = probe(id, hash(id));
+    return m_hashes[idx] != 0 ? &m_entries[idx].second : nullptr;
+}
+
+void container_table::set(std::string_view id, value_type info)
+{
+    if(info == nullptr)
+    {
+        erase(id);
+        return;
+    }
+
+    auto memory = info->memory_usage();
+    auto h = hash(id);
+    auto idx = probe(id, h);
+    if(m_hashes[idx] == 0)
+    {
+        if((m_size + 1) * 2 > m_hashes.size())
+        {
+            grow();
+            idx = probe(id, h);
+        }
+        m_hashes[idx] = h;
+        m_entries[idx].first = id;
+        m_size++;
+    }
+    m_memory = m_memory - m_slots[idx].m_memory + memory;
+    m_entries[idx].second = std::move(info);
+    m_slots[idx].m_memory = memory;
+    m_slots[idx].m_last_used = ++m_clock;
+    m_generation++;
+}
+
+void container_table::touch(std::string_view id)
+{
+    auto idx = probe(id, hash(id));
+    if(m_hashes[idx] != 0)
+    {
+        m_slots[idx].m_last_used = ++m_clock;
+    }
+}
+
+std::vector<std::string> container_table::evict(
+        size_t max_size, const std::function<bool(const std::string&)>& pinned)
+{
+    std::vector<std::string> evicted;
+    if(m_size <= max_size)
+    {
+        return evicted;
+    }
+
+    std::vector<std::pair<uint64_t, size_t>> candidates;
+    for(size_t idx = next_used(0); idx < m_hashes.size();
+        idx = next_used(idx + 1))
+    {
+        if(!pinned(m_entries[idx].first))
+        {
+            candidates.emplace_back(m_slots[idx].m_last_used, idx);
+        }
+    }
+    auto n = std::min(m_size - max_size, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + n,
+                      candidates.end());
+
+    // Collect the ids first, erasing moves the entries around
+    evicted.reserve(n);
+    for(size_t i = 0; i < n; i++)
+    {
+        evicted.push_back(m_entries[candidates[i].second].first);
+    }
+    for(const auto& id : evicted)
+    {
+        erase(id);
+    }
+    return evicted;
+}
+
+bool container_table::erase(std::string_view id)
+{
+    auto idx = probe(id, hash(id));
+    if(m_hashes[idx] == 0)
+    {
+        return false;
+    }
+    m_memory -= m_slots[idx].m_memory;
+
+    // Backward shift the entries following in the probe sequence, so that
+    // no lookup stops early at the freed slot
+    auto next = idx;
+    for(;;)
+    {
+        next = (next + 1) & mask();
+        if(m_hashes[next] == 0)
+        {
+            break;
+        }
+        auto home = m_hashes[next] & mask();
+        // Whether `home` lies cyclically in (idx, next]: the entry can't move
+        bool stays = idx <= next ? (idx < home && home <= next)
+                                 : (idx < home || home <= next);
+        if(!stays)
+        {
+            m_hashes[idx] = m_hashes[next];
+            m_entries[idx] = std::move(m_entries[next]);
+            m_slots[idx] = m_slots[next];
+            idx = next;
+        }
+    }
+    m_hashes[idx] = 0;
+    m_entries[idx] = entry_type();
+    m_slots[idx] = slot_info();
+    m_size--;
+    m_generation++;
+    return true;
+}
+
+void container_table::clear()
+{
+    std::fill(m_hashes.begin(), m_hashes.end(), 0);
+    for(auto& e : m_entries)
+    {
+        e = entry_type();
+    }
+    std::fill(m_slots.begin(), m_slots.end(), slot_info());
+    m_size = 0;
+    m_memory = 0;
+    m_generation++;
+}
+
+void container_table::grow()
+{
+    std::vector<uint64_t> hashes(m_hashes.size() * 2, 0);
+    std::vector<entry_type> entries(hashes.size());
+    std::vector<slot_info> slots(hashes.size());
+    std::swap(hashes, m_hashes);
+    std::swap(entries, m_entries);
+    std::swap(slots, m_slots);
+    for(size_t i = 0; i < hashes.size(); i++)
+    {
+        if(hashes[i] == 0)
+        {
+            continue;
+        }
+        auto idx = hashes[i] & mask();
+        while(m_hashes[idx] != 0)
+        {
+            idx = (idx + 1) & mask();
+        }
+        m_hashes[idx] = hashes[i];
+        m_entries[idx] = std::move(entries[i]);
+        m_slots[idx] = slots[i];
+    }
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "container_info.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+ * The containers table, indexed by container id.
+ *
+ * An open addressing hash table with linear probing: the hashes of the
+ * entries are stored contiguously, apart from the entries, so that a lookup
+ * usually costs one hash comparison and one key comparison, without chasing
+ * any node pointer. The load factor is kept below 1/2 and erased slots are
+ * backward shifted, rather than tombstoned, to keep probe sequences short.
+ *
+ * Each entry also records its memory usage, see container_info::memory_usage,
+ * and when it was last used, so that the table can be bounded by evicting
+ * the least recently used entries.
+ *
+ * Entries are never null and are immutable once added, updating a container
+ * means replacing its entry. The table is owned by the parsing thread: both
+ * our capabilities and the plugins reading it through the state API run
+ * there.
+ */
+class container_table
+{
+    public:
+    using value_type = std::shared_ptr<const container_info>;
+    using entry_type = std::pair<std::string, value_type>;
+
+    class const_iterator
+    {
+        public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = entry_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const entry_type*;
+        using reference = const entry_type&;
+
+        reference operator*() const { return m_table->m_entries[m_idx]; }
+        pointer operator->() const { return &m_table->m_entries[m_idx]; }
+        const_iterator& operator++()
+        {
+            m_idx = m_table->next_used(m_idx + 1);
+            return *this;
+        }
+        bool operator==(const const_iterator& o) const
+        {
+            return m_idx == o.m_idx;
+        }
+        bool operator!=(const const_iterator& o) const
+        {
+            return m_idx != o.m_idx;
+        }
+
+        private:
+        friend class container_table;
+        const_iterator(const container_table* t, size_t idx):
+                m_table(t), m_idx(idx)
+        {
+        }
+
+        const container_table* m_table;
+        size_t m_idx;
+    };
+
+    explicit container_table(size_t capacity = 16);
+
+    // Returns nullptr if the container is missing
+    const value_type* find(std::string_view id) const;
+    bool contains(std::string_view id) const { return find(id) != nullptr; }
+    // Add or replace the entry of `id`; a null `info` erases it
+    void set(std::string_view id, value_type info);
+    // Returns false if the container was missing
+    bool erase(std::string_view id);
+    void clear();
+    // Mark the entry of `id`, if any, as the most recently used one
+    void touch(std::string_view id);
+    // Erase the least recently used entries, skipping the pinned ones, until
+    // the table holds at most `max_size` entries. Returns the ids of the
+    // erased entries.
+    std::vector<std::string>
+    evict(size_t max_size,
+          const std::function<bool(const std::string&)>& pinned);
+
+    size_t size() const { return m_size; }
+    // Sum of the memory usage of the entries
+    size_t memory_usage() const { return m_memory; }
+    bool empty() const { return m_size == 0; }
+    size_t capacity() const { return m_hashes.size(); }
+    // Bumped by each change of the entries, not by `touch`
+    uint64_t get_generation() const { return m_generation; }
+
+    const_iterator begin() const { return {this, next_used(0)}; }
+    const_iterator end() const { return {this, m_hashes.size()}; }
+
+    private:
+    // 0 marks empty slots
+    static uint64_t hash(std::string_view id)
+    {
+        return std::hash<std::string_view>{}(id) | 1;
+    }
+
+    size_t mask() const { return m_hashes.size() - 1; }
+    // Index of the slot of `id`, or of the empty slot ending its probe
+    size_t probe(std::string_view id, uint64_t h) const;
+    size_t next_used(size_t idx) const;
+    void grow();
+
+    struct slot_info
+    {
+        uint64_t m_last_used = 0;
+        size_t m_memory = 0;
+    };
+
+    std::vector<uint64_t> m_hashes;
+    std::vector<entry_type> m_entries;
+    std::vector<slot_info> m_slots;
+    size_t m_size = 0;
+    size_t m_memory = 0;
+    // Logical clock ordering the uses of the entries
+    uint64_t m_clock = 0;
+    uint64_t m_generation = 0;
+};
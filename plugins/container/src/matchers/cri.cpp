@@ -15,4 +15,9 @@ constexpr const cgroup_layout CRI_CGROUP_LAYOUT[] = {
 bool cri::resolve(const std::string& cgroup, std::string& container_id)
 {
     return matches_runc_cgroup(cgroup, CRI_CGROUP_LAYOUT, container_id);
-}
\ No newline at end of file
+}
+
+const cgroup_layout* cri::get_runc_layout() const
+{
+    return CRI_CGROUP_LAYOUT;
+}
@@ -5,4 +5,5 @@
 class cri : public cgroup_matcher
 {
     bool resolve(const std::string& cgroup, std::string& container_id) override;
+    const libsinsp::runc::cgroup_layout* get_runc_layout() const override;
 };
@@ -11,4 +11,9 @@ constexpr const cgroup_layout DOCKER_CGROUP_LAYOUT[] = {
 bool docker::resolve(const std::string& cgroup, std::string& container_id)
 {
     return matches_runc_cgroup(cgroup, DOCKER_CGROUP_LAYOUT, container_id);
-}
\ No newline at end of file
+}
+
+const cgroup_layout* docker::get_runc_layout() const
+{
+    return DOCKER_CGROUP_LAYOUT;
+}
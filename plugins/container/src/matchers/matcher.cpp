@@ -8,65 +8,264 @@
 #include "libvirt_lxc.h"
 #include "static_container.h"
 
-matcher_manager::matcher_manager(const Engines& cfg)
+#include <plugin_toolkit/pod_uid.h>
+
+// Uid of the pod named by `cgroup`, empty if none
+static void find_pod_uid(const std::string& cgroup, std::string& pod_uid)
+{
+    char uid[POD_UID_LEN];
+    if(scan_pod_uid(cgroup, uid))
+    {
+        pod_uid.assign(uid, POD_UID_LEN);
+    }
+    else
+    {
+        pod_uid.clear();
+    }
+}
+
+matcher_manager::matcher_manager(const Engines& cfg, size_t cache_size):
+        m_cache_max_size(cache_size)
 {
     if(cfg.static_ctr.enabled)
     {
         // Configured with a static engine; add it and return.
         auto engine = std::make_shared<static_container>(
                 cfg.static_ctr.id, cfg.static_ctr.name, cfg.static_ctr.image);
-        m_matchers.push_back(engine);
+        add_matcher("static", engine);
+        compile_runc_layouts();
         return;
     }
 
     if(cfg.podman.enabled)
     {
         auto podman_engine = std::make_shared<podman>();
-        m_matchers.push_back(podman_engine);
+        add_matcher("podman", podman_engine);
     }
     if(cfg.docker.enabled)
     {
         auto docker_engine = std::make_shared<docker>();
-        m_matchers.push_back(docker_engine);
+        add_matcher("docker", docker_engine);
     }
     if(cfg.cri.enabled)
     {
         auto cri_engine = std::make_shared<cri>();
-        m_matchers.push_back(cri_engine);
+        add_matcher("cri", cri_engine);
     }
     if(cfg.containerd.enabled)
     {
         auto containerd_engine = std::make_shared<containerd>();
-        m_matchers.push_back(containerd_engine);
+        add_matcher("containerd", containerd_engine);
     }
     if(cfg.lxc.enabled)
     {
         auto lxc_engine = std::make_shared<lxc>();
-        m_matchers.push_back(lxc_engine);
+        add_matcher("lxc", lxc_engine);
     }
     if(cfg.libvirt_lxc.enabled)
     {
         auto libvirt_lxc_engine = std::make_shared<libvirt_lxc>();
-        m_matchers.push_back(libvirt_lxc_engine);
+        add_matcher("libvirt_lxc", libvirt_lxc_engine);
     }
     if(cfg.bpm.enabled)
     {
         auto bpm_engine = std::make_shared<bpm>();
-        m_matchers.push_back(bpm_engine);
+        add_matcher("bpm", bpm_engine);
     }
+    compile_runc_layouts();
 }
 
-bool matcher_manager::match_cgroup(const std::string& cgroup,
-                                   std::string& container_id,
-                                   container_info::ptr_t& ctr)
+void matcher_manager::add_matcher(const std::string& name,
+                                  std::shared_ptr<cgroup_matcher> matcher)
 {
+    m_matchers.push_back(std::move(matcher));
+    m_matcher_names.push_back(name);
+    m_matcher_hits.push_back(0);
+}
+
+void matcher_manager::compile_runc_layouts()
+{
+    for(const auto& matcher : m_matchers)
+    {
+        auto layout = matcher->get_runc_layout();
+        m_runc_layouts.push_back(
+                layout != nullptr ? (int64_t)m_scanner.add(layout) : -1);
+    }
+}
+
+bool matcher_manager::match_cgroup_uncached(
+        const std::string& cgroup, std::string& container_id,
+        std::shared_ptr<cgroup_matcher>& matched, size_t& matched_idx)
+{
+    bool scanned = false;
+    auto layout = m_runc_layouts.begin();
+    size_t idx = 0;
     for(const auto& matcher : m_matchers)
     {
-        if(matcher->resolve(cgroup, container_id))
+        bool found;
+        if(*layout >= 0)
+        {
+            // One pass finds the patterns of all the runc layouts
+            if(!scanned)
+            {
+                m_scanner.scan(cgroup);
+                scanned = true;
+            }
+            found = m_scanner.match(*layout, cgroup, container_id);
+        }
+        else
         {
-            ctr = matcher->to_container(container_id);
+            found = matcher->resolve(cgroup, container_id);
+        }
+        if(found)
+        {
+            matched = matcher;
+            matched_idx = idx;
             return true;
         }
+        ++layout;
+        idx++;
     }
     return false;
-}
\ No newline at end of file
+}
+
+bool matcher_manager::match_cgroup(const std::string& cgroup,
+                                   std::string& container_id,
+                                   container_info::ptr_t& ctr,
+                                   std::string* pod_uid)
+{
+    if(m_cache_max_size == 0)
+    {
+        std::shared_ptr<cgroup_matcher> matcher;
+        size_t idx;
+        if(!match_cgroup_uncached(cgroup, container_id, matcher, idx))
+        {
+            m_unmatched++;
+            return false;
+        }
+        m_matcher_hits[idx]++;
+        ctr = matcher->to_container(container_id);
+        if(pod_uid != nullptr)
+        {
+            find_pod_uid(cgroup, *pod_uid);
+        }
+        return true;
+    }
+
+    auto it = m_cache.find(cgroup);
+    if(it != m_cache.end())
+    {
+        m_cache_hits++;
+        m_cache_lru.splice(m_cache_lru.begin(), m_cache_lru, it->second);
+    }
+    else
+    {
+        m_cache_misses++;
+        if(m_cache.size() >= m_cache_max_size)
+        {
+            erase_entry(std::prev(m_cache_lru.end()));
+        }
+        cache_entry entry;
+        entry.cgroup = cgroup;
+        // The pod uid is found once per cgroup, along the match
+        if(match_cgroup_uncached(cgroup, entry.container_id, entry.matcher,
+                                 entry.matcher_idx))
+        {
+            find_pod_uid(cgroup, entry.pod_uid);
+        }
+        m_cache_lru.push_front(std::move(entry));
+        it = m_cache.emplace(m_cache_lru.front().cgroup, m_cache_lru.begin())
+                     .first;
+    }
+
+    return use_entry(*it->second, container_id, ctr, pod_uid);
+}
+
+bool matcher_manager::match_cgroup_id(uint64_t cgroup_id, bool& matched,
+                                      std::string& container_id,
+                                      container_info::ptr_t& ctr,
+                                      std::string* pod_uid)
+{
+    auto it = m_cache_ids.find(cgroup_id);
+    if(it == m_cache_ids.end())
+    {
+        return false;
+    }
+    m_cache_hits++;
+    m_cache_lru.splice(m_cache_lru.begin(), m_cache_lru, it->second);
+    matched = use_entry(*it->second, container_id, ctr, pod_uid);
+    return true;
+}
+
+void matcher_manager::bind_cgroup_id(const std::string& cgroup,
+                                     uint64_t cgroup_id)
+{
+    auto it = m_cache.find(cgroup);
+    if(cgroup_id == 0 || it == m_cache.end() ||
+       it->second->cgroup_id == cgroup_id)
+    {
+        return;
+    }
+    auto& entry = *it->second;
+    if(entry.cgroup_id != 0)
+    {
+        m_cache_ids.erase(entry.cgroup_id);
+    }
+    // The id of a removed cgroup may only be reused by a new cgroup once
+    // its entry got evicted, unless the kernel wraps 64 bits: replace the
+    // binding anyway
+    auto old = m_cache_ids.find(cgroup_id);
+    if(old != m_cache_ids.end())
+    {
+        old->second->cgroup_id = 0;
+        m_cache_ids.erase(old);
+    }
+    entry.cgroup_id = cgroup_id;
+    m_cache_ids.emplace(cgroup_id, it->second);
+}
+
+bool matcher_manager::use_entry(const cache_entry& entry,
+                                std::string& container_id,
+                                container_info::ptr_t& ctr,
+                                std::string* pod_uid)
+{
+    if(entry.matcher == nullptr)
+    {
+        m_unmatched++;
+        return false;
+    }
+    m_matcher_hits[entry.matcher_idx]++;
+    container_id = entry.container_id;
+    ctr = entry.matcher->to_container(container_id);
+    if(pod_uid != nullptr)
+    {
+        *pod_uid = entry.pod_uid;
+    }
+    return true;
+}
+
+std::list<matcher_manager::cache_entry>::iterator
+matcher_manager::erase_entry(std::list<cache_entry>::iterator it)
+{
+    if(it->cgroup_id != 0)
+    {
+        m_cache_ids.erase(it->cgroup_id);
+    }
+    m_cache.erase(it->cgroup);
+    return m_cache_lru.erase(it);
+}
+
+void matcher_manager::forget_container(const std::string& container_id)
+{
+    for(auto it = m_cache_lru.begin(); it != m_cache_lru.end();)
+    {
+        if(it->matcher != nullptr && it->container_id == container_id)
+        {
+            it = erase_entry(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
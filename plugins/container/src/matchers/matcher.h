@@ -2,7 +2,13 @@
 
 #include "../container_info.h"
 #include "../plugin_config.h"
+#include "runc.h"
 #include <list>
+#include <string_view>
+#include <unordered_map>
+
+// Default number of cgroup paths whose match result is cached
+#define CGROUP_CACHE_DEFAULT_SIZE 4096
 
 class cgroup_matcher
 {
@@ -18,16 +24,111 @@ class cgroup_matcher
     {
         return nullptr;
     }
+
+    /// Engines whose cgroups follow runc (prefix, suffix) layouts expose them,
+    /// so that the manager matches all of them in a single pass; `resolve()`
+    /// is then only used if the matcher is used on its own.
+    virtual const libsinsp::runc::cgroup_layout* get_runc_layout() const
+    {
+        return nullptr;
+    }
 };
 
 class matcher_manager
 {
     public:
-    matcher_manager(const Engines& cfg);
+    matcher_manager(const Engines& cfg,
+                    size_t cache_size = CGROUP_CACHE_DEFAULT_SIZE);
 
+    /// If `pod_uid` is given, it is set to the uid of the pod of the matched
+    /// container, or cleared if the cgroup names no pod.
     bool match_cgroup(const std::string& cgroup, std::string& container_id,
-                      container_info::ptr_t& ctr);
+                      container_info::ptr_t& ctr,
+                      std::string* pod_uid = nullptr);
+
+    /// Resolution keyed on the cgroup id (the cgroupfs inode on cgroup v2) of
+    /// a cgroup path previously bound to it, see `bind_cgroup_id`: an integer
+    /// lookup without any string parsing. Returns false if the id is unknown,
+    /// otherwise sets `matched` to the match result of the cgroup path.
+    bool match_cgroup_id(uint64_t cgroup_id, bool& matched,
+                         std::string& container_id, container_info::ptr_t& ctr,
+                         std::string* pod_uid = nullptr);
+
+    /// Bind `cgroup_id` to the cached match result of `cgroup`, once the path
+    /// got matched; a no-op if the path is not cached, eg: cache disabled.
+    /// Ids share the entries of the path cache, and its bound.
+    void bind_cgroup_id(const std::string& cgroup, uint64_t cgroup_id);
+
+    size_t get_cgroup_ids_size() const { return m_cache_ids.size(); }
+
+    /// Drop the cached cgroups resolving to `container_id`,
+    /// eg: when the container gets removed.
+    void forget_container(const std::string& container_id);
+
+    size_t get_cache_size() const { return m_cache.size(); }
+
+    /// Engine name of each matcher, in matching order
+    const std::vector<std::string>& get_matcher_names() const
+    {
+        return m_matcher_names;
+    }
+    /// Matched cgroups of each matcher, cached results included
+    const std::vector<uint64_t>& get_matcher_hits() const
+    {
+        return m_matcher_hits;
+    }
+    /// Cgroups matching no engine, eg: host processes
+    uint64_t get_unmatched() const { return m_unmatched; }
+    uint64_t get_cache_hits() const { return m_cache_hits; }
+    uint64_t get_cache_misses() const { return m_cache_misses; }
 
     private:
+    /// Match result of a cgroup path; cgroups matching no engine (eg: host
+    /// processes) are cached too, with an empty `container_id` and no matcher.
+    struct cache_entry
+    {
+        std::string cgroup;
+        std::string container_id;
+        std::shared_ptr<cgroup_matcher> matcher;
+        size_t matcher_idx;
+        // Empty for the containers out of any pod
+        std::string pod_uid;
+        // 0 if unbound
+        uint64_t cgroup_id = 0;
+    };
+
+    // Fill the match result of `entry`, updating the stats
+    bool use_entry(const cache_entry& entry, std::string& container_id,
+                   container_info::ptr_t& ctr, std::string* pod_uid);
+    std::list<cache_entry>::iterator
+    erase_entry(std::list<cache_entry>::iterator it);
+
+    void add_matcher(const std::string& name,
+                     std::shared_ptr<cgroup_matcher> matcher);
+    void compile_runc_layouts();
+    bool match_cgroup_uncached(const std::string& cgroup,
+                               std::string& container_id,
+                               std::shared_ptr<cgroup_matcher>& matched,
+                               size_t& matched_idx);
+
     std::list<std::shared_ptr<cgroup_matcher>> m_matchers;
+    std::vector<std::string> m_matcher_names;
+    std::vector<uint64_t> m_matcher_hits;
+    uint64_t m_unmatched = 0;
+    uint64_t m_cache_hits = 0;
+    uint64_t m_cache_misses = 0;
+    // Handle of each matcher runc layout in `m_scanner`, in `m_matchers`
+    // order, or -1 if the matcher has none.
+    std::vector<int64_t> m_runc_layouts;
+    libsinsp::runc::layout_scanner m_scanner;
+
+    // LRU cache of the match results, since matching only depends on the
+    // cgroup path and busy containers fork a lot with few distinct paths.
+    // Most recently used entries first; map keys point into the list entries.
+    size_t m_cache_max_size;
+    std::list<cache_entry> m_cache_lru;
+    std::unordered_map<std::string_view, std::list<cache_entry>::iterator>
+            m_cache;
+    // Bound cgroup ids of the cached entries
+    std::unordered_map<uint64_t, std::list<cache_entry>::iterator> m_cache_ids;
 };
\ No newline at end of file
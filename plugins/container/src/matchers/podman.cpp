@@ -16,4 +16,9 @@ constexpr const cgroup_layout ROOT_PODMAN_CGROUP_LAYOUT[] = {
 bool podman::resolve(const std::string& cgroup, std::string& container_id)
 {
     return matches_runc_cgroup(cgroup, ROOT_PODMAN_CGROUP_LAYOUT, container_id);
-}
\ No newline at end of file
+}
+
+const cgroup_layout* podman::get_runc_layout() const
+{
+    return ROOT_PODMAN_CGROUP_LAYOUT;
+}
@@ -1,5 +1,8 @@
 #include "runc.h"
 
+#include <cstring>
+#include <stdexcept>
+
 namespace
 {
 const size_t CONTAINER_ID_LENGTH = 64;
@@ -21,27 +24,14 @@ inline static bool endswith(const std::string &s, const std::string &suffix)
     return s.rfind(suffix) == (s.size() - suffix.size());
 }
 
-// check if cgroup ends with <prefix><container_id><suffix>
+// check if cgroup holds <container_id> between start_pos, right after the
+// last occurrence of a prefix, and end_pos, the last occurrence of a suffix.
 // If true, set <container_id> to a truncated version of the id and return true.
 // Otherwise return false and leave container_id unchanged
-bool match_one_container_id(const std::string &cgroup,
-                            const std::string &prefix,
-                            const std::string &suffix,
-                            std::string &container_id, bool is_containerd)
+static bool match_container_id_at(const std::string &cgroup, size_t start_pos,
+                                  size_t end_pos, std::string &container_id,
+                                  bool is_containerd)
 {
-    size_t start_pos = cgroup.rfind(prefix);
-    if(start_pos == std::string::npos)
-    {
-        return false;
-    }
-    start_pos += prefix.size();
-
-    size_t end_pos = cgroup.rfind(suffix);
-    if(end_pos == std::string::npos)
-    {
-        return false;
-    }
-
     if(end_pos - start_pos == CONTAINER_ID_LENGTH &&
        cgroup.find_first_not_of(CONTAINER_ID_VALID_CHARACTERS, start_pos) >=
                CONTAINER_ID_LENGTH)
@@ -74,6 +64,31 @@ bool match_one_container_id(const std::string &cgroup,
     return false;
 }
 
+// check if cgroup ends with <prefix><container_id><suffix>
+// If true, set <container_id> to a truncated version of the id and return true.
+// Otherwise return false and leave container_id unchanged
+bool match_one_container_id(const std::string &cgroup,
+                            const std::string &prefix,
+                            const std::string &suffix,
+                            std::string &container_id, bool is_containerd)
+{
+    size_t start_pos = cgroup.rfind(prefix);
+    if(start_pos == std::string::npos)
+    {
+        return false;
+    }
+    start_pos += prefix.size();
+
+    size_t end_pos = cgroup.rfind(suffix);
+    if(end_pos == std::string::npos)
+    {
+        return false;
+    }
+
+    return match_container_id_at(cgroup, start_pos, end_pos, container_id,
+                                 is_containerd);
+}
+
 bool matches_runc_cgroup(const std::string &cgroup,
                          const libsinsp::runc::cgroup_layout *layout,
                          std::string &container_id, bool is_containerd)
@@ -88,5 +103,97 @@ bool matches_runc_cgroup(const std::string &cgroup,
     }
     return false;
 }
+
+size_t layout_scanner::pattern_id(const char *pattern)
+{
+    for(size_t i = 0; i < m_patterns.size(); i++)
+    {
+        if(m_patterns[i] == pattern)
+        {
+            return i;
+        }
+    }
+    if(m_patterns.size() == max_patterns)
+    {
+        throw std::length_error("too many cgroup layout patterns");
+    }
+    m_patterns.emplace_back(pattern);
+    if(*pattern != '\0')
+    {
+        m_first_char[(uint8_t)*pattern] |= 1ULL << (m_patterns.size() - 1);
+    }
+    m_last.push_back(std::string::npos);
+    return m_patterns.size() - 1;
+}
+
+size_t layout_scanner::add(const cgroup_layout *layout)
+{
+    std::vector<std::pair<size_t, size_t>> ids;
+    for(size_t i = 0; layout[i].prefix && layout[i].suffix; ++i)
+    {
+        ids.emplace_back(pattern_id(layout[i].prefix),
+                         pattern_id(layout[i].suffix));
+    }
+    m_layouts.push_back(std::move(ids));
+    return m_layouts.size() - 1;
+}
+
+void layout_scanner::scan(const std::string &cgroup)
+{
+    // Patterns not found yet; the empty one always occurs last at the end,
+    // like `rfind("")` does.
+    uint64_t pending = 0;
+    for(size_t i = 0; i < m_patterns.size(); i++)
+    {
+        if(m_patterns[i].empty())
+        {
+            m_last[i] = cgroup.size();
+        }
+        else
+        {
+            m_last[i] = std::string::npos;
+            pending |= 1ULL << i;
+        }
+    }
+
+    const char *data = cgroup.data();
+    for(size_t pos = cgroup.size(); pos-- > 0 && pending != 0;)
+    {
+        uint64_t candidates = m_first_char[(uint8_t)data[pos]] & pending;
+        while(candidates != 0)
+        {
+            size_t i = __builtin_ctzll(candidates);
+            candidates &= candidates - 1;
+            const auto &pattern = m_patterns[i];
+            if(pattern.size() <= cgroup.size() - pos &&
+               std::memcmp(data + pos, pattern.data(), pattern.size()) == 0)
+            {
+                m_last[i] = pos;
+                pending &= ~(1ULL << i);
+            }
+        }
+    }
+}
+
+bool layout_scanner::match(size_t handle, const std::string &cgroup,
+                           std::string &container_id, bool is_containerd) const
+{
+    for(const auto &[prefix, suffix] : m_layouts[handle])
+    {
+        size_t start_pos = m_last[prefix];
+        size_t end_pos = m_last[suffix];
+        if(start_pos == std::string::npos || end_pos == std::string::npos)
+        {
+            continue;
+        }
+        start_pos += m_patterns[prefix].size();
+        if(match_container_id_at(cgroup, start_pos, end_pos, container_id,
+                                 is_containerd))
+        {
+            return true;
+        }
+    }
+    return false;
+}
 } // namespace runc
 } // namespace libsinsp
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -58,5 +60,53 @@ bool match_one_container_id(const std::string &cgroup,
 bool matches_runc_cgroup(const std::string &cgroup,
                          const libsinsp::runc::cgroup_layout *layout,
                          std::string &container_id, bool is_containerd = false);
+
+/**
+ * @brief Match a cgroup against the layouts of several engines in one pass
+ *
+ * Matching a layout looks for the last occurrence of its prefix and suffix,
+ * hence trying each layout of each engine in turn scans the cgroup path
+ * once per pattern. The scanner collects the distinct prefixes and suffixes
+ * of all the registered layouts and finds the last occurrence of all of them
+ * with a single backward pass, only comparing patterns at positions holding
+ * one of their first characters. Layouts are then matched against the found
+ * positions, with the very same semantics as `matches_runc_cgroup()`.
+ */
+class layout_scanner
+{
+    public:
+    /**
+     * @brief Register `layout`, an array terminated by an empty entry
+     * @return the handle to pass to `match()`
+     */
+    size_t add(const cgroup_layout *layout);
+
+    /**
+     * @brief Find the patterns of all the registered layouts in `cgroup`,
+     * must be called before `match()` for each new cgroup
+     */
+    void scan(const std::string &cgroup);
+
+    /**
+     * @brief Same as `matches_runc_cgroup()` for the layout `handle`, on the
+     * cgroup last passed to `scan()`
+     */
+    bool match(size_t handle, const std::string &cgroup,
+               std::string &container_id, bool is_containerd = false) const;
+
+    private:
+    // At most 64 distinct patterns, one bit each
+    static constexpr size_t max_patterns = 64;
+
+    size_t pattern_id(const char *pattern);
+
+    std::vector<std::string> m_patterns;
+    // Bitmask of the patterns starting with each character
+    std::array<uint64_t, 256> m_first_char = {};
+    // (prefix, suffix) pattern ids of each registered layout
+    std::vector<std::vector<std::pair<size_t, size_t>>> m_layouts;
+    // Last position of each pattern in the scanned cgroup, or npos
+    std::vector<size_t> m_last;
+};
 } // namespace runc
 } // namespace libsinsp
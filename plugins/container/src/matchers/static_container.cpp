@@ -71,10 +71,13 @@ static_container::static_container(const std::string& id,
     m_static_container_info->m_image = image;
     std::string hostname;
     std::string port;
-    split_container_image(m_static_container_info->m_image, hostname, port,
-                          m_static_container_info->m_imagerepo,
-                          m_static_container_info->m_imagetag,
-                          m_static_container_info->m_imagedigest);
+    std::string repo;
+    std::string tag;
+    std::string digest;
+    split_container_image(image, hostname, port, repo, tag, digest);
+    m_static_container_info->m_imagerepo = repo;
+    m_static_container_info->m_imagetag = tag;
+    m_static_container_info->m_imagedigest = digest;
 }
 
 bool static_container::resolve(const std::string& cgroup,
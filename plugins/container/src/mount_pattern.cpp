@@ -0,0 +1,122 @@
+#include "mount_pattern.h"
+
+#include <cstring>
+#include <reflex/matcher.h>
+
+// Regex operators, plus quotes that the regex syntax also supports
+static const char* const s_regex_chars = "\\^$*+?()[]{}|\"";
+
+mount_pattern::mount_pattern(const std::string& pattern):
+        m_pattern(pattern), m_kind(MP_REGEX), m_wildcards(false)
+{
+    size_t begin = 0;
+    size_t end = pattern.size();
+    bool prefix = end > 0 && pattern[0] == '^';
+    if(prefix)
+    {
+        begin++;
+    }
+    bool suffix = end > begin && pattern[end - 1] == '$';
+    if(suffix)
+    {
+        end--;
+    }
+
+    auto literal = pattern.substr(begin, end - begin);
+    if(literal.find_first_of(s_regex_chars) != std::string::npos)
+    {
+        return;
+    }
+
+    m_literal = std::move(literal);
+    m_wildcards = m_literal.find('.') != std::string::npos;
+    if(prefix && suffix)
+    {
+        m_kind = MP_EQUAL;
+    }
+    else if(prefix)
+    {
+        m_kind = MP_PREFIX;
+    }
+    else if(suffix)
+    {
+        m_kind = MP_SUFFIX;
+    }
+    else
+    {
+        m_kind = MP_SUBSTRING;
+    }
+}
+
+mount_pattern::~mount_pattern() = default;
+
+bool mount_pattern::match_at(const std::string& s, size_t pos) const
+{
+    if(!m_wildcards)
+    {
+        return s.compare(pos, m_literal.size(), m_literal) == 0;
+    }
+    for(size_t i = 0; i < m_literal.size(); i++)
+    {
+        char c = s[pos + i];
+        if(m_literal[i] == '.' ? c == '\n' : c != m_literal[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool mount_pattern::match_regex(const std::string& s) const
+{
+    if(!m_regex)
+    {
+        // enable multiline matching to match "^..."
+        m_regex = std::make_unique<reflex::Pattern>(m_pattern, "(?m)");
+        m_matcher = std::make_unique<reflex::Matcher>(*m_regex);
+    }
+    m_matcher->input(s.c_str());
+    return m_matcher->find() != 0;
+}
+
+bool mount_pattern::match(const std::string& path) const
+{
+    if(m_kind == MP_REGEX)
+    {
+        return match_regex(path);
+    }
+    if(path.size() < m_literal.size())
+    {
+        return false;
+    }
+
+    // Anchors also match around new lines, leave those rare paths to the
+    // regex
+    if(m_kind != MP_SUBSTRING && path.find('\n') != std::string::npos)
+    {
+        return match_regex(path);
+    }
+
+    switch(m_kind)
+    {
+    case MP_PREFIX:
+        return match_at(path, 0);
+    case MP_SUFFIX:
+        return match_at(path, path.size() - m_literal.size());
+    case MP_EQUAL:
+        return path.size() == m_literal.size() && match_at(path, 0);
+    default:
+        if(!m_wildcards)
+        {
+            return path.find(m_literal) != std::string::npos;
+        }
+        for(size_t pos = 0; pos + m_literal.size() <= path.size(); pos++)
+        {
+            if(match_at(path, pos))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
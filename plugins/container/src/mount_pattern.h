@@ -0,0 +1,59 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+namespace reflex
+{
+class Pattern;
+class Matcher;
+} // namespace reflex
+
+/*
+ * Pattern of the container.mount*[...] fields argument, matched against
+ * mount sources or destinations as a multiline regex search, as libsinsp
+ * does.
+ *
+ * Arguments are fixed paths most of the time, eg:
+ * `container.mount.source[/var/run/docker.sock]`. Patterns only made of
+ * literal characters, `.` wildcards and leading `^` or trailing `$` anchors
+ * are thus matched with plain string comparisons; any other pattern is
+ * compiled to a regex once and for all.
+ */
+class mount_pattern
+{
+    public:
+    enum kind
+    {
+        MP_SUBSTRING, // "docker.sock"
+        MP_PREFIX,    // "^/var/run"
+        MP_SUFFIX,    // "docker.sock$"
+        MP_EQUAL,     // "^/var/run/docker.sock$"
+        MP_REGEX      // anything else
+    };
+
+    explicit mount_pattern(const std::string& pattern);
+    ~mount_pattern();
+
+    bool match(const std::string& path) const;
+
+    kind get_kind() const { return m_kind; }
+    // The pattern without its anchors, for non regex patterns
+    const std::string& get_literal() const { return m_literal; }
+    // Whether the literal holds `.` wildcards
+    bool has_wildcards() const { return m_wildcards; }
+
+    private:
+    // Whether the literal matches `s` at `pos`
+    bool match_at(const std::string& s, size_t pos) const;
+    bool match_regex(const std::string& s) const;
+
+    std::string m_pattern;
+    kind m_kind;
+    std::string m_literal;
+    bool m_wildcards;
+    // Compiled on first use, as anchors of literal patterns still need the
+    // regex semantics on multiline paths
+    mutable std::unique_ptr<reflex::Pattern> m_regex;
+    mutable std::unique_ptr<reflex::Matcher> m_matcher;
+};
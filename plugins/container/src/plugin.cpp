@@ -17,6 +17,12 @@ limitations under the License.
 
 #include "plugin.h"
 #include "plugin_config_schema.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unordered_set>
+
 #ifdef _HAS_ASYNC
 #include "caps/async/async.tpp"
 #endif
@@ -44,6 +50,13 @@ void my_plugin::destroy()
 {
     m_logger.log("detach the plugin",
                  falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
+    if(m_warm_cache != nullptr)
+    {
+        // Waits for the pending snapshot, the last one for the next plugin
+        // instance is written right away
+        m_warm_cache.reset();
+        snapshot_warm_cache(true);
+    }
 }
 
 falcosecurity::init_schema my_plugin::get_init_schema()
@@ -79,6 +92,25 @@ bool my_plugin::init(falcosecurity::init_input& in)
 
     auto cfg = nlohmann::json::parse(in.get_config());
     parse_init_config(cfg);
+#ifdef _HAS_EXTRACT
+    try
+    {
+        m_cfg.pruned_sections = get_pruned_sections(m_cfg.required_fields);
+    }
+    catch(const std::exception& e)
+    {
+        m_lasterr = fmt::format("invalid init config: {}", e.what());
+        m_logger.log(m_lasterr,
+                     falcosecurity::_internal::SS_PLUGIN_LOG_SEV_CRITICAL);
+        return false;
+    }
+    if(m_cfg.pruned_sections != 0)
+    {
+        m_logger.log(fmt::format("pruning the container info sections {:#x}",
+                                 m_cfg.pruned_sections),
+                     falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
+    }
+#endif
 
     m_logger.log("init the plugin",
                  falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
@@ -133,6 +165,10 @@ bool my_plugin::init(falcosecurity::init_input& in)
         m_container_id_field = m_threads_table.add_field(
                 t.fields(), CONTAINER_ID_FIELD_NAME, st::SS_PLUGIN_ST_STRING);
 
+        // Add the pod_uid field into thread table, read by k8smeta
+        m_pod_uid_field = m_threads_table.add_field(
+                t.fields(), POD_UID_FIELD_NAME, st::SS_PLUGIN_ST_STRING);
+
         // Add the category field into thread table
         m_threads_field_category = m_threads_table.add_field(
                 t.fields(), CATEGORY_FIELD_NAME, st::SS_PLUGIN_ST_UINT16);
@@ -147,8 +183,26 @@ bool my_plugin::init(falcosecurity::init_input& in)
         return false;
     }
 
+    // Not all the frameworks expose the cgroup id of the threads, resolve
+    // containers from the cgroup paths only then
+    try
+    {
+        m_threads_field_cgroup_id = m_threads_table.get_field(
+                t.fields(), CGROUP_ID_FIELD_NAME, st::SS_PLUGIN_ST_UINT64);
+        m_has_cgroup_id = true;
+    }
+    catch(const std::exception& e)
+    {
+        m_logger.log(fmt::format("no '{}' field in the '{}' table, "
+                                 "resolving containers by cgroup path: {}",
+                                 CGROUP_ID_FIELD_NAME, THREAD_TABLE_NAME,
+                                 e.what()),
+                     falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
+    }
+
     // Initialize dummy host container entry
-    m_containers[""] = container_info::host_container_info();
+    m_containers.set("", container_info::host_container_info());
+    restore_warm_cache();
 
     // Initialize metrics
     falcosecurity::metric n_container(METRIC_N_CONTAINERS);
@@ -159,11 +213,47 @@ bool my_plugin::init(falcosecurity::init_input& in)
     n_missing.set_value(0);
     m_metrics.push_back(n_missing);
 
+    m_metrics.emplace_back(
+            METRIC_N_REQUESTS_HITS,
+            falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(
+            METRIC_N_REQUESTS_MISSES,
+            falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_REQUESTS_PENDING);
+    m_metrics.emplace_back(METRIC_N_CONTAINERS_MEMORY);
+    m_metrics.emplace_back(
+            METRIC_N_EVICTED,
+            falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_WARM_CACHE_RESTORED);
+    m_metrics.emplace_back(
+            METRIC_N_WARM_CACHE_WRITES,
+            falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(
+            METRIC_N_WARM_CACHE_WRITE_ERRORS,
+            falcosecurity::metric_type::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    init_stats_metrics();
+    for(size_t i = 2; i < m_metrics.size(); i++)
+    {
+        m_metrics[i].set_value((uint64_t)0);
+    }
+    m_metrics.at(0).set_value((uint64_t)m_containers.size() - 1);
+
     return true;
 }
 
 const std::vector<falcosecurity::metric>& my_plugin::get_metrics()
 {
+    m_metrics.at(2).set_value(m_container_requests.get_hits());
+    m_metrics.at(3).set_value(m_container_requests.get_misses());
+    m_metrics.at(4).set_value((uint64_t)m_container_requests.get_pending());
+    m_metrics.at(5).set_value((uint64_t)m_containers.memory_usage());
+    m_metrics.at(6).set_value(m_n_evicted);
+    m_metrics.at(7).set_value(m_n_warm_cache_restored);
+    m_metrics.at(8).set_value(
+            m_warm_cache != nullptr ? m_warm_cache->get_n_writes() : 0);
+    m_metrics.at(9).set_value(
+            m_warm_cache != nullptr ? m_warm_cache->get_n_errors() : 0);
+    update_stats_metrics();
     return m_metrics;
 }
 
@@ -173,27 +263,57 @@ FALCOSECURITY_PLUGIN(my_plugin);
 
 std::string my_plugin::compute_container_id_for_thread(
         const falcosecurity::table_entry& thread_entry,
-        const falcosecurity::table_reader& tr, container_info::ptr_t& info)
+        const falcosecurity::table_reader& tr, container_info::ptr_t& info,
+        std::string& pod_uid)
 {
     // retrieve tid cgroups, compute container_id and store it.
     std::string container_id;
     using st = falcosecurity::state_value_type;
 
+    // On cgroup v2 the cgroup id of the thread identifies its only cgroup,
+    // known ids skip the cgroups table altogether
+    uint64_t cgroup_id = 0;
+    if(m_has_cgroup_id)
+    {
+        m_threads_field_cgroup_id.read_value(tr, thread_entry, cgroup_id);
+    }
+    if(cgroup_id != 0)
+    {
+        latency_timer timer(m_stats.match_cgroup);
+        bool matched;
+        if(m_mgr->match_cgroup_id(cgroup_id, matched, container_id, info,
+                                  &pod_uid))
+        {
+            return container_id;
+        }
+    }
+
     // get the cgroups table of the thread
     auto cgroups_table = m_threads_table.get_subtable(
             tr, m_threads_field_cgroups, thread_entry, st::SS_PLUGIN_ST_UINT64);
 
+    size_t n_cgroups = 0;
+    std::string cgroup;
     cgroups_table.iterate_entries(
             tr,
             [&](const falcosecurity::table_entry& e)
             {
+                n_cgroups++;
+                if(!container_id.empty())
+                {
+                    // Already matched, only counting the cgroups
+                    return n_cgroups < 2;
+                }
                 // read the "second" field (aka: the cgroup path)
                 // from the current entry of the cgroups table
-                std::string cgroup;
                 m_cgroups_field_second.read_value(tr, e, cgroup);
                 if(!cgroup.empty())
                 {
-                    m_mgr->match_cgroup(cgroup, container_id, info);
+                    {
+                        latency_timer timer(m_stats.match_cgroup);
+                        m_mgr->match_cgroup(cgroup, container_id, info,
+                                            &pod_uid);
+                    }
                     if(!container_id.empty())
                     {
                         m_logger.log(fmt::format("Matched container_id: {} "
@@ -201,22 +321,29 @@ std::string my_plugin::compute_container_id_for_thread(
                                                  container_id, cgroup),
                                      falcosecurity::_internal::
                                              SS_PLUGIN_LOG_SEV_TRACE);
-                        // break the loop
-                        return false;
+                        // break the loop, unless the cgroups need to be
+                        // counted to bind the cgroup id
+                        return cgroup_id != 0;
                     }
                 }
                 return true;
             });
+
+    // A single cgroup is the cgroup v2 one, bind its id to its path. Host
+    // processes get bound too, ids then skip them as well.
+    if(cgroup_id != 0 && n_cgroups == 1 && !cgroup.empty())
+    {
+        m_mgr->bind_cgroup_id(cgroup, cgroup_id);
+    }
     return container_id;
 }
 
 // Same logic as
 // https://github.com/falcosecurity/libs/blob/a99a36573f59c0e25965b36f8fa4ae1b10c5d45c/userspace/libsinsp/container.cpp#L438
-void my_plugin::write_thread_category(
+uint16_t my_plugin::compute_thread_category(
         const std::shared_ptr<const container_info>& cinfo,
         const falcosecurity::table_entry& thread_entry,
-        const falcosecurity::table_reader& tr,
-        const falcosecurity::table_writer& tw)
+        const falcosecurity::table_reader& tr, uint32_t depth)
 {
     using st = falcosecurity::state_value_type;
 
@@ -224,9 +351,7 @@ void my_plugin::write_thread_category(
     m_threads_field_vpid.read_value(tr, thread_entry, vpid);
     if(vpid == 1)
     {
-        uint16_t category = CAT_CONTAINER;
-        m_threads_field_category.write_value(tw, thread_entry, category);
-        return;
+        return CAT_CONTAINER;
     }
 
     int64_t ptid;
@@ -235,12 +360,19 @@ void my_plugin::write_thread_category(
     {
         auto parent_entry = m_threads_table.get_entry(tr, ptid);
         uint16_t parent_category;
-        m_threads_field_category.read_value(tr, parent_entry, parent_category);
+        if(m_cfg.lazy_category)
+        {
+            parent_category =
+                    get_lazy_category(parent_entry, ptid, tr, depth + 1);
+        }
+        else
+        {
+            m_threads_field_category.read_value(tr, parent_entry,
+                                                parent_category);
+        }
         if(parent_category != CAT_NONE)
         {
-            m_threads_field_category.write_value(tw, thread_entry,
-                                                 parent_category);
-            return;
+            return parent_category;
         }
     }
     catch(...)
@@ -250,32 +382,48 @@ void my_plugin::write_thread_category(
                      falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
     }
 
+    // Most containers have no health probes at all
+    if(cinfo->m_health_probes.empty())
+    {
+        return CAT_NONE;
+    }
+
     // Read "exe" field
     std::string exe;
     m_threads_field_exe.read_value(tr, thread_entry, exe);
-    // Read "args" field: collect args
-    std::vector<std::string> args;
+    // Hash the "args" field, args are only collected on hash hits
+    health_probe_hasher hasher(exe);
     auto args_table = m_threads_table.get_subtable(
             tr, m_threads_field_args, thread_entry, st::SS_PLUGIN_ST_INT64);
-    args_table.iterate_entries(
-            tr,
-            [this, tr, &args](const falcosecurity::table_entry& e)
-            {
-                // read the arg field from the current entry of args
-                // table
-                std::string arg;
-                m_args_field.read_value(tr, e, arg);
-                if(!arg.empty())
+    auto for_each_arg = [this, tr, &args_table](auto f)
+    {
+        std::string arg;
+        args_table.iterate_entries(
+                tr,
+                [this, tr, &arg, &f](const falcosecurity::table_entry& e)
                 {
-                    args.push_back(arg);
-                }
-                return true;
-            });
+                    // read the arg field from the current entry of args
+                    // table
+                    m_args_field.read_value(tr, e, arg);
+                    if(!arg.empty())
+                    {
+                        f(arg);
+                    }
+                    return true;
+                });
+    };
+    for_each_arg([&hasher](const std::string& arg) { hasher.add_arg(arg); });
+    if(!cinfo->may_match_health_probe(hasher.value()))
+    {
+        return CAT_NONE;
+    }
 
+    std::vector<std::string> args;
+    for_each_arg([&args](const std::string& arg) { args.push_back(arg); });
     const auto ptype = cinfo->match_health_probe(exe, args);
     if(ptype == container_health_probe::PT_NONE)
     {
-        return;
+        return CAT_NONE;
     }
 
     bool found_container_init = false;
@@ -310,27 +458,146 @@ void my_plugin::write_thread_category(
     }
     if(!found_container_init)
     {
-        uint16_t category;
         // Each health probe type maps to a command category
         switch(ptype)
         {
         case container_health_probe::PT_NONE:
             break;
         case container_health_probe::PT_HEALTHCHECK:
-            category = CAT_HEALTHCHECK;
-            m_threads_field_category.write_value(tw, thread_entry, category);
-            break;
+            return CAT_HEALTHCHECK;
         case container_health_probe::PT_LIVENESS_PROBE:
-            category = CAT_LIVENESS_PROBE;
-            m_threads_field_category.write_value(tw, thread_entry, category);
-            break;
+            return CAT_LIVENESS_PROBE;
         case container_health_probe::PT_READINESS_PROBE:
-            category = CAT_READINESS_PROBE;
-            m_threads_field_category.write_value(tw, thread_entry, category);
-            break;
+            return CAT_READINESS_PROBE;
         }
-        return;
     }
+    return CAT_NONE;
+}
+
+void my_plugin::write_thread_category(
+        const std::shared_ptr<const container_info>& cinfo,
+        const falcosecurity::table_entry& thread_entry,
+        const falcosecurity::table_reader& tr,
+        const falcosecurity::table_writer& tw)
+{
+    auto category = compute_thread_category(cinfo, thread_entry, tr);
+    if(category != CAT_NONE)
+    {
+        m_threads_field_category.write_value(tw, thread_entry, category);
+    }
+}
+
+uint16_t my_plugin::get_lazy_category(
+        const falcosecurity::table_entry& thread_entry, int64_t tid,
+        const falcosecurity::table_reader& tr, uint32_t depth)
+{
+    auto it = m_lazy_categories.find(tid);
+    if(it != m_lazy_categories.end())
+    {
+        return it->second;
+    }
+
+    // As in `on_new_process`, only threads of known containers have a
+    // category
+    uint16_t category = CAT_NONE;
+    std::string container_id;
+    m_container_id_field.read_value(tr, thread_entry, container_id);
+    auto found = container_id.empty() ? nullptr
+                                      : m_containers.find(container_id);
+    if(found != nullptr && depth < LAZY_CATEGORY_MAX_DEPTH)
+    {
+        category = compute_thread_category(*found, thread_entry, tr, depth);
+    }
+
+    // Entries are dropped on exec and exit, bound missed exits
+    if(m_lazy_categories.size() >= LAZY_CATEGORY_CACHE_MAX_SIZE)
+    {
+        m_lazy_categories.clear();
+    }
+    m_lazy_categories.emplace(tid, category);
+    return category;
+}
+
+
+bool my_plugin::same_cgroups(const falcosecurity::table_entry& thread_entry,
+                             const falcosecurity::table_entry& parent_entry,
+                             const falcosecurity::table_reader& tr)
+{
+    using st = falcosecurity::state_value_type;
+
+    auto cgroups_table = m_threads_table.get_subtable(
+            tr, m_threads_field_cgroups, thread_entry, st::SS_PLUGIN_ST_UINT64);
+    size_t n = 0;
+    cgroups_table.iterate_entries(
+            tr,
+            [&](const falcosecurity::table_entry& e)
+            {
+                if(n == m_cgroups_buf.size())
+                {
+                    m_cgroups_buf.emplace_back();
+                }
+                m_cgroups_field_second.read_value(tr, e, m_cgroups_buf[n++]);
+                return true;
+            });
+
+    auto parent_cgroups_table = m_threads_table.get_subtable(
+            tr, m_threads_field_cgroups, parent_entry, st::SS_PLUGIN_ST_UINT64);
+    size_t i = 0;
+    bool same = true;
+    std::string cgroup;
+    parent_cgroups_table.iterate_entries(
+            tr,
+            [&](const falcosecurity::table_entry& e)
+            {
+                m_cgroups_field_second.read_value(tr, e, cgroup);
+                same = i < n && cgroup == m_cgroups_buf[i++];
+                return same;
+            });
+    return same && i == n;
+}
+
+// Fast path for clone/fork/vfork/clone3 children: a child shares its parent's
+// cgroups, hence its container, unless it was cloned into another cgroup
+// (CLONE_INTO_CGROUP) or it is the init of a new container. Copy the
+// container_id and category of the parent instead of matching the cgroups and
+// the health probes again.
+bool my_plugin::inherit_parent_container(
+        const falcosecurity::table_entry& thread_entry,
+        const falcosecurity::table_reader& tr,
+        const falcosecurity::table_writer& tw)
+{
+    int64_t vpid, ptid;
+    m_threads_field_vpid.read_value(tr, thread_entry, vpid);
+    if(vpid == 1)
+    {
+        return false;
+    }
+    m_threads_field_ptid.read_value(tr, thread_entry, ptid);
+
+    std::string container_id;
+    uint16_t category;
+    try
+    {
+        auto parent_entry = m_threads_table.get_entry(tr, ptid);
+        m_container_id_field.read_value(tr, parent_entry, container_id);
+        m_pod_uid_field.read_value(tr, parent_entry, m_pod_uid_buf);
+        // The parent may be a host process or not be resolved yet, which
+        // can't be told apart; take the full path.
+        if(container_id.empty() || !same_cgroups(thread_entry, parent_entry, tr))
+        {
+            return false;
+        }
+        m_threads_field_category.read_value(tr, parent_entry, category);
+    }
+    catch(...)
+    {
+        return false;
+    }
+
+    m_container_id_field.write_value(tw, thread_entry, container_id);
+    m_pod_uid_field.write_value(tw, thread_entry, m_pod_uid_buf);
+    m_threads_field_category.write_value(tw, thread_entry, category);
+    return true;
 }
 
 void my_plugin::on_new_process(const falcosecurity::table_entry& thread_entry,
@@ -338,8 +605,12 @@ void my_plugin::on_new_process(const falcosecurity::table_entry& thread_entry,
                                const falcosecurity::table_writer& tw)
 {
     container_info::ptr_t info = nullptr;
-    auto container_id = compute_container_id_for_thread(thread_entry, tr, info);
+    m_pod_uid_buf.clear();
+    auto container_id = compute_container_id_for_thread(thread_entry, tr, info,
+                                                        m_pod_uid_buf);
     m_container_id_field.write_value(tw, thread_entry, container_id);
+    // Cleared as well, an execve may leave the pod of the previous image
+    m_pod_uid_field.write_value(tw, thread_entry, m_pod_uid_buf);
 
     if(info != nullptr)
     {
@@ -348,22 +619,30 @@ void my_plugin::on_new_process(const falcosecurity::table_entry& thread_entry,
         // it means we do not expect to receive any metadata from the go-worker,
         // since the engine has no listener SDK.
         // Just send the event now.
-        nlohmann::json j(info);
-        generate_async_event<ASYNC_HANDLER_DEFAULT>(j.dump().c_str(), true,
-                                                    false);
+        std::string payload;
+        container_info_to_binary(*info, payload);
+        generate_async_event<ASYNC_HANDLER_DEFAULT>(
+                payload.data(), payload.size(), true);
 #endif
         // Immediately cache the container metadata
-        m_containers[info->m_id] = info;
+        m_containers.set(info->m_id, info);
+        evict_containers(tr);
     }
 
     // Write thread category field
     if(!container_id.empty())
     {
-        auto it = m_containers.find(container_id);
-        if(it != m_containers.end())
+        auto found = m_containers.find(container_id);
+        if(found != nullptr)
         {
-            auto cinfo = it->second;
-            write_thread_category(cinfo, thread_entry, tr, tw);
+            auto cinfo = *found;
+            m_containers.touch(container_id);
+            // Computed on the first extraction of the category otherwise,
+            // see `get_lazy_category`
+            if(!m_cfg.lazy_category)
+            {
+                write_thread_category(cinfo, thread_entry, tr, tw);
+            }
         }
         else
         {
@@ -373,32 +652,314 @@ void my_plugin::on_new_process(const falcosecurity::table_entry& thread_entry,
                                      container_id),
                          falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
 #ifdef _HAS_ASYNC
-            // Check if already asked
-            if(m_async_ctx != nullptr &&
-               m_asked_containers.find(container_id) ==
-                       m_asked_containers.end())
+            ask_container_info(container_id, false);
+#endif
+        }
+    }
+}
+
+#ifdef _HAS_ASYNC
+void my_plugin::ask_container_info(const std::string& container_id,
+                                   bool priority)
+{
+    // Check if already asked, or still backing off
+    auto now = monotonic_ns();
+    if(m_async_ctx == nullptr ||
+       !m_container_requests.should_ask(container_id, now, priority))
+    {
+        return;
+    }
+    m_logger.log(fmt::format("asking the go-worker to fetch info for "
+                             "container {}{}",
+                             container_id, priority ? " (priority)" : ""),
+                 falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
+    // Implemented by GO worker.go
+    if(AskForContainerInfo(m_async_ctx, container_id.c_str(),
+                           m_cfg.fetch_timeout_ms, priority))
+    {
+        m_container_requests.on_asked(container_id, now, priority);
+    }
+    else
+    {
+        m_logger.log(fmt::format("failed to ask the plugin to fetch "
+                                 "info for "
+                                 "container {}",
+                                 container_id),
+                     falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
+    }
+}
+#endif
+
+void my_plugin::evict_containers(const falcosecurity::table_reader& tr)
+{
+    // Account for the host entry
+    auto max_size = (size_t)m_cfg.max_containers + 1;
+    if(m_cfg.max_containers == 0 ||
+       m_containers.size() <= std::max(max_size, m_eviction_size))
+    {
+        return;
+    }
+
+    // Containers with live threads are still in use, whatever their last use
+    std::unordered_set<std::string> live;
+    m_threads_table.iterate_entries(
+            tr,
+            [this, &tr, &live](const falcosecurity::table_entry& e)
             {
-                m_logger.log(
-                        fmt::format("asking the go-worker to fetch info for "
-                                    "container {}",
-                                    container_id),
-                        falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
-                // Implemented by GO worker.go
-                if(AskForContainerInfo(m_async_ctx, container_id.c_str()))
-                {
-                    m_asked_containers.insert(container_id);
-                }
-                else
+                std::string container_id;
+                m_container_id_field.read_value(tr, e, container_id);
+                if(!container_id.empty())
                 {
-                    m_logger.log(
-                            fmt::format("failed to ask the plugin to fetch "
-                                        "info for "
-                                        "container {}",
-                                        container_id),
-                            falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
+                    live.insert(std::move(container_id));
                 }
-            }
+                return true;
+            });
+
+    // Evict down to 90% of the limit, not to scan the threads table again
+    // on the next container added
+    auto evicted = m_containers.evict(
+            max_size - m_cfg.max_containers / 10,
+            [&live](const std::string& id)
+            { return id.empty() || live.count(id) != 0; });
+    for(const auto& id : evicted)
+    {
+        m_logger.log(fmt::format("Evicting container: {}", id),
+                     falcosecurity::_internal::SS_PLUGIN_LOG_SEV_TRACE);
+        m_mgr->forget_container(id);
+    }
+    m_n_evicted += evicted.size();
+    m_metrics.at(0).set_value((uint64_t)m_containers.size() - 1);
+
+    // Most containers may be alive, only try again once the table grew by
+    // another 10%
+    m_eviction_size = m_containers.size() + m_cfg.max_containers / 10;
+    m_logger.log(fmt::format("evicted {} containers, {} left", evicted.size(),
+                             m_containers.size() - 1),
+                 falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
+}
+
+void my_plugin::restore_warm_cache()
+{
+    const auto& path = m_cfg.warm_cache.path;
+    if(path.empty())
+    {
+        return;
+    }
+    m_warm_cache = std::make_unique<warm_cache_writer>(path);
+    m_warm_cache_next_ns =
+            monotonic_ns() + m_cfg.warm_cache.interval_s * 1000000000ULL;
+
+    std::vector<container_info::ptr_t> infos;
+    try
+    {
+        auto n_threads = std::max(1u, std::thread::hardware_concurrency());
+        infos = load_warm_cache(path, n_threads, m_cfg.pruned_sections);
+    }
+    catch(const std::exception& e)
+    {
+        // Missing on the first run
+        m_logger.log(fmt::format("no warm cache restored: {}", e.what()),
+                     falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
+        return;
+    }
+    for(const auto& info : infos)
+    {
+        if(info->m_id.empty() || m_containers.contains(info->m_id))
+        {
+            continue;
+        }
+        m_containers.set(info->m_id, info);
+        m_warm_cache_ids.insert(info->m_id);
+    }
+#ifdef _HAS_PARSE
+    for(const auto& info : infos)
+    {
+        if(!info->m_is_pod_sandbox)
+        {
+            link_pod_sandbox(info);
+        }
+    }
 #endif
+    m_n_warm_cache_restored = m_warm_cache_ids.size();
+    // Nothing new to write until the table changes
+    m_warm_cache_generation = m_containers.get_generation();
+    m_logger.log(fmt::format("restored {} containers from the warm cache {}",
+                             m_n_warm_cache_restored, path),
+                 falcosecurity::_internal::SS_PLUGIN_LOG_SEV_INFO);
+}
+
+void my_plugin::reconcile_warm_cache(
+        const std::vector<container_info::ptr_t>& listed)
+{
+    if(m_warm_cache_ids.empty())
+    {
+        return;
+    }
+    // An engine listing some containers is up, its restored containers it
+    // did not list are gone. Those of the other engines are kept, their
+    // engine may only be slow or down, until they get updated or evicted.
+    std::unordered_set<uint32_t> listed_types;
+    for(const auto& info : listed)
+    {
+        if(info != nullptr)
+        {
+            listed_types.insert(info->m_type);
+            m_warm_cache_ids.erase(info->m_id);
+        }
+    }
+    size_t n_dropped = 0;
+    for(const auto& id : m_warm_cache_ids)
+    {
+        auto found = m_containers.find(id);
+        if(found != nullptr && listed_types.count((*found)->m_type) != 0)
+        {
+            m_logger.log(fmt::format("Dropping stale restored container: {}",
+                                     id),
+                         falcosecurity::_internal::SS_PLUGIN_LOG_SEV_TRACE);
+            m_containers.erase(id);
+            m_mgr->forget_container(id);
+            n_dropped++;
+        }
+    }
+    m_warm_cache_ids.clear();
+    m_metrics.at(0).set_value((uint64_t)m_containers.size() - 1);
+    m_logger.log(fmt::format("dropped {} stale restored containers",
+                             n_dropped),
+                 falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
+}
+
+void my_plugin::snapshot_warm_cache(bool sync)
+{
+    if(!sync)
+    {
+        auto n_errors = m_warm_cache->get_n_errors();
+        if(n_errors != m_warm_cache_n_errors)
+        {
+            m_warm_cache_n_errors = n_errors;
+            m_logger.log(fmt::format("cannot write the warm cache: {}",
+                                     m_warm_cache->get_last_error()),
+                         falcosecurity::_internal::SS_PLUGIN_LOG_SEV_WARNING);
+        }
+    }
+    if(m_containers.get_generation() == m_warm_cache_generation)
+    {
+        return;
+    }
+    m_warm_cache_generation = m_containers.get_generation();
+    // Entries are immutable, the writer encodes them on its own thread
+    warm_cache_entries containers;
+    containers.reserve(m_containers.size());
+    for(const auto& c : m_containers)
+    {
+        if(!c.first.empty())
+        {
+            containers.push_back(c.second);
         }
     }
-}
\ No newline at end of file
+    if(!sync)
+    {
+        m_warm_cache->submit(std::move(containers));
+        return;
+    }
+    try
+    {
+        save_warm_cache(m_cfg.warm_cache.path, containers);
+        m_logger.log(fmt::format("saved {} containers to the warm cache {}",
+                                 containers.size(), m_cfg.warm_cache.path),
+                     falcosecurity::_internal::SS_PLUGIN_LOG_SEV_DEBUG);
+    }
+    catch(const std::exception& e)
+    {
+        m_logger.log(fmt::format("cannot write the warm cache: {}", e.what()),
+                     falcosecurity::_internal::SS_PLUGIN_LOG_SEV_WARNING);
+    }
+}
+
+// Keep this aligned with `update_stats_metrics`
+void my_plugin::init_stats_metrics()
+{
+    using mt = falcosecurity::metric_type;
+    m_stats_metrics_offset = m_metrics.size();
+    add_histogram_metrics(m_metrics, METRIC_MATCH_CGROUP_LATENCY);
+    add_histogram_metrics(m_metrics, METRIC_PARSE_ASYNC_EVENT_LATENCY);
+    add_histogram_metrics(m_metrics, METRIC_CONTAINER_REQUEST_LATENCY);
+    add_histogram_metrics(m_metrics, METRIC_CONTAINER_FETCH_LATENCY);
+    add_histogram_metrics(m_metrics, METRIC_ASYNC_EVENT_QUEUE_LATENCY);
+    m_metrics.emplace_back(METRIC_ASYNC_EVENT_PAYLOAD_BYTES,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_CONTAINER_LOOKUP_MISSES,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    for(const auto& engine : m_mgr->get_matcher_names())
+    {
+        m_metrics.emplace_back(METRIC_N_CGROUP_MATCHES_PREFIX + engine,
+                               mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    }
+    m_metrics.emplace_back(METRIC_N_CGROUP_MATCHES_PREFIX "none",
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_CGROUP_CACHE_HITS,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_CGROUP_CACHE_MISSES,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+#ifdef _HAS_ASYNC
+    m_metrics.emplace_back(METRIC_N_FETCH_REQUESTS,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_FETCH_PRIORITY_REQUESTS,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_FETCH_COMPLETED,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_FETCH_TIMEOUTS,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_FETCH_ENGINE_TIMEOUTS,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_FETCHES_IN_FLIGHT,
+                           mt::SS_PLUGIN_METRIC_TYPE_NON_MONOTONIC);
+#endif
+#ifdef _HAS_EXTRACT
+    auto fields = get_fields();
+    m_stats.extract_calls.assign(fields.size(), 0);
+    for(const auto& f : fields)
+    {
+        std::string name = f.name;
+        std::replace(name.begin(), name.end(), '.', '_');
+        m_metrics.emplace_back(METRIC_N_EXTRACT_PREFIX + name,
+                               mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    }
+#endif
+}
+
+void my_plugin::update_stats_metrics()
+{
+    auto idx = m_stats_metrics_offset;
+    set_histogram_metrics(m_metrics, idx, m_stats.match_cgroup);
+    set_histogram_metrics(m_metrics, idx, m_stats.parse_async_event);
+    set_histogram_metrics(m_metrics, idx, m_stats.container_request);
+    set_histogram_metrics(m_metrics, idx, m_stats.container_fetch);
+    set_histogram_metrics(m_metrics, idx, m_stats.async_event_queue);
+    m_metrics.at(idx++).set_value(m_stats.async_payload_bytes);
+    m_metrics.at(idx++).set_value(m_stats.container_lookup_misses);
+    for(auto hits : m_mgr->get_matcher_hits())
+    {
+        m_metrics.at(idx++).set_value(hits);
+    }
+    m_metrics.at(idx++).set_value(m_mgr->get_unmatched());
+    m_metrics.at(idx++).set_value(m_mgr->get_cache_hits());
+    m_metrics.at(idx++).set_value(m_mgr->get_cache_misses());
+#ifdef _HAS_ASYNC
+    // Zeroes while the go-worker is not running
+    fetch_stats fs = {};
+    if(m_async_ctx != nullptr)
+    {
+        GetFetchStats(m_async_ctx, &fs);
+    }
+    m_metrics.at(idx++).set_value(fs.requests);
+    m_metrics.at(idx++).set_value(fs.priority_requests);
+    m_metrics.at(idx++).set_value(fs.completed);
+    m_metrics.at(idx++).set_value(fs.timeouts);
+    m_metrics.at(idx++).set_value(fs.engine_timeouts);
+    m_metrics.at(idx++).set_value(fs.in_flight);
+#endif
+    for(auto n : m_stats.extract_calls)
+    {
+        m_metrics.at(idx++).set_value(n);
+    }
+}
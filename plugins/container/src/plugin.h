@@ -18,9 +18,19 @@ limitations under the License.
 #include <consts.h>
 #include <macros.h>
 #include <matchers/matcher.h>
+#include <container_requests.h>
+#include <container_table.h>
+#include <plugin_toolkit/metrics.h>
+#include <plugin_toolkit/pod_uid.h>
+#include <mount_pattern.h>
+#include <warm_cache.h>
 #include <unordered_map>
 #include <unordered_set>
 
+// Bounds of the lazily computed categories, see `get_lazy_category`
+#define LAZY_CATEGORY_CACHE_MAX_SIZE 65536
+#define LAZY_CATEGORY_MAX_DEPTH 64
+
 enum command_category
 {
     CAT_NONE = 0,
@@ -61,6 +71,7 @@ class my_plugin
     bool start_async_events(
             std::shared_ptr<falcosecurity::async_event_handler_factory> f);
     bool stop_async_events() noexcept;
+    void load_initial_state(const char* data, uint32_t len);
     void
     dump(std::unique_ptr<falcosecurity::async_event_handler> async_handler);
 #endif
@@ -73,6 +84,10 @@ class my_plugin
     std::vector<std::string> get_extract_event_sources();
     std::vector<falcosecurity::field_info> get_fields();
     bool extract(const falcosecurity::extract_fields_input& in);
+    // Sections of the container_info needed by none of the `required_fields`,
+    // 0 if empty. Throws std::runtime_error on unknown fields.
+    uint32_t
+    get_pruned_sections(const std::vector<std::string>& required_fields);
 #endif
 
 #ifdef _HAS_PARSE
@@ -90,6 +105,7 @@ class my_plugin
     bool parse_exit_process_event(const falcosecurity::parse_event_input& in);
     bool parse_new_process_event(const falcosecurity::parse_event_input& in);
     bool parse_event(const falcosecurity::parse_event_input& in);
+    void link_pod_sandbox(const std::shared_ptr<const container_info>& cinfo);
 #endif
 
 #ifdef _HAS_LISTENING
@@ -106,29 +122,124 @@ class my_plugin
     void on_new_process(const falcosecurity::table_entry& thread_entry,
                         const falcosecurity::table_reader& tr,
                         const falcosecurity::table_writer& tw);
+    bool inherit_parent_container(const falcosecurity::table_entry& thread_entry,
+                                  const falcosecurity::table_reader& tr,
+                                  const falcosecurity::table_writer& tw);
+    bool same_cgroups(const falcosecurity::table_entry& thread_entry,
+                      const falcosecurity::table_entry& parent_entry,
+                      const falcosecurity::table_reader& tr);
     std::string compute_container_id_for_thread(
             const falcosecurity::table_entry& thread_entry,
-            const falcosecurity::table_reader& tr, container_info::ptr_t& info);
+            const falcosecurity::table_reader& tr, container_info::ptr_t& info,
+            std::string& pod_uid);
+    uint16_t
+    compute_thread_category(const std::shared_ptr<const container_info>& cinfo,
+                            const falcosecurity::table_entry& thread_entry,
+                            const falcosecurity::table_reader& tr,
+                            uint32_t depth = 0);
     void
     write_thread_category(const std::shared_ptr<const container_info>& cinfo,
                           const falcosecurity::table_entry& thread_entry,
                           const falcosecurity::table_reader& tr,
                           const falcosecurity::table_writer& tw);
+    // Category of the `tid` thread with `lazy_category`, computed once and
+    // memoized. Extraction can't write the threads table, the plugin keeps
+    // the memo; `depth` bounds the walk up the ancestors.
+    uint16_t get_lazy_category(const falcosecurity::table_entry& thread_entry,
+                               int64_t tid,
+                               const falcosecurity::table_reader& tr,
+                               uint32_t depth = 0);
+
+    // Register and refresh the metrics of `m_stats`
+    void init_stats_metrics();
+    void update_stats_metrics();
+
+    // Bound the containers table to `max_containers`, see PluginConfig
+    void evict_containers(const falcosecurity::table_reader& tr);
+
+#ifdef _HAS_ASYNC
+    // Ask the go-worker for the info of a container missing from the cache,
+    // unless already asked. `priority` requests skip the go-worker queue, for
+    // containers whose events are being evaluated.
+    void ask_container_info(const std::string& container_id, bool priority);
+#endif
+
+    // Cache the containers of the warm cache snapshot, if any
+    void restore_warm_cache();
+    // Drop the restored containers missing from the go-worker `listed` ones
+    // while their engine listed some
+    void reconcile_warm_cache(const std::vector<container_info::ptr_t>& listed);
+    // Hand the containers over to the warm cache writer, or write them right
+    // away if `sync`, if they changed since the last snapshot
+    void snapshot_warm_cache(bool sync = false);
 
     falcosecurity::_internal::ss_plugin_table_input& get_table();
 
     private:
     // State table
-    std::unordered_map<std::string, std::shared_ptr<const container_info>>
-            m_containers;
+    container_table m_containers;
     // Last container enriched from an async event parsing.
     // Used to extract container info from aforementioned async events.
     std::shared_ptr<const container_info> m_last_container;
-    // Cache being asked containers to go-worker through AskForContainerInfo()
+    // Containers being asked to go-worker through AskForContainerInfo()
     // API. Avoids repeatedly calling the API.
-    std::unordered_set<std::string> m_asked_containers;
+    container_requests m_container_requests;
+    // Size of the containers table above which containers get evicted, see
+    // `evict_containers`
+    size_t m_eviction_size = 0;
+    uint64_t m_n_evicted = 0;
+    // Warm cache snapshots writer, null if disabled
+    std::unique_ptr<warm_cache_writer> m_warm_cache;
+    // Containers table generation of the last snapshot
+    uint64_t m_warm_cache_generation = 0;
+    uint64_t m_warm_cache_next_ns = 0;
+    // Failed writes already logged
+    uint64_t m_warm_cache_n_errors = 0;
+    // Restored containers not yet confirmed by the go-worker listing
+    std::unordered_set<std::string> m_warm_cache_ids;
+    uint64_t m_n_warm_cache_restored = 0;
+    // Compiled container.mount*[...] field arguments
+    std::unordered_map<std::string, std::unique_ptr<mount_pattern>>
+            m_mount_patterns;
+    // Categories of the threads computed by `get_lazy_category`, by tid
+    std::unordered_map<int64_t, uint16_t> m_lazy_categories;
+    // Scratch buffer holding the cgroups of a thread, see `same_cgroups`
+    std::vector<std::string> m_cgroups_buf;
+    // Container resolved for the thread of the last event extracted from.
+    // `extract` is called once for each requested field, all the fields of
+    // an event share a single thread table read and containers lookup.
+    struct
+    {
+        uint64_t evtnum = UINT64_MAX;
+        int64_t tid = -1;
+        // Whether the thread entry was found
+        bool resolved = false;
+        std::string container_id;
+        std::shared_ptr<const container_info> cinfo;
+    } m_extract_memo;
 
     std::vector<falcosecurity::metric> m_metrics;
+    // Hot path statistics, exported as metrics past the fixed ones, see
+    // `init_stats_metrics`
+    struct
+    {
+        latency_histogram match_cgroup;
+        latency_histogram parse_async_event;
+        uint64_t async_payload_bytes = 0;
+        // From the first request to the go-worker to the container event,
+        // the window during which the events of a new container are not
+        // enriched, made of the two stages below and the parsing
+        latency_histogram container_request;
+        // From the first request to the go-worker queuing the container event
+        latency_histogram container_fetch;
+        // From the go-worker queuing a container event to its parsing
+        latency_histogram async_event_queue;
+        // Events whose container id has no container info
+        uint64_t container_lookup_misses = 0;
+        // Indexed by field id
+        std::vector<uint64_t> extract_calls;
+    } m_stats;
+    size_t m_stats_metrics_offset = 0;
 
     PluginConfig m_cfg;
 
@@ -163,6 +274,15 @@ class my_plugin
     // Accessors to the thread table "cgroups" "second" field, ie: the cgroups
     // path
     falcosecurity::table_field m_cgroups_field_second;
+    // Accessors to the thread table "cgroup_id" field, the cgroup v2 id of
+    // the thread. Optional, see `m_has_cgroup_id`.
+    falcosecurity::table_field m_threads_field_cgroup_id;
+    bool m_has_cgroup_id = false;
     // Accessors to the thread table "container_id" foreign key field
     falcosecurity::table_field m_container_id_field;
+    // Accessors to the thread table "pod_uid" field, published for the
+    // plugins parsing the same events, see `POD_UID_FIELD_NAME`
+    falcosecurity::table_field m_pod_uid_field;
+    // Reused by `on_new_process`
+    std::string m_pod_uid_buf;
 };
\ No newline at end of file
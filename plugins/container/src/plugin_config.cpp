@@ -33,10 +33,26 @@ void from_json(const nlohmann::json& j, Engines& engines)
     engines.containerd = j.value("containerd", SocketsEngine{});
 }
 
+void from_json(const nlohmann::json& j, WarmCache& warm_cache)
+{
+    warm_cache.path = j.value("path", "");
+    warm_cache.interval_s =
+            j.value("interval_s", (uint32_t)DEFAULT_WARM_CACHE_INTERVAL_S);
+}
+
 void from_json(const nlohmann::json& j, PluginConfig& cfg)
 {
     cfg.label_max_len = j.value("label_max_len", DEFAULT_LABEL_MAX_LEN);
     cfg.with_size = j.value("with_size", false);
+    cfg.max_containers = j.value("max_containers", 0u);
+    cfg.lazy_category = j.value("lazy_category", false);
+    cfg.warm_cache = j.value("warm_cache", WarmCache{});
+    cfg.fetch_timeout_ms =
+            j.value("fetch_timeout_ms", (uint32_t)DEFAULT_FETCH_TIMEOUT_MS);
+    cfg.fetch_max_concurrent = j.value("fetch_max_concurrent",
+                                       (uint32_t)DEFAULT_FETCH_MAX_CONCURRENT);
+    cfg.required_fields =
+            j.value("required_fields", std::vector<std::string>{});
 
     std::vector<std::string> hooks =
             j.value("hooks", std::vector<std::string>{"create"});
@@ -127,6 +143,10 @@ void to_json(nlohmann::json& j, const PluginConfig& cfg)
 {
     j["label_max_len"] = cfg.label_max_len;
     j["with_size"] = cfg.with_size;
+    j["max_containers"] = cfg.max_containers;
+    j["lazy_category"] = cfg.lazy_category;
+    j["fetch_max_concurrent"] = cfg.fetch_max_concurrent;
+    j["pruned_sections"] = cfg.pruned_sections;
     j["host_root"] = cfg.host_root;
     j["hooks"] = cfg.hooks;
     j["engines"] = cfg.engines;
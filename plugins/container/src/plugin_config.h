@@ -6,6 +6,10 @@
 
 #define DEFAULT_LABEL_MAX_LEN 100
 
+#define DEFAULT_WARM_CACHE_INTERVAL_S 30
+#define DEFAULT_FETCH_TIMEOUT_MS 1000
+#define DEFAULT_FETCH_MAX_CONCURRENT 4
+
 #define HOOK_CREATE 1
 #define HOOK_START 2
 
@@ -44,6 +48,17 @@ struct StaticEngine
     StaticEngine() { enabled = false; }
 };
 
+struct WarmCache
+{
+    // Snapshot file, empty to disable the warm cache
+    std::string path;
+    // Period of the snapshots while running, 0 to only write one on
+    // plugin destroy
+    uint32_t interval_s;
+
+    WarmCache() { interval_s = DEFAULT_WARM_CACHE_INTERVAL_S; }
+};
+
 struct Engines
 {
     SimpleEngine bpm;
@@ -60,6 +75,22 @@ struct PluginConfig
 {
     int label_max_len;
     bool with_size;
+    // Max number of cached containers, 0 for no limit
+    uint32_t max_containers;
+    // Compute the category of threads on the first extraction of the
+    // proc.is_container_* fields rather than for each new process
+    bool lazy_category;
+    // Containers table snapshot restored on init, see warm_cache.h
+    WarmCache warm_cache;
+    // Deadline of the container info requests to the go-worker
+    uint32_t fetch_timeout_ms;
+    // Max concurrent container info requests to a single engine socket
+    uint32_t fetch_max_concurrent;
+    // Extracted fields the loaded rules rely on, the container_info sections
+    // none of them needs are pruned. Empty to keep all of them.
+    std::vector<std::string> required_fields;
+    // Computed from `required_fields` on init, see CONTAINER_INFO_SECTION_*
+    uint32_t pruned_sections;
     uint8_t hooks;
     std::string host_root;
     Engines engines;
@@ -68,6 +99,11 @@ struct PluginConfig
     {
         label_max_len = DEFAULT_LABEL_MAX_LEN;
         with_size = false;
+        max_containers = 0;
+        lazy_category = false;
+        fetch_timeout_ms = DEFAULT_FETCH_TIMEOUT_MS;
+        fetch_max_concurrent = DEFAULT_FETCH_MAX_CONCURRENT;
+        pruned_sections = 0;
         hooks = HOOK_CREATE;
         if(const char* hroot = std::getenv("HOST_ROOT"))
         {
@@ -131,6 +167,7 @@ void from_json(const nlohmann::json& j, StaticEngine& engine);
 void from_json(const nlohmann::json& j, SimpleEngine& engine);
 void from_json(const nlohmann::json& j, SocketsEngine& engine);
 void from_json(const nlohmann::json& j, Engines& engines);
+void from_json(const nlohmann::json& j, WarmCache& warm_cache);
 void from_json(const nlohmann::json& j, PluginConfig& cfg);
 
 // Build the json object to be passed to the go-worker as init config.
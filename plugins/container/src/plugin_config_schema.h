@@ -18,6 +18,42 @@ const char plugin_schema_string[] = LONG_STRING_CONST(
       "title": "Inspect containers with size",
       "description": "Inspect containers size where supported."
     },
+    "max_containers": {
+      "type": "integer",
+      "minimum": 0,
+      "title": "Max cached containers",
+      "description": "Above this number of cached containers, the least recently used ones without any live thread are evicted. 0 means no limit."
+    },
+    "lazy_category": {
+      "type": "boolean",
+      "title": "Lazily compute the processes category",
+      "description": "Match processes against the container health probes only when the proc.is_container_healthcheck, proc.is_container_liveness_probe or proc.is_container_readiness_probe fields are extracted, rather than for each new process. Children of a probe process are still categorized as the probe, as long as their parent thread is alive."
+    },
+    "fetch_timeout_ms": {
+      "type": "integer",
+      "minimum": 0,
+      "title": "Container info requests timeout",
+      "description": "Milliseconds after which the container engines stop being asked for a container missing from the cache. 0 uses the go-worker default of 1000."
+    },
+    "fetch_max_concurrent": {
+      "type": "integer",
+      "minimum": 0,
+      "title": "Max concurrent container info requests per engine",
+      "description": "Max number of container info requests in flight to a single engine socket, so that a slow engine does not delay the requests to the other ones. 0 uses the go-worker default of 4."
+    },
+    "required_fields": {
+      "type": "array",
+      "items": {
+        "type": "string"
+      },
+      "title": "Required fields",
+      "description": "Fields of the plugin used by the loaded rules and outputs, e.g. container.id or container.label[app]. The container metadata needed by none of them (environment, port mappings, mounts, health probes, CNI result) is neither sent by the go-worker nor cached, saving memory and parsing time. Other fields extract empty values for that metadata. Empty keeps all the metadata."
+    },
+    "warm_cache": {
+      "$ref": "#/definitions/WarmCache",
+      "title": "Containers warm cache",
+      "description": "Snapshot of the cached containers written to disk, periodically and when the plugin is destroyed, and restored on init so that events get enriched before the container engines list the containers again."
+    },
     "hooks": {
       "type": "array",
       "items": {
@@ -76,6 +112,24 @@ const char plugin_schema_string[] = LONG_STRING_CONST(
       ],
       "title": "Engines"
     },
+    "WarmCache": {
+      "type": "object",
+      "additionalProperties": false,
+      "properties": {
+        "path": {
+          "type": "string",
+          "title": "Snapshot file",
+          "description": "Path of the snapshot file, e.g. '/var/lib/falco/containers.bin'. Empty disables the warm cache."
+        },
+        "interval_s": {
+          "type": "integer",
+          "minimum": 0,
+          "title": "Snapshot interval",
+          "description": "Seconds between two snapshots while the plugin runs, only written if the cached containers changed. 0 only writes a snapshot when the plugin is destroyed."
+        }
+      },
+      "title": "WarmCache"
+    },
     "nonEmptyString": {
       "type": "string",
       "minLength": 1
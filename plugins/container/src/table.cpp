@@ -3,19 +3,88 @@
 #define CONTAINER_TABLE_NAME "containers"
 #define CONTAINER_EXPOSED_FIELD_IP "ip"
 #define CONTAINER_EXPOSED_FIELD_USER "user"
+#define CONTAINER_EXPOSED_FIELD_ID "id"
+#define CONTAINER_EXPOSED_FIELD_FULL_ID "full_id"
+#define CONTAINER_EXPOSED_FIELD_TYPE "type"
+#define CONTAINER_EXPOSED_FIELD_NAME "name"
+#define CONTAINER_EXPOSED_FIELD_IMAGE "image"
+#define CONTAINER_EXPOSED_FIELD_IMAGE_ID "image_id"
+#define CONTAINER_EXPOSED_FIELD_IMAGE_REPO "image_repo"
+#define CONTAINER_EXPOSED_FIELD_IMAGE_TAG "image_tag"
+#define CONTAINER_EXPOSED_FIELD_IMAGE_DIGEST "image_digest"
+#define CONTAINER_EXPOSED_FIELD_PRIVILEGED "privileged"
+#define CONTAINER_EXPOSED_FIELD_HOST_PID "host_pid"
+#define CONTAINER_EXPOSED_FIELD_HOST_NETWORK "host_network"
+#define CONTAINER_EXPOSED_FIELD_HOST_IPC "host_ipc"
+#define CONTAINER_EXPOSED_FIELD_MEMORY_LIMIT "memory_limit"
+#define CONTAINER_EXPOSED_FIELD_CPU_SHARES "cpu_shares"
+#define CONTAINER_EXPOSED_FIELD_CPU_QUOTA "cpu_quota"
+#define CONTAINER_EXPOSED_FIELD_CPU_PERIOD "cpu_period"
+#define CONTAINER_EXPOSED_FIELD_CREATED_TIME "created_time"
+#define CONTAINER_EXPOSED_FIELD_IS_POD_SANDBOX "is_pod_sandbox"
+#define CONTAINER_EXPOSED_FIELD_POD_SANDBOX_ID "pod_sandbox_id"
+#define CONTAINER_EXPOSED_FIELD_LABELS "labels"
 
+// In the order of `fields`
 enum
 {
     CONTAINER_FIELD_IP,
     CONTAINER_FIELD_USER,
+    CONTAINER_FIELD_ID,
+    CONTAINER_FIELD_FULL_ID,
+    CONTAINER_FIELD_TYPE,
+    CONTAINER_FIELD_NAME,
+    CONTAINER_FIELD_IMAGE,
+    CONTAINER_FIELD_IMAGE_ID,
+    CONTAINER_FIELD_IMAGE_REPO,
+    CONTAINER_FIELD_IMAGE_TAG,
+    CONTAINER_FIELD_IMAGE_DIGEST,
+    CONTAINER_FIELD_PRIVILEGED,
+    CONTAINER_FIELD_HOST_PID,
+    CONTAINER_FIELD_HOST_NETWORK,
+    CONTAINER_FIELD_HOST_IPC,
+    CONTAINER_FIELD_MEMORY_LIMIT,
+    CONTAINER_FIELD_CPU_SHARES,
+    CONTAINER_FIELD_CPU_QUOTA,
+    CONTAINER_FIELD_CPU_PERIOD,
+    CONTAINER_FIELD_CREATED_TIME,
+    CONTAINER_FIELD_IS_POD_SANDBOX,
+    CONTAINER_FIELD_POD_SANDBOX_ID,
+    CONTAINER_FIELD_LABELS,
     CONTAINER_FIELD_MAX,
 };
 
 using namespace falcosecurity::_internal;
 
+/*
+ * All the fields are read in place: strings point into the container_info
+ * (interned ones into the string pool), which is never modified once in the
+ * table, and scalars keep their native type; `type` is a `container_type`.
+ */
 static std::vector<ss_plugin_table_fieldinfo> fields = {
         {CONTAINER_EXPOSED_FIELD_IP, SS_PLUGIN_ST_STRING, true},
         {CONTAINER_EXPOSED_FIELD_USER, SS_PLUGIN_ST_STRING, true},
+        {CONTAINER_EXPOSED_FIELD_ID, SS_PLUGIN_ST_STRING, true},
+        {CONTAINER_EXPOSED_FIELD_FULL_ID, SS_PLUGIN_ST_STRING, true},
+        {CONTAINER_EXPOSED_FIELD_TYPE, SS_PLUGIN_ST_UINT16, true},
+        {CONTAINER_EXPOSED_FIELD_NAME, SS_PLUGIN_ST_STRING, true},
+        {CONTAINER_EXPOSED_FIELD_IMAGE, SS_PLUGIN_ST_STRING, true},
+        {CONTAINER_EXPOSED_FIELD_IMAGE_ID, SS_PLUGIN_ST_STRING, true},
+        {CONTAINER_EXPOSED_FIELD_IMAGE_REPO, SS_PLUGIN_ST_STRING, true},
+        {CONTAINER_EXPOSED_FIELD_IMAGE_TAG, SS_PLUGIN_ST_STRING, true},
+        {CONTAINER_EXPOSED_FIELD_IMAGE_DIGEST, SS_PLUGIN_ST_STRING, true},
+        {CONTAINER_EXPOSED_FIELD_PRIVILEGED, SS_PLUGIN_ST_BOOL, true},
+        {CONTAINER_EXPOSED_FIELD_HOST_PID, SS_PLUGIN_ST_BOOL, true},
+        {CONTAINER_EXPOSED_FIELD_HOST_NETWORK, SS_PLUGIN_ST_BOOL, true},
+        {CONTAINER_EXPOSED_FIELD_HOST_IPC, SS_PLUGIN_ST_BOOL, true},
+        {CONTAINER_EXPOSED_FIELD_MEMORY_LIMIT, SS_PLUGIN_ST_INT64, true},
+        {CONTAINER_EXPOSED_FIELD_CPU_SHARES, SS_PLUGIN_ST_INT64, true},
+        {CONTAINER_EXPOSED_FIELD_CPU_QUOTA, SS_PLUGIN_ST_INT64, true},
+        {CONTAINER_EXPOSED_FIELD_CPU_PERIOD, SS_PLUGIN_ST_INT64, true},
+        {CONTAINER_EXPOSED_FIELD_CREATED_TIME, SS_PLUGIN_ST_INT64, true},
+        {CONTAINER_EXPOSED_FIELD_IS_POD_SANDBOX, SS_PLUGIN_ST_BOOL, true},
+        {CONTAINER_EXPOSED_FIELD_POD_SANDBOX_ID, SS_PLUGIN_ST_STRING, true},
+        {CONTAINER_EXPOSED_FIELD_LABELS, SS_PLUGIN_ST_STRING, true},
 };
 
 static const char* reader_get_table_name(ss_plugin_table_t* t)
@@ -25,21 +94,20 @@ static const char* reader_get_table_name(ss_plugin_table_t* t)
 
 static uint64_t reader_get_table_size(ss_plugin_table_t* t)
 {
-    auto containers = static_cast<std::unordered_map<
-            std::string, std::shared_ptr<const container_info>>*>(t);
+    auto containers = static_cast<container_table*>(t);
     return containers->size();
 }
 
 static ss_plugin_table_entry_t*
 reader_get_table_entry(ss_plugin_table_t* t, const ss_plugin_state_data* key)
 {
-    auto containers = static_cast<std::unordered_map<
-            std::string, std::shared_ptr<const container_info>>*>(t);
-    if(containers->count(key->str) == 0)
+    auto containers = static_cast<container_table*>(t);
+    auto found = containers->find(key->str);
+    if(found == nullptr)
     {
         return nullptr;
     }
-    return (ss_plugin_table_entry_t*)containers->at(key->str).get();
+    return (ss_plugin_table_entry_t*)found->get();
 }
 
 static ss_plugin_rc reader_read_entry_field(ss_plugin_table_t* t,
@@ -56,6 +124,70 @@ static ss_plugin_rc reader_read_entry_field(ss_plugin_table_t* t,
     case CONTAINER_FIELD_USER + 1:
         out->str = ctr->m_container_user.c_str();
         break;
+    case CONTAINER_FIELD_ID + 1:
+        out->str = ctr->m_id.c_str();
+        break;
+    case CONTAINER_FIELD_FULL_ID + 1:
+        out->str = ctr->m_full_id.c_str();
+        break;
+    case CONTAINER_FIELD_TYPE + 1:
+        out->u16 = (uint16_t)ctr->m_type;
+        break;
+    case CONTAINER_FIELD_NAME + 1:
+        out->str = ctr->m_name.c_str();
+        break;
+    case CONTAINER_FIELD_IMAGE + 1:
+        out->str = ctr->m_image.c_str();
+        break;
+    case CONTAINER_FIELD_IMAGE_ID + 1:
+        out->str = ctr->m_imageid.c_str();
+        break;
+    case CONTAINER_FIELD_IMAGE_REPO + 1:
+        out->str = ctr->m_imagerepo.c_str();
+        break;
+    case CONTAINER_FIELD_IMAGE_TAG + 1:
+        out->str = ctr->m_imagetag.c_str();
+        break;
+    case CONTAINER_FIELD_IMAGE_DIGEST + 1:
+        out->str = ctr->m_imagedigest.c_str();
+        break;
+    case CONTAINER_FIELD_PRIVILEGED + 1:
+        out->b = ctr->m_privileged;
+        break;
+    case CONTAINER_FIELD_HOST_PID + 1:
+        out->b = ctr->m_host_pid;
+        break;
+    case CONTAINER_FIELD_HOST_NETWORK + 1:
+        out->b = ctr->m_host_network;
+        break;
+    case CONTAINER_FIELD_HOST_IPC + 1:
+        out->b = ctr->m_host_ipc;
+        break;
+    case CONTAINER_FIELD_MEMORY_LIMIT + 1:
+        out->s64 = ctr->m_memory_limit;
+        break;
+    case CONTAINER_FIELD_CPU_SHARES + 1:
+        out->s64 = ctr->m_cpu_shares;
+        break;
+    case CONTAINER_FIELD_CPU_QUOTA + 1:
+        out->s64 = ctr->m_cpu_quota;
+        break;
+    case CONTAINER_FIELD_CPU_PERIOD + 1:
+        out->s64 = ctr->m_cpu_period;
+        break;
+    case CONTAINER_FIELD_CREATED_TIME + 1:
+        out->s64 = ctr->m_created_time;
+        break;
+    case CONTAINER_FIELD_IS_POD_SANDBOX + 1:
+        out->b = ctr->m_is_pod_sandbox;
+        break;
+    case CONTAINER_FIELD_POD_SANDBOX_ID + 1:
+        out->str = ctr->m_pod_sandbox_id.c_str();
+        break;
+    case CONTAINER_FIELD_LABELS + 1:
+        // Built once per container, as for `container.labels`
+        out->str = ctr->get_labels_string().c_str();
+        break;
     default:
         return SS_PLUGIN_FAILURE;
     }
@@ -72,8 +204,7 @@ static ss_plugin_bool
 reader_iterate_entries(ss_plugin_table_t* t, ss_plugin_table_iterator_func_t it,
                        ss_plugin_table_iterator_state_t* s)
 {
-    auto containers = static_cast<std::unordered_map<
-            std::string, std::shared_ptr<const container_info>>*>(t);
+    auto containers = static_cast<container_table*>(t);
     bool ret = true;
     for(const auto& c : *containers)
     {
@@ -101,6 +232,11 @@ static ss_plugin_table_field_t* get_table_field(ss_plugin_table_t* t,
     {
         if(strcmp(fields[i].name, name) == 0)
         {
+            // Values are written in the union member of the field type only
+            if(fields[i].field_type != data_type)
+            {
+                return nullptr;
+            }
             // note: shifted by 1 so that we never return 0 (interpreted as
             // NULL)
             return (ss_plugin_table_field_t*)(i + 1);
@@ -119,8 +255,7 @@ static ss_plugin_table_field_t* add_table_field(ss_plugin_table_t* _t,
 
 static ss_plugin_rc clear_table(ss_plugin_table_t* t)
 {
-    auto containers = static_cast<std::unordered_map<
-            std::string, std::shared_ptr<const container_info>>*>(t);
+    auto containers = static_cast<container_table*>(t);
     containers->clear();
     return SS_PLUGIN_SUCCESS;
 }
@@ -128,13 +263,11 @@ static ss_plugin_rc clear_table(ss_plugin_table_t* t)
 static ss_plugin_rc erase_table_entry(ss_plugin_table_t* t,
                                       const ss_plugin_state_data* key)
 {
-    auto containers = static_cast<std::unordered_map<
-            std::string, std::shared_ptr<const container_info>>*>(t);
-    if(containers->count(key->str) == 0)
+    auto containers = static_cast<container_table*>(t);
+    if(!containers->erase(key->str))
     {
         return SS_PLUGIN_FAILURE;
     }
-    containers->erase(key->str);
     return SS_PLUGIN_SUCCESS;
 }
 
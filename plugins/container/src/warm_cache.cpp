@@ -0,0 +1,196 @@
+#include "warm_cache.h"
+#include "container_info_binary.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <functional>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static std::string errno_string(const std::string& what,
+                                const std::string& path)
+{
+    return what + " '" + path + "': " + std::strerror(errno);
+}
+
+std::vector<container_info::ptr_t> load_warm_cache(const std::string& path,
+                                                   unsigned max_threads,
+                                                   uint32_t pruned)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        throw std::runtime_error(errno_string("cannot open", path));
+    }
+    struct stat st = {};
+    if(::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error(errno_string("cannot stat", path));
+    }
+    size_t len = st.st_size;
+    if(len < WARM_CACHE_HEADER_SIZE)
+    {
+        ::close(fd);
+        throw std::runtime_error("truncated warm cache '" + path + "'");
+    }
+    void* p = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED)
+    {
+        throw std::runtime_error(errno_string("cannot mmap", path));
+    }
+    // Unmapped once decoded, the decoded containers own copies
+    std::unique_ptr<void, std::function<void(void*)>> mapping(
+            p, [len](void* addr) { ::munmap(addr, len); });
+
+    auto base = (const uint8_t*)p;
+    uint32_t magic, version;
+    uint64_t size;
+    std::memcpy(&magic, base, sizeof(magic));
+    std::memcpy(&version, base + 4, sizeof(version));
+    std::memcpy(&size, base + 8, sizeof(size));
+    if(le32toh(magic) != WARM_CACHE_MAGIC)
+    {
+        throw std::runtime_error("invalid warm cache '" + path + "'");
+    }
+    if(le32toh(version) > WARM_CACHE_VERSION)
+    {
+        throw std::runtime_error("unsupported warm cache version " +
+                                 std::to_string(le32toh(version)));
+    }
+    if(le64toh(size) > len - WARM_CACHE_HEADER_SIZE)
+    {
+        throw std::runtime_error("truncated warm cache '" + path + "'");
+    }
+
+    auto payloads = container_info_view::split(base + WARM_CACHE_HEADER_SIZE,
+                                               le64toh(size));
+    auto infos = decode_container_infos(payloads, max_threads, pruned);
+    infos.erase(std::remove(infos.begin(), infos.end(), nullptr),
+                infos.end());
+    return infos;
+}
+
+void save_warm_cache(const std::string& path,
+                     const warm_cache_entries& containers)
+{
+    std::string data(WARM_CACHE_HEADER_SIZE, '\0');
+    std::string payload;
+    for(const auto& info : containers)
+    {
+        container_info_to_binary(*info, payload);
+        data += payload;
+    }
+    uint32_t magic = htole32(WARM_CACHE_MAGIC);
+    uint32_t version = htole32(WARM_CACHE_VERSION);
+    uint64_t size = htole64(data.size() - WARM_CACHE_HEADER_SIZE);
+    std::memcpy(&data[0], &magic, sizeof(magic));
+    std::memcpy(&data[4], &version, sizeof(version));
+    std::memcpy(&data[8], &size, sizeof(size));
+
+    auto tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    0600);
+    if(fd < 0)
+    {
+        throw std::runtime_error(errno_string("cannot open", tmp));
+    }
+    size_t off = 0;
+    while(off < data.size())
+    {
+        auto n = ::write(fd, data.data() + off, data.size() - off);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n < 0)
+        {
+            auto err = errno_string("cannot write", tmp);
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            throw std::runtime_error(err);
+        }
+        off += n;
+    }
+    if(::close(fd) != 0 || std::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        auto err = errno_string("cannot publish", path);
+        ::unlink(tmp.c_str());
+        throw std::runtime_error(err);
+    }
+}
+
+warm_cache_writer::warm_cache_writer(std::string path):
+        m_path(std::move(path)), m_thread(&warm_cache_writer::run, this)
+{
+}
+
+warm_cache_writer::~warm_cache_writer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+}
+
+void warm_cache_writer::submit(warm_cache_entries containers)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending = std::move(containers);
+    }
+    m_cond.notify_one();
+}
+
+std::string warm_cache_writer::get_last_error()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_last_error;
+}
+
+void warm_cache_writer::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for(;;)
+    {
+        m_cond.wait(lock, [this] { return m_stop || m_pending.has_value(); });
+        if(!m_pending.has_value())
+        {
+            // Stopping with nothing left to write
+            return;
+        }
+        auto containers = std::move(*m_pending);
+        m_pending.reset();
+        lock.unlock();
+        std::string err;
+        try
+        {
+            save_warm_cache(m_path, containers);
+        }
+        catch(const std::exception& e)
+        {
+            err = e.what();
+        }
+        // The entries are released off the lock too
+        containers.clear();
+        lock.lock();
+        if(err.empty())
+        {
+            m_n_writes++;
+        }
+        else
+        {
+            m_n_errors++;
+            m_last_error = std::move(err);
+        }
+    }
+}
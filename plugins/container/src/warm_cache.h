@@ -0,0 +1,83 @@
+#pragma once
+
+#include "container_info.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * On-disk snapshot of the containers table, restored by the next plugin
+ * instance so that events get enriched before the go-worker lists the
+ * containers again, see PluginConfig::warm_cache.
+ *
+ * The file holds a 16 bytes header followed by the concatenated binary
+ * payloads of the containers (see container_info_binary.h), the same layout
+ * as the go-worker initial state:
+ *
+ *     0   u32 magic, u32 version, u64 size of the payloads
+ *     16  payloads
+ *
+ * All integers are little endian. Snapshots are written to a temporary file
+ * renamed over the previous one, a reader never sees a partial snapshot.
+ */
+
+#define WARM_CACHE_MAGIC 0x31534346 // "FCS1"
+#define WARM_CACHE_VERSION 1
+#define WARM_CACHE_HEADER_SIZE 16
+
+using warm_cache_entries = std::vector<std::shared_ptr<const container_info>>;
+
+// Decode the snapshot at `path` but the `pruned` sections using up to
+// `max_threads` threads, skipping the containers failing to decode. Throws
+// std::runtime_error if the file is missing, truncated or has an unknown magic
+// or a newer version.
+std::vector<container_info::ptr_t> load_warm_cache(const std::string& path,
+                                                   unsigned max_threads,
+                                                   uint32_t pruned = 0);
+
+// Write `containers` to `path`. Throws std::runtime_error on I/O errors.
+void save_warm_cache(const std::string& path,
+                     const warm_cache_entries& containers);
+
+/*
+ * Writes the snapshots off the parsing thread: the plugin only collects the
+ * entries of its table, which are immutable, while the encoding and the I/O
+ * run on a thread of the writer. A snapshot submitted while the previous one
+ * is still being written replaces any other pending one.
+ */
+class warm_cache_writer
+{
+    public:
+    explicit warm_cache_writer(std::string path);
+    warm_cache_writer(const warm_cache_writer&) = delete;
+    warm_cache_writer& operator=(const warm_cache_writer&) = delete;
+    // Writes the pending snapshot, if any, before returning
+    ~warm_cache_writer();
+
+    void submit(warm_cache_entries containers);
+
+    uint64_t get_n_writes() const { return m_n_writes.load(); }
+    uint64_t get_n_errors() const { return m_n_errors.load(); }
+    // Error of the last failed write, empty if none
+    std::string get_last_error();
+
+    private:
+    void run();
+
+    std::string m_path;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::optional<warm_cache_entries> m_pending;
+    bool m_stop = false;
+    std::atomic<uint64_t> m_n_writes{0};
+    std::atomic<uint64_t> m_n_errors{0};
+    std::string m_last_error;
+    std::thread m_thread;
+};
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include <async_stamps.h>
+
+#include <thread>
+
+TEST(async_stamps, take)
+{
+    async_stamps stamps;
+    stamps.stamp("aaa", 10);
+    // The earliest stamp is kept
+    stamps.stamp("aaa", 20);
+    ASSERT_EQ(stamps.size(), 1);
+    ASSERT_EQ(stamps.take("aaa"), 10);
+    ASSERT_EQ(stamps.take("aaa"), 0);
+    ASSERT_EQ(stamps.take("bbb"), 0);
+    ASSERT_EQ(stamps.size(), 0);
+}
+
+TEST(async_stamps, bounded)
+{
+    async_stamps stamps(2, 100);
+    stamps.stamp("aaa", 0);
+    stamps.stamp("bbb", 50);
+    stamps.stamp("ccc", 60);
+    ASSERT_EQ(stamps.take("ccc"), 0);
+
+    // "aaa" expired, making room
+    stamps.stamp("ccc", 100);
+    ASSERT_EQ(stamps.size(), 2);
+    ASSERT_EQ(stamps.take("aaa"), 0);
+    ASSERT_EQ(stamps.take("bbb"), 50);
+    ASSERT_EQ(stamps.take("ccc"), 100);
+}
+
+TEST(async_stamps, concurrent)
+{
+    async_stamps stamps(1024);
+    std::thread producer(
+            [&stamps]
+            {
+                for(uint64_t i = 1; i <= 512; i++)
+                {
+                    stamps.stamp(std::to_string(i), i);
+                }
+            });
+    uint64_t taken = 0;
+    for(uint64_t i = 1; i <= 512; i++)
+    {
+        auto id = std::to_string(i);
+        uint64_t ts;
+        while((ts = stamps.take(id)) == 0)
+        {
+            std::this_thread::yield();
+        }
+        ASSERT_EQ(ts, i);
+        taken++;
+    }
+    producer.join();
+    ASSERT_EQ(taken, 512);
+}
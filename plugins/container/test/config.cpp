@@ -39,6 +39,15 @@ TEST(plugin_config, from_json)
   },
   "label_max_len": 120,
   "with_size": true,
+  "max_containers": 500,
+  "lazy_category": true,
+  "fetch_timeout_ms": 250,
+  "fetch_max_concurrent": 8,
+  "required_fields": ["container.id", "container.label[app]"],
+  "warm_cache": {
+    "path": "/var/lib/falco/containers.bin",
+    "interval_s": 10
+  },
   "hooks": ["start"]
 })";
     auto config_json = nlohmann::json::parse(config);
@@ -55,6 +64,17 @@ TEST(plugin_config, from_json)
 
     EXPECT_TRUE(cfg.with_size);
     EXPECT_EQ(cfg.label_max_len, 120);
+    EXPECT_EQ(cfg.max_containers, 500);
+    EXPECT_TRUE(cfg.lazy_category);
+    EXPECT_EQ(cfg.warm_cache.path, "/var/lib/falco/containers.bin");
+    EXPECT_EQ(cfg.warm_cache.interval_s, 10);
+    EXPECT_EQ(cfg.fetch_timeout_ms, 250);
+    EXPECT_EQ(cfg.fetch_max_concurrent, 8);
+    EXPECT_EQ(cfg.required_fields,
+              (std::vector<std::string>{"container.id",
+                                        "container.label[app]"}));
+    // Computed on init
+    EXPECT_EQ(cfg.pruned_sections, 0);
     EXPECT_EQ(cfg.hooks, HOOK_START);
 }
 
@@ -100,6 +120,13 @@ TEST(plugin_config, from_json_empty_json)
 
     EXPECT_FALSE(cfg.with_size);
     EXPECT_EQ(cfg.label_max_len, DEFAULT_LABEL_MAX_LEN);
+    EXPECT_EQ(cfg.max_containers, 0);
+    EXPECT_FALSE(cfg.lazy_category);
+    EXPECT_TRUE(cfg.warm_cache.path.empty());
+    EXPECT_EQ(cfg.warm_cache.interval_s, DEFAULT_WARM_CACHE_INTERVAL_S);
+    EXPECT_EQ(cfg.fetch_timeout_ms, DEFAULT_FETCH_TIMEOUT_MS);
+    EXPECT_EQ(cfg.fetch_max_concurrent, DEFAULT_FETCH_MAX_CONCURRENT);
+    EXPECT_TRUE(cfg.required_fields.empty());
     EXPECT_EQ(cfg.hooks, HOOK_CREATE);
 }
 
@@ -133,9 +160,13 @@ TEST(plugin_config, to_json)
       ]
     }
   },
+  "fetch_max_concurrent": 2,
   "hooks": 3,
   "host_root": "",
   "label_max_len": 120,
+  "lazy_category": false,
+  "max_containers": 0,
+  "pruned_sections": 5,
   "with_size": true
 })";
     auto cfg = PluginConfig{};
@@ -157,6 +188,8 @@ TEST(plugin_config, to_json)
     cfg.label_max_len = 120;
     cfg.with_size = true;
     cfg.hooks = HOOK_CREATE | HOOK_START;
+    cfg.fetch_max_concurrent = 2;
+    cfg.pruned_sections = 5;
 
     nlohmann::json j(cfg);
     EXPECT_EQ(j.dump(2).c_str(), expected_config);
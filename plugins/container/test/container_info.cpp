@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include <container_info.h>
+
+TEST(container_info, composite_strings)
+{
+    container_info empty;
+    ASSERT_EQ(empty.get_mounts_string(), "");
+    ASSERT_EQ(empty.get_labels_string(), "");
+
+    container_info info;
+
+    info.m_mounts.emplace_back("/var/log", "/logs", "ro", false, "rprivate");
+    info.m_mounts.emplace_back("/data", "/data", "", true, "");
+    info.m_labels = {{"app", "nginx"},
+                     {"tier", ""},
+                     {"annotation.kubernetes.io/config.seen", "now"},
+                     {"io.kubernetes.pod.name", "web-0"}};
+    info.m_pod_sandbox_labels = {{"app", "web"}, {"version", "2"}};
+
+    ASSERT_EQ(info.get_mounts_string(),
+              "/var/log:/logs:ro:false:rprivate,/data:/data::true:");
+    ASSERT_EQ(info.get_labels_string(), "app:nginx, tier");
+    ASSERT_EQ(info.get_pod_sandbox_labels_string(), "app:web, version:2");
+
+    // Built once
+    ASSERT_EQ(&info.get_labels_string(), &info.get_labels_string());
+
+    // Copies start with empty caches
+    container_info copy = info;
+    copy.m_labels.emplace("zone", "eu");
+    ASSERT_EQ(copy.get_labels_string(), "app:nginx, tier, zone:eu");
+    ASSERT_EQ(info.get_labels_string(), "app:nginx, tier");
+}
+
+TEST(container_info, health_probe_hashes)
+{
+    container_info info;
+    info.m_health_probes.emplace_back(container_health_probe::PT_LIVENESS_PROBE,
+                                      "/bin/sh",
+                                      std::vector<std::string>{"-c", "true"});
+
+    health_probe_hasher hit("/bin/sh");
+    hit.add_arg("-c");
+    hit.add_arg("true");
+    ASSERT_TRUE(info.may_match_health_probe(hit.value()));
+    ASSERT_EQ(info.match_health_probe("/bin/sh", {"-c", "true"}),
+              container_health_probe::PT_LIVENESS_PROBE);
+
+    // Arg boundaries are part of the hash
+    health_probe_hasher miss("/bin/sh");
+    miss.add_arg("-ct");
+    miss.add_arg("rue");
+    ASSERT_FALSE(info.may_match_health_probe(miss.value()));
+    ASSERT_FALSE(info.may_match_health_probe(
+            health_probe_hasher("/bin/sh").value()));
+}
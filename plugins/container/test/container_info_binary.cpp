@@ -0,0 +1,306 @@
+#include <gtest/gtest.h>
+#include <container_info.h>
+#include <container_info_binary.h>
+
+#include <cstring>
+
+static container_info::ptr_t make_container_info()
+{
+    auto info = std::make_shared<container_info>();
+    info->m_type = CT_CONTAINERD;
+    info->m_id = "fee3a77211e1";
+    info->m_full_id =
+            "fee3a77211e1c0ffee3a77211e1c0ffee3a77211e1c0ffee3a77211e1c0ff";
+    info->m_name = "nginx";
+    info->m_image = "docker.io/library/nginx:1.27";
+    info->m_imagerepo = "docker.io/library/nginx";
+    info->m_imagetag = "1.27";
+    info->m_container_ip = "10.0.0.12";
+    info->m_pod_sandbox_id = "0123456789ab";
+    info->m_pod_sandbox_cniresult = R"({"eth0":"10.0.0.12"})";
+    info->m_container_user = "root";
+    info->m_privileged = true;
+    info->m_host_network = true;
+    info->m_memory_limit = 2147483648;
+    info->m_swap_limit = -1;
+    info->m_cpu_quota = 100000;
+    info->m_created_time = 1749101763;
+    info->m_size_rw_bytes = -1;
+    info->m_env = {"PATH=/usr/local/sbin:/usr/local/bin", "TZ=Asia/Shanghai"};
+    info->m_labels = {{"app", "nginx"}, {"tier", ""}};
+    info->m_pod_sandbox_labels = {{"io.kubernetes.pod.name", "web-0"}};
+    info->m_mounts.emplace_back("/var/log", "/logs", "ro", false, "rprivate");
+    info->m_mounts.emplace_back("/data", "/data", "", true, "");
+    container_port_mapping port;
+    port.m_host_ip = 0x0100007f;
+    port.m_host_port = 8080;
+    port.m_container_port = 80;
+    info->m_port_mappings.push_back(port);
+    info->m_health_probes.emplace_back(container_health_probe::PT_HEALTHCHECK,
+                                       "/bin/sh",
+                                       std::vector<std::string>{"-c", "true"});
+    info->m_health_probes.emplace_back(
+            container_health_probe::PT_READINESS_PROBE, "/ready",
+            std::vector<std::string>{});
+    return info;
+}
+
+TEST(container_info_binary, roundtrip)
+{
+    auto info = make_container_info();
+    std::string payload;
+    container_info_to_binary(*info, payload);
+    ASSERT_TRUE(container_info_view::is_binary(payload.data(), payload.size()));
+
+    container_info_view view(payload.data(), payload.size());
+    ASSERT_EQ(view.get_version(), CONTAINER_INFO_BINARY_VERSION);
+    ASSERT_EQ(view.get_flags(), 0);
+    auto decoded = view.to_container_info();
+
+    ASSERT_EQ(decoded->m_type, info->m_type);
+    ASSERT_EQ(decoded->m_id, info->m_id);
+    ASSERT_EQ(decoded->m_full_id, info->m_full_id);
+    ASSERT_EQ(decoded->m_name, info->m_name);
+    ASSERT_EQ(decoded->m_image, info->m_image);
+    ASSERT_EQ(decoded->m_imageid, info->m_imageid);
+    ASSERT_EQ(decoded->m_imagerepo, info->m_imagerepo);
+    ASSERT_EQ(decoded->m_imagetag, info->m_imagetag);
+    ASSERT_EQ(decoded->m_imagedigest, info->m_imagedigest);
+    ASSERT_EQ(decoded->m_container_ip, info->m_container_ip);
+    ASSERT_EQ(decoded->m_pod_sandbox_id, info->m_pod_sandbox_id);
+    ASSERT_EQ(decoded->m_pod_sandbox_cniresult, info->m_pod_sandbox_cniresult);
+    ASSERT_EQ(decoded->m_container_user, info->m_container_user);
+    ASSERT_EQ(decoded->m_privileged, true);
+    ASSERT_EQ(decoded->m_host_pid, false);
+    ASSERT_EQ(decoded->m_host_network, true);
+    ASSERT_EQ(decoded->m_host_ipc, false);
+    ASSERT_EQ(decoded->m_is_pod_sandbox, false);
+    ASSERT_EQ(decoded->m_memory_limit, info->m_memory_limit);
+    ASSERT_EQ(decoded->m_swap_limit, info->m_swap_limit);
+    ASSERT_EQ(decoded->m_cpu_shares, info->m_cpu_shares);
+    ASSERT_EQ(decoded->m_cpu_quota, info->m_cpu_quota);
+    ASSERT_EQ(decoded->m_cpu_period, info->m_cpu_period);
+    ASSERT_EQ(decoded->m_cpuset_cpu_count, info->m_cpuset_cpu_count);
+    ASSERT_EQ(decoded->m_created_time, info->m_created_time);
+    ASSERT_EQ(decoded->m_size_rw_bytes, info->m_size_rw_bytes);
+    ASSERT_EQ(decoded->m_env, info->m_env);
+    ASSERT_EQ(decoded->m_labels, info->m_labels);
+    ASSERT_EQ(decoded->m_pod_sandbox_labels, info->m_pod_sandbox_labels);
+
+    ASSERT_EQ(decoded->m_mounts.size(), 2);
+    ASSERT_EQ(decoded->m_mounts[0].to_string(), info->m_mounts[0].to_string());
+    ASSERT_EQ(decoded->m_mounts[1].to_string(), info->m_mounts[1].to_string());
+
+    ASSERT_EQ(decoded->m_port_mappings.size(), 1);
+    ASSERT_EQ(decoded->m_port_mappings[0].m_host_ip, 0x0100007f);
+    ASSERT_EQ(decoded->m_port_mappings[0].m_host_port, 8080);
+    ASSERT_EQ(decoded->m_port_mappings[0].m_container_port, 80);
+
+    ASSERT_EQ(decoded->m_health_probes.size(), 2);
+    auto& healthcheck = decoded->m_health_probes.front();
+    ASSERT_EQ(healthcheck.m_type, container_health_probe::PT_HEALTHCHECK);
+    ASSERT_EQ(healthcheck.m_exe, "/bin/sh");
+    ASSERT_EQ(healthcheck.m_args, std::vector<std::string>({"-c", "true"}));
+    auto& readiness = decoded->m_health_probes.back();
+    ASSERT_EQ(readiness.m_type, container_health_probe::PT_READINESS_PROBE);
+    ASSERT_EQ(readiness.m_exe, "/ready");
+    ASSERT_TRUE(readiness.m_args.empty());
+}
+
+TEST(container_info_binary, view)
+{
+    auto info = make_container_info();
+    info->m_is_pod_sandbox = true;
+    std::string payload;
+    container_info_to_binary(*info, payload,
+                             CONTAINER_INFO_BINARY_FLAG_INITIAL_STATE);
+    // Async event payloads are NUL terminated
+    payload.push_back('\0');
+
+    container_info_view view(payload.data(), payload.size());
+    ASSERT_EQ(view.get_flags(), CONTAINER_INFO_BINARY_FLAG_INITIAL_STATE);
+    ASSERT_EQ(view.get_id(), "fee3a77211e1");
+    ASSERT_EQ(view.get_image(), "docker.io/library/nginx:1.27");
+    ASSERT_EQ(view.get_type(), CT_CONTAINERD);
+    ASSERT_TRUE(view.is_pod_sandbox());
+
+    // The host container has no lists
+    container_info_to_binary(*container_info::host_container_info(), payload);
+    container_info_view host(payload.data(), payload.size());
+    ASSERT_EQ(host.get_id(), HOST_CONTAINER_ID);
+    ASSERT_EQ(host.to_container_info()->m_type, CT_HOST);
+}
+
+TEST(container_info_binary, invalid)
+{
+    std::string json = R"({"container":{"id":"fee3a77211e1"}})";
+    ASSERT_FALSE(container_info_view::is_binary(json.data(), json.size()));
+    ASSERT_THROW(container_info_view(json.data(), json.size()),
+                 std::runtime_error);
+
+    std::string payload;
+    container_info_to_binary(*make_container_info(), payload);
+
+    // Truncated
+    ASSERT_THROW(container_info_view(payload.data(), payload.size() - 1),
+                 std::runtime_error);
+    ASSERT_THROW(container_info_view(payload.data(),
+                                     container_info_view::fixed_size - 1),
+                 std::runtime_error);
+
+    // Newer version
+    std::string newer = payload;
+    newer[4] = CONTAINER_INFO_BINARY_VERSION + 1;
+    ASSERT_THROW(container_info_view(newer.data(), newer.size()),
+                 std::runtime_error);
+
+    // String reference past the end of the payload
+    std::string corrupted = payload;
+    corrupted[container_info_view::strings_offset + 7] = (char)0x7f;
+    container_info_view view(corrupted.data(), corrupted.size());
+    ASSERT_THROW(view.get_id(), std::runtime_error);
+    ASSERT_THROW(view.to_container_info(), std::runtime_error);
+}
+
+TEST(container_info_binary, split)
+{
+    // Initial state snapshots are concatenated payloads
+    std::string snapshot;
+    std::string payload;
+    for(int i = 0; i < 200; i++)
+    {
+        auto info = make_container_info();
+        info->m_id = std::to_string(i);
+        container_info_to_binary(*info, payload,
+                                 CONTAINER_INFO_BINARY_FLAG_INITIAL_STATE);
+        snapshot += payload;
+    }
+
+    auto payloads = container_info_view::split(snapshot.data(),
+                                               snapshot.size());
+    ASSERT_EQ(payloads.size(), 200u);
+    ASSERT_EQ(payloads.front().data(), snapshot.data());
+    ASSERT_EQ(payloads.back().data() + payloads.back().size(),
+              snapshot.data() + snapshot.size());
+
+    auto infos = decode_container_infos(payloads, 4);
+    ASSERT_EQ(infos.size(), 200u);
+    for(int i = 0; i < 200; i++)
+    {
+        ASSERT_NE(infos[i], nullptr);
+        ASSERT_EQ(infos[i]->m_id, std::to_string(i));
+        ASSERT_EQ(infos[i]->m_image, "docker.io/library/nginx:1.27");
+    }
+
+    // Invalid payloads are skipped by the decoding
+    std::string corrupted = snapshot;
+    corrupted[payloads[0].size() + container_info_view::strings_offset + 7] =
+            (char)0x7f;
+    payloads = container_info_view::split(corrupted.data(), corrupted.size());
+    infos = decode_container_infos(payloads, 1);
+    ASSERT_NE(infos[0], nullptr);
+    ASSERT_EQ(infos[1], nullptr);
+    ASSERT_NE(infos[2], nullptr);
+
+    ASSERT_TRUE(container_info_view::split(nullptr, 0).empty());
+    ASSERT_THROW(container_info_view::split(snapshot.data(),
+                                            snapshot.size() - 1),
+                 std::runtime_error);
+}
+
+static void set_u32(std::string& payload, size_t off, uint32_t v)
+{
+    std::memcpy(&payload[off], &v, sizeof(v));
+}
+
+TEST(container_info_binary, delta)
+{
+    auto base = make_container_info();
+    // Cached strings are not inherited by updated copies
+    ASSERT_EQ(base->get_labels_string(), "app:nginx, tier");
+    auto update = std::make_shared<container_info>(*base);
+    update->m_container_ip = "10.0.0.13";
+    update->m_image = "";
+    update->m_labels = {{"app", "nginx"}, {"tier", "web"}};
+    update->m_mounts.clear();
+
+    // As the go-worker would send it: image and mounts unchanged
+    std::string payload;
+    container_info_to_binary(*update, payload);
+    payload[6] = CONTAINER_INFO_BINARY_FLAG_DELTA;
+    set_u32(payload,
+            container_info_view::strings_offset +
+                    container_info_view::SF_IMAGE * 8,
+            CONTAINER_INFO_BINARY_UNCHANGED);
+    set_u32(payload,
+            container_info_view::lists_offset +
+                    container_info_view::LF_MOUNTS * 8,
+            CONTAINER_INFO_BINARY_UNCHANGED);
+
+    ASSERT_TRUE(container_info_view::is_delta(payload.data(), payload.size()));
+    container_info_view view(payload.data(), payload.size());
+    ASSERT_TRUE(view.is_delta());
+    ASSERT_THROW(view.to_container_info(), std::runtime_error);
+    ASSERT_THROW(view.get_image(), std::runtime_error);
+
+    auto applied = view.apply_to(*base);
+    ASSERT_EQ(applied->m_id, base->m_id);
+    ASSERT_EQ(applied->m_container_ip, "10.0.0.13");
+    ASSERT_EQ(applied->m_image, base->m_image);
+    ASSERT_EQ(applied->m_labels, update->m_labels);
+    ASSERT_EQ(applied->m_mounts.size(), base->m_mounts.size());
+    ASSERT_EQ(applied->get_labels_string(), "app:nginx, tier:web");
+    // The base is left untouched
+    ASSERT_EQ(base->m_container_ip, "10.0.0.12");
+    ASSERT_EQ(base->m_labels.at("tier"), "");
+
+    auto other = make_container_info();
+    other->m_id = "0123456789ab";
+    ASSERT_THROW(view.apply_to(*other), std::runtime_error);
+
+    // Full payloads are decoded as is
+    container_info_to_binary(*update, payload);
+    ASSERT_FALSE(container_info_view::is_delta(payload.data(),
+                                               payload.size()));
+    applied = container_info_view(payload.data(), payload.size())
+                      .apply_to(*base);
+    ASSERT_TRUE(applied->m_image.empty());
+    ASSERT_TRUE(applied->m_mounts.empty());
+}
+
+TEST(container_info_binary, pruned)
+{
+    auto info = make_container_info();
+    std::string payload;
+    container_info_to_binary(*info, payload);
+    container_info_view view(payload.data(), payload.size());
+
+    auto decoded = view.to_container_info(CONTAINER_INFO_SECTION_ENV |
+                                          CONTAINER_INFO_SECTION_HEALTH_PROBES |
+                                          CONTAINER_INFO_SECTION_CNI_RESULT);
+    ASSERT_TRUE(decoded->m_env.empty());
+    ASSERT_TRUE(decoded->m_health_probes.empty());
+    ASSERT_TRUE(decoded->m_pod_sandbox_cniresult.empty());
+    // Other sections are kept
+    ASSERT_EQ(decoded->m_id, info->m_id);
+    ASSERT_EQ(decoded->m_container_ip, info->m_container_ip);
+    ASSERT_EQ(decoded->m_labels, info->m_labels);
+    ASSERT_EQ(decoded->m_mounts.size(), 2);
+    ASSERT_EQ(decoded->m_port_mappings.size(), 1);
+
+    auto all = decode_container_infos({payload}, 1,
+                                      CONTAINER_INFO_SECTIONS_ALL);
+    ASSERT_EQ(all.size(), 1);
+    ASSERT_TRUE(all[0]->m_mounts.empty());
+    ASSERT_TRUE(all[0]->m_port_mappings.empty());
+    ASSERT_EQ(all[0]->m_image, info->m_image);
+
+    // Same outcome on decoded containers, e.g. from JSON payloads
+    prune_container_info(*info, CONTAINER_INFO_SECTIONS_ALL);
+    ASSERT_TRUE(info->m_env.empty());
+    ASSERT_TRUE(info->m_mounts.empty());
+    ASSERT_TRUE(info->m_port_mappings.empty());
+    ASSERT_TRUE(info->m_health_probes.empty());
+    ASSERT_TRUE(info->m_pod_sandbox_cniresult.empty());
+    ASSERT_EQ(info->m_labels, all[0]->m_labels);
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include <container_requests.h>
+
+TEST(container_requests, backoff)
+{
+    container_requests reqs(16, 10, 40);
+    ASSERT_TRUE(reqs.should_ask("aaa", 0));
+    reqs.on_asked("aaa", 0);
+    ASSERT_EQ(reqs.get_pending(), 1);
+
+    // Negative cache hits until the backoff expires
+    ASSERT_FALSE(reqs.should_ask("aaa", 5));
+    ASSERT_TRUE(reqs.should_ask("aaa", 10));
+    reqs.on_asked("aaa", 10);
+    ASSERT_FALSE(reqs.should_ask("aaa", 29));
+    ASSERT_TRUE(reqs.should_ask("aaa", 30));
+    reqs.on_asked("aaa", 30);
+    ASSERT_FALSE(reqs.should_ask("aaa", 69));
+    ASSERT_TRUE(reqs.should_ask("aaa", 70));
+    // Capped
+    reqs.on_asked("aaa", 70);
+    ASSERT_FALSE(reqs.should_ask("aaa", 109));
+    ASSERT_TRUE(reqs.should_ask("aaa", 110));
+
+    ASSERT_EQ(reqs.get_hits(), 4);
+    ASSERT_EQ(reqs.get_misses(), 4);
+
+    // Resolved containers start over
+    ASSERT_EQ(reqs.on_resolved("aaa", 100), 100);
+    ASSERT_EQ(reqs.get_pending(), 0);
+    ASSERT_EQ(reqs.on_resolved("aaa", 100), 0);
+    ASSERT_TRUE(reqs.should_ask("aaa", 110));
+}
+
+TEST(container_requests, bounded)
+{
+    container_requests reqs(2, 10, 10);
+    reqs.on_asked("aaa", 0);
+    reqs.on_asked("bbb", 5);
+    ASSERT_FALSE(reqs.should_ask("ccc", 5));
+    ASSERT_EQ(reqs.get_hits(), 1);
+
+    // "aaa" expired, making room
+    ASSERT_TRUE(reqs.should_ask("ccc", 10));
+    reqs.on_asked("ccc", 10);
+    ASSERT_EQ(reqs.get_pending(), 2);
+    ASSERT_FALSE(reqs.should_ask("bbb", 10));
+}
+
+TEST(container_requests, priority)
+{
+    container_requests reqs(16, 10, 40);
+    reqs.on_asked("aaa", 0);
+
+    // Upgraded once while backing off, the backoff being unchanged
+    ASSERT_TRUE(reqs.should_ask("aaa", 5, true));
+    reqs.on_asked("aaa", 5, true);
+    ASSERT_FALSE(reqs.should_ask("aaa", 6, true));
+    ASSERT_FALSE(reqs.should_ask("aaa", 9));
+    ASSERT_TRUE(reqs.should_ask("aaa", 10));
+    ASSERT_EQ(reqs.get_hits(), 2);
+    ASSERT_EQ(reqs.get_misses(), 2);
+
+    // Asked as priority from the start
+    ASSERT_TRUE(reqs.should_ask("bbb", 0, true));
+    reqs.on_asked("bbb", 0, true);
+    ASSERT_FALSE(reqs.should_ask("bbb", 5, true));
+
+    // A retry can be upgraded again
+    reqs.on_asked("aaa", 10);
+    ASSERT_TRUE(reqs.should_ask("aaa", 15, true));
+    reqs.on_asked("aaa", 15, true);
+    ASSERT_FALSE(reqs.should_ask("aaa", 29));
+    ASSERT_TRUE(reqs.should_ask("aaa", 30));
+}
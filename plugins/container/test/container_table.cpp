@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include <container_table.h>
+
+#include <random>
+#include <unordered_map>
+
+static container_table::value_type make_info(const std::string& id)
+{
+    auto info = std::make_shared<container_info>();
+    info->m_id = id;
+    return info;
+}
+
+TEST(container_table, basic)
+{
+    container_table t;
+    ASSERT_TRUE(t.empty());
+    ASSERT_EQ(t.find("aaa"), nullptr);
+
+    t.set("", container_info::host_container_info());
+    t.set("aaa", make_info("aaa"));
+    ASSERT_EQ(t.size(), 2);
+    ASSERT_EQ((*t.find(""))->m_id, HOST_CONTAINER_ID);
+    ASSERT_EQ((*t.find("aaa"))->m_id, "aaa");
+    ASSERT_TRUE(t.contains("aaa"));
+    ASSERT_FALSE(t.contains("bbb"));
+
+    // Replaced
+    auto updated = make_info("aaa");
+    t.set("aaa", updated);
+    ASSERT_EQ(t.size(), 2);
+    ASSERT_EQ(*t.find("aaa"), updated);
+
+    ASSERT_TRUE(t.erase("aaa"));
+    ASSERT_FALSE(t.erase("aaa"));
+    ASSERT_EQ(t.size(), 1);
+    t.set("bbb", nullptr);
+    ASSERT_EQ(t.size(), 1);
+
+    t.clear();
+    ASSERT_TRUE(t.empty());
+    ASSERT_EQ(t.begin(), t.end());
+}
+
+// Random inserts and erases, against std::unordered_map
+TEST(container_table, random)
+{
+    container_table t;
+    std::unordered_map<std::string, container_table::value_type> ref;
+    std::mt19937 rng(42);
+    for(int i = 0; i < 20000; i++)
+    {
+        auto id = std::to_string(rng() % 512);
+        if(rng() % 3 == 0)
+        {
+            ASSERT_EQ(t.erase(id), ref.erase(id) == 1);
+        }
+        else
+        {
+            auto info = make_info(id);
+            t.set(id, info);
+            ref[id] = info;
+        }
+        ASSERT_EQ(t.size(), ref.size());
+    }
+    ASSERT_LE(t.size() * 2, t.capacity());
+
+    for(const auto& r : ref)
+    {
+        auto found = t.find(r.first);
+        ASSERT_NE(found, nullptr);
+        ASSERT_EQ(*found, r.second);
+    }
+    size_t n = 0;
+    for(const auto& e : t)
+    {
+        ASSERT_EQ(ref.at(e.first), e.second);
+        n++;
+    }
+    ASSERT_EQ(n, ref.size());
+
+    size_t memory = 0;
+    for(const auto& r : ref)
+    {
+        memory += r.second->memory_usage();
+    }
+    ASSERT_EQ(t.memory_usage(), memory);
+}
+
+TEST(container_table, memory_usage)
+{
+    container_table t;
+    ASSERT_EQ(t.memory_usage(), 0);
+
+    auto small = make_info("aaa");
+    auto large = std::make_shared<container_info>();
+    large->m_id = "aaa";
+    large->m_pod_sandbox_cniresult = std::string(4096, 'x');
+    ASSERT_GT(large->memory_usage(), small->memory_usage() + 4096);
+
+    t.set("aaa", small);
+    ASSERT_EQ(t.memory_usage(), small->memory_usage());
+    t.set("aaa", large);
+    ASSERT_EQ(t.memory_usage(), large->memory_usage());
+    t.set("bbb", small);
+    ASSERT_EQ(t.memory_usage(),
+              large->memory_usage() + small->memory_usage());
+    t.erase("aaa");
+    ASSERT_EQ(t.memory_usage(), small->memory_usage());
+    t.clear();
+    ASSERT_EQ(t.memory_usage(), 0);
+}
+
+TEST(container_table, evict)
+{
+    container_table t;
+    t.set("", container_info::host_container_info());
+    for(int i = 0; i < 100; i++)
+    {
+        t.set(std::to_string(i), make_info(std::to_string(i)));
+    }
+    // Used again, thus newer than the others
+    t.touch("0");
+    t.touch("1");
+
+    auto pinned = [](const std::string& id)
+    { return id.empty() || id == "2" || id == "3"; };
+    ASSERT_TRUE(t.evict(101, pinned).empty());
+
+    auto evicted = t.evict(11, pinned);
+    ASSERT_EQ(evicted.size(), 90);
+    // The least recently used first, pinned ones skipped
+    ASSERT_EQ(evicted.front(), "4");
+    ASSERT_EQ(evicted.back(), "93");
+    ASSERT_EQ(t.size(), 11);
+    for(const auto& id : {"", "0", "1", "2", "3", "99"})
+    {
+        ASSERT_TRUE(t.contains(id)) << id;
+    }
+
+    // Pinned entries are never evicted, even above the limit
+    evicted = t.evict(0, [](const std::string& id) { return id.size() < 2; });
+    ASSERT_EQ(evicted.size(), 6);
+    ASSERT_EQ(t.size(), 5);
+}
+
+TEST(container_table, generation)
+{
+    container_table t;
+    auto g = t.get_generation();
+    t.set("aaa", make_info("aaa"));
+    ASSERT_GT(t.get_generation(), g);
+    g = t.get_generation();
+    t.touch("aaa");
+    ASSERT_FALSE(t.erase("bbb"));
+    ASSERT_EQ(t.get_generation(), g);
+    ASSERT_TRUE(t.erase("aaa"));
+    ASSERT_GT(t.get_generation(), g);
+}
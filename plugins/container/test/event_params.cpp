@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <plugin_toolkit/event_params.h>
+
+#include <string>
+#include <vector>
+
+// A sinsp event with the given params, with 16 or 32-bit lengths
+template<typename L>
+static std::vector<uint8_t> make_event(const std::vector<std::string>& params)
+{
+    falcosecurity::_internal::ss_plugin_event hdr = {};
+    hdr.nparams = (uint32_t)params.size();
+    std::vector<uint8_t> evt((uint8_t*)&hdr, (uint8_t*)&hdr + sizeof(hdr));
+    for(const auto& p : params)
+    {
+        L len = (L)p.size();
+        evt.insert(evt.end(), (uint8_t*)&len, (uint8_t*)&len + sizeof(len));
+    }
+    for(const auto& p : params)
+    {
+        evt.insert(evt.end(), p.begin(), p.end());
+    }
+    return evt;
+}
+
+TEST(event_params, get)
+{
+    std::vector<std::string> params = {std::string("id\0", 3), "",
+                                       std::string("name\0", 5), "image"};
+    auto evt = make_event<uint16_t>(params);
+
+    event_params<> p(evt.data());
+    ASSERT_EQ(p.size(), 4);
+    for(uint32_t i = 0; i < params.size(); i++)
+    {
+        auto param = p.get(i);
+        auto single = get_syscall_evt_param(evt.data(), i);
+        ASSERT_EQ(param.param_len, params[i].size());
+        ASSERT_EQ(param.param_pointer, single.param_pointer);
+        ASSERT_EQ(param.param_len, single.param_len);
+        ASSERT_EQ(std::string((char*)param.param_pointer, param.param_len),
+                  params[i]);
+    }
+    ASSERT_EQ(param_as_string_view(p.get(0)), "id");
+    ASSERT_EQ(param_as_string_view(p.get(1)), "");
+    // Not NUL terminated, never read past its length
+    ASSERT_EQ(param_as_string_view(p.get(3)), "image");
+
+    // Out of range
+    ASSERT_EQ(p.get(4).param_pointer, nullptr);
+    ASSERT_EQ(get_syscall_evt_param(evt.data(), 4).param_pointer, nullptr);
+}
+
+TEST(event_params, large_payload)
+{
+    std::string json(100000, 'x');
+    std::vector<std::string> params = {json, "after"};
+    auto evt = make_event<uint32_t>(params);
+
+    event_params<true> p(evt.data());
+    ASSERT_EQ(p.size(), 2);
+    ASSERT_EQ(p.get(0).param_len, json.size());
+    ASSERT_EQ(param_as_string_view(p.get(1)), "after");
+    auto single = get_syscall_evt_param<true>(evt.data(), 1);
+    ASSERT_EQ(single.param_pointer, p.get(1).param_pointer);
+}
+
+TEST(event_params, no_params)
+{
+    auto evt = make_event<uint16_t>({});
+    event_params<> p(evt.data());
+    ASSERT_EQ(p.size(), 0);
+    ASSERT_EQ(p.get(0).param_pointer, nullptr);
+}
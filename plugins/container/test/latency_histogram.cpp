@@ -0,0 +1,33 @@
+#include <gtest/gtest.h>
+#include <plugin_toolkit/latency_histogram.h>
+
+TEST(latency_histogram, buckets)
+{
+    latency_histogram h;
+    h.record(500);
+    h.record(1000);
+    h.record(50000);
+    h.record(20000000);
+
+    ASSERT_EQ(h.get_count(), 4);
+    ASSERT_EQ(h.get_sum_ns(), 20051500);
+    ASSERT_EQ(h.get_cumulative(0), 2); // le_1us
+    ASSERT_EQ(h.get_cumulative(1), 2); // le_10us
+    ASSERT_EQ(h.get_cumulative(2), 3); // le_100us
+    // Values above the last bound are only counted
+    ASSERT_EQ(h.get_cumulative(latency_histogram::n_bounds - 1), 3);
+}
+
+TEST(latency_histogram, timer)
+{
+    latency_histogram h;
+    auto start = monotonic_ns();
+    {
+        latency_timer timer(h);
+    }
+    {
+        latency_timer timer(h);
+    }
+    ASSERT_EQ(h.get_count(), 2);
+    ASSERT_LE(h.get_sum_ns(), monotonic_ns() - start);
+}
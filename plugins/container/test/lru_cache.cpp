@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+#include <plugin_toolkit/lru_cache.h>
+
+#include <string>
+
+TEST(string_lru_cache, basic)
+{
+    string_lru_cache<uint64_t> c(2);
+    ASSERT_EQ(c.find("/a"), nullptr);
+
+    c.insert("/a", 1);
+    c.insert("/b", 2);
+    ASSERT_EQ(c.size(), 2);
+    ASSERT_EQ(*c.find("/a"), 1);
+
+    // "/b" is the least recently used
+    c.insert("/c", 3);
+    ASSERT_EQ(c.size(), 2);
+    ASSERT_EQ(c.find("/b"), nullptr);
+    ASSERT_EQ(*c.find("/a"), 1);
+    ASSERT_EQ(*c.find("/c"), 3);
+
+    // Overwritten in place
+    c.insert("/a", 4);
+    ASSERT_EQ(c.size(), 2);
+    ASSERT_EQ(*c.find("/a"), 4);
+
+    // Values can be updated through `find`
+    *c.find("/c") = 5;
+    ASSERT_EQ(*c.find("/c"), 5);
+
+    ASSERT_TRUE(c.erase("/a"));
+    ASSERT_FALSE(c.erase("/a"));
+    ASSERT_EQ(c.size(), 1);
+    c.clear();
+    ASSERT_EQ(c.size(), 0);
+    ASSERT_EQ(c.find("/c"), nullptr);
+}
+
+TEST(string_lru_cache, disabled)
+{
+    string_lru_cache<uint64_t> c(0);
+    c.insert("/a", 1);
+    ASSERT_EQ(c.size(), 0);
+    ASSERT_EQ(c.find("/a"), nullptr);
+}
+
+TEST(string_lru_cache, long_keys)
+{
+    // Keys are owned by the cache, the inserted strings may go away
+    string_lru_cache<std::string> c(16);
+    for(int i = 0; i < 32; i++)
+    {
+        std::string key = "/kubepods.slice/kubepods-burstable.slice/" +
+                          std::to_string(i);
+        c.insert(key, std::to_string(i));
+    }
+    ASSERT_EQ(c.size(), 16);
+    for(int i = 16; i < 32; i++)
+    {
+        auto key = "/kubepods.slice/kubepods-burstable.slice/" +
+                   std::to_string(i);
+        ASSERT_NE(c.find(key), nullptr);
+        ASSERT_EQ(*c.find(key), std::to_string(i));
+    }
+}
@@ -188,3 +188,204 @@ INSTANTIATE_TEST_SUITE_P(
                            "init.scope",
                  .should_match = false}}),
         test_name_generator);
+
+TEST(matchers_cache, cache)
+{
+    const std::string docker_cgroup =
+            "/docker/"
+            "7951fb549ab99e0722a949b6c121634e1f3a36b5bacbe5392991e3b12251e6b8";
+    const std::string crio_cgroup =
+            "/kubepods/besteffort/pod63b3ebfc-2890-11e9-8154-16bf8ef8d9dc/"
+            "crio-73bfe475650de66df8e2affdc98d440dcbe84f8df83b6f75a68a82eb70261"
+            "36a";
+    const std::string host_cgroup =
+            "/user.slice/user-1000.slice/user@1000.service/init.scope";
+    matcher_manager mgr(Engines{}, 2);
+
+    std::string container_id;
+    container_info::ptr_t info;
+    EXPECT_TRUE(mgr.match_cgroup(docker_cgroup, container_id, info));
+    EXPECT_EQ(container_id, "7951fb549ab9");
+    EXPECT_EQ(mgr.get_cache_size(), 1);
+
+    // Cache hit
+    container_id.clear();
+    EXPECT_TRUE(mgr.match_cgroup(docker_cgroup, container_id, info));
+    EXPECT_EQ(container_id, "7951fb549ab9");
+    EXPECT_EQ(mgr.get_cache_size(), 1);
+
+    // Misses are cached too
+    container_id.clear();
+    EXPECT_FALSE(mgr.match_cgroup(host_cgroup, container_id, info));
+    EXPECT_FALSE(mgr.match_cgroup(host_cgroup, container_id, info));
+    EXPECT_TRUE(container_id.empty());
+    EXPECT_EQ(mgr.get_cache_size(), 2);
+
+    // The least recently used entry (docker) gets evicted
+    EXPECT_TRUE(mgr.match_cgroup(crio_cgroup, container_id, info));
+    EXPECT_EQ(container_id, "73bfe475650d");
+    EXPECT_EQ(mgr.get_cache_size(), 2);
+    EXPECT_TRUE(mgr.match_cgroup(docker_cgroup, container_id, info));
+    EXPECT_EQ(container_id, "7951fb549ab9");
+    EXPECT_EQ(mgr.get_cache_size(), 2);
+
+    // Cached results still count as matches of their engine
+    const auto& names = mgr.get_matcher_names();
+    const auto& hits = mgr.get_matcher_hits();
+    auto engine_hits = [&](const std::string& name)
+    {
+        auto it = std::find(names.begin(), names.end(), name);
+        return it == names.end() ? UINT64_MAX : hits[it - names.begin()];
+    };
+    EXPECT_EQ(engine_hits("docker"), 3);
+    EXPECT_EQ(engine_hits("cri"), 1);
+    EXPECT_EQ(mgr.get_unmatched(), 2);
+    EXPECT_EQ(mgr.get_cache_hits(), 2);
+    EXPECT_EQ(mgr.get_cache_misses(), 4);
+
+    // Removed containers are dropped, negative entries are kept
+    mgr.forget_container("7951fb549ab9");
+    EXPECT_EQ(mgr.get_cache_size(), 1);
+    mgr.forget_container("");
+    EXPECT_EQ(mgr.get_cache_size(), 1);
+}
+
+TEST(matchers_scanner, same_as_matches_runc_cgroup)
+{
+    using namespace libsinsp::runc;
+    const std::string id =
+            "7951fb549ab99e0722a949b6c121634e1f3a36b5bacbe5392991e3b12251e6b8";
+    const cgroup_layout layout_a[] = {{"/", ""},
+                                      {"/docker-", ".scope"},
+                                      {"/libpod-", ".scope/container"},
+                                      {nullptr, nullptr}};
+    const cgroup_layout layout_b[] = {{"/crio-", ""},
+                                      {":cri-containerd:", ""},
+                                      {"/docker-", ".scope"},
+                                      {nullptr, nullptr}};
+    layout_scanner scanner;
+    auto a = scanner.add(layout_a);
+    auto b = scanner.add(layout_b);
+
+    const std::vector<std::string> cgroups = {
+            "/docker/" + id,
+            "/docker.slice/docker-" + id + ".scope",
+            "/docker.slice/docker-" + id + ".scope/nested",
+            "/machine.slice/libpod-" + id + ".scope/container",
+            "/kubepods/crio-" + id,
+            "/system.slice/containerd.service:cri-containerd:" + id,
+            "/docker/" + id.substr(0, 63) + "g",
+            "/docker/short",
+            "/user.slice/user-1000.slice/user@1000.service/init.scope",
+            "/",
+            "",
+    };
+    for(const auto& cgroup : cgroups)
+    {
+        scanner.scan(cgroup);
+        for(bool is_containerd : {false, true})
+        {
+            std::string expected, actual;
+            bool expected_a = matches_runc_cgroup(cgroup, layout_a, expected,
+                                                  is_containerd);
+            EXPECT_EQ(scanner.match(a, cgroup, actual, is_containerd),
+                      expected_a)
+                    << cgroup;
+            EXPECT_EQ(actual, expected) << cgroup;
+
+            expected.clear();
+            actual.clear();
+            bool expected_b = matches_runc_cgroup(cgroup, layout_b, expected,
+                                                  is_containerd);
+            EXPECT_EQ(scanner.match(b, cgroup, actual, is_containerd),
+                      expected_b)
+                    << cgroup;
+            EXPECT_EQ(actual, expected) << cgroup;
+        }
+    }
+}
+
+TEST(matchers_cache, cgroup_id)
+{
+    const std::string docker_cgroup =
+            "/docker/"
+            "7951fb549ab99e0722a949b6c121634e1f3a36b5bacbe5392991e3b12251e6b8";
+    const std::string host_cgroup = "/system.slice/sshd.service";
+    const std::string other_cgroup = "/system.slice/cron.service";
+    matcher_manager mgr(Engines{}, 2);
+
+    std::string container_id;
+    container_info::ptr_t info;
+    bool matched;
+    // Unknown ids fall back to the cgroup path
+    EXPECT_FALSE(mgr.match_cgroup_id(100, matched, container_id, info));
+    // Only cached paths get bound
+    mgr.bind_cgroup_id(docker_cgroup, 100);
+    EXPECT_EQ(mgr.get_cgroup_ids_size(), 0);
+
+    EXPECT_TRUE(mgr.match_cgroup(docker_cgroup, container_id, info));
+    mgr.bind_cgroup_id(docker_cgroup, 100);
+    EXPECT_FALSE(mgr.match_cgroup(host_cgroup, container_id, info));
+    mgr.bind_cgroup_id(host_cgroup, 200);
+    EXPECT_EQ(mgr.get_cgroup_ids_size(), 2);
+
+    container_id.clear();
+    EXPECT_TRUE(mgr.match_cgroup_id(100, matched, container_id, info));
+    EXPECT_TRUE(matched);
+    EXPECT_EQ(container_id, "7951fb549ab9");
+    container_id.clear();
+    EXPECT_TRUE(mgr.match_cgroup_id(200, matched, container_id, info));
+    EXPECT_FALSE(matched);
+    EXPECT_TRUE(container_id.empty());
+
+    // Evicting the path (docker is the least recently used) drops its id
+    EXPECT_FALSE(mgr.match_cgroup(other_cgroup, container_id, info));
+    EXPECT_FALSE(mgr.match_cgroup_id(100, matched, container_id, info));
+    EXPECT_EQ(mgr.get_cgroup_ids_size(), 1);
+
+    // A reused id moves to the new path
+    mgr.bind_cgroup_id(other_cgroup, 200);
+    EXPECT_EQ(mgr.get_cgroup_ids_size(), 1);
+    EXPECT_TRUE(mgr.match_cgroup_id(200, matched, container_id, info));
+    EXPECT_FALSE(matched);
+
+    // Removed containers drop their ids too
+    EXPECT_TRUE(mgr.match_cgroup(docker_cgroup, container_id, info));
+    mgr.bind_cgroup_id(docker_cgroup, 100);
+    mgr.forget_container("7951fb549ab9");
+    EXPECT_FALSE(mgr.match_cgroup_id(100, matched, container_id, info));
+}
+
+TEST(matchers_cache, pod_uid)
+{
+    const std::string crio_cgroup =
+            "/kubepods.slice/kubepods-besteffort.slice/"
+            "kubepods-besteffort-pod63b3ebfc_2890_11e9_8154_16bf8ef8d9dc.slice/"
+            "crio-73bfe475650de66df8e2affdc98d440dcbe84f8df83b6f75a68a82eb70261"
+            "36a.scope";
+    const std::string docker_cgroup =
+            "/docker/"
+            "7951fb549ab99e0722a949b6c121634e1f3a36b5bacbe5392991e3b12251e6b8";
+
+    for(size_t cache_size : {0, 2})
+    {
+        matcher_manager mgr(Engines{}, cache_size);
+        std::string container_id;
+        container_info::ptr_t info;
+        std::string pod_uid;
+        // Twice: the second lookup hits the cache, when enabled
+        for(int i = 0; i < 2; i++)
+        {
+            container_id.clear();
+            EXPECT_TRUE(mgr.match_cgroup(crio_cgroup, container_id, info,
+                                         &pod_uid));
+            EXPECT_EQ(pod_uid, "63b3ebfc-2890-11e9-8154-16bf8ef8d9dc");
+
+            // Not a pod, the previous uid is cleared
+            container_id.clear();
+            EXPECT_TRUE(mgr.match_cgroup(docker_cgroup, container_id, info,
+                                         &pod_uid));
+            EXPECT_TRUE(pod_uid.empty());
+        }
+    }
+}
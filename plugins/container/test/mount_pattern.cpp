@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include <container_info.h>
+#include <mount_pattern.h>
+
+TEST(mount_pattern, kinds)
+{
+    ASSERT_EQ(mount_pattern("/var/run/docker.sock").get_kind(),
+              mount_pattern::MP_SUBSTRING);
+    ASSERT_EQ(mount_pattern("^/var/run").get_kind(), mount_pattern::MP_PREFIX);
+    ASSERT_EQ(mount_pattern("docker.sock$").get_kind(),
+              mount_pattern::MP_SUFFIX);
+    ASSERT_EQ(mount_pattern("^/var/run/docker.sock$").get_kind(),
+              mount_pattern::MP_EQUAL);
+    ASSERT_EQ(mount_pattern("/tmp/*").get_kind(), mount_pattern::MP_REGEX);
+    ASSERT_EQ(mount_pattern("tmp/[fo,ba]").get_kind(),
+              mount_pattern::MP_REGEX);
+
+    mount_pattern p("^/var/run/docker.sock$");
+    ASSERT_EQ(p.get_literal(), "/var/run/docker.sock");
+    ASSERT_TRUE(p.has_wildcards());
+    ASSERT_FALSE(mount_pattern("^/var/run").has_wildcards());
+}
+
+TEST(mount_pattern, match)
+{
+    // `.` is still a wildcard
+    ASSERT_TRUE(mount_pattern("docker.sock").match("/run/docker.sock"));
+    ASSERT_TRUE(mount_pattern("docker.sock").match("/run/docker_sock"));
+    ASSERT_FALSE(mount_pattern("docker.sock").match("/run/docker\nsock"));
+    ASSERT_TRUE(mount_pattern("^/run").match("/run/docker.sock"));
+    ASSERT_FALSE(mount_pattern("^/run").match("/var/run/docker.sock"));
+    ASSERT_TRUE(mount_pattern("sock$").match("/run/docker.sock"));
+    ASSERT_FALSE(mount_pattern("sock$").match("/run/docker.sock/x"));
+    ASSERT_TRUE(mount_pattern("^/run$").match("/run"));
+    ASSERT_FALSE(mount_pattern("^/run$").match("/run/x"));
+    ASSERT_TRUE(mount_pattern("").match("/run"));
+    ASSERT_FALSE(mount_pattern("/run/docker.sock").match("/run"));
+}
+
+TEST(mount_pattern, mounts)
+{
+    container_info info{};
+    info.m_mounts.emplace_back("/var/lib/b", "/b", "", false, "");
+    info.m_mounts.emplace_back("/var/lib", "/a", "", false, "");
+    info.m_mounts.emplace_back("/var/lib/a", "/c", "", false, "");
+    info.m_mounts.emplace_back("/var/run/docker.sock", "/d", "", false, "");
+
+    // The first matching mount wins, whatever indexed lookup is used
+    ASSERT_EQ(info.mount_by_source(mount_pattern("^/var/lib"))->m_dest, "/b");
+    ASSERT_EQ(info.mount_by_source(mount_pattern("^/var/lib/a"))->m_dest,
+              "/c");
+    ASSERT_EQ(info.mount_by_source(mount_pattern("^/var/lib$"))->m_dest, "/a");
+    ASSERT_EQ(info.mount_by_source(mount_pattern("^/var/li$")), nullptr);
+    ASSERT_EQ(info.mount_by_source(mount_pattern("^/var/z")), nullptr);
+    ASSERT_EQ(info.mount_by_source(mount_pattern("docker.sock"))->m_dest,
+              "/d");
+    ASSERT_EQ(info.mount_by_source(mount_pattern("lib/[ab]"))->m_dest, "/b");
+    ASSERT_EQ(info.mount_by_dest(mount_pattern("^/c$"))->m_source,
+              "/var/lib/a");
+}
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include <container_info.h>
+#include <plugin_toolkit/string_pool.h>
+
+TEST(string_pool, intern)
+{
+    auto& pool = string_pool::instance();
+    auto size = pool.size();
+    {
+        interned_string a = "docker.io/library/nginx:1.27";
+        std::string s = "docker.io/library/nginx:1.27";
+        interned_string b = s;
+        ASSERT_EQ(pool.size(), size + 1);
+        ASSERT_EQ(a, b);
+        ASSERT_EQ(&a.str(), &b.str());
+        ASSERT_EQ(a, s);
+        ASSERT_EQ(a, "docker.io/library/nginx:1.27");
+
+        interned_string c = b;
+        b = "docker.io/library/nginx:1.28";
+        ASSERT_EQ(pool.size(), size + 2);
+        ASSERT_NE(a, b);
+        ASSERT_EQ(a, c);
+
+        // The empty string is never pooled
+        interned_string empty = "";
+        ASSERT_TRUE(empty.empty());
+        ASSERT_EQ(empty, interned_string());
+        ASSERT_STREQ(empty.c_str(), "");
+        ASSERT_EQ(pool.size(), size + 2);
+    }
+    // Dropped along with the last reference
+    ASSERT_EQ(pool.size(), size);
+}
+
+TEST(string_pool, labels)
+{
+    container_labels labels = {{"tier", "web"}, {"app", "nginx"}, {"env", ""}};
+    ASSERT_EQ(labels.size(), 3);
+    ASSERT_EQ(labels.begin()->first, "app");
+    ASSERT_EQ(labels.count("app"), 1);
+    ASSERT_EQ(labels.count("ap"), 0);
+    ASSERT_EQ(labels.at("tier"), "web");
+    ASSERT_EQ(labels.at("env"), "");
+    ASSERT_EQ(labels.find("missing"), labels.end());
+    ASSERT_THROW(labels.at("missing"), std::out_of_range);
+
+    // Existing labels are kept
+    ASSERT_FALSE(labels.emplace("tier", "db"));
+    ASSERT_EQ(labels.at("tier"), "web");
+    ASSERT_TRUE(labels.emplace("zone", "eu"));
+    ASSERT_TRUE(labels.emplace("bar", "1"));
+
+    std::vector<std::string> keys;
+    for(const auto& label : labels)
+    {
+        keys.push_back(label.first);
+    }
+    ASSERT_EQ(keys, std::vector<std::string>(
+                            {"app", "bar", "env", "tier", "zone"}));
+
+    container_labels other = {{"zone", "eu"}, {"app", "nginx"}, {"bar", "1"},
+                              {"env", ""},    {"tier", "web"}};
+    ASSERT_EQ(labels, other);
+}
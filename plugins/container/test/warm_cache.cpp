@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <warm_cache.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <unistd.h>
+
+static std::shared_ptr<const container_info> make_info(const std::string& id,
+                                                       const std::string& image)
+{
+    auto info = std::make_shared<container_info>();
+    info->m_type = CT_CONTAINERD;
+    info->m_id = id;
+    info->m_image = image;
+    info->m_labels = {{"app", id}};
+    return info;
+}
+
+static std::string temp_path()
+{
+    return testing::TempDir() + "warm_cache_" + std::to_string(getpid()) +
+           ".bin";
+}
+
+TEST(warm_cache, roundtrip)
+{
+    auto path = temp_path();
+    warm_cache_entries containers{make_info("aaaaaaaaaaaa", "nginx"),
+                                  make_info("bbbbbbbbbbbb", "redis")};
+    save_warm_cache(path, containers);
+
+    auto infos = load_warm_cache(path, 2);
+    ASSERT_EQ(infos.size(), 2);
+    EXPECT_EQ(infos[0]->m_id, "aaaaaaaaaaaa");
+    EXPECT_EQ(infos[0]->m_image, "nginx");
+    EXPECT_EQ(infos[0]->m_type, CT_CONTAINERD);
+    EXPECT_EQ(infos[1]->m_id, "bbbbbbbbbbbb");
+    EXPECT_EQ(infos[1]->m_image, "redis");
+
+    // Replaced as a whole
+    save_warm_cache(path, {});
+    EXPECT_TRUE(load_warm_cache(path, 1).empty());
+    std::remove(path.c_str());
+}
+
+TEST(warm_cache, invalid)
+{
+    auto path = temp_path();
+    EXPECT_THROW(load_warm_cache(path, 1), std::runtime_error);
+
+    {
+        std::ofstream f(path, std::ios::binary);
+        f << "not a warm cache snapshot";
+    }
+    EXPECT_THROW(load_warm_cache(path, 1), std::runtime_error);
+
+    // Truncated payloads
+    save_warm_cache(path, {make_info("aaaaaaaaaaaa", "nginx")});
+    std::string data;
+    {
+        std::ifstream f(path, std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(f), {});
+    }
+    {
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        f.write(data.data(), data.size() - 4);
+    }
+    EXPECT_THROW(load_warm_cache(path, 1), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+TEST(warm_cache, writer)
+{
+    auto path = temp_path();
+    {
+        warm_cache_writer writer(path);
+        writer.submit({make_info("aaaaaaaaaaaa", "nginx")});
+        writer.submit({make_info("aaaaaaaaaaaa", "nginx"),
+                       make_info("bbbbbbbbbbbb", "redis")});
+    }
+    // The last submitted snapshot wins, written before the writer is gone
+    auto infos = load_warm_cache(path, 1);
+    ASSERT_EQ(infos.size(), 2);
+    EXPECT_EQ(infos[1]->m_id, "bbbbbbbbbbbb");
+    std::remove(path.c_str());
+
+    warm_cache_writer failing("/nonexistent/dir/warm_cache.bin");
+    failing.submit({make_info("aaaaaaaaaaaa", "nginx")});
+    while(failing.get_n_errors() == 0)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(failing.get_n_writes(), 0);
+    EXPECT_NE(failing.get_last_error().find("cannot open"), std::string::npos);
+}
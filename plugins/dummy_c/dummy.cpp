@@ -17,6 +17,11 @@ limitations under the License.
 
 #include <falcosecurity/sdk.h>
 
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include <vector>
+
 #define PLUGIN_ID 4
 #define PLUGIN_NAME "dummy_c"
 #define PLUGIN_DESCRIPTION "Reference plugin for educational purposes"
@@ -28,16 +33,66 @@ limitations under the License.
 #define DEFAULT_JITTER 10
 #define DEFAULT_MAX_EVENTS 20
 #define DEFAULT_START_VALUE 1
+#define DEFAULT_PAYLOAD_SIZE sizeof(uint64_t)
+#define MAX_PAYLOAD_SIZE 65536
+#define DEFAULT_REPORT_INTERVAL 0
+
+// The clock is only read once every this many events
+#define REPORT_CHECK_EVENTS 4096
+
+// xorshift64*, owned by each instance: unlike `random()` it takes no lock
+class dummy_rng
+{
+    public:
+    dummy_rng(uint64_t seed)
+    {
+        // splitmix64 of the seed, the state must not be 0
+        seed += 0x9e3779b97f4a7c15;
+        seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9;
+        seed = (seed ^ (seed >> 27)) * 0x94d049bb133111eb;
+        m_state = (seed ^ (seed >> 31)) | 1;
+    }
+
+    uint64_t next()
+    {
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+        return m_state * 0x2545f4914f6cdd1d;
+    }
+
+    private:
+    uint64_t m_state;
+};
 
 class dummy_source
 {
     public:
-    virtual ~dummy_source() = default;
+    virtual ~dummy_source()
+    {
+        if(m_report_interval > 0 && m_event_count > 0)
+        {
+            report(m_event_count, std::chrono::steady_clock::now() - m_start);
+        }
+    }
 
-    dummy_source(uint64_t max_evts, uint64_t start, uint64_t jitter):
+    dummy_source(uint64_t max_evts, uint64_t start, uint64_t jitter,
+                 size_t payload_size, uint64_t report_interval):
             m_event_count(0), m_max_evts(max_evts), m_sample_value(start),
-            m_jitter(jitter), m_enc()
+            m_jitter(jitter), m_rng(start), m_payload(payload_size),
+            m_enc(), m_report_interval(report_interval),
+            m_start(std::chrono::steady_clock::now()),
+            m_last_report(m_start), m_last_report_count(0)
     {
+        // The payload is encoded once: the sample value is in its first 8
+        // bytes, and only these change between two events
+        for(size_t i = sizeof(uint64_t); i < m_payload.size(); i++)
+        {
+            m_payload[i] = (uint8_t)('a' + i % 26);
+        }
+
+        // we will memcpy the content of `m_payload` inside `m_enc.encode`.
+        m_enc.set_data((void *)m_payload.data(), m_payload.size());
     }
 
     falcosecurity::result_code next_event(falcosecurity::event_writer &evt)
@@ -49,20 +104,59 @@ class dummy_source
         m_event_count++;
 
         // Increment sample by 1, also add a jitter of [0:jitter]
-        m_sample_value += 1 + (random() % (m_jitter + 1));
+        m_sample_value += 1;
+        if(m_jitter > 0)
+        {
+            m_sample_value += m_rng.next() % (m_jitter + 1);
+        }
 
-        // we will memcpy the content of `m_sample_value` inside `m_enc.encode`.
-        m_enc.set_data((void *)&m_sample_value, sizeof(uint64_t));
+        memcpy(m_payload.data(), &m_sample_value, sizeof(uint64_t));
         m_enc.encode(evt);
+
+        if(m_report_interval > 0 &&
+           m_event_count % REPORT_CHECK_EVENTS == 0)
+        {
+            check_report();
+        }
         return falcosecurity::result_code::SS_PLUGIN_SUCCESS;
     }
 
     private:
+    void check_report()
+    {
+        auto now = std::chrono::steady_clock::now();
+        auto elapsed = now - m_last_report;
+        if(elapsed < std::chrono::seconds(m_report_interval))
+        {
+            return;
+        }
+        report(m_event_count - m_last_report_count, elapsed);
+        m_last_report = now;
+        m_last_report_count = m_event_count;
+    }
+
+    static void report(uint64_t n_evts,
+                       std::chrono::steady_clock::duration elapsed)
+    {
+        double secs = std::chrono::duration<double>(elapsed).count();
+        printf("%s %" PRIu64 " events in %.3fs (%.0f events/s)\n",
+               PLUGIN_LOG_PREFIX, n_evts, secs,
+               secs > 0 ? (double)n_evts / secs : 0);
+    }
+
     uint64_t m_event_count;
     uint64_t m_max_evts;
     uint64_t m_sample_value;
     uint64_t m_jitter;
+    dummy_rng m_rng;
+    std::vector<uint8_t> m_payload;
     falcosecurity::events::pluginevent_e_encoder m_enc;
+
+    // Throughput report, disabled when the interval is 0
+    uint64_t m_report_interval;
+    std::chrono::steady_clock::time_point m_start;
+    std::chrono::steady_clock::time_point m_last_report;
+    uint64_t m_last_report_count;
 };
 
 class dummy
@@ -100,6 +194,18 @@ class dummy
             {
                 m_jitter = *it;
             }
+
+            it = cfg.find("payloadSize");
+            if(it != cfg.end())
+            {
+                m_payload_size = *it;
+            }
+
+            it = cfg.find("reportInterval");
+            if(it != cfg.end())
+            {
+                m_report_interval = *it;
+            }
         }
         catch(std::exception e)
         {
@@ -108,6 +214,16 @@ class dummy
             return false;
         }
 
+        if(m_payload_size < sizeof(uint64_t) ||
+           m_payload_size > MAX_PAYLOAD_SIZE)
+        {
+            m_lasterr = "'payloadSize' must be between " +
+                        std::to_string(sizeof(uint64_t)) + " and " +
+                        std::to_string(MAX_PAYLOAD_SIZE);
+            log_error(m_lasterr);
+            return false;
+        }
+
         return true;
     }
 
@@ -151,11 +267,15 @@ class dummy
         auto &req = in.get_extract_request();
         falcosecurity::events::pluginevent_e_decoder dec(in.get_event_reader());
         uint32_t len = 0;
-        auto sample = *((uint64_t *)(dec.get_data(len)));
-        if(len != sizeof(uint64_t))
+        auto data = dec.get_data(len);
+        if(len < sizeof(uint64_t))
         {
             log_error("invalid event payload");
+            return false;
         }
+        // The sample is in the first 8 bytes, the rest is filler
+        uint64_t sample = 0;
+        memcpy(&sample, data, sizeof(uint64_t));
 
         switch(req.get_field_id())
         {
@@ -229,11 +349,14 @@ class dummy
         }
 
         return std::unique_ptr<dummy_source>(
-                new dummy_source(max_events, start, m_jitter));
+                new dummy_source(max_events, start, m_jitter, m_payload_size,
+                                 m_report_interval));
     }
 
     std::string m_lasterr = "";
     uint64_t m_jitter = DEFAULT_JITTER;
+    size_t m_payload_size = DEFAULT_PAYLOAD_SIZE;
+    uint64_t m_report_interval = DEFAULT_REPORT_INTERVAL;
 };
 
 FALCOSECURITY_PLUGIN(dummy);
@@ -0,0 +1,261 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <plugin.h>
+#include <metadata.pb.h>
+#include <google/protobuf/util/json_util.h>
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+/*
+ * Deterministic inputs of the benchmarks: every generator is seeded with a
+ * fixed value, so that two runs, or two releases, measure the same corpus.
+ */
+
+#define CORPUS_SEED 42
+// Label set on every resource, looked up by the `label[<key>]` fields
+#define CORPUS_LABEL_KEY "app"
+
+inline std::string random_hex(std::mt19937_64& rng, size_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string s(len, '0');
+    for(auto& c : s)
+    {
+        c = digits[rng() & 0xf];
+    }
+    return s;
+}
+
+// eg: 63b3ebfc-2890-11e9-8154-16bf8ef8d9dc
+inline std::string random_uid(std::mt19937_64& rng)
+{
+    return random_hex(rng, 8) + "-" + random_hex(rng, 4) + "-" +
+           random_hex(rng, 4) + "-" + random_hex(rng, 4) + "-" +
+           random_hex(rng, 12);
+}
+
+// A `Create` event as the collector sends it, with `n_labels` labels past
+// `CORPUS_LABEL_KEY`
+inline metadata::Event make_event(std::mt19937_64& rng, const char* kind,
+                                  const std::string& uid,
+                                  const std::string& name,
+                                  const std::string& ns, size_t n_labels)
+{
+    metadata::Event event;
+    event.set_reason(REASON_CREATE);
+    event.set_kind(kind);
+    event.set_uid(uid);
+
+    nlohmann::json meta;
+    meta["name"] = name;
+    if(!ns.empty())
+    {
+        meta["namespace"] = ns;
+    }
+    meta["labels"][CORPUS_LABEL_KEY] = name;
+    for(size_t i = 0; i < n_labels; i++)
+    {
+        meta["labels"]["app.kubernetes.io/label-" + std::to_string(i)] =
+                random_hex(rng, 8);
+    }
+    event.set_meta(meta.dump());
+    return event;
+}
+
+inline void add_ref(metadata::Event& event, const char* kind,
+                    const std::string& uid)
+{
+    (*event.mutable_refs()->mutable_resources())[kind].add_list(uid);
+}
+
+// Events of a cluster of `n_pods` pods, as sent to one node on the first
+// `Watch`: 1 namespace every 100 pods, 1 deployment and its replicaset
+// every 10 pods, 1 service every 20 pods. Every pod runs into a deployment
+// and is selected by 1 to 3 services.
+inline std::vector<metadata::Event> make_cluster(size_t n_pods)
+{
+    std::mt19937_64 rng(CORPUS_SEED);
+    std::vector<metadata::Event> events;
+    auto n_namespaces = n_pods / 100 + 1;
+    auto n_deployments = n_pods / 10 + 1;
+    auto n_services = n_pods / 20 + 1;
+    // No reallocation: the events refer to the ones before them
+    events.reserve(n_namespaces + 2 * n_deployments + n_services + n_pods);
+
+    for(size_t i = 0; i < n_namespaces; i++)
+    {
+        events.push_back(make_event(rng, "Namespace", random_uid(rng),
+                                    "ns-" + std::to_string(i), "", 2));
+    }
+    auto ns_of = [&](size_t i) -> const metadata::Event&
+    { return events[i % n_namespaces]; };
+    auto ns_name = [&](size_t i)
+    { return "ns-" + std::to_string(i % n_namespaces); };
+
+    size_t first_deployment = events.size();
+    for(size_t i = 0; i < n_deployments; i++)
+    {
+        auto name = "deploy-" + std::to_string(i);
+        events.push_back(make_event(rng, "Deployment", random_uid(rng), name,
+                                    ns_name(i), 4));
+        add_ref(events.back(), "Namespace", ns_of(i).uid());
+        events.push_back(make_event(rng, "ReplicaSet", random_uid(rng),
+                                    name + "-" + random_hex(rng, 10),
+                                    ns_name(i), 4));
+        add_ref(events.back(), "Namespace", ns_of(i).uid());
+        add_ref(events.back(), "Deployment", events[events.size() - 2].uid());
+    }
+
+    size_t first_service = events.size();
+    for(size_t i = 0; i < n_services; i++)
+    {
+        events.push_back(make_event(rng, "Service", random_uid(rng),
+                                    "svc-" + std::to_string(i), ns_name(i), 2));
+        add_ref(events.back(), "Namespace", ns_of(i).uid());
+    }
+
+    for(size_t i = 0; i < n_pods; i++)
+    {
+        auto d = i % n_deployments;
+        const auto& deployment = events[first_deployment + 2 * d];
+        const auto& replicaset = events[first_deployment + 2 * d + 1];
+        auto pod = make_event(rng, "Pod", random_uid(rng),
+                              "deploy-" + std::to_string(d) + "-" +
+                                      random_hex(rng, 5),
+                              ns_name(d), 8);
+        nlohmann::json status;
+        status["phase"] = "Running";
+        status["podIP"] = "10.0." + std::to_string(i / 250) + "." +
+                          std::to_string(i % 250);
+        pod.set_status(status.dump());
+        // Not read by the plugin, but parsed along the JSON events
+        nlohmann::json spec;
+        spec["nodeName"] = "node-0";
+        spec["containers"][0]["name"] = "app";
+        spec["containers"][0]["image"] = "registry.example.com/team/app:1.2.3";
+        pod.set_spec(spec.dump());
+        add_ref(pod, "Namespace", ns_of(d).uid());
+        add_ref(pod, "Deployment", deployment.uid());
+        add_ref(pod, "ReplicaSet", replicaset.uid());
+        auto n_pod_services = 1 + rng() % 3;
+        for(size_t s = 0; s < n_pod_services; s++)
+        {
+            add_ref(pod, "Service",
+                    events[first_service + (i + s) % n_services].uid());
+        }
+        events.push_back(std::move(pod));
+    }
+    return events;
+}
+
+// Recorded events of a collector `Watch` call: protobuf JSON messages one
+// after the other, as `grpcurl` prints a stream. Unreadable messages are
+// skipped.
+inline std::vector<metadata::Event> load_recorded_events(const std::string& path)
+{
+    std::vector<metadata::Event> events;
+    std::ifstream f(path);
+    while(f >> std::ws && f.peek() != EOF)
+    {
+        nlohmann::json j;
+        try
+        {
+            f >> j;
+        }
+        catch(const std::exception& e)
+        {
+            fprintf(stderr, "%s: %s\n", path.c_str(), e.what());
+            break;
+        }
+        metadata::Event event;
+        if(google::protobuf::util::JsonStringToMessage(j.dump(), &event).ok())
+        {
+            events.push_back(std::move(event));
+        }
+    }
+    return events;
+}
+
+// Payloads of the async events, as `K8sMetaClient` encodes them
+inline std::vector<std::string>
+encode_events(const std::vector<metadata::Event>& events, bool proto)
+{
+    std::vector<std::string> payloads;
+    payloads.reserve(events.size());
+    for(const auto& event : events)
+    {
+        std::string payload;
+        if(proto)
+        {
+            event.SerializeToString(&payload);
+        }
+        else
+        {
+            google::protobuf::util::MessageToJsonString(event, &payload);
+            // The JSON payload is sent with its terminator
+            payload.push_back('\0');
+        }
+        payloads.push_back(std::move(payload));
+    }
+    return payloads;
+}
+
+inline const char* const kind_names[K8S_RESOURCE_MAX] = {
+        "Pod",        "Namespace",             "Deployment", "Service",
+        "ReplicaSet", "ReplicationController", "DaemonSet"};
+
+// A plugin watching every kind of resource, without the framework tables:
+// only the parsing and the extraction are driven.
+inline std::unique_ptr<my_plugin> make_plugin()
+{
+    auto p = std::make_unique<my_plugin>();
+    nlohmann::json config;
+    config["collectorHostname"] = "localhost";
+    config["collectorPort"] = 45000;
+    config["nodeName"] = "node-0";
+    config["verbosity"] = "warning";
+    for(const auto* kind : kind_names)
+    {
+        config["resourceKinds"].push_back(kind);
+    }
+    p->parse_init_config(config);
+    return p;
+}
+
+inline bool ingest(my_plugin& p, const std::string& payload, bool proto)
+{
+    return proto ? p.parse_proto_event(payload.data(), payload.size())
+                 : p.parse_json_event(payload.data(), payload.size());
+}
+
+// Resident memory of the process, in bytes
+inline size_t resident_bytes()
+{
+    size_t pages = 0, resident = 0;
+    std::ifstream f("/proc/self/statm");
+    f >> pages >> resident;
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
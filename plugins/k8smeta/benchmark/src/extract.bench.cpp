@@ -0,0 +1,107 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "corpus.h"
+
+#include <benchmark/benchmark.h>
+
+#define BENCH_N_PODS 1000
+
+// Extraction request of `field_id`, the `label[<key>]` fields ask for the
+// label set on every resource
+struct bench_request
+{
+    explicit bench_request(uint64_t field_id)
+    {
+        field.field_id = (uint32_t)field_id;
+        field.arg_key = CORPUS_LABEL_KEY;
+        field.arg_present = true;
+        req.set_request(&field);
+    }
+
+    falcosecurity::_internal::ss_plugin_extract_field field = {};
+    falcosecurity::extract_request req;
+};
+
+static std::unique_ptr<my_plugin> make_cluster_plugin()
+{
+    auto p = make_plugin();
+    for(const auto& payload : encode_events(make_cluster(BENCH_N_PODS), true))
+    {
+        ingest(*p, payload, true);
+    }
+    return p;
+}
+
+static std::vector<const pod_slot*> cluster_pods(my_plugin& p)
+{
+    std::vector<const pod_slot*> pods;
+    for(const auto& event : make_cluster(BENCH_N_PODS))
+    {
+        if(event.kind() == "Pod")
+        {
+            pods.push_back(p.find_pod(p.get_pod_index(event.uid())));
+        }
+    }
+    return pods;
+}
+
+// Args: field id. Each iteration is the first k8s field of a new event: the
+// resources referenced by the pod are resolved again.
+static void BM_extract_field(benchmark::State& state)
+{
+    auto p = make_cluster_plugin();
+    auto pods = cluster_pods(*p);
+    bench_request r((uint64_t)state.range(0));
+    uint64_t evt_num = 0;
+    uint64_t found = 0;
+    for(auto _ : state)
+    {
+        evt_num++;
+        p->set_extract_pod(evt_num, pods[evt_num % pods.size()]);
+        found += p->extract_pod_field(r.req);
+    }
+    state.SetLabel(p->get_fields()[state.range(0)].name);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["found"] =
+            (double)found / (double)std::max<int64_t>(state.iterations(), 1);
+}
+BENCHMARK(BM_extract_field)->DenseRange(0, my_plugin::K8S_FIELD_MAX - 1);
+
+// Every k8s field of a same event, as an output listing all of them does
+static void BM_extract_event(benchmark::State& state)
+{
+    auto p = make_cluster_plugin();
+    auto pods = cluster_pods(*p);
+    std::vector<std::unique_ptr<bench_request>> requests;
+    for(uint64_t f = 0; f < my_plugin::K8S_FIELD_MAX; f++)
+    {
+        requests.push_back(std::make_unique<bench_request>(f));
+    }
+    uint64_t evt_num = 0;
+    for(auto _ : state)
+    {
+        evt_num++;
+        p->set_extract_pod(evt_num, pods[evt_num % pods.size()]);
+        for(auto& r : requests)
+        {
+            benchmark::DoNotOptimize(p->extract_pod_field(r->req));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_extract_event);
@@ -0,0 +1,141 @@
+/*
+Copyright (C) 2023 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "corpus.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+
+// Number of pods of the cluster
+static void cluster_size_args(benchmark::internal::Benchmark* b)
+{
+    for(int64_t n : {100, 1000, 10000})
+    {
+        b->Arg(n);
+    }
+}
+
+// Each iteration parses one collector event. The first pass over the
+// cluster creates the resources, the following ones update them with the
+// same content, as a resync after a reconnection does.
+static void run_ingest(benchmark::State& state,
+                       const std::vector<std::string>& payloads, bool proto)
+{
+    auto p = make_plugin();
+    size_t i = 0;
+    int64_t bytes = 0;
+    for(auto _ : state)
+    {
+        const auto& payload = payloads[i];
+        benchmark::DoNotOptimize(ingest(*p, payload, proto));
+        bytes += (int64_t)payload.size();
+        i = (i + 1) % payloads.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(bytes);
+}
+
+static void BM_ingest_json(benchmark::State& state)
+{
+    auto payloads = encode_events(make_cluster((size_t)state.range(0)), false);
+    run_ingest(state, payloads, false);
+}
+BENCHMARK(BM_ingest_json)->Apply(cluster_size_args);
+
+static void BM_ingest_proto(benchmark::State& state)
+{
+    auto payloads = encode_events(make_cluster((size_t)state.range(0)), true);
+    run_ingest(state, payloads, true);
+}
+BENCHMARK(BM_ingest_proto)->Apply(cluster_size_args);
+
+// Memory of the state tables once the whole cluster is stored: as the
+// plugin accounts it, per resource of each kind, and as the resident memory
+// of the process grows, per resource of any kind.
+static void BM_cluster_memory(benchmark::State& state)
+{
+    auto payloads = encode_events(make_cluster((size_t)state.range(0)), true);
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        auto rss = resident_bytes();
+        state.ResumeTiming();
+
+        auto p = make_plugin();
+        for(const auto& payload : payloads)
+        {
+            ingest(*p, payload, true);
+        }
+
+        state.PauseTiming();
+        size_t n_resources = 0;
+        for(int r = 0; r < K8S_RESOURCE_MAX; r++)
+        {
+            auto kind = (enum K8sResource)r;
+            auto n = p->get_table_size(kind);
+            n_resources += n;
+            if(n > 0)
+            {
+                state.counters[std::string("bytes_per_") + kind_names[r]] =
+                        (double)p->get_table_memory(kind) / (double)n;
+            }
+        }
+        state.counters["rss_bytes_per_resource"] =
+                (double)(resident_bytes() - std::min(rss, resident_bytes())) /
+                (double)std::max<size_t>(n_resources, 1);
+        p.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)payloads.size());
+}
+// The resident memory only grows on the first run, freed pages are reused
+BENCHMARK(BM_cluster_memory)->Apply(cluster_size_args)->Iterations(1);
+
+/*
+ * Replay of a recorded collector stream, set by the K8SMETA_BENCH_REPLAY
+ * environment variable, see `load_recorded_events`. The events are replayed
+ * in both encodings, whatever the encoding of the recording.
+ */
+
+static void BM_replay(benchmark::State& state,
+                      const std::vector<std::string>* payloads, bool proto)
+{
+    run_ingest(state, *payloads, proto);
+}
+
+static bool register_replay()
+{
+    const char* path = std::getenv("K8SMETA_BENCH_REPLAY");
+    if(path == nullptr)
+    {
+        return false;
+    }
+    auto events = load_recorded_events(path);
+    if(events.empty())
+    {
+        fprintf(stderr, "no events to replay in '%s'\n", path);
+        return false;
+    }
+    // Alive until the end of the process, as the benchmarks
+    static const auto json = encode_events(events, false);
+    static const auto proto = encode_events(events, true);
+    benchmark::RegisterBenchmark("BM_replay_json", BM_replay, &json, false);
+    benchmark::RegisterBenchmark("BM_replay_proto", BM_replay, &proto, true);
+    return true;
+}
+static const bool s_replay_registered = register_replay();
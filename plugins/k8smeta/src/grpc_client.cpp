@@ -31,27 +31,140 @@ using grpc::Status;
 using metadata::Event;
 using metadata::Selector;
 
+bool decode_queue::push(metadata::Event& evt)
+{
+    std::unique_lock<std::mutex> l(m_mu);
+    auto it = m_queued.find(evt.uid());
+    bool update = evt.reason().compare(REASON_UPDATE) == 0;
+    if(it != m_queued.end() && (update || !it->second->delayed))
+    {
+        // The queued event keeps its readiness
+        it->second->evt.Swap(&evt);
+        m_coalesced++;
+    }
+    else
+    {
+        auto now = clock::now();
+        if(it != m_queued.end())
+        {
+            // A creation or a deletion replacing a waiting update doesn't
+            // wait either, the update is left behind for `pop` to skip
+            it->second->moved = true;
+            it->second->evt.Clear();
+            m_queued.erase(it);
+            m_coalesced++;
+        }
+        if(m_update_window.count() > 0 && update)
+        {
+            m_delayed.push_back({{}, now + m_update_window, true});
+            m_delayed.back().evt.Swap(&evt);
+            m_queued.emplace(m_delayed.back().evt.uid(), &m_delayed.back());
+        }
+        else
+        {
+            m_ready.push_back({{}, now});
+            m_ready.back().evt.Swap(&evt);
+            m_queued.emplace(m_ready.back().evt.uid(), &m_ready.back());
+        }
+        m_cv.notify_one();
+    }
+    if(m_ready.size() + m_delayed.size() >= DECODE_QUEUE_MAX_SIZE)
+    {
+        m_paused = true;
+        return false;
+    }
+    return true;
+}
+
+bool decode_queue::pop(metadata::Event& evt, bool& resume)
+{
+    std::unique_lock<std::mutex> l(m_mu);
+    std::deque<queued_event>* from = nullptr;
+    while(from == nullptr)
+    {
+        while(!m_delayed.empty() && m_delayed.front().moved)
+        {
+            m_delayed.pop_front();
+        }
+        // The updates whose window elapsed go first, they waited the
+        // longest. Once closed, the waiting updates are flushed.
+        if(!m_delayed.empty() &&
+           (m_closed || m_delayed.front().ready <= clock::now()))
+        {
+            from = &m_delayed;
+        }
+        else if(!m_ready.empty())
+        {
+            from = &m_ready;
+        }
+        else if(m_closed)
+        {
+            return false;
+        }
+        else if(!m_delayed.empty())
+        {
+            m_cv.wait_until(l, m_delayed.front().ready);
+        }
+        else
+        {
+            m_cv.wait(l);
+        }
+    }
+    evt.Swap(&from->front().evt);
+    m_queued.erase(evt.uid());
+    from->pop_front();
+    // Half the queue is freed before reading again
+    resume = m_paused &&
+             m_ready.size() + m_delayed.size() <= DECODE_QUEUE_MAX_SIZE / 2;
+    if(resume)
+    {
+        m_paused = false;
+    }
+    return true;
+}
+
+void decode_queue::close()
+{
+    std::unique_lock<std::mutex> l(m_mu);
+    m_closed = true;
+    m_cv.notify_all();
+}
+
 K8sMetaClient::K8sMetaClient(const std::string& node_name,
                              const std::string& ip_port,
-                             const std::string& ca_PEM_encoding, std::mutex& mu,
+                             const std::string& ca_PEM_encoding,
+                             const std::vector<std::string>& resource_kinds,
+                             bool protobuf_events, size_t decode_workers,
+                             uint64_t update_window_ms, std::mutex& mu,
                              std::condition_variable& cv,
                              std::atomic<bool>& thread_quit,
-                             falcosecurity::async_event_handler& handler):
-        m_status_code(grpc::StatusCode::DO_NOT_USE),
+                             falcosecurity::async_event_handler& handler,
+                             resource_versions& versions):
+        m_protobuf_events(protobuf_events),
+        m_status_code(grpc::StatusCode::DO_NOT_USE), m_closing(false),
+        m_hold_released(false),
         m_cv(cv), m_mu(mu), m_async_thread_quit(thread_quit),
-        m_handler(handler), m_correctly_reading(0)
+        m_handler(handler), m_versions(versions), m_unchanged(0),
+        m_correctly_reading(0)
 {
+    for(size_t i = 0; i < std::max<size_t>(decode_workers, 1); i++)
+    {
+        m_workers.push_back(std::make_unique<decode_worker>(
+                std::chrono::milliseconds(update_window_ms)));
+        auto& queue = m_workers.back()->queue;
+        m_workers.back()->thread =
+                std::thread([this, &queue] { DecodeLoop(queue); });
+    }
+
     metadata::Selector sel;
     sel.set_nodename(node_name);
     sel.clear_resourcekinds();
 
-    /// todo!: one day we could expose them to the user.
-    (*sel.mutable_resourcekinds())["Pod"] = "true";
-    (*sel.mutable_resourcekinds())["Namespace"] = "true";
-    (*sel.mutable_resourcekinds())["Deployment"] = "true";
-    (*sel.mutable_resourcekinds())["Service"] = "true";
-    (*sel.mutable_resourcekinds())["ReplicaSet"] = "true";
-    (*sel.mutable_resourcekinds())["ReplicaController"] = "true";
+    // Kinds chosen by the `resourceKinds` config
+    for(const auto& kind : resource_kinds)
+    {
+        (*sel.mutable_resourcekinds())[kind] = "true";
+    }
 
     if(!ca_PEM_encoding.empty())
     {
@@ -67,10 +180,41 @@ K8sMetaClient::K8sMetaClient(const std::string& node_name,
     }
 
     m_stub->async()->Watch(&m_context, &sel, this);
+    // The workers may read again while the call has no read in flight, the
+    // hold keeps it alive until the reads end
+    AddHold();
     StartRead(&m_event);
     StartCall();
 }
 
+void K8sMetaClient::ReleaseHold()
+{
+    if(!m_hold_released.exchange(true))
+    {
+        RemoveHold();
+    }
+}
+
+K8sMetaClient::~K8sMetaClient()
+{
+    // The queued events are still forwarded: they are already known by
+    // `m_versions`, the next client wouldn't forward them again.
+    m_closing = true;
+    for(auto& w : m_workers)
+    {
+        w->queue.close();
+    }
+    for(auto& w : m_workers)
+    {
+        if(w->thread.joinable())
+        {
+            w->thread.join();
+        }
+    }
+    m_context.TryCancel();
+    ReleaseHold();
+}
+
 void K8sMetaClient::NotifyEnd(grpc::StatusCode c)
 {
     std::unique_lock<std::mutex> l(m_mu);
@@ -78,22 +222,63 @@ void K8sMetaClient::NotifyEnd(grpc::StatusCode c)
     m_cv.notify_one();
 }
 
+static inline uint64_t digest_combine(uint64_t seed, uint64_t h)
+{
+    return seed ^ (h + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+// Digest of what the plugin parses from an event: the spec is not used. The
+// refs are a map and their lists have no meaningful order, so they are
+// digested regardless of the order.
+static uint64_t event_digest(const metadata::Event& evt)
+{
+    std::hash<std::string> h;
+    uint64_t digest = digest_combine(h(evt.kind()), h(evt.meta()));
+    digest = digest_combine(digest, h(evt.status()));
+    uint64_t refs_digest = 0;
+    for(const auto& [kind, uids] : evt.refs().resources())
+    {
+        uint64_t uids_digest = 0;
+        for(const auto& uid : uids.list())
+        {
+            uids_digest += h(uid);
+        }
+        refs_digest += digest_combine(h(kind), uids_digest);
+    }
+    return digest_combine(digest, refs_digest);
+}
+
+// Return false if the resource was already forwarded with this content.
+bool K8sMetaClient::IsNewVersion()
+{
+    const auto& uid = m_event.uid();
+    if(m_event.reason().compare(REASON_DELETE) == 0)
+    {
+        m_versions.erase(uid);
+        return true;
+    }
+
+    auto digest = event_digest(m_event);
+    auto it = m_versions.find(uid);
+    if(it != m_versions.end() && it->second == digest)
+    {
+        m_unchanged++;
+        return false;
+    }
+    m_versions[uid] = digest;
+    return true;
+}
+
 void K8sMetaClient::OnReadDone(bool ok)
 {
     if(!ok)
     {
         // In case of failure we will call `OnDone` method
+        ReleaseHold();
         return;
     }
-
-    // Copy the JSON event into the string.
-    std::string json_string;
-    google::protobuf::util::JsonPrintOptions options;
-    auto status = MessageToJsonString(m_event, &json_string, options);
-    if(!status.ok())
+    if(m_closing)
     {
-        SPDLOG_ERROR("cannot convert message to json: {}", status.ToString());
-        NotifyEnd(grpc::StatusCode::DATA_LOSS);
         return;
     }
 
@@ -105,12 +290,84 @@ void K8sMetaClient::OnReadDone(bool ok)
                     "k8s-metacollector");
     }
 
-    m_enc.set_name(ASYNC_EVENT_NAME);
-    m_enc.set_data((void*)json_string.c_str(), json_string.size() + 1);
-    m_enc.encode(m_handler.writer());
-    m_handler.push();
-    StartRead(&m_event);
+    if(!IsNewVersion())
+    {
+        StartRead(&m_event);
+        return;
+    }
+
+    // If the queue is full the worker reads again once it makes room
+    auto& queue = m_workers[std::hash<std::string>{}(m_event.uid()) %
+                            m_workers.size()]
+                          ->queue;
+    if(queue.push(m_event))
+    {
+        StartRead(&m_event);
+    }
+}
+
+bool K8sMetaClient::Encode(metadata::Event& evt, std::string& payload)
+{
+    payload.clear();
+    if(m_protobuf_events)
+    {
+        // The message goes as it is, the plugin decodes it in the parsing
+        // phase.
+        if(!evt.SerializeToString(&payload))
+        {
+            SPDLOG_ERROR("cannot serialize the message");
+            return false;
+        }
+        return true;
+    }
+
+    // Copy the JSON event into the string.
+    google::protobuf::util::JsonPrintOptions options;
+    auto status = MessageToJsonString(evt, &payload, options);
+    if(!status.ok())
+    {
+        SPDLOG_ERROR("cannot convert message to json: {}", status.ToString());
+        return false;
+    }
+    return true;
+}
+
+void K8sMetaClient::DecodeLoop(decode_queue& queue)
+{
+    metadata::Event evt;
+    std::string payload;
+    falcosecurity::events::asyncevent_e_encoder enc;
+    bool resume = false;
+    while(queue.pop(evt, resume))
+    {
+        if(resume && !m_closing)
+        {
+            StartRead(&m_event);
+        }
+
+        if(!Encode(evt, payload))
+        {
+            NotifyEnd(grpc::StatusCode::DATA_LOSS);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> l(m_handler_mu);
+        if(m_protobuf_events)
+        {
+            enc.set_name(ASYNC_EVENT_NAME_PROTO);
+            enc.set_data((void*)payload.data(), payload.size());
+        }
+        else
+        {
+            // The JSON payload is sent with its terminator
+            enc.set_name(ASYNC_EVENT_NAME);
+            enc.set_data((void*)payload.c_str(), payload.size() + 1);
+        }
+        enc.encode(m_handler.writer());
+        m_handler.push();
+    }
 }
+
 // Some errors reported by Falco in failure conditions:
 // 1. When the server exposes a TLS certificate but the client doesn't:
 // ```
@@ -158,6 +415,24 @@ void K8sMetaClient::OnReadDone(bool ok)
 //
 void K8sMetaClient::OnDone(const grpc::Status& s)
 {
+    if(m_unchanged > 0)
+    {
+        SPDLOG_INFO("{} resources were received again without changes and "
+                    "were not forwarded",
+                    m_unchanged);
+    }
+    uint64_t coalesced = 0;
+    for(const auto& w : m_workers)
+    {
+        coalesced += w->queue.get_coalesced();
+    }
+    if(coalesced > 0)
+    {
+        SPDLOG_INFO("{} updates were replaced by a later one before being "
+                    "forwarded",
+                    coalesced);
+    }
+
     switch(s.error_code())
     {
     case grpc::StatusCode::OK:
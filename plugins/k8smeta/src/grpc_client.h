@@ -17,24 +17,101 @@ limitations under the License.
 
 #pragma once
 
+#include <chrono>
 #include <condition_variable>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include <grpcpp/grpcpp.h>
 #include <falcosecurity/sdk.h>
 #include "metadata.grpc.pb.h"
 
 #define MIN_BACKOFF_VALUE 1   // 1 Seconds
 #define MAX_BACKOFF_VALUE 120 // 2 Minutes
+// Events waiting for each decode worker before the reads stop
+#define DECODE_QUEUE_MAX_SIZE 1024
+
+// Digest of the last forwarded content of each resource, by uid. It outlives
+// the clients: on every new `Watch` the collector sends all the resources of
+// the node again, the ones that didn't change are not forwarded twice.
+using resource_versions = std::unordered_map<std::string, uint64_t>;
+
+// Collector events waiting for a decode worker, in order. A resource updated
+// again while it is still queued is replaced in place: when the worker falls
+// behind, as during a rollout, only the latest content of each resource is
+// decoded and forwarded.
+// With an update window, updates wait for the window to elapse before being
+// decoded, and the following updates of the resource are merged into them:
+// at most one update of a resource is forwarded per window. Creations and
+// deletions don't wait, not even when they replace a waiting update.
+class decode_queue
+{
+    public:
+    explicit decode_queue(std::chrono::milliseconds update_window):
+            m_update_window(update_window)
+    {
+    }
+
+    // Takes the content of `evt`. Return false if the queue is full: the
+    // reader stops until `pop` makes room again.
+    bool push(metadata::Event& evt);
+    // Wait for an event, return false once closed and drained. `resume` is
+    // set when the reader stopped and can read again.
+    bool pop(metadata::Event& evt, bool& resume);
+    void close();
+
+    uint64_t get_coalesced()
+    {
+        std::unique_lock<std::mutex> l(m_mu);
+        return m_coalesced;
+    }
+
+    private:
+    using clock = std::chrono::steady_clock;
+
+    struct queued_event
+    {
+        metadata::Event evt;
+        // When the event can be decoded
+        clock::time_point ready;
+        // Whether the event waits in `m_delayed`
+        bool delayed = false;
+        // Left empty in `m_delayed` once the event was moved to `m_ready`
+        bool moved = false;
+    };
+
+    std::mutex m_mu;
+    std::condition_variable m_cv;
+    const std::chrono::milliseconds m_update_window;
+    // Events ready to be decoded, and updates waiting for their window. Both
+    // are sorted by readiness.
+    std::deque<queued_event> m_ready;
+    std::deque<queued_event> m_delayed;
+    // Queued events by uid, a deque keeps the references to its elements
+    // valid while pushing and popping at its ends
+    std::unordered_map<std::string, queued_event*> m_queued;
+    uint64_t m_coalesced = 0;
+    bool m_paused = false;
+    bool m_closed = false;
+};
 
 class K8sMetaClient : public grpc::ClientReadReactor<metadata::Event>
 {
     public:
     K8sMetaClient(const std::string& node_name, const std::string& ip_port,
-                  const std::string& ca_PEM_encoding, std::mutex& mu,
-                  std::condition_variable& cv, std::atomic<bool>& thread_quit,
-                  falcosecurity::async_event_handler& handler);
-    ~K8sMetaClient() { m_context.TryCancel(); }
+                  const std::string& ca_PEM_encoding,
+                  const std::vector<std::string>& resource_kinds,
+                  bool protobuf_events, size_t decode_workers,
+                  uint64_t update_window_ms, std::mutex& mu,
+                  std::condition_variable& cv,
+                  std::atomic<bool>& thread_quit,
+                  falcosecurity::async_event_handler& handler,
+                  resource_versions& versions);
+    ~K8sMetaClient();
 
     bool Await(uint64_t& backoff_seconds);
 
@@ -42,18 +119,46 @@ class K8sMetaClient : public grpc::ClientReadReactor<metadata::Event>
     void OnReadDone(bool ok) override;
     void OnDone(const grpc::Status& s) override;
     void NotifyEnd(grpc::StatusCode c);
+    bool IsNewVersion();
+    void DecodeLoop(decode_queue& queue);
+    bool Encode(metadata::Event& evt, std::string& payload);
+    void ReleaseHold();
 
     std::unique_ptr<metadata::Metadata::Stub> m_stub;
     grpc::ClientContext m_context;
     metadata::Event m_event;
-    falcosecurity::events::asyncevent_e_encoder m_enc;
+    // Whether the events are forwarded as protobuf messages instead of JSON
+    bool m_protobuf_events;
     grpc::StatusCode m_status_code;
 
+    // Events are encoded out of the gRPC callbacks, by workers. The events of
+    // a resource always go to the same worker, so they stay in order.
+    struct decode_worker
+    {
+        explicit decode_worker(std::chrono::milliseconds update_window):
+                queue(update_window)
+        {
+        }
+
+        decode_queue queue;
+        std::thread thread;
+    };
+    std::vector<std::unique_ptr<decode_worker>> m_workers;
+    // The workers share the handler
+    std::mutex m_handler_mu;
+    // No more reads once the client is being destroyed
+    std::atomic<bool> m_closing;
+    std::atomic<bool> m_hold_released;
+
     // Shared with the thread that manages the async capability
     std::mutex& m_mu;
     std::condition_variable& m_cv;
     std::atomic<bool>& m_async_thread_quit;
     falcosecurity::async_event_handler& m_handler;
+    // Owned by the async thread, shared by its successive clients
+    resource_versions& m_versions;
+    // Resources received again without changes
+    uint64_t m_unchanged;
     // Use to print a log message when we can connect at least one time with the
     // metacollector.
     uint64_t m_correctly_reading;
@@ -29,58 +29,36 @@ limitations under the License.
 #include <fstream>
 #include <filesystem>
 
-#define ADD_MODIFY_TABLE_ENTRY(_resource_name, _resource_table)                \
-    if(resource_kind.compare(_resource_name) == 0)                             \
-    {                                                                          \
-        _resource_table[resource_uid] = res_layout;                            \
-        /* In debug mode we just print which resource has been added/updated   \
-         */                                                                    \
-        SPDLOG_DEBUG("added/modified {} {}", _resource_name, resource_uid);    \
-        /* In trace mode we print also the content of the resource */          \
-        SPDLOG_TRACE("resource content {}", res_layout.print_resource());      \
-        return;                                                                \
-    }
-
-#define DELETE_TABLE_ENTRY(_resource_name, _resource_table)                    \
-    if(resource_kind.compare(_resource_name) == 0)                             \
-    {                                                                          \
-        _resource_table.erase(resource_uid);                                   \
-        SPDLOG_DEBUG("deleted {} {}", _resource_name, resource_uid);           \
-        return;                                                                \
-    }
-
-// This is the regex needed to extract the pod_uid from the cgroup
-static re2::RE2 pattern(RGX_POD, re2::RE2::POSIX);
-
-static inline std::string
-get_pod_uid_from_cgroup_string(const std::string& cgroup)
+// Kinds of the resources as named by the collector, indexed by `K8sResource`
+static const char* const RESOURCE_KIND_NAMES[K8S_RESOURCE_MAX] = {
+        "Pod",        "Namespace",             "Deployment", "Service",
+        "ReplicaSet", "ReplicationController", "DaemonSet"};
+
+static inline enum K8sResource
+get_resource_from_kind(const std::string& resource_kind)
 {
-    // We set the pod uid to `""` if we are not able to extract it.
-    std::string pod_uid;
-
-    // Here `cgroup_first_line` has the following layout:
-    // `hierarchyID:controller:cgroup_path`
-    // Example (cgroup v2):
-    // `0::/kubepods.slice/kubepods-besteffort.slice/kubepods-besteffort-pod93f64796_43b9_468d_b77b_c652c985d5e0.slice`
-    // Example (cgroup v1):
-    // `12:perf_event:/kubepods.slice/kubepods-besteffort.slice/kubepods-besteffort-pod93f64796_43b9_468d_b77b_c652c985d5e0.slice`
-    if(re2::RE2::PartialMatch(cgroup, pattern, &pod_uid))
-    {
-        // Here `pod_uid` could have 2 possible layouts:
-        // - (driver cgroup) pod05869489-8c7f-45dc-9abd-1b1620787bb1
-        // - (driver systemd) pod05869489_8c7f_45dc_9abd_1b1620787bb1
-
-        // As a first thing we remove the "pod" prefix from `pod_uid`
-        pod_uid.erase(0, 3);
-
-        // Then we convert `_` into `-` if we are in `systemd` notation.
-        // The final `pod_uid` layout will be:
-        // 05869489-8c7f-45dc-9abd-1b1620787bb1
-        std::replace(pod_uid.begin(), pod_uid.end(), '_', '-');
-    }
-    return pod_uid;
+    for(int resource = 0; resource < K8S_RESOURCE_MAX; resource++)
+    {
+        if(resource_kind.compare(RESOURCE_KIND_NAMES[resource]) == 0)
+        {
+            return (enum K8sResource)resource;
+        }
+    }
+    return K8S_RESOURCE_MAX;
 }
 
+// Kinds as sent into the collector `Watch` selector, indexed by `K8sResource`
+static const char* const SELECTOR_KIND_NAMES[K8S_RESOURCE_MAX] = {
+        "Pod",        "Namespace",         "Deployment", "Service",
+        "ReplicaSet", "ReplicaController", "DaemonSet"};
+
+// Metrics names of the resources, indexed by `K8sResource`
+static const char* const RESOURCE_METRIC_NAMES[K8S_RESOURCE_MAX] = {
+        "pods",        "namespaces",
+        "deployments", "services",
+        "replicasets", "replicationcontrollers",
+        "daemonsets"};
+
 //////////////////////////
 // General plugin API
 //////////////////////////
@@ -131,6 +109,41 @@ falcosecurity::init_schema my_plugin::get_init_schema()
 			"title": "The path to the PEM encoding of the server root certificates",
 			"description": "The path to the PEM encoding of the server root certificates. E.g. '/etc/ssl/certs/ca-certificates.crt'"
 		},
+		"protobufEvents": {
+			"type": "boolean",
+			"title": "Forward the collector events as protobuf messages",
+			"description": "When enabled, the async events produced by the plugin carry the protobuf messages received from the collector instead of their JSON encoding. This saves two JSON conversions per event, but captures recorded this way can only be read by plugin versions supporting it. Default: false."
+		},
+		"resourceKinds": {
+			"type": "array",
+			"items": {
+				"enum": [
+					"Pod",
+					"Namespace",
+					"Deployment",
+					"Service",
+					"ReplicaSet",
+					"ReplicationController",
+					"DaemonSet"
+				]
+			},
+			"title": "The kinds of resources watched by the plugin",
+			"description": "The resources of the other kinds are neither asked to the collector nor stored, and their fields have no value. Pods are always watched. No field reads the DaemonSets. Default: all the kinds but DaemonSet."
+		},
+		"decodeWorkers": {
+			"type": "integer",
+			"minimum": 1,
+			"maximum": 16,
+			"title": "The number of threads encoding the collector events",
+			"description": "The collector events are encoded into async events out of the gRPC thread, by these workers. Updates of a resource waiting for a worker are replaced by the latest one. Default: 1."
+		},
+		"updateWindowMs": {
+			"type": "integer",
+			"minimum": 0,
+			"maximum": 60000,
+			"title": "The window in which the updates of a resource are merged, in milliseconds",
+			"description": "The updates of a resource, like pod status changes, are forwarded once the window elapses, along with the updates received meanwhile: at most one update per resource and window is injected into the event stream. Creations and deletions are not delayed. Default: 0, every update is forwarded as soon as possible."
+		},
 		"hostProc": {
 			"type": "string",
 			"title": "[DEPRECATED] Path to reach the '/proc' folder we want to scan.",
@@ -252,6 +265,58 @@ void my_plugin::parse_init_config(nlohmann::json& config_json)
         }
     }
 
+    // Protobuf events
+    m_protobuf_events = false;
+    if(config_json.contains(nlohmann::json::json_pointer(PROTOBUF_EVENTS_PATH)))
+    {
+        config_json.at(nlohmann::json::json_pointer(PROTOBUF_EVENTS_PATH))
+                .get_to(m_protobuf_events);
+    }
+
+    // Decode workers
+    m_decode_workers = 1;
+    if(config_json.contains(nlohmann::json::json_pointer(DECODE_WORKERS_PATH)))
+    {
+        config_json.at(nlohmann::json::json_pointer(DECODE_WORKERS_PATH))
+                .get_to(m_decode_workers);
+    }
+
+    // Update window
+    m_update_window_ms = 0;
+    if(config_json.contains(nlohmann::json::json_pointer(UPDATE_WINDOW_PATH)))
+    {
+        config_json.at(nlohmann::json::json_pointer(UPDATE_WINDOW_PATH))
+                .get_to(m_update_window_ms);
+    }
+
+    // Resource kinds
+    static const K8sResource default_kinds[] = {POD, NS, DEPLOYMENT,
+                                                SVC, RS, RC};
+    std::fill(std::begin(m_resource_kinds), std::end(m_resource_kinds), false);
+    if(config_json.contains(nlohmann::json::json_pointer(RESOURCE_KINDS_PATH)))
+    {
+        std::vector<std::string> kinds;
+        config_json.at(nlohmann::json::json_pointer(RESOURCE_KINDS_PATH))
+                .get_to(kinds);
+        for(const auto& kind : kinds)
+        {
+            auto resource = get_resource_from_kind(kind);
+            if(resource != K8S_RESOURCE_MAX)
+            {
+                m_resource_kinds[resource] = true;
+            }
+        }
+    }
+    else
+    {
+        for(auto resource : default_kinds)
+        {
+            m_resource_kinds[resource] = true;
+        }
+    }
+    // Processes are matched with their pod, the other kinds are optional
+    m_resource_kinds[POD] = true;
+
     // TODO: clean this up after deprecation period is over
     if(config_json.contains(nlohmann::json::json_pointer("/hostProc")))
     {
@@ -301,28 +366,149 @@ bool my_plugin::init(falcosecurity::init_input& in)
                 t.get_subtable_field(m_thread_table, m_thread_field_cgroups,
                                      "second", st::SS_PLUGIN_ST_STRING);
 
-        // Add the pod_uid field into thread table
-        m_pod_uid_field = m_thread_table.add_field(
-                t.fields(), POD_UID_FIELD_NAME, st::SS_PLUGIN_ST_STRING);
+        // get the 'ptid' field accessor from the thread table
+        m_ptid_field = m_thread_table.get_field(t.fields(), PTID_FIELD_NAME,
+                                                st::SS_PLUGIN_ST_INT64);
+
+        // Add the pod_index field into thread table
+        m_pod_index_field = m_thread_table.add_field(
+                t.fields(), POD_INDEX_FIELD_NAME, st::SS_PLUGIN_ST_UINT64);
     }
     catch(const std::exception& e)
     {
-        m_lasterr = "cannot add the '" + std::string(POD_UID_FIELD_NAME) +
+        m_lasterr = "cannot add the '" + std::string(POD_INDEX_FIELD_NAME) +
                     "' field into the '" + std::string(THREAD_TABLE_NAME) +
                     "' table: " + e.what();
         SPDLOG_CRITICAL(m_lasterr);
         return false;
     }
 
+    // Only there if the container plugin got initialized before this one
+    try
+    {
+        m_pod_uid_field = m_thread_table.get_field(
+                t.fields(), POD_UID_FIELD_NAME, st::SS_PLUGIN_ST_STRING);
+        m_has_pod_uid_field = true;
+        SPDLOG_INFO("pod uids are read from the '{}' field of the '{}' table",
+                    POD_UID_FIELD_NAME, THREAD_TABLE_NAME);
+    }
+    catch(const std::exception& e)
+    {
+        m_has_pod_uid_field = false;
+        SPDLOG_DEBUG("no '{}' field in the '{}' table, cgroups are scanned",
+                     POD_UID_FIELD_NAME, THREAD_TABLE_NAME);
+    }
+
+    // Initialize metrics, two for each kind of resource
+    m_metrics.clear();
+    for(int resource = 0; resource < K8S_RESOURCE_MAX; resource++)
+    {
+        std::string name = std::string("n_") + RESOURCE_METRIC_NAMES[resource];
+        m_metrics.emplace_back(name);
+        m_metrics.back().set_value((uint64_t)0);
+        m_metrics.emplace_back(name + "_memory_bytes");
+        m_metrics.back().set_value((uint64_t)0);
+    }
+    init_stats_metrics();
+    for(size_t i = m_stats_metrics_offset; i < m_metrics.size(); i++)
+    {
+        m_metrics[i].set_value((uint64_t)0);
+    }
+
     return true;
 }
 
+const std::vector<falcosecurity::metric>& my_plugin::get_metrics()
+{
+    for(int resource = 0; resource < K8S_RESOURCE_MAX; resource++)
+    {
+        auto kind = (enum K8sResource)resource;
+        m_metrics.at(2 * resource).set_value((uint64_t)get_table_size(kind));
+        m_metrics.at(2 * resource + 1)
+                .set_value((uint64_t)get_table_memory(kind));
+    }
+    update_stats_metrics();
+    return m_metrics;
+}
+
+// Keep this aligned with `update_stats_metrics`
+void my_plugin::init_stats_metrics()
+{
+    using mt = falcosecurity::metric_type;
+    m_stats_metrics_offset = m_metrics.size();
+    // The rate of events is left to the scraper, as for all the counters
+    m_metrics.emplace_back(METRIC_N_ASYNC_EVENTS,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_ASYNC_EVENT_PAYLOAD_BYTES,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    add_histogram_metrics(m_metrics, METRIC_PARSE_JSON_EVENT_LATENCY);
+    add_histogram_metrics(m_metrics, METRIC_PARSE_PROTO_EVENT_LATENCY);
+    add_histogram_metrics(m_metrics, METRIC_POD_ARRIVAL_LATENCY);
+    m_metrics.emplace_back(METRIC_N_POD_INDEX_CACHE_HITS,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_POD_INDEX_CACHE_MISSES,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_POD_UID_SHARED,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    // The pods currently known, with or without a record
+    m_metrics.emplace_back(METRIC_N_POD_SLOTS,
+                           mt::SS_PLUGIN_METRIC_TYPE_NON_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_POD_SLOTS_EVICTED,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    m_metrics.emplace_back(METRIC_N_COLLECTOR_RECONNECTS,
+                           mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    // The backoff of the next reconnection, not a counter
+    m_metrics.emplace_back(METRIC_COLLECTOR_BACKOFF_SECONDS,
+                           mt::SS_PLUGIN_METRIC_TYPE_NON_MONOTONIC);
+    auto fields = get_fields();
+    m_stats.extract_calls.assign(fields.size(), 0);
+    m_stats.extract_misses.assign(fields.size(), 0);
+    for(const char* prefix :
+        {METRIC_N_EXTRACT_PREFIX, METRIC_N_EXTRACT_MISSES_PREFIX})
+    {
+        for(const auto& f : fields)
+        {
+            std::string name = f.name;
+            std::replace(name.begin(), name.end(), '.', '_');
+            m_metrics.emplace_back(prefix + name,
+                                   mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+        }
+    }
+}
+
+void my_plugin::update_stats_metrics()
+{
+    auto idx = m_stats_metrics_offset;
+    m_metrics.at(idx++).set_value(m_stats.async_events);
+    m_metrics.at(idx++).set_value(m_stats.async_payload_bytes);
+    set_histogram_metrics(m_metrics, idx, m_stats.parse_json_event);
+    set_histogram_metrics(m_metrics, idx, m_stats.parse_proto_event);
+    set_histogram_metrics(m_metrics, idx, m_stats.pod_arrival);
+    m_metrics.at(idx++).set_value(m_stats.pod_index_cache_hits);
+    m_metrics.at(idx++).set_value(m_stats.pod_index_cache_misses);
+    m_metrics.at(idx++).set_value(m_stats.pod_uid_shared);
+    m_metrics.at(idx++).set_value((uint64_t)m_pods.size());
+    m_metrics.at(idx++).set_value(m_stats.pod_slots_evicted);
+    m_metrics.at(idx++).set_value(m_n_reconnects.load());
+    m_metrics.at(idx++).set_value(m_backoff_seconds.load());
+    for(auto n : m_stats.extract_calls)
+    {
+        m_metrics.at(idx++).set_value(n);
+    }
+    for(auto n : m_stats.extract_misses)
+    {
+        m_metrics.at(idx++).set_value(n);
+    }
+}
+
 //////////////////////////
 // Listen capability
 //////////////////////////
 
 bool my_plugin::capture_open(const falcosecurity::capture_listen_input& in)
 {
+    // Event numbers start again with the new capture
+    m_extract_memo.valid = false;
     SPDLOG_DEBUG("enriching initial thread table entries");
     auto& tr = in.get_table_reader();
     auto& tw = in.get_table_writer();
@@ -337,7 +523,7 @@ bool my_plugin::capture_open(const falcosecurity::capture_listen_input& in)
                 }
                 catch(const std::exception& e)
                 {
-                    SPDLOG_ERROR("cannot attach pod_uid to process: {}",
+                    SPDLOG_ERROR("cannot attach pod_index to process: {}",
                                  e.what());
                     // break the loop
                     return false;
@@ -393,16 +579,30 @@ void my_plugin::async_thread_loop(
     std::string ip_port = m_collector_hostname + ":" + m_collector_port;
     uint64_t backoff_seconds = MIN_BACKOFF_VALUE;
 
+    std::vector<std::string> resource_kinds;
+    for(int resource = 0; resource < K8S_RESOURCE_MAX; resource++)
+    {
+        if(m_resource_kinds[resource])
+        {
+            resource_kinds.push_back(SELECTOR_KIND_NAMES[resource]);
+        }
+    }
+
     while(!m_async_thread_quit.load())
     {
-        K8sMetaClient k8sclient(m_node_name, ip_port, m_ca_PEM_encoding, m_mu,
-                                m_cv, m_async_thread_quit, *h.get());
+        K8sMetaClient k8sclient(m_node_name, ip_port, m_ca_PEM_encoding,
+                                resource_kinds, m_protobuf_events,
+                                m_decode_workers, m_update_window_ms, m_mu,
+                                m_cv, m_async_thread_quit, *h.get(),
+                                m_resource_versions);
 
         if(!k8sclient.Await(backoff_seconds))
         {
             break;
         }
 
+        m_n_reconnects++;
+        m_backoff_seconds = backoff_seconds;
         SPDLOG_INFO("Retry after '{}' seconds", backoff_seconds);
         std::unique_lock<std::mutex> l(m_mu);
         m_cv.wait_for(l, std::chrono::seconds(backoff_seconds),
@@ -541,296 +741,203 @@ std::vector<falcosecurity::field_info> my_plugin::get_fields()
     return std::vector<falcosecurity::field_info>(fields, fields + fields_size);
 }
 
-bool inline my_plugin::get_uid_array(nlohmann::json& pod_refs_json,
-                                     enum K8sResource resource,
-                                     std::vector<std::string>& uid_array)
+inline const resource_record*
+my_plugin::get_resource(enum K8sResource resource,
+                        const std::string& resource_uid) const
 {
-    std::string json_path = "";
-    switch(resource)
+    if(resource >= K8S_RESOURCE_MAX)
     {
-    case NS:
-        json_path = "/resources/Namespace/list";
-        break;
-
-    case DEPLOYMENT:
-        json_path = "/resources/Deployment/list";
-        break;
-
-    case SVC:
-        json_path = "/resources/Service/list";
-        break;
-
-    case RS:
-        json_path = "/resources/ReplicaSet/list";
-        break;
-
-    case RC:
-        json_path = "/resources/ReplicationController/list";
-        break;
+        return nullptr;
+    }
 
-    default:
-        return false;
+    const auto& table = m_resource_tables[resource];
+    auto it = table.find(resource_uid);
+    if(it == table.end())
+    {
+        return nullptr;
     }
-    if(!pod_refs_json.contains(nlohmann::json::json_pointer(json_path)))
+    return &it->second;
+}
+
+inline const std::vector<std::string>*
+my_plugin::get_uid_array(const resource_record& pod, enum K8sResource resource)
+{
+    if(resource == POD || resource >= K8S_RESOURCE_MAX)
     {
-        return false;
+        return nullptr;
     }
-    pod_refs_json.at(nlohmann::json::json_pointer(json_path)).get_to(uid_array);
 
-    // If the `contains()` is successful we should always have at least one
-    // element, this is an extra check.
+    // The refs of a resource are never empty lists, this is an extra check.
+    const auto& uid_array = pod.refs[resource];
     if(uid_array.empty())
     {
-        return false;
+        return nullptr;
     }
-
-    return true;
+    return &uid_array;
 }
 
-bool inline my_plugin::get_layout(nlohmann::json& pod_refs_json,
-                                  enum K8sResource resource,
-                                  resource_layout& layout)
+// `pod` is the pod of the event being extracted, its refs are resolved once
+// per event.
+inline const std::vector<const resource_record*>&
+my_plugin::get_layouts(const resource_record& pod, enum K8sResource resource)
 {
-    std::vector<std::string> uid_array;
-    if(!get_uid_array(pod_refs_json, resource, uid_array))
+    static const std::vector<const resource_record*> no_layouts;
+    if(resource == POD || resource >= K8S_RESOURCE_MAX)
     {
-        return false;
+        return no_layouts;
     }
 
-    std::unordered_map<std::string, resource_layout> table;
-    switch(resource)
+    auto& memo = m_extract_memo;
+    auto& layouts = memo.refs[resource];
+    if(!memo.resolved[resource])
     {
-    case NS:
-        table = m_namespace_table;
-        break;
-
-    case DEPLOYMENT:
-        table = m_deployment_table;
-        break;
-
-    case SVC:
-        table = m_service_table;
-        break;
-
-    case RS:
-        table = m_replicaset_table;
-        break;
-
-    case RC:
-        table = m_replication_controller_table;
-        break;
-
-    default:
-        return false;
+        layouts.clear();
+        auto uid_array = get_uid_array(pod, resource);
+        if(uid_array != nullptr)
+        {
+            for(const auto& uid : *uid_array)
+            {
+                layouts.push_back(get_resource(resource, uid));
+            }
+        }
+        memo.resolved[resource] = true;
     }
+    return layouts;
+}
 
-    auto it = table.find(uid_array[0]);
-    if(it == table.end())
+inline const resource_record*
+my_plugin::get_layout(const resource_record& pod, enum K8sResource resource)
+{
+    const auto& layouts = get_layouts(pod, resource);
+    if(layouts.empty())
     {
-        return false;
+        return nullptr;
     }
-    layout = it->second;
-    return true;
+    return layouts[0];
 }
 
-bool inline my_plugin::extract_name_from_meta(
-        nlohmann::json& meta_json, falcosecurity::extract_request& req)
+bool inline my_plugin::extract_name(const resource_record& record,
+                                    falcosecurity::extract_request& req)
 {
-    std::string resource_name;
-    // todo!: Possible optimization here and in some other places, some paths
-    // should always be there.
-    if(!meta_json.contains(nlohmann::json::json_pointer(NAME_PATH)))
+    // A resource without a name is reported once, when it is parsed.
+    if(record.name.empty())
     {
-        SPDLOG_ERROR("The resource meta doesn't contain the '{}' field. "
-                     "Resource meta:\n{}\n",
-                     NAME_PATH, meta_json.dump());
         return false;
     }
-    meta_json.at(nlohmann::json::json_pointer(NAME_PATH)).get_to(resource_name);
-    req.set_value(resource_name, true);
+    req.set_value(record.name, true);
     return true;
 }
 
-bool inline my_plugin::extract_label_value_from_meta(
-        nlohmann::json& meta_json, falcosecurity::extract_request& req)
+bool inline my_plugin::extract_label_value(const resource_record& record,
+                                           falcosecurity::extract_request& req)
 {
     if(!req.is_arg_present())
     {
         return false;
     }
 
-    // We cannot concatenate "/labels/<label_key>" to extract the label value
-    // because `<label_key>` can contain `/` (`app.kubernetes.io/component`), so
-    // no json paths! We fetch the whole map and then we iterate over it.
-    std::unordered_map<std::string, std::string> labels_map;
-    if(!meta_json.contains(nlohmann::json::json_pointer(LABELS_PATH)))
-    {
-        // Please note that this is not an error, is possible that
-        // some resources don't have the `/labels` key.
-        return false;
-    }
-    meta_json.at(nlohmann::json::json_pointer(LABELS_PATH)).get_to(labels_map);
-
-    auto it = labels_map.find(req.get_arg_key());
-    if(it == labels_map.end())
+    auto label_value = record.find_label(req.get_arg_key());
+    if(label_value == nullptr)
     {
         return false;
     }
-    req.set_value(it->second, true);
+    req.set_value(*label_value, true);
     return true;
 }
 
-bool inline my_plugin::extract_labels_from_meta(
-        nlohmann::json& meta_json, falcosecurity::extract_request& req)
+bool inline my_plugin::extract_labels(const resource_record& record,
+                                      falcosecurity::extract_request& req)
 {
-    std::unordered_map<std::string, std::string> labels_map;
-    if(!meta_json.contains(nlohmann::json::json_pointer(LABELS_PATH)))
+    // Please note that this is not an error, is possible that
+    // some resources don't have labels.
+    if(record.labels_list.empty())
     {
-        // Please note that this is not an error, is possible that
-        // some resources don't have the `/labels` key.
         return false;
     }
-    meta_json.at(nlohmann::json::json_pointer(LABELS_PATH)).get_to(labels_map);
 
-    std::vector<std::string> labels;
-    for(const auto label : labels_map)
-    {
-        labels.emplace_back(label.first + ":" + label.second);
-    }
-
-    if(labels.empty())
-    {
-        return false;
-    }
-
-    req.set_value(labels.begin(), labels.end(), true);
+    req.set_value(record.labels_list.begin(), record.labels_list.end(), true);
     return true;
 }
 
 bool inline my_plugin::extract_uid_from_refs(
-        nlohmann::json& pod_refs_json, enum K8sResource resource,
+        const resource_record& pod, enum K8sResource resource,
         falcosecurity::extract_request& req)
 {
-    std::vector<std::string> uid_array;
-    if(!get_uid_array(pod_refs_json, resource, uid_array))
+    auto uid_array = get_uid_array(pod, resource);
+    if(uid_array == nullptr)
     {
         return false;
     }
 
     // We have at least one element otherwise the previous check should return
     // 0.
-    req.set_value(uid_array[0], true);
+    req.set_value((*uid_array)[0], true);
     return true;
 }
 
 bool inline my_plugin::extract_name_from_refs(
-        nlohmann::json& pod_refs_json, enum K8sResource resource,
+        const resource_record& pod, enum K8sResource resource,
         falcosecurity::extract_request& req)
 {
-    resource_layout rs_layout;
-    if(!get_layout(pod_refs_json, resource, rs_layout))
+    auto rs_layout = get_layout(pod, resource);
+    if(rs_layout == nullptr)
     {
         return false;
     }
-    return extract_name_from_meta(rs_layout.meta, req);
+    return extract_name(*rs_layout, req);
 }
 
 bool inline my_plugin::extract_label_value_from_refs(
-        nlohmann::json& pod_refs_json, enum K8sResource resource,
+        const resource_record& pod, enum K8sResource resource,
         falcosecurity::extract_request& req)
 {
-    resource_layout rs_layout;
-    if(!get_layout(pod_refs_json, resource, rs_layout))
+    auto rs_layout = get_layout(pod, resource);
+    if(rs_layout == nullptr)
     {
         return false;
     }
-    return extract_label_value_from_meta(rs_layout.meta, req);
+    return extract_label_value(*rs_layout, req);
 }
 
 bool inline my_plugin::extract_labels_from_refs(
-        nlohmann::json& pod_refs_json, enum K8sResource resource,
+        const resource_record& pod, enum K8sResource resource,
         falcosecurity::extract_request& req)
 {
-    resource_layout rs_layout;
-    if(!get_layout(pod_refs_json, resource, rs_layout))
+    auto rs_layout = get_layout(pod, resource);
+    if(rs_layout == nullptr)
     {
         return false;
     }
 
-    return extract_labels_from_meta(rs_layout.meta, req);
+    return extract_labels(*rs_layout, req);
 }
 
 bool inline my_plugin::extract_uid_array_from_refs(
-        nlohmann::json& pod_refs_json, enum K8sResource resource,
+        const resource_record& pod, enum K8sResource resource,
         falcosecurity::extract_request& req)
 {
-    std::vector<std::string> uid_array;
-    if(!get_uid_array(pod_refs_json, resource, uid_array))
+    auto uid_array = get_uid_array(pod, resource);
+    if(uid_array == nullptr)
     {
         return false;
     }
 
-    req.set_value(uid_array.begin(), uid_array.end(), true);
+    req.set_value(uid_array->begin(), uid_array->end(), true);
     return true;
 }
 
 bool inline my_plugin::extract_name_array_from_refs(
-        nlohmann::json& pod_refs_json, enum K8sResource resource,
+        const resource_record& pod, enum K8sResource resource,
         falcosecurity::extract_request& req)
 {
-    std::vector<std::string> uid_array;
-    if(!get_uid_array(pod_refs_json, resource, uid_array))
-    {
-        return false;
-    }
-
-    std::unordered_map<std::string, resource_layout> table;
-    switch(resource)
-    {
-    case NS:
-        table = m_namespace_table;
-        break;
-
-    case DEPLOYMENT:
-        table = m_deployment_table;
-        break;
-
-    case SVC:
-        table = m_service_table;
-        break;
-
-    case RS:
-        table = m_replicaset_table;
-        break;
-
-    case RC:
-        table = m_replication_controller_table;
-        break;
-
-    default:
-        return false;
-    }
-
     std::vector<std::string> name_array;
-    std::string name;
-    for(const auto& uid : uid_array)
+    for(auto rs_layout : get_layouts(pod, resource))
     {
-        auto it = table.find(uid);
-        if(it == table.end())
+        if(rs_layout == nullptr || rs_layout->name.empty())
         {
             continue;
         }
-
-        if(!it->second.meta.contains(nlohmann::json::json_pointer(NAME_PATH)))
-        {
-            SPDLOG_ERROR("The resource meta doesn't contain the '{}' field. "
-                         "Resource meta:\n{}\n",
-                         NAME_PATH, it->second.meta.dump());
-            return false;
-        }
-        it->second.meta.at(nlohmann::json::json_pointer(NAME_PATH))
-                .get_to(name);
-        name_array.push_back(name);
+        name_array.push_back(rs_layout->name);
     }
 
     if(name_array.empty())
@@ -843,7 +950,7 @@ bool inline my_plugin::extract_name_array_from_refs(
 }
 
 bool inline my_plugin::extract_label_value_array_from_refs(
-        nlohmann::json& pod_refs_json, enum K8sResource resource,
+        const resource_record& pod, enum K8sResource resource,
         falcosecurity::extract_request& req)
 {
     if(!req.is_arg_present())
@@ -851,65 +958,21 @@ bool inline my_plugin::extract_label_value_array_from_refs(
         return false;
     }
 
-    std::vector<std::string> uid_array;
-    if(!get_uid_array(pod_refs_json, resource, uid_array))
-    {
-        return false;
-    }
-
-    std::unordered_map<std::string, resource_layout> table;
-    switch(resource)
-    {
-    case NS:
-        table = m_namespace_table;
-        break;
-
-    case DEPLOYMENT:
-        table = m_deployment_table;
-        break;
-
-    case SVC:
-        table = m_service_table;
-        break;
-
-    case RS:
-        table = m_replicaset_table;
-        break;
-
-    case RC:
-        table = m_replication_controller_table;
-        break;
-
-    default:
-        return false;
-    }
-
     std::vector<std::string> label_value_array;
-    std::string label_value;
-    std::unordered_map<std::string, std::string> labels_map;
-    for(const auto& uid : uid_array)
+    for(auto rs_layout : get_layouts(pod, resource))
     {
-        auto layout_it = table.find(uid);
-        if(layout_it == table.end())
-        {
-            continue;
-        }
-
-        // If the resource doesn't have a `/labels` field skip it.
-        if(!layout_it->second.meta.contains(
-                   nlohmann::json::json_pointer(LABELS_PATH)))
+        if(rs_layout == nullptr)
         {
             continue;
         }
 
-        layout_it->second.meta.at(nlohmann::json::json_pointer(LABELS_PATH))
-                .get_to(labels_map);
-        auto it = labels_map.find(req.get_arg_key());
-        if(it == labels_map.end())
+        // If the resource doesn't have this label skip it.
+        auto label_value = rs_layout->find_label(req.get_arg_key());
+        if(label_value == nullptr)
         {
             continue;
         }
-        label_value_array.push_back(it->second);
+        label_value_array.push_back(*label_value);
     }
 
     if(label_value_array.empty())
@@ -922,65 +985,37 @@ bool inline my_plugin::extract_label_value_array_from_refs(
 }
 
 bool inline my_plugin::extract_labels_array_from_refs(
-        nlohmann::json& pod_refs_json, enum K8sResource resource,
+        const resource_record& pod, enum K8sResource resource,
         falcosecurity::extract_request& req)
 {
-    std::vector<std::string> uid_array;
-    if(!get_uid_array(pod_refs_json, resource, uid_array))
+    const auto& layouts = get_layouts(pod, resource);
+    if(layouts.empty())
     {
         return false;
     }
 
-    std::unordered_map<std::string, resource_layout> table;
-    switch(resource)
+    // Usually there is just one resource, its labels are already a list.
+    if(layouts.size() == 1)
     {
-    case NS:
-        table = m_namespace_table;
-        break;
-
-    case DEPLOYMENT:
-        table = m_deployment_table;
-        break;
-
-    case SVC:
-        table = m_service_table;
-        break;
-
-    case RS:
-        table = m_replicaset_table;
-        break;
-
-    case RC:
-        table = m_replication_controller_table;
-        break;
-
-    default:
-        return false;
+        if(layouts[0] == nullptr)
+        {
+            return false;
+        }
+        return extract_labels(*layouts[0], req);
     }
 
     std::vector<std::string> labels_array;
-    std::unordered_map<std::string, std::string> labels_map;
-    for(const auto& uid : uid_array)
+    for(auto rs_layout : layouts)
     {
-        auto layout_it = table.find(uid);
-        if(layout_it == table.end())
+        if(rs_layout == nullptr)
         {
             continue;
         }
 
-        // If the resource doesn't have a `/labels` field skip it.
-        if(!layout_it->second.meta.contains(
-                   nlohmann::json::json_pointer(LABELS_PATH)))
-        {
-            continue;
-        }
-
-        layout_it->second.meta.at(nlohmann::json::json_pointer(LABELS_PATH))
-                .get_to(labels_map);
-        for(const auto label : labels_map)
-        {
-            labels_array.emplace_back(label.first + ":" + label.second);
-        }
+        // If the resource doesn't have labels skip it.
+        const auto& labels_list = rs_layout->labels_list;
+        labels_array.insert(labels_array.end(), labels_list.begin(),
+                            labels_list.end());
     }
 
     if(labels_array.empty())
@@ -992,9 +1027,9 @@ bool inline my_plugin::extract_labels_array_from_refs(
     return true;
 }
 
-bool my_plugin::extract(const falcosecurity::extract_fields_input& in)
+inline const pod_slot*
+my_plugin::find_event_pod(const falcosecurity::extract_fields_input& in)
 {
-    auto& req = in.get_extract_request();
     auto& tr = in.get_table_reader();
 
     int64_t thread_id = in.get_event_reader().get_tid();
@@ -1004,132 +1039,157 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input& in)
         SPDLOG_INFO("unknown thread id for event num '{}' with type '{}'",
                     in.get_event_reader().get_num(),
                     int32_t(in.get_event_reader().get_type()));
-        return false;
+        return nullptr;
     }
 
     falcosecurity::table_entry thread_entry;
-    std::string pod_uid;
+    uint64_t pod_index = 0;
     try
     {
         // retrieve the thread entry associated with this thread id
         thread_entry = m_thread_table.get_entry(tr, thread_id);
-        // retrieve pod_uid from the entry
-        m_pod_uid_field.read_value(tr, thread_entry, pod_uid);
+        // retrieve pod_index from the entry
+        m_pod_index_field.read_value(tr, thread_entry, pod_index);
     }
     catch(const std::exception& e)
     {
         SPDLOG_ERROR("cannot extract the pod uid for the thread id '{}': {}",
                      thread_id, e.what());
-        return false;
+        return nullptr;
     }
 
     // The process is not into a pod, stop here.
-    if(pod_uid.empty())
+    if(pod_index == 0)
     {
-        SPDLOG_TRACE("no pod uid in the framework table for thread id '{}'",
+        SPDLOG_TRACE("no pod index in the framework table for thread id '{}'",
                      thread_id);
-        return false;
+        return nullptr;
     }
 
-    // Try to find the entry associated with the pod_uid
-    const auto it = m_pod_table.find(pod_uid);
-    if(it == m_pod_table.end())
+    return find_pod(pod_index);
+}
+
+const pod_slot* my_plugin::find_pod(uint64_t pod_index) const
+{
+    // Try to find the pod associated with the pod_index
+    auto pod = m_pods.find(pod_index);
+    if(pod == m_pods.end() || pod->second.record == nullptr)
+    {
+        SPDLOG_DEBUG("the plugin has no info for the pod index '{}'",
+                     pod_index);
+        return nullptr;
+    }
+    return &pod->second;
+}
+
+void my_plugin::set_extract_pod(uint64_t evt_num, const pod_slot* pod)
+{
+    auto& memo = m_extract_memo;
+    memo.valid = true;
+    memo.evt_num = evt_num;
+    std::fill(std::begin(memo.resolved), std::end(memo.resolved), false);
+    memo.pod = pod;
+}
+
+bool inline my_plugin::extract_field(
+        const falcosecurity::extract_fields_input& in)
+{
+    // Only the first field of an event looks the pod up
+    const auto& memo = m_extract_memo;
+    uint64_t evt_num = in.get_event_reader().get_num();
+    if(!memo.valid || memo.evt_num != evt_num)
+    {
+        set_extract_pod(evt_num, find_event_pod(in));
+    }
+    if(memo.pod == nullptr)
     {
-        SPDLOG_DEBUG("the plugin has no info for the pod uid '{}'", pod_uid);
         return false;
     }
+    return extract_pod_field(in.get_extract_request());
+}
 
-    auto pod_layout = it->second;
+bool my_plugin::extract_pod_field(falcosecurity::extract_request& req)
+{
+    const auto& memo = m_extract_memo;
+    const auto& pod_uid = memo.pod->uid;
+
+    // Records are not modified during the extraction, no need to copy them.
+    const auto& pod_layout = *memo.pod->record;
     switch(req.get_field_id())
     {
     case K8S_POD_NAME:
-        return extract_name_from_meta(pod_layout.meta, req);
+        return extract_name(pod_layout, req);
     case K8S_POD_UID:
         req.set_value(pod_uid, true);
         break;
     case K8S_POD_LABEL:
-        return extract_label_value_from_meta(pod_layout.meta, req);
+        return extract_label_value(pod_layout, req);
     case K8S_POD_LABELS:
-        return extract_labels_from_meta(pod_layout.meta, req);
+        return extract_labels(pod_layout, req);
     case K8S_POD_IP:
-    {
         // The pod ip is not always there, for example during pod
         // initialization we could receive an initial pod without the ip and
         // then in a second moment, we will receive an update on that pod.
-        if(!pod_layout.status.contains(
-                   nlohmann::json::json_pointer(POD_IP_PATH)))
+        if(pod_layout.pod_ip.empty())
         {
             return false;
         }
-        std::string pod_ip;
-        pod_layout.status.at(nlohmann::json::json_pointer(POD_IP_PATH))
-                .get_to(pod_ip);
-        req.set_value(pod_ip, true);
+        req.set_value(pod_layout.pod_ip, true);
         break;
-    }
     case K8S_NS_NAME:
-    {
-        if(!pod_layout.meta.contains(
-                   nlohmann::json::json_pointer(NAMESPACE_PATH)))
+        if(pod_layout.namespace_name.empty())
         {
-            SPDLOG_ERROR("The pod meta doesn't contain the '{}' field. "
-                         "Resource meta:\n{}\n",
-                         NAMESPACE_PATH, pod_layout.meta.dump());
             return false;
         }
-        std::string pod_namespace_name = "";
-        pod_layout.meta.at(nlohmann::json::json_pointer(NAMESPACE_PATH))
-                .get_to(pod_namespace_name);
-        req.set_value(pod_namespace_name, true);
+        req.set_value(pod_layout.namespace_name, true);
         break;
-    }
     case K8S_NS_UID:
-        return extract_uid_from_refs(pod_layout.refs, NS, req);
+        return extract_uid_from_refs(pod_layout, NS, req);
     case K8S_NS_LABEL:
-        return extract_label_value_from_refs(pod_layout.refs, NS, req);
+        return extract_label_value_from_refs(pod_layout, NS, req);
     case K8S_NS_LABELS:
-        return extract_labels_from_refs(pod_layout.refs, NS, req);
+        return extract_labels_from_refs(pod_layout, NS, req);
         // We cannot extract deployment fields directly from the pod name
         // because it's possible to move some pods from one deployment to
         // another under some circumstances.
     case K8S_DEPLOYMENT_NAME:
-        return extract_name_from_refs(pod_layout.refs, DEPLOYMENT, req);
+        return extract_name_from_refs(pod_layout, DEPLOYMENT, req);
     case K8S_DEPLOYMENT_UID:
-        return extract_uid_from_refs(pod_layout.refs, DEPLOYMENT, req);
+        return extract_uid_from_refs(pod_layout, DEPLOYMENT, req);
     case K8S_DEPLOYMENT_LABEL:
-        return extract_label_value_from_refs(pod_layout.refs, DEPLOYMENT, req);
+        return extract_label_value_from_refs(pod_layout, DEPLOYMENT, req);
     case K8S_DEPLOYMENT_LABELS:
-        return extract_labels_from_refs(pod_layout.refs, DEPLOYMENT, req);
+        return extract_labels_from_refs(pod_layout, DEPLOYMENT, req);
     case K8S_SVC_NAME:
-        return extract_name_array_from_refs(pod_layout.refs, SVC, req);
+        return extract_name_array_from_refs(pod_layout, SVC, req);
     case K8S_SVC_UID:
-        return extract_uid_array_from_refs(pod_layout.refs, SVC, req);
+        return extract_uid_array_from_refs(pod_layout, SVC, req);
     case K8S_SVC_LABEL:
-        return extract_label_value_array_from_refs(pod_layout.refs, SVC, req);
+        return extract_label_value_array_from_refs(pod_layout, SVC, req);
     case K8S_SVC_LABELS:
-        return extract_labels_array_from_refs(pod_layout.refs, SVC, req);
+        return extract_labels_array_from_refs(pod_layout, SVC, req);
         // We cannot extract replicaSet fields directly from the pod name
         // because it's possible to move some pods from one replicaSet to
         // another under some circumstances.
     case K8S_RS_NAME:
-        return extract_name_from_refs(pod_layout.refs, RS, req);
+        return extract_name_from_refs(pod_layout, RS, req);
     case K8S_RS_UID:
-        return extract_uid_from_refs(pod_layout.refs, RS, req);
+        return extract_uid_from_refs(pod_layout, RS, req);
     case K8S_RS_LABEL:
-        return extract_label_value_from_refs(pod_layout.refs, RS, req);
+        return extract_label_value_from_refs(pod_layout, RS, req);
     case K8S_RS_LABELS:
-        return extract_labels_from_refs(pod_layout.refs, RS, req);
+        return extract_labels_from_refs(pod_layout, RS, req);
         // We cannot extract replicationController fields directly from the pod
         // name because it's possible to move some pods from one
         // replicationController to another under some circumstances.
     case K8S_RC_NAME:
-        return extract_name_from_refs(pod_layout.refs, RC, req);
+        return extract_name_from_refs(pod_layout, RC, req);
     case K8S_RC_UID:
-        return extract_uid_from_refs(pod_layout.refs, RC, req);
+        return extract_uid_from_refs(pod_layout, RC, req);
     case K8S_RC_LABEL:
-        return extract_label_value_from_refs(pod_layout.refs, RC, req);
+        return extract_label_value_from_refs(pod_layout, RC, req);
     case K8S_RC_LABELS:
-        return extract_labels_from_refs(pod_layout.refs, RC, req);
+        return extract_labels_from_refs(pod_layout, RC, req);
 
     default:
         SPDLOG_ERROR(
@@ -1141,73 +1201,296 @@ bool my_plugin::extract(const falcosecurity::extract_fields_input& in)
     return true;
 }
 
+bool my_plugin::extract(const falcosecurity::extract_fields_input& in)
+{
+    auto field_id = in.get_extract_request().get_field_id();
+    bool found = extract_field(in);
+    if(field_id < m_stats.extract_calls.size())
+    {
+        m_stats.extract_calls[field_id]++;
+        m_stats.extract_misses[field_id] += !found;
+    }
+    return found;
+}
+
 //////////////////////////
 // Parse capability
 //////////////////////////
 
+void inline my_plugin::parse_resource_meta(const std::string& meta_string,
+                                           resource_record& record)
+{
+    auto meta_json = nlohmann::json::parse(meta_string);
+
+    if(meta_json.contains(nlohmann::json::json_pointer(NAME_PATH)))
+    {
+        meta_json.at(nlohmann::json::json_pointer(NAME_PATH))
+                .get_to(record.name);
+    }
+    else
+    {
+        SPDLOG_ERROR("The resource meta doesn't contain the '{}' field. "
+                     "Resource meta:\n{}\n",
+                     NAME_PATH, meta_json.dump());
+    }
+
+    if(meta_json.contains(nlohmann::json::json_pointer(NAMESPACE_PATH)))
+    {
+        meta_json.at(nlohmann::json::json_pointer(NAMESPACE_PATH))
+                .get_to(record.namespace_name);
+    }
+
+    // We cannot use "/labels/<label_key>" paths to look up a label
+    // because `<label_key>` can contain `/` (`app.kubernetes.io/component`)
+    // so we keep the whole map.
+    // Please note that is possible that some resources don't have the
+    // `/labels` key.
+    if(meta_json.contains(nlohmann::json::json_pointer(LABELS_PATH)))
+    {
+        // The `labels` fields keep the order in which they have always been
+        // listed, the lookups use a copy sorted by key.
+        std::unordered_map<std::string, std::string> labels_map;
+        meta_json.at(nlohmann::json::json_pointer(LABELS_PATH))
+                .get_to(labels_map);
+        record.labels_list.reserve(labels_map.size());
+        record.labels.reserve(labels_map.size());
+        for(auto& label : labels_map)
+        {
+            record.labels_list.emplace_back(label.first + ":" + label.second);
+            record.labels.emplace_back(label.first, std::move(label.second));
+        }
+        std::sort(record.labels.begin(), record.labels.end());
+    }
+}
+
+void inline my_plugin::parse_resource_status(const std::string& status_string,
+                                             resource_record& record)
+{
+    auto status_json = nlohmann::json::parse(status_string);
+
+    // The pod ip is not always there, for example during pod
+    // initialization.
+    if(status_json.contains(nlohmann::json::json_pointer(POD_IP_PATH)))
+    {
+        status_json.at(nlohmann::json::json_pointer(POD_IP_PATH))
+                .get_to(record.pod_ip);
+    }
+}
+
+// The node of an unordered map holds the key, the value, the next pointer and
+// the cached hash
+static inline size_t table_entry_memory(const resource_record& record)
+{
+    return record.memory_usage() + string_memory(record.uid) +
+           sizeof(std::string) + 2 * sizeof(void*);
+}
+
+void inline my_plugin::store_resource(enum K8sResource resource,
+                                      resource_record& record)
+{
+    // The record and its node in the table, whose key is the uid
+    auto& table = m_resource_tables[resource];
+    auto& entry = table[record.uid];
+    if(!entry.uid.empty())
+    {
+        m_tables_memory[resource] -= table_entry_memory(entry);
+    }
+    entry = std::move(record);
+    m_tables_memory[resource] += table_entry_memory(entry);
+    // Records are updated in place, the pod slot keeps pointing to them
+    if(resource == POD)
+    {
+        // A pod is not deleted for good if the collector sends it again
+        m_deleted_pod_uids.erase(entry.uid);
+        // The slot exists without a record if processes of the pod showed up
+        // first
+        bool known = m_pod_indexes.find(entry.uid) != m_pod_indexes.end();
+        auto& slot = m_pods[get_pod_index(entry.uid)];
+        if(known && slot.record == nullptr)
+        {
+            m_stats.pod_arrival.record(monotonic_ns() - slot.created_ns);
+        }
+        slot.record = &entry;
+    }
+    // In debug mode we just print which resource has been added/updated
+    SPDLOG_DEBUG("added/modified {} {}", entry.kind, entry.uid);
+    // In trace mode we print also the content of the resource
+    SPDLOG_TRACE("resource content {}", entry.print_resource());
+}
+
+inline enum K8sResource
+my_plugin::get_stored_resource(const std::string& resource_kind) const
+{
+    auto resource = get_resource_from_kind(resource_kind);
+    if(resource == K8S_RESOURCE_MAX || !m_resource_kinds[resource])
+    {
+        SPDLOG_DEBUG("ignoring unknown or unwatched resource kind {}",
+                     resource_kind);
+        return K8S_RESOURCE_MAX;
+    }
+    return resource;
+}
+
 void inline my_plugin::parse_added_modified_resource(nlohmann::json& json_event,
                                                      std::string& resource_uid,
                                                      std::string& resource_kind)
 {
-    // We craft the resource layout
-    resource_layout res_layout = {
-            .uid = resource_uid,
-            .kind = resource_kind,
-    };
+    auto resource = get_stored_resource(resource_kind);
+    if(resource == K8S_RESOURCE_MAX)
+    {
+        return;
+    }
+
+    // We craft the resource record, all the JSON work is done here once.
+    resource_record res_layout;
+    res_layout.uid = resource_uid;
+    res_layout.kind = resource_kind;
 
     if(json_event.contains(nlohmann::json::json_pointer(META_PATH)))
     {
         std::string meta_string;
         json_event.at(nlohmann::json::json_pointer(META_PATH))
                 .get_to(meta_string);
-        res_layout.meta = nlohmann::json::parse(meta_string);
-    }
-
-    if(json_event.contains(nlohmann::json::json_pointer(SPEC_PATH)))
-    {
-        std::string spec_string;
-        json_event.at(nlohmann::json::json_pointer(SPEC_PATH))
-                .get_to(spec_string);
-        res_layout.spec = nlohmann::json::parse(spec_string);
+        parse_resource_meta(meta_string, res_layout);
     }
 
-    if(json_event.contains(nlohmann::json::json_pointer(STATUS_PATH)))
+    // Only the pod status is read
+    if(resource == POD &&
+       json_event.contains(nlohmann::json::json_pointer(STATUS_PATH)))
     {
         std::string status_string;
         json_event.at(nlohmann::json::json_pointer(STATUS_PATH))
                 .get_to(status_string);
-        res_layout.status = nlohmann::json::parse(status_string);
+        parse_resource_status(status_string, res_layout);
     }
 
     if(json_event.contains(nlohmann::json::json_pointer(REFS_PATH)))
     {
-        nlohmann::json refs_json;
-        json_event.at(nlohmann::json::json_pointer(REFS_PATH))
-                .get_to(refs_json);
-        res_layout.refs = refs_json;
+        const auto& refs_json =
+                json_event.at(nlohmann::json::json_pointer(REFS_PATH));
+        for(int ref = 0; ref < K8S_RESOURCE_MAX; ref++)
+        {
+            if(!m_resource_kinds[ref])
+            {
+                continue;
+            }
+            const auto refs_path = std::string("/resources/") +
+                                   RESOURCE_KIND_NAMES[ref] + "/list";
+            if(refs_json.contains(nlohmann::json::json_pointer(refs_path)))
+            {
+                refs_json.at(nlohmann::json::json_pointer(refs_path))
+                        .get_to(res_layout.refs[ref]);
+            }
+        }
     }
 
-    ADD_MODIFY_TABLE_ENTRY("Pod", m_pod_table)
-    ADD_MODIFY_TABLE_ENTRY("Namespace", m_namespace_table)
-    ADD_MODIFY_TABLE_ENTRY("Deployment", m_deployment_table)
-    ADD_MODIFY_TABLE_ENTRY("Service", m_service_table)
-    ADD_MODIFY_TABLE_ENTRY("ReplicaSet", m_replicaset_table)
-    ADD_MODIFY_TABLE_ENTRY("ReplicationController",
-                           m_replication_controller_table)
-    ADD_MODIFY_TABLE_ENTRY("DeamonSet", m_deamonset_table)
+    store_resource(resource, res_layout);
 }
 
-void inline my_plugin::parse_deleted_resource(nlohmann::json& json_event,
-                                              std::string& resource_uid,
-                                              std::string& resource_kind)
+void inline my_plugin::parse_deleted_resource(const std::string& resource_uid,
+                                              const std::string& resource_kind)
 {
-    DELETE_TABLE_ENTRY("Pod", m_pod_table)
-    DELETE_TABLE_ENTRY("Namespace", m_namespace_table)
-    DELETE_TABLE_ENTRY("Deployment", m_deployment_table)
-    DELETE_TABLE_ENTRY("Service", m_service_table)
-    DELETE_TABLE_ENTRY("ReplicaSet", m_replicaset_table)
-    DELETE_TABLE_ENTRY("ReplicationController", m_replication_controller_table)
-    DELETE_TABLE_ENTRY("DeamonSet", m_deamonset_table)
+    auto resource = get_stored_resource(resource_kind);
+    if(resource == K8S_RESOURCE_MAX)
+    {
+        return;
+    }
+
+    if(resource == POD)
+    {
+        // Processes of the pod may still be running, they must not create its
+        // slot again
+        m_deleted_pod_uids.insert(resource_uid, true);
+        auto it = m_pod_indexes.find(resource_uid);
+        if(it != m_pod_indexes.end())
+        {
+            // the key is a view on the uid of the slot, erase it first
+            auto pod_index = it->second;
+            m_pod_indexes.erase(it);
+            m_pods.erase(pod_index);
+        }
+    }
+    auto& table = m_resource_tables[resource];
+    auto it = table.find(resource_uid);
+    if(it != table.end())
+    {
+        m_tables_memory[resource] -= table_entry_memory(it->second);
+        table.erase(it);
+    }
+    SPDLOG_DEBUG("deleted {} {}", resource_kind, resource_uid);
+}
+
+bool my_plugin::parse_proto_event(const char* data, uint32_t data_len)
+{
+    metadata::Event event;
+    if(!event.ParseFromArray(data, data_len))
+    {
+        m_lasterr = "cannot decode the protobuf payload of the async event";
+        SPDLOG_ERROR(m_lasterr);
+        return false;
+    }
+
+    const auto& event_reason = event.reason();
+    const auto& resource_uid = event.uid();
+    const auto& resource_kind = event.kind();
+
+    if(event_reason.compare(REASON_DELETE) == 0)
+    {
+        SPDLOG_DEBUG("try to delete {} '{}'", resource_kind, resource_uid);
+        parse_deleted_resource(resource_uid, resource_kind);
+        return true;
+    }
+
+    if(event_reason.compare(REASON_CREATE) != 0 &&
+       event_reason.compare(REASON_UPDATE) != 0)
+    {
+        SPDLOG_ERROR("reason '{}' is not known to the plugin", event_reason);
+        return false;
+    }
+
+    SPDLOG_DEBUG("try to add/update {} '{}'", resource_kind, resource_uid);
+    auto resource = get_stored_resource(resource_kind);
+    if(resource == K8S_RESOURCE_MAX)
+    {
+        return true;
+    }
+
+    // Same record as `parse_added_modified_resource`, without going through
+    // the JSON encoding of the whole event.
+    resource_record res_layout;
+    res_layout.uid = resource_uid;
+    res_layout.kind = resource_kind;
+
+    if(!event.meta().empty())
+    {
+        parse_resource_meta(event.meta(), res_layout);
+    }
+
+    if(resource == POD && !event.status().empty())
+    {
+        parse_resource_status(event.status(), res_layout);
+    }
+
+    if(event.has_refs())
+    {
+        const auto& refs = event.refs().resources();
+        for(int ref = 0; ref < K8S_RESOURCE_MAX; ref++)
+        {
+            if(!m_resource_kinds[ref])
+            {
+                continue;
+            }
+            auto it = refs.find(RESOURCE_KIND_NAMES[ref]);
+            if(it != refs.end())
+            {
+                res_layout.refs[ref].assign(it->second.list().begin(),
+                                            it->second.list().end());
+            }
+        }
+    }
+
+    store_resource(resource, res_layout);
+    return true;
 }
 
 bool inline my_plugin::parse_async_event(
@@ -1215,7 +1498,11 @@ bool inline my_plugin::parse_async_event(
 {
     auto& evt = in.get_event_reader();
     falcosecurity::events::asyncevent_e_decoder ad(evt);
-    if(std::strcmp(ad.get_name(), ASYNC_EVENT_NAME) != 0)
+    // The collector events are encoded as JSON or, if `protobufEvents` is
+    // enabled, as protobuf messages. Captures may hold both.
+    const bool is_proto =
+            std::strcmp(ad.get_name(), ASYNC_EVENT_NAME_PROTO) == 0;
+    if(!is_proto && std::strcmp(ad.get_name(), ASYNC_EVENT_NAME) != 0)
     {
         // We are not interested in parsing async events that are not
         // generated by our plugin.
@@ -1225,6 +1512,9 @@ bool inline my_plugin::parse_async_event(
         return true;
     }
 
+    // The resource tables are about to change
+    m_extract_memo.valid = false;
+
     uint32_t json_charbuf_len = 0;
     char* json_charbuf_pointer = (char*)ad.get_data(json_charbuf_len);
     if(json_charbuf_pointer == nullptr)
@@ -1233,7 +1523,22 @@ bool inline my_plugin::parse_async_event(
         SPDLOG_ERROR(m_lasterr);
         return false;
     }
-    auto json_event = nlohmann::json::parse(std::string(json_charbuf_pointer));
+    m_stats.async_events++;
+    m_stats.async_payload_bytes += json_charbuf_len;
+    latency_timer timer(is_proto ? m_stats.parse_proto_event
+                                 : m_stats.parse_json_event);
+    if(is_proto)
+    {
+        return parse_proto_event(json_charbuf_pointer, json_charbuf_len);
+    }
+    return parse_json_event(json_charbuf_pointer, json_charbuf_len);
+}
+
+bool my_plugin::parse_json_event(const char* data, uint32_t data_len)
+{
+    // The payload is sent with its terminator, which is not part of the JSON
+    auto json_event =
+            nlohmann::json::parse(data, data + strnlen(data, data_len));
 
     std::string event_reason;
     std::string resource_uid;
@@ -1268,7 +1573,7 @@ bool inline my_plugin::parse_async_event(
     else if(event_reason.compare(REASON_DELETE) == 0)
     {
         SPDLOG_DEBUG("try to delete {} '{}'", resource_kind, resource_uid);
-        parse_deleted_resource(json_event, resource_uid, resource_kind);
+        parse_deleted_resource(resource_uid, resource_kind);
     }
     else
     {
@@ -1278,26 +1583,6 @@ bool inline my_plugin::parse_async_event(
     return true;
 }
 
-// Obtain a param from a sinsp event
-static inline sinsp_param get_syscall_evt_param(void* evt, uint32_t num_param)
-{
-    uint32_t dataoffset = 0;
-    // pointer to the lengths array inside the event.
-    auto len = (uint16_t*)((uint8_t*)evt +
-                           sizeof(falcosecurity::_internal::ss_plugin_event));
-    for(uint32_t j = 0; j < num_param; j++)
-    {
-        // sum lengths of the previous params.
-        dataoffset += len[j];
-    }
-    return {.param_len = len[num_param],
-            .param_pointer =
-                    ((uint8_t*)&len
-                             [((falcosecurity::_internal::ss_plugin_event*)evt)
-                                      ->nparams]) +
-                    dataoffset};
-}
-
 static inline const char* get_event_name(uint16_t evt_type)
 {
     switch(evt_type)
@@ -1332,6 +1617,14 @@ bool inline my_plugin::parse_process_events(
     // - For clone/fork/vfork/clone3 we exclude failed syscall events (ret<0)
     auto res_param = get_syscall_evt_param(in.get_event_reader().get_buf(),
                                            EXECVE_CLONE_RES_PARAM_IDX);
+    if(res_param.param_pointer == nullptr ||
+       res_param.param_len < sizeof(int64_t))
+    {
+        SPDLOG_TRACE("missing return value of {}(event: {}) for thread id "
+                     "'{}'",
+                     get_event_name(evt_type), evt_type, thread_id);
+        return false;
+    }
     int64_t ret = 0;
     memcpy(&ret, res_param.param_pointer, sizeof(ret));
     if(ret < 0)
@@ -1347,10 +1640,18 @@ bool inline my_plugin::parse_process_events(
     // container or not. It's also true that if we enable this plugin we are in
     // a k8s environment so we need to evaluate this.
 
+    // clone/fork/vfork/clone3 return 0 in the child
+    const bool is_clone_child = ret == 0 &&
+                                evt_type != PPME_SYSCALL_EXECVE_19_X &&
+                                evt_type != PPME_SYSCALL_EXECVEAT_X;
+
     try
     {
         auto thread_entry = m_thread_table.get_entry(tr, thread_id);
-        on_new_process(thread_entry, tr, tw);
+        if(!is_clone_child || !inherit_parent_pod_index(thread_entry, tr, tw))
+        {
+            on_new_process(thread_entry, tr, tw);
+        }
         return true;
     }
     catch(const std::exception& e)
@@ -1385,6 +1686,168 @@ bool my_plugin::parse_event(const falcosecurity::parse_event_input& in)
     }
 }
 
+uint64_t my_plugin::get_pod_index(std::string_view pod_uid)
+{
+    auto it = m_pod_indexes.find(pod_uid);
+    if(it != m_pod_indexes.end())
+    {
+        return it->second;
+    }
+
+    auto pod_index = ++m_last_pod_index;
+    auto& slot = m_pods[pod_index];
+    slot.uid = pod_uid;
+    slot.created_ns = monotonic_ns();
+    m_pod_indexes.emplace(slot.uid, pod_index);
+    return pod_index;
+}
+
+uint64_t my_plugin::get_process_pod_index(std::string_view pod_uid)
+{
+    auto it = m_pod_indexes.find(pod_uid);
+    if(it != m_pod_indexes.end())
+    {
+        return it->second;
+    }
+    if(m_deleted_pod_uids.find(pod_uid) != nullptr)
+    {
+        return 0;
+    }
+
+    evict_pending_pods(monotonic_ns());
+    auto pod_index = get_pod_index(pod_uid);
+    m_pending_pods.push_back(pod_index);
+    return pod_index;
+}
+
+void my_plugin::evict_pending_pods(uint64_t now_ns)
+{
+    while(!m_pending_pods.empty())
+    {
+        auto pod = m_pods.find(m_pending_pods.front());
+        if(pod != m_pods.end() && pod->second.record == nullptr)
+        {
+            if(m_pending_pods.size() < POD_SLOT_PENDING_MAX_SIZE &&
+               now_ns - pod->second.created_ns < POD_SLOT_PENDING_TIMEOUT_NS)
+            {
+                return;
+            }
+            // The threads of the pod keep its index, they are just out of any
+            // known pod from now on. The key is a view on the uid of the
+            // slot, erase it first.
+            m_extract_memo.valid = false;
+            m_pod_indexes.erase(pod->second.uid);
+            m_pods.erase(pod);
+            m_stats.pod_slots_evicted++;
+        }
+        m_pending_pods.pop_front();
+    }
+}
+
+// We return `0` if we are not able to extract a pod uid from the cgroup.
+uint64_t my_plugin::scan_pod_index(const std::string& cgroup)
+{
+    char pod_uid[POD_UID_LEN];
+    if(!scan_pod_uid(cgroup, pod_uid))
+    {
+        return 0;
+    }
+    return get_process_pod_index(std::string_view(pod_uid, POD_UID_LEN));
+}
+
+uint64_t my_plugin::get_pod_index_from_cgroup(const std::string& cgroup)
+{
+    auto cached = m_pod_index_cache.find(cgroup);
+    if(cached != nullptr)
+    {
+        m_stats.pod_index_cache_hits++;
+        // The pod may have been deleted since the cgroup was scanned, a new
+        // index is given to it if it shows up again.
+        auto& pod_index = *cached;
+        if(pod_index != 0 && m_pods.find(pod_index) == m_pods.end())
+        {
+            pod_index = scan_pod_index(cgroup);
+        }
+        return pod_index;
+    }
+
+    // The processes out of a pod are remembered too.
+    m_stats.pod_index_cache_misses++;
+    auto pod_index = scan_pod_index(cgroup);
+    m_pod_index_cache.insert(cgroup, pod_index);
+    return pod_index;
+}
+
+bool my_plugin::same_cgroups(const falcosecurity::table_entry& thread_entry,
+                             const falcosecurity::table_entry& parent_entry,
+                             const falcosecurity::table_reader& tr)
+{
+    using st = falcosecurity::state_value_type;
+
+    auto cgroups_table = m_thread_table.get_subtable(
+            tr, m_thread_field_cgroups, thread_entry, st::SS_PLUGIN_ST_UINT64);
+    size_t n = 0;
+    cgroups_table.iterate_entries(
+            tr,
+            [&](const falcosecurity::table_entry& e)
+            {
+                if(n == m_cgroups_buf.size())
+                {
+                    m_cgroups_buf.emplace_back();
+                }
+                m_cgroups_field_second.read_value(tr, e, m_cgroups_buf[n++]);
+                return true;
+            });
+
+    auto parent_cgroups_table = m_thread_table.get_subtable(
+            tr, m_thread_field_cgroups, parent_entry, st::SS_PLUGIN_ST_UINT64);
+    size_t i = 0;
+    bool same = true;
+    std::string cgroup;
+    parent_cgroups_table.iterate_entries(
+            tr,
+            [&](const falcosecurity::table_entry& e)
+            {
+                m_cgroups_field_second.read_value(tr, e, cgroup);
+                same = i < n && cgroup == m_cgroups_buf[i++];
+                return same;
+            });
+    return same && i == n;
+}
+
+// Fast path for clone/fork/vfork/clone3 children: a child shares its parent's
+// cgroups, hence its pod, unless it was cloned into another cgroup
+// (CLONE_INTO_CGROUP). Copy the pod_index of the parent instead of scanning
+// the cgroups again.
+bool my_plugin::inherit_parent_pod_index(
+        const falcosecurity::table_entry& thread_entry,
+        const falcosecurity::table_reader& tr,
+        const falcosecurity::table_writer& tw)
+{
+    int64_t ptid;
+    m_ptid_field.read_value(tr, thread_entry, ptid);
+
+    uint64_t pod_index = 0;
+    try
+    {
+        auto parent_entry = m_thread_table.get_entry(tr, ptid);
+        m_pod_index_field.read_value(tr, parent_entry, pod_index);
+        // The parent may be out of any pod or not be resolved yet, which
+        // can't be told apart; take the full path.
+        if(pod_index == 0 || !same_cgroups(thread_entry, parent_entry, tr))
+        {
+            return false;
+        }
+    }
+    catch(...)
+    {
+        return false;
+    }
+
+    m_pod_index_field.write_value(tw, thread_entry, pod_index);
+    return true;
+}
+
 void my_plugin::on_new_process(const falcosecurity::table_entry& thread_entry,
                                const falcosecurity::table_reader& tr,
                                const falcosecurity::table_writer& tw)
@@ -1392,6 +1855,26 @@ void my_plugin::on_new_process(const falcosecurity::table_entry& thread_entry,
     using st = falcosecurity::state_value_type;
     try
     {
+        // The container plugin parses the event first and already found the
+        // pod uid in the cgroups. Only the threads of a pod have one, the
+        // others still go through the cgroups: the container plugin may not
+        // match all the container engines.
+        if(m_has_pod_uid_field)
+        {
+            const char* pod_uid = nullptr;
+            m_pod_uid_field.read_value(tr, thread_entry, pod_uid);
+            if(pod_uid != nullptr && strnlen(pod_uid, POD_UID_LEN + 1) ==
+                                             POD_UID_LEN)
+            {
+                m_stats.pod_uid_shared++;
+                m_pod_index_field.write_value(
+                        tw, thread_entry,
+                        get_process_pod_index(
+                                std::string_view(pod_uid, POD_UID_LEN)));
+                return;
+            }
+        }
+
         auto cgroups_table = m_thread_table.get_subtable(
                 tr, m_thread_field_cgroups, thread_entry,
                 st::SS_PLUGIN_ST_UINT64);
@@ -1406,12 +1889,11 @@ void my_plugin::on_new_process(const falcosecurity::table_entry& thread_entry,
                     m_cgroups_field_second.read_value(tr, e, cgroup);
                     if(!cgroup.empty())
                     {
-                        const std::string pod_uid =
-                                get_pod_uid_from_cgroup_string(cgroup);
-                        if(!pod_uid.empty())
+                        auto pod_index = get_pod_index_from_cgroup(cgroup);
+                        if(pod_index != 0)
                         {
-                            m_pod_uid_field.write_value(tw, thread_entry,
-                                                        pod_uid);
+                            m_pod_index_field.write_value(tw, thread_entry,
+                                                          pod_index);
                             // break the loop
                             return false;
                         }
@@ -1421,6 +1903,6 @@ void my_plugin::on_new_process(const falcosecurity::table_entry& thread_entry,
     }
     catch(const std::exception& ex)
     {
-        SPDLOG_ERROR("cannot attach pod_uid to process: {}", ex.what());
+        SPDLOG_ERROR("cannot attach pod_index to process: {}", ex.what());
     }
 }
@@ -19,38 +19,158 @@ limitations under the License.
 #include "shared_with_tests_consts.h"
 #include "grpc_client.h"
 
+#include <plugin_toolkit/event_params.h>
+#include <plugin_toolkit/lru_cache.h>
+#include <plugin_toolkit/metrics.h>
+#include <plugin_toolkit/pod_uid.h>
+
+#include <algorithm>
 #include <thread>
 #include <atomic>
 #include <chrono>
+#include <deque>
+#include <string_view>
 #include <unordered_map>
 #include <sstream>
+#include <vector>
+
+// Kinds of resources sent by the collector. Keep this aligned with
+// `RESOURCE_KIND_NAMES`.
+enum K8sResource
+{
+    POD,
+    NS,
+    DEPLOYMENT,
+    SVC,
+    RS,
+    RC,
+    DS,
+    K8S_RESOURCE_MAX
+};
 
-struct resource_layout
+// Heap memory owned by a string, none when it fits the string itself
+static inline size_t string_memory(const std::string& s)
+{
+    auto begin = (const char*)&s;
+    if(s.data() >= begin && s.data() < begin + sizeof(s))
+    {
+        return 0;
+    }
+    return s.capacity() + 1;
+}
+
+// A resource as the extraction needs it: every field is parsed once when the
+// resource is added or updated, so extracting a field is a lookup.
+struct resource_record
 {
     std::string uid;
     std::string kind;
-    nlohmann::json meta;
-    nlohmann::json spec;
-    nlohmann::json status;
-    nlohmann::json refs;
+    std::string name;
+    // Only set for namespaced resources
+    std::string namespace_name;
+    // Only set for pods, and possibly not yet known
+    std::string pod_ip;
+    // Labels sorted by key, for the `label[<key>]` fields
+    std::vector<std::pair<std::string, std::string>> labels;
+    // `key:value` labels, for the `labels` fields
+    std::vector<std::string> labels_list;
+    // Uids of the resources referenced by this one, by kind
+    std::vector<std::string> refs[K8S_RESOURCE_MAX];
+
+    // Value of the `key` label, if any
+    const std::string* find_label(const std::string& key) const
+    {
+        auto it = std::lower_bound(
+                labels.begin(), labels.end(), key,
+                [](const std::pair<std::string, std::string>& label,
+                   const std::string& key) { return label.first < key; });
+        if(it == labels.end() || it->first != key)
+        {
+            return nullptr;
+        }
+        return &it->second;
+    }
 
     std::string print_resource() const
     {
         std::ostringstream oss;
         oss << "Uid: " << uid << std::endl;
         oss << "Kind: " << kind << std::endl;
-        oss << "Meta: " << meta << std::endl;
-        oss << "Spec: " << spec << std::endl;
-        oss << "Status: " << status << std::endl;
-        oss << "Refs: " << refs << std::endl;
+        oss << "Name: " << name << std::endl;
+        oss << "Namespace: " << namespace_name << std::endl;
+        oss << "Pod IP: " << pod_ip << std::endl;
+        oss << "Labels:";
+        for(const auto& label : labels_list)
+        {
+            oss << " " << label;
+        }
+        oss << std::endl;
+        oss << "Refs:";
+        for(const auto& uids : refs)
+        {
+            for(const auto& uid : uids)
+            {
+                oss << " " << uid;
+            }
+        }
+        oss << std::endl;
         return oss.str();
     }
+
+    // Approximate memory used by the record, for the metrics
+    size_t memory_usage() const
+    {
+        size_t n = sizeof(*this);
+        for(const auto* s : {&uid, &kind, &name, &namespace_name, &pod_ip})
+        {
+            n += string_memory(*s);
+        }
+        n += labels.capacity() * sizeof(labels[0]);
+        for(const auto& label : labels)
+        {
+            n += string_memory(label.first) + string_memory(label.second);
+        }
+        n += labels_list.capacity() * sizeof(std::string);
+        for(const auto& label : labels_list)
+        {
+            n += string_memory(label);
+        }
+        for(const auto& uids : refs)
+        {
+            n += uids.capacity() * sizeof(std::string);
+            for(const auto& ref_uid : uids)
+            {
+                n += string_memory(ref_uid);
+            }
+        }
+        return n;
+    }
+};
+
+// A pod known by the plugin, from the cgroups of its processes or from the
+// collector. `record` stays null until the collector sends the pod.
+struct pod_slot
+{
+    std::string uid;
+    const resource_record* record = nullptr;
+    // When the slot was created, to measure how long the processes of the
+    // pod wait for the collector to send it, and to give up waiting
+    uint64_t created_ns = 0;
 };
 
-struct sinsp_param
+// Resources of the event being extracted. An output usually asks for several
+// k8s fields of the same event: the thread and the resources are looked up
+// once per event, on the first field, and reused by the following ones.
+struct extract_memo
 {
-    uint16_t param_len;
-    uint8_t* param_pointer;
+    bool valid = false;
+    uint64_t evt_num = 0;
+    // Null if the thread is out of any pod or the pod is unknown
+    const pod_slot* pod = nullptr;
+    // Records of the pod refs, resolved on first use, null for the unknown
+    // ones
+    bool resolved[K8S_RESOURCE_MAX] = {};
+    std::vector<const resource_record*> refs[K8S_RESOURCE_MAX];
 };
 
 class my_plugin
@@ -87,16 +207,6 @@ class my_plugin
         K8S_FIELD_MAX
     };
 
-    enum K8sResource
-    {
-        POD,
-        NS,
-        DEPLOYMENT,
-        SVC,
-        RS,
-        RC,
-    };
-
     //////////////////////////
     // General plugin API
     //////////////////////////
@@ -122,6 +232,22 @@ class my_plugin
 
     falcosecurity::init_schema get_init_schema();
 
+    const std::vector<falcosecurity::metric>& get_metrics();
+
+    // Number of resources and approximate memory of a state table
+    size_t get_table_size(enum K8sResource resource) const
+    {
+        return m_resource_tables[resource].size();
+    }
+    size_t get_table_memory(enum K8sResource resource) const
+    {
+        return m_tables_memory[resource];
+    }
+
+    // Register and refresh the metrics of `m_stats`
+    void init_stats_metrics();
+    void update_stats_metrics();
+
     void parse_init_config(nlohmann::json& config_json);
 
     bool init(falcosecurity::init_input& in);
@@ -164,56 +290,94 @@ class my_plugin
     void on_new_process(const falcosecurity::table_entry& thread_entry,
                         const falcosecurity::table_reader& tr,
                         const falcosecurity::table_writer& tw);
+    uint64_t get_pod_index_from_cgroup(const std::string& cgroup);
+    uint64_t scan_pod_index(const std::string& cgroup);
+    uint64_t get_pod_index(std::string_view pod_uid);
+    // Like `get_pod_index` for the pod of a process, `0` if the collector
+    // already deleted it. A new slot waits for the collector to send the
+    // pod, see `evict_pending_pods`.
+    uint64_t get_process_pod_index(std::string_view pod_uid);
+    // Release the slots of the oldest pods still not sent by the collector,
+    // once timed out or past `POD_SLOT_PENDING_MAX_SIZE`
+    void evict_pending_pods(uint64_t now_ns);
+    bool same_cgroups(const falcosecurity::table_entry& thread_entry,
+                      const falcosecurity::table_entry& parent_entry,
+                      const falcosecurity::table_reader& tr);
+    bool
+    inherit_parent_pod_index(const falcosecurity::table_entry& thread_entry,
+                             const falcosecurity::table_reader& tr,
+                             const falcosecurity::table_writer& tw);
     std::vector<falcosecurity::field_info> get_fields();
 
-    bool inline get_uid_array(nlohmann::json& pod_refs_json,
-                              enum K8sResource resource,
-                              std::vector<std::string>& uid_array);
+    inline const resource_record*
+    get_resource(enum K8sResource resource,
+                 const std::string& resource_uid) const;
 
-    bool inline get_layout(nlohmann::json& pod_refs_json,
-                           enum K8sResource resource, resource_layout& layout);
+    inline const std::vector<std::string>*
+    get_uid_array(const resource_record& pod, enum K8sResource resource);
 
-    bool inline extract_name_from_meta(nlohmann::json& meta_json,
-                                       falcosecurity::extract_request& req);
+    inline const resource_record* get_layout(const resource_record& pod,
+                                             enum K8sResource resource);
 
-    bool inline extract_label_value_from_meta(
-            nlohmann::json& meta_json, falcosecurity::extract_request& req);
+    inline const std::vector<const resource_record*>&
+    get_layouts(const resource_record& pod, enum K8sResource resource);
 
-    bool inline extract_labels_from_meta(nlohmann::json& meta_json,
-                                         falcosecurity::extract_request& req);
+    inline const pod_slot*
+    find_event_pod(const falcosecurity::extract_fields_input& in);
+
+    // Null if the plugin doesn't know the resource of the pod yet
+    const pod_slot* find_pod(uint64_t pod_index) const;
+
+    // Starts the extraction of the `evt_num` event, whose thread runs into
+    // `pod`, or out of any known pod if null
+    void set_extract_pod(uint64_t evt_num, const pod_slot* pod);
+
+    bool inline extract_name(const resource_record& record,
+                             falcosecurity::extract_request& req);
+
+    bool inline extract_label_value(const resource_record& record,
+                                    falcosecurity::extract_request& req);
 
-    bool inline extract_uid_from_refs(nlohmann::json& pod_refs_json,
+    bool inline extract_labels(const resource_record& record,
+                               falcosecurity::extract_request& req);
+
+    bool inline extract_uid_from_refs(const resource_record& pod,
                                       enum K8sResource resource,
                                       falcosecurity::extract_request& req);
 
-    bool inline extract_name_from_refs(nlohmann::json& pod_refs_json,
+    bool inline extract_name_from_refs(const resource_record& pod,
                                        enum K8sResource resource,
                                        falcosecurity::extract_request& req);
 
     bool inline extract_label_value_from_refs(
-            nlohmann::json& pod_refs_json, enum K8sResource resource,
+            const resource_record& pod, enum K8sResource resource,
             falcosecurity::extract_request& req);
 
-    bool inline extract_labels_from_refs(nlohmann::json& pod_refs_json,
+    bool inline extract_labels_from_refs(const resource_record& pod,
                                          enum K8sResource resource,
                                          falcosecurity::extract_request& req);
 
     bool inline extract_uid_array_from_refs(
-            nlohmann::json& pod_refs_json, enum K8sResource resource,
+            const resource_record& pod, enum K8sResource resource,
             falcosecurity::extract_request& req);
 
     bool inline extract_name_array_from_refs(
-            nlohmann::json& pod_refs_json, enum K8sResource resource,
+            const resource_record& pod, enum K8sResource resource,
             falcosecurity::extract_request& req);
 
     bool inline extract_label_value_array_from_refs(
-            nlohmann::json& pod_refs_json, enum K8sResource resource,
+            const resource_record& pod, enum K8sResource resource,
             falcosecurity::extract_request& req);
 
     bool inline extract_labels_array_from_refs(
-            nlohmann::json& pod_refs_json, enum K8sResource resource,
+            const resource_record& pod, enum K8sResource resource,
             falcosecurity::extract_request& req);
 
+    // Extraction of a field of the pod set by `set_extract_pod`, not null
+    bool extract_pod_field(falcosecurity::extract_request& req);
+
+    bool inline extract_field(const falcosecurity::extract_fields_input& in);
+
     bool extract(const falcosecurity::extract_fields_input& in);
 
     //////////////////////////
@@ -235,13 +399,28 @@ class my_plugin
         return PARSE_EVENT_CODES;
     }
 
+    void inline parse_resource_meta(const std::string& meta_string,
+                                    resource_record& record);
+
+    void inline parse_resource_status(const std::string& status_string,
+                                      resource_record& record);
+
+    void inline store_resource(enum K8sResource resource,
+                               resource_record& record);
+
     void inline parse_added_modified_resource(nlohmann::json& json_event,
                                               std::string& resource_uid,
                                               std::string& resource_kind);
 
-    void inline parse_deleted_resource(nlohmann::json& json_event,
-                                       std::string& resource_uid,
-                                       std::string& resource_kind);
+    inline enum K8sResource
+    get_stored_resource(const std::string& resource_kind) const;
+
+    void inline parse_deleted_resource(const std::string& resource_uid,
+                                       const std::string& resource_kind);
+
+    // Parse a collector event, as encoded by the async events
+    bool parse_json_event(const char* data, uint32_t data_len);
+    bool parse_proto_event(const char* data, uint32_t data_len);
 
     bool inline parse_async_event(const falcosecurity::parse_event_input& in);
 
@@ -253,25 +432,59 @@ class my_plugin
     private:
     // Async thread
     std::thread m_async_thread;
+    // Written by the async thread, read by `get_metrics`
+    std::atomic<uint64_t> m_n_reconnects = 0;
+    std::atomic<uint64_t> m_backoff_seconds = 0;
     std::atomic<bool> m_async_thread_quit = false;
     std::condition_variable m_cv;
     std::mutex m_mu;
+    // Resources already sent by the collector, only used by the async thread
+    resource_versions m_resource_versions;
 
     // Init params
     std::string m_collector_hostname;
     std::string m_collector_port;
     std::string m_node_name;
     std::string m_ca_PEM_encoding;
-
-    // State tables
-    std::unordered_map<std::string, resource_layout> m_pod_table;
-    std::unordered_map<std::string, resource_layout> m_namespace_table;
-    std::unordered_map<std::string, resource_layout> m_deployment_table;
-    std::unordered_map<std::string, resource_layout> m_service_table;
-    std::unordered_map<std::string, resource_layout> m_replicaset_table;
-    std::unordered_map<std::string, resource_layout>
-            m_replication_controller_table;
-    std::unordered_map<std::string, resource_layout> m_deamonset_table;
+    bool m_protobuf_events = false;
+    size_t m_decode_workers = 1;
+    uint64_t m_update_window_ms = 0;
+    // Kinds watched and stored, indexed by `K8sResource`
+    bool m_resource_kinds[K8S_RESOURCE_MAX] = {};
+
+    // State tables, one for each kind of resource, indexed by `K8sResource`.
+    // Records are only modified while parsing, so the extraction can work on
+    // references to them.
+    std::unordered_map<std::string, resource_record>
+            m_resource_tables[K8S_RESOURCE_MAX];
+    // Dropped when the event changes or when the tables are modified
+    extract_memo m_extract_memo;
+    // Approximate memory of each state table, indexed by `K8sResource`
+    size_t m_tables_memory[K8S_RESOURCE_MAX] = {};
+
+    std::vector<falcosecurity::metric> m_metrics;
+    // Hot path statistics, exported as metrics past the tables ones, see
+    // `init_stats_metrics`
+    struct
+    {
+        uint64_t async_events = 0;
+        uint64_t async_payload_bytes = 0;
+        latency_histogram parse_json_event;
+        latency_histogram parse_proto_event;
+        // From the first process of a pod to the collector sending the pod,
+        // for the pods not sent yet when their first process shows up
+        latency_histogram pod_arrival;
+        uint64_t pod_index_cache_hits = 0;
+        uint64_t pod_index_cache_misses = 0;
+        // New processes resolved by the pod uid of the container plugin
+        uint64_t pod_uid_shared = 0;
+        // Slots released without the collector ever sending their pod
+        uint64_t pod_slots_evicted = 0;
+        // Indexed by field id
+        std::vector<uint64_t> extract_calls;
+        std::vector<uint64_t> extract_misses;
+    } m_stats;
+    size_t m_stats_metrics_offset = 0;
 
     // Last error of the plugin
     std::string m_lasterr;
@@ -283,7 +496,32 @@ class my_plugin
     // path
     falcosecurity::table_field m_cgroups_field_second;
     // Accessors to the fixed fields of the thread table
+    falcosecurity::table_field m_ptid_field;
+    falcosecurity::table_field m_pod_index_field;
+    // Pod uid published by the container plugin, when it is loaded before
+    // this one, see `POD_UID_FIELD_NAME`
+    bool m_has_pod_uid_field = false;
     falcosecurity::table_field m_pod_uid_field;
+
+    // Pods by index, the value stored in the thread table `pod_index` field.
+    // `0` stands for "out of any pod", an index is never reused. A pod gets
+    // its index from the first cgroup or collector event naming it, and
+    // keeps it until the collector deletes it, or until it times out if the
+    // collector never sends it, see `evict_pending_pods`.
+    std::unordered_map<uint64_t, pod_slot> m_pods;
+    // Index of each pod, the keys are views on the uids owned by `m_pods`
+    std::unordered_map<std::string_view, uint64_t> m_pod_indexes;
+    uint64_t m_last_pod_index = 0;
+    // Indexes of the slots created by processes, oldest first. The ones sent
+    // or deleted by the collector since are skipped when reached.
+    std::deque<uint64_t> m_pending_pods;
+    // Uids of the pods deleted by the collector
+    string_lru_cache<bool> m_deleted_pod_uids{DELETED_POD_UID_CACHE_MAX_SIZE};
+
+    // Pod index of the last cgroup paths seen, `0` for the ones out of a pod
+    string_lru_cache<uint64_t> m_pod_index_cache{POD_UID_CACHE_MAX_SIZE};
+    // Cgroups of the new thread, reused by `same_cgroups`
+    std::vector<std::string> m_cgroups_buf;
 };
 
 FALCOSECURITY_PLUGIN(my_plugin);
@@ -17,17 +17,48 @@ limitations under the License.
 
 #pragma once
 
-/// todo!: According to perf tests we could compile out some logs
+// Logs below this level are compiled out, see `K8SMETA_LOG_LEVEL` in the
+// CMakeLists.txt. The hot path only has trace and debug logs.
+#ifndef SPDLOG_ACTIVE_LEVEL
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
 
 #include <falcosecurity/sdk.h>
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_sinks.h>
 
-// Regex to extract the pod uid from cgroups
-#define RGX_POD                                                                \
-    "(pod[a-z0-9]{8}[-_][a-z0-9]{4}[-_][a-z0-9]{4}[-_][a-z0-9]{4}[-_][a-z0-9]" \
-    "{12})"
+// Thread table fields read by the plugin
+#define PTID_FIELD_NAME "ptid"
+
+// Max number of cgroup paths whose pod uid is remembered
+#define POD_UID_CACHE_MAX_SIZE 4096
+
+// A pod only known from the cgroups of its processes waits that long for the
+// collector to send it before its slot is released, at most
+// `POD_SLOT_PENDING_MAX_SIZE` slots are waiting
+#define POD_SLOT_PENDING_TIMEOUT_NS (10ULL * 60 * 1000 * 1000 * 1000)
+#define POD_SLOT_PENDING_MAX_SIZE 4096
+
+// Max number of deleted pod uids remembered, the processes still running in
+// these pods don't get a slot again
+#define DELETED_POD_UID_CACHE_MAX_SIZE 4096
+
+// Metrics, past the ones of the resource tables
+#define METRIC_N_ASYNC_EVENTS "n_async_events"
+#define METRIC_ASYNC_EVENT_PAYLOAD_BYTES "async_event_payload_bytes"
+#define METRIC_PARSE_JSON_EVENT_LATENCY "parse_json_event_latency"
+#define METRIC_PARSE_PROTO_EVENT_LATENCY "parse_proto_event_latency"
+#define METRIC_POD_ARRIVAL_LATENCY "pod_arrival_latency"
+#define METRIC_N_POD_INDEX_CACHE_HITS "n_pod_index_cache_hits"
+#define METRIC_N_POD_INDEX_CACHE_MISSES "n_pod_index_cache_misses"
+#define METRIC_N_POD_UID_SHARED "n_pod_uid_shared"
+#define METRIC_N_POD_SLOTS "n_pod_slots"
+#define METRIC_N_POD_SLOTS_EVICTED "n_pod_slots_evicted"
+#define METRIC_N_COLLECTOR_RECONNECTS "n_collector_reconnects"
+#define METRIC_COLLECTOR_BACKOFF_SECONDS "collector_backoff_seconds"
+// Followed by the field name, with `_` instead of `.`
+#define METRIC_N_EXTRACT_PREFIX "n_extract_"
+#define METRIC_N_EXTRACT_MISSES_PREFIX "n_extract_misses_"
 
 // Sinsp events used in the plugin
 using _et = falcosecurity::event_type;
@@ -23,9 +23,11 @@ limitations under the License.
 // Async capability
 /////////////////////////
 #define ASYNC_EVENT_NAME "k8s"
+// Same events, as protobuf messages instead of JSON
+#define ASYNC_EVENT_NAME_PROTO "k8s_proto"
 #define ASYNC_EVENT_NAMES                                                      \
     {                                                                          \
-        ASYNC_EVENT_NAME                                                       \
+        ASYNC_EVENT_NAME, ASYNC_EVENT_NAME_PROTO                               \
     }
 #define ASYNC_EVENT_SOURCES                                                    \
     {                                                                          \
@@ -65,7 +67,7 @@ limitations under the License.
 /////////////////////////
 #define THREAD_TABLE_NAME "threads"
 #define CGROUPS_TABLE_NAME "cgroups"
-#define POD_UID_FIELD_NAME "pod_uid"
+#define POD_INDEX_FIELD_NAME "pod_index"
 
 /////////////////////////
 // Proto event reasons
@@ -100,3 +102,7 @@ limitations under the License.
 #define PORT_PATH "/collectorPort"
 #define NODENAME_PATH "/nodeName"
 #define CA_CERT_PATH "/caPEMBundle"
+#define PROTOBUF_EVENTS_PATH "/protobufEvents"
+#define RESOURCE_KINDS_PATH "/resourceKinds"
+#define DECODE_WORKERS_PATH "/decodeWorkers"
+#define UPDATE_WINDOW_PATH "/updateWindowMs"
@@ -18,8 +18,10 @@ limitations under the License.
 #include <gtest/gtest.h>
 #include <plugin.h>
 #include <test/helpers/threads_helpers.h>
+#include <chrono>
 #include <exception>
 #include <fstream>
+#include <map>
 
 // Obtained from the plugin folder
 #include <k8smeta_tests/json.hpp>
@@ -300,6 +302,64 @@ TEST_F(sinsp_with_test_input, plugin_k8s_content_of_async_events)
     ASSERT_EQ(extractor.get_num_events(), num_async_events);
 }
 
+// With an update window, the creations and deletions are forwarded without
+// waiting, even when they replace a waiting update, and each resource still
+// ends up with its latest content.
+TEST_F(sinsp_with_test_input, plugin_k8s_update_window_events)
+{
+    auto plugin_owner = m_inspector.register_plugin(PLUGIN_PATH);
+    ASSERT_TRUE(plugin_owner.get());
+    std::string err;
+    ASSERT_TRUE(plugin_owner->init(
+            R"({"collectorHostname":"localhost","collectorPort":45000,"nodeName":"control-plane","hostProc":"","updateWindowMs":5000})",
+            err))
+            << "err: " << err;
+
+    open_inspector();
+
+    // Latest content of each resource, the reason is left out: an update
+    // with no change is not forwarded
+    auto content = [](nlohmann::json json)
+    {
+        json.erase("reason");
+        return json;
+    };
+    k8s_json_extractor extractor;
+    std::map<std::string, nlohmann::json> expected;
+    for(uint32_t i = 0; i < extractor.get_num_events(); i++)
+    {
+        auto json = extractor.get_json_event(i);
+        expected[json.at(nlohmann::json::json_pointer(UID_PATH))
+                         .get<std::string>()] = content(json);
+    }
+
+    std::map<std::string, nlohmann::json> received;
+    auto start = std::chrono::steady_clock::now();
+    sinsp_evt* evt = NULL;
+    while(received != expected &&
+          std::chrono::steady_clock::now() - start < std::chrono::seconds(15))
+    {
+        int rc = m_inspector.next(&evt);
+        if(rc != SCAP_SUCCESS || evt == nullptr ||
+           evt->get_type() != PPME_ASYNCEVENT_E)
+        {
+            continue;
+        }
+        auto json = nlohmann::json::parse(evt->get_param(2)->m_val);
+        std::string reason;
+        json.at(nlohmann::json::json_pointer(REASON_PATH)).get_to(reason);
+        if(reason != REASON_UPDATE)
+        {
+            ASSERT_LT(std::chrono::steady_clock::now() - start,
+                      std::chrono::seconds(4))
+                    << json.dump();
+        }
+        received[json.at(nlohmann::json::json_pointer(UID_PATH))
+                         .get<std::string>()] = content(json);
+    }
+    ASSERT_EQ(received, expected);
+}
+
 // Check pod filterchecks value
 TEST_F(sinsp_with_test_input, plugin_k8s_pod_refs)
 {
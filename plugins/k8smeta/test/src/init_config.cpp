@@ -104,3 +104,78 @@ TEST_F(sinsp_with_test_input, plugin_k8s_with_host_proc)
                                        err));
     ASSERT_EQ(err, "");
 }
+
+TEST_F(sinsp_with_test_input, plugin_k8s_with_protobuf_events)
+{
+    auto plugin_owner = m_inspector.register_plugin(PLUGIN_PATH);
+    ASSERT_TRUE(plugin_owner.get());
+    std::string err;
+
+    ASSERT_NO_THROW(plugin_owner->init(R"(
+{"collectorHostname":"localhost","collectorPort":45000,"nodeName":"kind-control-plane","protobufEvents":true})",
+                                       err));
+    ASSERT_EQ(err, "");
+
+    // Only booleans are accepted
+    plugin_owner = m_inspector.register_plugin(PLUGIN_PATH);
+    ASSERT_THROW(plugin_owner->init(R"(
+{"collectorHostname":"localhost","collectorPort":45000,"nodeName":"kind-control-plane","protobufEvents":"true"})",
+                                    err),
+                 sinsp_exception);
+}
+
+TEST_F(sinsp_with_test_input, plugin_k8s_with_resource_kinds)
+{
+    auto plugin_owner = m_inspector.register_plugin(PLUGIN_PATH);
+    ASSERT_TRUE(plugin_owner.get());
+    std::string err;
+
+    ASSERT_NO_THROW(plugin_owner->init(R"(
+{"collectorHostname":"localhost","collectorPort":45000,"nodeName":"kind-control-plane","resourceKinds":["Pod","Namespace"]})",
+                                       err));
+    ASSERT_EQ(err, "");
+
+    // Only the kinds known to the collector are accepted
+    plugin_owner = m_inspector.register_plugin(PLUGIN_PATH);
+    ASSERT_THROW(plugin_owner->init(R"(
+{"collectorHostname":"localhost","collectorPort":45000,"nodeName":"kind-control-plane","resourceKinds":["Node"]})",
+                                    err),
+                 sinsp_exception);
+}
+
+TEST_F(sinsp_with_test_input, plugin_k8s_with_decode_workers)
+{
+    auto plugin_owner = m_inspector.register_plugin(PLUGIN_PATH);
+    ASSERT_TRUE(plugin_owner.get());
+    std::string err;
+
+    ASSERT_NO_THROW(plugin_owner->init(R"(
+{"collectorHostname":"localhost","collectorPort":45000,"nodeName":"kind-control-plane","decodeWorkers":4})",
+                                       err));
+    ASSERT_EQ(err, "");
+
+    // At least one worker is needed
+    plugin_owner = m_inspector.register_plugin(PLUGIN_PATH);
+    ASSERT_THROW(plugin_owner->init(R"(
+{"collectorHostname":"localhost","collectorPort":45000,"nodeName":"kind-control-plane","decodeWorkers":0})",
+                                    err),
+                 sinsp_exception);
+}
+
+TEST_F(sinsp_with_test_input, plugin_k8s_with_update_window)
+{
+    auto plugin_owner = m_inspector.register_plugin(PLUGIN_PATH);
+    ASSERT_TRUE(plugin_owner.get());
+    std::string err;
+
+    ASSERT_NO_THROW(plugin_owner->init(R"(
+{"collectorHostname":"localhost","collectorPort":45000,"nodeName":"kind-control-plane","updateWindowMs":500})",
+                                       err));
+    ASSERT_EQ(err, "");
+
+    plugin_owner = m_inspector.register_plugin(PLUGIN_PATH);
+    ASSERT_THROW(plugin_owner->init(R"(
+{"collectorHostname":"localhost","collectorPort":45000,"nodeName":"kind-control-plane","updateWindowMs":-1})",
+                                    err),
+                 sinsp_exception);
+}
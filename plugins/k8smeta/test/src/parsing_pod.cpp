@@ -38,8 +38,8 @@ limitations under the License.
     auto &reg = m_inspector.get_table_registry();                              \
     auto thread_table = reg->get_table<int64_t>(THREAD_TABLE_NAME);            \
     auto dynamic_fields = thread_table->dynamic_fields();                      \
-    auto field = dynamic_fields->fields().find(POD_UID_FIELD_NAME);            \
-    auto fieldacc = field->second.new_accessor<std::string>();                 \
+    auto field = dynamic_fields->fields().find(POD_INDEX_FIELD_NAME);          \
+    auto fieldacc = field->second.new_accessor<uint64_t>();                    \
                                                                                \
     int64_t p1_tid = 2;                                                        \
     int64_t p1_pid = 2;                                                        \
@@ -50,7 +50,7 @@ limitations under the License.
     std::string expected_pod_uid = "5eaeeca9-2277-460b-a4bf-5a0783f6d49f";     \
                                                                                \
     /* We generate a clone exit event for the parent. */                       \
-    /* This is parsed but the pod_uid is not extracted. */                     \
+    /* This is parsed but the pod_index is not extracted. */                   \
     auto evt = generate_clone_x_event(                                         \
             p1_tid, INIT_TID, INIT_PID, INIT_PTID, 0, INIT_TID, INIT_PTID,     \
             "init",                                                            \
@@ -61,9 +61,9 @@ limitations under the License.
     ASSERT_EQ(evt->get_type(), event);                                         \
     auto init_thread_entry = thread_table->get_entry(INIT_TID);                \
     ASSERT_NE(init_thread_entry, nullptr);                                     \
-    std::string pod_uid;                                                       \
-    init_thread_entry->get_dynamic_field(fieldacc, pod_uid);                   \
-    ASSERT_EQ(pod_uid, "");                                                    \
+    uint64_t pod_index = 0;                                                    \
+    init_thread_entry->get_dynamic_field(fieldacc, pod_index);                 \
+    ASSERT_EQ(pod_index, 0);                                                   \
                                                                                \
     evt = generate_clone_x_event(                                              \
             0, p1_tid, p1_pid, p1_ptid, PPM_CL_CHILD_IN_PIDNS, p1_vtid,        \
@@ -76,8 +76,8 @@ limitations under the License.
                                                                                \
     auto p1_tid_entry = thread_table->get_entry(p1_tid);                       \
     ASSERT_NE(p1_tid_entry, nullptr);                                          \
-    p1_tid_entry->get_dynamic_field(fieldacc, pod_uid);                        \
-    ASSERT_EQ(pod_uid, expected_pod_uid);
+    p1_tid_entry->get_dynamic_field(fieldacc, pod_index);                      \
+    ASSERT_NE(pod_index, 0);
 
 #define EXECVE_EXECVEAT_TEST(event)                                            \
     std::shared_ptr<sinsp_plugin> plugin_owner;                                \
@@ -90,8 +90,8 @@ limitations under the License.
     auto &reg = m_inspector.get_table_registry();                              \
     auto thread_table = reg->get_table<int64_t>(THREAD_TABLE_NAME);            \
     auto dynamic_fields = thread_table->dynamic_fields();                      \
-    auto field = dynamic_fields->fields().find(POD_UID_FIELD_NAME);            \
-    auto fieldacc = field->second.new_accessor<std::string>();                 \
+    auto field = dynamic_fields->fields().find(POD_INDEX_FIELD_NAME);          \
+    auto fieldacc = field->second.new_accessor<uint64_t>();                    \
                                                                                \
     uint64_t not_relevant_64 = 0;                                              \
     uint32_t not_relevant_32 = 0;                                              \
@@ -119,9 +119,9 @@ limitations under the License.
                                                                                \
     auto init_thread_entry = thread_table->get_entry(INIT_TID);                \
     ASSERT_NE(init_thread_entry, nullptr);                                     \
-    std::string pod_uid;                                                       \
-    init_thread_entry->get_dynamic_field(fieldacc, pod_uid);                   \
-    ASSERT_EQ(pod_uid, expected_pod_uid);
+    uint64_t pod_index = 0;                                                    \
+    init_thread_entry->get_dynamic_field(fieldacc, pod_index);                 \
+    ASSERT_NE(pod_index, 0);
 
 // Check pod regex with different formats
 TEST_F(sinsp_with_test_input, plugin_k8s_pod_uid_regex)
@@ -136,11 +136,31 @@ TEST_F(sinsp_with_test_input, plugin_k8s_pod_uid_regex)
     auto &reg = m_inspector.get_table_registry();
     auto thread_table = reg->get_table<int64_t>(THREAD_TABLE_NAME);
     auto field =
-            thread_table->dynamic_fields()->fields().find(POD_UID_FIELD_NAME);
-    auto fieldacc = field->second.new_accessor<std::string>();
+            thread_table->dynamic_fields()->fields().find(POD_INDEX_FIELD_NAME);
+    auto fieldacc = field->second.new_accessor<uint64_t>();
     auto init_thread_entry = thread_table->get_entry(INIT_TID);
     ASSERT_NE(init_thread_entry, nullptr);
-    std::string pod_uid = "";
+    uint64_t pod_index = 0;
+
+    // The thread table only holds pod indexes: the uid extracted from each
+    // format is checked against the index of the same uid in a plain cgroupfs
+    // path.
+    auto get_pod_index = [&](const std::string &cgroup)
+    {
+        generate_execve_enter_and_exit_event(
+                0, INIT_TID, INIT_TID, INIT_PID, INIT_PTID, "init", "init",
+                "/lib/systemd/systemd", {cgroup});
+        uint64_t index = 0;
+        init_thread_entry->get_dynamic_field(fieldacc, index);
+        return index;
+    };
+    auto get_cgroupfs_pod_index = [&](std::string pod_uid)
+    {
+        std::replace(pod_uid.begin(), pod_uid.end(), '_', '-');
+        return get_pod_index("cpuset=/kubepods/besteffort/pod" + pod_uid +
+                             "/691e0ffb65010b2b611f3a15b7f76c48466192e673e15"
+                             "6f38bd2f8e25acd6bbc");
+    };
 
     // CgroupV1, driver cgroup
     std::string expected_pod_uid = "05869489-8c7f-45dc-9abd-1b1620787bb1";
@@ -151,73 +171,67 @@ TEST_F(sinsp_with_test_input, plugin_k8s_pod_uid_regex)
              "/691e0ffb65010b2b611f3a15b7f76c48466192e673e156f38bd2f8e25acd6bb"
              "c"});
 
-    // Check that the pod uid is updated after the first execve
-    init_thread_entry->get_dynamic_field(fieldacc, pod_uid);
-    ASSERT_EQ(pod_uid, expected_pod_uid);
+    // Check that the pod index is updated after the first execve
+    init_thread_entry->get_dynamic_field(fieldacc, pod_index);
+    ASSERT_NE(pod_index, 0);
+    auto first_pod_index = pod_index;
 
     // CgroupV1, driver systemd
     // systemd has this format with `_` instead of `-`
     expected_pod_uid = "0f90f31c_ebeb_4192_a2b0_92e076c43817";
-    generate_execve_enter_and_exit_event(
-            0, INIT_TID, INIT_TID, INIT_PID, INIT_PTID, "init", "init",
-            "/lib/systemd/systemd",
-            {"cpuset=/kubepods.slice/kubepods-besteffort.slice/"
-             "kubepods-besteffort-pod" +
-             expected_pod_uid +
-             ".slice/"
-             "4c97d83b89df14eea65dbbab1f506b405758341616ab75437d66fd8bab0e2be"
-             "b"});
-    init_thread_entry->get_dynamic_field(fieldacc, pod_uid);
-    std::replace(expected_pod_uid.begin(), expected_pod_uid.end(), '_', '-');
-    ASSERT_EQ(pod_uid, expected_pod_uid);
+    pod_index = get_pod_index(
+            "cpuset=/kubepods.slice/kubepods-besteffort.slice/"
+            "kubepods-besteffort-pod" +
+            expected_pod_uid +
+            ".slice/"
+            "4c97d83b89df14eea65dbbab1f506b405758341616ab75437d66fd8bab0e2be"
+            "b");
+    ASSERT_NE(pod_index, 0);
+    ASSERT_NE(pod_index, first_pod_index);
+    ASSERT_EQ(pod_index, get_cgroupfs_pod_index(expected_pod_uid));
 
     // CgroupV2, driver cgroup
     expected_pod_uid = "af4fa4cf-129e-4699-a2af-65548fb8977d";
-    generate_execve_enter_and_exit_event(
-            0, INIT_TID, INIT_TID, INIT_PID, INIT_PTID, "init", "init",
-            "/lib/systemd/systemd",
-            {"cpuset=/kubepods/besteffort/pod" + expected_pod_uid +
-             "/fc16540dcd776bb475437b722c47de798fa1b07687db1ba7d4609c23d5d1a08"
-             "8"});
-    init_thread_entry->get_dynamic_field(fieldacc, pod_uid);
-    ASSERT_EQ(pod_uid, expected_pod_uid);
+    pod_index = get_pod_index(
+            "cpuset=/kubepods/besteffort/pod" + expected_pod_uid +
+            "/fc16540dcd776bb475437b722c47de798fa1b07687db1ba7d4609c23d5d1a08"
+            "8");
+    ASSERT_NE(pod_index, 0);
+    ASSERT_NE(pod_index, first_pod_index);
+    ASSERT_EQ(pod_index, get_cgroupfs_pod_index(expected_pod_uid));
 
     // CgroupV2, driver systemd
     expected_pod_uid = "43f23404_e33c_48c7_8114_28ee4b7043ec";
-    generate_execve_enter_and_exit_event(
-            0, INIT_TID, INIT_TID, INIT_PID, INIT_PTID, "init", "init",
-            "/lib/systemd/systemd",
-            {"cpuset=/kubepods.slice/kubepods-besteffort.slice/"
-             "kubepods-besteffort-pod" +
-             expected_pod_uid +
-             ".slice/"
-             "cri-containerd-"
-             "b59ce319955234d0b051a93dac5efa8fc07df08d8b0188195b434174efc44e73."
-             "scope"});
-    init_thread_entry->get_dynamic_field(fieldacc, pod_uid);
-    std::replace(expected_pod_uid.begin(), expected_pod_uid.end(), '_', '-');
-    ASSERT_EQ(pod_uid, expected_pod_uid);
+    pod_index = get_pod_index(
+            "cpuset=/kubepods.slice/kubepods-besteffort.slice/"
+            "kubepods-besteffort-pod" +
+            expected_pod_uid +
+            ".slice/"
+            "cri-containerd-"
+            "b59ce319955234d0b051a93dac5efa8fc07df08d8b0188195b434174efc44e73."
+            "scope");
+    ASSERT_NE(pod_index, 0);
+    ASSERT_NE(pod_index, first_pod_index);
+    ASSERT_EQ(pod_index, get_cgroupfs_pod_index(expected_pod_uid));
 
     // Not match, wrong pod_uid format
     // Use a cgroup with a wrong pod_uid
-    generate_execve_enter_and_exit_event(
-            0, INIT_TID, INIT_TID, INIT_PID, INIT_PTID, "init", "init",
-            "/lib/systemd/systemd",
-            {"cpuset=/kubepods.slice/kubepods-besteffort.slice/"
-             "kubepods-besteffort-pod438943***343r2e-fsdwed-32ewad-e2dw-2."
-             "slice/"
-             "cri-containerd-"
-             "b59ce319955234d0b051a93dac5efa8fc07df08d8b0188195b434174efc44e73."
-             "scope"});
-    init_thread_entry->get_dynamic_field(fieldacc, pod_uid);
+    auto expected_pod_index = pod_index;
+    pod_index = get_pod_index(
+            "cpuset=/kubepods.slice/kubepods-besteffort.slice/"
+            "kubepods-besteffort-pod438943***343r2e-fsdwed-32ewad-e2dw-2."
+            "slice/"
+            "cri-containerd-"
+            "b59ce319955234d0b051a93dac5efa8fc07df08d8b0188195b434174efc44e73."
+            "scope");
     // We are not able to extract something valid from the last call so the
-    // pod_uid is unchanged
-    ASSERT_EQ(pod_uid, expected_pod_uid);
+    // pod_index is unchanged
+    ASSERT_EQ(pod_index, expected_pod_index);
 }
 
-// Check that the plugin defines a new field called "pod_uid" in the `init`
+// Check that the plugin defines a new field called "pod_index" in the `init`
 // plugin.
-TEST_F(sinsp_with_test_input, plugin_k8s_pod_uid_field_existance)
+TEST_F(sinsp_with_test_input, plugin_k8s_pod_index_field_existance)
 {
     std::shared_ptr<sinsp_plugin> plugin_owner;
     filter_check_list pl_flist;
@@ -232,24 +246,24 @@ TEST_F(sinsp_with_test_input, plugin_k8s_pod_uid_field_existance)
     ASSERT_NE(reg->tables().find(THREAD_TABLE_NAME), reg->tables().end());
     auto thread_table = reg->get_table<int64_t>(THREAD_TABLE_NAME);
     auto field =
-            thread_table->dynamic_fields()->fields().find(POD_UID_FIELD_NAME);
+            thread_table->dynamic_fields()->fields().find(POD_INDEX_FIELD_NAME);
     ASSERT_NE(field, thread_table->dynamic_fields()->fields().end());
-    ASSERT_EQ(field->second.name(), POD_UID_FIELD_NAME);
+    ASSERT_EQ(field->second.name(), POD_INDEX_FIELD_NAME);
     ASSERT_EQ(field->second.info(),
-              libsinsp::state::typeinfo::of<std::string>());
+              libsinsp::state::typeinfo::of<uint64_t>());
 
     // Try to access this field for the init thread, the value should be empty
     // since the plugin doesn't populate it!
-    auto fieldacc = field->second.new_accessor<std::string>();
+    auto fieldacc = field->second.new_accessor<uint64_t>();
     auto init_thread_entry = thread_table->get_entry(INIT_TID);
     ASSERT_NE(init_thread_entry, nullptr);
-    std::string pod_uid;
-    init_thread_entry->get_dynamic_field(fieldacc, pod_uid);
-    ASSERT_EQ(pod_uid, "");
+    uint64_t pod_index = 0;
+    init_thread_entry->get_dynamic_field(fieldacc, pod_index);
+    ASSERT_EQ(pod_index, 0);
 }
 
 // Check that clone/fork events are correctly parsed into the plugin and the
-// pod_uid is populated for the new thread!
+// pod_index is populated for the new thread!
 TEST_F(sinsp_with_test_input, plugin_k8s_PPME_SYSCALL_CLONE_20_X_parse)
 {
     CLONE_FORK_TEST(PPME_SYSCALL_CLONE_20_X);
@@ -271,7 +285,7 @@ TEST_F(sinsp_with_test_input, plugin_k8s_PPME_SYSCALL_CLONE3_X_parse)
 }
 
 // Check that execve/execveat events are correctly parsed into the plugin and
-// the pod_uid is populated for the new thread!
+// the pod_index is populated for the new thread!
 TEST_F(sinsp_with_test_input, plugin_k8s_PPME_SYSCALL_EXECVE_19_X_parse)
 {
     EXECVE_EXECVEAT_TEST(PPME_SYSCALL_EXECVE_19_X);
@@ -282,7 +296,8 @@ TEST_F(sinsp_with_test_input, plugin_k8s_PPME_SYSCALL_EXECVEAT_X_parse)
     EXECVE_EXECVEAT_TEST(PPME_SYSCALL_EXECVEAT_X);
 }
 
-// Check that the pod_uid is correctly overwritten with an execve after a clone
+// Check that the pod_index is correctly overwritten with an execve after a
+// clone
 TEST_F(sinsp_with_test_input, plugin_k8s_execve_after_clone_event)
 {
     std::shared_ptr<sinsp_plugin> plugin_owner;
@@ -295,8 +310,8 @@ TEST_F(sinsp_with_test_input, plugin_k8s_execve_after_clone_event)
     auto &reg = m_inspector.get_table_registry();
     auto thread_table = reg->get_table<int64_t>(THREAD_TABLE_NAME);
     auto field =
-            thread_table->dynamic_fields()->fields().find(POD_UID_FIELD_NAME);
-    auto fieldacc = field->second.new_accessor<std::string>();
+            thread_table->dynamic_fields()->fields().find(POD_INDEX_FIELD_NAME);
+    auto fieldacc = field->second.new_accessor<uint64_t>();
 
     int64_t p1_tid = 2;
     int64_t p1_pid = 2;
@@ -304,7 +319,7 @@ TEST_F(sinsp_with_test_input, plugin_k8s_execve_after_clone_event)
     int64_t p1_vtid = 1;
     int64_t p1_vpid = 1;
 
-    // Populate the pod_uid with a fist clone event
+    // Populate the pod_index with a fist clone event
     std::string expected_pod_uid = "5eaeeca9-2277-460b-a4bf-5a0783f6d49f";
     generate_clone_x_event(0, p1_tid, p1_pid, p1_ptid, PPM_CL_CHILD_IN_PIDNS,
                            p1_vtid, p1_vpid, "bash",
@@ -316,11 +331,12 @@ TEST_F(sinsp_with_test_input, plugin_k8s_execve_after_clone_event)
 
     auto p1_thread_entry = thread_table->get_entry(p1_tid);
     ASSERT_NE(p1_thread_entry, nullptr);
-    std::string pod_uid = "";
-    p1_thread_entry->get_dynamic_field(fieldacc, pod_uid);
-    ASSERT_EQ(pod_uid, expected_pod_uid);
+    uint64_t pod_index = 0;
+    p1_thread_entry->get_dynamic_field(fieldacc, pod_index);
+    ASSERT_NE(pod_index, 0);
+    auto clone_pod_index = pod_index;
 
-    // Re-Populate the pod_uid with a following execve event
+    // Re-Populate the pod_index with a following execve event
     expected_pod_uid = "05869489-8c7f-45dc-9abd-1b1620787bb1";
     generate_execve_enter_and_exit_event(
             0, p1_tid, p1_tid, p1_pid, p1_ptid, "bash", "bash", "/usr/bin/bash",
@@ -328,9 +344,10 @@ TEST_F(sinsp_with_test_input, plugin_k8s_execve_after_clone_event)
              "/691e0ffb65010b2b611f3a15b7f76c48466192e673e156f38bd2f8e25acd6bb"
              "c"});
 
-    // Check that the pod uid is updated after the first execve
-    p1_thread_entry->get_dynamic_field(fieldacc, pod_uid);
-    ASSERT_EQ(pod_uid, expected_pod_uid);
+    // Check that the pod index is updated after the first execve
+    p1_thread_entry->get_dynamic_field(fieldacc, pod_index);
+    ASSERT_NE(pod_index, 0);
+    ASSERT_NE(pod_index, clone_pod_index);
 }
 
 // Check if the thread entry is correctly removed after it is populated by the
@@ -366,8 +383,8 @@ TEST_F(sinsp_with_test_input, plugin_k8s_parse_parent_clone)
     auto &reg = m_inspector.get_table_registry();
     auto thread_table = reg->get_table<int64_t>(THREAD_TABLE_NAME);
     auto field =
-            thread_table->dynamic_fields()->fields().find(POD_UID_FIELD_NAME);
-    auto fieldacc = field->second.new_accessor<std::string>();
+            thread_table->dynamic_fields()->fields().find(POD_INDEX_FIELD_NAME);
+    auto fieldacc = field->second.new_accessor<uint64_t>();
 
     int64_t p1_tid = 2;
     int64_t p1_pid = 2;
@@ -387,16 +404,17 @@ TEST_F(sinsp_with_test_input, plugin_k8s_parse_parent_clone)
                            PPME_SYSCALL_CLONE_20_X);
     auto p1_thread_entry = thread_table->get_entry(p1_tid);
     ASSERT_NE(p1_thread_entry, nullptr);
-    std::string pod_uid = "";
-    p1_thread_entry->get_dynamic_field(fieldacc, pod_uid);
-    ASSERT_EQ(pod_uid, expected_pod_uid);
+    uint64_t pod_index = 0;
+    p1_thread_entry->get_dynamic_field(fieldacc, pod_index);
+    ASSERT_NE(pod_index, 0);
+    auto expected_pod_index = pod_index;
 
-    // we clear the pod_uid manually so we check that the pod_uid will be
+    // we clear the pod_index manually so we check that the pod_index will be
     // populated by the next clone parent event.
-    std::string empty_pod_uid = "";
-    p1_thread_entry->set_dynamic_field(fieldacc, empty_pod_uid);
-    p1_thread_entry->get_dynamic_field(fieldacc, pod_uid);
-    ASSERT_EQ(pod_uid, empty_pod_uid);
+    uint64_t empty_pod_index = 0;
+    p1_thread_entry->set_dynamic_field(fieldacc, empty_pod_index);
+    p1_thread_entry->get_dynamic_field(fieldacc, pod_index);
+    ASSERT_EQ(pod_index, empty_pod_index);
 
     // Clone parent exit event for p1
     generate_clone_x_event(p2_tid, p1_tid, p1_pid, p1_ptid,
@@ -406,9 +424,137 @@ TEST_F(sinsp_with_test_input, plugin_k8s_parse_parent_clone)
                             "/691e0ffb65010b2b611f3a15b7f76c48466192e673e156f38"
                             "bd2f8e25acd6bbc"},
                            PPME_SYSCALL_CLONE_20_X);
-    // We have again the pod_uid for the parent thread
-    p1_thread_entry->get_dynamic_field(fieldacc, pod_uid);
-    ASSERT_EQ(pod_uid, expected_pod_uid);
+    // We have again the pod_index for the parent thread
+    p1_thread_entry->get_dynamic_field(fieldacc, pod_index);
+    ASSERT_EQ(pod_index, expected_pod_index);
+}
+
+// A clone child with the cgroups of its parent takes the parent's pod_index
+TEST_F(sinsp_with_test_input, plugin_k8s_clone_child_inherits_pod_index)
+{
+    std::shared_ptr<sinsp_plugin> plugin_owner;
+    filter_check_list pl_flist;
+    ASSERT_PLUGIN_INITIALIZATION(plugin_owner, pl_flist)
+
+    add_default_init_thread();
+    open_inspector();
+
+    auto &reg = m_inspector.get_table_registry();
+    auto thread_table = reg->get_table<int64_t>(THREAD_TABLE_NAME);
+    auto field =
+            thread_table->dynamic_fields()->fields().find(POD_INDEX_FIELD_NAME);
+    auto fieldacc = field->second.new_accessor<uint64_t>();
+
+    int64_t p1_tid = 2;
+    int64_t p1_pid = 2;
+    int64_t p1_ptid = INIT_TID;
+    int64_t p2_tid = 3;
+    int64_t p2_pid = 3;
+    std::vector<std::string> cgroups = {
+            "cpuset=/kubepods/besteffort/pod"
+            "5eaeeca9-2277-460b-a4bf-5a0783f6d49f"
+            "/691e0ffb65010b2b611f3a15b7f76c48466192e673e156f38bd2f8e25acd6bb"
+            "c"};
+
+    // Create process p1, that is a child of init
+    generate_clone_x_event(0, p1_tid, p1_pid, p1_ptid, PPM_CL_CHILD_IN_PIDNS,
+                           1, 1, "bash", cgroups, PPME_SYSCALL_CLONE_20_X);
+    auto p1_thread_entry = thread_table->get_entry(p1_tid);
+    ASSERT_NE(p1_thread_entry, nullptr);
+
+    // We change the pod_index of p1 manually so we check that p2 takes it
+    // from its parent instead of the cgroups.
+    uint64_t pod_index = 0;
+    p1_thread_entry->get_dynamic_field(fieldacc, pod_index);
+    ASSERT_NE(pod_index, 0);
+    uint64_t parent_pod_index = pod_index + 1;
+    p1_thread_entry->set_dynamic_field(fieldacc, parent_pod_index);
+
+    // Create process p2, that is a child of p1 with the same cgroups
+    generate_clone_x_event(0, p2_tid, p2_pid, p1_tid, PPM_CL_CHILD_IN_PIDNS,
+                           2, 2, "bash", cgroups, PPME_SYSCALL_CLONE_20_X);
+    auto p2_thread_entry = thread_table->get_entry(p2_tid);
+    ASSERT_NE(p2_thread_entry, nullptr);
+    p2_thread_entry->get_dynamic_field(fieldacc, pod_index);
+    ASSERT_EQ(pod_index, parent_pod_index);
+}
+
+// The threads of a deleted pod keep running for a while, their events must
+// not create a slot for the pod again
+TEST_F(sinsp_with_test_input, plugin_k8s_deleted_pod_with_live_threads)
+{
+    std::shared_ptr<sinsp_plugin> plugin_owner;
+    filter_check_list pl_flist;
+    ASSERT_PLUGIN_INITIALIZATION(plugin_owner, pl_flist)
+
+    add_default_init_thread();
+    open_inspector();
+
+    auto &reg = m_inspector.get_table_registry();
+    auto thread_table = reg->get_table<int64_t>(THREAD_TABLE_NAME);
+    auto field =
+            thread_table->dynamic_fields()->fields().find(POD_INDEX_FIELD_NAME);
+    auto fieldacc = field->second.new_accessor<uint64_t>();
+
+    auto n_pod_slots = [&]()
+    {
+        std::string suffix = "n_pod_slots";
+        for(const auto &metric : plugin_owner->get_metrics())
+        {
+            std::string name = metric.name;
+            if(name.size() >= suffix.size() &&
+               name.compare(name.size() - suffix.size(), suffix.size(),
+                            suffix) == 0)
+            {
+                return metric.value.u64;
+            }
+        }
+        return UINT64_MAX;
+    };
+
+    int64_t p1_tid = 2;
+    int64_t p1_pid = 2;
+    int64_t p2_tid = 3;
+    int64_t p2_pid = 3;
+    std::string pod_uid = "5eaeeca9-2277-460b-a4bf-5a0783f6d49f";
+    std::vector<std::string> cgroups = {
+            "cpuset=/kubepods/besteffort/pod" + pod_uid +
+            "/691e0ffb65010b2b611f3a15b7f76c48466192e673e156f38bd2f8e25acd6bb"
+            "c"};
+
+    // The process shows up before the collector sends its pod
+    generate_clone_x_event(0, p1_tid, p1_pid, INIT_TID, PPM_CL_CHILD_IN_PIDNS,
+                           1, 1, "bash", cgroups, PPME_SYSCALL_CLONE_20_X);
+    auto p1_thread_entry = thread_table->get_entry(p1_tid);
+    ASSERT_NE(p1_thread_entry, nullptr);
+    uint64_t pod_index = 0;
+    p1_thread_entry->get_dynamic_field(fieldacc, pod_index);
+    ASSERT_NE(pod_index, 0);
+    ASSERT_EQ(n_pod_slots(), 1);
+
+    // The collector deletes the pod while p1 is still running
+    std::string deleted = std::string("{\"reason\":\"") + REASON_DELETE +
+                          "\",\"kind\":\"Pod\",\"uid\":\"" + pod_uid +
+                          "\"}";
+    add_event_advance_ts(increasing_ts(), INIT_TID, PPME_ASYNCEVENT_E, 3,
+                         (uint32_t)0, ASYNC_EVENT_NAME,
+                         scap_const_sized_buffer{deleted.c_str(),
+                                                 deleted.size() + 1});
+    ASSERT_EQ(n_pod_slots(), 0);
+
+    // Neither a new program of p1 nor a new process of the pod bring it back
+    generate_execve_enter_and_exit_event(0, p1_tid, p1_tid, p1_pid, INIT_TID,
+                                         "bash", "bash", "/usr/bin/bash",
+                                         cgroups);
+    ASSERT_EQ(n_pod_slots(), 0);
+
+    generate_clone_x_event(0, p2_tid, p2_pid, INIT_TID, PPM_CL_CHILD_IN_PIDNS,
+                           1, 1, "bash", cgroups, PPME_SYSCALL_CLONE_20_X);
+    auto p2_thread_entry = thread_table->get_entry(p2_tid);
+    ASSERT_NE(p2_thread_entry, nullptr);
+    p2_thread_entry->get_dynamic_field(fieldacc, pod_index);
+    ASSERT_EQ(pod_index, 0);
+    ASSERT_EQ(n_pod_slots(), 0);
 }
 
 TEST_F(sinsp_with_test_input, plugin_listen_cap_poduid)
@@ -437,12 +583,12 @@ TEST_F(sinsp_with_test_input, plugin_listen_cap_poduid)
     auto &reg = m_inspector.get_table_registry();
     auto thread_table = reg->get_table<int64_t>(THREAD_TABLE_NAME);
     auto dynamic_fields = thread_table->dynamic_fields();
-    auto field = dynamic_fields->fields().find(POD_UID_FIELD_NAME);
-    auto fieldacc = field->second.new_accessor<std::string>();
+    auto field = dynamic_fields->fields().find(POD_INDEX_FIELD_NAME);
+    auto fieldacc = field->second.new_accessor<uint64_t>();
 
     auto init_thread_entry = thread_table->get_entry(INIT_TID);
     ASSERT_NE(init_thread_entry, nullptr);
-    std::string pod_uid;
-    init_thread_entry->get_dynamic_field(fieldacc, pod_uid);
-    ASSERT_EQ(pod_uid, expected_pod_uid);
+    uint64_t pod_index = 0;
+    init_thread_entry->get_dynamic_field(fieldacc, pod_index);
+    ASSERT_NE(pod_index, 0);
 }
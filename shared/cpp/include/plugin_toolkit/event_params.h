@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2026 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <falcosecurity/sdk.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+// Max number of params of a sinsp event, as PPM_MAX_EVENT_PARAMS in libs
+#define EVENT_PARAMS_MAX 32
+
+struct sinsp_param
+{
+    uint32_t param_len;
+    uint8_t* param_pointer;
+};
+
+/*
+ * Params of a sinsp event. The lengths array is walked once, at
+ * construction, then each param is found in constant time: use it instead
+ * of `get_syscall_evt_param` when reading several params of a same event.
+ *
+ * Most events have 16-bit param lengths, the ones flagged EF_LARGE_PAYLOAD
+ * in libs (eg: PPME_CONTAINER_JSON_2_E) have 32-bit ones.
+ */
+template<const bool LargePayload = false> class event_params
+{
+    public:
+    using len_type = std::conditional_t<LargePayload, uint32_t, uint16_t>;
+
+    explicit event_params(const void* evt)
+    {
+        auto hdr = (const falcosecurity::_internal::ss_plugin_event*)evt;
+        auto lens = (const uint8_t*)evt + sizeof(*hdr);
+        m_data = (uint8_t*)lens + hdr->nparams * sizeof(len_type);
+        // Params past the max can't be read, they are ignored
+        m_size = std::min<uint32_t>(hdr->nparams, EVENT_PARAMS_MAX);
+
+        uint32_t offset = 0;
+        for(uint32_t i = 0; i < m_size; i++)
+        {
+            // The array follows the packed event header, it may be unaligned
+            len_type len;
+            memcpy(&len, lens + i * sizeof(len_type), sizeof(len_type));
+            m_offsets[i] = offset;
+            m_lens[i] = len;
+            offset += len;
+        }
+    }
+
+    uint32_t size() const { return m_size; }
+
+    // A null pointer if the event has no param `num_param`
+    sinsp_param get(uint32_t num_param) const
+    {
+        if(num_param >= m_size)
+        {
+            return {0, nullptr};
+        }
+        return {m_lens[num_param], m_data + m_offsets[num_param]};
+    }
+
+    private:
+    uint8_t* m_data;
+    uint32_t m_size;
+    uint32_t m_offsets[EVENT_PARAMS_MAX];
+    uint32_t m_lens[EVENT_PARAMS_MAX];
+};
+
+// Obtain a single param from a sinsp event, only walking the lengths of the
+// previous ones. A null pointer if the event has no param `num_param`.
+template<const bool LargePayload = false>
+inline sinsp_param get_syscall_evt_param(const void* evt, uint32_t num_param)
+{
+    using len_type = std::conditional_t<LargePayload, uint32_t, uint16_t>;
+
+    auto hdr = (const falcosecurity::_internal::ss_plugin_event*)evt;
+    if(num_param >= hdr->nparams)
+    {
+        return {0, nullptr};
+    }
+    // pointer to the lengths array inside the event.
+    auto lens = (const uint8_t*)evt + sizeof(*hdr);
+    uint32_t dataoffset = 0;
+    len_type len;
+    for(uint32_t j = 0; j < num_param; j++)
+    {
+        // sum lengths of the previous params.
+        memcpy(&len, lens + j * sizeof(len_type), sizeof(len_type));
+        dataoffset += len;
+    }
+    memcpy(&len, lens + num_param * sizeof(len_type), sizeof(len_type));
+    return {len,
+            (uint8_t*)lens + hdr->nparams * sizeof(len_type) + dataoffset};
+}
+
+// View into the raw event buffer, string params are NUL terminated but never
+// read past their length
+inline std::string_view param_as_string_view(const sinsp_param& param)
+{
+    if(param.param_pointer == nullptr || param.param_len == 0)
+    {
+        return {};
+    }
+    auto str = (const char*)param.param_pointer;
+    return std::string_view(str, strnlen(str, param.param_len));
+}
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2026 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Histogram of latencies, with a fixed set of decimal buckets. Plugin metrics
+ * are scalars, the histogram is exported as its count, its sum and one
+ * cumulative counter for each bucket bound, as Prometheus histograms are.
+ */
+class latency_histogram
+{
+    public:
+    static constexpr size_t n_bounds = 5;
+    // Bucket upper bounds, in ns
+    static constexpr uint64_t bounds[n_bounds] = {1000, 10000, 100000,
+                                                  1000000, 10000000};
+    // Metric name suffixes of the bounds
+    static constexpr const char* bound_names[n_bounds] = {
+            "le_1us", "le_10us", "le_100us", "le_1ms", "le_10ms"};
+
+    void record(uint64_t ns)
+    {
+        m_count++;
+        m_sum_ns += ns;
+        for(size_t i = 0; i < n_bounds; i++)
+        {
+            if(ns <= bounds[i])
+            {
+                m_buckets[i]++;
+                return;
+            }
+        }
+    }
+
+    uint64_t get_count() const { return m_count; }
+    uint64_t get_sum_ns() const { return m_sum_ns; }
+    // Number of values lower than or equal to bounds[i]
+    uint64_t get_cumulative(size_t i) const
+    {
+        uint64_t n = 0;
+        for(size_t b = 0; b <= i && b < n_bounds; b++)
+        {
+            n += m_buckets[b];
+        }
+        return n;
+    }
+
+    private:
+    uint64_t m_count = 0;
+    uint64_t m_sum_ns = 0;
+    // Non cumulative, values above the last bound are only counted
+    uint64_t m_buckets[n_bounds] = {};
+};
+
+// Monotonic clock, in ns
+inline uint64_t monotonic_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+// Records the lifetime of the timer into a histogram
+class latency_timer
+{
+    public:
+    explicit latency_timer(latency_histogram& h):
+            m_histogram(h), m_start(std::chrono::steady_clock::now())
+    {
+    }
+    ~latency_timer()
+    {
+        m_histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now() - m_start)
+                                   .count());
+    }
+
+    latency_timer(const latency_timer&) = delete;
+    latency_timer& operator=(const latency_timer&) = delete;
+
+    private:
+    latency_histogram& m_histogram;
+    std::chrono::steady_clock::time_point m_start;
+};
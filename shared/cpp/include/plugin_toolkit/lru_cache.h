@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2026 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+/*
+ * Bounded cache keyed by strings, evicting the least recently used entry.
+ * Meant for the results of parsing cgroup paths: the processes of a same
+ * container share their cgroups, a small working set covers almost all of
+ * the new processes.
+ */
+template<typename V> class string_lru_cache
+{
+    public:
+    // A cache of size 0 caches nothing
+    explicit string_lru_cache(size_t max_size): m_max_size(max_size) {}
+
+    // The keys are views on the list entries, they can't be copied
+    string_lru_cache(const string_lru_cache&) = delete;
+    string_lru_cache& operator=(const string_lru_cache&) = delete;
+
+    // Value cached for `key`, made the most recently used, null if missing
+    V* find(std::string_view key)
+    {
+        auto it = m_index.find(key);
+        if(it == m_index.end())
+        {
+            return nullptr;
+        }
+        // Move the entry to the front, the least recently used is the last
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return &it->second->second;
+    }
+
+    // Cache `value` for `key`, evicting the least recently used entry once
+    // the cache is full
+    void insert(std::string_view key, V value)
+    {
+        if(m_max_size == 0)
+        {
+            return;
+        }
+        auto it = m_index.find(key);
+        if(it != m_index.end())
+        {
+            it->second->second = std::move(value);
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+            return;
+        }
+        if(m_index.size() >= m_max_size)
+        {
+            m_index.erase(m_lru.back().first);
+            m_lru.pop_back();
+        }
+        m_lru.emplace_front(std::string(key), std::move(value));
+        m_index.emplace(m_lru.front().first, m_lru.begin());
+    }
+
+    bool erase(std::string_view key)
+    {
+        auto it = m_index.find(key);
+        if(it == m_index.end())
+        {
+            return false;
+        }
+        auto entry = it->second;
+        m_index.erase(it);
+        m_lru.erase(entry);
+        return true;
+    }
+
+    void clear()
+    {
+        m_index.clear();
+        m_lru.clear();
+    }
+
+    size_t size() const { return m_index.size(); }
+    size_t max_size() const { return m_max_size; }
+
+    private:
+    using entry = std::pair<std::string, V>;
+
+    size_t m_max_size;
+    std::list<entry> m_lru;
+    // Keys are views on the strings owned by the list entries
+    std::unordered_map<std::string_view, typename std::list<entry>::iterator>
+            m_index;
+};
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2026 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <plugin_toolkit/latency_histogram.h>
+
+#include <falcosecurity/sdk.h>
+
+#include <string>
+#include <vector>
+
+// Declare the metrics of a histogram named `name`: its count, its sum and
+// its cumulative buckets. Keep this aligned with `set_histogram_metrics`.
+inline void add_histogram_metrics(std::vector<falcosecurity::metric>& metrics,
+                                  const std::string& name)
+{
+    using mt = falcosecurity::metric_type;
+    metrics.emplace_back(name + "_count", mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    metrics.emplace_back(name + "_sum_ns",
+                         mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    for(const auto* bound : latency_histogram::bound_names)
+    {
+        metrics.emplace_back(name + "_" + bound,
+                             mt::SS_PLUGIN_METRIC_TYPE_MONOTONIC);
+    }
+}
+
+// Refresh the values of the metrics declared by `add_histogram_metrics`,
+// starting at `idx`, which is moved past them
+inline void set_histogram_metrics(std::vector<falcosecurity::metric>& metrics,
+                                  size_t& idx, const latency_histogram& h)
+{
+    metrics.at(idx++).set_value(h.get_count());
+    metrics.at(idx++).set_value(h.get_sum_ns());
+    for(size_t i = 0; i < latency_histogram::n_bounds; i++)
+    {
+        metrics.at(idx++).set_value(h.get_cumulative(i));
+    }
+}
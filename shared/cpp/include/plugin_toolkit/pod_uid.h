@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2026 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Length of a pod uid, eg: 05869489-8c7f-45dc-9abd-1b1620787bb1
+#define POD_UID_LEN 36
+
+// Thread table field where the container plugin publishes the pod uid found
+// in the cgroups of a thread, empty for the threads out of any pod. Plugins
+// parsing the same events after it can read it instead of the cgroups.
+#define POD_UID_FIELD_NAME "pod_uid"
+
+inline bool is_pod_uid_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
+}
+
+// Look for the first `pod<uid>` in the cgroup. Here `cgroup` has the
+// following layout: `hierarchyID:controller:cgroup_path`, or only the path
+// Example (cgroup v2):
+// `0::/kubepods.slice/kubepods-besteffort.slice/kubepods-besteffort-pod93f64796_43b9_468d_b77b_c652c985d5e0.slice`
+// Example (cgroup v1):
+// `12:perf_event:/kubepods.slice/kubepods-besteffort.slice/kubepods-besteffort-pod93f64796_43b9_468d_b77b_c652c985d5e0.slice`
+//
+// The uid could have 2 possible layouts:
+// - (driver cgroup) pod05869489-8c7f-45dc-9abd-1b1620787bb1
+// - (driver systemd) pod05869489_8c7f_45dc_9abd_1b1620787bb1
+// and it is always written in `pod_uid` with `-`:
+// 05869489-8c7f-45dc-9abd-1b1620787bb1
+inline bool scan_pod_uid(std::string_view cgroup, char (&pod_uid)[POD_UID_LEN])
+{
+    for(auto pos = cgroup.find("pod"); pos != std::string_view::npos;
+        pos = cgroup.find("pod", pos + 1))
+    {
+        if(cgroup.size() - pos - 3 < POD_UID_LEN)
+        {
+            return false;
+        }
+
+        const char* uid = cgroup.data() + pos + 3;
+        size_t i = 0;
+        for(; i < POD_UID_LEN; i++)
+        {
+            if(i == 8 || i == 13 || i == 18 || i == 23)
+            {
+                if(uid[i] != '-' && uid[i] != '_')
+                {
+                    break;
+                }
+                pod_uid[i] = '-';
+            }
+            else
+            {
+                if(!is_pod_uid_char(uid[i]))
+                {
+                    break;
+                }
+                pod_uid[i] = uid[i];
+            }
+        }
+        if(i == POD_UID_LEN)
+        {
+            return true;
+        }
+    }
+    return false;
+}
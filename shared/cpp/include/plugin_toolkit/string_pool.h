@@ -0,0 +1,204 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2026 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class interned_string;
+
+/*
+ * Process wide pool of immutable strings, for the metadata values repeated
+ * across many entries of a plugin table: eg. image names, users, env entries
+ * and label keys/values are repeated across all the containers of a
+ * deployment, the pool stores a single copy of each of them. Each plugin
+ * library gets its own pool.
+ *
+ * Strings are refcounted by `interned_string` handles and dropped from the
+ * pool when the last handle goes away, so container churn does not make the
+ * pool grow unbounded.
+ */
+class string_pool
+{
+    public:
+    struct node
+    {
+        std::atomic<uint32_t> m_refs;
+        const std::string m_str;
+    };
+
+    // Never destroyed, handles may be held by objects outliving static ones
+    static string_pool& instance();
+
+    // Number of distinct strings currently held by the pool
+    size_t size() const;
+
+    private:
+    friend class interned_string;
+
+    string_pool() = default;
+
+    // Returns the node holding `s`, with a reference taken
+    node* intern(std::string_view s);
+    // Drops a reference, freeing the node once it was the last one
+    void release(node* n);
+
+    mutable std::mutex m_mutex;
+    // Keys point into the nodes' strings
+    std::unordered_map<std::string_view, node*> m_nodes;
+};
+
+// Handle to a pooled string, as cheap to copy as a pointer. Since the pool
+// holds a single node for each string, equality is a pointer comparison.
+class interned_string
+{
+    public:
+    interned_string() = default;
+    interned_string(std::string_view s): m_node(intern(s)) {}
+    interned_string(const std::string& s): m_node(intern(s)) {}
+    interned_string(const char* s): m_node(intern(s)) {}
+
+    interned_string(const interned_string& o): m_node(o.m_node)
+    {
+        if(m_node != nullptr)
+        {
+            m_node->m_refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    interned_string(interned_string&& o) noexcept: m_node(o.m_node)
+    {
+        o.m_node = nullptr;
+    }
+
+    interned_string& operator=(interned_string o) noexcept
+    {
+        std::swap(m_node, o.m_node);
+        return *this;
+    }
+
+    ~interned_string()
+    {
+        if(m_node != nullptr)
+        {
+            string_pool::instance().release(m_node);
+        }
+    }
+
+    const std::string& str() const
+    {
+        return m_node != nullptr ? m_node->m_str : empty_string();
+    }
+    operator const std::string&() const { return str(); }
+    const char* c_str() const { return str().c_str(); }
+    size_t size() const { return str().size(); }
+    bool empty() const { return m_node == nullptr; }
+
+    bool operator==(const interned_string& o) const
+    {
+        return m_node == o.m_node;
+    }
+    bool operator!=(const interned_string& o) const
+    {
+        return m_node != o.m_node;
+    }
+    bool operator==(std::string_view s) const { return str() == s; }
+    bool operator!=(std::string_view s) const { return str() != s; }
+    bool operator==(const std::string& s) const { return str() == s; }
+    bool operator!=(const std::string& s) const { return str() != s; }
+    bool operator==(const char* s) const { return str() == s; }
+    bool operator!=(const char* s) const { return str() != s; }
+
+    private:
+    static string_pool::node* intern(std::string_view s)
+    {
+        // The empty string is never pooled
+        return s.empty() ? nullptr : string_pool::instance().intern(s);
+    }
+
+    static const std::string& empty_string();
+
+    string_pool::node* m_node = nullptr;
+};
+
+inline string_pool& string_pool::instance()
+{
+    static string_pool* pool = new string_pool();
+    return *pool;
+}
+
+inline size_t string_pool::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_nodes.size();
+}
+
+inline string_pool::node* string_pool::intern(std::string_view s)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_nodes.find(s);
+    if(it != m_nodes.end())
+    {
+        // Nodes only reach 0 references, and get freed, under the lock
+        it->second->m_refs.fetch_add(1, std::memory_order_relaxed);
+        return it->second;
+    }
+    auto n = new node{{1}, std::string(s)};
+    m_nodes.emplace(n->m_str, n);
+    return n;
+}
+
+inline void string_pool::release(node* n)
+{
+    // Fast path, this is not the last reference
+    auto refs = n->m_refs.load(std::memory_order_relaxed);
+    while(refs > 1)
+    {
+        if(n->m_refs.compare_exchange_weak(refs, refs - 1,
+                                           std::memory_order_acq_rel))
+        {
+            return;
+        }
+    }
+
+    // Possibly the last one: decrement under the lock, so that intern()
+    // cannot hand out the node while it gets freed
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(n->m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        m_nodes.erase(n->m_str);
+        delete n;
+    }
+}
+
+inline const std::string& interned_string::empty_string()
+{
+    static const std::string empty;
+    return empty;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const interned_string& s)
+{
+    return os << s.str();
+}